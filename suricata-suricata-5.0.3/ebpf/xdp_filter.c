@@ -56,6 +56,15 @@
  * and unset BUILD_CPUMAP (number must be a power of 2 for netronome) */
 #define RSS_QUEUE_NUMBERS   32
 
+/* Set to 1 to hand the packets that are not bypassed to the Suricata
+ * AF_XDP sockets registered in xsks_map instead of the kernel stack.
+ * Needs BUILD_CPUMAP set to 0. */
+#define BUILD_XSKMAP        0
+
+#if BUILD_XSKMAP && BUILD_CPUMAP
+#error "BUILD_XSKMAP and BUILD_CPUMAP are mutually exclusive"
+#endif
+
 /* no vlan tracking: set it to 0 if you don't use VLAN for tracking. Can
  * also be used as workaround of some hardware offload issue */
 #define VLAN_TRACKING    1
@@ -176,6 +185,29 @@ struct bpf_map_def SEC("maps") tx_peer_int = {
 };
 #endif
 
+#if BUILD_XSKMAP
+/* AF_XDP sockets indexed by rx queue, set by Suricata at startup */
+struct bpf_map_def SEC("maps") xsks_map = {
+    .type = BPF_MAP_TYPE_XSKMAP,
+    .key_size = sizeof(__u32),
+    .value_size = sizeof(int),
+    .max_entries = 64,
+};
+#endif
+
+/* Verdict for packets we don't bypass: send them to the AF_XDP socket
+ * of the rx queue if there is one, else to the kernel stack. */
+static __always_inline int xdp_pass(struct xdp_md *ctx)
+{
+#if BUILD_XSKMAP
+    __u32 queue = ctx->rx_queue_index;
+
+    if (bpf_map_lookup_elem(&xsks_map, &queue))
+        return bpf_redirect_map(&xsks_map, queue, 0);
+#endif
+    return XDP_PASS;
+}
+
 #define USE_GLOBAL_BYPASS   0
 #if USE_GLOBAL_BYPASS
 /* single entry to indicate if global bypass switch is on */
@@ -258,7 +290,7 @@ static int __always_inline filter_ipv4(struct xdp_md *ctx, void *data, __u64 nh_
 #endif
 
     if ((void *)(iph + 1) > data_end)
-        return XDP_PASS;
+        return xdp_pass(ctx);
 
     if (iph->protocol == IPPROTO_TCP) {
         tuple.ip_proto = 1;
@@ -270,11 +302,11 @@ static int __always_inline filter_ipv4(struct xdp_md *ctx, void *data, __u64 nh_
 
     dport = get_dport(iph + 1, data_end, iph->protocol);
     if (dport == -1)
-        return XDP_PASS;
+        return xdp_pass(ctx);
 
     sport = get_sport(iph + 1, data_end, iph->protocol);
     if (sport == -1)
-        return XDP_PASS;
+        return xdp_pass(ctx);
 
     tuple.port16[0] = (__u16)sport;
     tuple.port16[1] = (__u16)dport;
@@ -363,16 +395,16 @@ static int __always_inline filter_ipv4(struct xdp_md *ctx, void *data, __u64 nh_
         cpu_dest = *cpu_selected;
         return bpf_redirect_map(&cpu_map, cpu_dest, 0);
     } else {
-        return XDP_PASS;
+        return xdp_pass(ctx);
     }
 #else
-#if RSS_QUEUE_NUMBERS
+#if RSS_QUEUE_NUMBERS && !BUILD_XSKMAP
     /* IP-pairs + protocol (UDP/TCP/ICMP) hit same CPU */
     __u32 xdp_hash = tuple.src + tuple.dst;
     xdp_hash = SuperFastHash((char *)&xdp_hash, 4, INITVAL + iph->protocol);
     ctx->rx_queue_index = xdp_hash % RSS_QUEUE_NUMBERS;
 #endif
-    return XDP_PASS;
+    return xdp_pass(ctx);
 #endif
 }
 
@@ -400,15 +432,15 @@ static int __always_inline filter_ipv6(struct xdp_md *ctx, void *data, __u64 nh_
     if ((void *)(ip6h + 1) > data_end)
         return 0;
     if (!((ip6h->nexthdr == IPPROTO_UDP) || (ip6h->nexthdr == IPPROTO_TCP)))
-        return XDP_PASS;
+        return xdp_pass(ctx);
 
     dport = get_dport(ip6h + 1, data_end, ip6h->nexthdr);
     if (dport == -1)
-        return XDP_PASS;
+        return xdp_pass(ctx);
 
     sport = get_sport(ip6h + 1, data_end, ip6h->nexthdr);
     if (sport == -1)
-        return XDP_PASS;
+        return xdp_pass(ctx);
 
     if (ip6h->nexthdr == IPPROTO_TCP) {
         tuple.ip_proto = 1;
@@ -465,10 +497,10 @@ static int __always_inline filter_ipv6(struct xdp_md *ctx, void *data, __u64 nh_
         cpu_dest = *cpu_selected;
         return bpf_redirect_map(&cpu_map, cpu_dest, 0);
     } else {
-        return XDP_PASS;
+        return xdp_pass(ctx);
     }
 #else
-#if RSS_QUEUE_NUMBERS
+#if RSS_QUEUE_NUMBERS && !BUILD_XSKMAP
     /* IP-pairs + protocol (UDP/TCP/ICMP) hit same CPU */
     __u32 xdp_hash  = tuple.src[0] + tuple.dst[0];
     xdp_hash += tuple.src[1] + tuple.dst[1];
@@ -478,7 +510,7 @@ static int __always_inline filter_ipv6(struct xdp_md *ctx, void *data, __u64 nh_
     ctx->rx_queue_index = xdp_hash % RSS_QUEUE_NUMBERS;
 #endif
 
-    return XDP_PASS;
+    return xdp_pass(ctx);
 #endif
 }
 
@@ -510,7 +542,7 @@ int SEC("xdp") xdp_hashfilter(struct xdp_md *ctx)
 
     nh_off = sizeof(*eth);
     if (data + nh_off > data_end)
-        return XDP_PASS;
+        return xdp_pass(ctx);
 
     h_proto = eth->h_proto;
 
@@ -520,7 +552,7 @@ int SEC("xdp") xdp_hashfilter(struct xdp_md *ctx)
         vhdr = data + nh_off;
         nh_off += sizeof(struct vlan_hdr);
         if (data + nh_off > data_end)
-            return XDP_PASS;
+            return xdp_pass(ctx);
         h_proto = vhdr->h_vlan_encapsulated_proto;
 #if VLAN_TRACKING
         vlan0 = vhdr->h_vlan_TCI & 0x0fff;
@@ -534,7 +566,7 @@ int SEC("xdp") xdp_hashfilter(struct xdp_md *ctx)
         vhdr = data + nh_off;
         nh_off += sizeof(struct vlan_hdr);
         if (data + nh_off > data_end)
-            return XDP_PASS;
+            return xdp_pass(ctx);
         h_proto = vhdr->h_vlan_encapsulated_proto;
 #if VLAN_TRACKING
         vlan1 = vhdr->h_vlan_TCI & 0x0fff;
@@ -548,7 +580,7 @@ int SEC("xdp") xdp_hashfilter(struct xdp_md *ctx)
     else if (h_proto == __constant_htons(ETH_P_IPV6))
         return filter_ipv6(ctx, data, nh_off, data_end, vlan0, vlan1);
 
-    return XDP_PASS;
+    return xdp_pass(ctx);
 }
 
 char __license[] SEC("license") = "GPL";
@@ -77,15 +77,15 @@ static void AlertDebugLogFlowVars(AlertDebugLogThread *aft, const Packet *p)
 {
     const GenericVar *gv = p->flow->flowvar;
     uint16_t i;
+    for (uint32_t idx = 0; FlowBitGetNext(p->flow, &idx); idx++) {
+        const char *fbname = VarNameStoreLookupById(idx, VAR_TYPE_FLOW_BIT);
+        if (fbname) {
+            MemBufferWriteString(aft->buffer, "FLOWBIT:           %s\n",
+                    fbname);
+        }
+    }
     while (gv != NULL) {
-        if (gv->type == DETECT_FLOWBITS) {
-            FlowBit *fb = (FlowBit *)gv;
-            const char *fbname = VarNameStoreLookupById(fb->idx, VAR_TYPE_FLOW_BIT);
-            if (fbname) {
-                MemBufferWriteString(aft->buffer, "FLOWBIT:           %s\n",
-                        fbname);
-            }
-        } else if (gv->type == DETECT_FLOWVAR || gv->type == DETECT_FLOWINT) {
+        if (gv->type == DETECT_FLOWVAR) {
             FlowVar *fv = (FlowVar *) gv;
 
             if (fv->datatype == FLOWVAR_TYPE_STR) {
@@ -103,15 +103,16 @@ static void AlertDebugLogFlowVars(AlertDebugLogThread *aft, const Packet *p)
                     }
                 }
                 MemBufferWriteString(aft->buffer, "\"\n");
-            } else if (fv->datatype == FLOWVAR_TYPE_INT) {
-                const char *fvname = VarNameStoreLookupById(fv->idx,
-                        VAR_TYPE_FLOW_INT);
-                MemBufferWriteString(aft->buffer, "FLOWINT:           \"%s\" =>"
-                        " %"PRIu32"\n", fvname, fv->data.fv_int.value);
             }
         }
         gv = gv->next;
     }
+    for (i = 0; i < p->flow->flowints_cnt; i++) {
+        const char *fvname = VarNameStoreLookupById(p->flow->flowints[i].idx,
+                VAR_TYPE_FLOW_INT);
+        MemBufferWriteString(aft->buffer, "FLOWINT:           \"%s\" =>"
+                " %"PRIu32"\n", fvname, p->flow->flowints[i].value);
+    }
 }
 
 /**
@@ -66,6 +66,41 @@
 static StreamingBufferConfig default_cfg = {
     0, 0, 3072, HTPMalloc, HTPCalloc, HTPRealloc, HTPFree };
 
+static int HtpBodyInitBuffer(const HTPCfgDir *hcfg, HtpBody *body)
+{
+    if (body->sb == NULL) {
+        const StreamingBufferConfig *cfg = hcfg ? &hcfg->sbcfg : &default_cfg;
+        body->sb = StreamingBufferInit(cfg);
+        if (body->sb == NULL)
+            return -1;
+        /* keep chunk offsets in sync with the body if earlier data
+         * couldn't be copied out of the stream */
+        body->sb->stream_offset = body->content_len_so_far;
+    }
+    return 0;
+}
+
+/** \internal
+ *  \brief body offset of the first byte of the view
+ *
+ *  The view always ends at the end of the body, see
+ *  HtpBodyAppendStreamChunk. */
+static inline uint64_t HtpBodyViewStart(const HtpBody *body)
+{
+    return body->content_len_so_far - body->view.len;
+}
+
+static void HtpBodyAddChunk(HtpBody *body, HtpBodyChunk *bd, uint32_t len)
+{
+    if (body->first == NULL) {
+        body->first = body->last = bd;
+    } else {
+        body->last->next = bd;
+        body->last = bd;
+    }
+    body->content_len_so_far += len;
+}
+
 /**
  * \brief Append a chunk of body to the HtpBody struct
  *
@@ -87,11 +122,8 @@ int HtpBodyAppendChunk(const HTPCfgDir *hcfg, HtpBody *body,
         SCReturnInt(0);
     }
 
-    if (body->sb == NULL) {
-        const StreamingBufferConfig *cfg = hcfg ? &hcfg->sbcfg : &default_cfg;
-        body->sb = StreamingBufferInit(cfg);
-        if (body->sb == NULL)
-            SCReturnInt(-1);
+    if (HtpBodyInitBuffer(hcfg, body) != 0) {
+        SCReturnInt(-1);
     }
 
     /* New chunk */
@@ -105,19 +137,158 @@ int HtpBodyAppendChunk(const HTPCfgDir *hcfg, HtpBody *body,
         SCReturnInt(-1);
     }
 
-    if (body->first == NULL) {
-        body->first = body->last = bd;
-    } else {
-        body->last->next = bd;
-        body->last = bd;
-    }
-    body->content_len_so_far += len;
+    HtpBodyAddChunk(body, bd, len);
 
     SCLogDebug("body %p", body);
 
     SCReturnInt(0);
 }
 
+/**
+ * \internal
+ * \brief Copy the data of the body's view into the body's own buffer
+ *
+ * Called by the stream's buffer when it slides past the data, or by
+ * us when the body data is no longer contiguous in the stream. The
+ * body has no buffer of its own while it uses the view, so the new
+ * buffer starts at the view's body offset to keep the chunk offsets
+ * valid.
+ */
+static void HtpBodyViewEvict(StreamingBufferView *view,
+        const uint8_t *data, uint32_t data_len)
+{
+    HtpBody *body = (HtpBody *)((uint8_t *)view - offsetof(HtpBody, view));
+
+    SCLogDebug("body %p: copying %u bytes out of the stream", body, data_len);
+    BUG_ON(body->sb != NULL);
+    body->sb = StreamingBufferInit(body->view_sbcfg);
+    if (body->sb == NULL) {
+        return;
+    }
+    body->sb->stream_offset = HtpBodyViewStart(body);
+
+    if (data_len > 0 &&
+            StreamingBufferAppendNoTrack(body->sb, data, data_len) != 0) {
+        SCLogDebug("body %p: failed to copy, body data lost", body);
+    }
+}
+
+/**
+ * \brief Append a chunk of body that may be in the TCP stream's buffer
+ *
+ * If all the body data so far is one contiguous region of the stream
+ * buffer, the body references it through a view instead of copying it.
+ * The data is copied only when the stream slides past it while the body
+ * still holds it, or when the body stops being contiguous in the stream,
+ * for example with chunked encoding or decompression.
+ *
+ * \param stream stream buffer the parser is fed from, can be NULL
+ *
+ * \retval 0 ok
+ * \retval -1 error
+ */
+int HtpBodyAppendStreamChunk(const HTPCfgDir *hcfg, HtpBody *body,
+        StreamingBuffer *stream, const uint8_t *data, uint32_t len)
+{
+    if (len == 0 || data == NULL) {
+        return 0;
+    }
+
+    if (body->view.sb != NULL) {
+        if (StreamingBufferViewExtend(&body->view, data, len) != 0) {
+            const uint8_t *vdata = NULL;
+            uint32_t vdata_len = 0;
+            StreamingBufferViewGetDataAtOffset(&body->view, &vdata, &vdata_len, 0);
+            StreamingBufferViewDetach(&body->view);
+            HtpBodyViewEvict(&body->view, vdata, vdata_len);
+            return HtpBodyAppendChunk(hcfg, body, data, len);
+        }
+    } else if (body->content_len_so_far == 0 && body->sb == NULL && stream != NULL) {
+        if (StreamingBufferViewAttach(stream, &body->view, data, len,
+                    HtpBodyViewEvict) != 0) {
+            return HtpBodyAppendChunk(hcfg, body, data, len);
+        }
+        body->view_sbcfg = hcfg ? &hcfg->sbcfg : &default_cfg;
+    } else {
+        return HtpBodyAppendChunk(hcfg, body, data, len);
+    }
+
+    HtpBodyChunk *bd = (HtpBodyChunk *)HTPCalloc(1, sizeof(HtpBodyChunk));
+    if (bd == NULL) {
+        /* undo the extend/attach so the view matches the chunks */
+        body->view.len -= len;
+        return -1;
+    }
+    bd->sbseg.stream_offset = body->content_len_so_far;
+    bd->sbseg.segment_len = len;
+    HtpBodyAddChunk(body, bd, len);
+
+    SCLogDebug("body %p: %u bytes referenced in the stream", body, len);
+    return 0;
+}
+
+/**
+ * \brief Get the body data starting at a body offset
+ *
+ * \retval 1 data returned
+ * \retval 0 no data at this offset
+ */
+int HtpBodyGetDataAtOffset(const HtpBody *body,
+        const uint8_t **data, uint32_t *data_len, uint64_t offset)
+{
+    if (body->view.sb != NULL) {
+        const uint64_t start = HtpBodyViewStart(body);
+        if (offset >= start) {
+            return StreamingBufferViewGetDataAtOffset(&body->view,
+                    data, data_len, offset - start);
+        }
+        *data = NULL;
+        *data_len = 0;
+        return 0;
+    }
+    return StreamingBufferGetDataAtOffset(body->sb, data, data_len, offset);
+}
+
+/**
+ * \brief Get all body data still held
+ *
+ * \param offset body offset of the returned data
+ *
+ * \retval 1 data returned
+ * \retval 0 no data
+ */
+int HtpBodyGetData(const HtpBody *body,
+        const uint8_t **data, uint32_t *data_len, uint64_t *offset)
+{
+    if (body->view.sb != NULL) {
+        *offset = HtpBodyViewStart(body);
+        return HtpBodyGetDataAtOffset(body, data, data_len, *offset);
+    }
+    return StreamingBufferGetData(body->sb, data, data_len, offset);
+}
+
+/**
+ * \brief Get the data of a single chunk, or of what is left of it
+ */
+void HtpBodyChunkGetData(const HtpBody *body, const HtpBodyChunk *chunk,
+        const uint8_t **data, uint32_t *data_len)
+{
+    if (body->view.sb != NULL) {
+        const StreamingBufferSegment *seg = &chunk->sbseg;
+        const uint64_t seg_end = seg->stream_offset + seg->segment_len;
+        const uint64_t offset = MAX(seg->stream_offset, HtpBodyViewStart(body));
+        if (offset < seg_end &&
+                HtpBodyGetDataAtOffset(body, data, data_len, offset) == 1) {
+            *data_len = MIN(*data_len, seg_end - offset);
+            return;
+        }
+        *data = NULL;
+        *data_len = 0;
+        return;
+    }
+    StreamingBufferSegmentGetData(body->sb, &chunk->sbseg, data, data_len);
+}
+
 /**
  * \brief Print the information and chunks of a Body
  * \param body pointer to the HtpBody holding the list
@@ -137,7 +308,7 @@ void HtpBodyPrint(HtpBody *body)
         for (cur = body->first; cur != NULL; cur = cur->next) {
             const uint8_t *data = NULL;
             uint32_t data_len = 0;
-            StreamingBufferSegmentGetData(body->sb, &cur->sbseg, &data, &data_len);
+            HtpBodyChunkGetData(body, cur, &data, &data_len);
             SCLogDebug("Body %p; data %p, len %"PRIu32, body, data, data_len);
             printf("Body %p; data %p, len %"PRIu32"\n", body, data, data_len);
             PrintRawDataFp(stdout, data, data_len);
@@ -168,6 +339,7 @@ void HtpBodyFree(HtpBody *body)
     }
     body->first = body->last = NULL;
 
+    StreamingBufferViewDetach(&body->view);
     StreamingBufferFree(body->sb);
 }
 
@@ -222,7 +394,14 @@ void HtpBodyPrune(HtpState *state, HtpBody *body, int direction)
 
     if (left_edge) {
         SCLogDebug("sliding body to offset %"PRIu64, left_edge);
-        StreamingBufferSlideToOffset(body->sb, left_edge);
+        if (body->view.sb != NULL) {
+            const uint64_t start = HtpBodyViewStart(body);
+            if (left_edge > start) {
+                StreamingBufferViewSlide(&body->view, left_edge - start);
+            }
+        } else {
+            StreamingBufferSlideToOffset(body->sb, left_edge);
+        }
     }
 
     SCLogDebug("pruning chunks of body %p", body);
@@ -232,7 +411,13 @@ void HtpBodyPrune(HtpState *state, HtpBody *body, int direction)
         HtpBodyChunk *next = cur->next;
         SCLogDebug("cur %p", cur);
 
-        if (!StreamingBufferSegmentIsBeforeWindow(body->sb, &cur->sbseg)) {
+        if (body->view.sb != NULL) {
+            if (cur->sbseg.stream_offset + cur->sbseg.segment_len >
+                    HtpBodyViewStart(body)) {
+                SCLogDebug("not removed");
+                break;
+            }
+        } else if (!StreamingBufferSegmentIsBeforeWindow(body->sb, &cur->sbseg)) {
             SCLogDebug("not removed");
             break;
         }
@@ -29,6 +29,12 @@
 #define __APP_LAYER_HTP_BODY_H__
 
 int HtpBodyAppendChunk(const HTPCfgDir *, HtpBody *, const uint8_t *, uint32_t);
+int HtpBodyAppendStreamChunk(const HTPCfgDir *, HtpBody *, StreamingBuffer *,
+        const uint8_t *, uint32_t);
+int HtpBodyGetDataAtOffset(const HtpBody *, const uint8_t **, uint32_t *, uint64_t);
+int HtpBodyGetData(const HtpBody *, const uint8_t **, uint32_t *, uint64_t *);
+void HtpBodyChunkGetData(const HtpBody *, const HtpBodyChunk *,
+        const uint8_t **, uint32_t *);
 void HtpBodyPrint(HtpBody *);
 void HtpBodyFree(HtpBody *);
 void HtpBodyPrune(HtpState *, HtpBody *, int);
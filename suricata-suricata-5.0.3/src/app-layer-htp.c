@@ -1256,6 +1256,23 @@ static void HtpRequestBodyMultipartParseHeader(HtpState *hstate,
     *filetype_len = ft_len;
 }
 
+/**
+ *  \internal
+ *  \brief Get the TCP stream buffer the parser is fed from in a direction
+ *
+ *  Body data that libhtp passes on unmodified points into this buffer,
+ *  so the body can reference it instead of copying it.
+ */
+static StreamingBuffer *HtpGetStreamBuffer(const HtpState *hstate, int direction)
+{
+    const Flow *f = hstate->f;
+    if (f == NULL || f->proto != IPPROTO_TCP || f->protoctx == NULL)
+        return NULL;
+
+    TcpSession *ssn = (TcpSession *)f->protoctx;
+    return (direction == STREAM_TOSERVER) ? &ssn->client.sb : &ssn->server.sb;
+}
+
 /**
  *  \brief Create a single buffer from the HtpBodyChunks in our list
  *
@@ -1266,7 +1283,7 @@ static void HtpRequestBodyMultipartParseHeader(HtpState *hstate,
 static void HtpRequestBodyReassemble(HtpTxUserData *htud,
         const uint8_t **chunks_buffer, uint32_t *chunks_buffer_len)
 {
-    StreamingBufferGetDataAtOffset(htud->request_body.sb,
+    HtpBodyGetDataAtOffset(&htud->request_body,
             chunks_buffer, chunks_buffer_len,
             htud->request_body.body_parsed);
 }
@@ -1883,7 +1900,8 @@ static int HTPCallbackRequestBodyData(htp_tx_data_t *d)
                                                      (uint32_t)d->len);
         BUG_ON(len > (uint32_t)d->len);
 
-        HtpBodyAppendChunk(&hstate->cfg->request, &tx_ud->request_body, d->data, len);
+        HtpBodyAppendStreamChunk(&hstate->cfg->request, &tx_ud->request_body,
+                HtpGetStreamBuffer(hstate, STREAM_TOSERVER), d->data, len);
 
         const uint8_t *chunks_buffer = NULL;
         uint32_t chunks_buffer_len = 0;
@@ -2004,7 +2022,8 @@ static int HTPCallbackResponseBodyData(htp_tx_data_t *d)
                                                      (uint32_t)d->len);
         BUG_ON(len > (uint32_t)d->len);
 
-        HtpBodyAppendChunk(&hstate->cfg->response, &tx_ud->response_body, d->data, len);
+        HtpBodyAppendStreamChunk(&hstate->cfg->response, &tx_ud->response_body,
+                HtpGetStreamBuffer(hstate, STREAM_TOCLIENT), d->data, len);
 
         HtpResponseBodyHandle(hstate, tx_ud, d->tx, (uint8_t *)d->data, (uint32_t)d->len);
     } else {
@@ -6117,6 +6136,88 @@ end:
     return result;
 }
 
+/** \test body data in the stream is referenced until the stream slides */
+static int HTPBodyReassemblyTest02(void)
+{
+    StreamingBufferConfig sbcfg = { 0, 0, 64, NULL, NULL, NULL, NULL };
+    StreamingBuffer *stream = StreamingBufferInit(&sbcfg);
+    FAIL_IF_NULL(stream);
+    const uint8_t req[] = "POST / HTTP/1.1\r\nContent-Length: 15\r\n\r\nbody1body2body3";
+    const uint32_t hdr_len = sizeof(req) - 1 - 15;
+    StreamingBufferSegment seg;
+    FAIL_IF(StreamingBufferAppend(stream, &seg, req, sizeof(req) - 1) != 0);
+
+    HTPCfgRec cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.request.inspect_min_size = 4;
+    cfg.request.inspect_window = 4;
+    HtpState hstate;
+    memset(&hstate, 0, sizeof(hstate));
+    hstate.cfg = &cfg;
+    HtpBody body;
+    memset(&body, 0, sizeof(body));
+
+    const uint8_t *data = NULL;
+    uint32_t data_len = 0;
+    FAIL_IF_NOT(StreamingBufferGetDataAtOffset(stream, &data, &data_len, hdr_len));
+    FAIL_IF(HtpBodyAppendStreamChunk(NULL, &body, stream, data, 5) != 0);
+    FAIL_IF(HtpBodyAppendStreamChunk(NULL, &body, stream, data + 5, 5) != 0);
+    FAIL_IF(body.view.sb != stream);
+    FAIL_IF(body.sb != NULL);
+    FAIL_IF(body.content_len_so_far != 10);
+
+    FAIL_IF_NOT(HtpBodyGetDataAtOffset(&body, &data, &data_len, 0));
+    FAIL_IF(data_len != 10 || memcmp(data, "body1body2", 10) != 0);
+    HtpBodyChunkGetData(&body, body.last, &data, &data_len);
+    FAIL_IF(data_len != 5 || memcmp(data, "body2", 5) != 0);
+
+    /* inspected: prune to the window, the first chunk goes */
+    body.body_parsed = body.body_inspected = 10;
+    HtpBodyPrune(&hstate, &body, STREAM_TOSERVER);
+    FAIL_IF(body.first != body.last);
+    FAIL_IF(body.view.sb != stream || body.view.len != 4);
+    HtpBodyChunkGetData(&body, body.first, &data, &data_len);
+    FAIL_IF(data_len != 4 || memcmp(data, "ody2", 4) != 0);
+
+    /* stream slides past the body: what is left is copied */
+    StreamingBufferSlideToOffset(stream, hdr_len + 12);
+    FAIL_IF(body.view.sb != NULL);
+    FAIL_IF(body.sb == NULL || body.sb->stream_offset != 6);
+    FAIL_IF_NOT(HtpBodyGetDataAtOffset(&body, &data, &data_len, 6));
+    FAIL_IF(data_len != 4 || memcmp(data, "ody2", 4) != 0);
+
+    /* from here on the body copies */
+    FAIL_IF_NOT(StreamingBufferGetDataAtOffset(stream, &data, &data_len, hdr_len + 12));
+    FAIL_IF(HtpBodyAppendStreamChunk(NULL, &body, stream, data, 3) != 0);
+    FAIL_IF(body.view.sb != NULL);
+    FAIL_IF_NOT(HtpBodyGetDataAtOffset(&body, &data, &data_len, 6));
+    FAIL_IF(data_len != 7 || memcmp(data, "ody2dy3", 7) != 0);
+    HtpBodyFree(&body);
+
+    /* data not contiguous in the stream switches to copying */
+    memset(&body, 0, sizeof(body));
+    FAIL_IF_NOT(StreamingBufferGetDataAtOffset(stream, &data, &data_len, hdr_len + 12));
+    FAIL_IF(HtpBodyAppendStreamChunk(NULL, &body, stream, data, 1) != 0);
+    FAIL_IF(body.view.sb != stream);
+    FAIL_IF(HtpBodyAppendStreamChunk(NULL, &body, stream, data + 2, 1) != 0);
+    FAIL_IF(body.view.sb != NULL);
+    FAIL_IF(stream->views != NULL);
+    FAIL_IF_NOT(HtpBodyGetDataAtOffset(&body, &data, &data_len, 0));
+    FAIL_IF(data_len != 2 || memcmp(data, "d3", 2) != 0);
+    HtpBodyFree(&body);
+
+    /* body freed first: the stream forgets the view */
+    memset(&body, 0, sizeof(body));
+    FAIL_IF_NOT(StreamingBufferGetDataAtOffset(stream, &data, &data_len, hdr_len + 12));
+    FAIL_IF(HtpBodyAppendStreamChunk(NULL, &body, stream, data, 3) != 0);
+    FAIL_IF(stream->views != &body.view);
+    HtpBodyFree(&body);
+    FAIL_IF(stream->views != NULL);
+
+    StreamingBufferFree(stream);
+    PASS;
+}
+
 /** \test BG crash */
 static int HTPSegvTest01(void)
 {
@@ -7471,6 +7572,7 @@ void HTPParserRegisterTests(void)
     UtRegisterTest("HTPParserDecodingTest09", HTPParserDecodingTest09);
 
     UtRegisterTest("HTPBodyReassemblyTest01", HTPBodyReassemblyTest01);
+    UtRegisterTest("HTPBodyReassemblyTest02", HTPBodyReassemblyTest02);
 
     UtRegisterTest("HTPSegvTest01", HTPSegvTest01);
 
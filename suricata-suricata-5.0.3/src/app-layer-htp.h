@@ -183,6 +183,10 @@ typedef struct HtpBody_ {
     HtpBodyChunk *last;  /**< Pointer to the last chunk */
 
     StreamingBuffer *sb;
+    /** body data still in the TCP stream, see HtpBodyAppendStreamChunk.
+     *  sb is NULL while the view is used. */
+    StreamingBufferView view;
+    const StreamingBufferConfig *view_sbcfg;
 
     /* Holds the length of the htp request body seen so far */
     uint64_t content_len_so_far;
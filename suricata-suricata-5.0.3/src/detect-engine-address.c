@@ -43,6 +43,7 @@
 #include "util-debug.h"
 #include "util-print.h"
 #include "util-var.h"
+#include "util-hash-lookup3.h"
 
 /* prototypes */
 #ifdef DEBUG
@@ -1580,10 +1581,234 @@ int DetectAddressCmp(DetectAddress *a, DetectAddress *b)
     return ADDRESS_ER;
 }
 
+/** address match arrays with at least this many ranges are searched with
+ *  a binary search and shared between signatures */
+#define ADDRESS_MATCH_BSEARCH_MIN   8
+
+/** shared address match array, refcounted as signatures are freed
+ *  independently of each other and of their detect engine */
+typedef struct AddressMatchShared_ {
+    struct AddressMatchShared_ *next;
+    uint32_t hash;
+    uint32_t refcnt;
+    uint32_t size;          /**< size of data in bytes */
+    uint8_t data[];
+} AddressMatchShared;
+
+#define ADDRESS_MATCH_SHARED_HASH_SIZE 1024
+
+static AddressMatchShared *address_match_shared[ADDRESS_MATCH_SHARED_HASH_SIZE];
+static SCMutex address_match_shared_lock = SCMUTEX_INITIALIZER;
+
+/** \internal
+ *  \brief get the shared copy of an address match array
+ *
+ *  \param data SCMalloc'd array, freed if a shared copy exists already
+ *
+ *  \retval ptr shared array or NULL on error, in which case data is freed
+ */
+static void *AddressMatchShare(void *data, uint32_t size)
+{
+    const uint32_t hash = hashlittle_safe(data, size, 0);
+    const uint32_t idx = hash % ADDRESS_MATCH_SHARED_HASH_SIZE;
+
+    SCMutexLock(&address_match_shared_lock);
+    for (AddressMatchShared *sh = address_match_shared[idx]; sh != NULL; sh = sh->next) {
+        if (sh->hash == hash && sh->size == size &&
+                memcmp(sh->data, data, size) == 0) {
+            sh->refcnt++;
+            SCMutexUnlock(&address_match_shared_lock);
+            SCFree(data);
+            return sh->data;
+        }
+    }
+
+    AddressMatchShared *sh = SCMalloc(sizeof(*sh) + size);
+    if (sh == NULL) {
+        SCMutexUnlock(&address_match_shared_lock);
+        SCFree(data);
+        return NULL;
+    }
+    sh->hash = hash;
+    sh->refcnt = 1;
+    sh->size = size;
+    memcpy(sh->data, data, size);
+    sh->next = address_match_shared[idx];
+    address_match_shared[idx] = sh;
+    SCMutexUnlock(&address_match_shared_lock);
+
+    SCFree(data);
+    return sh->data;
+}
+
+static void AddressMatchRelease(void *data)
+{
+    AddressMatchShared *sh = (AddressMatchShared *)
+        ((uint8_t *)data - offsetof(AddressMatchShared, data));
+    const uint32_t idx = sh->hash % ADDRESS_MATCH_SHARED_HASH_SIZE;
+
+    SCMutexLock(&address_match_shared_lock);
+    if (--sh->refcnt > 0) {
+        SCMutexUnlock(&address_match_shared_lock);
+        return;
+    }
+    AddressMatchShared **prev = &address_match_shared[idx];
+    while (*prev != sh)
+        prev = &(*prev)->next;
+    *prev = sh->next;
+    SCMutexUnlock(&address_match_shared_lock);
+
+    SCFree(sh);
+}
+
+static int AddressMatchIPv4Cmp(const void *a, const void *b)
+{
+    const DetectMatchAddressIPv4 *x = a;
+    const DetectMatchAddressIPv4 *y = b;
+    return x->ip < y->ip ? -1 : (x->ip > y->ip);
+}
+
+static int AddressIPv6Cmp(const uint32_t *a, const uint32_t *b)
+{
+    for (int i = 0; i < 4; i++) {
+        if (a[i] < b[i])
+            return -1;
+        if (a[i] > b[i])
+            return 1;
+    }
+    return 0;
+}
+
+static int AddressMatchIPv6Cmp(const void *a, const void *b)
+{
+    const DetectMatchAddressIPv6 *x = a;
+    const DetectMatchAddressIPv6 *y = b;
+    return AddressIPv6Cmp(x->ip, y->ip);
+}
+
+/** \internal
+ *  \brief check if an IPv6 range starting at 'ip' can be merged into a range
+ *         ending at 'ip2', so if ip <= ip2 + 1
+ */
+static bool AddressIPv6Adjacent(const uint32_t *ip2, const uint32_t *ip)
+{
+    if (AddressIPv6Cmp(ip, ip2) <= 0)
+        return true;
+
+    /* ip2 + 1 */
+    uint32_t next[4];
+    uint32_t carry = 1;
+    for (int i = 3; i >= 0; i--) {
+        next[i] = ip2[i] + carry;
+        carry = (carry && next[i] == 0);
+    }
+    if (carry)
+        return true;
+    return AddressIPv6Cmp(ip, next) == 0;
+}
+
+/**
+ *  \brief Prepare an address match array for DetectAddressMatchIPv4
+ *
+ *  Sorts the array and merges overlapping and adjacent ranges. Large
+ *  arrays are replaced by a copy that is shared between all signatures
+ *  using the same addresses.
+ *
+ *  \param addrs SCMalloc'd array, may be replaced
+ *  \param addrs_cnt array size in members
+ *
+ *  \retval cnt new array size, 0 on error
+ */
+uint16_t DetectAddressMatchIPv4Prepare(DetectMatchAddressIPv4 **addrs,
+        uint16_t addrs_cnt)
+{
+    DetectMatchAddressIPv4 *a = *addrs;
+    if (a == NULL || addrs_cnt == 0)
+        return 0;
+
+    qsort(a, addrs_cnt, sizeof(*a), AddressMatchIPv4Cmp);
+    uint16_t cnt = 1;
+    for (uint16_t i = 1; i < addrs_cnt; i++) {
+        DetectMatchAddressIPv4 *last = &a[cnt - 1];
+        if (last->ip2 == UINT32_MAX || a[i].ip <= last->ip2 + 1) {
+            if (a[i].ip2 > last->ip2)
+                last->ip2 = a[i].ip2;
+        } else {
+            a[cnt++] = a[i];
+        }
+    }
+
+    if (cnt >= ADDRESS_MATCH_BSEARCH_MIN) {
+        *addrs = AddressMatchShare(a, cnt * sizeof(*a));
+        if (*addrs == NULL)
+            return 0;
+    }
+    return cnt;
+}
+
+/**
+ *  \brief Prepare an address match array for DetectAddressMatchIPv6
+ *
+ *  \see DetectAddressMatchIPv4Prepare
+ */
+uint16_t DetectAddressMatchIPv6Prepare(DetectMatchAddressIPv6 **addrs,
+        uint16_t addrs_cnt)
+{
+    DetectMatchAddressIPv6 *a = *addrs;
+    if (a == NULL || addrs_cnt == 0)
+        return 0;
+
+    qsort(a, addrs_cnt, sizeof(*a), AddressMatchIPv6Cmp);
+    uint16_t cnt = 1;
+    for (uint16_t i = 1; i < addrs_cnt; i++) {
+        DetectMatchAddressIPv6 *last = &a[cnt - 1];
+        if (AddressIPv6Adjacent(last->ip2, a[i].ip)) {
+            if (AddressIPv6Cmp(a[i].ip2, last->ip2) > 0)
+                memcpy(last->ip2, a[i].ip2, sizeof(last->ip2));
+        } else {
+            a[cnt++] = a[i];
+        }
+    }
+
+    if (cnt >= ADDRESS_MATCH_BSEARCH_MIN) {
+        *addrs = AddressMatchShare(a, cnt * sizeof(*a));
+        if (*addrs == NULL)
+            return 0;
+    }
+    return cnt;
+}
+
+/**
+ *  \brief Free an array set up by DetectAddressMatchIPv4Prepare
+ */
+void DetectAddressMatchIPv4Free(DetectMatchAddressIPv4 *addrs, uint16_t addrs_cnt)
+{
+    if (addrs == NULL)
+        return;
+    if (addrs_cnt >= ADDRESS_MATCH_BSEARCH_MIN)
+        AddressMatchRelease(addrs);
+    else
+        SCFree(addrs);
+}
+
+/**
+ *  \brief Free an array set up by DetectAddressMatchIPv6Prepare
+ */
+void DetectAddressMatchIPv6Free(DetectMatchAddressIPv6 *addrs, uint16_t addrs_cnt)
+{
+    if (addrs == NULL)
+        return;
+    if (addrs_cnt >= ADDRESS_MATCH_BSEARCH_MIN)
+        AddressMatchRelease(addrs);
+    else
+        SCFree(addrs);
+}
+
 /**
  *  \brief Match a packets address against a signatures addrs array
  *
- *  \param addrs array of DetectMatchAddressIPv4's
+ *  \param addrs sorted array of DetectMatchAddressIPv4's without overlap,
+ *               see DetectAddressMatchIPv4Prepare
  *  \param addrs_cnt array size in members
  *  \param a packets address
  *
@@ -1591,8 +1816,6 @@ int DetectAddressCmp(DetectAddress *a, DetectAddress *b)
  *  \retval 1 match
  *
  *  \note addresses in addrs are in host order
- *
- *  \todo array should be ordered, so we can break out of the loop
  */
 int DetectAddressMatchIPv4(const DetectMatchAddressIPv4 *addrs,
         uint16_t addrs_cnt, const Address *a)
@@ -1603,13 +1826,29 @@ int DetectAddressMatchIPv4(const DetectMatchAddressIPv4 *addrs,
         SCReturnInt(0);
     }
 
-    for (uint16_t idx = 0; idx < addrs_cnt; idx++) {
-        if (SCNtohl(a->addr_data32[0]) >= addrs[idx].ip &&
-            SCNtohl(a->addr_data32[0]) <= addrs[idx].ip2)
-        {
-            SCReturnInt(1);
+    const uint32_t ip = SCNtohl(a->addr_data32[0]);
+
+    if (addrs_cnt < ADDRESS_MATCH_BSEARCH_MIN) {
+        for (uint16_t idx = 0; idx < addrs_cnt; idx++) {
+            if (ip < addrs[idx].ip)
+                break;
+            if (ip <= addrs[idx].ip2)
+                SCReturnInt(1);
         }
+        SCReturnInt(0);
+    }
+
+    /* find the last range starting at or before ip */
+    uint32_t lo = 0, hi = addrs_cnt;
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        if (addrs[mid].ip <= ip)
+            lo = mid + 1;
+        else
+            hi = mid;
     }
+    if (lo > 0 && ip <= addrs[lo - 1].ip2)
+        SCReturnInt(1);
 
     SCReturnInt(0);
 }
@@ -1617,7 +1856,8 @@ int DetectAddressMatchIPv4(const DetectMatchAddressIPv4 *addrs,
 /**
  *  \brief Match a packets address against a signatures addrs array
  *
- *  \param addrs array of DetectMatchAddressIPv6's
+ *  \param addrs sorted array of DetectMatchAddressIPv6's without overlap,
+ *               see DetectAddressMatchIPv6Prepare
  *  \param addrs_cnt array size in members
  *  \param a packets address
  *
@@ -1625,8 +1865,6 @@ int DetectAddressMatchIPv4(const DetectMatchAddressIPv4 *addrs,
  *  \retval 1 match
  *
  *  \note addresses in addrs are in host order
- *
- *  \todo array should be ordered, so we can break out of the loop
  */
 int DetectAddressMatchIPv6(const DetectMatchAddressIPv6 *addrs,
         uint16_t addrs_cnt, const Address *a)
@@ -1637,66 +1875,31 @@ int DetectAddressMatchIPv6(const DetectMatchAddressIPv6 *addrs,
         SCReturnInt(0);
     }
 
-    /* See if the packet address is within the range of any entry in the
-     * signature's address match array.
-     */
-    for (uint16_t idx = 0; idx < addrs_cnt; idx++) {
-        uint16_t result1 = 0, result2 = 0;
-
-        /* See if packet address equals either limit. Return 1 if true. */
-        if (SCNtohl(a->addr_data32[0]) == addrs[idx].ip[0] &&
-            SCNtohl(a->addr_data32[1]) == addrs[idx].ip[1] &&
-            SCNtohl(a->addr_data32[2]) == addrs[idx].ip[2] &&
-            SCNtohl(a->addr_data32[3]) == addrs[idx].ip[3])
-        {
-            SCReturnInt(1);
-        }
-        if (SCNtohl(a->addr_data32[0]) == addrs[idx].ip2[0] &&
-            SCNtohl(a->addr_data32[1]) == addrs[idx].ip2[1] &&
-            SCNtohl(a->addr_data32[2]) == addrs[idx].ip2[2] &&
-            SCNtohl(a->addr_data32[3]) == addrs[idx].ip2[3])
-        {
-            SCReturnInt(1);
-        }
-
-        /* See if packet address is greater than lower limit
-         * of the current signature address match pair.
-         */
-        for (int i = 0; i < 4; i++) {
-            if (SCNtohl(a->addr_data32[i]) > addrs[idx].ip[i]) {
-                result1 = 1;
-                break;
-            }
-            if (SCNtohl(a->addr_data32[i]) < addrs[idx].ip[i]) {
-                result1 = 0;
-                break;
-            }
-        }
-
-        /* If not greater than lower limit, try next address match entry */
-        if (result1 == 0)
-            continue;
+    const uint32_t ip[4] = {
+        SCNtohl(a->addr_data32[0]), SCNtohl(a->addr_data32[1]),
+        SCNtohl(a->addr_data32[2]), SCNtohl(a->addr_data32[3]),
+    };
 
-        /* See if packet address is less than upper limit
-         * of the current signature address match pair.
-         */
-        for (int i = 0; i < 4; i++) {
-            if (SCNtohl(a->addr_data32[i]) < addrs[idx].ip2[i]) {
-                result2 = 1;
-                break;
-            }
-            if (SCNtohl(a->addr_data32[i]) > addrs[idx].ip2[i]) {
-                result2 = 0;
+    if (addrs_cnt < ADDRESS_MATCH_BSEARCH_MIN) {
+        for (uint16_t idx = 0; idx < addrs_cnt; idx++) {
+            if (AddressIPv6Cmp(ip, addrs[idx].ip) < 0)
                 break;
-            }
+            if (AddressIPv6Cmp(ip, addrs[idx].ip2) <= 0)
+                SCReturnInt(1);
         }
+        SCReturnInt(0);
+    }
 
-        /* Return a match if packet address is between the two
-         * signature address match limits.
-         */
-        if (result1 == 1 && result2 == 1)
-            SCReturnInt(1);
+    uint32_t lo = 0, hi = addrs_cnt;
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        if (AddressIPv6Cmp(addrs[mid].ip, ip) <= 0)
+            lo = mid + 1;
+        else
+            hi = mid;
     }
+    if (lo > 0 && AddressIPv6Cmp(ip, addrs[lo - 1].ip2) <= 0)
+        SCReturnInt(1);
 
     SCReturnInt(0);
 }
@@ -4827,6 +5030,242 @@ static int AddressConfVarsTest05(void)
     return result;
 }
 
+static int AddressMatchTestBuild4(DetectMatchAddressIPv4 **addrs, const char *str)
+{
+    DetectAddressHead *gh = DetectAddressHeadInit();
+    if (gh == NULL)
+        return 0;
+    if (DetectAddressParse(NULL, gh, str) < 0) {
+        DetectAddressHeadFree(gh);
+        return 0;
+    }
+    uint16_t cnt = 0;
+    for (DetectAddress *da = gh->ipv4_head; da != NULL; da = da->next)
+        cnt++;
+    *addrs = SCMalloc(cnt * sizeof(DetectMatchAddressIPv4));
+    if (*addrs == NULL) {
+        DetectAddressHeadFree(gh);
+        return 0;
+    }
+    uint16_t idx = 0;
+    for (DetectAddress *da = gh->ipv4_head; da != NULL; da = da->next) {
+        (*addrs)[idx].ip = SCNtohl(da->ip.addr_data32[0]);
+        (*addrs)[idx].ip2 = SCNtohl(da->ip2.addr_data32[0]);
+        idx++;
+    }
+    DetectAddressHeadFree(gh);
+    return DetectAddressMatchIPv4Prepare(addrs, cnt);
+}
+
+static int AddressMatchTestIPv4(const DetectMatchAddressIPv4 *addrs,
+        uint16_t cnt, const char *str)
+{
+    Address a;
+    memset(&a, 0, sizeof(a));
+    a.family = AF_INET;
+    if (inet_pton(AF_INET, str, &a.addr_data32[0]) != 1)
+        return -1;
+    return DetectAddressMatchIPv4(addrs, cnt, &a);
+}
+
+/** \test small arrays are merged and scanned in order */
+static int AddressMatchTest01(void)
+{
+    DetectMatchAddressIPv4 *addrs = SCMalloc(4 * sizeof(*addrs));
+    FAIL_IF_NULL(addrs);
+    /* unsorted, overlapping and adjacent ranges */
+    addrs[0].ip = 100; addrs[0].ip2 = 200;
+    addrs[1].ip = 10;  addrs[1].ip2 = 20;
+    addrs[2].ip = 150; addrs[2].ip2 = 300;
+    addrs[3].ip = 21;  addrs[3].ip2 = 30;
+    uint16_t cnt = DetectAddressMatchIPv4Prepare(&addrs, 4);
+    FAIL_IF_NOT(cnt == 2);
+    FAIL_IF_NOT(addrs[0].ip == 10 && addrs[0].ip2 == 30);
+    FAIL_IF_NOT(addrs[1].ip == 100 && addrs[1].ip2 == 300);
+
+    FAIL_IF_NOT(AddressMatchTestIPv4(addrs, cnt, "0.0.0.25") == 1);
+    FAIL_IF_NOT(AddressMatchTestIPv4(addrs, cnt, "0.0.1.44") == 1);
+    FAIL_IF_NOT(AddressMatchTestIPv4(addrs, cnt, "0.0.0.50") == 0);
+    FAIL_IF_NOT(AddressMatchTestIPv4(addrs, cnt, "0.0.1.45") == 0);
+
+    DetectAddressMatchIPv4Free(addrs, cnt);
+    PASS;
+}
+
+/** \test large arrays are binary searched and shared */
+static int AddressMatchTest02(void)
+{
+    const char *str = "[1.1.1.0/24,2.2.2.2,3.3.3.3,4.4.4.4,5.5.5.5,"
+        "6.6.6.6,7.7.7.7,8.8.8.8,9.9.9.9,10.0.0.0/8,255.255.255.255]";
+    DetectMatchAddressIPv4 *addrs1 = NULL;
+    DetectMatchAddressIPv4 *addrs2 = NULL;
+    uint16_t cnt1 = AddressMatchTestBuild4(&addrs1, str);
+    uint16_t cnt2 = AddressMatchTestBuild4(&addrs2, str);
+    FAIL_IF_NOT(cnt1 == 11);
+    FAIL_IF_NOT(cnt2 == 11);
+    FAIL_IF_NOT(addrs1 == addrs2);
+
+    FAIL_IF_NOT(AddressMatchTestIPv4(addrs1, cnt1, "1.1.1.200") == 1);
+    FAIL_IF_NOT(AddressMatchTestIPv4(addrs1, cnt1, "5.5.5.5") == 1);
+    FAIL_IF_NOT(AddressMatchTestIPv4(addrs1, cnt1, "10.20.30.40") == 1);
+    FAIL_IF_NOT(AddressMatchTestIPv4(addrs1, cnt1, "255.255.255.255") == 1);
+    FAIL_IF_NOT(AddressMatchTestIPv4(addrs1, cnt1, "0.0.0.0") == 0);
+    FAIL_IF_NOT(AddressMatchTestIPv4(addrs1, cnt1, "5.5.5.6") == 0);
+    FAIL_IF_NOT(AddressMatchTestIPv4(addrs1, cnt1, "11.0.0.0") == 0);
+
+    DetectAddressMatchIPv4Free(addrs1, cnt1);
+    /* still usable through the second reference */
+    FAIL_IF_NOT(AddressMatchTestIPv4(addrs2, cnt2, "9.9.9.9") == 1);
+    DetectAddressMatchIPv4Free(addrs2, cnt2);
+    PASS;
+}
+
+/** \test IPv6 ranges */
+static int AddressMatchTest03(void)
+{
+    const uint32_t n = ADDRESS_MATCH_BSEARCH_MIN + 1;
+    DetectMatchAddressIPv6 *addrs = SCCalloc(n + 1, sizeof(*addrs));
+    FAIL_IF_NULL(addrs);
+    /* 2001:db8::X:0 - 2001:db8::X:ffff for X = 2, 4, ... in reverse order */
+    for (uint32_t i = 0; i < n; i++) {
+        const uint32_t x = (n - i) * 2;
+        addrs[i].ip[0] = addrs[i].ip2[0] = 0x20010db8;
+        addrs[i].ip[3] = x << 16;
+        addrs[i].ip2[3] = (x << 16) | 0xffff;
+    }
+    /* X = 3 joins the ranges of 2 and 4 */
+    addrs[n].ip[0] = addrs[n].ip2[0] = 0x20010db8;
+    addrs[n].ip[3] = 3 << 16;
+    addrs[n].ip2[3] = (3 << 16) | 0xffff;
+
+    uint16_t cnt = DetectAddressMatchIPv6Prepare(&addrs, n + 1);
+    FAIL_IF_NOT(cnt == ADDRESS_MATCH_BSEARCH_MIN);
+    FAIL_IF_NOT(addrs[0].ip[3] == 2 << 16);
+    FAIL_IF_NOT(addrs[0].ip2[3] == ((4 << 16) | 0xffff));
+
+    Address a;
+    memset(&a, 0, sizeof(a));
+    a.family = AF_INET6;
+    FAIL_IF_NOT(inet_pton(AF_INET6, "2001:db8::3:1234", &a.addr_data32[0]) == 1);
+    FAIL_IF_NOT(DetectAddressMatchIPv6(addrs, cnt, &a) == 1);
+    FAIL_IF_NOT(inet_pton(AF_INET6, "2001:db8::10:ffff", &a.addr_data32[0]) == 1);
+    FAIL_IF_NOT(DetectAddressMatchIPv6(addrs, cnt, &a) == 1);
+    FAIL_IF_NOT(inet_pton(AF_INET6, "2001:db8::5:0", &a.addr_data32[0]) == 1);
+    FAIL_IF_NOT(DetectAddressMatchIPv6(addrs, cnt, &a) == 0);
+    FAIL_IF_NOT(inet_pton(AF_INET6, "2001:db8::1:ffff", &a.addr_data32[0]) == 1);
+    FAIL_IF_NOT(DetectAddressMatchIPv6(addrs, cnt, &a) == 0);
+
+    DetectAddressMatchIPv6Free(addrs, cnt);
+    PASS;
+}
+
+static int AddressMatchTestSet6(DetectMatchAddressIPv6 *m,
+        const char *start, const char *end)
+{
+    uint32_t ip[4], ip2[4];
+    if (inet_pton(AF_INET6, start, ip) != 1 || inet_pton(AF_INET6, end, ip2) != 1)
+        return -1;
+    for (int i = 0; i < 4; i++) {
+        m->ip[i] = SCNtohl(ip[i]);
+        m->ip2[i] = SCNtohl(ip2[i]);
+    }
+    return 0;
+}
+
+static uint16_t AddressMatchTestBuild6(DetectMatchAddressIPv6 **addrs)
+{
+    /* unsorted, with ranges inside, overlapping or adjacent to others */
+    static const char *ranges[][2] = {
+        { "2001:db8::", "2001:db8:ffff:ffff:ffff:ffff:ffff:ffff" },
+        { "ff02::1", "ff02::1" },
+        { "2001:db8:1::", "2001:db8:1:ffff:ffff:ffff:ffff:ffff" },
+        { "2001:dc0::8", "2001:dc0::20" },
+        { "fe80::", "fe80::ffff:ffff:ffff:ffff" },
+        { "ffff:ffff:ffff:ffff:ffff:ffff:ffff:0",
+          "ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff" },
+        { "2001:db9::", "2001:db9::ffff" },
+        { "::1", "::1" },
+        { "2001:dc0::1", "2001:dc0::10" },
+        { "3000::", "3000::ff" },
+        { "ff02::2", "ff02::2" },
+        { "fc00::", "fdff:ffff:ffff:ffff:ffff:ffff:ffff:ffff" },
+        { "2002::", "2002:ffff:ffff:ffff:ffff:ffff:ffff:ffff" },
+        { "ffff:ffff:ffff:ffff:ffff:ffff:ffff:fff0",
+          "ffff:ffff:ffff:ffff:ffff:ffff:ffff:fff8" },
+    };
+    const uint16_t n = ARRAY_SIZE(ranges);
+
+    *addrs = SCCalloc(n, sizeof(DetectMatchAddressIPv6));
+    if (*addrs == NULL)
+        return 0;
+    for (uint16_t i = 0; i < n; i++) {
+        if (AddressMatchTestSet6(&(*addrs)[i], ranges[i][0], ranges[i][1]) < 0) {
+            SCFree(*addrs);
+            return 0;
+        }
+    }
+    return DetectAddressMatchIPv6Prepare(addrs, n);
+}
+
+static int AddressMatchTestIPv6(const DetectMatchAddressIPv6 *addrs,
+        uint16_t cnt, const char *str)
+{
+    Address a;
+    memset(&a, 0, sizeof(a));
+    a.family = AF_INET6;
+    if (inet_pton(AF_INET6, str, &a.addr_data32[0]) != 1)
+        return -1;
+    return DetectAddressMatchIPv6(addrs, cnt, &a);
+}
+
+/** \test large IPv6 arrays are merged across words, binary searched and
+ *        shared */
+static int AddressMatchTest04(void)
+{
+    DetectMatchAddressIPv6 *addrs1 = NULL;
+    DetectMatchAddressIPv6 *addrs2 = NULL;
+    uint16_t cnt1 = AddressMatchTestBuild6(&addrs1);
+    uint16_t cnt2 = AddressMatchTestBuild6(&addrs2);
+    FAIL_IF_NOT(cnt1 == 9);
+    FAIL_IF_NOT(cnt2 == 9);
+    FAIL_IF_NOT(addrs1 == addrs2);
+
+    /* sorted, 2001:db8::/32 grew into the adjacent 2001:db9:: range */
+    DetectMatchAddressIPv6 m;
+    FAIL_IF(AddressMatchTestSet6(&m, "::1", "2001:db9::ffff") < 0);
+    FAIL_IF_NOT(memcmp(addrs1[0].ip, m.ip, sizeof(m.ip)) == 0);
+    FAIL_IF_NOT(memcmp(addrs1[1].ip2, m.ip2, sizeof(m.ip2)) == 0);
+    FAIL_IF(AddressMatchTestSet6(&m, "ffff:ffff:ffff:ffff:ffff:ffff:ffff:0",
+                "ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff") < 0);
+    FAIL_IF_NOT(memcmp(&addrs1[8], &m, sizeof(m)) == 0);
+    for (uint16_t i = 1; i < cnt1; i++) {
+        FAIL_IF_NOT(AddressIPv6Cmp(addrs1[i - 1].ip2, addrs1[i].ip) < 0);
+    }
+
+    FAIL_IF_NOT(AddressMatchTestIPv6(addrs1, cnt1, "::1") == 1);
+    FAIL_IF_NOT(AddressMatchTestIPv6(addrs1, cnt1, "2001:db8:1::5") == 1);
+    FAIL_IF_NOT(AddressMatchTestIPv6(addrs1, cnt1, "2001:db9::ffff") == 1);
+    FAIL_IF_NOT(AddressMatchTestIPv6(addrs1, cnt1, "2001:dc0::15") == 1);
+    FAIL_IF_NOT(AddressMatchTestIPv6(addrs1, cnt1, "fd12::1") == 1);
+    FAIL_IF_NOT(AddressMatchTestIPv6(addrs1, cnt1, "fe80::1") == 1);
+    FAIL_IF_NOT(AddressMatchTestIPv6(addrs1, cnt1, "ff02::2") == 1);
+    FAIL_IF_NOT(AddressMatchTestIPv6(addrs1, cnt1,
+                "ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff") == 1);
+    FAIL_IF_NOT(AddressMatchTestIPv6(addrs1, cnt1, "::") == 0);
+    FAIL_IF_NOT(AddressMatchTestIPv6(addrs1, cnt1, "1::") == 0);
+    FAIL_IF_NOT(AddressMatchTestIPv6(addrs1, cnt1, "2001:db9::1:0") == 0);
+    FAIL_IF_NOT(AddressMatchTestIPv6(addrs1, cnt1, "2001:dc0::") == 0);
+    FAIL_IF_NOT(AddressMatchTestIPv6(addrs1, cnt1, "2001:dc0::21") == 0);
+    FAIL_IF_NOT(AddressMatchTestIPv6(addrs1, cnt1, "fe81::") == 0);
+    FAIL_IF_NOT(AddressMatchTestIPv6(addrs1, cnt1, "ff02::3") == 0);
+
+    DetectAddressMatchIPv6Free(addrs1, cnt1);
+    /* still usable through the second reference */
+    FAIL_IF_NOT(AddressMatchTestIPv6(addrs2, cnt2, "3000::80") == 1);
+    DetectAddressMatchIPv6Free(addrs2, cnt2);
+    PASS;
+}
+
 #endif /* UNITTESTS */
 
 void DetectAddressTests(void)
@@ -5029,5 +5468,10 @@ void DetectAddressTests(void)
     UtRegisterTest("AddressConfVarsTest03 ", AddressConfVarsTest03);
     UtRegisterTest("AddressConfVarsTest04 ", AddressConfVarsTest04);
     UtRegisterTest("AddressConfVarsTest05 ", AddressConfVarsTest05);
+
+    UtRegisterTest("AddressMatchTest01", AddressMatchTest01);
+    UtRegisterTest("AddressMatchTest02", AddressMatchTest02);
+    UtRegisterTest("AddressMatchTest03", AddressMatchTest03);
+    UtRegisterTest("AddressMatchTest04", AddressMatchTest04);
 #endif /* UNITTESTS */
 }
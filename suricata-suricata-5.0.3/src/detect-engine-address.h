@@ -37,6 +37,11 @@ DetectAddress *DetectAddressLookupInHead(const DetectAddressHead *, Address *);
 
 int DetectAddressCmp(DetectAddress *, DetectAddress *);
 
+uint16_t DetectAddressMatchIPv4Prepare(DetectMatchAddressIPv4 **, uint16_t);
+uint16_t DetectAddressMatchIPv6Prepare(DetectMatchAddressIPv6 **, uint16_t);
+void DetectAddressMatchIPv4Free(DetectMatchAddressIPv4 *, uint16_t);
+void DetectAddressMatchIPv6Free(DetectMatchAddressIPv6 *, uint16_t);
+
 int DetectAddressMatchIPv4(const DetectMatchAddressIPv4 *, uint16_t, const Address *);
 int DetectAddressMatchIPv6(const DetectMatchAddressIPv6 *, uint16_t, const Address *);
 
@@ -25,6 +25,7 @@
 #include "detect-engine-iponly.h"
 #include "detect-engine-mpm.h"
 #include "detect-engine-siggroup.h"
+#include "detect-engine-header.h"
 #include "detect-engine-port.h"
 #include "detect-engine-prefilter.h"
 #include "detect-engine-proto.h"
@@ -1775,6 +1776,11 @@ int SigAddressPrepareStage4(DetectEngineCtx *de_ctx)
 
         SigGroupHeadBuildNonPrefilterArray(de_ctx, sgh);
 
+        if (SigGroupHeadBuildHeaderFilter(sgh) < 0) {
+            SCLogWarning(SC_ERR_MEM_ALLOC, "failed to set up the header "
+                    "filter of rule group %u", idx);
+        }
+
         SigGroupHeadInitDataFree(sgh->init);
         sgh->init = NULL;
 
@@ -1916,6 +1922,7 @@ int SigGroupBuild(DetectEngineCtx *de_ctx)
     int r = DetectMpmPrepareBuiltinMpms(de_ctx);
     r |= DetectMpmPrepareAppMpms(de_ctx);
     r |= DetectMpmPreparePktMpms(de_ctx);
+    r |= DetectMpmPrepareQueued(de_ctx);
     if (r != 0) {
         SCLogError(SC_ERR_DETECT_PREPARE, "initializing the detection engine failed");
         exit(EXIT_FAILURE);
@@ -1926,6 +1933,15 @@ int SigGroupBuild(DetectEngineCtx *de_ctx)
         exit(EXIT_FAILURE);
     }
 
+    /* needs the inspect engines set up by SigMatchPrepare() */
+    for (uint32_t idx = 0; idx < de_ctx->sgh_array_cnt; idx++) {
+        if (SigGroupHeadBuildStateArray(de_ctx, de_ctx->sgh_array[idx]) != 0) {
+            SCLogError(SC_ERR_DETECT_PREPARE, "initializing the detection engine failed");
+            exit(EXIT_FAILURE);
+        }
+        SigGroupHeadSetInspectAny(de_ctx->sgh_array[idx]);
+    }
+
 #ifdef PROFILING
     SCProfilingKeywordInitCounters(de_ctx);
     SCProfilingPrefilterInitCounters(de_ctx);
@@ -0,0 +1,680 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Header filter for rule groups.
+ *
+ * For the source and destination port and IPv4 address, the value range
+ * is split into intervals at every boundary used by the signatures of the
+ * rule group. Within an interval, each signature either accepts all values
+ * or none, so a bitmap indexed by the position of the signature in the
+ * group's match_array tells which signatures accept a value. Identical
+ * bitmaps are stored once, so large address lists used by one signature
+ * cost an interval entry per range, not a bitmap. The tables are built by
+ * a sweep over the sorted range starts and ends of the signatures. Fields
+ * split into too many intervals are not filtered.
+ *
+ * At runtime one binary search per field finds the bitmaps for the packet,
+ * after which each candidate from the prefilter stage is checked with a
+ * few bit tests. Candidates are sparse compared to the rule group, so
+ * testing their bits is cheaper than combining the full bitmaps.
+ *
+ * The filter only removes signatures that DetectRunInspectRuleHeader would
+ * reject as well, the full header inspection still runs on the remaining
+ * candidates.
+ */
+
+#include "suricata-common.h"
+#include "suricata.h"
+#include "decode.h"
+
+#include "detect.h"
+#include "detect-engine.h"
+#include "detect-engine-header.h"
+#include "detect-engine-port.h"
+#include "detect-engine-address.h"
+#include "detect-engine-siggroup.h"
+#include "detect-engine-build.h"
+#include "detect-parse.h"
+
+#include "util-hash-lookup3.h"
+#include "util-unittest.h"
+#include "util-unittest-helper.h"
+
+/** rule groups with fewer signatures don't get a filter */
+#define HEADER_FILTER_MIN_SIGS      32
+/** max size of the bitmaps of a single table */
+#define HEADER_FILTER_MAX_BITS_SIZE (4 * 1024 * 1024)
+/** fields split into more intervals don't get a table */
+#define HEADER_FILTER_MAX_INTERVALS (128 * 1024)
+
+enum HeaderFilterField {
+    HEADER_FILTER_SP = 0,
+    HEADER_FILTER_DP,
+    HEADER_FILTER_SRC4,
+    HEADER_FILTER_DST4,
+    HEADER_FILTER_MAX,
+};
+
+typedef struct HeaderFilterTable_ {
+    uint32_t cnt;           /**< number of intervals */
+    uint32_t *start;        /**< first value of each interval, sorted */
+    uint32_t *row;          /**< offset of the bitmap of each interval */
+    uint8_t *bits;          /**< unique bitmaps */
+} HeaderFilterTable;
+
+typedef struct SigGroupHeadHeaderFilter_ {
+    /** num of each signature in match_array, to find a candidate's
+     *  position in the bitmaps */
+    SigIntId *sig_nums;
+    HeaderFilterTable *tables[HEADER_FILTER_MAX];
+} SigGroupHeadHeaderFilter;
+
+static void HeaderFilterTableFree(HeaderFilterTable *t)
+{
+    if (t == NULL)
+        return;
+    SCFree(t->start);
+    SCFree(t->row);
+    SCFree(t->bits);
+    SCFree(t);
+}
+
+static int HeaderFilterCompareU64(const void *a, const void *b)
+{
+    const uint64_t x = *(const uint64_t *)a;
+    const uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : (x > y);
+}
+
+static bool HeaderFilterSigIsAny(const Signature *s, enum HeaderFilterField field)
+{
+    switch (field) {
+        case HEADER_FILTER_SP:
+            return (s->flags & SIG_FLAG_SP_ANY);
+        case HEADER_FILTER_DP:
+            return (s->flags & SIG_FLAG_DP_ANY);
+        case HEADER_FILTER_SRC4:
+            return (s->flags & SIG_FLAG_SRC_ANY);
+        case HEADER_FILTER_DST4:
+            return (s->flags & SIG_FLAG_DST_ANY);
+        default:
+            return true;
+    }
+}
+
+/** events of the interval sweep: value << 32 | position in the
+ *  match_array << 1 | start flag */
+#define HEADER_FILTER_EVENT(v, idx, start) \
+    (((uint64_t)(v) << 32) | ((uint64_t)(idx) << 1) | (start))
+#define HEADER_FILTER_EVENT_VALUE(e)   ((uint32_t)((e) >> 32))
+#define HEADER_FILTER_EVENT_IDX(e)     ((SigIntId)(((e) & UINT32_MAX) >> 1))
+#define HEADER_FILTER_EVENT_START(e)   ((e) & 1)
+
+/** \internal
+ *  \brief add the start and end events of a signature's field
+ *
+ *  A signature starts accepting values at the start of each of its ranges
+ *  and stops after the end of it, e.g. for port range 80:90 at 80 and 91.
+ *  The end of a range reaching the max value has no event.
+ */
+static int HeaderFilterAddEvents(const Signature *s, SigIntId idx,
+        enum HeaderFilterField field, uint64_t **events, uint32_t *cnt,
+        uint32_t *size)
+{
+    uint32_t pairs[2];
+    const DetectPort *port = NULL;
+    const DetectMatchAddressIPv4 *addrs = NULL;
+    uint16_t addrs_cnt = 0;
+    uint32_t max = UINT32_MAX;
+
+    switch (field) {
+        case HEADER_FILTER_SP:
+            port = s->sp;
+            max = UINT16_MAX;
+            break;
+        case HEADER_FILTER_DP:
+            port = s->dp;
+            max = UINT16_MAX;
+            break;
+        case HEADER_FILTER_SRC4:
+            addrs = s->addr_src_match4;
+            addrs_cnt = s->addr_src_match4_cnt;
+            break;
+        case HEADER_FILTER_DST4:
+            addrs = s->addr_dst_match4;
+            addrs_cnt = s->addr_dst_match4_cnt;
+            break;
+        default:
+            return 0;
+    }
+
+    uint32_t i = 0;
+    while (1) {
+        if (port != NULL) {
+            pairs[0] = port->port;
+            pairs[1] = port->port2;
+            port = port->next;
+        } else if (i < addrs_cnt) {
+            pairs[0] = addrs[i].ip;
+            pairs[1] = addrs[i].ip2;
+            i++;
+        } else {
+            break;
+        }
+
+        if (*cnt + 2 > *size) {
+            uint32_t nsize = *size ? *size * 2 : 64;
+            uint64_t *ptr = SCRealloc(*events, nsize * sizeof(uint64_t));
+            if (ptr == NULL)
+                return -1;
+            *events = ptr;
+            *size = nsize;
+        }
+        (*events)[(*cnt)++] = HEADER_FILTER_EVENT(pairs[0], idx, 1);
+        if (pairs[1] < max)
+            (*events)[(*cnt)++] = HEADER_FILTER_EVENT(pairs[1] + 1, idx, 0);
+    }
+    return 0;
+}
+
+/** \internal
+ *  \brief store a bitmap if it's not stored yet
+ *
+ *  Bitmaps are deduplicated using an open addressing hash of their
+ *  offsets into t->bits.
+ *
+ *  \retval offset of the stored bitmap or -1 on error
+ */
+static int64_t HeaderFilterStoreRow(HeaderFilterTable *t, const uint8_t *row,
+        uint32_t row_size, uint32_t *uniq, uint32_t *bits_size,
+        uint32_t *hash, uint32_t hash_size)
+{
+    const uint32_t h = hashlittle_safe(row, row_size, 0);
+    uint32_t slot = h & (hash_size - 1);
+    while (hash[slot] != 0) {
+        const uint32_t off = hash[slot] - 1;
+        if (memcmp(t->bits + off, row, row_size) == 0)
+            return off;
+        slot = (slot + 1) & (hash_size - 1);
+    }
+
+    const uint64_t off = (uint64_t)*uniq * row_size;
+    if (off + row_size > HEADER_FILTER_MAX_BITS_SIZE)
+        return -1;
+    if (off + row_size > *bits_size) {
+        uint32_t nsize = *bits_size ? *bits_size * 2 : row_size * 16;
+        if (nsize < off + row_size)
+            nsize = off + row_size;
+        uint8_t *ptr = SCRealloc(t->bits, nsize);
+        if (ptr == NULL)
+            return -1;
+        t->bits = ptr;
+        *bits_size = nsize;
+    }
+    memcpy(t->bits + off, row, row_size);
+    hash[slot] = (uint32_t)off + 1;
+    (*uniq)++;
+    return (int64_t)off;
+}
+
+/** \internal
+ *  \brief build the interval table of a field
+ *
+ *  Sweeps over the sorted start and end events of the signatures, keeping
+ *  the bitmap of the signatures accepting the current interval up to date.
+ *  Signatures can have overlapping ranges, so a count of the ranges
+ *  containing the current value is kept per signature.
+ *
+ *  \retval t table or NULL if the field doesn't filter anything, needs
+ *            too many intervals or on error
+ */
+static HeaderFilterTable *HeaderFilterBuildTable(const SigGroupHead *sgh,
+        enum HeaderFilterField field)
+{
+    HeaderFilterTable *t = NULL;
+    uint64_t *events = NULL;
+    uint32_t events_cnt = 0, events_size = 0;
+    uint32_t *hash = NULL;
+    uint8_t *row = NULL;
+    uint16_t *active = NULL;
+    const uint32_t row_size = (sgh->sig_cnt + 7) / 8;
+
+    row = SCCalloc(1, row_size);
+    if (row == NULL)
+        goto error;
+    for (SigIntId i = 0; i < sgh->sig_cnt; i++) {
+        const Signature *s = sgh->match_array[i];
+        if (HeaderFilterSigIsAny(s, field)) {
+            row[i / 8] |= 1 << (i % 8);
+            continue;
+        }
+        if (HeaderFilterAddEvents(s, i, field, &events, &events_cnt, &events_size) < 0)
+            goto error;
+    }
+    if (events_cnt == 0)
+        goto error;
+
+    qsort(events, events_cnt, sizeof(uint64_t), HeaderFilterCompareU64);
+
+    /* unique starts of the intervals, the first one starting at 0 */
+    uint32_t cnt = 1;
+    uint32_t prev = 0;
+    for (uint32_t i = 0; i < events_cnt; i++) {
+        const uint32_t v = HEADER_FILTER_EVENT_VALUE(events[i]);
+        if (v != prev) {
+            cnt++;
+            prev = v;
+        }
+    }
+    if (cnt > HEADER_FILTER_MAX_INTERVALS) {
+        SCLogDebug("sgh %u: %u intervals for field %d, not filtering it",
+                sgh->id, cnt, field);
+        goto error;
+    }
+
+    t = SCCalloc(1, sizeof(*t));
+    if (t == NULL)
+        goto error;
+    t->start = SCMalloc(cnt * sizeof(uint32_t));
+    t->row = SCMalloc(cnt * sizeof(uint32_t));
+    active = SCCalloc(sgh->sig_cnt, sizeof(uint16_t));
+    uint32_t hash_size = 64;
+    while (hash_size < cnt * 2)
+        hash_size *= 2;
+    hash = SCCalloc(hash_size, sizeof(uint32_t));
+    if (t->start == NULL || t->row == NULL || active == NULL || hash == NULL)
+        goto error;
+
+    uint32_t uniq = 0, bits_size = 0;
+    uint32_t e = 0;
+    for (uint32_t i = 0; i < cnt; i++) {
+        const uint32_t v = (i == 0) ? 0 : HEADER_FILTER_EVENT_VALUE(events[e]);
+        for ( ; e < events_cnt && HEADER_FILTER_EVENT_VALUE(events[e]) == v; e++) {
+            const SigIntId idx = HEADER_FILTER_EVENT_IDX(events[e]);
+            if (HEADER_FILTER_EVENT_START(events[e])) {
+                if (active[idx]++ == 0)
+                    row[idx / 8] |= 1 << (idx % 8);
+            } else {
+                if (--active[idx] == 0)
+                    row[idx / 8] &= ~(1 << (idx % 8));
+            }
+        }
+        int64_t off = HeaderFilterStoreRow(t, row, row_size, &uniq, &bits_size,
+                hash, hash_size);
+        if (off < 0)
+            goto error;
+        t->start[i] = v;
+        t->row[i] = (uint32_t)off;
+    }
+    t->cnt = cnt;
+
+    SCFree(events);
+    SCFree(active);
+    SCFree(row);
+    SCFree(hash);
+    return t;
+
+error:
+    SCFree(events);
+    SCFree(active);
+    SCFree(row);
+    SCFree(hash);
+    HeaderFilterTableFree(t);
+    return NULL;
+}
+
+/**
+ *  \brief Build the header filter of a rule group
+ *
+ *  Needs the match_array of the sgh.
+ *
+ *  \retval 0 ok, also if the group doesn't need a filter
+ *  \retval -1 error
+ */
+int SigGroupHeadBuildHeaderFilter(SigGroupHead *sgh)
+{
+    if (sgh == NULL || sgh->match_array == NULL ||
+            sgh->sig_cnt < HEADER_FILTER_MIN_SIGS)
+        return 0;
+
+    SigGroupHeadHeaderFilter *hf = SCCalloc(1, sizeof(*hf));
+    if (hf == NULL)
+        return -1;
+
+    bool have_table = false;
+    for (int f = 0; f < HEADER_FILTER_MAX; f++) {
+        hf->tables[f] = HeaderFilterBuildTable(sgh, f);
+        if (hf->tables[f] != NULL)
+            have_table = true;
+    }
+    if (!have_table) {
+        SCFree(hf);
+        return 0;
+    }
+
+    hf->sig_nums = SCMalloc(sgh->sig_cnt * sizeof(SigIntId));
+    if (hf->sig_nums == NULL) {
+        sgh->header_filter = hf;
+        SigGroupHeadFreeHeaderFilter(sgh);
+        return -1;
+    }
+    for (SigIntId i = 0; i < sgh->sig_cnt; i++) {
+        hf->sig_nums[i] = sgh->match_array[i]->num;
+    }
+
+    sgh->header_filter = hf;
+    return 0;
+}
+
+void SigGroupHeadFreeHeaderFilter(SigGroupHead *sgh)
+{
+    SigGroupHeadHeaderFilter *hf = sgh->header_filter;
+    if (hf == NULL)
+        return;
+
+    for (int f = 0; f < HEADER_FILTER_MAX; f++) {
+        HeaderFilterTableFree(hf->tables[f]);
+    }
+    SCFree(hf->sig_nums);
+    SCFree(hf);
+    sgh->header_filter = NULL;
+}
+
+static inline const uint8_t *HeaderFilterLookup(const HeaderFilterTable *t,
+        uint32_t v)
+{
+    /* last interval with start <= v, start[0] is 0 */
+    uint32_t lo = 0, hi = t->cnt;
+    while (hi - lo > 1) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        if (t->start[mid] <= v)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return t->bits + t->row[lo];
+}
+
+/**
+ *  \brief Remove candidates from det_ctx->match_array that can't match
+ *         the ports and IPv4 addresses of the packet
+ */
+void DetectHeaderFilter(DetectEngineThreadCtx *det_ctx,
+        const SigGroupHead *sgh, const Packet *p)
+{
+    const SigGroupHeadHeaderFilter *hf = sgh->header_filter;
+    if (hf == NULL || det_ctx->match_array_cnt == 0)
+        return;
+
+    const uint8_t *rows[HEADER_FILTER_MAX];
+    int nrows = 0;
+
+    /* packets without ports are left to DetectRunInspectRuleHeader */
+    if ((p->proto == IPPROTO_TCP || p->proto == IPPROTO_UDP ||
+                p->proto == IPPROTO_SCTP) && !(p->flags & PKT_IS_FRAGMENT))
+    {
+        if (hf->tables[HEADER_FILTER_SP] != NULL)
+            rows[nrows++] = HeaderFilterLookup(hf->tables[HEADER_FILTER_SP], p->sp);
+        if (hf->tables[HEADER_FILTER_DP] != NULL)
+            rows[nrows++] = HeaderFilterLookup(hf->tables[HEADER_FILTER_DP], p->dp);
+    }
+    if (PKT_IS_IPV4(p)) {
+        if (hf->tables[HEADER_FILTER_SRC4] != NULL)
+            rows[nrows++] = HeaderFilterLookup(hf->tables[HEADER_FILTER_SRC4],
+                    SCNtohl(p->src.addr_data32[0]));
+        if (hf->tables[HEADER_FILTER_DST4] != NULL)
+            rows[nrows++] = HeaderFilterLookup(hf->tables[HEADER_FILTER_DST4],
+                    SCNtohl(p->dst.addr_data32[0]));
+    }
+    if (nrows == 0)
+        return;
+
+    Signature **match_array = det_ctx->match_array;
+    const SigIntId cnt = det_ctx->match_array_cnt;
+    const SigIntId *sig_nums = hf->sig_nums;
+    SigIntId out = 0;
+    uint32_t lo = 0;
+
+    for (SigIntId i = 0; i < cnt; i++) {
+        Signature *s = match_array[i];
+
+        /* candidates are sorted by num, so the search can start after
+         * the previous one */
+        uint32_t l = lo, h = sgh->sig_cnt;
+        while (l < h) {
+            const uint32_t mid = l + (h - l) / 2;
+            if (sig_nums[mid] < s->num)
+                l = mid + 1;
+            else
+                h = mid;
+        }
+
+        if (l < sgh->sig_cnt && sig_nums[l] == s->num) {
+            lo = l + 1;
+            const uint8_t mask = 1 << (l % 8);
+            const uint32_t byte = l / 8;
+            bool pass = true;
+            for (int r = 0; r < nrows; r++) {
+                if (!(rows[r][byte] & mask)) {
+                    pass = false;
+                    break;
+                }
+            }
+            if (!pass) {
+                SCLogDebug("sig %u rejected by header filter", s->id);
+                continue;
+            }
+        }
+        match_array[out++] = s;
+    }
+    det_ctx->match_array_cnt = out;
+}
+
+/********************************Unittests********************************/
+
+#ifdef UNITTESTS
+
+static bool HeaderFilterTestHasSid(const DetectEngineThreadCtx *det_ctx, uint32_t sid)
+{
+    for (SigIntId i = 0; i < det_ctx->match_array_cnt; i++) {
+        if (det_ctx->match_array[i]->id == sid)
+            return true;
+    }
+    return false;
+}
+
+static int DetectHeaderFilterTest01(void)
+{
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+
+    char sig[256];
+    for (int i = 0; i < HEADER_FILTER_MIN_SIGS; i++) {
+        snprintf(sig, sizeof(sig), "alert tcp any any -> 10.0.%d.0/24 [80,%d] "
+                "(content:\"abc\"; sid:%d;)", i, 1000 + i, i + 1);
+        FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, sig));
+    }
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp any 1024:2048 -> any any "
+                "(content:\"abc\"; sid:100;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any "
+                "(content:\"abc\"; sid:101;)"));
+    SigGroupBuild(de_ctx);
+
+    ThreadVars tv;
+    memset(&tv, 0, sizeof(tv));
+    DetectEngineThreadCtx *det_ctx = NULL;
+    DetectEngineThreadCtxInit(&tv, (void *)de_ctx, (void *)&det_ctx);
+    FAIL_IF_NULL(det_ctx);
+
+    Packet *p = UTHBuildPacketReal(NULL, 0, IPPROTO_TCP,
+            "192.168.1.1", "10.0.5.1", 1500, 80);
+    FAIL_IF_NULL(p);
+
+    /* all ports end up in one group */
+    const SigGroupHead *sgh = SigMatchSignaturesGetSgh(de_ctx, p);
+    FAIL_IF_NULL(sgh);
+    FAIL_IF_NULL(sgh->header_filter);
+
+    /* all signatures of the group are candidates */
+    memcpy(det_ctx->match_array, sgh->match_array,
+            sgh->sig_cnt * sizeof(Signature *));
+    det_ctx->match_array_cnt = sgh->sig_cnt;
+    DetectHeaderFilter(det_ctx, sgh, p);
+
+    FAIL_IF_NOT(det_ctx->match_array_cnt == 3);
+    FAIL_IF_NOT(HeaderFilterTestHasSid(det_ctx, 6));
+    FAIL_IF_NOT(HeaderFilterTestHasSid(det_ctx, 100));
+    FAIL_IF_NOT(HeaderFilterTestHasSid(det_ctx, 101));
+
+    /* port of sid 6 only and source port outside of sid 100's range */
+    p->sp = 3000;
+    p->dp = 1005;
+    memcpy(det_ctx->match_array, sgh->match_array,
+            sgh->sig_cnt * sizeof(Signature *));
+    det_ctx->match_array_cnt = sgh->sig_cnt;
+    DetectHeaderFilter(det_ctx, sgh, p);
+
+    FAIL_IF_NOT(det_ctx->match_array_cnt == 2);
+    FAIL_IF_NOT(HeaderFilterTestHasSid(det_ctx, 6));
+    FAIL_IF_NOT(HeaderFilterTestHasSid(det_ctx, 101));
+
+    /* fragments are left alone for the ports */
+    p->flags |= PKT_IS_FRAGMENT;
+    memcpy(det_ctx->match_array, sgh->match_array,
+            sgh->sig_cnt * sizeof(Signature *));
+    det_ctx->match_array_cnt = sgh->sig_cnt;
+    DetectHeaderFilter(det_ctx, sgh, p);
+    FAIL_IF_NOT(det_ctx->match_array_cnt == 3);
+
+    UTHFreePacket(p);
+    DetectEngineThreadCtxDeinit(&tv, (void *)det_ctx);
+    DetectEngineCtxFree(de_ctx);
+    PASS;
+}
+
+/** \test identical bitmaps are stored once */
+static int DetectHeaderFilterTest02(void)
+{
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+
+    char sig[256];
+    for (int i = 0; i < HEADER_FILTER_MIN_SIGS; i++) {
+        snprintf(sig, sizeof(sig), "alert tcp any any -> any any "
+                "(content:\"abc\"; sid:%d;)", i + 1);
+        FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, sig));
+    }
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp any any -> "
+                "[1.1.1.1,2.2.2.2,3.3.3.3,4.4.4.4,5.5.5.5] any "
+                "(content:\"abc\"; sid:100;)"));
+    SigGroupBuild(de_ctx);
+
+    Packet *p = UTHBuildPacketReal(NULL, 0, IPPROTO_TCP,
+            "192.168.1.1", "3.3.3.3", 1500, 80);
+    FAIL_IF_NULL(p);
+    const SigGroupHead *sgh = SigMatchSignaturesGetSgh(de_ctx, p);
+    FAIL_IF_NULL(sgh);
+    const SigGroupHeadHeaderFilter *hf = sgh->header_filter;
+    FAIL_IF_NULL(hf);
+    FAIL_IF_NOT_NULL(hf->tables[HEADER_FILTER_SP]);
+    FAIL_IF_NOT_NULL(hf->tables[HEADER_FILTER_SRC4]);
+
+    const HeaderFilterTable *t = hf->tables[HEADER_FILTER_DST4];
+    FAIL_IF_NULL(t);
+    FAIL_IF_NOT(t->cnt == 11);
+    const uint32_t row_size = (sgh->sig_cnt + 7) / 8;
+    for (uint32_t i = 0; i < t->cnt; i++) {
+        FAIL_IF_NOT(t->row[i] == (i % 2) * row_size);
+    }
+
+    UTHFreePacket(p);
+    DetectEngineCtxFree(de_ctx);
+    PASS;
+}
+
+/** \test overlapping ranges of a signature and the interval cap */
+static int DetectHeaderFilterTest03(void)
+{
+    Signature s[2];
+    memset(&s, 0, sizeof(s));
+    Signature *match_array[2] = { &s[0], &s[1] };
+    SigGroupHead sgh;
+    memset(&sgh, 0, sizeof(sgh));
+    sgh.match_array = match_array;
+    sgh.sig_cnt = 2;
+
+    DetectMatchAddressIPv4 a[3] = {
+        { .ip = 10, .ip2 = 20 }, { .ip = 15, .ip2 = 30 }, { .ip = 40, .ip2 = UINT32_MAX },
+    };
+    s[0].flags = SIG_FLAG_SRC_ANY;
+    s[0].addr_dst_match4 = a;
+    s[0].addr_dst_match4_cnt = 3;
+    s[1].flags = SIG_FLAG_SRC_ANY|SIG_FLAG_DST_ANY;
+
+    HeaderFilterTable *t = HeaderFilterBuildTable(&sgh, HEADER_FILTER_DST4);
+    FAIL_IF_NULL(t);
+    FAIL_IF_NOT(t->cnt == 6);
+    FAIL_IF_NOT(*HeaderFilterLookup(t, 9) == 0x2);
+    FAIL_IF_NOT(*HeaderFilterLookup(t, 10) == 0x3);
+    FAIL_IF_NOT(*HeaderFilterLookup(t, 20) == 0x3);
+    FAIL_IF_NOT(*HeaderFilterLookup(t, 30) == 0x3);
+    FAIL_IF_NOT(*HeaderFilterLookup(t, 31) == 0x2);
+    FAIL_IF_NOT(*HeaderFilterLookup(t, 40) == 0x3);
+    FAIL_IF_NOT(*HeaderFilterLookup(t, UINT32_MAX) == 0x3);
+    HeaderFilterTableFree(t);
+
+    /* single addresses, each adding two intervals */
+    const uint16_t many = UINT16_MAX;
+    DetectMatchAddressIPv4 *b = SCCalloc(2 * many, sizeof(*b));
+    FAIL_IF_NULL(b);
+    for (uint32_t i = 0; i < 2U * many; i++) {
+        b[i].ip = b[i].ip2 = i * 2 + 1;
+    }
+    s[0].addr_dst_match4 = b;
+    s[0].addr_dst_match4_cnt = many;
+    t = HeaderFilterBuildTable(&sgh, HEADER_FILTER_DST4);
+    FAIL_IF_NULL(t);
+    FAIL_IF_NOT(t->cnt == 2U * many + 1);
+    FAIL_IF_NOT(t->cnt <= HEADER_FILTER_MAX_INTERVALS);
+    HeaderFilterTableFree(t);
+
+    /* too many intervals: no table */
+    s[1].flags &= ~SIG_FLAG_DST_ANY;
+    s[1].addr_dst_match4 = b + many;
+    s[1].addr_dst_match4_cnt = many;
+    t = HeaderFilterBuildTable(&sgh, HEADER_FILTER_DST4);
+    FAIL_IF_NOT_NULL(t);
+
+    SCFree(b);
+    PASS;
+}
+
+#endif /* UNITTESTS */
+
+void DetectHeaderFilterRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("DetectHeaderFilterTest01", DetectHeaderFilterTest01);
+    UtRegisterTest("DetectHeaderFilterTest02", DetectHeaderFilterTest02);
+    UtRegisterTest("DetectHeaderFilterTest03", DetectHeaderFilterTest03);
+#endif
+}
@@ -0,0 +1,36 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Per rule group tables to filter the candidate signatures of a packet on
+ * their ports and IPv4 addresses.
+ */
+
+#ifndef __DETECT_ENGINE_HEADER_H__
+#define __DETECT_ENGINE_HEADER_H__
+
+int SigGroupHeadBuildHeaderFilter(SigGroupHead *sgh);
+void SigGroupHeadFreeHeaderFilter(SigGroupHead *sgh);
+
+void DetectHeaderFilter(DetectEngineThreadCtx *det_ctx,
+        const SigGroupHead *sgh, const Packet *p);
+
+void DetectHeaderFilterRegisterTests(void);
+
+#endif /* __DETECT_ENGINE_HEADER_H__ */
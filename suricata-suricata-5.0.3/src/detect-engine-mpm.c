@@ -58,6 +58,7 @@
 #include "stream.h"
 
 #include "util-misc.h"
+#include "util-cpu.h"
 #include "util-enum.h"
 #include "util-debug.h"
 #include "util-print.h"
@@ -255,6 +256,136 @@ void DetectMpmInitializeAppMpms(DetectEngineCtx *de_ctx)
             de_ctx->app_mpms_list, de_ctx->app_mpms_list_cnt);
 }
 
+/**
+ *  \brief queue a mpm ctx for DetectMpmPrepareQueued()
+ *
+ *  Shared ctxs are handed in for every buffer using them, they are
+ *  queued once. If the queue can't grow the ctx is prepared right away.
+ */
+static int MpmPrepareQueueAdd(DetectEngineCtx *de_ctx, MpmCtx *mpm_ctx)
+{
+    if (mpm_ctx == NULL || mpm_ctx->pattern_cnt == 0 ||
+        (mpm_ctx->flags & MPMCTX_FLAGS_QUEUED) ||
+        mpm_table[de_ctx->mpm_matcher].Prepare == NULL)
+        return 0;
+
+    if (de_ctx->mpm_prepare_queue_cnt == de_ctx->mpm_prepare_queue_size) {
+        uint32_t size = MAX(64, de_ctx->mpm_prepare_queue_size * 2);
+        MpmCtx **queue = SCRealloc(de_ctx->mpm_prepare_queue,
+                size * sizeof(MpmCtx *));
+        if (queue == NULL) {
+            return mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
+        }
+        de_ctx->mpm_prepare_queue = queue;
+        de_ctx->mpm_prepare_queue_size = size;
+    }
+    mpm_ctx->flags |= MPMCTX_FLAGS_QUEUED;
+    de_ctx->mpm_prepare_queue[de_ctx->mpm_prepare_queue_cnt++] = mpm_ctx;
+    return 0;
+}
+
+typedef struct MpmPrepareQueue_ {
+    MpmCtx **queue;
+    uint32_t cnt;
+    uint32_t next;
+    int result;
+    SCMutex m;
+} MpmPrepareQueue;
+
+static void *MpmPrepareWorker(void *data)
+{
+    MpmPrepareQueue *q = data;
+
+    while (1) {
+        SCMutexLock(&q->m);
+        if (q->next == q->cnt) {
+            SCMutexUnlock(&q->m);
+            break;
+        }
+        MpmCtx *mpm_ctx = q->queue[q->next++];
+        SCMutexUnlock(&q->m);
+
+        int r = mpm_table[mpm_ctx->mpm_type].Prepare(mpm_ctx);
+        if (r != 0) {
+            SCMutexLock(&q->m);
+            q->result |= r;
+            SCMutexUnlock(&q->m);
+        }
+    }
+    return NULL;
+}
+
+/* biggest first, so that a big ctx doesn't end up being built last */
+static int MpmPrepareQueueCompare(const void *a, const void *b)
+{
+    const MpmCtx *m1 = *(const MpmCtx **)a;
+    const MpmCtx *m2 = *(const MpmCtx **)b;
+    if (m1->pattern_cnt != m2->pattern_cnt)
+        return m1->pattern_cnt > m2->pattern_cnt ? -1 : 1;
+    return 0;
+}
+
+/**
+ *  \brief run the Prepare of all queued mpm ctxs
+ *
+ *  The ctxs are independent, so they are built in parallel by
+ *  detect.mpm-build-threads threads. The default is one per cpu.
+ *
+ *  \retval 0 ok
+ *  \retval -1 a Prepare failed
+ */
+int DetectMpmPrepareQueued(DetectEngineCtx *de_ctx)
+{
+    MpmPrepareQueue q = {
+        .queue = de_ctx->mpm_prepare_queue,
+        .cnt = de_ctx->mpm_prepare_queue_cnt,
+        .next = 0,
+        .result = 0,
+    };
+    if (q.cnt == 0)
+        return 0;
+
+    qsort(q.queue, q.cnt, sizeof(MpmCtx *), MpmPrepareQueueCompare);
+
+    intmax_t setting = 0;
+    if (ConfGetInt("detect.mpm-build-threads", &setting) != 1 || setting <= 0)
+        setting = UtilCpuGetNumProcessorsOnline();
+    uint32_t nthreads = (uint32_t)MIN(MAX(setting, 1), (intmax_t)q.cnt);
+
+    SCMutexInit(&q.m, NULL);
+
+    /* the calling thread is a worker as well */
+    pthread_t *threads = NULL;
+    uint32_t started = 0;
+    if (nthreads > 1) {
+        threads = SCCalloc(nthreads - 1, sizeof(pthread_t));
+        for (uint32_t i = 0; threads != NULL && i < nthreads - 1; i++) {
+            if (pthread_create(&threads[i], NULL, MpmPrepareWorker, &q) != 0)
+                break;
+            started++;
+        }
+    }
+    SCLogDebug("preparing %u mpm ctxs with %u threads", q.cnt, started + 1);
+
+    MpmPrepareWorker(&q);
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    if (threads != NULL)
+        SCFree(threads);
+    SCMutexDestroy(&q.m);
+
+    for (uint32_t i = 0; i < q.cnt; i++) {
+        q.queue[i]->flags &= ~MPMCTX_FLAGS_QUEUED;
+    }
+    SCFree(de_ctx->mpm_prepare_queue);
+    de_ctx->mpm_prepare_queue = NULL;
+    de_ctx->mpm_prepare_queue_cnt = 0;
+    de_ctx->mpm_prepare_queue_size = 0;
+
+    return q.result ? -1 : 0;
+}
+
 /**
  *  \brief initialize mpm contexts for applayer buffers that are in
  *         "single or "shared" mode.
@@ -270,9 +401,7 @@ int DetectMpmPrepareAppMpms(DetectEngineCtx *de_ctx)
         {
             MpmCtx *mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, am->sgh_mpm_context, dir);
             if (mpm_ctx != NULL) {
-                if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-                    r |= mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-                }
+                r |= MpmPrepareQueueAdd(de_ctx, mpm_ctx);
             }
         }
         am = am->next;
@@ -437,10 +566,8 @@ int DetectMpmPreparePktMpms(DetectEngineCtx *de_ctx)
         {
             MpmCtx *mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, am->sgh_mpm_context, 0);
             if (mpm_ctx != NULL) {
-                if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-                    r |= mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-                    SCLogDebug("%s: %d", am->name, r);
-                }
+                r |= MpmPrepareQueueAdd(de_ctx, mpm_ctx);
+                SCLogDebug("%s: %d", am->name, r);
             }
         }
         am = am->next;
@@ -492,42 +619,28 @@ int DetectMpmPrepareBuiltinMpms(DetectEngineCtx *de_ctx)
 
     if (de_ctx->sgh_mpm_context_proto_tcp_packet != MPM_CTX_FACTORY_UNIQUE_CONTEXT) {
         mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_proto_tcp_packet, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            r |= mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
+        r |= MpmPrepareQueueAdd(de_ctx, mpm_ctx);
         mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_proto_tcp_packet, 1);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            r |= mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
+        r |= MpmPrepareQueueAdd(de_ctx, mpm_ctx);
     }
 
     if (de_ctx->sgh_mpm_context_proto_udp_packet != MPM_CTX_FACTORY_UNIQUE_CONTEXT) {
         mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_proto_udp_packet, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            r |= mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
+        r |= MpmPrepareQueueAdd(de_ctx, mpm_ctx);
         mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_proto_udp_packet, 1);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            r |= mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
+        r |= MpmPrepareQueueAdd(de_ctx, mpm_ctx);
     }
 
     if (de_ctx->sgh_mpm_context_proto_other_packet != MPM_CTX_FACTORY_UNIQUE_CONTEXT) {
         mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_proto_other_packet, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            r |= mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
+        r |= MpmPrepareQueueAdd(de_ctx, mpm_ctx);
     }
 
     if (de_ctx->sgh_mpm_context_stream != MPM_CTX_FACTORY_UNIQUE_CONTEXT) {
         mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_stream, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            r |= mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
+        r |= MpmPrepareQueueAdd(de_ctx, mpm_ctx);
         mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_stream, 1);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            r |= mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
+        r |= MpmPrepareQueueAdd(de_ctx, mpm_ctx);
     }
 
     return r;
@@ -1192,7 +1305,7 @@ void MpmStoreFree(DetectEngineCtx *de_ctx)
     return;
 }
 
-static void MpmStoreSetup(const DetectEngineCtx *de_ctx, MpmStore *ms)
+static void MpmStoreSetup(DetectEngineCtx *de_ctx, MpmStore *ms)
 {
     const Signature *s = NULL;
     uint32_t sig;
@@ -1278,9 +1391,7 @@ static void MpmStoreSetup(const DetectEngineCtx *de_ctx, MpmStore *ms)
         ms->mpm_ctx = NULL;
     } else {
         if (ms->sgh_mpm_context == MPM_CTX_FACTORY_UNIQUE_CONTEXT) {
-            if (mpm_table[ms->mpm_ctx->mpm_type].Prepare != NULL) {
-                mpm_table[ms->mpm_ctx->mpm_type].Prepare(ms->mpm_ctx);
-            }
+            MpmPrepareQueueAdd(de_ctx, ms->mpm_ctx);
         }
     }
 }
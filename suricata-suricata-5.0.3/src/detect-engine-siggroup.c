@@ -34,8 +34,10 @@
 #include "detect-parse.h"
 #include "detect-engine.h"
 #include "detect-engine-address.h"
+#include "detect-engine-port.h"
 #include "detect-engine-mpm.h"
 #include "detect-engine-siggroup.h"
+#include "detect-engine-header.h"
 #include "detect-engine-prefilter.h"
 
 #include "detect-content.h"
@@ -163,6 +165,12 @@ void SigGroupHeadFree(const DetectEngineCtx *de_ctx, SigGroupHead *sgh)
         sgh->match_array = NULL;
     }
 
+    if (sgh->state_sig_array != NULL) {
+        SCFree(sgh->state_sig_array);
+        sgh->state_sig_array = NULL;
+        sgh->state_sig_cnt = 0;
+    }
+
     if (sgh->non_pf_other_store_array != NULL) {
         SCFree(sgh->non_pf_other_store_array);
         sgh->non_pf_other_store_array = NULL;
@@ -175,6 +183,8 @@ void SigGroupHeadFree(const DetectEngineCtx *de_ctx, SigGroupHead *sgh)
         sgh->non_pf_syn_store_cnt = 0;
     }
 
+    SigGroupHeadFreeHeaderFilter(sgh);
+
     sgh->sig_cnt = 0;
 
     if (sgh->init != NULL) {
@@ -517,6 +527,172 @@ int SigGroupHeadBuildMatchArray(DetectEngineCtx *de_ctx, SigGroupHead *sgh,
     return 0;
 }
 
+/** \internal
+ *  \brief Get the kinds of inspection a signature needs to match
+ *
+ *  App-layer inspection is checked separately.
+ *
+ *  \retval inspect SGH_INSPECT_* flags, any of which lets the signature
+ *                  match
+ */
+static uint8_t SigGetInspect(const Signature *s)
+{
+    if (!(s->flags & SIG_FLAG_DSIZE) &&
+            s->sm_arrays[DETECT_SM_LIST_PMATCH] == NULL)
+        return SGH_INSPECT_PACKET;
+
+    uint8_t inspect = 0;
+    if (s->flags & SIG_FLAG_REQUIRE_STREAM)
+        inspect |= SGH_INSPECT_STREAM;
+    if (s->flags & SIG_FLAG_REQUIRE_PACKET)
+        inspect |= SGH_INSPECT_PAYLOAD;
+    if (inspect == 0)
+        inspect = SGH_INSPECT_PAYLOAD|SGH_INSPECT_STREAM;
+    return inspect;
+}
+
+/** \internal
+ *  \brief Check if a signature can still match a flow
+ *
+ *  Does the checks of DetectRunInspectRuleHeader, using the flow
+ *  instead of a packet.
+ */
+static bool SigCanMatchFlow(const Signature *s, const Flow *f,
+        const Address *src, const Address *dst, Port sp, Port dp,
+        uint8_t inspect)
+{
+    const uint32_t sflags = s->flags;
+
+    if (s->alproto != ALPROTO_UNKNOWN) {
+        if (f->alproto == ALPROTO_FAILED)
+            return false;
+        if (f->alproto != ALPROTO_UNKNOWN && s->alproto != f->alproto)
+            return false;
+    }
+
+    if (s->app_inspect != NULL && !(inspect & SGH_INSPECT_APPLAYER))
+        return false;
+    if (s->app_inspect == NULL || s->sm_arrays[DETECT_SM_LIST_PMATCH] != NULL) {
+        if (!(SigGetInspect(s) & inspect))
+            return false;
+    }
+
+    if ((s->proto.flags & DETECT_PROTO_IPV4) && !FLOW_IS_IPV4(f))
+        return false;
+    if ((s->proto.flags & DETECT_PROTO_IPV6) && !FLOW_IS_IPV6(f))
+        return false;
+
+    if (f->proto == IPPROTO_TCP || f->proto == IPPROTO_UDP ||
+            f->proto == IPPROTO_SCTP) {
+        if (!(sflags & SIG_FLAG_DP_ANY) && DetectPortLookupGroup(s->dp, dp) == NULL)
+            return false;
+        if (!(sflags & SIG_FLAG_SP_ANY) && DetectPortLookupGroup(s->sp, sp) == NULL)
+            return false;
+    } else if ((sflags & (SIG_FLAG_DP_ANY|SIG_FLAG_SP_ANY)) !=
+            (SIG_FLAG_DP_ANY|SIG_FLAG_SP_ANY)) {
+        return false;
+    }
+
+    if (!(sflags & SIG_FLAG_DST_ANY)) {
+        if (FLOW_IS_IPV4(f)) {
+            if (DetectAddressMatchIPv4(s->addr_dst_match4, s->addr_dst_match4_cnt, dst) == 0)
+                return false;
+        } else if (FLOW_IS_IPV6(f)) {
+            if (DetectAddressMatchIPv6(s->addr_dst_match6, s->addr_dst_match6_cnt, dst) == 0)
+                return false;
+        }
+    }
+    if (!(sflags & SIG_FLAG_SRC_ANY)) {
+        if (FLOW_IS_IPV4(f)) {
+            if (DetectAddressMatchIPv4(s->addr_src_match4, s->addr_src_match4_cnt, src) == 0)
+                return false;
+        } else if (FLOW_IS_IPV6(f)) {
+            if (DetectAddressMatchIPv6(s->addr_src_match6, s->addr_src_match6_cnt, src) == 0)
+                return false;
+        }
+    }
+    return true;
+}
+
+/**
+ *  \brief Set the inspect_any flags of the sgh
+ *
+ *  Needs the match_array and the inspect engines of the signatures.
+ */
+void SigGroupHeadSetInspectAny(SigGroupHead *sgh)
+{
+    const uint32_t any = SIG_FLAG_SRC_ANY|SIG_FLAG_DST_ANY|
+        SIG_FLAG_SP_ANY|SIG_FLAG_DP_ANY;
+
+    sgh->inspect_any = 0;
+    for (uint32_t sig = 0; sig < sgh->sig_cnt; sig++) {
+        const Signature *s = sgh->match_array[sig];
+        if (s == NULL)
+            continue;
+
+        if ((s->flags & any) != any || s->alproto != ALPROTO_UNKNOWN ||
+                s->app_inspect != NULL ||
+                (s->proto.flags & (DETECT_PROTO_IPV4|DETECT_PROTO_IPV6)))
+            continue;
+        sgh->inspect_any |= SigGetInspect(s);
+    }
+}
+
+/**
+ *  \brief Check if any signature in the sgh can still match a flow
+ *
+ *  Signatures are skipped if their app proto, ports or addresses don't
+ *  match the flow, or if they need inspection that is no longer done on
+ *  the flow, e.g. stream signatures once the reassembly depth is
+ *  reached. IP-only signatures are not part of the sgh: they are done
+ *  with the first packet of each direction.
+ *
+ *  \param f flow. If its alproto is ALPROTO_UNKNOWN, signatures for any
+ *           app proto count.
+ *  \param direction STREAM_TOSERVER or STREAM_TOCLIENT, the direction
+ *                   the sgh is used for
+ *  \param inspect SGH_INSPECT_* flags of the inspection still done on
+ *                 the flow in this direction
+ *
+ *  \retval true signatures can match
+ *  \retval false sgh is NULL or none of its signatures can match
+ */
+bool SigGroupHeadCanMatch(const SigGroupHead *sgh, const Flow *f,
+        uint8_t direction, uint8_t inspect)
+{
+    if (sgh == NULL || inspect == 0)
+        return false;
+    if (sgh->inspect_any & inspect)
+        return true;
+
+    Address src, dst;
+    memset(&src, 0, sizeof(src));
+    memset(&dst, 0, sizeof(dst));
+    const FlowAddress *fsrc = (direction & STREAM_TOSERVER) ? &f->src : &f->dst;
+    const FlowAddress *fdst = (direction & STREAM_TOSERVER) ? &f->dst : &f->src;
+    if (FLOW_IS_IPV4(f)) {
+        FLOW_COPY_IPV4_ADDR_TO_PACKET(fsrc, &src);
+        FLOW_COPY_IPV4_ADDR_TO_PACKET(fdst, &dst);
+    } else if (FLOW_IS_IPV6(f)) {
+        FLOW_COPY_IPV6_ADDR_TO_PACKET(fsrc, &src);
+        FLOW_COPY_IPV6_ADDR_TO_PACKET(fdst, &dst);
+    }
+    const Port sp = (direction & STREAM_TOSERVER) ? f->sp : f->dp;
+    const Port dp = (direction & STREAM_TOSERVER) ? f->dp : f->sp;
+
+    for (uint32_t sig = 0; sig < sgh->sig_cnt; sig++) {
+        const Signature *s = sgh->match_array[sig];
+        if (s == NULL)
+            continue;
+
+        if (SigCanMatchFlow(s, f, &src, &dst, sp, dp, inspect)) {
+            SCLogDebug("sig %u can still match flow %p", s->id, f);
+            return true;
+        }
+    }
+    return false;
+}
+
 /**
  *  \brief Set the need magic flag in the sgh.
  *
@@ -720,6 +896,49 @@ int SigGroupHeadBuildNonPrefilterArray(DetectEngineCtx *de_ctx, SigGroupHead *sg
     return 0;
 }
 
+/** \brief build the array of internal ids of the sigs in the sgh that keep
+ *         per tx inspection state, i.e. the ones with app inspect engines
+ *  Needs the inspect engines, so it's called after SigMatchPrepare(). Also
+ *  updates de_ctx::state_sig_cnt_max to track the highest cnt
+ *
+ *  \retval 0 success
+ *  \retval -1 error
+ */
+int SigGroupHeadBuildStateArray(DetectEngineCtx *de_ctx, SigGroupHead *sgh)
+{
+    uint32_t cnt = 0;
+    uint32_t sig = 0;
+
+    if (sgh == NULL)
+        return 0;
+
+    BUG_ON(sgh->state_sig_array != NULL);
+
+    for (sig = 0; sig < sgh->sig_cnt; sig++) {
+        const Signature *s = sgh->match_array[sig];
+        if (s != NULL && s->app_inspect != NULL)
+            cnt++;
+    }
+    if (cnt == 0)
+        return 0;
+
+    sgh->state_sig_array = SCCalloc(cnt, sizeof(SigIntId));
+    if (sgh->state_sig_array == NULL)
+        return -1;
+
+    /* match_array is ordered by internal id, so this array is too */
+    for (sig = 0; sig < sgh->sig_cnt; sig++) {
+        const Signature *s = sgh->match_array[sig];
+        if (s != NULL && s->app_inspect != NULL)
+            sgh->state_sig_array[sgh->state_sig_cnt++] = s->num;
+    }
+
+    if (sgh->state_sig_cnt > de_ctx->state_sig_cnt_max)
+        de_ctx->state_sig_cnt_max = sgh->state_sig_cnt;
+
+    return 0;
+}
+
 /**
  * \brief Check if a SigGroupHead contains a Signature, whose sid is sent as an
  *        argument.
@@ -58,6 +58,16 @@ int SigGroupHeadBuildMatchArray (DetectEngineCtx *de_ctx, SigGroupHead *sgh,
                                  uint32_t max_idx);
 void SigGroupHeadFreeSigArrays(DetectEngineCtx *de_ctx);
 
+/** inspection still done on a flow, see SigGroupHeadCanMatch */
+#define SGH_INSPECT_PACKET      BIT_U8(0)   /**< packet headers */
+#define SGH_INSPECT_PAYLOAD     BIT_U8(1)   /**< packet payload */
+#define SGH_INSPECT_STREAM      BIT_U8(2)   /**< reassembled stream */
+#define SGH_INSPECT_APPLAYER    BIT_U8(3)   /**< app-layer transactions */
+
+void SigGroupHeadSetInspectAny(SigGroupHead *sgh);
+bool SigGroupHeadCanMatch(const SigGroupHead *sgh, const Flow *f,
+        uint8_t direction, uint8_t inspect);
+
 int SigGroupHeadContainsSigId (DetectEngineCtx *de_ctx, SigGroupHead *sgh,
                                uint32_t sid);
 
@@ -73,5 +83,33 @@ uint16_t SigGroupHeadGetMinMpmSize(DetectEngineCtx *de_ctx,
                                    SigGroupHead *sgh, int list);
 
 int SigGroupHeadBuildNonPrefilterArray(DetectEngineCtx *de_ctx, SigGroupHead *sgh);
+int SigGroupHeadBuildStateArray(DetectEngineCtx *de_ctx, SigGroupHead *sgh);
+
+/** \brief get the index of a sig in the sgh's state_sig_array
+ *
+ *  \param num internal id of the sig
+ *  \param idx set to the index if found
+ *
+ *  \retval true if the sig is in the array
+ */
+static inline bool SigGroupHeadGetStateIdx(const SigGroupHead *sgh,
+        const SigIntId num, uint32_t *idx)
+{
+    uint32_t lo = 0;
+    uint32_t hi = sgh->state_sig_cnt;
+
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        if (sgh->state_sig_array[mid] < num)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < sgh->state_sig_cnt && sgh->state_sig_array[lo] == num) {
+        *idx = lo;
+        return true;
+    }
+    return false;
+}
 
 #endif /* __DETECT_ENGINE_SIGGROUP_H__ */
@@ -18,11 +18,13 @@
 /**
  * \defgroup sigstate State support
  *
- * State is stored in the ::DetectEngineState structure. This is
- * basically a containter for storage item of type ::DeStateStore.
- * They contains an array of ::DeStateStoreItem which store the
- * state of match for an individual signature identified by
- * DeStateStoreItem::sid.
+ * State is stored in the ::DetectEngineState structure. Per direction
+ * it has an array of ::DeStateStoreItem, ordered by
+ * DeStateStoreItem::sid, which store the state of match for an
+ * individual signature. Bitmaps indexed like the state_sig_array of the
+ * rule group tell which signatures have an item and which of those are
+ * done, so the detection engine can check and merge them without
+ * searching the items.
  *
  * @{
  */
@@ -43,6 +45,7 @@
 #include "detect.h"
 #include "detect-engine.h"
 #include "detect-parse.h"
+#include "detect-engine-siggroup.h"
 #include "detect-engine-state.h"
 #include "detect-engine-dcepayload.h"
 
@@ -63,6 +66,7 @@
 #include "util-unittest.h"
 #include "util-unittest-helper.h"
 #include "util-profiling.h"
+#include "util-hash-lookup3.h"
 
 #include "flow-util.h"
 
@@ -84,83 +88,262 @@ static inline int StateIsValid(uint16_t alproto, void *alstate)
     return 0;
 }
 
-static DeStateStore *DeStateStoreAlloc(void)
+/** initial number of items in a direction's store */
+#define DE_STATE_STORE_INIT_SIZE    4
+
+/** transformed buffers larger than this are not cached in the tx state */
+#define DE_STATE_BUFFER_MAX_LEN     65536
+/** max memory used by the cached buffers of all txs */
+#define DE_STATE_BUFFERS_MEMCAP     (16 * 1024 * 1024)
+
+static SC_ATOMIC_DECLARE(uint64_t, de_state_buffers_memuse);
+
+/** \internal
+ *  \brief make sure the bitmaps of a direction cover sgh index 'idx'
+ *
+ *  \retval 0 ok
+ *  \retval -1 alloc failure
+ */
+static int DeStateBitsGrow(DetectEngineStateDirection *dir_state, const uint32_t idx)
 {
-    DeStateStore *d = SCMalloc(sizeof(DeStateStore));
-    if (unlikely(d == NULL))
-        return NULL;
-    memset(d, 0, sizeof(DeStateStore));
+    const uint32_t need = idx / 32 + 1;
+    if (need <= dir_state->bits_size)
+        return 0;
+
+    /* grow on demand: sized to the rule group, big groups would cost
+     * every tx with state a large bitmap */
+    const uint32_t max_size = (dir_state->sgh->state_sig_cnt + 31) / 32;
+    const uint32_t new_size = MIN(MAX(need, dir_state->bits_size * 2), max_size);
+    DeStateBits *ptr = SCRealloc(dir_state->bits, new_size * sizeof(DeStateBits));
+    if (unlikely(ptr == NULL))
+        return -1;
+    memset(ptr + dir_state->bits_size, 0,
+            (new_size - dir_state->bits_size) * sizeof(DeStateBits));
+    dir_state->bits = ptr;
+    dir_state->bits_size = new_size;
+    return 0;
+}
 
-    return d;
+/** \internal
+ *  \brief set the bitmap bits of a stored item */
+static void DeStateBitsSetItem(DetectEngineStateDirection *dir_state,
+        const uint32_t idx, const uint32_t inspect_flags)
+{
+    dir_state->bits[idx / 32].stored |= BIT_U32(idx % 32);
+    if (inspect_flags & (DE_STATE_FLAG_FULL_INSPECT|DE_STATE_FLAG_SIG_CANT_MATCH))
+        dir_state->bits[idx / 32].done |= BIT_U32(idx % 32);
 }
 
-#ifdef DEBUG_VALIDATION
-static int DeStateSearchState(DetectEngineState *state, uint8_t direction, SigIntId num)
+/** \brief index the stored state of a direction for a rule group
+ *
+ *  The rule group of a flow direction normally doesn't change, so the
+ *  store is empty when this is called. Otherwise the bitmaps are rebuilt
+ *  for the new group, dropping the items of sigs not in it.
+ */
+void DeStateDirectionSetRuleGroup(DetectEngineStateDirection *dir_state,
+        const SigGroupHead *sgh)
 {
-    DetectEngineStateDirection *dir_state = &state->dir_state[direction & STREAM_TOSERVER ? 0 : 1];
-    DeStateStore *tx_store = dir_state->head;
-    SigIntId store_cnt;
-    SigIntId state_cnt = 0;
-
-    for (; tx_store != NULL; tx_store = tx_store->next) {
-        SCLogDebug("tx_store %p", tx_store);
-        for (store_cnt = 0;
-             store_cnt < DE_STATE_CHUNK_SIZE && state_cnt < dir_state->cnt;
-             store_cnt++, state_cnt++)
-        {
-            DeStateStoreItem *item = &tx_store->store[store_cnt];
-            if (item->sid == num) {
-                SCLogDebug("sid %u already in state: %p %p %p %u %u, direction %s",
-                            num, state, dir_state, tx_store, state_cnt,
-                            store_cnt, direction & STREAM_TOSERVER ? "toserver" : "toclient");
-                return 1;
-            }
+    if (dir_state->bits != NULL)
+        memset(dir_state->bits, 0, dir_state->bits_size * sizeof(DeStateBits));
+    dir_state->sgh = sgh;
+
+    SigIntId keep = 0;
+    for (SigIntId i = 0; i < dir_state->cnt; i++) {
+        const DeStateStoreItem item = dir_state->store[i];
+        uint32_t idx;
+        if (!SigGroupHeadGetStateIdx(sgh, item.sid, &idx) ||
+                DeStateBitsGrow(dir_state, idx) < 0) {
+            SCLogDebug("dropping state for sig %u", item.sid);
+            continue;
         }
+        DeStateBitsSetItem(dir_state, idx, item.flags);
+        dir_state->store[keep++] = item;
     }
-    return 0;
+    dir_state->cnt = keep;
 }
-#endif
 
-static void DeStateSignatureAppend(DetectEngineState *state,
+/** \brief reset the file part of the stored state
+ *
+ *  Called when a new file is available in the tx, so that file inspecting
+ *  sigs can be evaluated again.
+ */
+void DeStateDirectionResetFiles(DetectEngineStateDirection *dir_state)
+{
+    for (SigIntId i = 0; i < dir_state->cnt; i++) {
+        DeStateStoreItem *item = &dir_state->store[i];
+        if (!(item->flags & DE_STATE_FLAG_FILE_INSPECT))
+            continue;
+
+        /* remove part of the state. File inspect engine will now
+         * be able to run again */
+        item->flags &= ~(DE_STATE_FLAG_SIG_CANT_MATCH|DE_STATE_FLAG_FULL_INSPECT|DE_STATE_FLAG_FILE_INSPECT);
+        SCLogDebug("rule id %u, post file reset inspect_flags %u", item->sid, item->flags);
+
+        uint32_t idx;
+        if (dir_state->sgh != NULL &&
+                SigGroupHeadGetStateIdx(dir_state->sgh, item->sid, &idx) &&
+                idx / 32 < dir_state->bits_size) {
+            dir_state->bits[idx / 32].done &= ~BIT_U32(idx % 32);
+        }
+    }
+}
+
+static void DeStateSignatureAppend(DetectEngineState *state, const SigGroupHead *sgh,
         const Signature *s, uint32_t inspect_flags, uint8_t direction)
 {
-    int jump = 0;
-    int i = 0;
     DetectEngineStateDirection *dir_state = &state->dir_state[direction & STREAM_TOSERVER ? 0 : 1];
 
+    uint32_t idx;
+    if (!SigGroupHeadGetStateIdx(sgh, s->num, &idx)) {
+        SCLogDebug("sig %u has no state index in the rule group", s->num);
+        return;
+    }
+    if (dir_state->sgh != sgh)
+        DeStateDirectionSetRuleGroup(dir_state, sgh);
+
 #ifdef DEBUG_VALIDATION
-    BUG_ON(DeStateSearchState(state, direction, s->num));
+    BUG_ON(DeStateDirectionIsStored(dir_state, idx));
 #endif
-    DeStateStore *store = dir_state->head;
+    if (DeStateBitsGrow(dir_state, idx) < 0)
+        return;
 
-    if (store == NULL) {
-        store = DeStateStoreAlloc();
-        if (store != NULL) {
-            dir_state->head = store;
-            dir_state->tail = store;
-        }
-    } else {
-        jump = dir_state->cnt / DE_STATE_CHUNK_SIZE;
-        for (i = 0; i < jump; i++) {
-            store = store->next;
+    if (dir_state->cnt == dir_state->size) {
+        const SigIntId new_size = dir_state->size ?
+            dir_state->size * 2 : DE_STATE_STORE_INIT_SIZE;
+        DeStateStoreItem *ptr = SCRealloc(dir_state->store,
+                new_size * sizeof(DeStateStoreItem));
+        if (unlikely(ptr == NULL))
+            return;
+        dir_state->store = ptr;
+        dir_state->size = new_size;
+    }
+
+    /* keep the store ordered by sid */
+    SigIntId lo = 0;
+    SigIntId hi = dir_state->cnt;
+    while (lo < hi) {
+        const SigIntId mid = lo + (hi - lo) / 2;
+        if (dir_state->store[mid].sid < s->num)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    memmove(&dir_state->store[lo + 1], &dir_state->store[lo],
+            (dir_state->cnt - lo) * sizeof(DeStateStoreItem));
+    dir_state->store[lo].sid = s->num;
+    dir_state->store[lo].flags = inspect_flags;
+    dir_state->cnt++;
+
+    DeStateBitsSetItem(dir_state, idx, inspect_flags);
+}
+
+static void DeStateBuffersFree(DetectEngineStateDirection *dir_state)
+{
+    uint64_t size = dir_state->buffers_cnt * sizeof(DeStateBuffer);
+    for (uint16_t i = 0; i < dir_state->buffers_cnt; i++) {
+        if (dir_state->buffers[i].buf != NULL) {
+            size += dir_state->buffers[i].size;
+            SCFree(dir_state->buffers[i].buf);
         }
-        if (store == NULL) {
-            store = DeStateStoreAlloc();
-            if (store != NULL) {
-                dir_state->tail->next = store;
-                dir_state->tail = store;
-            }
+    }
+    if (dir_state->buffers != NULL)
+        SCFree(dir_state->buffers);
+    dir_state->buffers = NULL;
+    dir_state->buffers_cnt = 0;
+    (void)SC_ATOMIC_SUB(de_state_buffers_memuse, size);
+}
+
+/** \brief hash of the data a buffer is created from, see DeStateBuffer */
+uint32_t DeStateBufferHash(const uint8_t *orig, const uint32_t orig_len)
+{
+    return hashlittle_safe(orig, orig_len, 0);
+}
+
+/** \brief check if the cached buffers of all txs use up the memcap */
+bool DeStateBufferMemcapReached(void)
+{
+    return SC_ATOMIC_GET(de_state_buffers_memuse) >= DE_STATE_BUFFERS_MEMCAP;
+}
+
+/** \brief get the cached transformed buffer for a list
+ *
+ *  \retval b the buffer if it was created at the same tx progress from
+ *           the same data, NULL otherwise
+ */
+const DeStateBuffer *DeStateBufferLookup(const DetectEngineStateDirection *dir_state,
+        const int list_id, const int tx_progress,
+        const uint8_t *orig, const uint32_t orig_len, const uint32_t orig_hash)
+{
+    for (uint16_t i = 0; i < dir_state->buffers_cnt; i++) {
+        const DeStateBuffer *b = &dir_state->buffers[i];
+        if (b->list_id != list_id)
+            continue;
+
+        if (b->len > 0 && b->tx_progress == tx_progress &&
+                b->orig == orig && b->orig_len == orig_len &&
+                b->orig_hash == orig_hash) {
+            return b;
         }
+        return NULL;
     }
+    return NULL;
+}
 
-    if (store == NULL)
+/** \brief cache a transformed buffer, replacing the old one of the list
+ *
+ *  Nothing is cached once the memcap is reached.
+ */
+void DeStateBufferStore(DetectEngineStateDirection *dir_state,
+        const int list_id, const int tx_progress,
+        const InspectionBuffer *buffer, const uint32_t orig_hash)
+{
+    if (buffer->inspect_len == 0 || buffer->inspect_len > DE_STATE_BUFFER_MAX_LEN)
         return;
 
-    SigIntId idx = dir_state->cnt++ % DE_STATE_CHUNK_SIZE;
-    store->store[idx].sid = s->num;
-    store->store[idx].flags = inspect_flags;
+    DeStateBuffer *b = NULL;
+    for (uint16_t i = 0; i < dir_state->buffers_cnt; i++) {
+        if (dir_state->buffers[i].list_id == list_id) {
+            b = &dir_state->buffers[i];
+            break;
+        }
+    }
+    if (b == NULL) {
+        if (dir_state->buffers_cnt == UINT16_MAX ||
+                SC_ATOMIC_GET(de_state_buffers_memuse) + sizeof(DeStateBuffer) +
+                buffer->inspect_len > DE_STATE_BUFFERS_MEMCAP)
+            return;
+        DeStateBuffer *ptr = SCRealloc(dir_state->buffers,
+                (dir_state->buffers_cnt + 1) * sizeof(DeStateBuffer));
+        if (unlikely(ptr == NULL))
+            return;
+        dir_state->buffers = ptr;
+        b = &dir_state->buffers[dir_state->buffers_cnt++];
+        memset(b, 0, sizeof(*b));
+        b->list_id = list_id;
+        (void)SC_ATOMIC_ADD(de_state_buffers_memuse, sizeof(DeStateBuffer));
+    }
 
-    return;
+    if (b->size < buffer->inspect_len) {
+        if (SC_ATOMIC_GET(de_state_buffers_memuse) + buffer->inspect_len - b->size >
+                DE_STATE_BUFFERS_MEMCAP) {
+            b->len = 0;
+            return;
+        }
+        uint8_t *ptr = SCRealloc(b->buf, buffer->inspect_len);
+        if (unlikely(ptr == NULL)) {
+            b->len = 0;
+            return;
+        }
+        (void)SC_ATOMIC_ADD(de_state_buffers_memuse, buffer->inspect_len - b->size);
+        b->buf = ptr;
+        b->size = buffer->inspect_len;
+    }
+    memcpy(b->buf, buffer->inspect, buffer->inspect_len);
+    b->len = buffer->inspect_len;
+    b->tx_progress = tx_progress;
+    b->orig = buffer->orig;
+    b->orig_len = buffer->orig_len;
+    b->orig_hash = orig_hash;
 }
 
 DetectEngineState *DetectEngineStateAlloc(void)
@@ -175,17 +358,14 @@ DetectEngineState *DetectEngineStateAlloc(void)
 
 void DetectEngineStateFree(DetectEngineState *state)
 {
-    DeStateStore *store;
-    DeStateStore *store_next;
     int i = 0;
 
     for (i = 0; i < 2; i++) {
-        store = state->dir_state[i].head;
-        while (store != NULL) {
-            store_next = store->next;
-            SCFree(store);
-            store = store_next;
-        }
+        if (state->dir_state[i].bits != NULL)
+            SCFree(state->dir_state[i].bits);
+        if (state->dir_state[i].store != NULL)
+            SCFree(state->dir_state[i].store);
+        DeStateBuffersFree(&state->dir_state[i]);
     }
     SCFree(state);
 
@@ -218,25 +398,47 @@ static void StoreStateTxHandleFiles(const SigGroupHead *sgh, Flow *f,
     }
 }
 
-void DetectRunStoreStateTx(
-        const SigGroupHead *sgh,
-        Flow *f, void *tx, uint64_t tx_id,
-        const Signature *s,
-        uint32_t inspect_flags, uint8_t flow_flags,
-        const uint16_t file_no_match)
+/** \internal
+ *  \brief get the detect state of a tx, creating it if needed */
+static DetectEngineState *DeStateGetTxState(Flow *f, void *tx)
 {
     DetectEngineState *destate = AppLayerParserGetTxDetectState(f->proto, f->alproto, tx);
     if (destate == NULL) {
         destate = DetectEngineStateAlloc();
         if (destate == NULL)
-            return;
+            return NULL;
         if (AppLayerParserSetTxDetectState(f, tx, destate) < 0) {
             DetectEngineStateFree(destate);
-            return;
+            return NULL;
         }
-        SCLogDebug("destate created for %"PRIu64, tx_id);
+        SCLogDebug("destate created for tx %p", tx);
     }
-    DeStateSignatureAppend(destate, s, inspect_flags, flow_flags);
+    return destate;
+}
+
+/** \brief get the detect state of a tx for a direction, creating it if
+ *         needed
+ *  \retval dir_state or NULL if the state can't be set up */
+DetectEngineStateDirection *DeStateGetTxDirection(Flow *f, void *tx,
+        const uint8_t flow_flags)
+{
+    DetectEngineState *destate = DeStateGetTxState(f, tx);
+    if (destate == NULL)
+        return NULL;
+    return &destate->dir_state[flow_flags & STREAM_TOSERVER ? 0 : 1];
+}
+
+void DetectRunStoreStateTx(
+        const SigGroupHead *sgh,
+        Flow *f, void *tx, uint64_t tx_id,
+        const Signature *s,
+        uint32_t inspect_flags, uint8_t flow_flags,
+        const uint16_t file_no_match)
+{
+    DetectEngineState *destate = DeStateGetTxState(f, tx);
+    if (destate == NULL)
+        return;
+    DeStateSignatureAppend(destate, sgh, s, inspect_flags, flow_flags);
     StoreStateTxHandleFiles(sgh, f, destate, flow_flags, tx_id, file_no_match);
 
     SCLogDebug("Stored for TX %"PRIu64, tx_id);
@@ -287,13 +489,20 @@ void DetectEngineStateResetTxs(Flow *f)
                 continue;
             }
 
-            tx_de_state->dir_state[0].cnt = 0;
-            tx_de_state->dir_state[0].filestore_cnt = 0;
-            tx_de_state->dir_state[0].flags = 0;
-
-            tx_de_state->dir_state[1].cnt = 0;
-            tx_de_state->dir_state[1].filestore_cnt = 0;
-            tx_de_state->dir_state[1].flags = 0;
+            for (int i = 0; i < 2; i++) {
+                DetectEngineStateDirection *dir_state = &tx_de_state->dir_state[i];
+                /* the rule group is gone with the old detect engine */
+                dir_state->sgh = NULL;
+                if (dir_state->bits != NULL) {
+                    memset(dir_state->bits, 0,
+                            dir_state->bits_size * sizeof(DeStateBits));
+                }
+                dir_state->cnt = 0;
+                dir_state->filestore_cnt = 0;
+                dir_state->flags = 0;
+                /* list ids are per detect engine */
+                DeStateBuffersFree(dir_state);
+            }
         }
     }
 }
@@ -306,8 +515,8 @@ static int DeStateTest01(void)
 {
     SCLogDebug("sizeof(DetectEngineState)\t\t%"PRIuMAX,
             (uintmax_t)sizeof(DetectEngineState));
-    SCLogDebug("sizeof(DeStateStore)\t\t\t%"PRIuMAX,
-            (uintmax_t)sizeof(DeStateStore));
+    SCLogDebug("sizeof(DeStateBits)\t\t\t%"PRIuMAX,
+            (uintmax_t)sizeof(DeStateBits));
     SCLogDebug("sizeof(DeStateStoreItem)\t\t%"PRIuMAX"",
             (uintmax_t)sizeof(DeStateStoreItem));
 
@@ -319,52 +528,44 @@ static int DeStateTest02(void)
     DetectEngineState *state = DetectEngineStateAlloc();
     FAIL_IF_NULL(state);
 
+    SigIntId nums[] = { 0, 11, 22, 33, 44, 55, 66, 77, 88, 99, 100, 111,
+                        122, 133, 144, 155, 166, 177, 188, 199, 200, 211,
+                        222, 233, 244, 255, 266, 277, 288, 299, 300, 311,
+                        322, 333 };
+    SigGroupHead sgh;
+    memset(&sgh, 0x00, sizeof(sgh));
+    sgh.state_sig_array = nums;
+    sgh.state_sig_cnt = sizeof(nums) / sizeof(nums[0]);
+
     Signature s;
     memset(&s, 0x00, sizeof(s));
 
     uint8_t direction = STREAM_TOSERVER;
+    DetectEngineStateDirection *dir_state = &state->dir_state[0];
 
-    s.num = 0;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 11;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 22;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 33;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 44;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 55;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 66;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 77;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 88;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 99;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 100;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 111;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 122;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 133;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 144;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 155;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 166;
-    DeStateSignatureAppend(state, &s, 0, direction);
-
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head == NULL);
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->store[1].sid != 11);
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->next == NULL);
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->store[14].sid != 144);
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->next->store[0].sid != 155);
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->next->store[1].sid != 166);
+    /* append out of order, the store is kept ordered by sid */
+    for (uint32_t i = 1; i < sgh.state_sig_cnt; i += 2) {
+        s.num = nums[i];
+        DeStateSignatureAppend(state, &sgh, &s, 0, direction);
+    }
+    for (uint32_t i = 0; i < sgh.state_sig_cnt; i += 2) {
+        s.num = nums[i];
+        DeStateSignatureAppend(state, &sgh, &s, 0, direction);
+    }
+    /* not in the rule group */
+    s.num = 12;
+    DeStateSignatureAppend(state, &sgh, &s, 0, direction);
+
+    FAIL_IF_NOT(dir_state->sgh == &sgh);
+    FAIL_IF_NOT(dir_state->cnt == sgh.state_sig_cnt);
+    FAIL_IF_NOT(dir_state->bits_size == 2);
+    for (uint32_t i = 0; i < sgh.state_sig_cnt; i++) {
+        FAIL_IF_NOT(dir_state->store[i].sid == nums[i]);
+        FAIL_IF_NOT(DeStateDirectionIsStored(dir_state, i));
+        FAIL_IF(DeStateDirectionIsDone(dir_state, i));
+    }
+    FAIL_IF(DeStateDirectionIsStored(dir_state, sgh.state_sig_cnt));
+    FAIL_IF(state->dir_state[1].cnt != 0);
 
     DetectEngineStateFree(state);
 
@@ -376,23 +577,149 @@ static int DeStateTest03(void)
     DetectEngineState *state = DetectEngineStateAlloc();
     FAIL_IF_NULL(state);
 
+    SigIntId nums[] = { 11, 22, 33 };
+    SigGroupHead sgh;
+    memset(&sgh, 0x00, sizeof(sgh));
+    sgh.state_sig_array = nums;
+    sgh.state_sig_cnt = 3;
+
     Signature s;
     memset(&s, 0x00, sizeof(s));
 
     uint8_t direction = STREAM_TOSERVER;
+    DetectEngineStateDirection *dir_state = &state->dir_state[0];
 
     s.num = 11;
-    DeStateSignatureAppend(state, &s, 0, direction);
+    DeStateSignatureAppend(state, &sgh, &s, 0, direction);
     s.num = 22;
-    DeStateSignatureAppend(state, &s, BIT_U32(DE_STATE_FLAG_BASE), direction);
+    DeStateSignatureAppend(state, &sgh, &s, BIT_U32(DE_STATE_FLAG_BASE), direction);
+    s.num = 33;
+    DeStateSignatureAppend(state, &sgh, &s,
+            DE_STATE_FLAG_FULL_INSPECT|DE_STATE_FLAG_FILE_INSPECT, direction);
+
+    FAIL_IF(dir_state->store == NULL);
+    FAIL_IF(dir_state->store[0].sid != 11);
+    FAIL_IF(dir_state->store[0].flags & BIT_U32(DE_STATE_FLAG_BASE));
+    FAIL_IF(dir_state->store[1].sid != 22);
+    FAIL_IF(!(dir_state->store[1].flags & BIT_U32(DE_STATE_FLAG_BASE)));
+    FAIL_IF(DeStateDirectionIsDone(dir_state, 0));
+    FAIL_IF(DeStateDirectionIsDone(dir_state, 1));
+    FAIL_IF_NOT(DeStateDirectionIsDone(dir_state, 2));
+
+    /* a new file makes the file inspecting sig inspectable again */
+    DeStateDirectionResetFiles(dir_state);
+    FAIL_IF(dir_state->store[2].flags != 0);
+    FAIL_IF(DeStateDirectionIsDone(dir_state, 2));
+    FAIL_IF_NOT(DeStateDirectionIsStored(dir_state, 2));
+
+    /* new rule group without sig 22: its state is dropped */
+    SigIntId nums2[] = { 5, 11, 33 };
+    SigGroupHead sgh2;
+    memset(&sgh2, 0x00, sizeof(sgh2));
+    sgh2.state_sig_array = nums2;
+    sgh2.state_sig_cnt = 3;
+
+    DeStateDirectionSetRuleGroup(dir_state, &sgh2);
+    FAIL_IF_NOT(dir_state->cnt == 2);
+    FAIL_IF_NOT(dir_state->store[0].sid == 11);
+    FAIL_IF_NOT(dir_state->store[1].sid == 33);
+    FAIL_IF(DeStateDirectionIsStored(dir_state, 0));
+    FAIL_IF_NOT(DeStateDirectionIsStored(dir_state, 1));
+    FAIL_IF_NOT(DeStateDirectionIsStored(dir_state, 2));
 
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head == NULL);
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->store[0].sid != 11);
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->store[0].flags & BIT_U32(DE_STATE_FLAG_BASE));
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->store[1].sid != 22);
-    FAIL_IF(!(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->store[1].flags & BIT_U32(DE_STATE_FLAG_BASE)));
+    DetectEngineStateFree(state);
+    PASS;
+}
+
+static int DeStateTest04(void)
+{
+    const uint64_t memuse = SC_ATOMIC_GET(de_state_buffers_memuse);
+    DetectEngineState *state = DetectEngineStateAlloc();
+    FAIL_IF_NULL(state);
+    DetectEngineStateDirection *dir_state = &state->dir_state[1];
+
+    uint8_t orig[] = "/index.html";
+    const uint32_t orig_len = sizeof(orig) - 1;
+    uint8_t transformed[] = "0123456789abcdef";
+    InspectionBuffer buffer;
+    memset(&buffer, 0x00, sizeof(buffer));
+    InspectionBufferSetup(&buffer, orig, orig_len);
+    buffer.inspect = transformed;
+    buffer.inspect_len = sizeof(transformed) - 1;
+
+    uint32_t hash = DeStateBufferHash(orig, orig_len);
+    DeStateBufferStore(dir_state, 20, 2, &buffer, hash);
+    FAIL_IF_NOT(dir_state->buffers_cnt == 1);
+    FAIL_IF(state->dir_state[0].buffers_cnt != 0);
+    FAIL_IF_NOT(SC_ATOMIC_GET(de_state_buffers_memuse) > memuse);
+
+    const DeStateBuffer *b = DeStateBufferLookup(dir_state, 20, 2, orig, orig_len, hash);
+    FAIL_IF_NULL(b);
+    FAIL_IF_NOT(b->len == sizeof(transformed) - 1);
+    FAIL_IF_NOT(memcmp(b->buf, transformed, b->len) == 0);
+
+    /* other list, other progress, other data */
+    FAIL_IF_NOT_NULL(DeStateBufferLookup(dir_state, 21, 2, orig, orig_len, hash));
+    FAIL_IF_NOT_NULL(DeStateBufferLookup(dir_state, 20, 3, orig, orig_len, hash));
+    FAIL_IF_NOT_NULL(DeStateBufferLookup(dir_state, 20, 2, orig, orig_len - 1,
+                DeStateBufferHash(orig, orig_len - 1)));
+    FAIL_IF_NOT_NULL(DeStateBufferLookup(dir_state, 20, 2, transformed, orig_len,
+                DeStateBufferHash(transformed, orig_len)));
+
+    /* new data at the same address */
+    orig[1] = 'X';
+    FAIL_IF_NOT_NULL(DeStateBufferLookup(dir_state, 20, 2, orig, orig_len,
+                DeStateBufferHash(orig, orig_len)));
+    orig[1] = 'i';
+
+    /* a new version replaces the old one */
+    buffer.inspect_len = 4;
+    DeStateBufferStore(dir_state, 20, 3, &buffer, hash);
+    FAIL_IF_NOT(dir_state->buffers_cnt == 1);
+    FAIL_IF_NOT_NULL(DeStateBufferLookup(dir_state, 20, 2, orig, orig_len, hash));
+    b = DeStateBufferLookup(dir_state, 20, 3, orig, orig_len, hash);
+    FAIL_IF_NULL(b);
+    FAIL_IF_NOT(b->len == 4);
+
+    /* empty buffers are not cached */
+    buffer.inspect_len = 0;
+    DeStateBufferStore(dir_state, 22, 3, &buffer, hash);
+    FAIL_IF_NOT(dir_state->buffers_cnt == 1);
+
+    DetectEngineStateFree(state);
+    FAIL_IF_NOT(SC_ATOMIC_GET(de_state_buffers_memuse) == memuse);
+    PASS;
+}
+
+/** \test nothing is cached once the memcap is reached */
+static int DeStateTest05(void)
+{
+    DetectEngineState *state = DetectEngineStateAlloc();
+    FAIL_IF_NULL(state);
+    DetectEngineStateDirection *dir_state = &state->dir_state[0];
+
+    const uint8_t orig[] = "/index.html";
+    uint8_t transformed[] = "0123456789abcdef";
+    InspectionBuffer buffer;
+    memset(&buffer, 0x00, sizeof(buffer));
+    InspectionBufferSetup(&buffer, orig, sizeof(orig) - 1);
+    buffer.inspect = transformed;
+    buffer.inspect_len = sizeof(transformed) - 1;
+    const uint32_t hash = DeStateBufferHash(orig, sizeof(orig) - 1);
+
+    const uint64_t memuse = SC_ATOMIC_GET(de_state_buffers_memuse);
+    SC_ATOMIC_SET(de_state_buffers_memuse, DE_STATE_BUFFERS_MEMCAP);
+    FAIL_IF_NOT(DeStateBufferMemcapReached());
+    DeStateBufferStore(dir_state, 20, 2, &buffer, hash);
+    FAIL_IF_NOT(dir_state->buffers_cnt == 0);
+
+    SC_ATOMIC_SET(de_state_buffers_memuse, memuse);
+    FAIL_IF(DeStateBufferMemcapReached());
+    DeStateBufferStore(dir_state, 20, 2, &buffer, hash);
+    FAIL_IF_NOT(dir_state->buffers_cnt == 1);
 
     DetectEngineStateFree(state);
+    FAIL_IF_NOT(SC_ATOMIC_GET(de_state_buffers_memuse) == memuse);
     PASS;
 }
 
@@ -563,7 +890,7 @@ static int DeStateSigTest02(void)
     FAIL_IF(tx_de_state->dir_state[0].cnt != 1);
     /* http_header(mpm): 5, uri: 3, method: 6, cookie: 7 */
     uint32_t expected_flags = (BIT_U32(5) | BIT_U32(3) | BIT_U32(6) |BIT_U32(7));
-    FAIL_IF(tx_de_state->dir_state[0].head->store[0].flags != expected_flags);
+    FAIL_IF(tx_de_state->dir_state[0].store[0].flags != expected_flags);
 
     r = AppLayerParserParse(NULL, alp_tctx, &f, ALPROTO_HTTP,
                             STREAM_TOSERVER, httpbuf4, httplen4);
@@ -1373,6 +1700,8 @@ void DeStateRegisterTests(void)
     UtRegisterTest("DeStateTest01", DeStateTest01);
     UtRegisterTest("DeStateTest02", DeStateTest02);
     UtRegisterTest("DeStateTest03", DeStateTest03);
+    UtRegisterTest("DeStateTest04", DeStateTest04);
+    UtRegisterTest("DeStateTest05", DeStateTest05);
     UtRegisterTest("DeStateSigTest01", DeStateSigTest01);
     UtRegisterTest("DeStateSigTest02", DeStateSigTest02);
     UtRegisterTest("DeStateSigTest03", DeStateSigTest03);
@@ -49,9 +49,6 @@
  *  more files that have ongoing inspection. */
 #define DETECT_ENGINE_INSPECT_SIG_MATCH_MORE_FILES 4
 
-/** number of DeStateStoreItem's in one DeStateStore object */
-#define DE_STATE_CHUNK_SIZE             15
-
 /* per sig flags */
 #define DE_STATE_FLAG_FULL_INSPECT              BIT_U32(0)
 #define DE_STATE_FLAG_SIG_CANT_MATCH            BIT_U32(1)
@@ -75,15 +72,39 @@ typedef struct DeStateStoreItem_ {
     SigIntId sid;
 } DeStateStoreItem;
 
-typedef struct DeStateStore_ {
-    DeStateStoreItem store[DE_STATE_CHUNK_SIZE];
-    struct DeStateStore_ *next;
-} DeStateStore;
+/** one word of the per tx state bitmaps. Bits are indexed like the
+ *  SigGroupHead::state_sig_array of the rule group the state is for. */
+typedef struct DeStateBits_ {
+    uint32_t stored;    /**< sig has an item in the store */
+    uint32_t done;      /**< sig is fully inspected or can't match */
+} DeStateBits;
+
+/** transformed buffer cached in the tx state. Valid as long as the tx
+ *  progress and the data it was created from are unchanged. The data is
+ *  compared by its address, length and hash, as a freed buffer can be
+ *  replaced by one at the same address. */
+typedef struct DeStateBuffer_ {
+    int list_id;                /**< transformed list, so buffer + transforms */
+    int tx_progress;            /**< tx progress when the buffer was created */
+    const uint8_t *orig;        /**< data the buffer was created from */
+    uint32_t orig_len;
+    uint32_t orig_hash;         /**< hash of the orig data */
+    uint32_t len;
+    uint32_t size;              /**< size of buf allocation */
+    uint8_t *buf;
+} DeStateBuffer;
 
 typedef struct DetectEngineStateDirection_ {
-    DeStateStore *head;
-    DeStateStore *tail;
+    /** rule group the bitmaps are indexed for */
+    const struct SigGroupHead_ *sgh;
+    DeStateBits *bits;
+    uint32_t bits_size;         /**< size of bits in words */
+    /** stored items, ordered by sid (and so by sgh index) */
+    DeStateStoreItem *store;
     SigIntId cnt;
+    SigIntId size;              /**< number of items allocated */
+    DeStateBuffer *buffers;     /**< cached transformed buffers */
+    uint16_t buffers_cnt;
     uint16_t filestore_cnt;
     uint8_t flags;
     /* coccinelle: DetectEngineStateDirection:flags:DETECT_ENGINE_STATE_FLAG_ */
@@ -130,6 +151,46 @@ void DeStateUpdateInspectTransactionId(Flow *f, const uint8_t flags,
 
 void DetectEngineStateResetTxs(Flow *f);
 
+void DeStateDirectionSetRuleGroup(DetectEngineStateDirection *dir_state,
+        const struct SigGroupHead_ *sgh);
+void DeStateDirectionResetFiles(DetectEngineStateDirection *dir_state);
+
+DetectEngineStateDirection *DeStateGetTxDirection(Flow *f, void *tx,
+        const uint8_t flow_flags);
+
+uint32_t DeStateBufferHash(const uint8_t *orig, const uint32_t orig_len);
+bool DeStateBufferMemcapReached(void);
+const DeStateBuffer *DeStateBufferLookup(const DetectEngineStateDirection *dir_state,
+        const int list_id, const int tx_progress,
+        const uint8_t *orig, const uint32_t orig_len, const uint32_t orig_hash);
+void DeStateBufferStore(DetectEngineStateDirection *dir_state,
+        const int list_id, const int tx_progress,
+        const struct InspectionBuffer *buffer, const uint32_t orig_hash);
+
+/** \brief check if the sig at sgh index 'idx' has a stored item */
+static inline bool DeStateDirectionIsStored(const DetectEngineStateDirection *dir_state,
+        const uint32_t idx)
+{
+    return (idx / 32 < dir_state->bits_size &&
+            (dir_state->bits[idx / 32].stored & BIT_U32(idx % 32)));
+}
+
+/** \brief check if the sig at sgh index 'idx' is done for this tx */
+static inline bool DeStateDirectionIsDone(const DetectEngineStateDirection *dir_state,
+        const uint32_t idx)
+{
+    return (idx / 32 < dir_state->bits_size &&
+            (dir_state->bits[idx / 32].done & BIT_U32(idx % 32)));
+}
+
+/** \brief flag the stored sig at sgh index 'idx' as done for this tx */
+static inline void DeStateDirectionSetDone(DetectEngineStateDirection *dir_state,
+        const uint32_t idx)
+{
+    if (idx / 32 < dir_state->bits_size)
+        dir_state->bits[idx / 32].done |= BIT_U32(idx % 32);
+}
+
 void DeStateRegisterTests(void);
 
 
@@ -1160,6 +1160,69 @@ void InspectionBufferApplyTransforms(InspectionBuffer *buffer,
     }
 }
 
+/** \internal
+ *  \brief check if the transforms are costly enough to cache their result
+ */
+static bool DetectEngineTransformsCache(const DetectEngineTransforms *transforms)
+{
+    for (int i = 0; i < transforms->cnt; i++) {
+        if (sigmatch_table[transforms->transforms[i]].flags & SIGMATCH_TRANSFORM_CACHE)
+            return true;
+    }
+    return false;
+}
+
+/** \brief setup a tx buffer with our initial data and apply the transforms
+ *
+ *  While a tx is inspected the result of costly transforms, like the
+ *  hashes, is cached in its detect state. As long as the tx progress and
+ *  the data are unchanged the transforms don't have to run again for the
+ *  next packets. Cheap transforms are done again, as checking the data
+ *  costs about as much.
+ *
+ *  \note only for buffers that are set up from data owned by the tx
+ */
+void InspectionBufferSetupAndApplyTransforms(DetectEngineThreadCtx *det_ctx,
+        const int list_id, InspectionBuffer *buffer,
+        const uint8_t *data, const uint32_t data_len,
+        const DetectEngineTransforms *transforms)
+{
+    InspectionBufferSetup(buffer, data, data_len);
+    if (transforms == NULL || transforms->cnt == 0)
+        return;
+
+    if (det_ctx->buffer_cache.tx_ptr == NULL ||
+            !DetectEngineTransformsCache(transforms)) {
+        InspectionBufferApplyTransforms(buffer, transforms);
+        return;
+    }
+
+    const uint32_t hash = DeStateBufferHash(data, data_len);
+    if (det_ctx->buffer_cache.de_state != NULL) {
+        const DeStateBuffer *b = DeStateBufferLookup(det_ctx->buffer_cache.de_state,
+                list_id, det_ctx->buffer_cache.tx_progress, data, data_len, hash);
+        if (b != NULL) {
+            buffer->inspect = b->buf;
+            buffer->inspect_len = b->len;
+            SCLogDebug("list %d: using cached buffer", list_id);
+            return;
+        }
+    }
+
+    InspectionBufferApplyTransforms(buffer, transforms);
+
+    if (det_ctx->buffer_cache.de_state == NULL) {
+        if (DeStateBufferMemcapReached())
+            return;
+        det_ctx->buffer_cache.de_state = DeStateGetTxDirection(det_ctx->buffer_cache.f,
+                det_ctx->buffer_cache.tx_ptr, det_ctx->buffer_cache.flow_flags);
+        if (det_ctx->buffer_cache.de_state == NULL)
+            return;
+    }
+    DeStateBufferStore(det_ctx->buffer_cache.de_state, list_id,
+            det_ctx->buffer_cache.tx_progress, buffer, hash);
+}
+
 static void DetectBufferTypeSetupDetectEngine(DetectEngineCtx *de_ctx)
 {
     const int size = g_buffer_type_id;
@@ -2105,6 +2168,8 @@ void DetectEngineCtxFree(DetectEngineCtx *de_ctx)
      */
     SigGroupHeadHashFree(de_ctx);
     MpmStoreFree(de_ctx);
+    if (de_ctx->mpm_prepare_queue != NULL)
+        SCFree(de_ctx->mpm_prepare_queue);
     DetectParseDupSigHashFree(de_ctx);
     SCSigSignatureOrderingModuleCleanup(de_ctx);
     ThresholdContextDestroy(de_ctx);
@@ -2218,6 +2283,7 @@ static int DetectEngineCtxLoadConf(DetectEngineCtx *de_ctx)
         /* for now, since we still haven't implemented any intelligence into
          * understanding the patterns and distributing mpm_ctx across sgh */
         if (de_ctx->mpm_matcher == MPM_AC || de_ctx->mpm_matcher == MPM_AC_KS ||
+            de_ctx->mpm_matcher == MPM_AC_SIMD ||
 #ifdef BUILD_HYPERSCAN
             de_ctx->mpm_matcher == MPM_HS ||
 #endif
@@ -2701,8 +2767,9 @@ static TmEcode ThreadCtxDoInit (DetectEngineCtx *de_ctx, DetectEngineThreadCtx *
         }
         memset(det_ctx->match_array, 0,
                det_ctx->match_array_len * sizeof(Signature *));
-
-        RuleMatchCandidateTxArrayInit(det_ctx, de_ctx->sig_array_len);
+    }
+    if (de_ctx->state_sig_cnt_max > 0) {
+        RuleMatchCandidateTxBitsInit(det_ctx, de_ctx->state_sig_cnt_max);
     }
 
     /* byte_extract storage */
@@ -2934,7 +3001,7 @@ static void DetectEngineThreadCtxFree(DetectEngineThreadCtx *det_ctx)
     if (det_ctx->match_array != NULL)
         SCFree(det_ctx->match_array);
 
-    RuleMatchCandidateTxArrayFree(det_ctx);
+    RuleMatchCandidateTxBitsFree(det_ctx);
 
     if (det_ctx->bj_values != NULL)
         SCFree(det_ctx->bj_values);
@@ -3359,6 +3426,8 @@ static int DetectEngineMultiTenantReloadTenant(uint32_t tenant_id, const char *f
         goto error;
     }
 
+    DetectEngineReloadDiff(old_de_ctx, new_de_ctx);
+
     DetectEngineAddToMaster(new_de_ctx);
 
     /* move to free list */
@@ -4032,6 +4101,75 @@ void DetectEnginePruneFreeList(void)
     SCMutexUnlock(&master->lock);
 }
 
+static uint32_t ReloadDiffSigHash(HashTable *ht, void *data, uint16_t datalen)
+{
+    const Signature *s = data;
+    return ((s->gid * 7) ^ s->id) % ht->array_size;
+}
+
+static char ReloadDiffSigCompare(void *data1, uint16_t len1, void *data2, uint16_t len2)
+{
+    const Signature *s1 = data1;
+    const Signature *s2 = data2;
+    return (s1->id == s2->id && s1->gid == s2->gid);
+}
+
+static void ReloadDiffSigFree(void *data)
+{
+    /* signatures are owned by their detection engine */
+}
+
+/** \brief Reload diagnostics: compare the rules of a reloaded detection
+ *         engine with the engine it replaces.
+ *
+ *  Rules are matched up by gid:sid. A rule with a different rev or rule
+ *  text counts as changed. The counts are logged and stored in the
+ *  sig_stat of the new engine for ruleset-stats. They don't affect how the
+ *  new engine is built, so a failure here only means no counts.
+ */
+void DetectEngineReloadDiff(const DetectEngineCtx *old_de_ctx,
+        DetectEngineCtx *new_de_ctx)
+{
+    SigFileLoaderStat *sig_stat = &new_de_ctx->sig_stat;
+    int unchanged = 0;
+
+    HashTable *ht = HashTableInit(4096, ReloadDiffSigHash,
+            ReloadDiffSigCompare, ReloadDiffSigFree);
+    if (ht == NULL)
+        return;
+
+    int old_cnt = 0;
+    for (Signature *s = old_de_ctx->sig_list; s != NULL; s = s->next) {
+        if (HashTableAdd(ht, s, 0) != 0) {
+            HashTableFree(ht);
+            return;
+        }
+        old_cnt++;
+    }
+
+    sig_stat->added_sigs_total = 0;
+    sig_stat->changed_sigs_total = 0;
+    for (Signature *s = new_de_ctx->sig_list; s != NULL; s = s->next) {
+        const Signature *old = HashTableLookup(ht, s, 0);
+        if (old == NULL) {
+            sig_stat->added_sigs_total++;
+        } else if (old->rev != s->rev || old->sig_str == NULL ||
+                s->sig_str == NULL || strcmp(old->sig_str, s->sig_str) != 0) {
+            sig_stat->changed_sigs_total++;
+        } else {
+            unchanged++;
+        }
+    }
+    sig_stat->removed_sigs_total =
+        old_cnt - sig_stat->changed_sigs_total - unchanged;
+    HashTableFree(ht);
+
+    SCLogNotice("rule reload: %d rules added, %d removed, %d changed, "
+            "%d unchanged", sig_stat->added_sigs_total,
+            sig_stat->removed_sigs_total, sig_stat->changed_sigs_total,
+            unchanged);
+}
+
 static int reloads = 0;
 
 /** \brief Reload the detection engine
@@ -4101,6 +4239,8 @@ int DetectEngineReload(const SCInstance *suri)
     }
     SCLogDebug("set up new_de_ctx %p", new_de_ctx);
 
+    DetectEngineReloadDiff(old_de_ctx, new_de_ctx);
+
     /* add to master */
     DetectEngineAddToMaster(new_de_ctx);
 
@@ -4271,6 +4411,8 @@ int DetectEngineGetEventInfo(const char *event_name, int *event_id,
 
 #ifdef UNITTESTS
 
+#include "util-mpm-ac.h"
+
 static int DetectEngineInitYamlConf(const char *conf)
 {
     ConfCreateContextBackup();
@@ -4506,6 +4648,118 @@ static int DetectEngineTest09(void)
     return result;
 }
 
+static int DetectEngineTest10(void)
+{
+    DetectEngineCtx *old_de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(old_de_ctx);
+    DetectEngineCtx *new_de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(new_de_ctx);
+
+    FAIL_IF_NULL(DetectEngineAppendSig(old_de_ctx,
+            "alert tcp any any -> any any (content:\"one\"; sid:1; rev:1;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(old_de_ctx,
+            "alert tcp any any -> any any (content:\"two\"; sid:2; rev:1;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(old_de_ctx,
+            "alert tcp any any -> any any (content:\"three\"; sid:3; rev:1;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(old_de_ctx,
+            "alert tcp any any -> any any (content:\"four\"; sid:4; rev:1;)"));
+
+    /* 1 unchanged, 2 new rev, 3 same rev other text, 4 removed, 5 added */
+    FAIL_IF_NULL(DetectEngineAppendSig(new_de_ctx,
+            "alert tcp any any -> any any (content:\"one\"; sid:1; rev:1;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(new_de_ctx,
+            "alert tcp any any -> any any (content:\"two\"; sid:2; rev:2;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(new_de_ctx,
+            "alert tcp any any -> any any (content:\"3\"; sid:3; rev:1;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(new_de_ctx,
+            "alert tcp any any -> any any (content:\"five\"; sid:5; rev:1;)"));
+
+    DetectEngineReloadDiff(old_de_ctx, new_de_ctx);
+    FAIL_IF_NOT(new_de_ctx->sig_stat.added_sigs_total == 1);
+    FAIL_IF_NOT(new_de_ctx->sig_stat.removed_sigs_total == 1);
+    FAIL_IF_NOT(new_de_ctx->sig_stat.changed_sigs_total == 2);
+
+    DetectEngineCtxFree(old_de_ctx);
+    DetectEngineCtxFree(new_de_ctx);
+    PASS;
+}
+
+/** \internal
+ *  \brief check if the ac tables of a new engine's mpm store are shared
+ *          with a store of the old engine
+ */
+static bool DetectEngineTestMpmStoreReused(const DetectEngineCtx *old_de_ctx,
+        const MpmStore *ms)
+{
+    const SCACCtx *ctx = (const SCACCtx *)ms->mpm_ctx->ctx;
+
+    for (HashListTableBucket *htb = HashListTableGetListHead(old_de_ctx->mpm_hash_table);
+            htb != NULL; htb = HashListTableGetListNext(htb)) {
+        const MpmStore *old = (MpmStore *)HashListTableGetListData(htb);
+        if (old->mpm_ctx == NULL || old->mpm_ctx->ctx == NULL)
+            continue;
+        if (((const SCACCtx *)old->mpm_ctx->ctx)->shared == ctx->shared)
+            return true;
+    }
+    return false;
+}
+
+/** \test reload with one rule changed: the pattern matcher tables of the
+ *        unchanged group come from the live engine, the changed group's
+ *        are compiled */
+static int DetectEngineTest11(void)
+{
+    DetectEngineCtx *old_de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(old_de_ctx);
+    old_de_ctx->flags |= DE_QUIET;
+    old_de_ctx->mpm_matcher = MPM_AC;
+    FAIL_IF_NULL(DetectEngineAppendSig(old_de_ctx,
+            "alert tcp any any -> any 80 (content:\"one\"; sid:1; rev:1;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(old_de_ctx,
+            "alert tcp any any -> any 443 (content:\"twotwo\"; sid:2; rev:1;)"));
+    FAIL_IF(SigGroupBuild(old_de_ctx) != 0);
+
+    /* the old engine stays live while the new one is built */
+    DetectEngineCtx *new_de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(new_de_ctx);
+    new_de_ctx->flags |= DE_QUIET;
+    new_de_ctx->mpm_matcher = MPM_AC;
+    FAIL_IF_NULL(DetectEngineAppendSig(new_de_ctx,
+            "alert tcp any any -> any 80 (content:\"one\"; sid:1; rev:1;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(new_de_ctx,
+            "alert tcp any any -> any 443 (content:\"twotwotwo\"; sid:2; rev:2;)"));
+    DetectEngineReloadDiff(old_de_ctx, new_de_ctx);
+    FAIL_IF_NOT(new_de_ctx->sig_stat.changed_sigs_total == 1);
+    FAIL_IF(SigGroupBuild(new_de_ctx) != 0);
+
+    int reused = 0, built = 0;
+    for (HashListTableBucket *htb = HashListTableGetListHead(new_de_ctx->mpm_hash_table);
+            htb != NULL; htb = HashListTableGetListNext(htb)) {
+        const MpmStore *ms = (MpmStore *)HashListTableGetListData(htb);
+        if (ms->mpm_ctx == NULL || ms->mpm_ctx->ctx == NULL)
+            continue;
+        const SCACCtx *ctx = (const SCACCtx *)ms->mpm_ctx->ctx;
+        FAIL_IF_NULL(ctx->shared);
+
+        if (ms->mpm_ctx->minlen == 3) {
+            /* sid 1's group */
+            FAIL_IF_NOT(DetectEngineTestMpmStoreReused(old_de_ctx, ms));
+            FAIL_IF(ctx->shared_owner);
+            reused++;
+        } else {
+            /* sid 2's group */
+            FAIL_IF(DetectEngineTestMpmStoreReused(old_de_ctx, ms));
+            built++;
+        }
+    }
+    FAIL_IF_NOT(reused > 0 && built > 0);
+
+    /* the new engine keeps the tables after the old one is gone */
+    DetectEngineCtxFree(old_de_ctx);
+    DetectEngineCtxFree(new_de_ctx);
+    PASS;
+}
+
 #endif
 
 void DetectEngineRegisterTests()
@@ -4517,6 +4771,8 @@ void DetectEngineRegisterTests()
     UtRegisterTest("DetectEngineTest04", DetectEngineTest04);
     UtRegisterTest("DetectEngineTest08", DetectEngineTest08);
     UtRegisterTest("DetectEngineTest09", DetectEngineTest09);
+    UtRegisterTest("DetectEngineTest10", DetectEngineTest10);
+    UtRegisterTest("DetectEngineTest11", DetectEngineTest11);
 #endif
     return;
 }
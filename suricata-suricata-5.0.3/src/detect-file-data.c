@@ -39,6 +39,7 @@
 
 #include "app-layer-parser.h"
 #include "app-layer-htp.h"
+#include "app-layer-htp-body.h"
 #include "app-layer-smtp.h"
 
 #include "flow.h"
@@ -300,8 +301,7 @@ static InspectionBuffer *HttpServerBodyGetDataCallback(DetectEngineThreadCtx *de
     const uint8_t *data;
     uint32_t data_len;
 
-    StreamingBufferGetDataAtOffset(body->sb,
-            &data, &data_len, offset);
+    HtpBodyGetDataAtOffset(body, &data, &data_len, offset);
     InspectionBufferSetup(buffer, data, data_len);
     buffer->inspect_offset = offset;
 
@@ -71,12 +71,16 @@ void DetectFlowbitsRegister (void)
 }
 
 
-static int DetectFlowbitMatchToggle (Packet *p, const DetectFlowbitsData *fd)
+static int DetectFlowbitMatchToggle (DetectEngineThreadCtx *det_ctx, Packet *p,
+        const DetectFlowbitsData *fd)
 {
     if (p->flow == NULL)
         return 0;
 
-    FlowBitToggle(p->flow,fd->idx);
+    if (FlowBitIsset(p->flow, fd->idx))
+        FlowBitUnset(p->flow, fd->idx);
+    else
+        FlowBitSetPrealloc(p->flow, fd->idx, det_ctx->de_ctx->flowbits_prealloc);
 
     return 1;
 }
@@ -91,12 +95,13 @@ static int DetectFlowbitMatchUnset (Packet *p, const DetectFlowbitsData *fd)
     return 1;
 }
 
-static int DetectFlowbitMatchSet (Packet *p, const DetectFlowbitsData *fd)
+static int DetectFlowbitMatchSet (DetectEngineThreadCtx *det_ctx, Packet *p,
+        const DetectFlowbitsData *fd)
 {
     if (p->flow == NULL)
         return 0;
 
-    FlowBitSet(p->flow,fd->idx);
+    FlowBitSetPrealloc(p->flow, fd->idx, det_ctx->de_ctx->flowbits_prealloc);
 
     return 1;
 }
@@ -136,11 +141,11 @@ int DetectFlowbitMatch (DetectEngineThreadCtx *det_ctx, Packet *p,
         case DETECT_FLOWBITS_CMD_ISNOTSET:
             return DetectFlowbitMatchIsnotset(p,fd);
         case DETECT_FLOWBITS_CMD_SET:
-            return DetectFlowbitMatchSet(p,fd);
+            return DetectFlowbitMatchSet(det_ctx,p,fd);
         case DETECT_FLOWBITS_CMD_UNSET:
             return DetectFlowbitMatchUnset(p,fd);
         case DETECT_FLOWBITS_CMD_TOGGLE:
-            return DetectFlowbitMatchToggle(p,fd);
+            return DetectFlowbitMatchToggle(det_ctx,p,fd);
         default:
             SCLogError(SC_ERR_UNKNOWN_VALUE, "unknown cmd %" PRIu32 "", fd->cmd);
             return 0;
@@ -336,6 +341,7 @@ static void DetectFlowbitsAnalyzeDump(const DetectEngineCtx *de_ctx,
 void DetectFlowbitsAnalyze(DetectEngineCtx *de_ctx)
 {
     const uint32_t max_fb_id = de_ctx->max_fb_id;
+    de_ctx->flowbits_prealloc = FlowBitPreallocSize(max_fb_id);
     if (max_fb_id == 0)
         return;
 
@@ -873,8 +879,7 @@ static int FlowBitsTestSig06(void)
     DetectEngineThreadCtx *det_ctx = NULL;
     DetectEngineCtx *de_ctx = NULL;
     Flow f;
-    GenericVar flowvar, *gv = NULL;
-    int result = 0;
+    GenericVar flowvar;
     uint32_t idx = 0;
 
     memset(p, 0, SIZE_OF_PACKET);
@@ -908,14 +913,7 @@ static int FlowBitsTestSig06(void)
 
     SigMatchSignatures(&th_v, de_ctx, det_ctx, p);
 
-    gv = p->flow->flowvar;
-    FAIL_IF_NULL(gv);
-    for ( ; gv != NULL; gv = gv->next) {
-        if (gv->type == DETECT_FLOWBITS && gv->idx == idx) {
-                result = 1;
-        }
-    }
-    FAIL_IF_NOT(result);
+    FAIL_IF_NOT(FlowBitIsset(p->flow, idx));
 
     DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
     DetectEngineCtxFree(de_ctx);
@@ -947,8 +945,7 @@ static int FlowBitsTestSig07(void)
     DetectEngineThreadCtx *det_ctx = NULL;
     DetectEngineCtx *de_ctx = NULL;
     Flow f;
-    GenericVar flowvar, *gv = NULL;
-    int result = 0;
+    GenericVar flowvar;
     uint32_t idx = 0;
 
     memset(p, 0, SIZE_OF_PACKET);
@@ -983,15 +980,7 @@ static int FlowBitsTestSig07(void)
 
     SigMatchSignatures(&th_v, de_ctx, det_ctx, p);
 
-    gv = p->flow->flowvar;
-    FAIL_IF_NULL(gv);
-
-    for ( ; gv != NULL; gv = gv->next) {
-        if (gv->type == DETECT_FLOWBITS && gv->idx == idx) {
-                result = 1;
-        }
-    }
-    FAIL_IF(result);
+    FAIL_IF(FlowBitIsset(p->flow, idx));
 
     DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
     DetectEngineCtxFree(de_ctx);
@@ -1024,8 +1013,7 @@ static int FlowBitsTestSig08(void)
     DetectEngineThreadCtx *det_ctx = NULL;
     DetectEngineCtx *de_ctx = NULL;
     Flow f;
-    GenericVar flowvar, *gv = NULL;
-    int result = 0;
+    GenericVar flowvar;
     uint32_t idx = 0;
 
     memset(p, 0, SIZE_OF_PACKET);
@@ -1060,15 +1048,7 @@ static int FlowBitsTestSig08(void)
 
     SigMatchSignatures(&th_v, de_ctx, det_ctx, p);
 
-    gv = p->flow->flowvar;
-    FAIL_IF_NULL(gv);
-
-    for ( ; gv != NULL; gv = gv->next) {
-        if (gv->type == DETECT_FLOWBITS && gv->idx == idx) {
-                result = 1;
-        }
-    }
-    FAIL_IF(result);
+    FAIL_IF(FlowBitIsset(p->flow, idx));
 
     DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
     DetectEngineCtxFree(de_ctx);
@@ -90,8 +90,7 @@ int DetectFlowintMatch(DetectEngineThreadCtx *det_ctx,
                         Packet *p, const Signature *s, const SigMatchCtx *ctx)
 {
     const DetectFlowintData *sfd = (const DetectFlowintData *)ctx;
-    FlowVar *fv;
-    FlowVar *fvt;
+    uint32_t value = 0;
     uint32_t targetval;
     int ret = 0;
 
@@ -109,12 +108,9 @@ int DetectFlowintMatch(DetectEngineThreadCtx *det_ctx,
     if (sfd->targettype == FLOWINT_TARGET_VAR) {
         uint32_t tvar_idx = VarNameStoreLookupByName(sfd->target.tvar.name, VAR_TYPE_FLOW_INT);
 
-        fvt = FlowVarGet(p->flow, tvar_idx);
-            /* We don't have that variable initialized yet */
-        if (fvt == NULL)
+        /* We don't have that variable initialized yet */
+        if (FlowVarGetInt(p->flow, tvar_idx, &targetval) == 0)
             targetval = 0;
-        else
-            targetval = fvt->data.fv_int.value;
     } else {
         targetval = sfd->target.value;
     }
@@ -128,63 +124,61 @@ int DetectFlowintMatch(DetectEngineThreadCtx *det_ctx,
         goto end;
     }
 
-    fv = FlowVarGet(p->flow, sfd->idx);
+    const int isset = FlowVarGetInt(p->flow, sfd->idx, &value);
 
     if (sfd->modifier == FLOWINT_MODIFIER_ISSET) {
-        SCLogDebug(" Isset %s? = %u", sfd->name,(fv) ? 1 : 0);
-        if (fv != NULL)
+        SCLogDebug(" Isset %s? = %u", sfd->name, isset);
+        if (isset)
             ret = 1;
         goto end;
     }
 
     if (sfd->modifier == FLOWINT_MODIFIER_NOTSET) {
-        SCLogDebug(" Not set %s? = %u", sfd->name,(fv) ? 0 : 1);
-        if (fv == NULL)
+        SCLogDebug(" Not set %s? = %u", sfd->name, !isset);
+        if (!isset)
             ret = 1;
         goto end;
     }
 
-    if (fv != NULL && fv->datatype == FLOWVAR_TYPE_INT) {
+    if (isset) {
         if (sfd->modifier == FLOWINT_MODIFIER_ADD) {
             SCLogDebug("Adding %u to %s", targetval, sfd->name);
-            FlowVarAddIntNoLock(p->flow, sfd->idx, fv->data.fv_int.value +
-                           targetval);
+            FlowVarAddIntNoLock(p->flow, sfd->idx, value + targetval);
             ret = 1;
             goto end;
         }
 
         if (sfd->modifier == FLOWINT_MODIFIER_SUB) {
             SCLogDebug("Substracting %u to %s", targetval, sfd->name);
-            FlowVarAddIntNoLock(p->flow, sfd->idx, fv->data.fv_int.value -
-                           targetval);
+            FlowVarAddIntNoLock(p->flow, sfd->idx, value - targetval);
             ret = 1;
             goto end;
         }
 
         switch(sfd->modifier) {
             case FLOWINT_MODIFIER_EQ:
-                SCLogDebug("( %u EQ %u )", fv->data.fv_int.value, targetval);
-                ret = (fv->data.fv_int.value == targetval);
+                SCLogDebug("( %u EQ %u )", value, targetval);
+                ret = (value == targetval);
                 break;
             case FLOWINT_MODIFIER_NE:
-                SCLogDebug("( %u NE %u )", fv->data.fv_int.value, targetval);
-                ret = (fv->data.fv_int.value != targetval);
+                SCLogDebug("( %u NE %u )", value, targetval);
+                ret = (value != targetval);
                 break;
             case FLOWINT_MODIFIER_LT:
-                SCLogDebug("( %u LT %u )", fv->data.fv_int.value, targetval);
-                ret = (fv->data.fv_int.value < targetval);
+                SCLogDebug("( %u LT %u )", value, targetval);
+                ret = (value < targetval);
                 break;
             case FLOWINT_MODIFIER_LE:
-                SCLogDebug("( %u LE %u )", fv->data.fv_int.value, targetval);
-                ret = (fv->data.fv_int.value <= targetval);
+                SCLogDebug("( %u LE %u )", value, targetval);
+                ret = (value <= targetval);
                 break;
             case FLOWINT_MODIFIER_GT:
-                SCLogDebug("( %u GT %u )", fv->data.fv_int.value, targetval);
-                ret = (fv->data.fv_int.value > targetval);
+                SCLogDebug("( %u GT %u )", value, targetval);
+                ret = (value > targetval);
                 break;
             case FLOWINT_MODIFIER_GE:
-                SCLogDebug("( %u GE %u )", fv->data.fv_int.value, targetval);
-                ret = (fv->data.fv_int.value >= targetval);
+                SCLogDebug("( %u GE %u )", value, targetval);
+                ret = (value >= targetval);
                 break;
             default:
                 SCLogDebug("Unknown Modifier!");
@@ -201,9 +195,7 @@ int DetectFlowintMatch(DetectEngineThreadCtx *det_ctx,
             ret = 1;
         } else {
             SCLogDebug("Var not found!");
-            /* It doesn't exist because it wasn't set
-             * or it is a string var, that we don't compare here
-             */
+            /* It doesn't exist because it wasn't set */
             ret = 0;
         }
     }
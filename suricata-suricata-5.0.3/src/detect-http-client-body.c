@@ -55,6 +55,7 @@
 #include "app-layer.h"
 #include "app-layer-parser.h"
 #include "app-layer-htp.h"
+#include "app-layer-htp-body.h"
 #include "detect-http-client-body.h"
 #include "stream-tcp.h"
 
@@ -255,8 +256,7 @@ static InspectionBuffer *HttpClientBodyGetDataCallback(DetectEngineThreadCtx *de
     const uint8_t *data;
     uint32_t data_len;
 
-    StreamingBufferGetDataAtOffset(body->sb,
-            &data, &data_len, offset);
+    HtpBodyGetDataAtOffset(body, &data, &data_len, offset);
     InspectionBufferSetup(buffer, data, data_len);
     buffer->inspect_offset = offset;
 
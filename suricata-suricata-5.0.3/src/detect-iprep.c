@@ -55,7 +55,7 @@ static pcre_extra *parse_regex_study;
 static int DetectIPRepMatch (DetectEngineThreadCtx *, Packet *,
         const Signature *, const SigMatchCtx *);
 static int DetectIPRepSetup (DetectEngineCtx *, Signature *, const char *);
-void DetectIPRepFree (void *);
+
 void IPRepRegisterTests(void);
 
 void DetectIPRepRegister (void)
@@ -164,44 +164,50 @@ static inline int RepMatch(uint8_t op, uint8_t val1, uint8_t val2)
     return 0;
 }
 
-/*
- * returns 0: no match
- *         1: match
- *        -1: error
- */
-static int DetectIPRepMatch (DetectEngineThreadCtx *det_ctx, Packet *p,
-        const Signature *s, const SigMatchCtx *ctx)
+static uint8_t GetRepSrc(const DetectEngineCtx *de_ctx, Packet *p, uint8_t cat)
 {
-    const DetectIPRepData *rd = (const DetectIPRepData *)ctx;
-    if (rd == NULL)
-        return 0;
+    uint8_t val = GetHostRepSrc(p, cat, de_ctx->srep_version);
+    if (val == 0 && de_ctx->srepCIDR_ctx != NULL)
+        val = SRepCIDRGetIPRepSrc(de_ctx->srepCIDR_ctx, p, cat, de_ctx->srep_version);
+    return val;
+}
 
-    uint32_t version = det_ctx->de_ctx->srep_version;
+static uint8_t GetRepDst(const DetectEngineCtx *de_ctx, Packet *p, uint8_t cat)
+{
+    uint8_t val = GetHostRepDst(p, cat, de_ctx->srep_version);
+    if (val == 0 && de_ctx->srepCIDR_ctx != NULL)
+        val = SRepCIDRGetIPRepDst(de_ctx->srepCIDR_ctx, p, cat, de_ctx->srep_version);
+    return val;
+}
+
+/**
+ * \brief match the packet's addresses against parsed iprep settings
+ *
+ * \retval 1 match
+ * \retval 0 no match
+ */
+int DetectIPRepMatchPacket(const DetectEngineCtx *de_ctx, Packet *p,
+        const DetectIPRepData *rd)
+{
     uint8_t val = 0;
 
     SCLogDebug("rd->cmd %u", rd->cmd);
     switch(rd->cmd) {
         case DETECT_IPREP_CMD_ANY:
-            val = GetHostRepSrc(p, rd->cat, version);
-            if (val == 0)
-                val = SRepCIDRGetIPRepSrc(det_ctx->de_ctx->srepCIDR_ctx, p, rd->cat, version);
+            val = GetRepSrc(de_ctx, p, rd->cat);
             if (val > 0) {
                 if (RepMatch(rd->op, val, rd->val) == 1)
                     return 1;
             }
-            val = GetHostRepDst(p, rd->cat, version);
-            if (val == 0)
-                val = SRepCIDRGetIPRepDst(det_ctx->de_ctx->srepCIDR_ctx, p, rd->cat, version);
+            val = GetRepDst(de_ctx, p, rd->cat);
             if (val > 0) {
                 return RepMatch(rd->op, val, rd->val);
             }
             break;
 
         case DETECT_IPREP_CMD_SRC:
-            val = GetHostRepSrc(p, rd->cat, version);
+            val = GetRepSrc(de_ctx, p, rd->cat);
             SCLogDebug("checking src -- val %u (looking for cat %u, val %u)", val, rd->cat, rd->val);
-            if (val == 0)
-                val = SRepCIDRGetIPRepSrc(det_ctx->de_ctx->srepCIDR_ctx, p, rd->cat, version);
             if (val > 0) {
                 return RepMatch(rd->op, val, rd->val);
             }
@@ -209,23 +215,17 @@ static int DetectIPRepMatch (DetectEngineThreadCtx *det_ctx, Packet *p,
 
         case DETECT_IPREP_CMD_DST:
             SCLogDebug("checking dst");
-            val = GetHostRepDst(p, rd->cat, version);
-            if (val == 0)
-                val = SRepCIDRGetIPRepDst(det_ctx->de_ctx->srepCIDR_ctx, p, rd->cat, version);
+            val = GetRepDst(de_ctx, p, rd->cat);
             if (val > 0) {
                 return RepMatch(rd->op, val, rd->val);
             }
             break;
 
         case DETECT_IPREP_CMD_BOTH:
-            val = GetHostRepSrc(p, rd->cat, version);
-            if (val == 0)
-                val = SRepCIDRGetIPRepSrc(det_ctx->de_ctx->srepCIDR_ctx, p, rd->cat, version);
+            val = GetRepSrc(de_ctx, p, rd->cat);
             if (val == 0 || RepMatch(rd->op, val, rd->val) == 0)
                 return 0;
-            val = GetHostRepDst(p, rd->cat, version);
-            if (val == 0)
-                val = SRepCIDRGetIPRepDst(det_ctx->de_ctx->srepCIDR_ctx, p, rd->cat, version);
+            val = GetRepDst(de_ctx, p, rd->cat);
             if (val > 0) {
                 return RepMatch(rd->op, val, rd->val);
             }
@@ -235,10 +235,30 @@ static int DetectIPRepMatch (DetectEngineThreadCtx *det_ctx, Packet *p,
     return 0;
 }
 
-int DetectIPRepSetup (DetectEngineCtx *de_ctx, Signature *s, const char *rawstr)
+/*
+ * returns 0: no match
+ *         1: match
+ *        -1: error
+ */
+static int DetectIPRepMatch (DetectEngineThreadCtx *det_ctx, Packet *p,
+        const Signature *s, const SigMatchCtx *ctx)
+{
+    const DetectIPRepData *rd = (const DetectIPRepData *)ctx;
+    if (rd == NULL)
+        return 0;
+
+    return DetectIPRepMatchPacket(det_ctx->de_ctx, p, rd);
+}
+
+/**
+ * \brief parse iprep settings: "<side>,<category>,<operator>,<value>"
+ *
+ * \retval rd parsed settings, free with DetectIPRepFree
+ * \retval NULL on error
+ */
+DetectIPRepData *DetectIPRepParse(const char *rawstr)
 {
     DetectIPRepData *cd = NULL;
-    SigMatch *sm = NULL;
     char *cmd_str = NULL, *name = NULL, *op_str = NULL, *value = NULL;
     uint8_t cmd = 0;
 #define MAX_SUBSTRINGS 30
@@ -248,14 +268,14 @@ int DetectIPRepSetup (DetectEngineCtx *de_ctx, Signature *s, const char *rawstr)
     ret = pcre_exec(parse_regex, parse_regex_study, rawstr, strlen(rawstr), 0, 0, ov, MAX_SUBSTRINGS);
     if (ret != 5) {
         SCLogError(SC_ERR_PCRE_MATCH, "\"%s\" is not a valid setting for iprep", rawstr);
-        return -1;
+        return NULL;
     }
 
     const char *str_ptr;
     res = pcre_get_substring((char *)rawstr, ov, MAX_SUBSTRINGS, 1, &str_ptr);
     if (res < 0) {
         SCLogError(SC_ERR_PCRE_GET_SUBSTRING, "pcre_get_substring failed");
-        return -1;
+        return NULL;
     }
     cmd_str = (char *)str_ptr;
 
@@ -348,18 +368,7 @@ int DetectIPRepSetup (DetectEngineCtx *de_ctx, Signature *s, const char *rawstr)
     pcre_free_substring(value);
     value = NULL;
 
-    /* Okay so far so good, lets get this into a SigMatch
-     * and put it in the Signature. */
-    sm = SigMatchAlloc();
-    if (sm == NULL)
-        goto error;
-
-    sm->type = DETECT_IPREP;
-    sm->ctx = (SigMatchCtx *)cd;
-
-    SigMatchAppendSMToList(s, sm, DETECT_SM_LIST_MATCH);
-
-    return 0;
+    return cd;
 
 error:
     if (name != NULL)
@@ -372,9 +381,29 @@ error:
         pcre_free_substring(value);
     if (cd != NULL)
         SCFree(cd);
-    if (sm != NULL)
-        SCFree(sm);
-    return -1;
+    return NULL;
+}
+
+int DetectIPRepSetup (DetectEngineCtx *de_ctx, Signature *s, const char *rawstr)
+{
+    DetectIPRepData *cd = DetectIPRepParse(rawstr);
+    if (cd == NULL)
+        return -1;
+
+    /* Okay so far so good, lets get this into a SigMatch
+     * and put it in the Signature. */
+    SigMatch *sm = SigMatchAlloc();
+    if (sm == NULL) {
+        SCFree(cd);
+        return -1;
+    }
+
+    sm->type = DETECT_IPREP;
+    sm->ctx = (SigMatchCtx *)cd;
+
+    SigMatchAppendSMToList(s, sm, DETECT_SM_LIST_MATCH);
+
+    return 0;
 }
 
 void DetectIPRepFree (void *ptr)
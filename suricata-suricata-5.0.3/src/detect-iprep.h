@@ -42,5 +42,9 @@ typedef struct DetectIPRepData_ {
 
 /* prototypes */
 void DetectIPRepRegister (void);
+DetectIPRepData *DetectIPRepParse(const char *rawstr);
+int DetectIPRepMatchPacket(const DetectEngineCtx *de_ctx, Packet *p,
+        const DetectIPRepData *rd);
+void DetectIPRepFree(void *ptr);
 
 #endif /* __DETECT_IPREP_H__ */
@@ -169,12 +169,14 @@ static int GetFlowVarByKey(lua_State *luastate, Flow *f, FlowVar **ret_fv)
 }
 
 static int GetFlowIntById(lua_State *luastate, Flow *f,
-        FlowVar **ret_fv, _Bool fv_may_be_null, uint32_t *ret_idx)
+        uint32_t *ret_value, _Bool *ret_isset, _Bool may_be_unset,
+        uint32_t *ret_idx)
 {
     DetectLuaData *ld = NULL;
     if (ret_idx)
         *ret_idx = 0;
-    *ret_fv = NULL;
+    *ret_value = 0;
+    *ret_isset = FALSE;
 
     /* need lua data for id -> idx conversion */
     int ret = GetLuaData(luastate, &ld);
@@ -192,11 +194,10 @@ static int GetFlowIntById(lua_State *luastate, Flow *f,
     if (idx == 0) {
         LUA_ERROR("flowvar id uninitialized");
     }
-    FlowVar *fv = FlowVarGet(f, idx);
-    if (!fv_may_be_null && fv == NULL) {
+    *ret_isset = FlowVarGetInt(f, idx, ret_value) ? TRUE : FALSE;
+    if (!may_be_unset && !*ret_isset) {
         LUA_ERROR("no flow var");
     }
-    *ret_fv = fv;
     if (ret_idx)
         *ret_idx = idx;
     return 0;
@@ -350,20 +351,18 @@ static int LuaSetFlowvar(lua_State *luastate)
 static int LuaGetFlowint(lua_State *luastate)
 {
     Flow *f;
-    FlowVar *fv;
     uint32_t number;
+    _Bool isset;
 
     /* need flow */
     int ret = GetFlow(luastate, &f);
     if (ret != 0)
         return ret;
 
-    ret = GetFlowIntById(luastate, f, &fv, FALSE, NULL);
+    ret = GetFlowIntById(luastate, f, &number, &isset, FALSE, NULL);
     if (ret != 0)
         return ret;
 
-    number = fv->data.fv_int.value;
-
     /* return value through luastate, as a luanumber */
     lua_pushnumber(luastate, (lua_Number)number);
     return 1;
@@ -420,24 +419,22 @@ static int LuaIncrFlowint(lua_State *luastate)
 {
     uint32_t idx;
     Flow *f;
-    FlowVar *fv;
     uint32_t number;
+    _Bool isset;
 
     /* need flow */
     int ret = GetFlow(luastate, &f);
     if (ret != 0)
         return ret;
 
-    ret = GetFlowIntById(luastate, f, &fv, TRUE, &idx);
+    ret = GetFlowIntById(luastate, f, &number, &isset, TRUE, &idx);
     if (ret != 0)
         return ret;
 
-    if (fv == NULL) {
+    if (!isset) {
         number = 1;
-    } else {
-        number = fv->data.fv_int.value;
-        if (number < UINT_MAX)
-            number++;
+    } else if (number < UINT_MAX) {
+        number++;
     }
     FlowVarAddIntNoLock(f, idx, number);
 
@@ -452,24 +449,22 @@ static int LuaDecrFlowint(lua_State *luastate)
 {
     uint32_t idx;
     Flow *f;
-    FlowVar *fv;
     uint32_t number;
+    _Bool isset;
 
     /* need flow */
     int ret = GetFlow(luastate, &f);
     if (ret != 0)
         return ret;
 
-    ret = GetFlowIntById(luastate, f, &fv, TRUE, &idx);
+    ret = GetFlowIntById(luastate, f, &number, &isset, TRUE, &idx);
     if (ret != 0)
         return ret;
 
-    if (fv == NULL) {
+    if (!isset) {
         number = 0;
-    } else {
-        number = fv->data.fv_int.value;
-        if (number > 0)
-            number--;
+    } else if (number > 0) {
+        number--;
     }
     FlowVarAddIntNoLock(f, idx, number);
 
@@ -1699,14 +1699,14 @@ static int LuaMatchTest04(void)
         goto end;
     }
 
-    FlowVar *fv = FlowVarGet(&f, 1);
-    if (fv == NULL) {
-        printf("no flowvar: ");
+    uint32_t value;
+    if (FlowVarGetInt(&f, 1, &value) == 0) {
+        printf("no flowint: ");
         goto end;
     }
 
-    if (fv->data.fv_int.value != 2) {
-        printf("%u != %u: ", fv->data.fv_int.value, 2);
+    if (value != 2) {
+        printf("%u != %u: ", value, 2);
         goto end;
     }
 
@@ -1849,14 +1849,14 @@ static int LuaMatchTest05(void)
         goto end;
     }
 
-    FlowVar *fv = FlowVarGet(&f, 1);
-    if (fv == NULL) {
-        printf("no flowvar: ");
+    uint32_t value;
+    if (FlowVarGetInt(&f, 1, &value) == 0) {
+        printf("no flowint: ");
         goto end;
     }
 
-    if (fv->data.fv_int.value != 2) {
-        printf("%u != %u: ", fv->data.fv_int.value, 2);
+    if (value != 2) {
+        printf("%u != %u: ", value, 2);
         goto end;
     }
 
@@ -2004,14 +2004,14 @@ static int LuaMatchTest06(void)
         goto end;
     }
 
-    FlowVar *fv = FlowVarGet(&f, 1);
-    if (fv == NULL) {
-        printf("no flowvar: ");
+    uint32_t value;
+    if (FlowVarGetInt(&f, 1, &value) == 0) {
+        printf("no flowint: ");
         goto end;
     }
 
-    if (fv->data.fv_int.value != 0) {
-        printf("%u != %u: ", fv->data.fv_int.value, 0);
+    if (value != 0) {
+        printf("%u != %u: ", value, 0);
         goto end;
     }
 
@@ -1415,18 +1415,10 @@ void SigFree(Signature *s)
     if (s->msg != NULL)
         SCFree(s->msg);
 
-    if (s->addr_src_match4 != NULL) {
-        SCFree(s->addr_src_match4);
-    }
-    if (s->addr_dst_match4 != NULL) {
-        SCFree(s->addr_dst_match4);
-    }
-    if (s->addr_src_match6 != NULL) {
-        SCFree(s->addr_src_match6);
-    }
-    if (s->addr_dst_match6 != NULL) {
-        SCFree(s->addr_dst_match6);
-    }
+    DetectAddressMatchIPv4Free(s->addr_src_match4, s->addr_src_match4_cnt);
+    DetectAddressMatchIPv4Free(s->addr_dst_match4, s->addr_dst_match4_cnt);
+    DetectAddressMatchIPv6Free(s->addr_src_match6, s->addr_src_match6_cnt);
+    DetectAddressMatchIPv6Free(s->addr_dst_match6, s->addr_dst_match6_cnt);
     if (s->sig_str != NULL) {
         SCFree(s->sig_str);
     }
@@ -1480,6 +1472,8 @@ int DetectSignatureSetAppProto(Signature *s, AppProto alproto)
  *  \internal
  *  \brief build address match array for cache efficient matching
  *
+ *  The arrays are sorted, so large ones can be binary searched.
+ *
  *  \param s the signature
  */
 static void SigBuildAddressMatchArray(Signature *s)
@@ -1502,7 +1496,10 @@ static void SigBuildAddressMatchArray(Signature *s)
             s->addr_src_match4[idx].ip2 = SCNtohl(da->ip2.addr_data32[0]);
             idx++;
         }
-        s->addr_src_match4_cnt = cnt;
+        s->addr_src_match4_cnt = DetectAddressMatchIPv4Prepare(&s->addr_src_match4, cnt);
+        if (s->addr_src_match4_cnt == 0) {
+            exit(EXIT_FAILURE);
+        }
     }
 
     /* destination addresses */
@@ -1523,7 +1520,10 @@ static void SigBuildAddressMatchArray(Signature *s)
             s->addr_dst_match4[idx].ip2 = SCNtohl(da->ip2.addr_data32[0]);
             idx++;
         }
-        s->addr_dst_match4_cnt = cnt;
+        s->addr_dst_match4_cnt = DetectAddressMatchIPv4Prepare(&s->addr_dst_match4, cnt);
+        if (s->addr_dst_match4_cnt == 0) {
+            exit(EXIT_FAILURE);
+        }
     }
 
     /* source addresses IPv6 */
@@ -1550,7 +1550,10 @@ static void SigBuildAddressMatchArray(Signature *s)
             s->addr_src_match6[idx].ip2[3] = SCNtohl(da->ip2.addr_data32[3]);
             idx++;
         }
-        s->addr_src_match6_cnt = cnt;
+        s->addr_src_match6_cnt = DetectAddressMatchIPv6Prepare(&s->addr_src_match6, cnt);
+        if (s->addr_src_match6_cnt == 0) {
+            exit(EXIT_FAILURE);
+        }
     }
 
     /* destination addresses IPv6 */
@@ -1577,7 +1580,10 @@ static void SigBuildAddressMatchArray(Signature *s)
             s->addr_dst_match6[idx].ip2[3] = SCNtohl(da->ip2.addr_data32[3]);
             idx++;
         }
-        s->addr_dst_match6_cnt = cnt;
+        s->addr_dst_match6_cnt = DetectAddressMatchIPv6Prepare(&s->addr_dst_match6, cnt);
+        if (s->addr_dst_match6_cnt == 0) {
+            exit(EXIT_FAILURE);
+        }
     }
 }
 
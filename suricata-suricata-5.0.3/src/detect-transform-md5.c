@@ -56,6 +56,7 @@ void DetectTransformMd5Register(void)
         DetectTransformToMd5RegisterTests;
 #endif
     sigmatch_table[DETECT_TRANSFORM_MD5].flags |= SIGMATCH_NOOPT;
+    sigmatch_table[DETECT_TRANSFORM_MD5].flags |= SIGMATCH_TRANSFORM_CACHE;
 }
 
 #ifndef HAVE_NSS
@@ -56,6 +56,7 @@ void DetectTransformSha1Register(void)
         DetectTransformToSha1RegisterTests;
 #endif
     sigmatch_table[DETECT_TRANSFORM_SHA1].flags |= SIGMATCH_NOOPT;
+    sigmatch_table[DETECT_TRANSFORM_SHA1].flags |= SIGMATCH_TRANSFORM_CACHE;
 }
 
 #ifndef HAVE_NSS
@@ -56,6 +56,7 @@ void DetectTransformSha256Register(void)
         DetectTransformToSha256RegisterTests;
 #endif
     sigmatch_table[DETECT_TRANSFORM_SHA256].flags |= SIGMATCH_NOOPT;
+    sigmatch_table[DETECT_TRANSFORM_SHA256].flags |= SIGMATCH_TRANSFORM_CACHE;
 }
 
 #ifndef HAVE_NSS
@@ -39,6 +39,7 @@
 
 #include "detect-engine-alert.h"
 #include "detect-engine-siggroup.h"
+#include "detect-engine-header.h"
 #include "detect-engine-address.h"
 #include "detect-engine-proto.h"
 #include "detect-engine-port.h"
@@ -585,7 +586,7 @@ static inline int DetectRunInspectRuleHeader(
     if ((p->flags & PKT_HAS_FLOW) && (sflags & SIG_FLAG_REQUIRE_FLOWVAR)) {
         DEBUG_VALIDATE_BUG_ON(f == NULL);
 
-        int m  = f->flowvar ? 1 : 0;
+        int m  = (f->flowvar || f->flowbits || f->flowints_cnt) ? 1 : 0;
 
         /* no flowvars? skip this sig */
         if (m == 0) {
@@ -689,6 +690,8 @@ static inline void DetectRunPrefilterPkt(
         PACKET_PROFILING_DETECT_START(p, PROF_DETECT_PF_SORT2);
         DetectPrefilterMergeSort(de_ctx, det_ctx);
         PACKET_PROFILING_DETECT_END(p, PROF_DETECT_PF_SORT2);
+
+        DetectHeaderFilter(det_ctx, scratch->sgh, p);
     }
 
 #ifdef PROFILING
@@ -882,8 +885,7 @@ static DetectRunScratchpad DetectRunSetup(
             pflow->sgh_toclient = NULL;
 
             pflow->de_ctx_version = de_ctx->version;
-            GenericVarFree(pflow->flowvar);
-            pflow->flowvar = NULL;
+            FlowFreeVars(pflow);
 
             DetectEngineStateResetTxs(pflow);
         }
@@ -963,64 +965,39 @@ static void DetectRunCleanup(DetectEngineThreadCtx *det_ctx,
     SCReturn;
 }
 
-void RuleMatchCandidateTxArrayInit(DetectEngineThreadCtx *det_ctx, uint32_t size)
+void RuleMatchCandidateTxBitsInit(DetectEngineThreadCtx *det_ctx, uint32_t size)
 {
-    DEBUG_VALIDATE_BUG_ON(det_ctx->tx_candidates);
-    det_ctx->tx_candidates = SCCalloc(size, sizeof(RuleMatchCandidateTx));
-    if (det_ctx->tx_candidates == NULL) {
+    DEBUG_VALIDATE_BUG_ON(det_ctx->tx_candidate_bits);
+    const uint32_t words = (size + 31) / 32;
+    det_ctx->tx_candidate_bits = SCCalloc(words, sizeof(uint32_t));
+    if (det_ctx->tx_candidate_bits == NULL) {
         FatalError(SC_ERR_MEM_ALLOC, "failed to allocate %"PRIu64" bytes",
-                (uint64_t)(size * sizeof(RuleMatchCandidateTx)));
+                (uint64_t)(words * sizeof(uint32_t)));
     }
-    det_ctx->tx_candidates_size = size;
-    SCLogDebug("array initialized to %u elements (%"PRIu64" bytes)",
-            size, (uint64_t)(size * sizeof(RuleMatchCandidateTx)));
+    det_ctx->tx_candidate_bits_size = words;
+    SCLogDebug("bitmap initialized for %u rules (%"PRIu64" bytes)",
+            size, (uint64_t)(words * sizeof(uint32_t)));
 }
 
-void RuleMatchCandidateTxArrayFree(DetectEngineThreadCtx *det_ctx)
+void RuleMatchCandidateTxBitsFree(DetectEngineThreadCtx *det_ctx)
 {
-    SCFree(det_ctx->tx_candidates);
-    det_ctx->tx_candidates_size = 0;
-}
-
-/* if size >= cur_space */
-static inline bool RuleMatchCandidateTxArrayHasSpace(const DetectEngineThreadCtx *det_ctx,
-        const uint32_t need)
-{
-    if (det_ctx->tx_candidates_size >= need)
-        return 1;
-    return 0;
+    SCFree(det_ctx->tx_candidate_bits);
+    det_ctx->tx_candidate_bits = NULL;
+    det_ctx->tx_candidate_bits_size = 0;
 }
 
 /* realloc */
-static int RuleMatchCandidateTxArrayExpand(DetectEngineThreadCtx *det_ctx, const uint32_t needed)
+static void RuleMatchCandidateTxBitsExpand(DetectEngineThreadCtx *det_ctx,
+        const uint32_t words)
 {
-    const uint32_t old_size = det_ctx->tx_candidates_size;
-    uint32_t new_size = needed;
-    void *ptmp = SCRealloc(det_ctx->tx_candidates, (new_size * sizeof(RuleMatchCandidateTx)));
+    void *ptmp = SCRealloc(det_ctx->tx_candidate_bits, words * sizeof(uint32_t));
     if (ptmp == NULL) {
         FatalError(SC_ERR_MEM_ALLOC, "failed to expand to %"PRIu64" bytes",
-                (uint64_t)(new_size * sizeof(RuleMatchCandidateTx)));
-        // TODO can this be handled more gracefully?
+                (uint64_t)(words * sizeof(uint32_t)));
     }
-    det_ctx->tx_candidates = ptmp;
-    det_ctx->tx_candidates_size = new_size;
-    SCLogDebug("array expanded from %u to %u elements (%"PRIu64" bytes -> %"PRIu64" bytes)",
-            old_size, new_size, (uint64_t)(old_size * sizeof(RuleMatchCandidateTx)),
-            (uint64_t)(new_size * sizeof(RuleMatchCandidateTx))); (void)old_size;
-    return 1;
-}
-
-
-/* TODO maybe let one with flags win if equal? */
-static int
-DetectRunTxSortHelper(const void *a, const void *b)
-{
-    const RuleMatchCandidateTx *s0 = a;
-    const RuleMatchCandidateTx *s1 = b;
-    if (s1->id == s0->id)
-        return 0;
-    else
-        return s0->id > s1->id ? -1 : 1;
+    det_ctx->tx_candidate_bits = ptmp;
+    det_ctx->tx_candidate_bits_size = words;
+    SCLogDebug("bitmap expanded to %u words", words);
 }
 
 #if 0
@@ -1300,11 +1277,25 @@ static void DetectRunTx(ThreadVars *tv,
         }
         tx_id_min = tx.tx_id + 1; // next look for cur + 1
 
-        uint32_t array_idx = 0;
-        uint32_t total_rules = det_ctx->match_array_cnt;
-        total_rules += (tx.de_state ? tx.de_state->cnt : 0);
+        /* let the buffer getters cache transformed buffers in the tx */
+        det_ctx->buffer_cache.f = f;
+        det_ctx->buffer_cache.tx_ptr = tx.tx_ptr;
+        det_ctx->buffer_cache.de_state = tx.de_state;
+        det_ctx->buffer_cache.tx_progress = tx.tx_progress;
+        det_ctx->buffer_cache.flow_flags = flow_flags;
+
+        /* candidates are gathered in a bitmap indexed like
+         * sgh->state_sig_array, so merging and deduplicating them
+         * is a matter of or'ing bits */
+        const uint32_t bits_size = (sgh->state_sig_cnt + 31) / 32;
+        if (unlikely(bits_size > det_ctx->tx_candidate_bits_size)) {
+            RuleMatchCandidateTxBitsExpand(det_ctx, bits_size);
+        }
+        uint32_t * const bits = det_ctx->tx_candidate_bits;
+        if (bits_size > 0)
+            memset(bits, 0, bits_size * sizeof(uint32_t));
 
-        /* run prefilter engines and merge results into a candidates array */
+        /* run prefilter engines and merge results into the candidates */
         if (sgh->tx_engines) {
             PACKET_PROFILING_DETECT_START(p, PROF_DETECT_PF_TX);
             DetectRunPrefilterTx(det_ctx, sgh, p, ipproto, flow_flags, alproto,
@@ -1313,165 +1304,114 @@ static void DetectRunTx(ThreadVars *tv,
             SCLogDebug("%p/%"PRIu64" rules added from prefilter: %u candidates",
                     tx.tx_ptr, tx.tx_id, det_ctx->pmq.rule_id_array_cnt);
 
-            total_rules += det_ctx->pmq.rule_id_array_cnt;
-            if (!(RuleMatchCandidateTxArrayHasSpace(det_ctx, total_rules))) {
-                RuleMatchCandidateTxArrayExpand(det_ctx, total_rules);
-            }
-
             for (uint32_t i = 0; i < det_ctx->pmq.rule_id_array_cnt; i++) {
-                const Signature *s = de_ctx->sig_array[det_ctx->pmq.rule_id_array[i]];
-                const SigIntId id = s->num;
-                det_ctx->tx_candidates[array_idx].s = s;
-                det_ctx->tx_candidates[array_idx].id = id;
-                det_ctx->tx_candidates[array_idx].flags = NULL;
-                det_ctx->tx_candidates[array_idx].stream_reset = 0;
-                array_idx++;
-            }
-        } else {
-            if (!(RuleMatchCandidateTxArrayHasSpace(det_ctx, total_rules))) {
-                RuleMatchCandidateTxArrayExpand(det_ctx, total_rules);
+                uint32_t idx;
+                if (SigGroupHeadGetStateIdx(sgh, det_ctx->pmq.rule_id_array[i], &idx)) {
+                    bits[idx / 32] |= BIT_U32(idx % 32);
+                }
             }
         }
 
         /* merge 'state' rules from the regular prefilter */
-        uint32_t x = array_idx;
         for (uint32_t i = 0; i < det_ctx->match_array_cnt; i++) {
             const Signature *s = det_ctx->match_array[i];
             if (s->app_inspect != NULL) {
-                const SigIntId id = s->num;
-                det_ctx->tx_candidates[array_idx].s = s;
-                det_ctx->tx_candidates[array_idx].id = id;
-                det_ctx->tx_candidates[array_idx].flags = NULL;
-                det_ctx->tx_candidates[array_idx].stream_reset = 0;
-                array_idx++;
-
-                SCLogDebug("%p/%"PRIu64" rule %u (%u) added from 'match' list",
-                        tx.tx_ptr, tx.tx_id, s->id, id);
+                uint32_t idx;
+                if (SigGroupHeadGetStateIdx(sgh, s->num, &idx)) {
+                    bits[idx / 32] |= BIT_U32(idx % 32);
+
+                    SCLogDebug("%p/%"PRIu64" rule %u (%u) added from 'match' list",
+                            tx.tx_ptr, tx.tx_id, s->id, s->num);
+                }
             }
         }
-        SCLogDebug("%p/%"PRIu64" rules added from 'match' list: %u",
-                tx.tx_ptr, tx.tx_id, array_idx - x); (void)x;
 
-        /* merge stored state into results */
+        /* merge stored state into the candidates and drop the rules
+         * that are done for this tx */
         if (tx.de_state != NULL) {
-            const uint32_t old = array_idx;
+            if (tx.de_state->sgh != sgh) {
+                DeStateDirectionSetRuleGroup(tx.de_state, sgh);
+            }
 
-            /* if tx.de_state->flags has 'new file' set and sig below has
-             * 'file inspected' flag, reset the file part of the state */
-            const bool have_new_file = (tx.de_state->flags & DETECT_ENGINE_STATE_FLAG_FILE_NEW);
-            if (have_new_file) {
+            /* if tx.de_state->flags has 'new file' set, reset the file
+             * part of the state of the file inspecting rules */
+            if (tx.de_state->flags & DETECT_ENGINE_STATE_FLAG_FILE_NEW) {
                 SCLogDebug("%p/%"PRIu64" destate: need to consider new file",
                         tx.tx_ptr, tx.tx_id);
                 tx.de_state->flags &= ~DETECT_ENGINE_STATE_FLAG_FILE_NEW;
+                DeStateDirectionResetFiles(tx.de_state);
             }
 
-            SigIntId state_cnt = 0;
-            DeStateStore *tx_store = tx.de_state->head;
-            for (; tx_store != NULL; tx_store = tx_store->next) {
-                SCLogDebug("tx_store %p", tx_store);
-
-                SigIntId store_cnt = 0;
-                for (store_cnt = 0;
-                        store_cnt < DE_STATE_CHUNK_SIZE && state_cnt < tx.de_state->cnt;
-                        store_cnt++, state_cnt++)
-                {
-                    DeStateStoreItem *item = &tx_store->store[store_cnt];
-                    SCLogDebug("rule id %u, inspect_flags %u", item->sid, item->flags);
-                    if (have_new_file && (item->flags & DE_STATE_FLAG_FILE_INSPECT)) {
-                        /* remove part of the state. File inspect engine will now
-                         * be able to run again */
-                        item->flags &= ~(DE_STATE_FLAG_SIG_CANT_MATCH|DE_STATE_FLAG_FULL_INSPECT|DE_STATE_FLAG_FILE_INSPECT);
-                        SCLogDebug("rule id %u, post file reset inspect_flags %u", item->sid, item->flags);
-                    }
-                    det_ctx->tx_candidates[array_idx].s = de_ctx->sig_array[item->sid];
-                    det_ctx->tx_candidates[array_idx].id = item->sid;
-                    det_ctx->tx_candidates[array_idx].flags = &item->flags;
-                    det_ctx->tx_candidates[array_idx].stream_reset = 0;
-                    array_idx++;
-                }
-            }
-            if (old && old != array_idx) {
-                qsort(det_ctx->tx_candidates, array_idx, sizeof(RuleMatchCandidateTx),
-                        DetectRunTxSortHelper);
-
-                SCLogDebug("%p/%"PRIu64" rules added from 'continue' list: %u",
-                        tx.tx_ptr, tx.tx_id, array_idx - old);
+            const uint32_t state_size = MIN(tx.de_state->bits_size, bits_size);
+            for (uint32_t w = 0; w < state_size; w++) {
+                bits[w] = (bits[w] | tx.de_state->bits[w].stored) &
+                    ~tx.de_state->bits[w].done;
             }
+            SCLogDebug("%p/%"PRIu64" rules in 'continue' list: %u",
+                    tx.tx_ptr, tx.tx_id, tx.de_state->cnt);
         }
 
         det_ctx->tx_id = tx.tx_id;
         det_ctx->tx_id_set = 1;
         det_ctx->p = p;
 
-        /* run rules: inspect the match candidates */
-        for (uint32_t i = 0; i < array_idx; i++) {
-            RuleMatchCandidateTx *can = &det_ctx->tx_candidates[i];
-            const Signature *s = det_ctx->tx_candidates[i].s;
-            uint32_t *inspect_flags = det_ctx->tx_candidates[i].flags;
-
-            /* deduplicate: rules_array is sorted, but not deduplicated:
-             * both mpm and stored state could give us the same sid.
-             * As they are back to back in that case we can check for it
-             * here. We select the stored state one. */
-            if ((i + 1) < array_idx) {
-                if (det_ctx->tx_candidates[i].s == det_ctx->tx_candidates[i+1].s) {
-                    if (det_ctx->tx_candidates[i].flags != NULL) {
-                        i++;
-                        SCLogDebug("%p/%"PRIu64" inspecting SKIP NEXT: sid %u (%u), flags %08x",
-                                tx.tx_ptr, tx.tx_id, s->id, s->num, inspect_flags ? *inspect_flags : 0);
-                    } else if (det_ctx->tx_candidates[i+1].flags != NULL) {
-                        SCLogDebug("%p/%"PRIu64" inspecting SKIP CURRENT: sid %u (%u), flags %08x",
-                                tx.tx_ptr, tx.tx_id, s->id, s->num, inspect_flags ? *inspect_flags : 0);
-                        continue;
-                    } else {
-                        // if it's all the same, inspect the current one and skip next.
-                        i++;
-                        SCLogDebug("%p/%"PRIu64" inspecting SKIP NEXT: sid %u (%u), flags %08x",
-                                tx.tx_ptr, tx.tx_id, s->id, s->num, inspect_flags ? *inspect_flags : 0);
-                    }
+        /* run rules: inspect the match candidates in sgh index order,
+         * which is the order of the internal ids. The store is ordered
+         * the same way, so stored items are found by walking along. */
+        SigIntId store_idx = 0;
+        for (uint32_t w = 0; w < bits_size; w++) {
+            uint32_t word = bits[w];
+            while (word != 0) {
+                const uint32_t idx = w * 32 + __builtin_ctz(word);
+                word &= word - 1;
+
+                const Signature *s = de_ctx->sig_array[sgh->state_sig_array[idx]];
+                uint32_t *inspect_flags = NULL;
+                if (tx.de_state != NULL && DeStateDirectionIsStored(tx.de_state, idx)) {
+                    while (tx.de_state->store[store_idx].sid < s->num)
+                        store_idx++;
+                    DEBUG_VALIDATE_BUG_ON(tx.de_state->store[store_idx].sid != s->num);
+                    inspect_flags = &tx.de_state->store[store_idx].flags;
                 }
-            }
+                RuleMatchCandidateTx can = { .id = s->num, .flags = inspect_flags, .s = s };
 
-            SCLogDebug("%p/%"PRIu64" inspecting: sid %u (%u), flags %08x",
-                    tx.tx_ptr, tx.tx_id, s->id, s->num, inspect_flags ? *inspect_flags : 0);
+                SCLogDebug("%p/%"PRIu64" inspecting: sid %u (%u), flags %08x",
+                        tx.tx_ptr, tx.tx_id, s->id, s->num, inspect_flags ? *inspect_flags : 0);
 
-            if (inspect_flags) {
-                if (*inspect_flags & (DE_STATE_FLAG_FULL_INSPECT|DE_STATE_FLAG_SIG_CANT_MATCH)) {
-                    SCLogDebug("%p/%"PRIu64" inspecting: sid %u (%u), flags %08x ALREADY COMPLETE",
-                            tx.tx_ptr, tx.tx_id, s->id, s->num, *inspect_flags);
-                    continue;
+                if (inspect_flags) {
+                    /* continue previous inspection */
+                    SCLogDebug("%p/%"PRIu64" Continueing sid %u", tx.tx_ptr, tx.tx_id, s->id);
+                } else {
+                    /* start new inspection */
+                    SCLogDebug("%p/%"PRIu64" Start sid %u", tx.tx_ptr, tx.tx_id, s->id);
                 }
-            }
-
-            if (inspect_flags) {
-                /* continue previous inspection */
-                SCLogDebug("%p/%"PRIu64" Continueing sid %u", tx.tx_ptr, tx.tx_id, s->id);
-            } else {
-                /* start new inspection */
-                SCLogDebug("%p/%"PRIu64" Start sid %u", tx.tx_ptr, tx.tx_id, s->id);
-            }
 
-            /* call individual rule inspection */
-            RULE_PROFILING_START(p);
-            const int r = DetectRunTxInspectRule(tv, de_ctx, det_ctx, p, f, flow_flags,
-                    alstate, &tx, s, inspect_flags, can, scratch);
-            if (r == 1) {
-                /* match */
-                DetectRunPostMatch(tv, det_ctx, p, s);
-
-                uint8_t alert_flags = (PACKET_ALERT_FLAG_STATE_MATCH|PACKET_ALERT_FLAG_TX);
-                if (s->action & ACTION_DROP)
-                    alert_flags |= PACKET_ALERT_FLAG_DROP_FLOW;
-
-                SCLogDebug("%p/%"PRIu64" sig %u (%u) matched", tx.tx_ptr, tx.tx_id, s->id, s->num);
-                if (!(s->flags & SIG_FLAG_NOALERT)) {
-                    PacketAlertAppend(det_ctx, s, p, tx.tx_id, alert_flags);
-                } else {
-                    DetectSignatureApplyActions(p, s, alert_flags);
+                /* call individual rule inspection */
+                RULE_PROFILING_START(p);
+                const int r = DetectRunTxInspectRule(tv, de_ctx, det_ctx, p, f, flow_flags,
+                        alstate, &tx, s, inspect_flags, &can, scratch);
+                if (r == 1) {
+                    /* match */
+                    DetectRunPostMatch(tv, det_ctx, p, s);
+
+                    uint8_t alert_flags = (PACKET_ALERT_FLAG_STATE_MATCH|PACKET_ALERT_FLAG_TX);
+                    if (s->action & ACTION_DROP)
+                        alert_flags |= PACKET_ALERT_FLAG_DROP_FLOW;
+
+                    SCLogDebug("%p/%"PRIu64" sig %u (%u) matched", tx.tx_ptr, tx.tx_id, s->id, s->num);
+                    if (!(s->flags & SIG_FLAG_NOALERT)) {
+                        PacketAlertAppend(det_ctx, s, p, tx.tx_id, alert_flags);
+                    } else {
+                        DetectSignatureApplyActions(p, s, alert_flags);
+                    }
+                }
+                if (inspect_flags != NULL &&
+                        (*inspect_flags & (DE_STATE_FLAG_FULL_INSPECT|DE_STATE_FLAG_SIG_CANT_MATCH))) {
+                    DeStateDirectionSetDone(tx.de_state, idx);
                 }
+                DetectVarProcessList(det_ctx, p->flow, p);
+                RULE_PROFILING_END(det_ctx, s, r, p);
             }
-            DetectVarProcessList(det_ctx, p->flow, p);
-            RULE_PROFILING_END(det_ctx, s, r, p);
         }
 
         det_ctx->tx_id = 0;
@@ -1507,6 +1447,8 @@ static void DetectRunTx(ThreadVars *tv,
                     flow_flags, new_detect_flags);
         }
 next:
+        det_ctx->buffer_cache.tx_ptr = NULL;
+        det_ctx->buffer_cache.de_state = NULL;
         InspectionBufferClean(det_ctx);
 
         if (!ires.has_next)
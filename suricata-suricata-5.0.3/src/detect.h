@@ -726,6 +726,10 @@ typedef struct SigFileLoaderStat_ {
     int total_files;
     int good_sigs_total;
     int bad_sigs_total;
+    /* rule changes compared to the engine this one replaced on reload */
+    int added_sigs_total;
+    int removed_sigs_total;
+    int changed_sigs_total;
 } SigFileLoaderStat;
 
 typedef struct DetectEngineThreadKeywordCtxItem_ {
@@ -783,6 +787,10 @@ typedef struct DetectEngineCtx_ {
      *  used to alloc det_ctx::non_mpm_id_array */
     uint32_t non_pf_store_cnt_max;
 
+    /** Maximum value of all our sgh's state_sig_cnt setting,
+     *  used to alloc det_ctx::tx_candidate_bits */
+    uint32_t state_sig_cnt_max;
+
     /* used by the signature ordering module */
     struct SCSigOrderFunc_ *sc_sig_order_funcs;
 
@@ -801,6 +809,12 @@ typedef struct DetectEngineCtx_ {
 
     HashListTable *mpm_hash_table;
 
+    /* mpm ctxs waiting for their Prepare, which is run for all of them at
+     * the end of the build */
+    MpmCtx **mpm_prepare_queue;
+    uint32_t mpm_prepare_queue_cnt;
+    uint32_t mpm_prepare_queue_size;
+
     /* hash table used to cull out duplicate sigs */
     HashListTable *dup_sig_hash_table;
 
@@ -824,6 +838,8 @@ typedef struct DetectEngineCtx_ {
 
     /* max flowbit id that is used */
     uint32_t max_fb_id;
+    /* flowbits bitset size to allocate for a flow, see FlowBitPreallocSize */
+    uint16_t flowbits_prealloc;
 
     uint32_t max_fp_id;
 
@@ -1063,6 +1079,16 @@ typedef struct DetectEngineThreadCtx_ {
         uint32_t *to_clear_queue;
     } multi_inspect;
 
+    /** tx whose detect state caches its transformed buffers, set while
+     *  the tx is inspected. See InspectionBufferSetupAndApplyTransforms() */
+    struct {
+        Flow *f;
+        void *tx_ptr;
+        struct DetectEngineStateDirection_ *de_state; /**< NULL until needed */
+        int tx_progress;
+        uint8_t flow_flags;
+    } buffer_cache;
+
     /* used to discontinue any more matching */
     uint16_t discontinue_matching;
     uint16_t flags;
@@ -1087,8 +1113,10 @@ typedef struct DetectEngineThreadCtx_ {
     /** size in use */
     SigIntId match_array_cnt;
 
-    RuleMatchCandidateTx *tx_candidates;
-    uint32_t tx_candidates_size;
+    /** bitmap of the tx inspection candidates, indexed like
+     *  SigGroupHead::state_sig_array */
+    uint32_t *tx_candidate_bits;
+    uint32_t tx_candidate_bits_size; /**< size in 32 bit words */
 
     SignatureNonPrefilterStore *non_pf_store_ptr;
     uint32_t non_pf_store_cnt;
@@ -1351,6 +1379,11 @@ typedef struct SigGroupHead_ {
      *  set. */
     uint16_t filestore_cnt;
 
+    /** SGH_INSPECT_* flags of the signatures that can match any flow, as
+     *  they have no app proto, address, port or ip version restriction.
+     *  See SigGroupHeadCanMatch. */
+    uint8_t inspect_any;
+
     uint32_t id; /**< unique id used to index sgh_array for stats */
 
     PrefilterEngine *pkt_engines;
@@ -1360,6 +1393,16 @@ typedef struct SigGroupHead_ {
     /** Array with sig ptrs... size is sig_cnt * sizeof(Signature *) */
     Signature **match_array;
 
+    /** internal ids of the signatures in match_array that have app-layer
+     *  inspection engines, in ascending order. The position of a signature
+     *  in this array is its index in the per tx inspection state. */
+    SigIntId *state_sig_array;
+    uint32_t state_sig_cnt;
+
+    /** port and IPv4 address filter for the candidates of a packet,
+     *  NULL if the group doesn't have one. See detect-engine-header.c */
+    struct SigGroupHeadHeaderFilter_ *header_filter;
+
     /* ptr to our init data we only use at... init :) */
     SigGroupHeadInitData *init;
 
@@ -1395,6 +1438,9 @@ typedef struct SigGroupHead_ {
 #define SIGMATCH_INFO_DEPRECATED        BIT_U16(10)
 /** strict parsing is enabled */
 #define SIGMATCH_STRICT_PARSING         BIT_U16(11)
+/** transform is costly enough to cache its result with the tx, see
+ *  InspectionBufferSetupAndApplyTransforms */
+#define SIGMATCH_TRANSFORM_CACHE        BIT_U16(12)
 
 enum DetectEngineTenantSelectors
 {
@@ -1482,8 +1528,8 @@ void *DetectThreadCtxGetKeywordThreadCtx(DetectEngineThreadCtx *, int);
 
 void DetectSignatureApplyActions(Packet *p, const Signature *s, const uint8_t);
 
-void RuleMatchCandidateTxArrayInit(DetectEngineThreadCtx *det_ctx, uint32_t size);
-void RuleMatchCandidateTxArrayFree(DetectEngineThreadCtx *det_ctx);
+void RuleMatchCandidateTxBitsInit(DetectEngineThreadCtx *det_ctx, uint32_t size);
+void RuleMatchCandidateTxBitsFree(DetectEngineThreadCtx *det_ctx);
 
 void DetectFlowbitsAnalyze(DetectEngineCtx *de_ctx);
 
@@ -20,11 +20,8 @@
  *
  * \author Victor Julien <victor@inliniac.net>
  *
- * Implements per flow bits. Actually, not a bit,
- * but called that way because of Snort's flowbits.
- * It's a binary storage.
+ * Implements per flow bits as a bitset indexed by the variable id.
  *
- * \todo move away from a linked list implementation
  * \todo use different datatypes, such as string, int, etc.
  * \todo have more than one instance of the same var, and be able to match on a
  *       specific one, or one all at a time. So if a certain capture matches
@@ -42,97 +39,141 @@
 #include "util-debug.h"
 #include "util-unittest.h"
 
-/* get the flowbit with idx from the flow */
-static FlowBit *FlowBitGet(Flow *f, uint32_t idx)
+/** max size in 32 bit words of the bitset that is allocated up front */
+#define FLOWBITS_PREALLOC_MAX 32
+
+/** \brief get the bitset layout for a ruleset
+ *
+ *  If all flowbits of the ruleset fit in a small bitset it is allocated
+ *  completely when the first bit is set. Otherwise the bitset grows on
+ *  demand, so flows using only a few low ids stay small.
+ *
+ *  The result is kept per detection engine, so with multi tenancy each
+ *  tenant's rules set their own layout.
+ *
+ *  \param max_id highest flowbit variable id in use
+ *
+ *  \retval words size in 32 bit words to allocate for a flow's first
+ *          flowbit, 0 to grow on demand
+ */
+uint16_t FlowBitPreallocSize(uint32_t max_id)
 {
-    GenericVar *gv = f->flowvar;
-    for ( ; gv != NULL; gv = gv->next) {
-        if (gv->type == DETECT_FLOWBITS && gv->idx == idx) {
-            return (FlowBit *)gv;
-        }
-    }
+    const uint32_t words = max_id / 32 + 1;
+    return (uint16_t)(words <= FLOWBITS_PREALLOC_MAX ? words : 0);
+}
 
-    return NULL;
+/** \internal
+ *  \brief make sure the flowbits cover idx
+ *  \retval 0 ok
+ *  \retval -1 out of memory or idx out of range
+ */
+static int FlowBitGrow(Flow *f, uint32_t idx, uint16_t prealloc)
+{
+    const uint32_t word = idx / 32;
+    if (word >= UINT16_MAX)
+        return -1;
+
+    uint32_t size = MAX(word + 1, (uint32_t)prealloc);
+    if (f->flowbits_size > 0)
+        size = MAX(size, MIN((uint32_t)f->flowbits_size * 2, UINT16_MAX));
+
+    uint32_t *ptr = SCRealloc(f->flowbits, size * sizeof(uint32_t));
+    if (unlikely(ptr == NULL))
+        return -1;
+    memset(ptr + f->flowbits_size, 0, (size - f->flowbits_size) * sizeof(uint32_t));
+    f->flowbits = ptr;
+    f->flowbits_size = (uint16_t)size;
+    return 0;
 }
 
-/* add a flowbit to the flow */
-static void FlowBitAdd(Flow *f, uint32_t idx)
+static inline int FlowBitGet(const Flow *f, uint32_t idx)
 {
-    FlowBit *fb = FlowBitGet(f, idx);
-    if (fb == NULL) {
-        fb = SCMalloc(sizeof(FlowBit));
-        if (unlikely(fb == NULL))
-            return;
-
-        fb->type = DETECT_FLOWBITS;
-        fb->idx = idx;
-        fb->next = NULL;
-        GenericVarAppend(&f->flowvar, (GenericVar *)fb);
-    }
+    if (idx / 32 >= f->flowbits_size)
+        return 0;
+    return (f->flowbits[idx / 32] & (1U << (idx % 32))) != 0;
 }
 
-static void FlowBitRemove(Flow *f, uint32_t idx)
+/** \brief set a flowbit
+ *
+ *  \param prealloc bitset size in words to allocate if the flow has no
+ *         flowbits yet, see FlowBitPreallocSize()
+ */
+void FlowBitSetPrealloc(Flow *f, uint32_t idx, uint16_t prealloc)
 {
-    FlowBit *fb = FlowBitGet(f, idx);
-    if (fb == NULL)
+    if (idx / 32 >= f->flowbits_size && FlowBitGrow(f, idx, prealloc) < 0)
         return;
-
-    GenericVarRemove(&f->flowvar, (GenericVar *)fb);
-    FlowBitFree(fb);
+    f->flowbits[idx / 32] |= (1U << (idx % 32));
 }
 
 void FlowBitSet(Flow *f, uint32_t idx)
 {
-    FlowBitAdd(f, idx);
+    FlowBitSetPrealloc(f, idx, 0);
 }
 
 void FlowBitUnset(Flow *f, uint32_t idx)
 {
-    FlowBitRemove(f, idx);
+    if (idx / 32 >= f->flowbits_size)
+        return;
+    f->flowbits[idx / 32] &= ~(1U << (idx % 32));
 }
 
 void FlowBitToggle(Flow *f, uint32_t idx)
 {
-    FlowBit *fb = FlowBitGet(f, idx);
-    if (fb != NULL) {
-        FlowBitRemove(f, idx);
+    if (FlowBitGet(f, idx)) {
+        FlowBitUnset(f, idx);
     } else {
-        FlowBitAdd(f, idx);
+        FlowBitSet(f, idx);
     }
 }
 
 int FlowBitIsset(Flow *f, uint32_t idx)
 {
-    int r = 0;
-
-    FlowBit *fb = FlowBitGet(f, idx);
-    if (fb != NULL) {
-        r = 1;
-    }
-
-    return r;
+    return FlowBitGet(f, idx);
 }
 
 int FlowBitIsnotset(Flow *f, uint32_t idx)
 {
-    int r = 0;
+    return !FlowBitGet(f, idx);
+}
 
-    FlowBit *fb = FlowBitGet(f, idx);
-    if (fb == NULL) {
-        r = 1;
+/** \brief check if any flowbit is set */
+bool FlowBitHasAny(const Flow *f)
+{
+    for (uint16_t i = 0; i < f->flowbits_size; i++) {
+        if (f->flowbits[i] != 0)
+            return true;
     }
-
-    return r;
+    return false;
 }
 
-void FlowBitFree(FlowBit *fb)
+/** \brief get the next set flowbit
+ *
+ *  \param idx in: id to start from, out: id of the set flowbit
+ *  \retval 1 found a set flowbit
+ *  \retval 0 no more flowbits set
+ */
+int FlowBitGetNext(const Flow *f, uint32_t *idx)
 {
-    if (fb == NULL)
-        return;
-
-    SCFree(fb);
+    for (uint32_t i = *idx; i / 32 < f->flowbits_size; ) {
+        const uint32_t word = f->flowbits[i / 32] >> (i % 32);
+        if (word == 0) {
+            i = (i / 32 + 1) * 32;
+            continue;
+        }
+        *idx = i + __builtin_ctz(word);
+        return 1;
+    }
+    return 0;
 }
 
+void FlowBitFreeAll(Flow *f)
+{
+    if (f->flowbits != NULL) {
+        SCFree(f->flowbits);
+        f->flowbits = NULL;
+    }
+    f->flowbits_size = 0;
+}
 
 /* TESTS */
 #ifdef UNITTESTS
@@ -143,13 +184,13 @@ static int FlowBitTest01 (void)
     Flow f;
     memset(&f, 0, sizeof(Flow));
 
-    FlowBitAdd(&f, 0);
+    FlowBitSet(&f, 0);
 
-    FlowBit *fb = FlowBitGet(&f,0);
-    if (fb != NULL)
+    int fb = FlowBitGet(&f,0);
+    if (fb)
         ret = 1;
 
-    GenericVarFree(f.flowvar);
+    FlowBitFreeAll(&f);
     return ret;
 }
 
@@ -160,11 +201,11 @@ static int FlowBitTest02 (void)
     Flow f;
     memset(&f, 0, sizeof(Flow));
 
-    FlowBit *fb = FlowBitGet(&f,0);
-    if (fb == NULL)
+    int fb = FlowBitGet(&f,0);
+    if (!fb)
         ret = 1;
 
-    GenericVarFree(f.flowvar);
+    FlowBitFreeAll(&f);
     return ret;
 }
 
@@ -175,25 +216,25 @@ static int FlowBitTest03 (void)
     Flow f;
     memset(&f, 0, sizeof(Flow));
 
-    FlowBitAdd(&f, 0);
+    FlowBitSet(&f, 0);
 
-    FlowBit *fb = FlowBitGet(&f,0);
-    if (fb == NULL) {
+    int fb = FlowBitGet(&f,0);
+    if (!fb) {
         printf("fb == NULL although it was just added: ");
         goto end;
     }
 
-    FlowBitRemove(&f, 0);
+    FlowBitUnset(&f, 0);
 
     fb = FlowBitGet(&f,0);
-    if (fb != NULL) {
+    if (fb) {
         printf("fb != NULL although it was just removed: ");
         goto end;
     } else {
         ret = 1;
     }
 end:
-    GenericVarFree(f.flowvar);
+    FlowBitFreeAll(&f);
     return ret;
 }
 
@@ -204,16 +245,16 @@ static int FlowBitTest04 (void)
     Flow f;
     memset(&f, 0, sizeof(Flow));
 
-    FlowBitAdd(&f, 0);
-    FlowBitAdd(&f, 1);
-    FlowBitAdd(&f, 2);
-    FlowBitAdd(&f, 3);
+    FlowBitSet(&f, 0);
+    FlowBitSet(&f, 1);
+    FlowBitSet(&f, 2);
+    FlowBitSet(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f,0);
-    if (fb != NULL)
+    int fb = FlowBitGet(&f,0);
+    if (fb)
         ret = 1;
 
-    GenericVarFree(f.flowvar);
+    FlowBitFreeAll(&f);
     return ret;
 }
 
@@ -224,16 +265,16 @@ static int FlowBitTest05 (void)
     Flow f;
     memset(&f, 0, sizeof(Flow));
 
-    FlowBitAdd(&f, 0);
-    FlowBitAdd(&f, 1);
-    FlowBitAdd(&f, 2);
-    FlowBitAdd(&f, 3);
+    FlowBitSet(&f, 0);
+    FlowBitSet(&f, 1);
+    FlowBitSet(&f, 2);
+    FlowBitSet(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f,1);
-    if (fb != NULL)
+    int fb = FlowBitGet(&f,1);
+    if (fb)
         ret = 1;
 
-    GenericVarFree(f.flowvar);
+    FlowBitFreeAll(&f);
     return ret;
 }
 
@@ -244,16 +285,16 @@ static int FlowBitTest06 (void)
     Flow f;
     memset(&f, 0, sizeof(Flow));
 
-    FlowBitAdd(&f, 0);
-    FlowBitAdd(&f, 1);
-    FlowBitAdd(&f, 2);
-    FlowBitAdd(&f, 3);
+    FlowBitSet(&f, 0);
+    FlowBitSet(&f, 1);
+    FlowBitSet(&f, 2);
+    FlowBitSet(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f,2);
-    if (fb != NULL)
+    int fb = FlowBitGet(&f,2);
+    if (fb)
         ret = 1;
 
-    GenericVarFree(f.flowvar);
+    FlowBitFreeAll(&f);
     return ret;
 }
 
@@ -264,16 +305,16 @@ static int FlowBitTest07 (void)
     Flow f;
     memset(&f, 0, sizeof(Flow));
 
-    FlowBitAdd(&f, 0);
-    FlowBitAdd(&f, 1);
-    FlowBitAdd(&f, 2);
-    FlowBitAdd(&f, 3);
+    FlowBitSet(&f, 0);
+    FlowBitSet(&f, 1);
+    FlowBitSet(&f, 2);
+    FlowBitSet(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f,3);
-    if (fb != NULL)
+    int fb = FlowBitGet(&f,3);
+    if (fb)
         ret = 1;
 
-    GenericVarFree(f.flowvar);
+    FlowBitFreeAll(&f);
     return ret;
 }
 
@@ -284,26 +325,26 @@ static int FlowBitTest08 (void)
     Flow f;
     memset(&f, 0, sizeof(Flow));
 
-    FlowBitAdd(&f, 0);
-    FlowBitAdd(&f, 1);
-    FlowBitAdd(&f, 2);
-    FlowBitAdd(&f, 3);
+    FlowBitSet(&f, 0);
+    FlowBitSet(&f, 1);
+    FlowBitSet(&f, 2);
+    FlowBitSet(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f,0);
-    if (fb == NULL)
+    int fb = FlowBitGet(&f,0);
+    if (!fb)
         goto end;
 
-    FlowBitRemove(&f,0);
+    FlowBitUnset(&f,0);
 
     fb = FlowBitGet(&f,0);
-    if (fb != NULL) {
+    if (fb) {
         printf("fb != NULL even though it was removed: ");
         goto end;
     }
 
     ret = 1;
 end:
-    GenericVarFree(f.flowvar);
+    FlowBitFreeAll(&f);
     return ret;
 }
 
@@ -314,26 +355,26 @@ static int FlowBitTest09 (void)
     Flow f;
     memset(&f, 0, sizeof(Flow));
 
-    FlowBitAdd(&f, 0);
-    FlowBitAdd(&f, 1);
-    FlowBitAdd(&f, 2);
-    FlowBitAdd(&f, 3);
+    FlowBitSet(&f, 0);
+    FlowBitSet(&f, 1);
+    FlowBitSet(&f, 2);
+    FlowBitSet(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f,1);
-    if (fb == NULL)
+    int fb = FlowBitGet(&f,1);
+    if (!fb)
         goto end;
 
-    FlowBitRemove(&f,1);
+    FlowBitUnset(&f,1);
 
     fb = FlowBitGet(&f,1);
-    if (fb != NULL) {
+    if (fb) {
         printf("fb != NULL even though it was removed: ");
         goto end;
     }
 
     ret = 1;
 end:
-    GenericVarFree(f.flowvar);
+    FlowBitFreeAll(&f);
     return ret;
 }
 
@@ -344,26 +385,26 @@ static int FlowBitTest10 (void)
     Flow f;
     memset(&f, 0, sizeof(Flow));
 
-    FlowBitAdd(&f, 0);
-    FlowBitAdd(&f, 1);
-    FlowBitAdd(&f, 2);
-    FlowBitAdd(&f, 3);
+    FlowBitSet(&f, 0);
+    FlowBitSet(&f, 1);
+    FlowBitSet(&f, 2);
+    FlowBitSet(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f,2);
-    if (fb == NULL)
+    int fb = FlowBitGet(&f,2);
+    if (!fb)
         goto end;
 
-    FlowBitRemove(&f,2);
+    FlowBitUnset(&f,2);
 
     fb = FlowBitGet(&f,2);
-    if (fb != NULL) {
+    if (fb) {
         printf("fb != NULL even though it was removed: ");
         goto end;
     }
 
     ret = 1;
 end:
-    GenericVarFree(f.flowvar);
+    FlowBitFreeAll(&f);
     return ret;
 }
 
@@ -374,29 +415,92 @@ static int FlowBitTest11 (void)
     Flow f;
     memset(&f, 0, sizeof(Flow));
 
-    FlowBitAdd(&f, 0);
-    FlowBitAdd(&f, 1);
-    FlowBitAdd(&f, 2);
-    FlowBitAdd(&f, 3);
+    FlowBitSet(&f, 0);
+    FlowBitSet(&f, 1);
+    FlowBitSet(&f, 2);
+    FlowBitSet(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f,3);
-    if (fb == NULL)
+    int fb = FlowBitGet(&f,3);
+    if (!fb)
         goto end;
 
-    FlowBitRemove(&f,3);
+    FlowBitUnset(&f,3);
 
     fb = FlowBitGet(&f,3);
-    if (fb != NULL) {
+    if (fb) {
         printf("fb != NULL even though it was removed: ");
         goto end;
     }
 
     ret = 1;
 end:
-    GenericVarFree(f.flowvar);
+    FlowBitFreeAll(&f);
     return ret;
 }
 
+/** \test ids beyond the allocated bitset and walking the set bits */
+static int FlowBitTest12 (void)
+{
+    Flow f;
+    memset(&f, 0, sizeof(Flow));
+
+    FlowBitSet(&f, 3);
+    FlowBitSet(&f, 1000);
+    FlowBitSet(&f, 31);
+    FlowBitSet(&f, 32);
+    FAIL_IF_NOT(f.flowbits_size >= 1000 / 32 + 1);
+    FAIL_IF_NOT(FlowBitIsset(&f, 1000));
+    FAIL_IF_NOT(FlowBitIsnotset(&f, 999));
+    FAIL_IF_NOT(FlowBitIsnotset(&f, 100000));
+
+    uint32_t expect[] = { 3, 31, 32, 1000 };
+    uint32_t idx = 0;
+    for (int i = 0; i < 4; i++) {
+        FAIL_IF_NOT(FlowBitGetNext(&f, &idx) == 1);
+        FAIL_IF_NOT(idx == expect[i]);
+        idx++;
+    }
+    FAIL_IF_NOT(FlowBitGetNext(&f, &idx) == 0);
+
+    FlowBitToggle(&f, 1000);
+    FlowBitUnset(&f, 3);
+    FlowBitUnset(&f, 100000);
+    FAIL_IF_NOT(FlowBitIsnotset(&f, 1000));
+    FAIL_IF_NOT(FlowBitHasAny(&f));
+    FlowBitUnset(&f, 31);
+    FlowBitUnset(&f, 32);
+    FAIL_IF(FlowBitHasAny(&f));
+
+    FlowBitFreeAll(&f);
+    FAIL_IF_NOT(f.flowbits == NULL);
+    PASS;
+}
+
+/** \test bitset layouts */
+static int FlowBitTest13 (void)
+{
+    Flow f;
+    memset(&f, 0, sizeof(Flow));
+
+    FAIL_IF_NOT(FlowBitPreallocSize(0) == 1);
+    FAIL_IF_NOT(FlowBitPreallocSize(100) == 4);
+    FAIL_IF_NOT(FlowBitPreallocSize(FLOWBITS_PREALLOC_MAX * 32) == 0);
+
+    /* small ruleset: allocated in full by the first bit */
+    FlowBitSetPrealloc(&f, 1, FlowBitPreallocSize(100));
+    FAIL_IF_NOT(f.flowbits_size == 4);
+    FlowBitSetPrealloc(&f, 100, FlowBitPreallocSize(100));
+    FAIL_IF_NOT(f.flowbits_size == 4);
+    FlowBitFreeAll(&f);
+
+    /* large ruleset: grows on demand */
+    FlowBitSetPrealloc(&f, 1, FlowBitPreallocSize(10000));
+    FAIL_IF_NOT(f.flowbits_size == 1);
+    FAIL_IF_NOT(FlowBitIsset(&f, 1));
+    FlowBitFreeAll(&f);
+    PASS;
+}
+
 #endif /* UNITTESTS */
 
 void FlowBitRegisterTests(void)
@@ -413,6 +517,8 @@ void FlowBitRegisterTests(void)
     UtRegisterTest("FlowBitTest09", FlowBitTest09);
     UtRegisterTest("FlowBitTest10", FlowBitTest10);
     UtRegisterTest("FlowBitTest11", FlowBitTest11);
+    UtRegisterTest("FlowBitTest12", FlowBitTest12);
+    UtRegisterTest("FlowBitTest13", FlowBitTest13);
 #endif /* UNITTESTS */
 }
 
@@ -27,22 +27,17 @@
 #include "flow.h"
 #include "util-var.h"
 
-typedef struct FlowBit_ {
-    uint8_t type; /* type, DETECT_FLOWBITS in this case */
-    uint8_t pad[3];
-    uint32_t idx; /* name idx */
-    GenericVar *next; /* right now just implement this as a list,
-                       * in the long run we have think of something
-                       * faster. */
-} FlowBit;
-
-void FlowBitFree(FlowBit *);
 void FlowBitRegisterTests(void);
+uint16_t FlowBitPreallocSize(uint32_t max_id);
 
+void FlowBitSetPrealloc(Flow *, uint32_t, uint16_t);
 void FlowBitSet(Flow *, uint32_t);
 void FlowBitUnset(Flow *, uint32_t);
 void FlowBitToggle(Flow *, uint32_t);
 int FlowBitIsset(Flow *, uint32_t);
 int FlowBitIsnotset(Flow *, uint32_t);
+bool FlowBitHasAny(const Flow *);
+int FlowBitGetNext(const Flow *, uint32_t *);
+void FlowBitFreeAll(Flow *);
 #endif /* __FLOW_BIT_H__ */
 
@@ -0,0 +1,815 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Per flow bypass policies.
+ *
+ * Policies are read from the 'bypass-policy' section of the yaml and
+ * evaluated by the flow worker after detection. The first policy that
+ * matches a flow decides what happens to it:
+ *
+ * - bypass: the flow is handed to PacketBypassCallback, so it is either
+ *   bypassed by the capture method or locally by the flow engine.
+ * - truncate: reassembly, app-layer parsing and payload inspection stop
+ *   for the flow, header based signatures are still inspected.
+ *
+ * Unless disabled per policy, a flow is only considered if none of the
+ * signatures in the rule groups of the flow can still match it.
+ */
+
+#include "suricata-common.h"
+#include "suricata.h"
+#include "conf.h"
+#include "conf-yaml-loader.h"
+#include "decode.h"
+#include "flow.h"
+#include "flow-util.h"
+#include "flow-bypass-policy.h"
+#include "stream-tcp.h"
+#include "stream-tcp-private.h"
+#include "app-layer-protos.h"
+
+#include "detect.h"
+#include "detect-engine.h"
+#include "detect-parse.h"
+#include "detect-engine-port.h"
+#include "detect-engine-siggroup.h"
+#include "detect-iprep.h"
+
+#include "util-misc.h"
+#include "util-unittest.h"
+#include "util-unittest-helper.h"
+
+typedef struct BypassPolicy_ {
+    char *name;
+
+    /** app protos the policy applies to, unless 'any_alproto' */
+    uint8_t alprotos[(ALPROTO_MAX + 7) / 8];
+    bool any_alproto;
+
+    /** ports, either source or destination, NULL for any */
+    DetectPort *ports;
+
+    /** ip reputation condition, NULL if not set */
+    DetectIPRepData *iprep;
+
+    /** bytes in both directions before the policy applies */
+    uint64_t min_bytes;
+
+    /** only apply if no signature can match the flow anymore */
+    bool check_signatures;
+
+    enum BypassPolicyAction action;
+
+    struct BypassPolicy_ *next;
+} BypassPolicy;
+
+static BypassPolicy *policies = NULL;
+/** lowest min-bytes of all policies, to skip small flows quickly */
+static uint64_t policies_min_bytes = UINT64_MAX;
+static bool policies_enabled = false;
+
+static void BypassPolicyFree(BypassPolicy *pol)
+{
+    if (pol->name != NULL)
+        SCFree(pol->name);
+    if (pol->ports != NULL)
+        DetectPortCleanupList(NULL, pol->ports);
+    if (pol->iprep != NULL)
+        DetectIPRepFree(pol->iprep);
+    SCFree(pol);
+}
+
+static int BypassPolicyParseAppProto(BypassPolicy *pol, const ConfNode *node)
+{
+    if (node->val != NULL) {
+        AppProto alproto = StringToAppProto(node->val);
+        if (alproto == ALPROTO_UNKNOWN) {
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "bypass-policy %s: "
+                    "unknown app-proto \"%s\"", pol->name, node->val);
+            return -1;
+        }
+        pol->alprotos[alproto / 8] |= 1 << (alproto % 8);
+        return 0;
+    }
+
+    const ConfNode *child;
+    TAILQ_FOREACH(child, &node->head, next) {
+        if (BypassPolicyParseAppProto(pol, child) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ *  \brief Parse a single policy
+ *
+ *  \retval pol policy or NULL on error
+ */
+static BypassPolicy *BypassPolicyParse(const ConfNode *node, int idx)
+{
+    BypassPolicy *pol = SCCalloc(1, sizeof(*pol));
+    if (unlikely(pol == NULL))
+        return NULL;
+    pol->any_alproto = true;
+    pol->check_signatures = true;
+
+    const char *name = ConfNodeLookupChildValue(node, "name");
+    if (name != NULL) {
+        pol->name = SCStrdup(name);
+    } else {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%d", idx);
+        pol->name = SCStrdup(buf);
+    }
+    if (unlikely(pol->name == NULL))
+        goto error;
+
+    const ConfNode *alproto_node = ConfNodeLookupChild(node, "app-proto");
+    if (alproto_node != NULL) {
+        if (BypassPolicyParseAppProto(pol, alproto_node) < 0)
+            goto error;
+        pol->any_alproto = false;
+    }
+
+    const char *port = ConfNodeLookupChildValue(node, "port");
+    if (port != NULL) {
+        if (DetectPortParse(NULL, &pol->ports, port) < 0) {
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "bypass-policy %s: "
+                    "invalid port \"%s\"", pol->name, port);
+            goto error;
+        }
+    }
+
+    const char *iprep = ConfNodeLookupChildValue(node, "iprep");
+    if (iprep != NULL) {
+        pol->iprep = DetectIPRepParse(iprep);
+        if (pol->iprep == NULL) {
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "bypass-policy %s: "
+                    "invalid iprep \"%s\"", pol->name, iprep);
+            goto error;
+        }
+    }
+
+    const char *min_bytes = ConfNodeLookupChildValue(node, "min-bytes");
+    if (min_bytes != NULL) {
+        if (ParseSizeStringU64(min_bytes, &pol->min_bytes) < 0) {
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "bypass-policy %s: "
+                    "invalid min-bytes \"%s\"", pol->name, min_bytes);
+            goto error;
+        }
+    }
+
+    const char *check = ConfNodeLookupChildValue(node, "check-signatures");
+    if (check != NULL) {
+        pol->check_signatures = ConfValIsTrue(check);
+    }
+
+    const char *action = ConfNodeLookupChildValue(node, "action");
+    if (action == NULL) {
+        SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "bypass-policy %s: "
+                "no action", pol->name);
+        goto error;
+    } else if (strcasecmp(action, "bypass") == 0) {
+        pol->action = BYPASS_POLICY_ACTION_BYPASS;
+    } else if (strcasecmp(action, "truncate") == 0) {
+        pol->action = BYPASS_POLICY_ACTION_TRUNCATE;
+    } else {
+        SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "bypass-policy %s: "
+                "invalid action \"%s\", expected \"bypass\" or \"truncate\"",
+                pol->name, action);
+        goto error;
+    }
+
+    return pol;
+error:
+    BypassPolicyFree(pol);
+    return NULL;
+}
+
+/**
+ *  \brief Load the policies from a 'bypass-policy' node
+ *
+ *  \retval 0 ok (also if disabled)
+ *  \retval -1 error
+ */
+static int BypassPolicyLoad(const ConfNode *root)
+{
+    if (root == NULL || !ConfNodeChildValueIsTrue(root, "enabled"))
+        return 0;
+
+    const ConfNode *list = ConfNodeLookupChild(root, "policies");
+    if (list == NULL)
+        return 0;
+
+    BypassPolicy *tail = NULL;
+    const ConfNode *node;
+    int idx = 0;
+    TAILQ_FOREACH(node, &list->head, next) {
+        BypassPolicy *pol = BypassPolicyParse(node, idx++);
+        if (pol == NULL)
+            return -1;
+
+        if (tail == NULL)
+            policies = pol;
+        else
+            tail->next = pol;
+        tail = pol;
+
+        if (pol->min_bytes < policies_min_bytes)
+            policies_min_bytes = pol->min_bytes;
+        SCLogConfig("bypass-policy %s: %s after %"PRIu64" bytes", pol->name,
+                pol->action == BYPASS_POLICY_ACTION_BYPASS ? "bypass" : "truncate",
+                pol->min_bytes);
+    }
+
+    policies_enabled = (policies != NULL);
+    return 0;
+}
+
+/**
+ *  \brief Setup the bypass policies from the yaml
+ *
+ *  Needs to run after the detection engine is set up, as ip reputation
+ *  categories are loaded with it.
+ */
+void BypassPolicyInit(void)
+{
+    ConfNode *root = ConfGetNode("bypass-policy");
+    if (root == NULL)
+        return;
+
+    if (BypassPolicyLoad(root) < 0) {
+        FatalError(SC_ERR_INVALID_YAML_CONF_ENTRY,
+                "failed to setup bypass policies");
+    }
+}
+
+void BypassPolicyDestroy(void)
+{
+    BypassPolicy *pol = policies;
+    while (pol != NULL) {
+        BypassPolicy *next = pol->next;
+        BypassPolicyFree(pol);
+        pol = next;
+    }
+    policies = NULL;
+    policies_min_bytes = UINT64_MAX;
+    policies_enabled = false;
+}
+
+bool BypassPolicyEnabled(void)
+{
+    return policies_enabled;
+}
+
+/** \internal
+ *  \brief Get the inspection still done on a flow in a direction
+ *
+ *  \param direction STREAM_TOSERVER or STREAM_TOCLIENT
+ *
+ *  \retval inspect SGH_INSPECT_* flags
+ */
+static uint8_t FlowGetInspect(const Flow *f, uint8_t direction)
+{
+    if (f->flags & FLOW_NOPACKET_INSPECTION)
+        return 0;
+    if (f->flags & FLOW_NOPAYLOAD_INSPECTION)
+        return SGH_INSPECT_PACKET;
+
+    uint8_t inspect = SGH_INSPECT_PACKET|SGH_INSPECT_PAYLOAD;
+    bool applayer = (f->alproto != ALPROTO_FAILED);
+
+    if (f->proto == IPPROTO_TCP) {
+        const TcpSession *ssn = (const TcpSession *)f->protoctx;
+        if (ssn == NULL)
+            return inspect|SGH_INSPECT_STREAM|SGH_INSPECT_APPLAYER;
+
+        const TcpStream *stream = (direction & STREAM_TOSERVER) ?
+            &ssn->client : &ssn->server;
+        const uint32_t done = STREAMTCP_STREAM_FLAG_NOREASSEMBLY|
+            STREAMTCP_STREAM_FLAG_DEPTH_REACHED;
+        if (!(stream->flags & (done|STREAMTCP_STREAM_FLAG_NEW_RAW_DISABLED)))
+            inspect |= SGH_INSPECT_STREAM;
+
+        /* transactions can progress on data of either direction */
+        if ((ssn->flags & STREAMTCP_FLAG_APP_LAYER_DISABLED) ||
+                ((ssn->client.flags & done) && (ssn->server.flags & done)))
+            applayer = false;
+    }
+    if (applayer)
+        inspect |= SGH_INSPECT_APPLAYER;
+    return inspect;
+}
+
+/**
+ *  \brief Check if signatures can still match the flow
+ *
+ *  Until both directions have their rule group we don't know what
+ *  signatures apply, so we assume some do.
+ *
+ *  The verdict is stored in the flow and only checked again when the rule
+ *  groups, the app proto or the inspection still done on the flow change.
+ *
+ *  \param truncate only count signatures the truncate action would
+ *                  stop: the ones inspecting payload, stream or app-layer
+ *                  data
+ */
+static bool SignaturesCanMatch(const DetectEngineThreadCtx *det_ctx,
+        Flow *f, bool truncate)
+{
+    if (det_ctx == NULL)
+        return false;
+
+    if ((f->flags & (FLOW_SGH_TOSERVER|FLOW_SGH_TOCLIENT)) !=
+            (FLOW_SGH_TOSERVER|FLOW_SGH_TOCLIENT))
+        return true;
+
+    const uint8_t mask = truncate ? (uint8_t)~SGH_INSPECT_PACKET : 0xff;
+    const uint8_t inspect_ts = FlowGetInspect(f, STREAM_TOSERVER) & mask;
+    const uint8_t inspect_tc = FlowGetInspect(f, STREAM_TOCLIENT) & mask;
+
+    if (f->bypass_check_done &&
+            f->bypass_check_version == f->de_ctx_version &&
+            f->bypass_check_alproto == f->alproto &&
+            f->bypass_check_inspect[0] == inspect_ts &&
+            f->bypass_check_inspect[1] == inspect_tc)
+        return f->bypass_check_match;
+
+    f->bypass_check_match =
+        SigGroupHeadCanMatch(f->sgh_toserver, f, STREAM_TOSERVER, inspect_ts) ||
+        SigGroupHeadCanMatch(f->sgh_toclient, f, STREAM_TOCLIENT, inspect_tc);
+    f->bypass_check_done = true;
+    f->bypass_check_version = f->de_ctx_version;
+    f->bypass_check_alproto = f->alproto;
+    f->bypass_check_inspect[0] = inspect_ts;
+    f->bypass_check_inspect[1] = inspect_tc;
+    return f->bypass_check_match;
+}
+
+static bool BypassPolicyMatch(const BypassPolicy *pol,
+        DetectEngineThreadCtx *det_ctx, Packet *p, uint64_t bytes)
+{
+    Flow *f = p->flow;
+
+    if (bytes < pol->min_bytes)
+        return false;
+
+    /* already truncated */
+    if (pol->action == BYPASS_POLICY_ACTION_TRUNCATE &&
+            (f->flags & FLOW_NOPAYLOAD_INSPECTION))
+        return false;
+
+    if (!pol->any_alproto) {
+        const AppProto alproto = f->alproto;
+        if (alproto >= ALPROTO_MAX ||
+                !(pol->alprotos[alproto / 8] & (1 << (alproto % 8))))
+            return false;
+    }
+
+    if (pol->ports != NULL) {
+        if (!(p->proto == IPPROTO_TCP || p->proto == IPPROTO_UDP ||
+                    p->proto == IPPROTO_SCTP))
+            return false;
+        if (DetectPortLookupGroup(pol->ports, p->sp) == NULL &&
+                DetectPortLookupGroup(pol->ports, p->dp) == NULL)
+            return false;
+    }
+
+    if (pol->iprep != NULL) {
+        if (det_ctx == NULL ||
+                !DetectIPRepMatchPacket(det_ctx->de_ctx, p, pol->iprep))
+            return false;
+    }
+
+    if (pol->check_signatures &&
+            SignaturesCanMatch(det_ctx, f,
+                pol->action == BYPASS_POLICY_ACTION_TRUNCATE))
+        return false;
+
+    return true;
+}
+
+static void BypassPolicyTruncate(Flow *f)
+{
+    FlowSetNoPayloadInspectionFlag(f);
+
+    if (f->proto == IPPROTO_TCP && f->protoctx != NULL) {
+        TcpSession *ssn = (TcpSession *)f->protoctx;
+        StreamTcpSetSessionNoReassemblyFlag(ssn, 0);
+        StreamTcpSetSessionNoReassemblyFlag(ssn, 1);
+    }
+}
+
+/**
+ *  \brief Apply the first matching policy to the flow of a packet
+ *
+ *  \param det_ctx detection thread ctx, NULL if detection is disabled
+ *  \param p packet with locked flow
+ *
+ *  \retval action the action taken, BYPASS_POLICY_ACTION_NONE if no
+ *                 policy matched
+ */
+int BypassPolicyApply(DetectEngineThreadCtx *det_ctx, Packet *p)
+{
+    Flow *f = p->flow;
+    if (f == NULL || PKT_IS_PSEUDOPKT(p))
+        return BYPASS_POLICY_ACTION_NONE;
+
+    const uint64_t bytes = f->todstbytecnt + f->tosrcbytecnt;
+    if (bytes < policies_min_bytes)
+        return BYPASS_POLICY_ACTION_NONE;
+
+    for (const BypassPolicy *pol = policies; pol != NULL; pol = pol->next) {
+        if (!BypassPolicyMatch(pol, det_ctx, p, bytes))
+            continue;
+
+        SCLogDebug("flow %p: bypass-policy %s matched after %"PRIu64" bytes",
+                f, pol->name, bytes);
+        if (pol->action == BYPASS_POLICY_ACTION_BYPASS) {
+            PacketBypassCallback(p);
+        } else {
+            BypassPolicyTruncate(f);
+        }
+        return pol->action;
+    }
+    return BYPASS_POLICY_ACTION_NONE;
+}
+
+/********************************Unittests********************************/
+
+#ifdef UNITTESTS
+
+static int BypassPolicyLoadString(const char *yaml)
+{
+    ConfCreateContextBackup();
+    ConfInit();
+    ConfYamlLoadString(yaml, strlen(yaml));
+    int r = BypassPolicyLoad(ConfGetNode("bypass-policy"));
+    ConfDeInit();
+    ConfRestoreContextBackup();
+    return r;
+}
+
+static int BypassPolicyTest01(void)
+{
+    const char *yaml = "\
+%YAML 1.1\n\
+---\n\
+bypass-policy:\n\
+  enabled: yes\n\
+  policies:\n\
+    - name: backup\n\
+      app-proto: [smb, nfs]\n\
+      port: \"[445,2049]\"\n\
+      min-bytes: 1mb\n\
+      action: bypass\n\
+    - app-proto: http\n\
+      min-bytes: 64kb\n\
+      check-signatures: no\n\
+      action: truncate\n\
+";
+    FAIL_IF(BypassPolicyLoadString(yaml) != 0);
+    FAIL_IF_NOT(BypassPolicyEnabled());
+
+    const BypassPolicy *pol = policies;
+    FAIL_IF_NULL(pol);
+    FAIL_IF(strcmp(pol->name, "backup") != 0);
+    FAIL_IF(pol->any_alproto);
+    FAIL_IF_NOT(pol->alprotos[ALPROTO_SMB / 8] & (1 << (ALPROTO_SMB % 8)));
+    FAIL_IF_NOT(pol->alprotos[ALPROTO_NFS / 8] & (1 << (ALPROTO_NFS % 8)));
+    FAIL_IF(pol->alprotos[ALPROTO_HTTP / 8] & (1 << (ALPROTO_HTTP % 8)));
+    FAIL_IF_NULL(pol->ports);
+    FAIL_IF_NULL(DetectPortLookupGroup(pol->ports, 2049));
+    FAIL_IF_NOT_NULL(DetectPortLookupGroup(pol->ports, 80));
+    FAIL_IF(pol->min_bytes != 1024 * 1024);
+    FAIL_IF_NOT(pol->check_signatures);
+    FAIL_IF(pol->action != BYPASS_POLICY_ACTION_BYPASS);
+
+    pol = pol->next;
+    FAIL_IF_NULL(pol);
+    FAIL_IF(strcmp(pol->name, "1") != 0);
+    FAIL_IF(pol->check_signatures);
+    FAIL_IF(pol->action != BYPASS_POLICY_ACTION_TRUNCATE);
+    FAIL_IF_NOT_NULL(pol->next);
+
+    FAIL_IF(policies_min_bytes != 64 * 1024);
+
+    BypassPolicyDestroy();
+    FAIL_IF(BypassPolicyEnabled());
+    PASS;
+}
+
+/** \test invalid policies */
+static int BypassPolicyTest02(void)
+{
+    const char *yaml = "\
+%YAML 1.1\n\
+---\n\
+bypass-policy:\n\
+  enabled: yes\n\
+  policies:\n\
+    - app-proto: nosuchproto\n\
+      action: bypass\n\
+";
+    FAIL_IF(BypassPolicyLoadString(yaml) == 0);
+    BypassPolicyDestroy();
+
+    const char *yaml2 = "\
+%YAML 1.1\n\
+---\n\
+bypass-policy:\n\
+  enabled: yes\n\
+  policies:\n\
+    - port: 80\n\
+      action: drop\n\
+";
+    FAIL_IF(BypassPolicyLoadString(yaml2) == 0);
+    BypassPolicyDestroy();
+
+    const char *yaml3 = "\
+%YAML 1.1\n\
+---\n\
+bypass-policy:\n\
+  enabled: no\n\
+  policies:\n\
+    - port: 80\n\
+      action: bypass\n\
+";
+    FAIL_IF(BypassPolicyLoadString(yaml3) != 0);
+    FAIL_IF(BypassPolicyEnabled());
+    PASS;
+}
+
+/** \test policies applied to a flow */
+static int BypassPolicyTest03(void)
+{
+    const char *yaml = "\
+%YAML 1.1\n\
+---\n\
+bypass-policy:\n\
+  enabled: yes\n\
+  policies:\n\
+    - app-proto: http\n\
+      min-bytes: 1000\n\
+      action: truncate\n\
+    - port: 445\n\
+      min-bytes: 5000\n\
+      action: bypass\n\
+";
+    FAIL_IF(BypassPolicyLoadString(yaml) != 0);
+
+    Packet *p = UTHBuildPacketReal(NULL, 0, IPPROTO_TCP,
+            "1.2.3.4", "5.6.7.8", 1024, 445);
+    FAIL_IF_NULL(p);
+    Flow *f = UTHBuildFlow(AF_INET, "1.2.3.4", "5.6.7.8", 1024, 445);
+    FAIL_IF_NULL(f);
+    f->proto = IPPROTO_TCP;
+    f->alproto = ALPROTO_SMB;
+    p->flow = f;
+
+    /* below min-bytes of all policies */
+    f->todstbytecnt = 500;
+    FAIL_IF(BypassPolicyApply(NULL, p) != BYPASS_POLICY_ACTION_NONE);
+
+    /* http policy doesn't apply to smb */
+    f->tosrcbytecnt = 1000;
+    FAIL_IF(BypassPolicyApply(NULL, p) != BYPASS_POLICY_ACTION_NONE);
+
+    f->alproto = ALPROTO_HTTP;
+    FAIL_IF(BypassPolicyApply(NULL, p) != BYPASS_POLICY_ACTION_TRUNCATE);
+    FAIL_IF_NOT(f->flags & FLOW_NOPAYLOAD_INSPECTION);
+    /* already truncated */
+    FAIL_IF(BypassPolicyApply(NULL, p) != BYPASS_POLICY_ACTION_NONE);
+
+    f->tosrcbytecnt = 5000;
+    FAIL_IF(BypassPolicyApply(NULL, p) != BYPASS_POLICY_ACTION_BYPASS);
+    FAIL_IF(SC_ATOMIC_GET(f->flow_state) != FLOW_STATE_LOCAL_BYPASSED);
+
+    UTHFreeFlow(f);
+    UTHFreePacket(p);
+    BypassPolicyDestroy();
+    PASS;
+}
+
+/** \test signatures still matching the flow hold off the policy */
+static int BypassPolicyTest04(void)
+{
+    const char *yaml = "\
+%YAML 1.1\n\
+---\n\
+bypass-policy:\n\
+  enabled: yes\n\
+  policies:\n\
+    - port: 80\n\
+      action: truncate\n\
+";
+    FAIL_IF(BypassPolicyLoadString(yaml) != 0);
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+    Signature *s = DetectEngineAppendSig(de_ctx, "alert http any any -> any any "
+            "(http.uri; content:\"/index\"; sid:1;)");
+    FAIL_IF_NULL(s);
+    SigGroupBuild(de_ctx);
+
+    ThreadVars tv;
+    memset(&tv, 0, sizeof(tv));
+    DetectEngineThreadCtx *det_ctx = NULL;
+    DetectEngineThreadCtxInit(&tv, (void *)de_ctx, (void *)&det_ctx);
+    FAIL_IF_NULL(det_ctx);
+
+    Packet *p = UTHBuildPacketReal(NULL, 0, IPPROTO_TCP,
+            "1.2.3.4", "5.6.7.8", 1024, 80);
+    FAIL_IF_NULL(p);
+    Flow *f = UTHBuildFlow(AF_INET, "1.2.3.4", "5.6.7.8", 1024, 80);
+    FAIL_IF_NULL(f);
+    f->proto = IPPROTO_TCP;
+    f->alproto = ALPROTO_HTTP;
+    p->flow = f;
+
+    /* rule groups not set up yet */
+    FAIL_IF(BypassPolicyApply(det_ctx, p) != BYPASS_POLICY_ACTION_NONE);
+
+    const SigGroupHead *sgh = SigMatchSignaturesGetSgh(de_ctx, p);
+    FAIL_IF_NULL(sgh);
+    f->sgh_toserver = sgh;
+    f->sgh_toclient = sgh;
+    f->flags |= FLOW_SGH_TOSERVER|FLOW_SGH_TOCLIENT;
+    FAIL_IF(BypassPolicyApply(det_ctx, p) != BYPASS_POLICY_ACTION_NONE);
+
+    FAIL_IF_NOT(SigGroupHeadCanMatch(sgh, f, STREAM_TOSERVER, SGH_INSPECT_APPLAYER));
+    FAIL_IF(SigGroupHeadCanMatch(sgh, f, STREAM_TOSERVER, SGH_INSPECT_PACKET));
+
+    /* no signatures for smtp */
+    f->alproto = ALPROTO_SMTP;
+    FAIL_IF(SigGroupHeadCanMatch(sgh, f, STREAM_TOSERVER, SGH_INSPECT_APPLAYER));
+    FAIL_IF(BypassPolicyApply(det_ctx, p) != BYPASS_POLICY_ACTION_TRUNCATE);
+
+    UTHFreeFlow(f);
+    UTHFreePacket(p);
+    DetectEngineThreadCtxDeinit(&tv, (void *)det_ctx);
+    DetectEngineCtxFree(de_ctx);
+    BypassPolicyDestroy();
+    PASS;
+}
+
+/** \test mixed generic and app-layer rules: only the signatures that
+ *        can still match the flow hold off the policy */
+static int BypassPolicyTest05(void)
+{
+    const char *yaml = "\
+%YAML 1.1\n\
+---\n\
+bypass-policy:\n\
+  enabled: yes\n\
+  policies:\n\
+    - port: 80\n\
+      action: bypass\n\
+";
+    FAIL_IF(BypassPolicyLoadString(yaml) != 0);
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+    /* stream */
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp any any -> any 80 "
+            "(content:\"evil\"; sid:1;)"));
+    /* app-layer */
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert http any any -> any any "
+            "(http.uri; content:\"/index\"; sid:2;)"));
+    /* packet, but not for this flow */
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp 10.0.0.0/8 any -> any 80 "
+            "(flags:S; sid:3;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp any 1000:2000 -> any 80 "
+            "(flow:established; ttl:1; sid:4;)"));
+    SigGroupBuild(de_ctx);
+
+    ThreadVars tv;
+    memset(&tv, 0, sizeof(tv));
+    DetectEngineThreadCtx *det_ctx = NULL;
+    DetectEngineThreadCtxInit(&tv, (void *)de_ctx, (void *)&det_ctx);
+    FAIL_IF_NULL(det_ctx);
+
+    Packet *p = UTHBuildPacketReal(NULL, 0, IPPROTO_TCP,
+            "1.2.3.4", "5.6.7.8", 3000, 80);
+    FAIL_IF_NULL(p);
+    Flow *f = UTHBuildFlow(AF_INET, "1.2.3.4", "5.6.7.8", 3000, 80);
+    FAIL_IF_NULL(f);
+    TcpSession ssn;
+    memset(&ssn, 0, sizeof(ssn));
+    f->proto = IPPROTO_TCP;
+    f->protoctx = &ssn;
+    f->alproto = ALPROTO_HTTP;
+    p->flow = f;
+
+    const SigGroupHead *sgh = SigMatchSignaturesGetSgh(de_ctx, p);
+    FAIL_IF_NULL(sgh);
+    f->sgh_toserver = sgh;
+    f->sgh_toclient = NULL;
+    f->flags |= FLOW_SGH_TOSERVER|FLOW_SGH_TOCLIENT;
+
+    FAIL_IF_NOT(SigGroupHeadCanMatch(sgh, f, STREAM_TOSERVER, SGH_INSPECT_STREAM));
+    FAIL_IF_NOT(SigGroupHeadCanMatch(sgh, f, STREAM_TOSERVER, SGH_INSPECT_APPLAYER));
+    FAIL_IF(SigGroupHeadCanMatch(sgh, f, STREAM_TOSERVER, SGH_INSPECT_PAYLOAD));
+    /* sid 3 has the wrong source, sid 4 the wrong source port */
+    FAIL_IF(SigGroupHeadCanMatch(sgh, f, STREAM_TOSERVER, SGH_INSPECT_PACKET));
+    FAIL_IF(sgh->inspect_any != 0);
+    FAIL_IF(BypassPolicyApply(det_ctx, p) != BYPASS_POLICY_ACTION_NONE);
+    FAIL_IF_NOT(f->bypass_check_done);
+    FAIL_IF_NOT(f->bypass_check_match);
+
+    /* no more stream data in the to server direction: sid 1 is done, but
+     * http transactions can still progress on the responses */
+    ssn.client.flags |= STREAMTCP_STREAM_FLAG_DEPTH_REACHED;
+    FAIL_IF(SigGroupHeadCanMatch(sgh, f, STREAM_TOSERVER, SGH_INSPECT_STREAM));
+    FAIL_IF(BypassPolicyApply(det_ctx, p) != BYPASS_POLICY_ACTION_NONE);
+
+    /* both directions done: no signature can match anymore */
+    ssn.server.flags |= STREAMTCP_STREAM_FLAG_DEPTH_REACHED;
+    FAIL_IF(SigGroupHeadCanMatch(sgh, f, STREAM_TOSERVER, SGH_INSPECT_STREAM));
+    FAIL_IF(BypassPolicyApply(det_ctx, p) != BYPASS_POLICY_ACTION_BYPASS);
+    FAIL_IF(f->bypass_check_match);
+
+    /* the port of sid 4. Ports of a flow don't change, so drop the
+     * stored verdict */
+    f->sp = 1500;
+    FAIL_IF_NOT(SigGroupHeadCanMatch(sgh, f, STREAM_TOSERVER, SGH_INSPECT_PACKET));
+    FAIL_IF(BypassPolicyApply(det_ctx, p) != BYPASS_POLICY_ACTION_BYPASS);
+    f->bypass_check_done = false;
+    FAIL_IF(BypassPolicyApply(det_ctx, p) != BYPASS_POLICY_ACTION_NONE);
+
+    f->protoctx = NULL;
+    UTHFreeFlow(f);
+    UTHFreePacket(p);
+    DetectEngineThreadCtxDeinit(&tv, (void *)det_ctx);
+    DetectEngineCtxFree(de_ctx);
+    BypassPolicyDestroy();
+    PASS;
+}
+
+/** \test signatures matching any flow are found without checking the
+ *        flow */
+static int BypassPolicyTest06(void)
+{
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any "
+            "(flags:S; sid:1;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert http any any -> any any "
+            "(http.uri; content:\"/index\"; sid:2;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp any any -> any 80 "
+            "(content:\"evil\"; sid:3;)"));
+    SigGroupBuild(de_ctx);
+
+    Packet *p = UTHBuildPacketReal(NULL, 0, IPPROTO_TCP,
+            "1.2.3.4", "5.6.7.8", 3000, 80);
+    FAIL_IF_NULL(p);
+    const SigGroupHead *sgh = SigMatchSignaturesGetSgh(de_ctx, p);
+    FAIL_IF_NULL(sgh);
+    FAIL_IF(sgh->inspect_any != SGH_INSPECT_PACKET);
+
+    Flow *f = UTHBuildFlow(AF_INET, "1.2.3.4", "5.6.7.8", 3000, 80);
+    FAIL_IF_NULL(f);
+    f->proto = IPPROTO_TCP;
+    FAIL_IF_NOT(SigGroupHeadCanMatch(sgh, f, STREAM_TOSERVER, SGH_INSPECT_PACKET));
+    f->alproto = ALPROTO_SMTP;
+    FAIL_IF(SigGroupHeadCanMatch(sgh, f, STREAM_TOSERVER, SGH_INSPECT_APPLAYER));
+
+    UTHFreeFlow(f);
+    UTHFreePacket(p);
+    DetectEngineCtxFree(de_ctx);
+    PASS;
+}
+
+#endif /* UNITTESTS */
+
+void BypassPolicyRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("BypassPolicyTest01", BypassPolicyTest01);
+    UtRegisterTest("BypassPolicyTest02", BypassPolicyTest02);
+    UtRegisterTest("BypassPolicyTest03", BypassPolicyTest03);
+    UtRegisterTest("BypassPolicyTest04", BypassPolicyTest04);
+    UtRegisterTest("BypassPolicyTest05", BypassPolicyTest05);
+    UtRegisterTest("BypassPolicyTest06", BypassPolicyTest06);
+#endif
+}
@@ -0,0 +1,45 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Per flow bypass policies.
+ *
+ * A policy selects flows by app-layer protocol, port, ip reputation and
+ * the number of bytes seen. Once a flow matches, it is either bypassed
+ * or its reassembly and payload inspection is stopped.
+ */
+
+#ifndef __FLOW_BYPASS_POLICY_H__
+#define __FLOW_BYPASS_POLICY_H__
+
+enum BypassPolicyAction {
+    BYPASS_POLICY_ACTION_NONE = 0,
+    BYPASS_POLICY_ACTION_BYPASS,
+    BYPASS_POLICY_ACTION_TRUNCATE,
+};
+
+void BypassPolicyInit(void);
+void BypassPolicyDestroy(void);
+bool BypassPolicyEnabled(void);
+
+int BypassPolicyApply(DetectEngineThreadCtx *det_ctx, Packet *p);
+
+void BypassPolicyRegisterTests(void);
+
+#endif /* __FLOW_BYPASS_POLICY_H__ */
@@ -36,6 +36,7 @@
 #include "flow-private.h"
 #include "flow-manager.h"
 #include "flow-storage.h"
+#include "flow-partition.h"
 #include "app-layer-parser.h"
 
 #include "util-time.h"
@@ -54,6 +55,8 @@ SC_ATOMIC_EXTERN(unsigned int, flow_prune_idx);
 SC_ATOMIC_EXTERN(unsigned int, flow_flags);
 
 static Flow *FlowGetUsedFlow(ThreadVars *tv, DecodeThreadVars *dtv);
+static Flow *FlowPartitionGetUsedFlow(ThreadVars *tv, DecodeThreadVars *dtv,
+        FlowPartition *fp, const Packet *p);
 
 /** \brief compare two raw ipv6 addrs
  *
@@ -498,7 +501,11 @@ static Flow *FlowGetNew(ThreadVars *tv, DecodeThreadVars *dtv, const Packet *p)
     }
 
     /* get a flow from the spare queue */
-    f = FlowDequeue(&flow_spare_q);
+    FlowPartition *fp = dtv ? dtv->flow_partition : NULL;
+    if (fp != NULL)
+        f = FlowPartitionGetSpare(fp);
+    else
+        f = FlowDequeue(&flow_spare_q);
     if (f == NULL) {
         /* If we reached the max memcap, we get a used flow */
         if (!(FLOW_CHECK_MEMCAP(sizeof(Flow) + FlowStorageSize()))) {
@@ -514,7 +521,10 @@ static Flow *FlowGetNew(ThreadVars *tv, DecodeThreadVars *dtv, const Packet *p)
                 FlowWakeupFlowManagerThread();
             }
 
-            f = FlowGetUsedFlow(tv, dtv);
+            if (fp != NULL)
+                f = FlowPartitionGetUsedFlow(tv, dtv, fp, p);
+            else
+                f = FlowGetUsedFlow(tv, dtv);
             if (f == NULL) {
                 /* max memcap reached, so increments the counter */
                 if (tv != NULL && dtv != NULL) {
@@ -598,17 +608,19 @@ static Flow *TcpReuseReplace(ThreadVars *tv, DecodeThreadVars *dtv,
  *
  *  \param tv thread vars
  *  \param dtv decode thread vars (for flow log api thread data)
+ *  \param fb hash bucket for the packet
+ *  \param locked false if the bucket is private to the calling thread
  *
  *  \retval f *LOCKED* flow or NULL
  */
-Flow *FlowGetFlowFromHash(ThreadVars *tv, DecodeThreadVars *dtv, const Packet *p, Flow **dest)
+static inline Flow *FlowGetFlowFromBucket(ThreadVars *tv, DecodeThreadVars *dtv,
+        const Packet *p, Flow **dest, FlowBucket *fb, const uint32_t hash,
+        const bool locked)
 {
     Flow *f = NULL;
 
-    /* get our hash bucket and lock it */
-    const uint32_t hash = p->flow_hash;
-    FlowBucket *fb = &flow_hash[hash % flow_config.hash_size];
-    FBLOCK_LOCK(fb);
+    if (locked)
+        FBLOCK_LOCK(fb);
 
     SCLogDebug("fb %p fb->head %p", fb, fb->head);
 
@@ -616,7 +628,8 @@ Flow *FlowGetFlowFromHash(ThreadVars *tv, DecodeThreadVars *dtv, const Packet *p
     if (fb->head == NULL) {
         f = FlowGetNew(tv, dtv, p);
         if (f == NULL) {
-            FBLOCK_UNLOCK(fb);
+            if (locked)
+                FBLOCK_UNLOCK(fb);
             return NULL;
         }
 
@@ -632,7 +645,8 @@ Flow *FlowGetFlowFromHash(ThreadVars *tv, DecodeThreadVars *dtv, const Packet *p
 
         FlowReference(dest, f);
 
-        FBLOCK_UNLOCK(fb);
+        if (locked)
+            FBLOCK_UNLOCK(fb);
         return f;
     }
 
@@ -650,7 +664,8 @@ Flow *FlowGetFlowFromHash(ThreadVars *tv, DecodeThreadVars *dtv, const Packet *p
             if (f == NULL) {
                 f = pf->hnext = FlowGetNew(tv, dtv, p);
                 if (f == NULL) {
-                    FBLOCK_UNLOCK(fb);
+                    if (locked)
+                        FBLOCK_UNLOCK(fb);
                     return NULL;
                 }
                 fb->tail = f;
@@ -667,7 +682,8 @@ Flow *FlowGetFlowFromHash(ThreadVars *tv, DecodeThreadVars *dtv, const Packet *p
 
                 FlowReference(dest, f);
 
-                FBLOCK_UNLOCK(fb);
+                if (locked)
+                    FBLOCK_UNLOCK(fb);
                 return f;
             }
 
@@ -694,14 +710,16 @@ Flow *FlowGetFlowFromHash(ThreadVars *tv, DecodeThreadVars *dtv, const Packet *p
                 if (unlikely(TcpSessionPacketSsnReuse(p, f, f->protoctx) == 1)) {
                     f = TcpReuseReplace(tv, dtv, fb, f, hash, p);
                     if (f == NULL) {
-                        FBLOCK_UNLOCK(fb);
+                        if (locked)
+                            FBLOCK_UNLOCK(fb);
                         return NULL;
                     }
                 }
 
                 FlowReference(dest, f);
 
-                FBLOCK_UNLOCK(fb);
+                if (locked)
+                    FBLOCK_UNLOCK(fb);
                 return f;
             }
         }
@@ -712,17 +730,60 @@ Flow *FlowGetFlowFromHash(ThreadVars *tv, DecodeThreadVars *dtv, const Packet *p
     if (unlikely(TcpSessionPacketSsnReuse(p, f, f->protoctx) == 1)) {
         f = TcpReuseReplace(tv, dtv, fb, f, hash, p);
         if (f == NULL) {
-            FBLOCK_UNLOCK(fb);
+            if (locked)
+                FBLOCK_UNLOCK(fb);
             return NULL;
         }
     }
 
     FlowReference(dest, f);
 
-    FBLOCK_UNLOCK(fb);
+    if (locked)
+        FBLOCK_UNLOCK(fb);
     return f;
 }
 
+/** \brief Get the hash row the flow of a packet lives in
+ *
+ *  Only meant for prefetching: the row is not locked.
+ *
+ *  \param dtv decode thread vars of the flow worker
+ *  \param p packet with PKT_WANTS_FLOW set
+ */
+FlowBucket *FlowGetBucket(const DecodeThreadVars *dtv, const Packet *p)
+{
+    if (dtv != NULL && dtv->flow_partition != NULL) {
+        const FlowPartition *fp = dtv->flow_partition;
+        return &fp->hash[p->flow_hash % fp->hash_size];
+    }
+    return &flow_hash[p->flow_hash % flow_config.hash_size];
+}
+
+/** \brief Get Flow for packet
+ *
+ *  Looks up the flow in the worker's private partition if it has one,
+ *  or in the shared flow hash otherwise.
+ *
+ *  \param tv thread vars
+ *  \param dtv decode thread vars (for flow log api thread data)
+ *
+ *  \retval f *LOCKED* flow or NULL
+ */
+Flow *FlowGetFlowFromHash(ThreadVars *tv, DecodeThreadVars *dtv, const Packet *p, Flow **dest)
+{
+    const uint32_t hash = p->flow_hash;
+
+    if (dtv != NULL && dtv->flow_partition != NULL) {
+        FlowPartition *fp = dtv->flow_partition;
+        FlowBucket *fb = &fp->hash[hash % fp->hash_size];
+        return FlowGetFlowFromBucket(tv, dtv, p, dest, fb, hash, false);
+    }
+
+    /* get our hash bucket and lock it */
+    FlowBucket *fb = &flow_hash[hash % flow_config.hash_size];
+    return FlowGetFlowFromBucket(tv, dtv, p, dest, fb, hash, true);
+}
+
 static inline int FlowCompareKey(Flow *f, FlowKey *key)
 {
     if ((f->proto != IPPROTO_TCP) && (f->proto != IPPROTO_UDP))
@@ -861,6 +922,63 @@ Flow *FlowGetExistingFlowFromHash(FlowKey *key, const uint32_t hash)
     return f;
 }
 
+/** \internal
+ *  \brief remove an unused flow from its hash row and clear it for reuse
+ *
+ *  \param fb hash row, locked by the caller if 'locked' is set. It is
+ *            unlocked by this function.
+ *  \param f *LOCKED* flow. Returned unlocked.
+ */
+static void FlowEvictUsedFlow(ThreadVars *tv, DecodeThreadVars *dtv,
+        FlowBucket *fb, Flow *f, const bool locked)
+{
+    /* remove from the hash */
+    if (f->hprev != NULL)
+        f->hprev->hnext = f->hnext;
+    if (f->hnext != NULL)
+        f->hnext->hprev = f->hprev;
+    if (fb->head == f)
+        fb->head = f->hnext;
+    if (fb->tail == f)
+        fb->tail = f->hprev;
+
+    f->hnext = NULL;
+    f->hprev = NULL;
+    f->fb = NULL;
+    SC_ATOMIC_SET(fb->next_ts, 0);
+    if (locked)
+        FBLOCK_UNLOCK(fb);
+
+    int state = SC_ATOMIC_GET(f->flow_state);
+    if (state == FLOW_STATE_NEW)
+        f->flow_end_flags |= FLOW_END_FLAG_STATE_NEW;
+    else if (state == FLOW_STATE_ESTABLISHED)
+        f->flow_end_flags |= FLOW_END_FLAG_STATE_ESTABLISHED;
+    else if (state == FLOW_STATE_CLOSED)
+        f->flow_end_flags |= FLOW_END_FLAG_STATE_CLOSED;
+#ifdef CAPTURE_OFFLOAD
+    else if (state == FLOW_STATE_CAPTURE_BYPASSED)
+        f->flow_end_flags |= FLOW_END_FLAG_STATE_BYPASSED;
+#endif
+    else if (state == FLOW_STATE_LOCAL_BYPASSED)
+        f->flow_end_flags |= FLOW_END_FLAG_STATE_BYPASSED;
+
+    f->flow_end_flags |= FLOW_END_FLAG_FORCED;
+
+    if (SC_ATOMIC_GET(flow_flags) & FLOW_EMERGENCY)
+        f->flow_end_flags |= FLOW_END_FLAG_EMERGENCY;
+
+    /* invoke flow log api */
+    if (dtv && dtv->output_flow_thread_data)
+        (void)OutputFlowLog(tv, dtv->output_flow_thread_data, f);
+
+    FlowClearMemory(f, f->protomap);
+
+    FlowUpdateState(f, FLOW_STATE_NEW);
+
+    FLOWLOCK_UNLOCK(f);
+}
+
 /** \internal
  *  \brief Get a flow from the hash directly.
  *
@@ -909,52 +1027,57 @@ static Flow *FlowGetUsedFlow(ThreadVars *tv, DecodeThreadVars *dtv)
             continue;
         }
 
-        /* remove from the hash */
-        if (f->hprev != NULL)
-            f->hprev->hnext = f->hnext;
-        if (f->hnext != NULL)
-            f->hnext->hprev = f->hprev;
-        if (fb->head == f)
-            fb->head = f->hnext;
-        if (fb->tail == f)
-            fb->tail = f->hprev;
-
-        f->hnext = NULL;
-        f->hprev = NULL;
-        f->fb = NULL;
-        SC_ATOMIC_SET(fb->next_ts, 0);
-        FBLOCK_UNLOCK(fb);
+        FlowEvictUsedFlow(tv, dtv, fb, f, true);
 
-        int state = SC_ATOMIC_GET(f->flow_state);
-        if (state == FLOW_STATE_NEW)
-            f->flow_end_flags |= FLOW_END_FLAG_STATE_NEW;
-        else if (state == FLOW_STATE_ESTABLISHED)
-            f->flow_end_flags |= FLOW_END_FLAG_STATE_ESTABLISHED;
-        else if (state == FLOW_STATE_CLOSED)
-            f->flow_end_flags |= FLOW_END_FLAG_STATE_CLOSED;
-#ifdef CAPTURE_OFFLOAD
-        else if (state == FLOW_STATE_CAPTURE_BYPASSED)
-            f->flow_end_flags |= FLOW_END_FLAG_STATE_BYPASSED;
-#endif
-        else if (state == FLOW_STATE_LOCAL_BYPASSED)
-            f->flow_end_flags |= FLOW_END_FLAG_STATE_BYPASSED;
+        (void) SC_ATOMIC_ADD(flow_prune_idx, (flow_config.hash_size - cnt));
+        return f;
+    }
 
-        f->flow_end_flags |= FLOW_END_FLAG_FORCED;
+    return NULL;
+}
 
-        if (SC_ATOMIC_GET(flow_flags) & FLOW_EMERGENCY)
-            f->flow_end_flags |= FLOW_END_FLAG_EMERGENCY;
+/** \internal
+ *  \brief Get a flow from a worker's partition directly.
+ *
+ *  Partition version of FlowGetUsedFlow(): called by the owning worker
+ *  when there are no spare flows and the memcap is reached. The row of
+ *  the packet we're getting a flow for is skipped as the caller is in
+ *  the middle of updating it.
+ *
+ *  \param tv thread vars
+ *  \param dtv decode thread vars (for flow log api thread data)
+ *  \param fp the worker's partition
+ *  \param p packet we need a flow for
+ *
+ *  \retval f flow or NULL
+ */
+static Flow *FlowPartitionGetUsedFlow(ThreadVars *tv, DecodeThreadVars *dtv,
+        FlowPartition *fp, const Packet *p)
+{
+    const uint32_t skip_idx = p->flow_hash % fp->hash_size;
+    uint32_t idx = fp->prune_idx % fp->hash_size;
+    uint32_t cnt = fp->hash_size;
 
-        /* invoke flow log api */
-        if (dtv && dtv->output_flow_thread_data)
-            (void)OutputFlowLog(tv, dtv->output_flow_thread_data, f);
+    while (cnt--) {
+        if (++idx >= fp->hash_size)
+            idx = 0;
+        if (idx == skip_idx)
+            continue;
 
-        FlowClearMemory(f, f->protomap);
+        FlowBucket *fb = &fp->hash[idx];
+        Flow *f = fb->tail;
+        if (f == NULL)
+            continue;
 
-        FlowUpdateState(f, FLOW_STATE_NEW);
+        /** never prune a flow that is used by a packet */
+        if (SC_ATOMIC_GET(f->use_cnt) > 0)
+            continue;
 
-        FLOWLOCK_UNLOCK(f);
+        FLOWLOCK_WRLOCK(f);
+        FlowEvictUsedFlow(tv, dtv, fb, f, false);
 
-        (void) SC_ATOMIC_ADD(flow_prune_idx, (flow_config.hash_size - cnt));
+        fp->prune_idx = idx;
+        StatsIncr(tv, fp->counter_flows_evicted);
         return f;
     }
 
@@ -42,6 +42,7 @@
 #include "flow-timeout.h"
 #include "flow-manager.h"
 #include "flow-storage.h"
+#include "flow-partition.h"
 
 #include "stream-tcp-private.h"
 #include "stream-tcp-reassemble.h"
@@ -113,30 +114,6 @@ void FlowTimeoutsEmergency(void)
 #define FLOW_EMERG_MODE_UPDATE_DELAY_NSEC 100000
 #define NEW_FLOW_COUNT_COND 10
 
-typedef struct FlowTimeoutCounters_ {
-    uint32_t new;
-    uint32_t est;
-    uint32_t clo;
-    uint32_t byp;
-    uint32_t tcp_reuse;
-
-    uint32_t flows_checked;
-    uint32_t flows_notimeout;
-    uint32_t flows_timeout;
-    uint32_t flows_timeout_inuse;
-    uint32_t flows_removed;
-
-    uint32_t rows_checked;
-    uint32_t rows_skipped;
-    uint32_t rows_empty;
-    uint32_t rows_busy;
-    uint32_t rows_maxlen;
-
-    uint32_t bypassed_count;
-    uint64_t bypassed_pkts;
-    uint64_t bypassed_bytes;
-} FlowTimeoutCounters;
-
 /**
  * \brief Used to disable flow manager thread(s).
  *
@@ -370,7 +347,8 @@ static inline int FlowManagerFlowTimedOut(Flow *f, struct timeval *ts,
  *  \retval cnt timed out flows
  */
 static uint32_t FlowManagerHashRowTimeout(Flow *f, struct timeval *ts,
-        int emergency, FlowTimeoutCounters *counters, int32_t *next_ts)
+        int emergency, FlowTimeoutCounters *counters, int32_t *next_ts,
+        const bool owner)
 {
     uint32_t cnt = 0;
     uint32_t checked = 0;
@@ -395,8 +373,18 @@ static uint32_t FlowManagerHashRowTimeout(Flow *f, struct timeval *ts,
         }
 
         /* before grabbing the flow lock, make sure we have at least
-         * 3 packets in the pool */
-        PacketPoolWaitForN(3);
+         * 3 packets in the pool. The owner of a partition can't wait
+         * for its own packets to come back, so it leaves the rest of
+         * the row for the next pass. */
+        if (owner) {
+            if (!PacketPoolHasN(3)) {
+                counters->rows_busy++;
+                *next_ts = 0;
+                break;
+            }
+        } else {
+            PacketPoolWaitForN(3);
+        }
 
         FLOWLOCK_WRLOCK(f);
 
@@ -482,19 +470,24 @@ static uint32_t FlowManagerHashRowTimeout(Flow *f, struct timeval *ts,
 }
 
 /**
- *  \brief time out flows from the hash
+ *  \internal
  *
+ *  \brief time out flows from a range of hash rows
+ *
+ *  \param hash hash rows to consider
  *  \param ts timestamp
  *  \param try_cnt number of flows to time out max (0 is unlimited)
  *  \param hash_min min hash index to consider
  *  \param hash_max max hash index to consider
  *  \param counters ptr to FlowTimeoutCounters structure
+ *  \param owner true if the calling thread owns the rows, so no row
+ *               locking is needed and packet pool waits are not allowed
  *
  *  \retval cnt number of timed out flow
  */
-static uint32_t FlowTimeoutHash(struct timeval *ts, uint32_t try_cnt,
-        uint32_t hash_min, uint32_t hash_max,
-        FlowTimeoutCounters *counters)
+static uint32_t FlowTimeoutRows(FlowBucket *hash, struct timeval *ts,
+        uint32_t try_cnt, uint32_t hash_min, uint32_t hash_max,
+        FlowTimeoutCounters *counters, const bool owner)
 {
     uint32_t idx = 0;
     uint32_t cnt = 0;
@@ -504,7 +497,7 @@ static uint32_t FlowTimeoutHash(struct timeval *ts, uint32_t try_cnt,
         emergency = 1;
 
     for (idx = hash_min; idx < hash_max; idx++) {
-        FlowBucket *fb = &flow_hash[idx];
+        FlowBucket *fb = &hash[idx];
 
         counters->rows_checked++;
 
@@ -514,16 +507,18 @@ static uint32_t FlowTimeoutHash(struct timeval *ts, uint32_t try_cnt,
             continue;
         }
 
-        /* before grabbing the row lock, make sure we have at least
-         * 9 packets in the pool */
-        PacketPoolWaitForN(9);
+        if (!owner) {
+            /* before grabbing the row lock, make sure we have at least
+             * 9 packets in the pool */
+            PacketPoolWaitForN(9);
 
-        if (FBLOCK_TRYLOCK(fb) != 0) {
-            counters->rows_busy++;
-            continue;
+            if (FBLOCK_TRYLOCK(fb) != 0) {
+                counters->rows_busy++;
+                continue;
+            }
         }
 
-        /* flow hash bucket is now locked */
+        /* flow hash bucket is now locked (or private to us) */
 
         if (fb->tail == NULL) {
             SC_ATOMIC_SET(fb->next_ts, INT_MAX);
@@ -534,12 +529,14 @@ static uint32_t FlowTimeoutHash(struct timeval *ts, uint32_t try_cnt,
         int32_t next_ts = 0;
 
         /* we have a flow, or more than one */
-        cnt += FlowManagerHashRowTimeout(fb->tail, ts, emergency, counters, &next_ts);
+        cnt += FlowManagerHashRowTimeout(fb->tail, ts, emergency, counters,
+                &next_ts, owner);
 
         SC_ATOMIC_SET(fb->next_ts, next_ts);
 
 next:
-        FBLOCK_UNLOCK(fb);
+        if (!owner)
+            FBLOCK_UNLOCK(fb);
 
         if (try_cnt > 0 && cnt >= try_cnt)
             break;
@@ -548,6 +545,47 @@ next:
     return cnt;
 }
 
+/**
+ *  \brief time out flows from the hash
+ *
+ *  \param ts timestamp
+ *  \param try_cnt number of flows to time out max (0 is unlimited)
+ *  \param hash_min min hash index to consider
+ *  \param hash_max max hash index to consider
+ *  \param counters ptr to FlowTimeoutCounters structure
+ *
+ *  \retval cnt number of timed out flow
+ */
+static uint32_t FlowTimeoutHash(struct timeval *ts, uint32_t try_cnt,
+        uint32_t hash_min, uint32_t hash_max,
+        FlowTimeoutCounters *counters)
+{
+    return FlowTimeoutRows(flow_hash, ts, try_cnt, hash_min, hash_max,
+            counters, false);
+}
+
+/**
+ *  \brief time out flows from a flow partition owned by the caller
+ *
+ *  Like FlowTimeoutHash(), but for the private rows of a worker's flow
+ *  partition. Must only be called by the thread owning the rows and
+ *  not while holding a flow lock.
+ *
+ *  \param hash partition rows
+ *  \param ts timestamp
+ *  \param hash_min min hash index to consider
+ *  \param hash_max max hash index to consider
+ *  \param counters ptr to FlowTimeoutCounters structure
+ *
+ *  \retval cnt number of timed out flow
+ */
+uint32_t FlowTimeoutPartitionRows(FlowBucket *hash, struct timeval *ts,
+        uint32_t hash_min, uint32_t hash_max,
+        FlowTimeoutCounters *counters)
+{
+    return FlowTimeoutRows(hash, ts, 0, hash_min, hash_max, counters, true);
+}
+
 /**
  *  \internal
  *
@@ -605,16 +643,19 @@ static uint32_t FlowManagerHashRowCleanup(Flow *f)
 }
 
 /**
- *  \brief remove all flows from the hash
+ *  \internal
+ *
+ *  \brief remove all flows from a set of hash rows
  *
  *  \retval cnt number of removes out flows
  */
-static uint32_t FlowCleanupHash(void){
+static uint32_t FlowCleanupRows(FlowBucket *hash, uint32_t hash_size)
+{
     uint32_t idx = 0;
     uint32_t cnt = 0;
 
-    for (idx = 0; idx < flow_config.hash_size; idx++) {
-        FlowBucket *fb = &flow_hash[idx];
+    for (idx = 0; idx < hash_size; idx++) {
+        FlowBucket *fb = &hash[idx];
 
         FBLOCK_LOCK(fb);
 
@@ -629,6 +670,18 @@ static uint32_t FlowCleanupHash(void){
     return cnt;
 }
 
+/**
+ *  \brief remove all flows from the hash and the worker partitions
+ *
+ *  \retval cnt number of removes out flows
+ */
+static uint32_t FlowCleanupHash(void)
+{
+    uint32_t cnt = FlowCleanupRows(flow_hash, flow_config.hash_size);
+    cnt += FlowPartitionsWalk(FlowCleanupRows);
+    return cnt;
+}
+
 extern int g_detect_disabled;
 
 typedef struct FlowManagerThreadData_ {
@@ -793,6 +846,9 @@ static TmEcode FlowManager(ThreadVars *th_v, void *thread_data)
 
 
         if (ftd->instance == 1) {
+            /* partitions are timed out by their workers */
+            FlowPartitionsWakeupIdle(&ts);
+
             DefragTimeoutHash(&ts);
             //uint32_t hosts_pruned =
             HostTimeoutHash(&ts);
@@ -1017,6 +1073,10 @@ static TmEcode FlowRecycler(ThreadVars *th_v, void *thread_data)
 
         SCLogDebug("%u flows to recycle", len);
 
+        /* let loggers write out records they buffered, also when
+         * no flows were logged */
+        OutputFlowLogFlush(th_v, ftd->output_thread_data, &ts);
+
         if (TmThreadsCheckFlag(th_v, THV_KILL)) {
             StatsSyncCounters(th_v);
             break;
@@ -24,6 +24,32 @@
 #ifndef __FLOW_MANAGER_H__
 #define __FLOW_MANAGER_H__
 
+#include "flow-hash.h"
+
+typedef struct FlowTimeoutCounters_ {
+    uint32_t new;
+    uint32_t est;
+    uint32_t clo;
+    uint32_t byp;
+    uint32_t tcp_reuse;
+
+    uint32_t flows_checked;
+    uint32_t flows_notimeout;
+    uint32_t flows_timeout;
+    uint32_t flows_timeout_inuse;
+    uint32_t flows_removed;
+
+    uint32_t rows_checked;
+    uint32_t rows_skipped;
+    uint32_t rows_empty;
+    uint32_t rows_busy;
+    uint32_t rows_maxlen;
+
+    uint32_t bypassed_count;
+    uint64_t bypassed_pkts;
+    uint64_t bypassed_bytes;
+} FlowTimeoutCounters;
+
 #define FlowTimeoutsReset() FlowTimeoutsInit()
 void FlowTimeoutsInit(void);
 void FlowTimeoutsEmergency(void);
@@ -37,6 +63,10 @@ void FlowManagerThreadSpawn(void);
 void FlowDisableFlowManagerThread(void);
 void FlowMgrRegisterTests (void);
 
+uint32_t FlowTimeoutPartitionRows(FlowBucket *hash, struct timeval *ts,
+        uint32_t hash_min, uint32_t hash_max,
+        FlowTimeoutCounters *counters);
+
 /** flow recycler scheduling condition */
 extern SCCtrlCondT flow_recycler_ctrl_cond;
 extern SCCtrlMutex flow_recycler_ctrl_mutex;
@@ -0,0 +1,574 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Per worker flow hash partitions.
+ *
+ * In the 'workers' runmode with flow pinned capture (af-packet
+ * cluster_flow, RSS, etc) all packets of a flow are handled by the same
+ * thread. In that case each worker can own a private part of the flow
+ * table: lookups don't need the bucket locks and the rows are never
+ * shared with other threads. The flow manager no longer walks these rows,
+ * timeout handling is done by the owning worker in small slices between
+ * packets, or in full passes when capture is idle.
+ *
+ * Flows that are bypassed in capture (eBPF/XDP) keep using the global
+ * flow hash.
+ */
+
+#include "suricata-common.h"
+#include "threads.h"
+#include "tm-threads.h"
+#include "runmodes.h"
+#include "conf.h"
+
+#include "flow.h"
+#include "flow-private.h"
+#include "flow-partition.h"
+#include "flow-manager.h"
+#include "flow-storage.h"
+#include "flow-util.h"
+
+#include "util-byte.h"
+#include "util-cpu.h"
+#include "util-misc.h"
+#include "util-time.h"
+#include "util-unittest.h"
+#include "util-unittest-helper.h"
+
+/** rows a worker walks per packet while a timeout pass is in progress */
+#define FLOW_PARTITION_ROWS_PER_SLICE   256
+/** flows to take from the global spare queue at once */
+#define FLOW_PARTITION_SPARE_BATCH      64
+/** min rows per partition */
+#define FLOW_PARTITION_MIN_HASH_SIZE    1024
+
+SC_ATOMIC_EXTERN(unsigned int, flow_flags);
+
+static bool partition_enabled = false;
+static uint32_t partition_hash_size = 0;
+
+/** all partitions, for the flow manager and shutdown walks */
+static FlowPartition *partition_list = NULL;
+static SCMutex partition_list_lock = SCMUTEX_INITIALIZER;
+
+/** \brief read the flow.partition config
+ *  \warning Not thread safe */
+void FlowPartitionInitConfig(char quiet)
+{
+    int enabled = 0;
+    partition_enabled = false;
+
+    if (ConfGetBool("flow.partition.enabled", &enabled) != 1 || enabled == 0)
+        return;
+
+    /* split the global hash size over the cpus by default */
+    uint16_t ncpus = UtilCpuGetNumProcessorsOnline();
+    partition_hash_size = flow_config.hash_size / (ncpus ? ncpus : 1);
+
+    const char *conf_val;
+    if (ConfGet("flow.partition.hash-size", &conf_val) == 1 && conf_val != NULL) {
+        uint32_t configval = 0;
+        if (ByteExtractStringUint32(&configval, 10, strlen(conf_val),
+                    conf_val) <= 0) {
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "invalid value for "
+                    "flow.partition.hash-size: %s", conf_val);
+            exit(EXIT_FAILURE);
+        }
+        partition_hash_size = configval;
+    }
+    if (partition_hash_size < FLOW_PARTITION_MIN_HASH_SIZE)
+        partition_hash_size = FLOW_PARTITION_MIN_HASH_SIZE;
+
+    partition_enabled = true;
+    if (quiet == FALSE) {
+        SCLogConfig("flow table partitioned per worker: %"PRIu32" rows per "
+                "worker", partition_hash_size);
+    }
+}
+
+/** \brief check if workers should set up flow partitions
+ *
+ *  Only the 'workers' runmode guarantees that the thread doing the flow
+ *  lookup also does all other work for that flow.
+ */
+bool FlowPartitionEnabled(void)
+{
+    if (!partition_enabled)
+        return false;
+
+    const char *active_runmode = RunmodeGetActive();
+    if (active_runmode == NULL || strcmp(active_runmode, "workers") != 0) {
+        static bool warned = false;
+        if (!warned) {
+            SCLogWarning(SC_ERR_INVALID_ARGUMENT, "flow.partition is only "
+                    "supported in the 'workers' runmode, using the shared "
+                    "flow table");
+            warned = true;
+        }
+        return false;
+    }
+    return true;
+}
+
+/** \brief set up a flow partition for a worker
+ *
+ *  \param tv the owning thread
+ *
+ *  \retval fp partition or NULL on error
+ */
+FlowPartition *FlowPartitionNew(ThreadVars *tv)
+{
+    uint64_t hash_size = (uint64_t)partition_hash_size * sizeof(FlowBucket);
+    if (!(FLOW_CHECK_MEMCAP(hash_size))) {
+        SCLogError(SC_ERR_FLOW_INIT, "allocating flow partition failed: "
+                "flow memcap reached. Memcap: %"PRIu64", partition size "
+                "%"PRIu64". Lower \"flow.partition.hash-size\" or raise "
+                "\"flow.memcap\".", SC_ATOMIC_GET(flow_config.memcap),
+                hash_size);
+        return NULL;
+    }
+
+    FlowPartition *fp = SCCalloc(1, sizeof(*fp));
+    if (unlikely(fp == NULL))
+        return NULL;
+
+    fp->hash = SCMallocAligned(hash_size, CLS);
+    if (unlikely(fp->hash == NULL)) {
+        SCFree(fp);
+        return NULL;
+    }
+    memset(fp->hash, 0, hash_size);
+    fp->hash_size = partition_hash_size;
+
+    /* the row locks are never taken by the owner, only by the shutdown
+     * walks that run when the owner is done with packets */
+    for (uint32_t i = 0; i < fp->hash_size; i++) {
+        FBLOCK_INIT(&fp->hash[i]);
+        SC_ATOMIC_INIT(fp->hash[i].next_ts);
+    }
+    (void) SC_ATOMIC_ADD(flow_memuse, hash_size);
+
+    FlowQueueInit(&fp->spare);
+    SC_ATOMIC_INIT(fp->last_walk);
+    fp->tv = tv;
+
+    fp->counter_flows_removed = StatsRegisterCounter("flow_partition.flows_removed", tv);
+    fp->counter_flows_evicted = StatsRegisterCounter("flow_partition.flows_evicted", tv);
+    fp->counter_rows_busy = StatsRegisterCounter("flow_partition.rows_busy", tv);
+    fp->counter_spare = StatsRegisterCounter("flow_partition.spare", tv);
+
+    SCMutexLock(&partition_list_lock);
+    fp->next = partition_list;
+    partition_list = fp;
+    SCMutexUnlock(&partition_list_lock);
+
+    SCLogDebug("partition %p for %s: %u rows", fp, tv->name, fp->hash_size);
+    return fp;
+}
+
+/** \brief free a partition
+ *
+ *  Flows still in the rows are freed, spare flows are handed back to
+ *  the global spare queue.
+ */
+void FlowPartitionFree(FlowPartition *fp)
+{
+    if (fp == NULL)
+        return;
+
+    SCMutexLock(&partition_list_lock);
+    FlowPartition **pp = &partition_list;
+    while (*pp != NULL) {
+        if (*pp == fp) {
+            *pp = fp->next;
+            break;
+        }
+        pp = &(*pp)->next;
+    }
+    SCMutexUnlock(&partition_list_lock);
+
+    for (uint32_t u = 0; u < fp->hash_size; u++) {
+        Flow *f = fp->hash[u].head;
+        while (f) {
+            Flow *n = f->hnext;
+            uint8_t proto_map = FlowGetProtoMapping(f->proto);
+            FlowClearMemory(f, proto_map);
+            FlowFree(f);
+            f = n;
+        }
+        FBLOCK_DESTROY(&fp->hash[u]);
+        SC_ATOMIC_DESTROY(fp->hash[u].next_ts);
+    }
+    SCFreeAligned(fp->hash);
+    (void) SC_ATOMIC_SUB(flow_memuse, (uint64_t)fp->hash_size * sizeof(FlowBucket));
+
+    Flow *f;
+    while ((f = FlowDequeueNoLock(&fp->spare)) != NULL) {
+        FlowMoveToSpare(f);
+    }
+    FlowQueueDestroy(&fp->spare);
+
+    SC_ATOMIC_DESTROY(fp->last_walk);
+    SCFree(fp);
+}
+
+/** \brief get a spare flow for this partition
+ *
+ *  Takes from the private spare queue, which is refilled from the global
+ *  spare queue in batches so that the shared queue lock is only taken
+ *  once per FLOW_PARTITION_SPARE_BATCH new flows.
+ *
+ *  \retval f unlocked flow or NULL if no spare flows are available
+ */
+Flow *FlowPartitionGetSpare(FlowPartition *fp)
+{
+    Flow *f = FlowDequeueNoLock(&fp->spare);
+    if (f != NULL)
+        return f;
+
+    if (FlowQueueMoveBatch(&fp->spare, &flow_spare_q, FLOW_PARTITION_SPARE_BATCH) == 0)
+        return NULL;
+
+    return FlowDequeueNoLock(&fp->spare);
+}
+
+/** \brief do a slice of flow timeout work for the partition
+ *
+ *  Called by the owning worker for each packet before any flow is
+ *  locked. Once per second (continuously in emergency mode) a pass
+ *  over the rows is started, which is then spread over the following
+ *  packets in FLOW_PARTITION_ROWS_PER_SLICE steps. Capture timeout
+ *  pseudo packets, as injected on the request of the flow manager when
+ *  a worker is idle, finish the pass in one go.
+ *
+ *  \param tv owning thread
+ *  \param fp partition
+ *  \param p packet
+ */
+void FlowPartitionTimeoutSlice(ThreadVars *tv, FlowPartition *fp, const Packet *p)
+{
+    const bool idle = PKT_IS_PSEUDOPKT(p) &&
+        p->pkt_src == PKT_SRC_CAPTURE_TIMEOUT;
+
+    /* other pseudo packets can be injected during shutdown, when the
+     * rows are walked by the main thread */
+    if (PKT_IS_PSEUDOPKT(p) && !idle)
+        return;
+
+    struct timeval ts;
+    if (!fp->walk_active) {
+        if (!idle && (uint32_t)p->ts.tv_sec == fp->walk_sec &&
+                !(SC_ATOMIC_GET(flow_flags) & FLOW_EMERGENCY))
+            return;
+
+        memset(&ts, 0, sizeof(ts));
+        TimeGet(&ts);
+        fp->walk_sec = idle ? (uint32_t)ts.tv_sec : (uint32_t)p->ts.tv_sec;
+        fp->walk_idx = 0;
+        fp->walk_active = true;
+    } else {
+        memset(&ts, 0, sizeof(ts));
+        TimeGet(&ts);
+    }
+
+    uint32_t max = fp->hash_size;
+    if (!idle && fp->hash_size - fp->walk_idx > FLOW_PARTITION_ROWS_PER_SLICE)
+        max = fp->walk_idx + FLOW_PARTITION_ROWS_PER_SLICE;
+
+    FlowTimeoutCounters counters;
+    memset(&counters, 0, sizeof(counters));
+    FlowTimeoutPartitionRows(fp->hash, &ts, fp->walk_idx, max, &counters);
+    fp->walk_idx = max;
+
+    if (fp->walk_idx >= fp->hash_size) {
+        fp->walk_active = false;
+        SC_ATOMIC_SET(fp->last_walk, (uint32_t)ts.tv_sec);
+        StatsSetUI64(tv, fp->counter_spare, (uint64_t)fp->spare.len);
+    }
+
+    if (counters.flows_removed > 0) {
+        StatsAddUI64(tv, fp->counter_flows_removed, (uint64_t)counters.flows_removed);
+        FlowWakeupFlowRecyclerThread();
+    }
+    if (counters.rows_busy > 0)
+        StatsAddUI64(tv, fp->counter_rows_busy, (uint64_t)counters.rows_busy);
+}
+
+/** \brief run a function over the rows of all partitions
+ *
+ *  \warning only safe when the owning workers don't process packets
+ *           anymore, e.g. during shutdown
+ *
+ *  \retval cnt sum of the return values of Func
+ */
+uint32_t FlowPartitionsWalk(FlowPartitionRowsFunc Func)
+{
+    uint32_t cnt = 0;
+
+    SCMutexLock(&partition_list_lock);
+    for (FlowPartition *fp = partition_list; fp != NULL; fp = fp->next) {
+        cnt += Func(fp->hash, fp->hash_size);
+    }
+    SCMutexUnlock(&partition_list_lock);
+    return cnt;
+}
+
+/** \brief ask idle workers to do their timeout work
+ *
+ *  Called by the flow manager. Workers that didn't complete a timeout
+ *  pass in the last 2 seconds are probably not seeing packets. Have the
+ *  capture loop inject a pseudo packet on its next capture timeout.
+ *
+ *  \param ts current time
+ */
+void FlowPartitionsWakeupIdle(const struct timeval *ts)
+{
+    SCMutexLock(&partition_list_lock);
+    for (FlowPartition *fp = partition_list; fp != NULL; fp = fp->next) {
+        uint32_t last = SC_ATOMIC_GET(fp->last_walk);
+        if ((uint32_t)ts->tv_sec > last + 1) {
+            TmThreadsSetFlag(fp->tv, THV_CAPTURE_INJECT_PKT);
+        }
+    }
+    SCMutexUnlock(&partition_list_lock);
+}
+
+#ifdef UNITTESTS
+static int FlowPartitionTest01(void)
+{
+    FlowQueue shared, private;
+    FlowQueueInit(&shared);
+    FlowQueueInit(&private);
+
+    Flow flows[3];
+    memset(flows, 0, sizeof(flows));
+    for (int i = 0; i < 3; i++)
+        FlowEnqueue(&shared, &flows[i]);
+
+    FAIL_IF_NOT(FlowQueueMoveBatch(&private, &shared, 2) == 2);
+    FAIL_IF_NOT(shared.len == 1);
+    FAIL_IF_NOT(private.len == 2);
+
+    /* order is preserved: oldest first */
+    FAIL_IF_NOT(FlowDequeueNoLock(&private) == &flows[0]);
+    FAIL_IF_NOT(FlowDequeueNoLock(&private) == &flows[1]);
+    FAIL_IF_NOT(FlowDequeueNoLock(&private) == NULL);
+
+    FAIL_IF_NOT(FlowQueueMoveBatch(&private, &shared, 8) == 1);
+    FAIL_IF_NOT(FlowDequeueNoLock(&private) == &flows[2]);
+    FAIL_IF_NOT(FlowQueueMoveBatch(&private, &shared, 8) == 0);
+
+    FlowQueueDestroy(&shared);
+    FlowQueueDestroy(&private);
+    PASS;
+}
+
+static Packet *FlowPartitionTestPacket(const char *src, uint16_t sp,
+        const char *dst, uint16_t dp, uint32_t hash, time_t sec)
+{
+    Packet *p = UTHBuildPacketReal(NULL, 0, IPPROTO_UDP, src, dst, sp, dp);
+    if (p != NULL) {
+        p->flow_hash = hash;
+        p->ts.tv_sec = sec;
+    }
+    return p;
+}
+
+/** \internal
+ *  \brief get the flow of a packet like FlowHandlePacket does, but
+ *         leave it unreferenced and unlocked */
+static Flow *FlowPartitionTestLookup(ThreadVars *tv, DecodeThreadVars *dtv,
+        Packet *p)
+{
+    Flow *f = FlowGetFlowFromHash(tv, dtv, p, &p->flow);
+    if (f != NULL) {
+        f->lastts = p->ts;
+        FlowDeReference(&p->flow);
+        FLOWLOCK_UNLOCK(f);
+    }
+    return f;
+}
+
+/** \test lookup and insert in a partition, next to the shared hash */
+static int FlowPartitionTest02(void)
+{
+    FlowInitConfig(FLOW_QUIET);
+    partition_hash_size = FLOW_PARTITION_MIN_HASH_SIZE;
+
+    ThreadVars tv;
+    memset(&tv, 0, sizeof(tv));
+    DecodeThreadVars dtv;
+    memset(&dtv, 0, sizeof(dtv));
+    FlowPartition *fp = FlowPartitionNew(&tv);
+    FAIL_IF_NULL(fp);
+    FAIL_IF_NOT(fp->hash_size == FLOW_PARTITION_MIN_HASH_SIZE);
+    dtv.flow_partition = fp;
+
+    Packet *p1 = FlowPartitionTestPacket("1.2.3.4", 1024, "5.6.7.8", 53, 7, 1);
+    FAIL_IF_NULL(p1);
+    Flow *f1 = FlowPartitionTestLookup(&tv, &dtv, p1);
+    FAIL_IF_NULL(f1);
+
+    /* the flow lives in the partition, not in the shared hash, and the
+     * spare flow came from a batch moved to the partition */
+    FAIL_IF_NOT(f1->fb == &fp->hash[7]);
+    FAIL_IF_NOT(fp->hash[7].head == f1);
+    FAIL_IF_NOT(flow_hash[7 % flow_config.hash_size].head == NULL);
+    FAIL_IF_NOT(fp->spare.len == FLOW_PARTITION_SPARE_BATCH - 1);
+    FAIL_IF_NOT(FlowGetBucket(&dtv, p1) == &fp->hash[7]);
+
+    /* both directions find the same flow */
+    Packet *p2 = FlowPartitionTestPacket("5.6.7.8", 53, "1.2.3.4", 1024, 7, 1);
+    FAIL_IF_NULL(p2);
+    FAIL_IF_NOT(FlowPartitionTestLookup(&tv, &dtv, p2) == f1);
+
+    /* another flow in the same row is added to the end of the row, and
+     * moved to the front when it is looked up again */
+    Packet *p3 = FlowPartitionTestPacket("1.2.3.4", 1025, "5.6.7.8", 53,
+            7 + fp->hash_size, 1);
+    FAIL_IF_NULL(p3);
+    Flow *f3 = FlowPartitionTestLookup(&tv, &dtv, p3);
+    FAIL_IF_NULL(f3);
+    FAIL_IF(f3 == f1);
+    FAIL_IF_NOT(fp->hash[7].head == f1);
+    FAIL_IF_NOT(fp->hash[7].tail == f3);
+    FAIL_IF_NOT(FlowPartitionTestLookup(&tv, &dtv, p3) == f3);
+    FAIL_IF_NOT(fp->hash[7].head == f3);
+    FAIL_IF_NOT(fp->hash[7].tail == f1);
+    FAIL_IF_NOT(FlowPartitionTestLookup(&tv, &dtv, p1) == f1);
+
+    /* without a partition the shared hash is used */
+    Packet *p4 = FlowPartitionTestPacket("1.2.3.4", 1024, "5.6.7.8", 53, 7, 1);
+    FAIL_IF_NULL(p4);
+    Flow *f4 = FlowPartitionTestLookup(NULL, NULL, p4);
+    FAIL_IF_NULL(f4);
+    FAIL_IF(f4 == f1);
+    FAIL_IF_NOT(flow_hash[7 % flow_config.hash_size].head == f4);
+    FAIL_IF_NOT(FlowGetBucket(NULL, p4) == &flow_hash[7 % flow_config.hash_size]);
+
+    UTHFreePacket(p1);
+    UTHFreePacket(p2);
+    UTHFreePacket(p3);
+    UTHFreePacket(p4);
+    FlowPartitionFree(fp);
+    StatsThreadCleanup(&tv);
+    FlowShutdown();
+    PASS;
+}
+
+/** \test timeouts are handled per partition: in slices for packets,
+ *        in one pass for capture timeout packets */
+static int FlowPartitionTest03(void)
+{
+    FlowInitConfig(FLOW_QUIET);
+    partition_hash_size = FLOW_PARTITION_MIN_HASH_SIZE;
+
+    struct timeval now = { .tv_sec = 1000000, .tv_usec = 0 };
+    TimeModeSetOffline();
+    TimeSet(&now);
+
+    ThreadVars tv;
+    memset(&tv, 0, sizeof(tv));
+    DecodeThreadVars dtv;
+    memset(&dtv, 0, sizeof(dtv));
+    FlowPartition *fp = FlowPartitionNew(&tv);
+    FAIL_IF_NULL(fp);
+    dtv.flow_partition = fp;
+
+    /* old flows in the first slice and in a later one, a fresh flow and
+     * an old flow in the shared hash */
+    const time_t old = now.tv_sec - 1000;
+    Packet *p1 = FlowPartitionTestPacket("1.2.3.4", 1024, "5.6.7.8", 53, 5, old);
+    Packet *p2 = FlowPartitionTestPacket("1.2.3.4", 1025, "5.6.7.8", 53, 600, old);
+    Packet *p3 = FlowPartitionTestPacket("1.2.3.4", 1026, "5.6.7.8", 53, 10, now.tv_sec);
+    Packet *p4 = FlowPartitionTestPacket("1.2.3.4", 1027, "5.6.7.8", 53, 5, old);
+    FAIL_IF(p1 == NULL || p2 == NULL || p3 == NULL || p4 == NULL);
+    FAIL_IF_NULL(FlowPartitionTestLookup(&tv, &dtv, p1));
+    FAIL_IF_NULL(FlowPartitionTestLookup(&tv, &dtv, p2));
+    FAIL_IF_NULL(FlowPartitionTestLookup(&tv, &dtv, p3));
+    FAIL_IF_NULL(FlowPartitionTestLookup(NULL, NULL, p4));
+    const uint32_t recycled = flow_recycle_q.len;
+
+    /* a packet starts a pass and walks the first slice */
+    Packet *p = UTHBuildPacket(NULL, 0, IPPROTO_UDP);
+    FAIL_IF_NULL(p);
+    p->ts = now;
+    FlowPartitionTimeoutSlice(&tv, fp, p);
+    FAIL_IF_NOT(fp->walk_active);
+    FAIL_IF_NOT(fp->walk_idx == FLOW_PARTITION_ROWS_PER_SLICE);
+    FAIL_IF_NOT(fp->hash[5].head == NULL);
+    FAIL_IF_NULL(fp->hash[600].head);
+    FAIL_IF_NOT(flow_recycle_q.len == recycled + 1);
+
+    /* the next packets finish it */
+    while (fp->walk_active) {
+        FlowPartitionTimeoutSlice(&tv, fp, p);
+    }
+    FAIL_IF_NOT(fp->hash[600].head == NULL);
+    FAIL_IF_NULL(fp->hash[10].head);
+    FAIL_IF_NOT(SC_ATOMIC_GET(fp->last_walk) == (uint32_t)now.tv_sec);
+    FAIL_IF_NOT(flow_recycle_q.len == recycled + 2);
+
+    /* no new pass in the same second */
+    FlowPartitionTimeoutSlice(&tv, fp, p);
+    FAIL_IF(fp->walk_active);
+
+    /* the flow manager wakes up a worker that didn't walk its rows */
+    now.tv_sec += 100;
+    TimeSet(&now);
+    FlowPartitionsWakeupIdle(&now);
+    FAIL_IF_NOT(TmThreadsCheckFlag(&tv, THV_CAPTURE_INJECT_PKT));
+
+    /* which then does a full pass on a capture timeout packet */
+    Packet *pseudo = UTHBuildPacket(NULL, 0, IPPROTO_UDP);
+    FAIL_IF_NULL(pseudo);
+    pseudo->flags |= PKT_PSEUDO_STREAM_END;
+    PKT_SET_SRC(pseudo, PKT_SRC_CAPTURE_TIMEOUT);
+    FlowPartitionTimeoutSlice(&tv, fp, pseudo);
+    FAIL_IF(fp->walk_active);
+    FAIL_IF_NOT(fp->hash[10].head == NULL);
+    FAIL_IF_NOT(SC_ATOMIC_GET(fp->last_walk) == (uint32_t)now.tv_sec);
+    FAIL_IF_NOT(flow_recycle_q.len == recycled + 3);
+
+    /* the shared hash is left to the flow manager */
+    FAIL_IF_NULL(flow_hash[5 % flow_config.hash_size].head);
+
+    UTHFreePacket(p1);
+    UTHFreePacket(p2);
+    UTHFreePacket(p3);
+    UTHFreePacket(p4);
+    UTHFreePacket(p);
+    UTHFreePacket(pseudo);
+    FlowPartitionFree(fp);
+    StatsThreadCleanup(&tv);
+    FlowShutdown();
+    TimeModeSetLive();
+    PASS;
+}
+#endif /* UNITTESTS */
+
+void FlowPartitionRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("FlowPartitionTest01", FlowPartitionTest01);
+    UtRegisterTest("FlowPartitionTest02", FlowPartitionTest02);
+    UtRegisterTest("FlowPartitionTest03", FlowPartitionTest03);
+#endif /* UNITTESTS */
+}
@@ -0,0 +1,79 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Per worker flow hash partitions.
+ */
+
+#ifndef __FLOW_PARTITION_H__
+#define __FLOW_PARTITION_H__
+
+#include "flow-hash.h"
+#include "flow-queue.h"
+
+/** A worker private slice of the flow table. Only the owning worker
+ *  thread touches the rows and the spare queue while the engine runs,
+ *  so neither is locked. The flow manager only reads 'last_walk'. */
+typedef struct FlowPartition_ {
+    FlowBucket *hash;
+    uint32_t hash_size;
+
+    /** timeout walk state: next row and second the pass started */
+    uint32_t walk_idx;
+    uint32_t walk_sec;
+    bool walk_active;
+
+    /** next row to consider for emergency eviction */
+    uint32_t prune_idx;
+
+    /** spare flows for this worker, refilled from flow_spare_q in
+     *  batches */
+    FlowQueue spare;
+
+    /** owning thread */
+    ThreadVars *tv;
+
+    /** time in seconds of the last completed timeout pass */
+    SC_ATOMIC_DECLARE(uint32_t, last_walk);
+
+    uint16_t counter_flows_removed;
+    uint16_t counter_flows_evicted;
+    uint16_t counter_rows_busy;
+    uint16_t counter_spare;
+
+    struct FlowPartition_ *next;
+} FlowPartition;
+
+typedef uint32_t (*FlowPartitionRowsFunc)(FlowBucket *hash, uint32_t hash_size);
+
+void FlowPartitionInitConfig(char quiet);
+bool FlowPartitionEnabled(void);
+
+FlowPartition *FlowPartitionNew(ThreadVars *tv);
+void FlowPartitionFree(FlowPartition *fp);
+
+Flow *FlowPartitionGetSpare(FlowPartition *fp);
+void FlowPartitionTimeoutSlice(ThreadVars *tv, FlowPartition *fp, const Packet *p);
+
+uint32_t FlowPartitionsWalk(FlowPartitionRowsFunc Func);
+void FlowPartitionsWakeupIdle(const struct timeval *ts);
+
+void FlowPartitionRegisterTests(void);
+
+#endif /* __FLOW_PARTITION_H__ */
@@ -96,19 +96,19 @@ void FlowEnqueue (FlowQueue *q, Flow *f)
 }
 
 /**
- *  \brief remove a flow from the queue
+ *  \brief remove a flow from the queue without locking it
+ *
+ *  Only to be used on queues that are private to the calling thread,
+ *  like the per worker spare queue of a flow partition.
  *
  *  \param q queue
  *
  *  \retval f flow or NULL if empty list.
  */
-Flow *FlowDequeue (FlowQueue *q)
+Flow *FlowDequeueNoLock(FlowQueue *q)
 {
-    FQLOCK_LOCK(q);
-
     Flow *f = q->bot;
     if (f == NULL) {
-        FQLOCK_UNLOCK(q);
         return NULL;
     }
 
@@ -130,11 +130,62 @@ Flow *FlowDequeue (FlowQueue *q)
 
     f->lnext = NULL;
     f->lprev = NULL;
+    return f;
+}
 
+/**
+ *  \brief remove a flow from the queue
+ *
+ *  \param q queue
+ *
+ *  \retval f flow or NULL if empty list.
+ */
+Flow *FlowDequeue (FlowQueue *q)
+{
+    FQLOCK_LOCK(q);
+    Flow *f = FlowDequeueNoLock(q);
     FQLOCK_UNLOCK(q);
     return f;
 }
 
+/**
+ *  \brief move up to 'max' flows from a shared queue into a private one
+ *
+ *  Only the source queue is locked, and only once for the whole batch.
+ *
+ *  \param dst private (unlocked) destination queue
+ *  \param src shared source queue
+ *  \param max max number of flows to move
+ *
+ *  \retval cnt number of flows moved
+ */
+uint32_t FlowQueueMoveBatch(FlowQueue *dst, FlowQueue *src, uint32_t max)
+{
+    uint32_t cnt = 0;
+
+    FQLOCK_LOCK(src);
+    while (cnt < max) {
+        Flow *f = FlowDequeueNoLock(src);
+        if (f == NULL)
+            break;
+
+        /* append to the top of dst, FlowDequeueNoLock takes from the bottom */
+        if (dst->top != NULL) {
+            f->lnext = dst->top;
+            dst->top->lprev = f;
+            dst->top = f;
+        } else {
+            dst->top = f;
+            dst->bot = f;
+        }
+        dst->len++;
+        cnt++;
+    }
+    FQLOCK_UNLOCK(src);
+
+    return cnt;
+}
+
 /**
  *  \brief Transfer a flow from a queue to the spare queue
  *
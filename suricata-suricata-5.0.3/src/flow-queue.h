@@ -78,6 +78,8 @@ void FlowQueueDestroy (FlowQueue *);
 
 void FlowEnqueue (FlowQueue *, Flow *);
 Flow *FlowDequeue (FlowQueue *);
+Flow *FlowDequeueNoLock(FlowQueue *);
+uint32_t FlowQueueMoveBatch(FlowQueue *, FlowQueue *, uint32_t);
 
 void FlowMoveToSpare(Flow *);
 
@@ -39,6 +39,7 @@
 #include "flow-var.h"
 #include "flow-private.h"
 #include "flow-manager.h"
+#include "flow-partition.h"
 #include "flow-timeout.h"
 #include "pkt-var.h"
 #include "host.h"
@@ -418,12 +419,13 @@ done:
  * - be robust in case of future changes
  * - locking overhead if neglectable when no other thread fights us
  *
- * \param q The queue to process flows from.
+ * \param hash hash rows to process flows from
+ * \param hash_size number of rows
  */
-static inline void FlowForceReassemblyForHash(void)
+static uint32_t FlowForceReassemblyForRows(FlowBucket *hash, uint32_t hash_size)
 {
-    for (uint32_t idx = 0; idx < flow_config.hash_size; idx++) {
-        FlowBucket *fb = &flow_hash[idx];
+    for (uint32_t idx = 0; idx < hash_size; idx++) {
+        FlowBucket *fb = &hash[idx];
 
         PacketPoolWaitForN(9);
         FBLOCK_LOCK(fb);
@@ -459,7 +461,7 @@ static inline void FlowForceReassemblyForHash(void)
         }
         FBLOCK_UNLOCK(fb);
     }
-    return;
+    return 0;
 }
 
 /**
@@ -468,6 +470,7 @@ static inline void FlowForceReassemblyForHash(void)
 void FlowForceReassembly(void)
 {
     /* Carry out flow reassembly for unattended flows */
-    FlowForceReassemblyForHash();
+    (void)FlowForceReassemblyForRows(flow_hash, flow_config.hash_size);
+    (void)FlowPartitionsWalk(FlowForceReassemblyForRows);
     return;
 }
@@ -68,7 +68,13 @@
         (f)->alstate = NULL; \
         (f)->sgh_toserver = NULL; \
         (f)->sgh_toclient = NULL; \
+        (f)->bypass_check_done = false; \
         (f)->flowvar = NULL; \
+        (f)->flowbits = NULL; \
+        (f)->flowints = NULL; \
+        (f)->flowbits_size = 0; \
+        (f)->flowints_cnt = 0; \
+        (f)->flowints_size = 0; \
         (f)->hnext = NULL; \
         (f)->hprev = NULL; \
         (f)->lnext = NULL; \
@@ -113,8 +119,8 @@
         (f)->thread_id[1] = 0; \
         (f)->sgh_toserver = NULL; \
         (f)->sgh_toclient = NULL; \
-        GenericVarFree((f)->flowvar); \
-        (f)->flowvar = NULL; \
+        (f)->bypass_check_done = false; \
+        FlowFreeVars((f)); \
         RESET_COUNTERS((f)); \
     } while(0)
 
@@ -124,7 +130,7 @@
         SC_ATOMIC_DESTROY((f)->use_cnt); \
         \
         FLOWLOCK_DESTROY((f)); \
-        GenericVarFree((f)->flowvar); \
+        FlowFreeVars((f)); \
     } while(0)
 
 /** \brief check if a memory alloc would fit in the memcap
@@ -41,12 +41,6 @@ static void FlowVarUpdateStr(FlowVar *fv, uint8_t *value, uint16_t size)
     fv->data.fv_str.value_len = size;
 }
 
-/* puts a new value into a flowvar */
-static void FlowVarUpdateInt(FlowVar *fv, uint32_t value)
-{
-    fv->data.fv_int.value = value;
-}
-
 /** \brief get the flowvar with index 'idx' from the flow
  *  \note flow is not locked by this function, caller is
  *        responsible
@@ -131,33 +125,73 @@ void FlowVarAddIdValue(Flow *f, uint32_t idx, uint8_t *value, uint16_t size)
     }
 }
 
-/* add a flowvar to the flow, or update it */
-void FlowVarAddIntNoLock(Flow *f, uint32_t idx, uint32_t value)
+/** \internal
+ *  \brief get the flowint with index 'idx' from the flow
+ */
+static FlowInt *FlowIntGet(const Flow *f, uint32_t idx)
 {
-    FlowVar *fv = FlowVarGet(f, idx);
-    if (fv == NULL) {
-        fv = SCMalloc(sizeof(FlowVar));
-        if (unlikely(fv == NULL))
-            return;
+    for (uint16_t i = 0; i < f->flowints_cnt; i++) {
+        if (f->flowints[i].idx == idx)
+            return &f->flowints[i];
+    }
+    return NULL;
+}
 
-        fv->type = DETECT_FLOWVAR;
-        fv->datatype = FLOWVAR_TYPE_INT;
-        fv->idx = idx;
-        fv->data.fv_int.value= value;
-        fv->next = NULL;
+/** \brief get the value of flowint 'idx'
+ *  \note flow is not locked by this function, caller is
+ *        responsible
+ *  \retval 1 flowint is set, value in 'value'
+ *  \retval 0 flowint is not set
+ */
+int FlowVarGetInt(const Flow *f, uint32_t idx, uint32_t *value)
+{
+    if (f == NULL)
+        return 0;
 
-        GenericVarAppend(&f->flowvar, (GenericVar *)fv);
-    } else {
-        FlowVarUpdateInt(fv, value);
+    const FlowInt *fi = FlowIntGet(f, idx);
+    if (fi == NULL)
+        return 0;
+    *value = fi->value;
+    return 1;
+}
+
+/* add a flowint to the flow, or update it */
+void FlowVarAddIntNoLock(Flow *f, uint32_t idx, uint32_t value)
+{
+    FlowInt *fi = FlowIntGet(f, idx);
+    if (fi == NULL) {
+        if (f->flowints_cnt == f->flowints_size) {
+            if (f->flowints_size == UINT16_MAX)
+                return;
+            uint32_t size = MIN(MAX((uint32_t)f->flowints_size * 2, 4), UINT16_MAX);
+            void *ptr = SCRealloc(f->flowints, size * sizeof(FlowInt));
+            if (unlikely(ptr == NULL))
+                return;
+            f->flowints = ptr;
+            f->flowints_size = (uint16_t)size;
+        }
+        fi = &f->flowints[f->flowints_cnt++];
+        fi->idx = idx;
     }
+    fi->value = value;
 }
 
-/* add a flowvar to the flow, or update it */
+/* add a flowint to the flow, or update it */
 void FlowVarAddInt(Flow *f, uint32_t idx, uint32_t value)
 {
     FlowVarAddIntNoLock(f, idx, value);
 }
 
+void FlowVarFreeInts(Flow *f)
+{
+    if (f->flowints != NULL) {
+        SCFree(f->flowints);
+        f->flowints = NULL;
+    }
+    f->flowints_cnt = 0;
+    f->flowints_size = 0;
+}
+
 void FlowVarFree(FlowVar *fv)
 {
     if (fv == NULL)
@@ -180,7 +214,7 @@ void FlowVarPrint(GenericVar *gv)
     if (gv == NULL)
         return;
 
-    if (gv->type == DETECT_FLOWVAR || gv->type == DETECT_FLOWINT) {
+    if (gv->type == DETECT_FLOWVAR) {
         FlowVar *fv = (FlowVar *)gv;
 
         if (fv->datatype == FLOWVAR_TYPE_STR) {
@@ -192,9 +226,6 @@ void FlowVarPrint(GenericVar *gv)
                     SCLogDebug("\\%02X", fv->data.fv_str.value[u]);
             }
             SCLogDebug("\", Len \"%" PRIu16 "\"\n", fv->data.fv_str.value_len);
-        } else if (fv->datatype == FLOWVAR_TYPE_INT) {
-            SCLogDebug("Name idx \"%" PRIu32 "\", Value \"%" PRIu32 "\"", fv->idx,
-                    fv->data.fv_int.value);
         } else {
             SCLogDebug("Unknown data type at flowvars\n");
         }
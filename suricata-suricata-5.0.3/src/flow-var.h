@@ -31,7 +31,6 @@
 /** Available data types for Flowvars */
 
 #define FLOWVAR_TYPE_STR 1
-#define FLOWVAR_TYPE_INT 2
 
 /** Struct used to hold the string data type for flowvars */
 typedef struct FlowVarTypeStr {
@@ -39,10 +38,11 @@ typedef struct FlowVarTypeStr {
     uint16_t value_len;
 } FlowVarTypeStr;
 
-/** Struct used to hold the integer data type for flowvars */
-typedef struct FlowVarTypeInt_ {
+/** Flowint, stored in a packed array in the flow */
+typedef struct FlowInt_ {
+    uint32_t idx;       /* name idx */
     uint32_t value;
-} FlowVarTypeInt;
+} FlowInt;
 
 /** Generic Flowvar Structure */
 typedef struct FlowVar_ {
@@ -55,7 +55,6 @@ typedef struct FlowVar_ {
                          * faster. */
     union {
         FlowVarTypeStr fv_str;
-        FlowVarTypeInt fv_int;
     } data;
     uint8_t *key;
 } FlowVar;
@@ -67,6 +66,8 @@ void FlowVarAddKeyValue(Flow *f, uint8_t *key, uint16_t keysize, uint8_t *value,
 
 void FlowVarAddIntNoLock(Flow *, uint32_t, uint32_t);
 void FlowVarAddInt(Flow *, uint32_t, uint32_t);
+int FlowVarGetInt(const Flow *, uint32_t, uint32_t *);
+void FlowVarFreeInts(Flow *);
 FlowVar *FlowVarGet(Flow *, uint32_t);
 FlowVar *FlowVarGetByKey(Flow *f, const uint8_t *key, uint16_t keylen);
 void FlowVarFree(FlowVar *);
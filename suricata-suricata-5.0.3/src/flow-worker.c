@@ -44,9 +44,15 @@
 #include "util-validate.h"
 
 #include "flow-util.h"
+#include "flow-partition.h"
+#include "flow-bypass-policy.h"
 
 typedef DetectEngineThreadCtx *DetectEngineThreadCtxPtr;
 
+/** number of Prefetch calls between prefetching a hash row and
+ *  prefetching the head flow of that row */
+#define FLOW_WORKER_PREFETCH_DELAY 2
+
 typedef struct FlowWorkerThreadData_ {
     DecodeThreadVars *dtv;
 
@@ -64,8 +70,15 @@ typedef struct FlowWorkerThreadData_ {
     uint16_t both_bypass_pkts;
     uint16_t both_bypass_bytes;
 
+    uint16_t policy_bypass;
+    uint16_t policy_truncate;
+
     PacketQueue pq;
 
+    /** rows prefetched by the last FlowWorkerPrefetch calls */
+    FlowBucket *prefetch_fb[FLOW_WORKER_PREFETCH_DELAY];
+    uint32_t prefetch_idx;
+
 } FlowWorkerThreadData;
 
 /** \brief handle flow for packet
@@ -108,6 +121,10 @@ static TmEcode FlowWorkerThreadInit(ThreadVars *tv, const void *initdata, void *
     fw->local_bypass_bytes = StatsRegisterCounter("flow_bypassed.local_bytes", tv);
     fw->both_bypass_pkts = StatsRegisterCounter("flow_bypassed.local_capture_pkts", tv);
     fw->both_bypass_bytes = StatsRegisterCounter("flow_bypassed.local_capture_bytes", tv);
+    if (BypassPolicyEnabled()) {
+        fw->policy_bypass = StatsRegisterCounter("flow_bypassed.policy_bypass", tv);
+        fw->policy_truncate = StatsRegisterCounter("flow_bypassed.policy_truncate", tv);
+    }
 
     fw->dtv = DecodeThreadVarsAlloc(tv);
     if (fw->dtv == NULL) {
@@ -137,6 +154,14 @@ static TmEcode FlowWorkerThreadInit(ThreadVars *tv, const void *initdata, void *
         return TM_ECODE_FAILED;
     }
 
+    if (FlowPartitionEnabled()) {
+        fw->dtv->flow_partition = FlowPartitionNew(tv);
+        if (fw->dtv->flow_partition == NULL) {
+            FlowWorkerThreadDeinit(tv, fw);
+            return TM_ECODE_FAILED;
+        }
+    }
+
     DecodeRegisterPerfCounters(fw->dtv, tv);
     AppLayerRegisterThreadCounters(tv);
 
@@ -152,6 +177,10 @@ static TmEcode FlowWorkerThreadDeinit(ThreadVars *tv, void *data)
 {
     FlowWorkerThreadData *fw = data;
 
+    if (fw->dtv != NULL) {
+        FlowPartitionFree(fw->dtv->flow_partition);
+        fw->dtv->flow_partition = NULL;
+    }
     DecodeThreadVarsFree(tv, fw->dtv);
 
     /* free TCP */
@@ -191,6 +220,36 @@ static void FlowPruneFiles(Packet *p)
     }
 }
 
+/** \brief Prefetch the flow hash row a packet will be looked up in
+ *
+ *  Called a few packets ahead of FlowWorker when packets are processed
+ *  in batches. The head flow of a row can only be found once the row is
+ *  in the cache, so it is prefetched a couple of calls later. The row is
+ *  read without its lock, a stale head pointer only costs a useless
+ *  prefetch.
+ */
+static void FlowWorkerPrefetch(ThreadVars *tv, Packet *p, void *data)
+{
+    FlowWorkerThreadData *fw = data;
+    const uint32_t idx = fw->prefetch_idx;
+
+    FlowBucket *prev = fw->prefetch_fb[idx];
+    if (prev != NULL) {
+        Flow *f = prev->head;
+        if (f != NULL)
+            prefetch(f);
+    }
+
+    if (p->flags & PKT_WANTS_FLOW) {
+        FlowBucket *fb = FlowGetBucket(fw->dtv, p);
+        prefetch(fb);
+        fw->prefetch_fb[idx] = fb;
+    } else {
+        fw->prefetch_fb[idx] = NULL;
+    }
+    fw->prefetch_idx = (idx + 1) % FLOW_WORKER_PREFETCH_DELAY;
+}
+
 static TmEcode FlowWorker(ThreadVars *tv, Packet *p, void *data, PacketQueue *preq, PacketQueue *unused)
 {
     FlowWorkerThreadData *fw = data;
@@ -203,6 +262,12 @@ static TmEcode FlowWorker(ThreadVars *tv, Packet *p, void *data, PacketQueue *pr
         TimeSetByThread(tv->id, &p->ts);
     }
 
+    /* timeout work for our own part of the flow table. Done before
+     * we take any flow lock. */
+    if (fw->dtv->flow_partition != NULL) {
+        FlowPartitionTimeoutSlice(tv, fw->dtv->flow_partition, p);
+    }
+
     /* handle Flow */
     if (p->flags & PKT_WANTS_FLOW) {
         FLOWWORKER_PROFILING_START(p, PROFILE_FLOWWORKER_FLOW);
@@ -290,6 +355,20 @@ static TmEcode FlowWorker(ThreadVars *tv, Packet *p, void *data, PacketQueue *pr
         FLOWWORKER_PROFILING_END(p, PROFILE_FLOWWORKER_DETECT);
     }
 
+    /* bypass policies need the rule groups Detect set up for the flow */
+    if (p->flow != NULL && BypassPolicyEnabled()) {
+        switch (BypassPolicyApply(detect_thread, p)) {
+            case BYPASS_POLICY_ACTION_BYPASS:
+                StatsIncr(tv, fw->policy_bypass);
+                break;
+            case BYPASS_POLICY_ACTION_TRUNCATE:
+                StatsIncr(tv, fw->policy_truncate);
+                break;
+            default:
+                break;
+        }
+    }
+
     // Outputs.
     OutputLoggerLog(tv, p, fw->output_thread);
 
@@ -359,6 +438,7 @@ void TmModuleFlowWorkerRegister (void)
     tmm_modules[TMM_FLOWWORKER].name = "FlowWorker";
     tmm_modules[TMM_FLOWWORKER].ThreadInit = FlowWorkerThreadInit;
     tmm_modules[TMM_FLOWWORKER].Func = FlowWorker;
+    tmm_modules[TMM_FLOWWORKER].Prefetch = FlowWorkerPrefetch;
     tmm_modules[TMM_FLOWWORKER].ThreadDeinit = FlowWorkerThreadDeinit;
     tmm_modules[TMM_FLOWWORKER].ThreadExitPrintStats = FlowWorkerExitPrintStats;
     tmm_modules[TMM_FLOWWORKER].cap_flags = 0;
@@ -39,10 +39,12 @@
 #include "flow-hash.h"
 #include "flow-util.h"
 #include "flow-var.h"
+#include "flow-bit.h"
 #include "flow-private.h"
 #include "flow-timeout.h"
 #include "flow-manager.h"
 #include "flow-storage.h"
+#include "flow-partition.h"
 #include "flow-bypass.h"
 
 #include "stream-tcp-private.h"
@@ -148,6 +150,15 @@ void FlowCleanupAppLayer(Flow *f)
     return;
 }
 
+/** \brief free the flow's variables: the var list, flowbits and flowints */
+void FlowFreeVars(Flow *f)
+{
+    GenericVarFree(f->flowvar);
+    f->flowvar = NULL;
+    FlowBitFreeAll(f);
+    FlowVarFreeInts(f);
+}
+
 /** \brief Make sure we have enough spare flows. 
  *
  *  Enforce the prealloc parameter, so keep at least prealloc flows in the
@@ -669,6 +680,7 @@ void FlowInitConfig(char quiet)
     }
 
     FlowInitFlowProto();
+    FlowPartitionInitConfig(quiet);
 
     return;
 }
@@ -1050,6 +1062,11 @@ int FlowClearMemory(Flow* f, uint8_t proto_map)
         AppLayerExpectationClean(f);
     }
 
+    /* app-layer state can reference data in the TCP stream buffers
+     * (see StreamingBufferView), so release it before the protocol
+     * state. Otherwise that data is copied out just to be freed. */
+    FlowCleanupAppLayer(f);
+
     /* call the protocol specific free function if we have one */
     if (flow_freefuncs[proto_map].Freefunc != NULL) {
         flow_freefuncs[proto_map].Freefunc(f->protoctx);
@@ -446,9 +446,26 @@ typedef struct Flow_
      *  has been set. */
     const struct SigGroupHead_ *sgh_toserver;
 
+    /** verdict of the bypass policy signature check and the state of the
+     *  flow it was made for, see SignaturesCanMatch. Only valid if
+     *  bypass_check_done is set. */
+    uint32_t bypass_check_version;  /**< de_ctx_version of the check */
+    AppProto bypass_check_alproto;
+    uint8_t bypass_check_inspect[2];
+    bool bypass_check_done;
+    bool bypass_check_match;
+
     /* pointer to the var list */
     GenericVar *flowvar;
 
+    /** flowbits, a bitset indexed by the flowbit's variable id */
+    uint32_t *flowbits;
+    /** flowints, packed (id, value) pairs */
+    struct FlowInt_ *flowints;
+    uint16_t flowbits_size;     /**< size of flowbits in 32 bit words */
+    uint16_t flowints_cnt;      /**< flowints in use */
+    uint16_t flowints_size;     /**< flowints allocated */
+
     /** hash list pointers, protected by fb->s */
     struct Flow_ *hnext; /* hash list */
     struct Flow_ *hprev;
@@ -529,6 +546,7 @@ static inline void FlowSetNoPayloadInspectionFlag(Flow *);
 int FlowGetPacketDirection(const Flow *, const Packet *);
 
 void FlowCleanupAppLayer(Flow *);
+void FlowFreeVars(Flow *);
 
 void FlowUpdateState(Flow *f, enum FlowState s);
 
@@ -0,0 +1,1068 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Logs the flow records of the eve flow logger in a binary, column
+ * oriented format. Each thread collects the records in one buffer per
+ * field, and writes them out as a batch when the batch is full or old
+ * enough. Every column of a batch is compressed on its own.
+ *
+ * A batch is self describing, so a file is just a sequence of batches.
+ * All integers are little endian.
+ *
+ *   batch header (16 bytes):
+ *     magic "SCFC", u32 batch length including the header,
+ *     u8 version, u8 reserved, u16 number of columns, u32 number of rows
+ *   per column a descriptor:
+ *     u8 name length, name, u8 type, u8 codec,
+ *     u32 raw length, u32 stored length
+ *   the column data, in the order of the descriptors
+ *
+ * Strings are stored as u16 length followed by the bytes, ip addresses as
+ * 16 bytes with ipv4 addresses mapped to ::ffff:a.b.c.d.
+ */
+
+#include "suricata-common.h"
+#include "debug.h"
+#include "detect.h"
+#include "conf.h"
+
+#include "threads.h"
+#include "threadvars.h"
+#include "tm-threads.h"
+
+#include "util-unittest.h"
+#include "util-debug.h"
+
+#include "output.h"
+#include "log-flow-columnar.h"
+#include "util-logopenfile.h"
+#include "util-time.h"
+#include "util-byte.h"
+
+#include "output-json.h"
+
+#include "app-layer-parser.h"
+#include "flow-storage.h"
+#include "stream-tcp-private.h"
+#include "stream-tcp.h"
+#include "source-pcap-file.h"
+
+#ifdef HAVE_LIBLZ4
+#include <lz4.h>
+#endif /* HAVE_LIBLZ4 */
+
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif /* HAVE_LIBZSTD */
+
+#define DEFAULT_LOG_FILENAME "flow.columnar"
+#define MODULE_NAME "LogFlowColumnar"
+
+#define FLOW_COLUMNAR_MAGIC         "SCFC"
+#define FLOW_COLUMNAR_VERSION       1
+#define FLOW_COLUMNAR_HEADER_LEN    16
+/* name length, type, codec, raw length, stored length */
+#define FLOW_COLUMNAR_DESC_LEN      (1 + 1 + 1 + 4 + 4)
+
+#define DEFAULT_BATCH_SIZE          8192
+#define MAX_BATCH_SIZE              65536
+#define DEFAULT_FLUSH_INTERVAL      60
+
+enum FlowColumnType {
+    FC_TYPE_UINT8 = 1,
+    FC_TYPE_UINT16,
+    FC_TYPE_UINT64,
+    FC_TYPE_INT64,
+    FC_TYPE_BOOL,
+    FC_TYPE_IP,
+    FC_TYPE_STRING,
+};
+
+enum FlowColumnCodec {
+    FC_CODEC_NONE = 0,
+    FC_CODEC_LZ4,
+    FC_CODEC_ZSTD,
+};
+
+enum {
+    FC_COL_TIMESTAMP,
+    FC_COL_FLOW_ID,
+    FC_COL_IN_IFACE,
+    FC_COL_VLAN_0,
+    FC_COL_VLAN_1,
+    FC_COL_SRC_IP,
+    FC_COL_SRC_PORT,
+    FC_COL_DEST_IP,
+    FC_COL_DEST_PORT,
+    FC_COL_PROTO,
+    FC_COL_ICMP_TYPE,
+    FC_COL_ICMP_CODE,
+    FC_COL_RESPONSE_ICMP_TYPE,
+    FC_COL_RESPONSE_ICMP_CODE,
+    FC_COL_APP_PROTO,
+    FC_COL_APP_PROTO_TS,
+    FC_COL_APP_PROTO_TC,
+    FC_COL_APP_PROTO_ORIG,
+    FC_COL_APP_PROTO_EXPECTED,
+    FC_COL_PKTS_TOSERVER,
+    FC_COL_PKTS_TOCLIENT,
+    FC_COL_BYTES_TOSERVER,
+    FC_COL_BYTES_TOCLIENT,
+    FC_COL_BYPASSED_PKTS_TOSERVER,
+    FC_COL_BYPASSED_PKTS_TOCLIENT,
+    FC_COL_BYPASSED_BYTES_TOSERVER,
+    FC_COL_BYPASSED_BYTES_TOCLIENT,
+    FC_COL_START,
+    FC_COL_END,
+    FC_COL_AGE,
+    FC_COL_EMERGENCY,
+    FC_COL_STATE,
+    FC_COL_BYPASS,
+    FC_COL_REASON,
+    FC_COL_ALERTED,
+    FC_COL_WRONG_THREAD,
+    FC_COL_TCP_FLAGS,
+    FC_COL_TCP_FLAGS_TS,
+    FC_COL_TCP_FLAGS_TC,
+    FC_COL_TCP_STATE,
+    FC_COL_TCP_GAP_TS,
+    FC_COL_TCP_GAP_TC,
+    FC_COL_COMMUNITY_ID,
+    FC_COL_MAX,
+};
+
+/** columns, named after the fields of the eve flow record. Times are
+ *  microseconds since the epoch. Fields missing from a record are 0
+ *  or an empty string. */
+static const struct {
+    const char *name;
+    uint8_t type;
+} flow_columns[FC_COL_MAX] = {
+    [FC_COL_TIMESTAMP] = { "timestamp", FC_TYPE_INT64 },
+    [FC_COL_FLOW_ID] = { "flow_id", FC_TYPE_UINT64 },
+    [FC_COL_IN_IFACE] = { "in_iface", FC_TYPE_STRING },
+    [FC_COL_VLAN_0] = { "vlan.0", FC_TYPE_UINT16 },
+    [FC_COL_VLAN_1] = { "vlan.1", FC_TYPE_UINT16 },
+    [FC_COL_SRC_IP] = { "src_ip", FC_TYPE_IP },
+    [FC_COL_SRC_PORT] = { "src_port", FC_TYPE_UINT16 },
+    [FC_COL_DEST_IP] = { "dest_ip", FC_TYPE_IP },
+    [FC_COL_DEST_PORT] = { "dest_port", FC_TYPE_UINT16 },
+    [FC_COL_PROTO] = { "proto", FC_TYPE_UINT8 },
+    [FC_COL_ICMP_TYPE] = { "icmp_type", FC_TYPE_UINT8 },
+    [FC_COL_ICMP_CODE] = { "icmp_code", FC_TYPE_UINT8 },
+    [FC_COL_RESPONSE_ICMP_TYPE] = { "response_icmp_type", FC_TYPE_UINT8 },
+    [FC_COL_RESPONSE_ICMP_CODE] = { "response_icmp_code", FC_TYPE_UINT8 },
+    [FC_COL_APP_PROTO] = { "app_proto", FC_TYPE_STRING },
+    [FC_COL_APP_PROTO_TS] = { "app_proto_ts", FC_TYPE_STRING },
+    [FC_COL_APP_PROTO_TC] = { "app_proto_tc", FC_TYPE_STRING },
+    [FC_COL_APP_PROTO_ORIG] = { "app_proto_orig", FC_TYPE_STRING },
+    [FC_COL_APP_PROTO_EXPECTED] = { "app_proto_expected", FC_TYPE_STRING },
+    [FC_COL_PKTS_TOSERVER] = { "flow.pkts_toserver", FC_TYPE_UINT64 },
+    [FC_COL_PKTS_TOCLIENT] = { "flow.pkts_toclient", FC_TYPE_UINT64 },
+    [FC_COL_BYTES_TOSERVER] = { "flow.bytes_toserver", FC_TYPE_UINT64 },
+    [FC_COL_BYTES_TOCLIENT] = { "flow.bytes_toclient", FC_TYPE_UINT64 },
+    [FC_COL_BYPASSED_PKTS_TOSERVER] = { "flow.bypassed.pkts_toserver", FC_TYPE_UINT64 },
+    [FC_COL_BYPASSED_PKTS_TOCLIENT] = { "flow.bypassed.pkts_toclient", FC_TYPE_UINT64 },
+    [FC_COL_BYPASSED_BYTES_TOSERVER] = { "flow.bypassed.bytes_toserver", FC_TYPE_UINT64 },
+    [FC_COL_BYPASSED_BYTES_TOCLIENT] = { "flow.bypassed.bytes_toclient", FC_TYPE_UINT64 },
+    [FC_COL_START] = { "flow.start", FC_TYPE_INT64 },
+    [FC_COL_END] = { "flow.end", FC_TYPE_INT64 },
+    [FC_COL_AGE] = { "flow.age", FC_TYPE_INT64 },
+    [FC_COL_EMERGENCY] = { "flow.emergency", FC_TYPE_BOOL },
+    [FC_COL_STATE] = { "flow.state", FC_TYPE_STRING },
+    [FC_COL_BYPASS] = { "flow.bypass", FC_TYPE_STRING },
+    [FC_COL_REASON] = { "flow.reason", FC_TYPE_STRING },
+    [FC_COL_ALERTED] = { "flow.alerted", FC_TYPE_BOOL },
+    [FC_COL_WRONG_THREAD] = { "flow.wrong_thread", FC_TYPE_BOOL },
+    [FC_COL_TCP_FLAGS] = { "tcp.tcp_flags", FC_TYPE_UINT8 },
+    [FC_COL_TCP_FLAGS_TS] = { "tcp.tcp_flags_ts", FC_TYPE_UINT8 },
+    [FC_COL_TCP_FLAGS_TC] = { "tcp.tcp_flags_tc", FC_TYPE_UINT8 },
+    [FC_COL_TCP_STATE] = { "tcp.state", FC_TYPE_STRING },
+    [FC_COL_TCP_GAP_TS] = { "tcp.gap_ts", FC_TYPE_BOOL },
+    [FC_COL_TCP_GAP_TC] = { "tcp.gap_tc", FC_TYPE_BOOL },
+    [FC_COL_COMMUNITY_ID] = { "community_id", FC_TYPE_STRING },
+};
+
+typedef struct LogFlowColumnarCtx_ {
+    LogFileCtx *file_ctx;
+    uint32_t batch_size;
+    /** seconds after which a batch is written out, 0 to only write
+     *  out full batches */
+    uint32_t flush_interval;
+    enum FlowColumnCodec codec;
+    int level;
+    bool include_community_id;
+    uint16_t community_id_seed;
+} LogFlowColumnarCtx;
+
+typedef struct FlowColumn_ {
+    uint8_t *buf;
+    uint32_t len;
+    uint32_t size;
+} FlowColumn;
+
+typedef struct LogFlowColumnarThread_ {
+    LogFlowColumnarCtx *ctx;
+    FlowColumn cols[FC_COL_MAX];
+    uint32_t rows;
+    /** log time of the first row of the batch */
+    time_t batch_start;
+    /** encoded batch */
+    uint8_t *out;
+    size_t out_size;
+#ifdef HAVE_LIBZSTD
+    ZSTD_CCtx *zstd_context;
+#endif /* HAVE_LIBZSTD */
+} LogFlowColumnarThread;
+
+static uint32_t FlowColumnWidth(uint8_t type)
+{
+    switch (type) {
+        case FC_TYPE_UINT8:
+        case FC_TYPE_BOOL:
+            return 1;
+        case FC_TYPE_UINT16:
+            return 2;
+        case FC_TYPE_UINT64:
+        case FC_TYPE_INT64:
+            return 8;
+        case FC_TYPE_IP:
+            return 16;
+    }
+    /* strings have no fixed width */
+    return 0;
+}
+
+static int FlowColumnReserve(FlowColumn *c, uint32_t len)
+{
+    if (c->len + len <= c->size)
+        return 0;
+
+    uint32_t size = MAX(c->size * 2, c->len + len);
+    uint8_t *buf = SCRealloc(c->buf, size);
+    if (unlikely(buf == NULL))
+        return -1;
+    c->buf = buf;
+    c->size = size;
+    return 0;
+}
+
+static inline uint8_t *FlowColumnarPut(uint8_t *p, uint64_t val, uint32_t width)
+{
+    for (uint32_t i = 0; i < width; i++) {
+        p[i] = (uint8_t)(val >> (8 * i));
+    }
+    return p + width;
+}
+
+static inline void FlowColumnPut(FlowColumn *c, uint64_t val, uint32_t width)
+{
+    FlowColumnarPut(c->buf + c->len, val, width);
+    c->len += width;
+}
+
+static inline uint32_t FlowColumnStringLen(const char *str)
+{
+    return str ? MIN(strlen(str), UINT16_MAX) : 0;
+}
+
+static inline void FlowColumnPutString(FlowColumn *c, const char *str)
+{
+    const uint32_t len = FlowColumnStringLen(str);
+    FlowColumnPut(c, len, 2);
+    if (len > 0) {
+        memcpy(c->buf + c->len, str, len);
+        c->len += len;
+    }
+}
+
+static inline void FlowColumnPutIp(FlowColumn *c, const Flow *f,
+        const FlowAddress *a)
+{
+    uint8_t *p = c->buf + c->len;
+    if (FLOW_IS_IPV4(f)) {
+        memset(p, 0, 10);
+        p[10] = 0xff;
+        p[11] = 0xff;
+        memcpy(p + 12, &a->addr_data32[0], 4);
+    } else if (FLOW_IS_IPV6(f)) {
+        memcpy(p, a->addr_data8, 16);
+    } else {
+        memset(p, 0, 16);
+    }
+    c->len += 16;
+}
+
+static inline int64_t FlowColumnarTime(const struct timeval *tv)
+{
+    return (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+}
+
+static size_t LogFlowColumnarBound(const LogFlowColumnarCtx *ctx, uint32_t len)
+{
+    size_t bound = len;
+#ifdef HAVE_LIBLZ4
+    if (ctx->codec == FC_CODEC_LZ4)
+        bound = LZ4_compressBound(len);
+#endif /* HAVE_LIBLZ4 */
+#ifdef HAVE_LIBZSTD
+    if (ctx->codec == FC_CODEC_ZSTD)
+        bound = ZSTD_compressBound(len);
+#endif /* HAVE_LIBZSTD */
+    return MAX(bound, len);
+}
+
+/**
+ * \brief Compress a column into dst.
+ *
+ * Columns that don't get smaller are stored as they are.
+ *
+ * \retval codec of the stored column
+ */
+static uint8_t LogFlowColumnarCompress(LogFlowColumnarThread *aft,
+        const FlowColumn *c, uint8_t *dst, size_t dst_size, uint32_t *stored)
+{
+#ifdef HAVE_LIBLZ4
+    if (aft->ctx->codec == FC_CODEC_LZ4) {
+        int r = LZ4_compress_default((const char *)c->buf, (char *)dst,
+                                     c->len, dst_size);
+        if (r > 0 && (uint32_t)r < c->len) {
+            *stored = r;
+            return FC_CODEC_LZ4;
+        }
+    }
+#endif /* HAVE_LIBLZ4 */
+#ifdef HAVE_LIBZSTD
+    if (aft->ctx->codec == FC_CODEC_ZSTD) {
+        size_t r = ZSTD_compressCCtx(aft->zstd_context, dst, dst_size,
+                                     c->buf, c->len, aft->ctx->level);
+        if (!ZSTD_isError(r) && r < c->len) {
+            *stored = r;
+            return FC_CODEC_ZSTD;
+        }
+    }
+#endif /* HAVE_LIBZSTD */
+    memcpy(dst, c->buf, c->len);
+    *stored = c->len;
+    return FC_CODEC_NONE;
+}
+
+/**
+ * \brief Encode the collected rows as a batch and write it out.
+ */
+static void LogFlowColumnarFlush(LogFlowColumnarThread *aft)
+{
+    if (aft->rows == 0)
+        return;
+
+    size_t header_len = FLOW_COLUMNAR_HEADER_LEN;
+    size_t need = 0;
+    for (int i = 0; i < FC_COL_MAX; i++) {
+        header_len += FLOW_COLUMNAR_DESC_LEN + strlen(flow_columns[i].name);
+        need += LogFlowColumnarBound(aft->ctx, aft->cols[i].len);
+    }
+    need += header_len;
+
+    if (need > aft->out_size) {
+        uint8_t *out = SCRealloc(aft->out, need);
+        if (unlikely(out == NULL)) {
+            SCLogDebug("dropping %u flow records", aft->rows);
+            goto reset;
+        }
+        aft->out = out;
+        aft->out_size = need;
+    }
+
+    uint8_t *desc = aft->out + FLOW_COLUMNAR_HEADER_LEN;
+    uint8_t *data = aft->out + header_len;
+    for (int i = 0; i < FC_COL_MAX; i++) {
+        const FlowColumn *c = &aft->cols[i];
+        uint32_t stored = 0;
+        uint8_t codec = LogFlowColumnarCompress(aft, c, data,
+                aft->out_size - (data - aft->out), &stored);
+
+        const uint8_t name_len = strlen(flow_columns[i].name);
+        *desc++ = name_len;
+        memcpy(desc, flow_columns[i].name, name_len);
+        desc += name_len;
+        *desc++ = flow_columns[i].type;
+        *desc++ = codec;
+        desc = FlowColumnarPut(desc, c->len, 4);
+        desc = FlowColumnarPut(desc, stored, 4);
+        data += stored;
+    }
+
+    const uint32_t batch_len = data - aft->out;
+    uint8_t *p = aft->out;
+    memcpy(p, FLOW_COLUMNAR_MAGIC, 4);
+    p = FlowColumnarPut(p + 4, batch_len, 4);
+    *p++ = FLOW_COLUMNAR_VERSION;
+    *p++ = 0;
+    p = FlowColumnarPut(p, FC_COL_MAX, 2);
+    FlowColumnarPut(p, aft->rows, 4);
+
+    LogFileCtx *file_ctx = aft->ctx->file_ctx;
+    file_ctx->Write((const char *)aft->out, batch_len, file_ctx);
+
+reset:
+    for (int i = 0; i < FC_COL_MAX; i++) {
+        aft->cols[i].len = 0;
+    }
+    aft->rows = 0;
+}
+
+static const char *LogFlowColumnarState(const Flow *f)
+{
+    if (f->flow_end_flags & FLOW_END_FLAG_STATE_NEW)
+        return "new";
+    else if (f->flow_end_flags & FLOW_END_FLAG_STATE_ESTABLISHED)
+        return "established";
+    else if (f->flow_end_flags & FLOW_END_FLAG_STATE_CLOSED)
+        return "closed";
+    else if (f->flow_end_flags & FLOW_END_FLAG_STATE_BYPASSED)
+        return "bypassed";
+    return NULL;
+}
+
+static const char *LogFlowColumnarBypass(Flow *f)
+{
+    if (!(f->flow_end_flags & FLOW_END_FLAG_STATE_BYPASSED))
+        return NULL;
+
+    switch (SC_ATOMIC_GET(f->flow_state)) {
+        case FLOW_STATE_LOCAL_BYPASSED:
+            return "local";
+#ifdef CAPTURE_OFFLOAD
+        case FLOW_STATE_CAPTURE_BYPASSED:
+            return "capture";
+#endif
+    }
+    return NULL;
+}
+
+static const char *LogFlowColumnarReason(const Flow *f)
+{
+    if (f->flow_end_flags & FLOW_END_FLAG_TIMEOUT)
+        return "timeout";
+    else if (f->flow_end_flags & FLOW_END_FLAG_FORCED)
+        return "forced";
+    else if (f->flow_end_flags & FLOW_END_FLAG_SHUTDOWN)
+        return "shutdown";
+    return NULL;
+}
+
+/**
+ * \brief Add a flow to the batch of the thread.
+ *
+ * \param fc bypass counters of the flow or NULL
+ */
+static void LogFlowColumnarAddFlow(LogFlowColumnarThread *aft, Flow *f,
+        const FlowBypassInfo *fc, const struct timeval *ts)
+{
+    const TcpSession *ssn = (f->proto == IPPROTO_TCP) ? f->protoctx : NULL;
+
+    unsigned char community_id[64] = "";
+    if (aft->ctx->include_community_id) {
+        CreateCommunityFlowId(f, aft->ctx->community_id_seed,
+                community_id, sizeof(community_id));
+    }
+
+    const char *strings[FC_COL_MAX] = {
+        [FC_COL_IN_IFACE] = f->livedev ? f->livedev->dev : NULL,
+        [FC_COL_APP_PROTO] = AppProtoToString(f->alproto),
+        [FC_COL_APP_PROTO_TS] = AppProtoToString(f->alproto_ts),
+        [FC_COL_APP_PROTO_TC] = AppProtoToString(f->alproto_tc),
+        [FC_COL_APP_PROTO_ORIG] = f->alproto_orig != ALPROTO_UNKNOWN ?
+            AppProtoToString(f->alproto_orig) : NULL,
+        [FC_COL_APP_PROTO_EXPECTED] = f->alproto_expect != ALPROTO_UNKNOWN ?
+            AppProtoToString(f->alproto_expect) : NULL,
+        [FC_COL_STATE] = LogFlowColumnarState(f),
+        [FC_COL_BYPASS] = LogFlowColumnarBypass(f),
+        [FC_COL_REASON] = LogFlowColumnarReason(f),
+        [FC_COL_TCP_STATE] = ssn ? StreamTcpStateAsString(ssn->state) : NULL,
+        [FC_COL_COMMUNITY_ID] = (const char *)community_id,
+    };
+
+    /* the columns grow with the batch, so small or slow batches don't
+     * hold the memory of a full one */
+    for (int i = 0; i < FC_COL_MAX; i++) {
+        const uint32_t len = flow_columns[i].type == FC_TYPE_STRING ?
+            2 + FlowColumnStringLen(strings[i]) :
+            FlowColumnWidth(flow_columns[i].type);
+        if (FlowColumnReserve(&aft->cols[i], len) < 0) {
+            SCLogDebug("dropping flow record");
+            return;
+        }
+    }
+
+    const FlowAddress *src = &f->src, *dst = &f->dst;
+    Port sp = f->sp, dp = f->dp;
+    if (f->flags & FLOW_DIR_REVERSED) {
+        src = &f->dst;
+        dst = &f->src;
+        sp = f->dp;
+        dp = f->sp;
+    }
+
+    bool ports = false, icmp = false;
+    switch (f->proto) {
+        case IPPROTO_UDP:
+        case IPPROTO_TCP:
+        case IPPROTO_SCTP:
+            ports = true;
+            break;
+        case IPPROTO_ICMP:
+        case IPPROTO_ICMPV6:
+            icmp = true;
+            break;
+    }
+
+    FlowColumn *cols = aft->cols;
+    for (int i = 0; i < FC_COL_MAX; i++) {
+        if (flow_columns[i].type == FC_TYPE_STRING)
+            FlowColumnPutString(&cols[i], strings[i]);
+    }
+
+    FlowColumnPut(&cols[FC_COL_TIMESTAMP], FlowColumnarTime(ts), 8);
+    FlowColumnPut(&cols[FC_COL_FLOW_ID], FlowGetId(f), 8);
+    FlowColumnPut(&cols[FC_COL_VLAN_0], f->vlan_idx > 0 ? f->vlan_id[0] : 0, 2);
+    FlowColumnPut(&cols[FC_COL_VLAN_1], f->vlan_idx > 1 ? f->vlan_id[1] : 0, 2);
+    FlowColumnPutIp(&cols[FC_COL_SRC_IP], f, src);
+    FlowColumnPut(&cols[FC_COL_SRC_PORT], ports ? sp : 0, 2);
+    FlowColumnPutIp(&cols[FC_COL_DEST_IP], f, dst);
+    FlowColumnPut(&cols[FC_COL_DEST_PORT], ports ? dp : 0, 2);
+    FlowColumnPut(&cols[FC_COL_PROTO], f->proto, 1);
+    FlowColumnPut(&cols[FC_COL_ICMP_TYPE], icmp ? f->icmp_s.type : 0, 1);
+    FlowColumnPut(&cols[FC_COL_ICMP_CODE], icmp ? f->icmp_s.code : 0, 1);
+    FlowColumnPut(&cols[FC_COL_RESPONSE_ICMP_TYPE],
+            icmp && f->tosrcpktcnt ? f->icmp_d.type : 0, 1);
+    FlowColumnPut(&cols[FC_COL_RESPONSE_ICMP_CODE],
+            icmp && f->tosrcpktcnt ? f->icmp_d.code : 0, 1);
+
+    FlowColumnPut(&cols[FC_COL_PKTS_TOSERVER],
+            f->todstpktcnt + (fc ? fc->todstpktcnt : 0), 8);
+    FlowColumnPut(&cols[FC_COL_PKTS_TOCLIENT],
+            f->tosrcpktcnt + (fc ? fc->tosrcpktcnt : 0), 8);
+    FlowColumnPut(&cols[FC_COL_BYTES_TOSERVER],
+            f->todstbytecnt + (fc ? fc->todstbytecnt : 0), 8);
+    FlowColumnPut(&cols[FC_COL_BYTES_TOCLIENT],
+            f->tosrcbytecnt + (fc ? fc->tosrcbytecnt : 0), 8);
+    FlowColumnPut(&cols[FC_COL_BYPASSED_PKTS_TOSERVER], fc ? fc->todstpktcnt : 0, 8);
+    FlowColumnPut(&cols[FC_COL_BYPASSED_PKTS_TOCLIENT], fc ? fc->tosrcpktcnt : 0, 8);
+    FlowColumnPut(&cols[FC_COL_BYPASSED_BYTES_TOSERVER], fc ? fc->todstbytecnt : 0, 8);
+    FlowColumnPut(&cols[FC_COL_BYPASSED_BYTES_TOCLIENT], fc ? fc->tosrcbytecnt : 0, 8);
+
+    FlowColumnPut(&cols[FC_COL_START], FlowColumnarTime(&f->startts), 8);
+    FlowColumnPut(&cols[FC_COL_END], FlowColumnarTime(&f->lastts), 8);
+    FlowColumnPut(&cols[FC_COL_AGE], f->lastts.tv_sec - f->startts.tv_sec, 8);
+    FlowColumnPut(&cols[FC_COL_EMERGENCY],
+            (f->flow_end_flags & FLOW_END_FLAG_EMERGENCY) != 0, 1);
+    FlowColumnPut(&cols[FC_COL_ALERTED], FlowHasAlerts(f) != 0, 1);
+    FlowColumnPut(&cols[FC_COL_WRONG_THREAD], (f->flags & FLOW_WRONG_THREAD) != 0, 1);
+
+    FlowColumnPut(&cols[FC_COL_TCP_FLAGS], ssn ? ssn->tcp_packet_flags : 0, 1);
+    FlowColumnPut(&cols[FC_COL_TCP_FLAGS_TS], ssn ? ssn->client.tcp_flags : 0, 1);
+    FlowColumnPut(&cols[FC_COL_TCP_FLAGS_TC], ssn ? ssn->server.tcp_flags : 0, 1);
+    FlowColumnPut(&cols[FC_COL_TCP_GAP_TS],
+            ssn && (ssn->client.flags & STREAMTCP_STREAM_FLAG_GAP), 1);
+    FlowColumnPut(&cols[FC_COL_TCP_GAP_TC],
+            ssn && (ssn->server.flags & STREAMTCP_STREAM_FLAG_GAP), 1);
+
+    if (aft->rows == 0)
+        aft->batch_start = ts->tv_sec;
+    aft->rows++;
+}
+
+/**
+ * \brief Write out the batch if it is older than the flush interval.
+ */
+static void LogFlowColumnarFlushOld(LogFlowColumnarThread *aft,
+        const struct timeval *ts)
+{
+    const LogFlowColumnarCtx *ctx = aft->ctx;
+    if (aft->rows > 0 && ctx->flush_interval > 0 &&
+            ts->tv_sec - aft->batch_start >= (time_t)ctx->flush_interval) {
+        LogFlowColumnarFlush(aft);
+    }
+}
+
+static int LogFlowColumnarLogger(ThreadVars *tv, void *thread_data, Flow *f)
+{
+    SCEnter();
+    LogFlowColumnarThread *aft = (LogFlowColumnarThread *)thread_data;
+    const LogFlowColumnarCtx *ctx = aft->ctx;
+
+    struct timeval ts;
+    memset(&ts, 0x00, sizeof(ts));
+    TimeGet(&ts);
+
+    LogFlowColumnarFlushOld(aft, &ts);
+
+    const FlowBypassInfo *fc = FlowGetStorageById(f, GetFlowBypassInfoID());
+    LogFlowColumnarAddFlow(aft, f, fc, &ts);
+
+    if (aft->rows >= ctx->batch_size) {
+        LogFlowColumnarFlush(aft);
+    }
+
+    SCReturnInt(TM_ECODE_OK);
+}
+
+/**
+ * \brief Periodic flush, so a batch doesn't wait for the next flow to
+ *        reach the flush interval.
+ */
+static void LogFlowColumnarLoggerFlush(ThreadVars *tv, void *thread_data,
+        const struct timeval *ts)
+{
+    LogFlowColumnarThread *aft = (LogFlowColumnarThread *)thread_data;
+    if (aft == NULL)
+        return;
+
+    LogFlowColumnarFlushOld(aft, ts);
+}
+
+static void LogFlowColumnarThreadFree(LogFlowColumnarThread *aft)
+{
+    for (int i = 0; i < FC_COL_MAX; i++) {
+        if (aft->cols[i].buf != NULL)
+            SCFree(aft->cols[i].buf);
+    }
+    if (aft->out != NULL)
+        SCFree(aft->out);
+#ifdef HAVE_LIBZSTD
+    if (aft->zstd_context != NULL)
+        ZSTD_freeCCtx(aft->zstd_context);
+#endif /* HAVE_LIBZSTD */
+    SCFree(aft);
+}
+
+static LogFlowColumnarThread *LogFlowColumnarThreadNew(LogFlowColumnarCtx *ctx)
+{
+    LogFlowColumnarThread *aft = SCCalloc(1, sizeof(LogFlowColumnarThread));
+    if (unlikely(aft == NULL))
+        return NULL;
+    aft->ctx = ctx;
+
+#ifdef HAVE_LIBZSTD
+    if (ctx->codec == FC_CODEC_ZSTD) {
+        aft->zstd_context = ZSTD_createCCtx();
+        if (aft->zstd_context == NULL) {
+            LogFlowColumnarThreadFree(aft);
+            return NULL;
+        }
+    }
+#endif /* HAVE_LIBZSTD */
+
+    return aft;
+}
+
+static TmEcode LogFlowColumnarThreadInit(ThreadVars *t, const void *initdata, void **data)
+{
+    if (initdata == NULL) {
+        SCLogDebug("Error getting context for LogFlowColumnar. \"initdata\" argument NULL");
+        return TM_ECODE_FAILED;
+    }
+
+    LogFlowColumnarThread *aft =
+        LogFlowColumnarThreadNew(((OutputCtx *)initdata)->data);
+    if (unlikely(aft == NULL))
+        return TM_ECODE_FAILED;
+
+    *data = (void *)aft;
+    return TM_ECODE_OK;
+}
+
+static TmEcode LogFlowColumnarThreadDeinit(ThreadVars *t, void *data)
+{
+    LogFlowColumnarThread *aft = (LogFlowColumnarThread *)data;
+    if (aft == NULL) {
+        return TM_ECODE_OK;
+    }
+
+    LogFlowColumnarFlush(aft);
+    LogFlowColumnarThreadFree(aft);
+    return TM_ECODE_OK;
+}
+
+static void LogFlowColumnarDeInitCtx(OutputCtx *output_ctx)
+{
+    LogFlowColumnarCtx *ctx = (LogFlowColumnarCtx *)output_ctx->data;
+    LogFileFreeCtx(ctx->file_ctx);
+    SCFree(ctx);
+    SCFree(output_ctx);
+}
+
+static int LogFlowColumnarParseConfig(ConfNode *conf, LogFlowColumnarCtx *ctx)
+{
+#if defined(HAVE_LIBZSTD)
+    ctx->codec = FC_CODEC_ZSTD;
+#elif defined(HAVE_LIBLZ4)
+    ctx->codec = FC_CODEC_LZ4;
+#else
+    ctx->codec = FC_CODEC_NONE;
+#endif
+#ifdef HAVE_LIBZSTD
+    ctx->level = ZSTD_CLEVEL_DEFAULT;
+#endif /* HAVE_LIBZSTD */
+    ctx->batch_size = DEFAULT_BATCH_SIZE;
+    ctx->flush_interval = DEFAULT_FLUSH_INTERVAL;
+
+    const char *codec = ConfNodeLookupChildValue(conf, "codec");
+    if (codec != NULL) {
+        if (strcmp(codec, "none") == 0) {
+            ctx->codec = FC_CODEC_NONE;
+        } else if (strcmp(codec, "lz4") == 0) {
+#ifdef HAVE_LIBLZ4
+            ctx->codec = FC_CODEC_LZ4;
+#else
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "%s.codec: lz4 "
+                       "requires Suricata to be built with liblz4", conf->name);
+            return -1;
+#endif /* HAVE_LIBLZ4 */
+        } else if (strcmp(codec, "zstd") == 0) {
+#ifdef HAVE_LIBZSTD
+            ctx->codec = FC_CODEC_ZSTD;
+#else
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "%s.codec: zstd "
+                       "requires Suricata to be built with libzstd", conf->name);
+            return -1;
+#endif /* HAVE_LIBZSTD */
+        } else {
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "invalid value for "
+                       "%s.codec: %s. Expected \"none\", \"lz4\" or \"zstd\"",
+                       conf->name, codec);
+            return -1;
+        }
+    }
+
+    intmax_t value = 0;
+    if (ConfGetChildValueInt(conf, "compression-level", &value)) {
+        ctx->level = (int)value;
+    }
+    if (ConfGetChildValueInt(conf, "batch-size", &value)) {
+        if (value < 1 || value > MAX_BATCH_SIZE) {
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "invalid value for "
+                       "%s.batch-size: %"PRIdMAX". Expected 1 to %d",
+                       conf->name, value, MAX_BATCH_SIZE);
+            return -1;
+        }
+        ctx->batch_size = (uint32_t)value;
+    }
+    if (ConfGetChildValueInt(conf, "flush-interval", &value)) {
+        if (value < 0 || value > UINT32_MAX) {
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "invalid value for "
+                       "%s.flush-interval: %"PRIdMAX, conf->name, value);
+            return -1;
+        }
+        ctx->flush_interval = (uint32_t)value;
+    }
+
+    const char *community_id = ConfNodeLookupChildValue(conf, "community-id");
+    if (community_id != NULL && ConfValIsTrue(community_id)) {
+        ctx->include_community_id = true;
+    }
+    const char *cid_seed = ConfNodeLookupChildValue(conf, "community-id-seed");
+    if (cid_seed != NULL) {
+        if (ByteExtractStringUint16(&ctx->community_id_seed, 10, 0,
+                    cid_seed) == -1) {
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "invalid value for "
+                       "%s.community-id-seed: %s", conf->name, cid_seed);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static OutputInitResult LogFlowColumnarInitCtx(ConfNode *conf)
+{
+    OutputInitResult result = { NULL, false };
+
+    LogFlowColumnarCtx *ctx = SCCalloc(1, sizeof(LogFlowColumnarCtx));
+    if (unlikely(ctx == NULL))
+        return result;
+
+    if (LogFlowColumnarParseConfig(conf, ctx) < 0) {
+        SCFree(ctx);
+        return result;
+    }
+
+    LogFileCtx *file_ctx = LogFileNewCtx();
+    if (file_ctx == NULL) {
+        SCLogError(SC_ERR_FLOW_LOG_GENERIC, "couldn't create new file_ctx");
+        SCFree(ctx);
+        return result;
+    }
+
+    if (SCConfLogOpenGeneric(conf, file_ctx, DEFAULT_LOG_FILENAME, 1) < 0) {
+        LogFileFreeCtx(file_ctx);
+        SCFree(ctx);
+        return result;
+    }
+    if (!file_ctx->is_regular) {
+        SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "%s only supports "
+                   "regular files", conf->name);
+        LogFileFreeCtx(file_ctx);
+        SCFree(ctx);
+        return result;
+    }
+    ctx->file_ctx = file_ctx;
+
+    OutputCtx *output_ctx = SCCalloc(1, sizeof(OutputCtx));
+    if (unlikely(output_ctx == NULL)) {
+        LogFileFreeCtx(file_ctx);
+        SCFree(ctx);
+        return result;
+    }
+
+    output_ctx->data = ctx;
+    output_ctx->DeInit = LogFlowColumnarDeInitCtx;
+
+    SCLogDebug("flow columnar log output initialized");
+
+    result.ctx = output_ctx;
+    result.ok = true;
+    return result;
+}
+
+#ifdef UNITTESTS
+#include "util-unittest-helper.h"
+
+static uint8_t *test_batch = NULL;
+static int test_batch_len = 0;
+
+static int LogFlowColumnarTestWrite(const char *buffer, int buffer_len,
+        LogFileCtx *file_ctx)
+{
+    SCFree(test_batch);
+    test_batch = SCMalloc(buffer_len);
+    if (test_batch == NULL)
+        return -1;
+    memcpy(test_batch, buffer, buffer_len);
+    test_batch_len = buffer_len;
+    return 0;
+}
+
+static uint64_t LogFlowColumnarTestGet(const uint8_t *p, uint32_t width)
+{
+    uint64_t val = 0;
+    for (uint32_t i = 0; i < width; i++) {
+        val |= (uint64_t)p[i] << (8 * i);
+    }
+    return val;
+}
+
+/** \brief look up a column in the test batch */
+static const uint8_t *LogFlowColumnarTestColumn(const char *name,
+        uint32_t *raw_len)
+{
+    const uint16_t columns = LogFlowColumnarTestGet(test_batch + 10, 2);
+    const uint8_t *desc = test_batch + FLOW_COLUMNAR_HEADER_LEN;
+    const uint8_t *data = desc;
+    for (int i = 0; i < columns; i++)
+        data += FLOW_COLUMNAR_DESC_LEN + data[0];
+
+    for (int i = 0; i < columns; i++) {
+        const uint8_t name_len = *desc++;
+        const bool match = (name_len == strlen(name) &&
+                            memcmp(desc, name, name_len) == 0);
+        desc += name_len + 2;
+        *raw_len = LogFlowColumnarTestGet(desc, 4);
+        const uint32_t stored = LogFlowColumnarTestGet(desc + 4, 4);
+        desc += 8;
+        if (match)
+            return data;
+        data += stored;
+    }
+    return NULL;
+}
+
+/** \test encode two flows without compression and check the batch */
+static int LogFlowColumnarTest01(void)
+{
+    LogFlowColumnarCtx ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.codec = FC_CODEC_NONE;
+    ctx.batch_size = 4;
+
+    LogFileCtx *file_ctx = LogFileNewCtx();
+    FAIL_IF_NULL(file_ctx);
+    file_ctx->Write = LogFlowColumnarTestWrite;
+    ctx.file_ctx = file_ctx;
+
+    LogFlowColumnarThread *aft = LogFlowColumnarThreadNew(&ctx);
+    FAIL_IF_NULL(aft);
+
+    Flow *f1 = UTHBuildFlow(AF_INET, "1.2.3.4", "5.6.7.8", 1024, 80);
+    FAIL_IF_NULL(f1);
+    f1->proto = IPPROTO_TCP;
+    f1->alproto = ALPROTO_HTTP;
+    f1->todstpktcnt = 3;
+    Flow *f2 = UTHBuildFlow(AF_INET, "1.2.3.4", "5.6.7.8", 53, 53);
+    FAIL_IF_NULL(f2);
+    f2->proto = IPPROTO_UDP;
+    f2->flags |= FLOW_DIR_REVERSED;
+    FlowBypassInfo fc;
+    memset(&fc, 0, sizeof(fc));
+    fc.todstpktcnt = 10;
+
+    struct timeval ts = { 1, 0 };
+    LogFlowColumnarAddFlow(aft, f1, NULL, &ts);
+    LogFlowColumnarAddFlow(aft, f2, &fc, &ts);
+    FAIL_IF_NOT(aft->rows == 2);
+    FAIL_IF_NOT(test_batch == NULL);
+
+    LogFlowColumnarFlush(aft);
+    FAIL_IF_NOT(aft->rows == 0);
+    FAIL_IF_NULL(test_batch);
+    FAIL_IF_NOT(memcmp(test_batch, FLOW_COLUMNAR_MAGIC, 4) == 0);
+    FAIL_IF_NOT(LogFlowColumnarTestGet(test_batch + 4, 4) == (uint64_t)test_batch_len);
+    FAIL_IF_NOT(test_batch[8] == FLOW_COLUMNAR_VERSION);
+    FAIL_IF_NOT(LogFlowColumnarTestGet(test_batch + 10, 2) == FC_COL_MAX);
+    FAIL_IF_NOT(LogFlowColumnarTestGet(test_batch + 12, 4) == 2);
+
+    uint32_t raw_len = 0;
+    const uint8_t *col = LogFlowColumnarTestColumn("dest_port", &raw_len);
+    FAIL_IF_NULL(col);
+    FAIL_IF_NOT(raw_len == 4);
+    FAIL_IF_NOT(LogFlowColumnarTestGet(col, 2) == 80);
+    FAIL_IF_NOT(LogFlowColumnarTestGet(col + 2, 2) == 53);
+
+    col = LogFlowColumnarTestColumn("flow.pkts_toserver", &raw_len);
+    FAIL_IF_NULL(col);
+    FAIL_IF_NOT(raw_len == 16);
+    FAIL_IF_NOT(LogFlowColumnarTestGet(col, 8) == 3);
+    FAIL_IF_NOT(LogFlowColumnarTestGet(col + 8, 8) == 10);
+
+    col = LogFlowColumnarTestColumn("src_ip", &raw_len);
+    FAIL_IF_NULL(col);
+    FAIL_IF_NOT(raw_len == 32);
+    static const uint8_t src[16] = { 0,0,0,0,0,0,0,0,0,0,0xff,0xff,1,2,3,4 };
+    static const uint8_t src_rev[16] = { 0,0,0,0,0,0,0,0,0,0,0xff,0xff,5,6,7,8 };
+    FAIL_IF_NOT(memcmp(col, src, 16) == 0);
+    FAIL_IF_NOT(memcmp(col + 16, src_rev, 16) == 0);
+
+    /* unknown protocols are stored as empty strings */
+    col = LogFlowColumnarTestColumn("app_proto", &raw_len);
+    FAIL_IF_NULL(col);
+    FAIL_IF_NOT(raw_len == 2 + 4 + 2);
+    FAIL_IF_NOT(LogFlowColumnarTestGet(col, 2) == 4);
+    FAIL_IF_NOT(memcmp(col + 2, "http", 4) == 0);
+    FAIL_IF_NOT(LogFlowColumnarTestGet(col + 6, 2) == 0);
+
+    UTHFreeFlow(f1);
+    UTHFreeFlow(f2);
+    LogFlowColumnarThreadFree(aft);
+    LogFileFreeCtx(file_ctx);
+    SCFree(test_batch);
+    test_batch = NULL;
+    PASS;
+}
+
+/** \test the periodic flush writes out old batches, and the age and
+ *        community_id columns */
+static int LogFlowColumnarTest02(void)
+{
+    LogFlowColumnarCtx ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.codec = FC_CODEC_NONE;
+    ctx.batch_size = MAX_BATCH_SIZE;
+    ctx.flush_interval = 10;
+    ctx.include_community_id = true;
+
+    LogFileCtx *file_ctx = LogFileNewCtx();
+    FAIL_IF_NULL(file_ctx);
+    file_ctx->Write = LogFlowColumnarTestWrite;
+    ctx.file_ctx = file_ctx;
+
+    /* nothing is allocated until flows are logged */
+    LogFlowColumnarThread *aft = LogFlowColumnarThreadNew(&ctx);
+    FAIL_IF_NULL(aft);
+    for (int i = 0; i < FC_COL_MAX; i++) {
+        FAIL_IF_NOT(aft->cols[i].size == 0);
+    }
+
+    Flow *f = UTHBuildFlow(AF_INET, "1.2.3.4", "5.6.7.8", 1024, 80);
+    FAIL_IF_NULL(f);
+    f->proto = IPPROTO_TCP;
+    f->startts.tv_sec = 90;
+    f->lastts.tv_sec = 97;
+
+    struct timeval ts = { 100, 0 };
+    LogFlowColumnarAddFlow(aft, f, NULL, &ts);
+    FAIL_IF_NOT(aft->rows == 1);
+    FAIL_IF_NOT(aft->cols[FC_COL_SRC_IP].size < 16 * 1024);
+
+    ts.tv_sec = 109;
+    LogFlowColumnarLoggerFlush(NULL, aft, &ts);
+    FAIL_IF_NOT(aft->rows == 1);
+    FAIL_IF_NOT(test_batch == NULL);
+
+    ts.tv_sec = 110;
+    LogFlowColumnarLoggerFlush(NULL, aft, &ts);
+    FAIL_IF_NOT(aft->rows == 0);
+    FAIL_IF_NULL(test_batch);
+    FAIL_IF_NOT(LogFlowColumnarTestGet(test_batch + 12, 4) == 1);
+
+    uint32_t raw_len = 0;
+    const uint8_t *col = LogFlowColumnarTestColumn("flow.age", &raw_len);
+    FAIL_IF_NULL(col);
+    FAIL_IF_NOT(raw_len == 8);
+    FAIL_IF_NOT(LogFlowColumnarTestGet(col, 8) == 7);
+
+    unsigned char community_id[64];
+    FAIL_IF_NOT(CreateCommunityFlowId(f, 0, community_id, sizeof(community_id)));
+    const uint32_t len = strlen((const char *)community_id);
+    col = LogFlowColumnarTestColumn("community_id", &raw_len);
+    FAIL_IF_NULL(col);
+    FAIL_IF_NOT(raw_len == 2 + len);
+    FAIL_IF_NOT(LogFlowColumnarTestGet(col, 2) == len);
+    FAIL_IF_NOT(memcmp(col + 2, community_id, len) == 0);
+
+    /* an empty batch isn't written out */
+    SCFree(test_batch);
+    test_batch = NULL;
+    ts.tv_sec = 200;
+    LogFlowColumnarLoggerFlush(NULL, aft, &ts);
+    FAIL_IF_NOT(test_batch == NULL);
+
+    UTHFreeFlow(f);
+    LogFlowColumnarThreadFree(aft);
+    LogFileFreeCtx(file_ctx);
+    PASS;
+}
+
+static void LogFlowColumnarRegisterTests(void)
+{
+    UtRegisterTest("LogFlowColumnarTest01", LogFlowColumnarTest01);
+    UtRegisterTest("LogFlowColumnarTest02", LogFlowColumnarTest02);
+}
+#endif /* UNITTESTS */
+
+void LogFlowColumnarRegister(void)
+{
+    OutputRegisterFlowModule(LOGGER_FLOW_COLUMNAR, MODULE_NAME, "flow-columnar",
+        LogFlowColumnarInitCtx, LogFlowColumnarLogger,
+        LogFlowColumnarLoggerFlush, LogFlowColumnarThreadInit,
+        LogFlowColumnarThreadDeinit, NULL);
+#ifdef UNITTESTS
+    LogFlowColumnarRegisterTests();
+#endif /* UNITTESTS */
+}
@@ -45,6 +45,7 @@ typedef struct OutputLoggerThreadData_ {
  * log module (e.g. http.log) with different output ctx'. */
 typedef struct OutputFlowLogger_ {
     FlowLogger LogFunc;
+    FlowLoggerFlush FlushFunc;
     OutputCtx *output_ctx;
     struct OutputFlowLogger_ *next;
     const char *name;
@@ -56,7 +57,7 @@ typedef struct OutputFlowLogger_ {
 static OutputFlowLogger *list = NULL;
 
 int OutputRegisterFlowLogger(const char *name, FlowLogger LogFunc,
-    OutputCtx *output_ctx, ThreadInitFunc ThreadInit,
+    FlowLoggerFlush FlushFunc, OutputCtx *output_ctx, ThreadInitFunc ThreadInit,
     ThreadDeinitFunc ThreadDeinit,
     ThreadExitPrintStatsFunc ThreadExitPrintStats)
 {
@@ -66,6 +67,7 @@ int OutputRegisterFlowLogger(const char *name, FlowLogger LogFunc,
     memset(op, 0x00, sizeof(*op));
 
     op->LogFunc = LogFunc;
+    op->FlushFunc = FlushFunc;
     op->output_ctx = output_ctx;
     op->name = name;
     op->ThreadInit = ThreadInit;
@@ -123,6 +125,30 @@ TmEcode OutputFlowLog(ThreadVars *tv, void *thread_data, Flow *f)
     return TM_ECODE_OK;
 }
 
+/** \brief Run the flush functions of the flow logger(s)
+ *
+ *  Lets loggers that buffer records write them out when no flows
+ *  are logged for a while.
+ */
+void OutputFlowLogFlush(ThreadVars *tv, void *thread_data,
+        const struct timeval *ts)
+{
+    if (list == NULL || thread_data == NULL)
+        return;
+
+    OutputLoggerThreadData *op_thread_data = (OutputLoggerThreadData *)thread_data;
+    OutputFlowLogger *logger = list;
+    OutputLoggerThreadStore *store = op_thread_data->store;
+
+    while (logger && store) {
+        if (logger->FlushFunc) {
+            logger->FlushFunc(tv, store->thread_data, ts);
+        }
+        logger = logger->next;
+        store = store->next;
+    }
+}
+
 /** \brief thread init for the flow logger
  *  This will run the thread init functions for the individual registered
  *  loggers */
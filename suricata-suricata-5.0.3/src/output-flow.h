@@ -31,19 +31,26 @@
 /** flow logger function pointer type */
 typedef int (*FlowLogger)(ThreadVars *, void *thread_data, Flow *f);
 
+/** flow logger flush function pointer type, called about once a second
+ *  from the flow recycler so loggers can write out buffered records */
+typedef void (*FlowLoggerFlush)(ThreadVars *, void *thread_data,
+        const struct timeval *ts);
+
 /** packet logger condition function pointer type,
  *  must return true for packets that should be logged
  */
 //typedef int (*TxLogCondition)(ThreadVars *, const Packet *);
 
 int OutputRegisterFlowLogger(const char *name, FlowLogger LogFunc,
-    OutputCtx *, ThreadInitFunc ThreadInit, ThreadDeinitFunc ThreadDeinit,
+    FlowLoggerFlush FlushFunc, OutputCtx *, ThreadInitFunc ThreadInit, ThreadDeinitFunc ThreadDeinit,
     ThreadExitPrintStatsFunc ThreadExitPrintStats);
 
 void OutputFlowShutdown(void);
 
 
 TmEcode OutputFlowLog(ThreadVars *tv, void *thread_data, Flow *f);
+void OutputFlowLogFlush(ThreadVars *tv, void *thread_data,
+        const struct timeval *ts);
 TmEcode OutputFlowLogThreadInit(ThreadVars *tv, void *initdata, void **data);
 TmEcode OutputFlowLogThreadDeinit(ThreadVars *tv, void *thread_data);
 void OutputFlowLogExitPrintStats(ThreadVars *tv, void *thread_data);
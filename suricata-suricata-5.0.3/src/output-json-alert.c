@@ -126,23 +126,6 @@ static int AlertJsonDumpStreamSegmentCallback(const Packet *p, void *data, const
     return 1;
 }
 
-static void AlertJsonTls(const Flow *f, json_t *js)
-{
-    SSLState *ssl_state = (SSLState *)FlowGetAppState(f);
-    if (ssl_state) {
-        json_t *tjs = json_object();
-        if (unlikely(tjs == NULL))
-            return;
-
-        JsonTlsLogJSONBasic(tjs, ssl_state);
-        JsonTlsLogJSONExtended(tjs, ssl_state);
-
-        json_object_set_new(js, "tls", tjs);
-    }
-
-    return;
-}
-
 static void AlertJsonSsh(const Flow *f, json_t *js)
 {
     SshState *ssh_state = (SshState *)FlowGetAppState(f);
@@ -292,10 +275,8 @@ static void AlertJsonMetadata(AlertJsonOutputCtx *json_output_ctx, const PacketA
 }
 
 
-void AlertJsonHeader(void *ctx, const Packet *p, const PacketAlert *pa, json_t *js,
-                     uint16_t flags)
+static const char *AlertJsonAction(const Packet *p, const PacketAlert *pa)
 {
-    AlertJsonOutputCtx *json_output_ctx = (AlertJsonOutputCtx *)ctx;
     const char *action = "allowed";
     /* use packet action if rate_filter modified the action */
     if (unlikely(pa->flags & PACKET_ALERT_RATE_FILTER_MODIFIED)) {
@@ -310,6 +291,14 @@ void AlertJsonHeader(void *ctx, const Packet *p, const PacketAlert *pa, json_t *
             action = "blocked";
         }
     }
+    return action;
+}
+
+void AlertJsonHeader(void *ctx, const Packet *p, const PacketAlert *pa, json_t *js,
+                     uint16_t flags)
+{
+    AlertJsonOutputCtx *json_output_ctx = (AlertJsonOutputCtx *)ctx;
+    const char *action = AlertJsonAction(p, pa);
 
     /* Add tx_id to root element for correlation with other events. */
     json_object_del(js, "tx_id");
@@ -346,47 +335,237 @@ void AlertJsonHeader(void *ctx, const Packet *p, const PacketAlert *pa, json_t *
     json_object_set_new(js, "alert", ajs);
 }
 
-static void AlertJsonTunnel(const Packet *p, json_t *js)
+static void EveAlertSourceTarget(const Packet *p, const PacketAlert *pa,
+        const JsonAddrInfo *addr, JsonBuilder *jb)
+{
+    const char *src_ip = addr->src_ip, *dst_ip = addr->dst_ip;
+    Port sp = addr->sp, dp = addr->dp;
+
+    if (pa->s->flags & SIG_FLAG_SRC_IS_TARGET) {
+        src_ip = addr->dst_ip;
+        dst_ip = addr->src_ip;
+        sp = addr->dp;
+        dp = addr->sp;
+    } else if (!(pa->s->flags & SIG_FLAG_DEST_IS_TARGET)) {
+        JsonBuilderOpenObject(jb, "source");
+        JsonBuilderClose(jb);
+        JsonBuilderOpenObject(jb, "target");
+        JsonBuilderClose(jb);
+        return;
+    }
+
+    bool ports = false;
+    switch (p->proto) {
+        case IPPROTO_UDP:
+        case IPPROTO_TCP:
+        case IPPROTO_SCTP:
+            ports = true;
+            break;
+    }
+
+    JsonBuilderOpenObject(jb, "source");
+    JsonBuilderSetString(jb, "ip", src_ip);
+    if (ports)
+        JsonBuilderSetUint(jb, "port", sp);
+    JsonBuilderClose(jb);
+
+    JsonBuilderOpenObject(jb, "target");
+    JsonBuilderSetString(jb, "ip", dst_ip);
+    if (ports)
+        JsonBuilderSetUint(jb, "port", dp);
+    JsonBuilderClose(jb);
+}
+
+/** \brief add the rule metadata with the values of a key as array */
+static void EveAlertMetadata(const PacketAlert *pa, JsonBuilder *jb)
 {
-    json_t *tunnel = json_object();
-    if (tunnel == NULL)
+    if (pa->s->metadata == NULL)
         return;
 
+    JsonBuilderOpenObject(jb, "metadata");
+    for (const DetectMetadata *kv = pa->s->metadata; kv != NULL; kv = kv->next) {
+        /* logged with the first value of the key */
+        const DetectMetadata *prev = pa->s->metadata;
+        while (prev != kv && strcmp(prev->key, kv->key) != 0)
+            prev = prev->next;
+        if (prev != kv)
+            continue;
+
+        JsonBuilderOpenArray(jb, kv->key);
+        for (const DetectMetadata *v = kv; v != NULL; v = v->next) {
+            if (strcmp(v->key, kv->key) == 0)
+                JsonBuilderSetString(jb, NULL, v->value);
+        }
+        JsonBuilderClose(jb);
+    }
+    JsonBuilderClose(jb);
+}
+
+/** \brief add the "alert" object, see AlertJsonHeader() */
+static void EveAlertHeader(AlertJsonOutputCtx *json_output_ctx,
+        const Packet *p, const PacketAlert *pa, const JsonAddrInfo *addr,
+        JsonBuilder *jb)
+{
+    /* Add tx_id to root element for correlation with other events. */
+    if (pa->flags & PACKET_ALERT_FLAG_TX)
+        JsonBuilderSetUint(jb, "tx_id", pa->tx_id);
+
+    JsonBuilderOpenObject(jb, "alert");
+    JsonBuilderSetString(jb, "action", AlertJsonAction(p, pa));
+    JsonBuilderSetUint(jb, "gid", pa->s->gid);
+    JsonBuilderSetUint(jb, "signature_id", pa->s->id);
+    JsonBuilderSetUint(jb, "rev", pa->s->rev);
+    JsonBuilderSetString(jb, "signature", (pa->s->msg) ? pa->s->msg : "");
+    JsonBuilderSetString(jb, "category",
+            (pa->s->class_msg) ? pa->s->class_msg : "");
+    JsonBuilderSetInt(jb, "severity", pa->s->prio);
+
+    if (p->tenant_id > 0)
+        JsonBuilderSetUint(jb, "tenant_id", p->tenant_id);
+
+    if (pa->s->flags & SIG_FLAG_HAS_TARGET) {
+        EveAlertSourceTarget(p, pa, addr, jb);
+    }
+
+    if (json_output_ctx->flags & LOG_JSON_RULE_METADATA) {
+        EveAlertMetadata(pa, jb);
+    }
+
+    /* signature text */
+    if (json_output_ctx->flags & LOG_JSON_RULE) {
+        JsonBuilderSetString(jb, "rule", pa->s->sig_str);
+    }
+    JsonBuilderClose(jb);
+}
+
+static void EveAlertTunnel(const Packet *p, JsonBuilder *jb)
+{
     if (p->root == NULL) {
-        json_decref(tunnel);
         return;
     }
 
+    JsonBuilderOpenObject(jb, "tunnel");
+
     /* get a lock to access root packet fields */
     SCMutex *m = &p->root->tunnel_mutex;
 
     SCMutexLock(m);
-    JsonFiveTuple((const Packet *)p->root, 0, tunnel);
+    JsonAddrInfo addr = json_addr_info_zero;
+    if (JsonAddrInfoInit(p->root, LOG_DIR_PACKET, &addr)) {
+        EveAddAddrInfo(jb, p->root, &addr);
+    }
     SCMutexUnlock(m);
 
-    json_object_set_new(tunnel, "depth", json_integer(p->recursion_level));
+    JsonBuilderSetUint(jb, "depth", p->recursion_level);
+
+    JsonBuilderClose(jb);
+}
+
+/** \brief add a jansson object built by an app layer logger */
+static void EveAlertAddJson(JsonBuilder *jb, const char *key, json_t *js)
+{
+    if (js != NULL) {
+        JsonBuilderSetJson(jb, key, js);
+        json_decref(js);
+    }
+}
 
-    json_object_set_new(js, "tunnel", tunnel);
+static void EveAlertAppLayer(AlertJsonOutputCtx *json_output_ctx,
+        const Packet *p, const PacketAlert *pa, JsonBuilder *jb)
+{
+    const AppProto proto = FlowGetAppProtocol(p->flow);
+    json_t *hjs;
+    switch (proto) {
+        case ALPROTO_HTTP: {
+            JsonBuilderMark mark;
+            JsonBuilderGetMark(jb, &mark);
+            JsonBuilderOpenObject(jb, "http");
+            if (EveHttpAddMetadata(p->flow, pa->tx_id, jb)) {
+                if (json_output_ctx->flags & LOG_JSON_HTTP_BODY) {
+                    EveHttpLogJSONBodyPrintable(jb, p->flow, pa->tx_id);
+                }
+                if (json_output_ctx->flags & LOG_JSON_HTTP_BODY_BASE64) {
+                    EveHttpLogJSONBodyBase64(jb, p->flow, pa->tx_id);
+                }
+                JsonBuilderClose(jb);
+            } else {
+                JsonBuilderRestoreMark(jb, &mark);
+            }
+            break;
+        }
+        case ALPROTO_TLS: {
+            SSLState *ssl_state = (SSLState *)FlowGetAppState(p->flow);
+            if (ssl_state) {
+                JsonBuilderOpenObject(jb, "tls");
+                EveTlsLogJSONExtended(jb, ssl_state);
+                JsonBuilderClose(jb);
+            }
+            break;
+        }
+        case ALPROTO_SSH:
+            hjs = json_object();
+            if (hjs != NULL) {
+                AlertJsonSsh(p->flow, hjs);
+                EveAlertAddJson(jb, "ssh", json_incref(json_object_get(hjs, "ssh")));
+                json_decref(hjs);
+            }
+            break;
+        case ALPROTO_SMTP:
+            EveAlertAddJson(jb, "smtp", JsonSMTPAddMetadata(p->flow, pa->tx_id));
+            EveAlertAddJson(jb, "email", JsonEmailAddMetadata(p->flow, pa->tx_id));
+            break;
+        case ALPROTO_NFS:
+            EveAlertAddJson(jb, "rpc", JsonNFSAddMetadataRPC(p->flow, pa->tx_id));
+            EveAlertAddJson(jb, "nfs", JsonNFSAddMetadata(p->flow, pa->tx_id));
+            break;
+        case ALPROTO_SMB:
+            EveAlertAddJson(jb, "smb", JsonSMBAddMetadata(p->flow, pa->tx_id));
+            break;
+        case ALPROTO_SIP:
+            EveAlertAddJson(jb, "sip", JsonSIPAddMetadata(p->flow, pa->tx_id));
+            break;
+        case ALPROTO_FTPDATA:
+            EveAlertAddJson(jb, "ftp-data", JsonFTPDataAddMetadata(p->flow));
+            break;
+        case ALPROTO_DNP3:
+            hjs = json_object();
+            if (hjs != NULL) {
+                AlertJsonDnp3(p->flow, pa->tx_id, hjs);
+                EveAlertAddJson(jb, "dnp3", json_incref(json_object_get(hjs, "dnp3")));
+                json_decref(hjs);
+            }
+            break;
+        case ALPROTO_DNS:
+            hjs = json_object();
+            if (hjs != NULL) {
+                AlertJsonDns(p->flow, pa->tx_id, hjs);
+                EveAlertAddJson(jb, "dns", json_incref(json_object_get(hjs, "dns")));
+                json_decref(hjs);
+            }
+            break;
+        default:
+            break;
+    }
 }
 
-static void AlertAddPayload(AlertJsonOutputCtx *json_output_ctx, json_t *js, const Packet *p)
+static void EveAlertPayload(AlertJsonOutputCtx *json_output_ctx, JsonBuilder *jb,
+        const uint8_t *data, uint32_t data_len)
 {
     if (json_output_ctx->flags & LOG_JSON_PAYLOAD_BASE64) {
-        unsigned long len = p->payload_len * 2 + 1;
+        unsigned long len = data_len * 2 + 1;
         uint8_t encoded[len];
-        if (Base64Encode(p->payload, p->payload_len, encoded, &len) == SC_BASE64_OK) {
-            json_object_set_new(js, "payload", json_string((char *)encoded));
+        if (Base64Encode(data, data_len, encoded, &len) == SC_BASE64_OK) {
+            JsonBuilderSetString(jb, "payload", (char *)encoded);
         }
     }
 
     if (json_output_ctx->flags & LOG_JSON_PAYLOAD) {
-        uint8_t printable_buf[p->payload_len + 1];
+        uint8_t printable_buf[data_len + 1];
         uint32_t offset = 0;
         PrintStringsToBuffer(printable_buf, &offset,
-                p->payload_len + 1,
-                p->payload, p->payload_len);
-        printable_buf[p->payload_len] = '\0';
-        json_object_set_new(js, "payload_printable", json_string((char *)printable_buf));
+                sizeof(printable_buf), data, data_len);
+        printable_buf[MIN(offset, data_len)] = '\0';
+        JsonBuilderSetString(jb, "payload_printable", (char *)printable_buf);
     }
 }
 
@@ -394,18 +573,17 @@ static int AlertJson(ThreadVars *tv, JsonAlertLogThread *aft, const Packet *p)
 {
     MemBuffer *payload = aft->payload_buffer;
     AlertJsonOutputCtx *json_output_ctx = aft->json_output_ctx;
-    json_t *hjs = NULL;
 
     int i;
 
     if (p->alerts.cnt == 0 && !(p->flags & PKT_HAS_TAG))
         return TM_ECODE_OK;
 
-    json_t *js = CreateJSONHeader(p, LOG_DIR_PACKET, "alert");
-    if (unlikely(js == NULL))
-        return TM_ECODE_OK;
+    JsonAddrInfo addr = json_addr_info_zero;
+    JsonAddrInfoInit(p, LOG_DIR_PACKET, &addr);
 
-    JsonAddCommonOptions(&json_output_ctx->cfg, p, p->flow, js);
+    HttpXFFCfg *xff_cfg = json_output_ctx->xff_cfg != NULL ?
+        json_output_ctx->xff_cfg : json_output_ctx->parent_xff_cfg;;
 
     for (i = 0; i < p->alerts.cnt; i++) {
         const PacketAlert *pa = &p->alerts.alerts[i];
@@ -413,91 +591,59 @@ static int AlertJson(ThreadVars *tv, JsonAlertLogThread *aft, const Packet *p)
             continue;
         }
 
-        MemBufferReset(aft->json_buffer);
+        /* xff header */
+        int have_xff_ip = 0;
+        char xff_buffer[XFF_MAXLEN];
+        JsonAddrInfo header_addr = addr;
+        if ((xff_cfg != NULL) && !(xff_cfg->flags & XFF_DISABLED) && p->flow != NULL) {
+            if (FlowGetAppProtocol(p->flow) == ALPROTO_HTTP) {
+                if (pa->flags & PACKET_ALERT_FLAG_TX) {
+                    have_xff_ip = HttpXFFGetIPFromTx(p->flow, pa->tx_id, xff_cfg,
+                            xff_buffer, XFF_MAXLEN);
+                } else {
+                    have_xff_ip = HttpXFFGetIP(p->flow, xff_cfg, xff_buffer,
+                            XFF_MAXLEN);
+                }
+            }
+
+            if (have_xff_ip && !(xff_cfg->flags & XFF_EXTRADATA) &&
+                    (xff_cfg->flags & XFF_OVERWRITE))
+            {
+                if (p->flowflags & FLOW_PKT_TOCLIENT) {
+                    strlcpy(header_addr.dst_ip, xff_buffer, sizeof(header_addr.dst_ip));
+                } else {
+                    strlcpy(header_addr.src_ip, xff_buffer, sizeof(header_addr.src_ip));
+                }
+            }
+        }
+
+        JsonBuilder jb;
+        OutputJsonBuilderStart(&jb, aft->file_ctx, &aft->json_buffer);
+
+        EveAddHeader(&jb, p, LOG_DIR_PACKET, "alert", &header_addr);
+
+        EveAddCommonOptions(&json_output_ctx->cfg, p, p->flow, &jb);
 
         /* alert */
-        AlertJsonHeader(json_output_ctx, p, pa, js, json_output_ctx->flags);
+        EveAlertHeader(json_output_ctx, p, pa, &addr, &jb);
 
         if (IS_TUNNEL_PKT(p)) {
-            AlertJsonTunnel(p, js);
+            EveAlertTunnel(p, &jb);
         }
 
         if (json_output_ctx->flags & LOG_JSON_APP_LAYER && p->flow != NULL) {
-            const AppProto proto = FlowGetAppProtocol(p->flow);
-            switch (proto) {
-                case ALPROTO_HTTP:
-                    hjs = JsonHttpAddMetadata(p->flow, pa->tx_id);
-                    if (hjs) {
-                        if (json_output_ctx->flags & LOG_JSON_HTTP_BODY) {
-                            JsonHttpLogJSONBodyPrintable(hjs, p->flow, pa->tx_id);
-                        }
-                        if (json_output_ctx->flags & LOG_JSON_HTTP_BODY_BASE64) {
-                            JsonHttpLogJSONBodyBase64(hjs, p->flow, pa->tx_id);
-                        }
-                        json_object_set_new(js, "http", hjs);
-                    }
-                    break;
-                case ALPROTO_TLS:
-                    AlertJsonTls(p->flow, js);
-                    break;
-                case ALPROTO_SSH:
-                    AlertJsonSsh(p->flow, js);
-                    break;
-                case ALPROTO_SMTP:
-                    hjs = JsonSMTPAddMetadata(p->flow, pa->tx_id);
-                    if (hjs) {
-                        json_object_set_new(js, "smtp", hjs);
-                    }
-
-                    hjs = JsonEmailAddMetadata(p->flow, pa->tx_id);
-                    if (hjs) {
-                        json_object_set_new(js, "email", hjs);
-                    }
-                    break;
-                case ALPROTO_NFS:
-                    hjs = JsonNFSAddMetadataRPC(p->flow, pa->tx_id);
-                    if (hjs)
-                        json_object_set_new(js, "rpc", hjs);
-                    hjs = JsonNFSAddMetadata(p->flow, pa->tx_id);
-                    if (hjs)
-                        json_object_set_new(js, "nfs", hjs);
-                    break;
-                case ALPROTO_SMB:
-                    hjs = JsonSMBAddMetadata(p->flow, pa->tx_id);
-                    if (hjs)
-                        json_object_set_new(js, "smb", hjs);
-                    break;
-                case ALPROTO_SIP:
-                    hjs = JsonSIPAddMetadata(p->flow, pa->tx_id);
-                    if (hjs)
-                        json_object_set_new(js, "sip", hjs);
-                    break;
-                case ALPROTO_FTPDATA:
-                    hjs = JsonFTPDataAddMetadata(p->flow);
-                    if (hjs)
-                        json_object_set_new(js, "ftp-data", hjs);
-                    break;
-                case ALPROTO_DNP3:
-                    AlertJsonDnp3(p->flow, pa->tx_id, js);
-                    break;
-                case ALPROTO_DNS:
-                    AlertJsonDns(p->flow, pa->tx_id, js);
-                    break;
-                default:
-                    break;
-            }
+            EveAlertAppLayer(json_output_ctx, p, pa, &jb);
         }
 
         if (p->flow) {
             if (json_output_ctx->flags & LOG_JSON_FLOW) {
-                hjs = json_object();
-                if (hjs != NULL) {
-                    JsonAddFlow(p->flow, js, hjs);
-                    json_object_set_new(js, "flow", hjs);
-                }
+                EveAddAppProto(p->flow, &jb);
+                JsonBuilderOpenObject(&jb, "flow");
+                EveAddFlow(p->flow, &jb);
+                JsonBuilderClose(&jb);
             } else {
-                json_object_set_new(js, "app_proto",
-                        json_string(AppProtoToString(p->flow->alproto)));
+                JsonBuilderSetString(&jb, "app_proto",
+                        AppProtoToString(p->flow->alproto));
             }
         }
 
@@ -523,91 +669,40 @@ static int AlertJson(ThreadVars *tv, JsonAlertLogThread *aft, const Packet *p)
                                     AlertJsonDumpStreamSegmentCallback,
                                     (void *)payload);
                 if (payload->offset) {
-                    if (json_output_ctx->flags & LOG_JSON_PAYLOAD_BASE64) {
-                        unsigned long len = json_output_ctx->payload_buffer_size * 2;
-                        uint8_t encoded[len];
-                        Base64Encode(payload->buffer, payload->offset, encoded, &len);
-                        json_object_set_new(js, "payload", json_string((char *)encoded));
-                    }
-
-                    if (json_output_ctx->flags & LOG_JSON_PAYLOAD) {
-                        uint8_t printable_buf[payload->offset + 1];
-                        uint32_t offset = 0;
-                        PrintStringsToBuffer(printable_buf, &offset,
-                                sizeof(printable_buf),
-                                payload->buffer, payload->offset);
-                        json_object_set_new(js, "payload_printable",
-                                json_string((char *)printable_buf));
-                    }
+                    EveAlertPayload(json_output_ctx, &jb,
+                            payload->buffer, payload->offset);
                 } else if (p->payload_len) {
                     /* Fallback on packet payload */
-                    AlertAddPayload(json_output_ctx, js, p);
+                    EveAlertPayload(json_output_ctx, &jb,
+                            p->payload, p->payload_len);
                 }
             } else {
                 /* This is a single packet and not a stream */
-                AlertAddPayload(json_output_ctx, js, p);
+                EveAlertPayload(json_output_ctx, &jb, p->payload, p->payload_len);
             }
 
-            json_object_set_new(js, "stream", json_integer(stream));
+            JsonBuilderSetInt(&jb, "stream", stream);
         }
 
         /* base64-encoded full packet */
         if (json_output_ctx->flags & LOG_JSON_PACKET) {
-            JsonPacket(p, js, 0);
-        }
-
-        /* signature text */
-        if (json_output_ctx->flags & LOG_JSON_RULE) {
-            hjs = json_object_get(js, "alert");
-            if (json_is_object(hjs))
-                json_object_set_new(hjs, "rule", json_string(pa->s->sig_str));
+            EveAddPacket(p, &jb, 0);
         }
 
-        HttpXFFCfg *xff_cfg = json_output_ctx->xff_cfg != NULL ?
-            json_output_ctx->xff_cfg : json_output_ctx->parent_xff_cfg;;
-
-        /* xff header */
-        if ((xff_cfg != NULL) && !(xff_cfg->flags & XFF_DISABLED) && p->flow != NULL) {
-            int have_xff_ip = 0;
-            char buffer[XFF_MAXLEN];
-
-            if (FlowGetAppProtocol(p->flow) == ALPROTO_HTTP) {
-                if (pa->flags & PACKET_ALERT_FLAG_TX) {
-                    have_xff_ip = HttpXFFGetIPFromTx(p->flow, pa->tx_id, xff_cfg, buffer, XFF_MAXLEN);
-                } else {
-                    have_xff_ip = HttpXFFGetIP(p->flow, xff_cfg, buffer, XFF_MAXLEN);
-                }
-            }
-
-            if (have_xff_ip) {
-                if (xff_cfg->flags & XFF_EXTRADATA) {
-                    json_object_set_new(js, "xff", json_string(buffer));
-                }
-                else if (xff_cfg->flags & XFF_OVERWRITE) {
-                    if (p->flowflags & FLOW_PKT_TOCLIENT) {
-                        json_object_set(js, "dest_ip", json_string(buffer));
-                    } else {
-                        json_object_set(js, "src_ip", json_string(buffer));
-                    }
-                }
-            }
+        if (have_xff_ip && (xff_cfg->flags & XFF_EXTRADATA)) {
+            JsonBuilderSetString(&jb, "xff", xff_buffer);
         }
 
-        OutputJSONBuffer(js, aft->file_ctx, &aft->json_buffer);
-        json_object_del(js, "alert");
+        OutputJsonBuilderBuffer(&jb, aft->file_ctx, &aft->json_buffer);
     }
-    json_object_clear(js);
-    json_decref(js);
 
     if ((p->flags & PKT_HAS_TAG) && (json_output_ctx->flags &
             LOG_JSON_TAGGED_PACKETS)) {
-        MemBufferReset(aft->json_buffer);
-        json_t *packetjs = CreateJSONHeader(p, LOG_DIR_PACKET, "packet");
-        if (unlikely(packetjs != NULL)) {
-            JsonPacket(p, packetjs, 0);
-            OutputJSONBuffer(packetjs, aft->file_ctx, &aft->json_buffer);
-            json_decref(packetjs);
-        }
+        JsonBuilder jb;
+        OutputJsonBuilderStart(&jb, aft->file_ctx, &aft->json_buffer);
+        EveAddHeader(&jb, p, LOG_DIR_PACKET, "packet", &addr);
+        EveAddPacket(p, &jb, 0);
+        OutputJsonBuilderBuffer(&jb, aft->file_ctx, &aft->json_buffer);
     }
 
     return TM_ECODE_OK;
@@ -617,7 +712,6 @@ static int AlertJsonDecoderEvent(ThreadVars *tv, JsonAlertLogThread *aft, const
 {
     int i;
     char timebuf[64];
-    json_t *js;
 
     if (p->alerts.cnt == 0)
         return TM_ECODE_OK;
@@ -625,8 +719,6 @@ static int AlertJsonDecoderEvent(ThreadVars *tv, JsonAlertLogThread *aft, const
     CreateIsoTimeString(&p->ts, timebuf, sizeof(timebuf));
 
     for (i = 0; i < p->alerts.cnt; i++) {
-        MemBufferReset(aft->json_buffer);
-
         const PacketAlert *pa = &p->alerts.alerts[i];
         if (unlikely(pa->s == NULL)) {
             continue;
@@ -639,44 +731,27 @@ static int AlertJsonDecoderEvent(ThreadVars *tv, JsonAlertLogThread *aft, const
             action = "blocked";
         }
 
-        js = json_object();
-        if (js == NULL)
-            return TM_ECODE_OK;
-
-        json_t *ajs = json_object();
-        if (ajs == NULL) {
-            json_decref(js);
-            return TM_ECODE_OK;
-        }
+        JsonBuilder jb;
+        OutputJsonBuilderStart(&jb, aft->file_ctx, &aft->json_buffer);
 
         /* time & tx */
-        json_object_set_new(js, "timestamp", json_string(timebuf));
-
-        /* tuple */
-        //json_object_set_new(js, "srcip", json_string(srcip));
-        //json_object_set_new(js, "sp", json_integer(p->sp));
-        //json_object_set_new(js, "dstip", json_string(dstip));
-        //json_object_set_new(js, "dp", json_integer(p->dp));
-        //json_object_set_new(js, "proto", json_integer(proto));
-
-        json_object_set_new(ajs, "action", json_string(action));
-        json_object_set_new(ajs, "gid", json_integer(pa->s->gid));
-        json_object_set_new(ajs, "signature_id", json_integer(pa->s->id));
-        json_object_set_new(ajs, "rev", json_integer(pa->s->rev));
-        json_object_set_new(ajs, "signature",
-                            json_string((pa->s->msg) ? pa->s->msg : ""));
-        json_object_set_new(ajs, "category",
-                            json_string((pa->s->class_msg) ? pa->s->class_msg : ""));
-        json_object_set_new(ajs, "severity", json_integer(pa->s->prio));
+        JsonBuilderSetString(&jb, "timestamp", timebuf);
+
+        JsonBuilderOpenObject(&jb, "alert");
+        JsonBuilderSetString(&jb, "action", action);
+        JsonBuilderSetUint(&jb, "gid", pa->s->gid);
+        JsonBuilderSetUint(&jb, "signature_id", pa->s->id);
+        JsonBuilderSetUint(&jb, "rev", pa->s->rev);
+        JsonBuilderSetString(&jb, "signature", (pa->s->msg) ? pa->s->msg : "");
+        JsonBuilderSetString(&jb, "category",
+                (pa->s->class_msg) ? pa->s->class_msg : "");
+        JsonBuilderSetInt(&jb, "severity", pa->s->prio);
 
         if (p->tenant_id > 0)
-            json_object_set_new(ajs, "tenant_id", json_integer(p->tenant_id));
+            JsonBuilderSetUint(&jb, "tenant_id", p->tenant_id);
+        JsonBuilderClose(&jb);
 
-        /* alert */
-        json_object_set_new(js, "alert", ajs);
-        OutputJSONBuffer(js, aft->file_ctx, &aft->json_buffer);
-        json_object_clear(js);
-        json_decref(js);
+        OutputJsonBuilderBuffer(&jb, aft->file_ctx, &aft->json_buffer);
     }
 
     return TM_ECODE_OK;
@@ -295,6 +295,19 @@ json_t *JsonDNSLogAnswer(void *txptr, uint64_t tx_id)
     return rs_dns_log_json_answer(txptr, LOG_ALL_RRTYPES);
 }
 
+/** \brief write a dns record, the "dns" object itself is built by the
+ *         rust logger */
+static void JsonDnsLogRecord(LogDnsLogThread *td, const Packet *p, Flow *f,
+        const json_t *dns)
+{
+    JsonBuilder jb;
+    OutputJsonBuilderStart(&jb, td->dnslog_ctx->file_ctx, &td->buffer);
+    EveAddHeader(&jb, p, LOG_DIR_FLOW, "dns", NULL);
+    EveAddCommonOptions(&td->dnslog_ctx->cfg, p, f, &jb);
+    JsonBuilderSetJson(&jb, "dns", dns);
+    OutputJsonBuilderBuffer(&jb, td->dnslog_ctx->file_ctx, &td->buffer);
+}
+
 static int JsonDnsLoggerToServer(ThreadVars *tv, void *thread_data,
     const Packet *p, Flow *f, void *alstate, void *txptr, uint64_t tx_id)
 {
@@ -302,28 +315,18 @@ static int JsonDnsLoggerToServer(ThreadVars *tv, void *thread_data,
 
     LogDnsLogThread *td = (LogDnsLogThread *)thread_data;
     LogDnsFileCtx *dnslog_ctx = td->dnslog_ctx;
-    json_t *js;
 
     if (unlikely(dnslog_ctx->flags & LOG_QUERIES) == 0) {
         return TM_ECODE_OK;
     }
 
     for (uint16_t i = 0; i < 0xffff; i++) {
-        js = CreateJSONHeader(p, LOG_DIR_FLOW, "dns");
-        if (unlikely(js == NULL)) {
-            return TM_ECODE_OK;
-        }
-        JsonAddCommonOptions(&dnslog_ctx->cfg, p, f, js);
-
         json_t *dns = rs_dns_log_json_query(txptr, i, td->dnslog_ctx->flags);
         if (unlikely(dns == NULL)) {
-            json_decref(js);
             break;
         }
-        json_object_set_new(js, "dns", dns);
-        MemBufferReset(td->buffer);
-        OutputJSONBuffer(js, td->dnslog_ctx->file_ctx, &td->buffer);
-        json_decref(js);
+        JsonDnsLogRecord(td, p, f, dns);
+        json_decref(dns);
     }
 
     SCReturnInt(TM_ECODE_OK);
@@ -341,19 +344,12 @@ static int JsonDnsLoggerToClient(ThreadVars *tv, void *thread_data,
         return TM_ECODE_OK;
     }
 
-    json_t *js = CreateJSONHeader(p, LOG_DIR_FLOW, "dns");
-    if (unlikely(js == NULL))
-        return TM_ECODE_OK;
-
-    JsonAddCommonOptions(&dnslog_ctx->cfg, p, f, js);
-
     if (td->dnslog_ctx->version == DNS_VERSION_2) {
         json_t *answer = rs_dns_log_json_answer(txptr,
                 td->dnslog_ctx->flags);
         if (answer != NULL) {
-            json_object_set_new(js, "dns", answer);
-            MemBufferReset(td->buffer);
-            OutputJSONBuffer(js, td->dnslog_ctx->file_ctx, &td->buffer);
+            JsonDnsLogRecord(td, p, f, answer);
+            json_decref(answer);
         }
     } else {
         /* Log answers. */
@@ -363,10 +359,8 @@ static int JsonDnsLoggerToClient(ThreadVars *tv, void *thread_data,
             if (answer == NULL) {
                 break;
             }
-            json_object_set_new(js, "dns", answer);
-            MemBufferReset(td->buffer);
-            OutputJSONBuffer(js, td->dnslog_ctx->file_ctx, &td->buffer);
-            json_object_del(js, "dns");
+            JsonDnsLogRecord(td, p, f, answer);
+            json_decref(answer);
         }
         /* Log authorities. */
         for (uint16_t i = 0; i < UINT16_MAX; i++) {
@@ -375,15 +369,11 @@ static int JsonDnsLoggerToClient(ThreadVars *tv, void *thread_data,
             if (answer == NULL) {
                 break;
             }
-            json_object_set_new(js, "dns", answer);
-            MemBufferReset(td->buffer);
-            OutputJSONBuffer(js, td->dnslog_ctx->file_ctx, &td->buffer);
-            json_object_del(js, "dns");
+            JsonDnsLogRecord(td, p, f, answer);
+            json_decref(answer);
         }
     }
 
-    json_decref(js);
-
     SCReturnInt(TM_ECODE_OK);
 }
 
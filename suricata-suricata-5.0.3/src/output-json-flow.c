@@ -48,6 +48,7 @@
 #include "output-json-flow.h"
 
 #include "stream-tcp-private.h"
+#include "stream-tcp.h"
 #include "flow-storage.h"
 
 typedef struct LogJsonFileCtx_ {
@@ -62,16 +63,13 @@ typedef struct JsonFlowLogThread_ {
     MemBuffer *buffer;
 } JsonFlowLogThread;
 
-static json_t *CreateJSONHeaderFromFlow(const Flow *f, const char *event_type)
+static void EveAddHeaderFromFlow(JsonBuilder *jb, const Flow *f,
+        const char *event_type)
 {
     char timebuf[64];
     char srcip[46] = {0}, dstip[46] = {0};
     Port sp, dp;
 
-    json_t *js = json_object();
-    if (unlikely(js == NULL))
-        return NULL;
-
     struct timeval tv;
     memset(&tv, 0x00, sizeof(tv));
     TimeGet(&tv);
@@ -108,155 +106,140 @@ static json_t *CreateJSONHeaderFromFlow(const Flow *f, const char *event_type)
     }
 
     /* time */
-    json_object_set_new(js, "timestamp", json_string(timebuf));
+    JsonBuilderSetString(jb, "timestamp", timebuf);
 
-    CreateJSONFlowId(js, (const Flow *)f);
+    EveAddFlowId(jb, (const Flow *)f);
 
 #if 0 // TODO
     /* sensor id */
     if (sensor_id >= 0)
-        json_object_set_new(js, "sensor_id", json_integer(sensor_id));
+        JsonBuilderSetInt(jb, "sensor_id", sensor_id);
 #endif
 
     /* input interface */
     if (f->livedev) {
-        json_object_set_new(js, "in_iface", json_string(f->livedev->dev));
+        JsonBuilderSetString(jb, "in_iface", f->livedev->dev);
     }
 
     if (event_type) {
-        json_object_set_new(js, "event_type", json_string(event_type));
+        JsonBuilderSetString(jb, "event_type", event_type);
     }
 
     /* vlan */
     if (f->vlan_idx > 0) {
-        json_t *js_vlan = json_array();
-        json_array_append_new(js_vlan, json_integer(f->vlan_id[0]));
+        JsonBuilderOpenArray(jb, "vlan");
+        JsonBuilderSetUint(jb, NULL, f->vlan_id[0]);
         if (f->vlan_idx > 1) {
-            json_array_append_new(js_vlan, json_integer(f->vlan_id[1]));
+            JsonBuilderSetUint(jb, NULL, f->vlan_id[1]);
         }
-        json_object_set_new(js, "vlan", js_vlan);
+        JsonBuilderClose(jb);
     }
 
     /* tuple */
-    json_object_set_new(js, "src_ip", json_string(srcip));
+    JsonBuilderSetString(jb, "src_ip", srcip);
     switch(f->proto) {
         case IPPROTO_ICMP:
             break;
         case IPPROTO_UDP:
         case IPPROTO_TCP:
         case IPPROTO_SCTP:
-            json_object_set_new(js, "src_port", json_integer(sp));
+            JsonBuilderSetUint(jb, "src_port", sp);
             break;
     }
-    json_object_set_new(js, "dest_ip", json_string(dstip));
+    JsonBuilderSetString(jb, "dest_ip", dstip);
     switch(f->proto) {
         case IPPROTO_ICMP:
             break;
         case IPPROTO_UDP:
         case IPPROTO_TCP:
         case IPPROTO_SCTP:
-            json_object_set_new(js, "dest_port", json_integer(dp));
+            JsonBuilderSetUint(jb, "dest_port", dp);
             break;
     }
-    json_object_set_new(js, "proto", json_string(proto));
+    JsonBuilderSetString(jb, "proto", proto);
     switch (f->proto) {
         case IPPROTO_ICMP:
         case IPPROTO_ICMPV6:
-            json_object_set_new(js, "icmp_type",
-                    json_integer(f->icmp_s.type));
-            json_object_set_new(js, "icmp_code",
-                    json_integer(f->icmp_s.code));
+            JsonBuilderSetUint(jb, "icmp_type", f->icmp_s.type);
+            JsonBuilderSetUint(jb, "icmp_code", f->icmp_s.code);
             if (f->tosrcpktcnt) {
-                json_object_set_new(js, "response_icmp_type",
-                        json_integer(f->icmp_d.type));
-                json_object_set_new(js, "response_icmp_code",
-                        json_integer(f->icmp_d.code));
+                JsonBuilderSetUint(jb, "response_icmp_type", f->icmp_d.type);
+                JsonBuilderSetUint(jb, "response_icmp_code", f->icmp_d.code);
             }
             break;
     }
-    return js;
 }
 
-void JsonAddFlow(Flow *f, json_t *js, json_t *hjs)
+/**
+ * \brief Add the app layer protocols of a flow to the eve record
+ */
+void EveAddAppProto(Flow *f, JsonBuilder *jb)
 {
-    json_object_set_new(js, "app_proto",
-            json_string(AppProtoToString(f->alproto)));
+    JsonBuilderSetString(jb, "app_proto", AppProtoToString(f->alproto));
     if (f->alproto_ts != f->alproto) {
-        json_object_set_new(js, "app_proto_ts",
-                json_string(AppProtoToString(f->alproto_ts)));
+        JsonBuilderSetString(jb, "app_proto_ts", AppProtoToString(f->alproto_ts));
     }
     if (f->alproto_tc != f->alproto) {
-        json_object_set_new(js, "app_proto_tc",
-                json_string(AppProtoToString(f->alproto_tc)));
+        JsonBuilderSetString(jb, "app_proto_tc", AppProtoToString(f->alproto_tc));
     }
     if (f->alproto_orig != f->alproto && f->alproto_orig != ALPROTO_UNKNOWN) {
-        json_object_set_new(js, "app_proto_orig",
-                json_string(AppProtoToString(f->alproto_orig)));
+        JsonBuilderSetString(jb, "app_proto_orig", AppProtoToString(f->alproto_orig));
     }
     if (f->alproto_expect != f->alproto && f->alproto_expect != ALPROTO_UNKNOWN) {
-        json_object_set_new(js, "app_proto_expected",
-                json_string(AppProtoToString(f->alproto_expect)));
+        JsonBuilderSetString(jb, "app_proto_expected",
+                AppProtoToString(f->alproto_expect));
     }
+}
 
+/**
+ * \brief Add the counters and start time of a flow to the open "flow"
+ *        object of the eve record
+ */
+void EveAddFlow(Flow *f, JsonBuilder *jb)
+{
     FlowBypassInfo *fc = FlowGetStorageById(f, GetFlowBypassInfoID());
     if (fc) {
-        json_object_set_new(hjs, "pkts_toserver",
-                json_integer(f->todstpktcnt + fc->todstpktcnt));
-        json_object_set_new(hjs, "pkts_toclient",
-                json_integer(f->tosrcpktcnt + fc->tosrcpktcnt));
-        json_object_set_new(hjs, "bytes_toserver",
-                json_integer(f->todstbytecnt + fc->todstbytecnt));
-        json_object_set_new(hjs, "bytes_toclient",
-                json_integer(f->tosrcbytecnt + fc->tosrcbytecnt));
-        json_t *bhjs = json_object();
-        if (bhjs != NULL) {
-            json_object_set_new(bhjs, "pkts_toserver",
-                    json_integer(fc->todstpktcnt));
-            json_object_set_new(bhjs, "pkts_toclient",
-                    json_integer(fc->tosrcpktcnt));
-            json_object_set_new(bhjs, "bytes_toserver",
-                    json_integer(fc->todstbytecnt));
-            json_object_set_new(bhjs, "bytes_toclient",
-                    json_integer(fc->tosrcbytecnt));
-            json_object_set_new(hjs, "bypassed", bhjs);
-        }
+        JsonBuilderSetUint(jb, "pkts_toserver", f->todstpktcnt + fc->todstpktcnt);
+        JsonBuilderSetUint(jb, "pkts_toclient", f->tosrcpktcnt + fc->tosrcpktcnt);
+        JsonBuilderSetUint(jb, "bytes_toserver", f->todstbytecnt + fc->todstbytecnt);
+        JsonBuilderSetUint(jb, "bytes_toclient", f->tosrcbytecnt + fc->tosrcbytecnt);
+        JsonBuilderOpenObject(jb, "bypassed");
+        JsonBuilderSetUint(jb, "pkts_toserver", fc->todstpktcnt);
+        JsonBuilderSetUint(jb, "pkts_toclient", fc->tosrcpktcnt);
+        JsonBuilderSetUint(jb, "bytes_toserver", fc->todstbytecnt);
+        JsonBuilderSetUint(jb, "bytes_toclient", fc->tosrcbytecnt);
+        JsonBuilderClose(jb);
     } else {
-        json_object_set_new(hjs, "pkts_toserver",
-                json_integer(f->todstpktcnt));
-        json_object_set_new(hjs, "pkts_toclient",
-                json_integer(f->tosrcpktcnt));
-        json_object_set_new(hjs, "bytes_toserver",
-                json_integer(f->todstbytecnt));
-        json_object_set_new(hjs, "bytes_toclient",
-                json_integer(f->tosrcbytecnt));
+        JsonBuilderSetUint(jb, "pkts_toserver", f->todstpktcnt);
+        JsonBuilderSetUint(jb, "pkts_toclient", f->tosrcpktcnt);
+        JsonBuilderSetUint(jb, "bytes_toserver", f->todstbytecnt);
+        JsonBuilderSetUint(jb, "bytes_toclient", f->tosrcbytecnt);
     }
 
     char timebuf1[64];
     CreateIsoTimeString(&f->startts, timebuf1, sizeof(timebuf1));
-    json_object_set_new(hjs, "start", json_string(timebuf1));
+    JsonBuilderSetString(jb, "start", timebuf1);
 }
 
 /* JSON format logging */
-static void JsonFlowLogJSON(JsonFlowLogThread *aft, json_t *js, Flow *f)
+static void JsonFlowLogJSON(JsonFlowLogThread *aft, JsonBuilder *jb, Flow *f)
 {
     LogJsonFileCtx *flow_ctx = aft->flowlog_ctx;
-    json_t *hjs = json_object();
-    if (hjs == NULL) {
-        return;
-    }
 
-    JsonAddFlow(f, js, hjs);
+    EveAddAppProto(f, jb);
+
+    JsonBuilderOpenObject(jb, "flow");
+    EveAddFlow(f, jb);
 
     char timebuf2[64];
     CreateIsoTimeString(&f->lastts, timebuf2, sizeof(timebuf2));
-    json_object_set_new(hjs, "end", json_string(timebuf2));
+    JsonBuilderSetString(jb, "end", timebuf2);
 
     int32_t age = f->lastts.tv_sec - f->startts.tv_sec;
-    json_object_set_new(hjs, "age",
-            json_integer(age));
+    JsonBuilderSetInt(jb, "age", age);
 
     if (f->flow_end_flags & FLOW_END_FLAG_EMERGENCY)
-        json_object_set_new(hjs, "emergency", json_true());
+        JsonBuilderSetBool(jb, "emergency", true);
     const char *state = NULL;
     if (f->flow_end_flags & FLOW_END_FLAG_STATE_NEW)
         state = "new";
@@ -269,13 +252,11 @@ static void JsonFlowLogJSON(JsonFlowLogThread *aft, json_t *js, Flow *f)
         int flow_state = SC_ATOMIC_GET(f->flow_state);
         switch (flow_state) {
             case FLOW_STATE_LOCAL_BYPASSED:
-                json_object_set_new(hjs, "bypass",
-                        json_string("local"));
+                JsonBuilderSetString(jb, "bypass", "local");
                 break;
 #ifdef CAPTURE_OFFLOAD
             case FLOW_STATE_CAPTURE_BYPASSED:
-                json_object_set_new(hjs, "bypass",
-                        json_string("capture"));
+                JsonBuilderSetString(jb, "bypass", "capture");
                 break;
 #endif
             default:
@@ -285,8 +266,7 @@ static void JsonFlowLogJSON(JsonFlowLogThread *aft, json_t *js, Flow *f)
         }
     }
 
-    json_object_set_new(hjs, "state",
-            json_string(state));
+    JsonBuilderSetString(jb, "state", state);
 
     const char *reason = NULL;
     if (f->flow_end_flags & FLOW_END_FLAG_TIMEOUT)
@@ -296,89 +276,47 @@ static void JsonFlowLogJSON(JsonFlowLogThread *aft, json_t *js, Flow *f)
     else if (f->flow_end_flags & FLOW_END_FLAG_SHUTDOWN)
         reason = "shutdown";
 
-    json_object_set_new(hjs, "reason",
-            json_string(reason));
+    JsonBuilderSetString(jb, "reason", reason);
 
-    json_object_set_new(hjs, "alerted", json_boolean(FlowHasAlerts(f)));
+    JsonBuilderSetBool(jb, "alerted", FlowHasAlerts(f));
     if (f->flags & FLOW_WRONG_THREAD)
-        json_object_set_new(hjs, "wrong_thread", json_true());
+        JsonBuilderSetBool(jb, "wrong_thread", true);
 
-    json_object_set_new(js, "flow", hjs);
+    JsonBuilderClose(jb);
 
-    JsonAddCommonOptions(&flow_ctx->cfg, NULL, f, js);
+    EveAddCommonOptions(&flow_ctx->cfg, NULL, f, jb);
 
     /* TCP */
     if (f->proto == IPPROTO_TCP) {
-        json_t *tjs = json_object();
-        if (tjs == NULL) {
-            return;
-        }
+        JsonBuilderOpenObject(jb, "tcp");
 
         TcpSession *ssn = f->protoctx;
 
         char hexflags[3];
         snprintf(hexflags, sizeof(hexflags), "%02x",
                 ssn ? ssn->tcp_packet_flags : 0);
-        json_object_set_new(tjs, "tcp_flags", json_string(hexflags));
+        JsonBuilderSetString(jb, "tcp_flags", hexflags);
 
         snprintf(hexflags, sizeof(hexflags), "%02x",
                 ssn ? ssn->client.tcp_flags : 0);
-        json_object_set_new(tjs, "tcp_flags_ts", json_string(hexflags));
+        JsonBuilderSetString(jb, "tcp_flags_ts", hexflags);
 
         snprintf(hexflags, sizeof(hexflags), "%02x",
                 ssn ? ssn->server.tcp_flags : 0);
-        json_object_set_new(tjs, "tcp_flags_tc", json_string(hexflags));
+        JsonBuilderSetString(jb, "tcp_flags_tc", hexflags);
 
-        JsonTcpFlags(ssn ? ssn->tcp_packet_flags : 0, tjs);
+        EveTcpFlags(ssn ? ssn->tcp_packet_flags : 0, jb);
 
         if (ssn) {
-            const char *tcp_state = NULL;
-            switch (ssn->state) {
-                case TCP_NONE:
-                    tcp_state = "none";
-                    break;
-                case TCP_LISTEN:
-                    tcp_state = "listen";
-                    break;
-                case TCP_SYN_SENT:
-                    tcp_state = "syn_sent";
-                    break;
-                case TCP_SYN_RECV:
-                    tcp_state = "syn_recv";
-                    break;
-                case TCP_ESTABLISHED:
-                    tcp_state = "established";
-                    break;
-                case TCP_FIN_WAIT1:
-                    tcp_state = "fin_wait1";
-                    break;
-                case TCP_FIN_WAIT2:
-                    tcp_state = "fin_wait2";
-                    break;
-                case TCP_TIME_WAIT:
-                    tcp_state = "time_wait";
-                    break;
-                case TCP_LAST_ACK:
-                    tcp_state = "last_ack";
-                    break;
-                case TCP_CLOSE_WAIT:
-                    tcp_state = "close_wait";
-                    break;
-                case TCP_CLOSING:
-                    tcp_state = "closing";
-                    break;
-                case TCP_CLOSED:
-                    tcp_state = "closed";
-                    break;
-            }
-            json_object_set_new(tjs, "state", json_string(tcp_state));
+            const char *tcp_state = StreamTcpStateAsString(ssn->state);
+            JsonBuilderSetString(jb, "state", tcp_state);
             if (ssn->client.flags & STREAMTCP_STREAM_FLAG_GAP)
-                json_object_set_new(tjs, "gap_ts", json_true());
+                JsonBuilderSetBool(jb, "gap_ts", true);
             if (ssn->server.flags & STREAMTCP_STREAM_FLAG_GAP)
-                json_object_set_new(tjs, "gap_tc", json_true());
+                JsonBuilderSetBool(jb, "gap_tc", true);
         }
 
-        json_object_set_new(js, "tcp", tjs);
+        JsonBuilderClose(jb);
     }
 }
 
@@ -386,21 +324,16 @@ static int JsonFlowLogger(ThreadVars *tv, void *thread_data, Flow *f)
 {
     SCEnter();
     JsonFlowLogThread *jhl = (JsonFlowLogThread *)thread_data;
+    LogFileCtx *file_ctx = jhl->flowlog_ctx->file_ctx;
 
-    /* reset */
-    MemBufferReset(jhl->buffer);
-
-    json_t *js = CreateJSONHeaderFromFlow(f, "flow");
-    if (unlikely(js == NULL))
-        return TM_ECODE_OK;
+    JsonBuilder jb;
+    OutputJsonBuilderStart(&jb, file_ctx, &jhl->buffer);
 
-    JsonFlowLogJSON(jhl, js, f);
+    EveAddHeaderFromFlow(&jb, f, "flow");
 
-    OutputJSONBuffer(js, jhl->flowlog_ctx->file_ctx, &jhl->buffer);
-    json_object_del(js, "http");
+    JsonFlowLogJSON(jhl, &jb, f);
 
-    json_object_clear(js);
-    json_decref(js);
+    OutputJsonBuilderBuffer(&jb, file_ctx, &jhl->buffer);
 
     SCReturnInt(TM_ECODE_OK);
 }
@@ -530,11 +463,11 @@ void JsonFlowLogRegister (void)
 {
     /* register as separate module */
     OutputRegisterFlowModule(LOGGER_JSON_FLOW, "JsonFlowLog", "flow-json-log",
-        OutputFlowLogInit, JsonFlowLogger, JsonFlowLogThreadInit,
+        OutputFlowLogInit, JsonFlowLogger, NULL, JsonFlowLogThreadInit,
         JsonFlowLogThreadDeinit, NULL);
 
     /* also register as child of eve-log */
     OutputRegisterFlowSubModule(LOGGER_JSON_FLOW, "eve-log", "JsonFlowLog",
-        "eve-log.flow", OutputFlowLogInitSub, JsonFlowLogger,
+        "eve-log.flow", OutputFlowLogInitSub, JsonFlowLogger, NULL,
         JsonFlowLogThreadInit, JsonFlowLogThreadDeinit, NULL);
 }
@@ -24,7 +24,10 @@
 #ifndef __OUTPUT_JSON_FLOW_H__
 #define __OUTPUT_JSON_FLOW_H__
 
+#include "util-json-builder.h"
+
 void JsonFlowLogRegister(void);
-void JsonAddFlow(Flow *f, json_t *js, json_t *hjs);
+void EveAddAppProto(Flow *f, JsonBuilder *jb);
+void EveAddFlow(Flow *f, JsonBuilder *jb);
 
 #endif /* __OUTPUT_JSON_FLOW_H__ */
@@ -40,6 +40,7 @@
 
 #include "output.h"
 #include "app-layer-htp.h"
+#include "app-layer-htp-body.h"
 #include "app-layer-htp-file.h"
 #include "app-layer-htp-xff.h"
 #include "app-layer.h"
@@ -199,14 +200,39 @@ struct {
     { "x_bluecoat_via", "x-bluecoat-via", LOG_HTTP_REQUEST },
 };
 
-static void JsonHttpLogJSONBasic(json_t *js, htp_tx_t *tx)
+/** \brief add a bstr as a printable string */
+static void EveHttpBstr(JsonBuilder *jb, const char *key, bstr *b)
+{
+    const size_t size = bstr_len(b) * 2 + 1;
+    char string[size];
+    BytesToStringBuffer(bstr_ptr(b), bstr_len(b), string, size);
+    JsonBuilderSetString(jb, key, string);
+}
+
+/** \brief add a header value like bstr_util_strdup_to_c() formats it */
+static void EveHttpHeaderValue(JsonBuilder *jb, const char *key, bstr *b)
+{
+    if (memchr(bstr_ptr(b), '\0', bstr_len(b)) == NULL) {
+        JsonBuilderSetStringN(jb, key, (const char *)bstr_ptr(b), bstr_len(b));
+    } else {
+        char *c = bstr_util_strdup_to_c(b);
+        if (c != NULL) {
+            JsonBuilderSetString(jb, key, c);
+            SCFree(c);
+        }
+    }
+}
+
+/**
+ * \param content_range_raw log the content range as the custom field
+ *        would, so the record has the key only once
+ */
+static void JsonHttpLogJSONBasic(JsonBuilder *jb, htp_tx_t *tx,
+        bool content_range_raw)
 {
     /* hostname */
     if (tx->request_hostname != NULL) {
-        const size_t size = bstr_len(tx->request_hostname) * 2 + 1;
-        char string[size];
-        BytesToStringBuffer(bstr_ptr(tx->request_hostname), bstr_len(tx->request_hostname), string, size);
-        json_object_set_new(js, "hostname", SCJsonString(string));
+        EveHttpBstr(jb, "hostname", tx->request_hostname);
     }
 
     /* port */
@@ -216,35 +242,25 @@ static void JsonHttpLogJSONBasic(json_t *js, htp_tx_t *tx)
      * port and the TCP destination port of the flow.
      */
     if (tx->request_port_number >= 0) {
-        json_object_set_new(js, "http_port",
-                json_integer(tx->request_port_number));
+        JsonBuilderSetInt(jb, "http_port", tx->request_port_number);
     }
 
     /* uri */
     if (tx->request_uri != NULL) {
-        const size_t size = bstr_len(tx->request_uri) * 2 + 1;
-        char string[size];
-        BytesToStringBuffer(bstr_ptr(tx->request_uri), bstr_len(tx->request_uri), string, size);
-        json_object_set_new(js, "url", SCJsonString(string));
+        EveHttpBstr(jb, "url", tx->request_uri);
     }
 
     if (tx->request_headers != NULL) {
         /* user agent */
         htp_header_t *h_user_agent = htp_table_get_c(tx->request_headers, "user-agent");
         if (h_user_agent != NULL) {
-            const size_t size = bstr_len(h_user_agent->value) * 2 + 1;
-            char string[size];
-            BytesToStringBuffer(bstr_ptr(h_user_agent->value), bstr_len(h_user_agent->value), string, size);
-            json_object_set_new(js, "http_user_agent", SCJsonString(string));
+            EveHttpBstr(jb, "http_user_agent", h_user_agent->value);
         }
 
         /* x-forwarded-for */
         htp_header_t *h_x_forwarded_for = htp_table_get_c(tx->request_headers, "x-forwarded-for");
         if (h_x_forwarded_for != NULL) {
-            const size_t size = bstr_len(h_x_forwarded_for->value) * 2 + 1;
-            char string[size];
-            BytesToStringBuffer(bstr_ptr(h_x_forwarded_for->value), bstr_len(h_x_forwarded_for->value), string, size);
-            json_object_set_new(js, "xff", json_string(string));
+            EveHttpBstr(jb, "xff", h_x_forwarded_for->value);
         }
     }
 
@@ -258,74 +274,73 @@ static void JsonHttpLogJSONBasic(json_t *js, htp_tx_t *tx)
             char *p = strchr(string, ';');
             if (p != NULL)
                 *p = '\0';
-            json_object_set_new(js, "http_content_type", SCJsonString(string));
+            JsonBuilderSetString(jb, "http_content_type", string);
         }
         htp_header_t *h_content_range = htp_table_get_c(tx->response_headers, "content-range");
-        if (h_content_range != NULL) {
-            const size_t size = bstr_len(h_content_range->value) * 2 + 1;
-            char string[size];
-            BytesToStringBuffer(bstr_ptr(h_content_range->value), bstr_len(h_content_range->value), string, size);
-            json_t *crjs = json_object();
-            if (crjs != NULL) {
-                json_object_set_new(crjs, "raw", SCJsonString(string));
-                HtpContentRange crparsed;
-                if (HTPParseContentRange(h_content_range->value, &crparsed) == 0) {
-                    if (crparsed.start >= 0)
-                        json_object_set_new(crjs, "start", json_integer(crparsed.start));
-                    if (crparsed.end >= 0)
-                        json_object_set_new(crjs, "end", json_integer(crparsed.end));
-                    if (crparsed.size >= 0)
-                        json_object_set_new(crjs, "size", json_integer(crparsed.size));
-                }
-                json_object_set_new(js, "content_range", crjs);
+        if (h_content_range != NULL && content_range_raw) {
+            EveHttpHeaderValue(jb, "content_range", h_content_range->value);
+        } else if (h_content_range != NULL) {
+            JsonBuilderOpenObject(jb, "content_range");
+            EveHttpBstr(jb, "raw", h_content_range->value);
+            HtpContentRange crparsed;
+            if (HTPParseContentRange(h_content_range->value, &crparsed) == 0) {
+                if (crparsed.start >= 0)
+                    JsonBuilderSetInt(jb, "start", crparsed.start);
+                if (crparsed.end >= 0)
+                    JsonBuilderSetInt(jb, "end", crparsed.end);
+                if (crparsed.size >= 0)
+                    JsonBuilderSetInt(jb, "size", crparsed.size);
             }
+            JsonBuilderClose(jb);
         }
     }
 }
 
-static void JsonHttpLogJSONCustom(LogHttpFileCtx *http_ctx, json_t *js, htp_tx_t *tx)
+static bool JsonHttpLogCustomField(const LogHttpFileCtx *http_ctx, HttpField f)
+{
+    if ((http_ctx->fields & (1ULL<<f)) == 0)
+        return false;
+    /* prevent logging a field twice if extended logging is
+        enabled */
+    return (((http_ctx->flags & LOG_HTTP_EXTENDED) == 0) ||
+            ((http_ctx->flags & LOG_HTTP_EXTENDED) !=
+                  (http_fields[f].flags & LOG_HTTP_EXTENDED)));
+}
+
+static void JsonHttpLogJSONCustom(LogHttpFileCtx *http_ctx, JsonBuilder *jb, htp_tx_t *tx)
 {
-    char *c;
     HttpField f;
 
     for (f = HTTP_FIELD_ACCEPT; f < HTTP_FIELD_SIZE; f++)
     {
-        if ((http_ctx->fields & (1ULL<<f)) != 0)
+        /* logged by JsonHttpLogJSONBasic() */
+        if (f == HTTP_FIELD_CONTENT_RANGE)
+            continue;
+
+        if (JsonHttpLogCustomField(http_ctx, f))
         {
-            /* prevent logging a field twice if extended logging is
-                enabled */
-            if (((http_ctx->flags & LOG_HTTP_EXTENDED) == 0) ||
-                ((http_ctx->flags & LOG_HTTP_EXTENDED) !=
-                      (http_fields[f].flags & LOG_HTTP_EXTENDED)))
+            htp_header_t *h_field = NULL;
+            if ((http_fields[f].flags & LOG_HTTP_REQUEST) != 0)
             {
-                htp_header_t *h_field = NULL;
-                if ((http_fields[f].flags & LOG_HTTP_REQUEST) != 0)
-                {
-                    if (tx->request_headers != NULL) {
-                        h_field = htp_table_get_c(tx->request_headers,
-                                                  http_fields[f].htp_field);
-                    }
-                } else {
-                    if (tx->response_headers != NULL) {
-                        h_field = htp_table_get_c(tx->response_headers,
-                                                  http_fields[f].htp_field);
-                    }
+                if (tx->request_headers != NULL) {
+                    h_field = htp_table_get_c(tx->request_headers,
+                                              http_fields[f].htp_field);
                 }
-                if (h_field != NULL) {
-                    c = bstr_util_strdup_to_c(h_field->value);
-                    if (c != NULL) {
-                        json_object_set_new(js,
-                                http_fields[f].config_field,
-                                SCJsonString(c));
-                        SCFree(c);
-                    }
+            } else {
+                if (tx->response_headers != NULL) {
+                    h_field = htp_table_get_c(tx->response_headers,
+                                              http_fields[f].htp_field);
                 }
             }
+            if (h_field != NULL) {
+                EveHttpHeaderValue(jb, http_fields[f].config_field,
+                        h_field->value);
+            }
         }
     }
 }
 
-static void JsonHttpLogJSONExtended(json_t *js, htp_tx_t *tx)
+static void JsonHttpLogJSONExtended(JsonBuilder *jb, htp_tx_t *tx)
 {
     /* referer */
     htp_header_t *h_referer = NULL;
@@ -333,27 +348,17 @@ static void JsonHttpLogJSONExtended(json_t *js, htp_tx_t *tx)
         h_referer = htp_table_get_c(tx->request_headers, "referer");
     }
     if (h_referer != NULL) {
-        const size_t size = bstr_len(h_referer->value) * 2 + 1;
-        char string[size];
-        BytesToStringBuffer(bstr_ptr(h_referer->value), bstr_len(h_referer->value), string, size);
-
-        json_object_set_new(js, "http_refer", SCJsonString(string));
+        EveHttpBstr(jb, "http_refer", h_referer->value);
     }
 
     /* method */
     if (tx->request_method != NULL) {
-        const size_t size = bstr_len(tx->request_method) * 2 + 1;
-        char string[size];
-        BytesToStringBuffer(bstr_ptr(tx->request_method), bstr_len(tx->request_method), string, size);
-        json_object_set_new(js, "http_method", SCJsonString(string));
+        EveHttpBstr(jb, "http_method", tx->request_method);
     }
 
     /* protocol */
     if (tx->request_protocol != NULL) {
-        const size_t size = bstr_len(tx->request_protocol) * 2 + 1;
-        char string[size];
-        BytesToStringBuffer(bstr_ptr(tx->request_protocol), bstr_len(tx->request_protocol), string, size);
-        json_object_set_new(js, "protocol", SCJsonString(string));
+        EveHttpBstr(jb, "protocol", tx->request_protocol);
     }
 
     /* response status */
@@ -363,22 +368,19 @@ static void JsonHttpLogJSONExtended(json_t *js, htp_tx_t *tx)
         BytesToStringBuffer(bstr_ptr(tx->response_status), bstr_len(tx->response_status),
                 status_string, status_size);
         unsigned int val = strtoul(status_string, NULL, 10);
-        json_object_set_new(js, "status", json_integer(val));
+        JsonBuilderSetUint(jb, "status", val);
 
         htp_header_t *h_location = htp_table_get_c(tx->response_headers, "location");
         if (h_location != NULL) {
-            const size_t size = bstr_len(h_location->value) * 2 + 1;
-            char string[size];
-            BytesToStringBuffer(bstr_ptr(h_location->value), bstr_len(h_location->value), string, size);
-            json_object_set_new(js, "redirect", SCJsonString(string));
+            EveHttpBstr(jb, "redirect", h_location->value);
         }
     }
 
     /* length */
-    json_object_set_new(js, "length", json_integer(tx->response_message_len));
+    JsonBuilderSetInt(jb, "length", tx->response_message_len);
 }
 
-static void JsonHttpLogJSONHeaders(json_t *js, uint32_t direction, htp_tx_t *tx)
+static void JsonHttpLogJSONHeaders(JsonBuilder *jb, uint32_t direction, htp_tx_t *tx)
 {
     htp_table_t *headers = direction & LOG_HTTP_REQ_HEADERS ?
                            tx->request_headers : tx->response_headers;
@@ -406,20 +408,20 @@ static void JsonHttpLogJSONHeaders(json_t *js, uint32_t direction, htp_tx_t *tx)
         memcpy(value, bstr_ptr(h->value), size_value);
         value[size_value] = '\0';
         strcat(name, head);
-        json_object_set_new(js,name, SCJsonString(value));
+        JsonBuilderSetString(jb, name, value);
     }
 }
 
-static void BodyPrintableBuffer(json_t *js, HtpBody *body, const char *key)
+static void BodyPrintableBuffer(JsonBuilder *jb, HtpBody *body, const char *key)
 {
-    if (body->sb != NULL && body->sb->buf != NULL) {
+    if (body->sb != NULL || body->view.sb != NULL) {
         uint32_t offset = 0;
         const uint8_t *body_data;
         uint32_t body_data_len;
         uint64_t body_offset;
 
-        if (StreamingBufferGetData(body->sb, &body_data,
-                                   &body_data_len, &body_offset) == 0) {
+        if (HtpBodyGetData(body, &body_data,
+                           &body_data_len, &body_offset) == 0) {
             return;
         }
 
@@ -428,12 +430,12 @@ static void BodyPrintableBuffer(json_t *js, HtpBody *body, const char *key)
                              sizeof(printable_buf),
                              body_data, body_data_len);
         if (offset > 0) {
-            json_object_set_new(js, key, json_string((char *)printable_buf));
+            JsonBuilderSetString(jb, key, (char *)printable_buf);
         }
     }
 }
 
-void JsonHttpLogJSONBodyPrintable(json_t *js, Flow *f, uint64_t tx_id)
+void EveHttpLogJSONBodyPrintable(JsonBuilder *jb, Flow *f, uint64_t tx_id)
 {
     HtpState *htp_state = (HtpState *)FlowGetAppState(f);
     if (htp_state) {
@@ -441,34 +443,34 @@ void JsonHttpLogJSONBodyPrintable(json_t *js, Flow *f, uint64_t tx_id)
         if (tx) {
             HtpTxUserData *htud = (HtpTxUserData *)htp_tx_get_user_data(tx);
             if (htud != NULL) {
-                BodyPrintableBuffer(js, &htud->request_body, "http_request_body_printable");
-                BodyPrintableBuffer(js, &htud->response_body, "http_response_body_printable");
+                BodyPrintableBuffer(jb, &htud->request_body, "http_request_body_printable");
+                BodyPrintableBuffer(jb, &htud->response_body, "http_response_body_printable");
             }
         }
     }
 }
 
-static void BodyBase64Buffer(json_t *js, HtpBody *body, const char *key)
+static void BodyBase64Buffer(JsonBuilder *jb, HtpBody *body, const char *key)
 {
-    if (body->sb != NULL && body->sb->buf != NULL) {
+    if (body->sb != NULL || body->view.sb != NULL) {
         const uint8_t *body_data;
         uint32_t body_data_len;
         uint64_t body_offset;
 
-        if (StreamingBufferGetData(body->sb, &body_data,
-                                   &body_data_len, &body_offset) == 0) {
+        if (HtpBodyGetData(body, &body_data,
+                           &body_data_len, &body_offset) == 0) {
             return;
         }
 
         unsigned long len = body_data_len * 2 + 1;
         uint8_t encoded[len];
         if (Base64Encode(body_data, body_data_len, encoded, &len) == SC_BASE64_OK) {
-            json_object_set_new(js, key, json_string((char *)encoded));
+            JsonBuilderSetString(jb, key, (char *)encoded);
         }
     }
 }
 
-void JsonHttpLogJSONBodyBase64(json_t *js, Flow *f, uint64_t tx_id)
+void EveHttpLogJSONBodyBase64(JsonBuilder *jb, Flow *f, uint64_t tx_id)
 {
     HtpState *htp_state = (HtpState *)FlowGetAppState(f);
     if (htp_state) {
@@ -476,41 +478,40 @@ void JsonHttpLogJSONBodyBase64(json_t *js, Flow *f, uint64_t tx_id)
         if (tx) {
             HtpTxUserData *htud = (HtpTxUserData *)htp_tx_get_user_data(tx);
             if (htud != NULL) {
-                BodyBase64Buffer(js, &htud->request_body, "http_request_body");
-                BodyBase64Buffer(js, &htud->response_body, "http_response_body");
+                BodyBase64Buffer(jb, &htud->request_body, "http_request_body");
+                BodyBase64Buffer(jb, &htud->response_body, "http_response_body");
             }
         }
     }
 }
 
 /* JSON format logging */
-static void JsonHttpLogJSON(JsonHttpLogThread *aft, json_t *js, htp_tx_t *tx, uint64_t tx_id)
+static void JsonHttpLogJSON(JsonHttpLogThread *aft, JsonBuilder *jb, htp_tx_t *tx, uint64_t tx_id)
 {
     LogHttpFileCtx *http_ctx = aft->httplog_ctx;
-    json_t *hjs = json_object();
-    if (hjs == NULL) {
-        return;
-    }
 
-    JsonHttpLogJSONBasic(hjs, tx);
+    JsonBuilderOpenObject(jb, "http");
+
+    JsonHttpLogJSONBasic(jb, tx,
+            JsonHttpLogCustomField(http_ctx, HTTP_FIELD_CONTENT_RANGE));
     /* log custom fields if configured */
     if (http_ctx->fields != 0)
-        JsonHttpLogJSONCustom(http_ctx, hjs, tx);
+        JsonHttpLogJSONCustom(http_ctx, jb, tx);
     if (http_ctx->flags & LOG_HTTP_EXTENDED)
-        JsonHttpLogJSONExtended(hjs, tx);
+        JsonHttpLogJSONExtended(jb, tx);
     if (http_ctx->flags & LOG_HTTP_REQ_HEADERS)
-        JsonHttpLogJSONHeaders(hjs, LOG_HTTP_REQ_HEADERS, tx);
+        JsonHttpLogJSONHeaders(jb, LOG_HTTP_REQ_HEADERS, tx);
     if (http_ctx->flags & LOG_HTTP_RES_HEADERS)
-        JsonHttpLogJSONHeaders(hjs, LOG_HTTP_RES_HEADERS, tx);
+        JsonHttpLogJSONHeaders(jb, LOG_HTTP_RES_HEADERS, tx);
     if (tx) {
         HtpTxUserData *htud = (HtpTxUserData *)htp_tx_get_user_data(tx);
         if (htud != NULL) {
-            BodyPrintableBuffer(hjs, &htud->request_body, "http_request_body");
-            BodyPrintableBuffer(hjs, &htud->response_body, "http_response_body");
+            BodyPrintableBuffer(jb, &htud->request_body, "http_request_body");
+            BodyPrintableBuffer(jb, &htud->response_body, "http_response_body");
         }
     }
 
-    json_object_set_new(js, "http", hjs);
+    JsonBuilderClose(jb);
 }
 
 static int JsonHttpLogger(ThreadVars *tv, void *thread_data, const Packet *p, Flow *f, void *alstate, void *txptr, uint64_t tx_id)
@@ -519,70 +520,90 @@ static int JsonHttpLogger(ThreadVars *tv, void *thread_data, const Packet *p, Fl
 
     htp_tx_t *tx = txptr;
     JsonHttpLogThread *jhl = (JsonHttpLogThread *)thread_data;
-
-    json_t *js = CreateJSONHeaderWithTxId(p, LOG_DIR_FLOW, "http", tx_id);
-    if (unlikely(js == NULL))
-        return TM_ECODE_OK;
-
-    JsonAddCommonOptions(&jhl->httplog_ctx->cfg, p, f, js);
+    LogFileCtx *file_ctx = jhl->httplog_ctx->file_ctx;
 
     SCLogDebug("got a HTTP request and now logging !!");
 
-    /* reset */
-    MemBufferReset(jhl->buffer);
+    JsonAddrInfo addr = json_addr_info_zero;
+    JsonAddrInfoInit(p, LOG_DIR_FLOW, &addr);
 
-    JsonHttpLogJSON(jhl, js, tx, tx_id);
     HttpXFFCfg *xff_cfg = jhl->httplog_ctx->xff_cfg != NULL ?
         jhl->httplog_ctx->xff_cfg : jhl->httplog_ctx->parent_xff_cfg;
 
     /* xff header */
+    int have_xff_ip = 0;
+    char buffer[XFF_MAXLEN];
     if ((xff_cfg != NULL) && !(xff_cfg->flags & XFF_DISABLED) && p->flow != NULL) {
-        int have_xff_ip = 0;
-        char buffer[XFF_MAXLEN];
-
         have_xff_ip = HttpXFFGetIPFromTx(p->flow, tx_id, xff_cfg, buffer, XFF_MAXLEN);
 
-        if (have_xff_ip) {
-            if (xff_cfg->flags & XFF_EXTRADATA) {
-                json_object_set_new(js, "xff", json_string(buffer));
-            }
-            else if (xff_cfg->flags & XFF_OVERWRITE) {
-                if (p->flowflags & FLOW_PKT_TOCLIENT) {
-                    json_object_set(js, "dest_ip", json_string(buffer));
-                } else {
-                    json_object_set(js, "src_ip", json_string(buffer));
-                }
+        if (have_xff_ip && (xff_cfg->flags & XFF_EXTRADATA) == 0 &&
+                (xff_cfg->flags & XFF_OVERWRITE))
+        {
+            if (p->flowflags & FLOW_PKT_TOCLIENT) {
+                strlcpy(addr.dst_ip, buffer, sizeof(addr.dst_ip));
+            } else {
+                strlcpy(addr.src_ip, buffer, sizeof(addr.src_ip));
             }
         }
     }
 
-    OutputJSONBuffer(js, jhl->httplog_ctx->file_ctx, &jhl->buffer);
-    json_object_del(js, "http");
+    JsonBuilder jb;
+    OutputJsonBuilderStart(&jb, file_ctx, &jhl->buffer);
+
+    EveAddHeader(&jb, p, LOG_DIR_FLOW, "http", &addr);
+    JsonBuilderSetUint(&jb, "tx_id", tx_id);
+
+    EveAddCommonOptions(&jhl->httplog_ctx->cfg, p, f, &jb);
+
+    JsonHttpLogJSON(jhl, &jb, tx, tx_id);
+
+    if (have_xff_ip && (xff_cfg->flags & XFF_EXTRADATA)) {
+        JsonBuilderSetString(&jb, "xff", buffer);
+    }
 
-    json_object_clear(js);
-    json_decref(js);
+    OutputJsonBuilderBuffer(&jb, file_ctx, &jhl->buffer);
 
     SCReturnInt(TM_ECODE_OK);
 }
 
-json_t *JsonHttpAddMetadata(const Flow *f, uint64_t tx_id)
+/**
+ * \brief Add the http fields logged with alerts to the open object
+ *
+ * \retval true if the transaction was found
+ */
+bool EveHttpAddMetadata(const Flow *f, uint64_t tx_id, JsonBuilder *jb)
 {
     HtpState *htp_state = (HtpState *)FlowGetAppState(f);
     if (htp_state) {
         htp_tx_t *tx = AppLayerParserGetTx(IPPROTO_TCP, ALPROTO_HTTP, htp_state, tx_id);
 
         if (tx) {
-            json_t *hjs = json_object();
-            if (unlikely(hjs == NULL))
-                return NULL;
-
-            JsonHttpLogJSONBasic(hjs, tx);
-            JsonHttpLogJSONExtended(hjs, tx);
-            return hjs;
+            JsonHttpLogJSONBasic(jb, tx, false);
+            JsonHttpLogJSONExtended(jb, tx);
+            return true;
         }
     }
 
-    return NULL;
+    return false;
+}
+
+json_t *JsonHttpAddMetadata(const Flow *f, uint64_t tx_id)
+{
+    MemBuffer *buffer = MemBufferCreateNew(1024);
+    if (unlikely(buffer == NULL))
+        return NULL;
+
+    json_t *hjs = NULL;
+    JsonBuilder jb;
+    JsonBuilderInit(&jb, &buffer, 0);
+    JsonBuilderOpenObject(&jb, NULL);
+    if (EveHttpAddMetadata(f, tx_id, &jb)) {
+        JsonBuilderClose(&jb);
+        hjs = JsonBuilderToJson(&jb);
+    }
+
+    MemBufferFree(buffer);
+    return hjs;
 }
 
 static void OutputHttpLogDeinit(OutputCtx *output_ctx)
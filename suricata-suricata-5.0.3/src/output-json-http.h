@@ -24,11 +24,14 @@
 #ifndef __OUTPUT_JSON_HTTP_H__
 #define __OUTPUT_JSON_HTTP_H__
 
+#include "util-json-builder.h"
+
 void JsonHttpLogRegister(void);
 
 json_t *JsonHttpAddMetadata(const Flow *f, uint64_t tx_id);
-void JsonHttpLogJSONBodyPrintable(json_t *js, Flow *f, uint64_t tx_id);
-void JsonHttpLogJSONBodyBase64(json_t *js, Flow *f, uint64_t tx_id);
+bool EveHttpAddMetadata(const Flow *f, uint64_t tx_id, JsonBuilder *jb);
+void EveHttpLogJSONBodyPrintable(JsonBuilder *jb, Flow *f, uint64_t tx_id);
+void EveHttpLogJSONBodyBase64(JsonBuilder *jb, Flow *f, uint64_t tx_id);
 
 #endif /* __OUTPUT_JSON_HTTP_H__ */
 
@@ -452,11 +452,11 @@ void JsonNetFlowLogRegister(void)
 {
     /* register as separate module */
     OutputRegisterFlowModule(LOGGER_JSON_NETFLOW, "JsonNetFlowLog",
-        "netflow-json-log", OutputNetFlowLogInit, JsonNetFlowLogger,
+        "netflow-json-log", OutputNetFlowLogInit, JsonNetFlowLogger, NULL,
         JsonNetFlowLogThreadInit, JsonNetFlowLogThreadDeinit, NULL);
 
     /* also register as child of eve-log */
     OutputRegisterFlowSubModule(LOGGER_JSON_NETFLOW, "eve-log", "JsonNetFlowLog",
-        "eve-log.netflow", OutputNetFlowLogInitSub, JsonNetFlowLogger,
+        "eve-log.netflow", OutputNetFlowLogInitSub, JsonNetFlowLogger, NULL,
         JsonNetFlowLogThreadInit, JsonNetFlowLogThreadDeinit, NULL);
 }
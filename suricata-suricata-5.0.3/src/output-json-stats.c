@@ -99,6 +99,12 @@ static json_t *EngineStats2Json(const DetectEngineCtx *de_ctx,
                             json_integer(sig_stat->good_sigs_total));
         json_object_set_new(jdata, "rules_failed",
                             json_integer(sig_stat->bad_sigs_total));
+        json_object_set_new(jdata, "rules_added",
+                            json_integer(sig_stat->added_sigs_total));
+        json_object_set_new(jdata, "rules_removed",
+                            json_integer(sig_stat->removed_sigs_total));
+        json_object_set_new(jdata, "rules_changed",
+                            json_integer(sig_stat->changed_sigs_total));
     }
 
     return jdata;
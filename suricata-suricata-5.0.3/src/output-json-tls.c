@@ -110,23 +110,21 @@ typedef struct JsonTlsLogThread_ {
     MemBuffer *buffer;
 } JsonTlsLogThread;
 
-static void JsonTlsLogSubject(json_t *js, SSLState *ssl_state)
+static void JsonTlsLogSubject(JsonBuilder *jb, SSLState *ssl_state)
 {
     if (ssl_state->server_connp.cert0_subject) {
-        json_object_set_new(js, "subject",
-                            SCJsonString(ssl_state->server_connp.cert0_subject));
+        JsonBuilderSetString(jb, "subject", ssl_state->server_connp.cert0_subject);
     }
 }
 
-static void JsonTlsLogIssuer(json_t *js, SSLState *ssl_state)
+static void JsonTlsLogIssuer(JsonBuilder *jb, SSLState *ssl_state)
 {
     if (ssl_state->server_connp.cert0_issuerdn) {
-        json_object_set_new(js, "issuerdn",
-                            SCJsonString(ssl_state->server_connp.cert0_issuerdn));
+        JsonBuilderSetString(jb, "issuerdn", ssl_state->server_connp.cert0_issuerdn);
     }
 }
 
-static void JsonTlsLogSessionResumed(json_t *js, SSLState *ssl_state)
+static void JsonTlsLogSessionResumed(JsonBuilder *jb, SSLState *ssl_state)
 {
     if (ssl_state->flags & SSL_AL_FLAG_SESSION_RESUMED) {
         /* Only log a session as 'resumed' if a certificate has not
@@ -135,43 +133,40 @@ static void JsonTlsLogSessionResumed(json_t *js, SSLState *ssl_state)
                ssl_state->server_connp.cert0_subject == NULL) &&
                (ssl_state->flags & SSL_AL_FLAG_STATE_SERVER_HELLO) &&
                ((ssl_state->flags & SSL_AL_FLAG_LOG_WITHOUT_CERT) == 0)) {
-            json_object_set_new(js, "session_resumed", json_boolean(true));
+            JsonBuilderSetBool(jb, "session_resumed", true);
         }
     }
 }
 
-static void JsonTlsLogFingerprint(json_t *js, SSLState *ssl_state)
+static void JsonTlsLogFingerprint(JsonBuilder *jb, SSLState *ssl_state)
 {
     if (ssl_state->server_connp.cert0_fingerprint) {
-        json_object_set_new(js, "fingerprint",
-                SCJsonString(ssl_state->server_connp.cert0_fingerprint));
+        JsonBuilderSetString(jb, "fingerprint", ssl_state->server_connp.cert0_fingerprint);
     }
 }
 
-static void JsonTlsLogSni(json_t *js, SSLState *ssl_state)
+static void JsonTlsLogSni(JsonBuilder *jb, SSLState *ssl_state)
 {
     if (ssl_state->client_connp.sni) {
-        json_object_set_new(js, "sni",
-                            SCJsonString(ssl_state->client_connp.sni));
+        JsonBuilderSetString(jb, "sni", ssl_state->client_connp.sni);
     }
 }
 
-static void JsonTlsLogSerial(json_t *js, SSLState *ssl_state)
+static void JsonTlsLogSerial(JsonBuilder *jb, SSLState *ssl_state)
 {
     if (ssl_state->server_connp.cert0_serial) {
-        json_object_set_new(js, "serial",
-                            SCJsonString(ssl_state->server_connp.cert0_serial));
+        JsonBuilderSetString(jb, "serial", ssl_state->server_connp.cert0_serial);
     }
 }
 
-static void JsonTlsLogVersion(json_t *js, SSLState *ssl_state)
+static void JsonTlsLogVersion(JsonBuilder *jb, SSLState *ssl_state)
 {
     char ssl_version[SSL_VERSION_MAX_STRLEN];
     SSLVersionToString(ssl_state->server_connp.version, ssl_version);
-    json_object_set_new(js, "version", json_string(ssl_version));
+    JsonBuilderSetString(jb, "version", ssl_version);
 }
 
-static void JsonTlsLogNotBefore(json_t *js, SSLState *ssl_state)
+static void JsonTlsLogNotBefore(JsonBuilder *jb, SSLState *ssl_state)
 {
     if (ssl_state->server_connp.cert0_not_before != 0) {
         char timebuf[64];
@@ -179,11 +174,11 @@ static void JsonTlsLogNotBefore(json_t *js, SSLState *ssl_state)
         tv.tv_sec = ssl_state->server_connp.cert0_not_before;
         tv.tv_usec = 0;
         CreateUtcIsoTimeString(&tv, timebuf, sizeof(timebuf));
-        json_object_set_new(js, "notbefore", json_string(timebuf));
+        JsonBuilderSetString(jb, "notbefore", timebuf);
     }
 }
 
-static void JsonTlsLogNotAfter(json_t *js, SSLState *ssl_state)
+static void JsonTlsLogNotAfter(JsonBuilder *jb, SSLState *ssl_state)
 {
     if (ssl_state->server_connp.cert0_not_after != 0) {
         char timebuf[64];
@@ -191,68 +186,56 @@ static void JsonTlsLogNotAfter(json_t *js, SSLState *ssl_state)
         tv.tv_sec = ssl_state->server_connp.cert0_not_after;
         tv.tv_usec = 0;
         CreateUtcIsoTimeString(&tv, timebuf, sizeof(timebuf));
-       json_object_set_new(js, "notafter", json_string(timebuf));
+       JsonBuilderSetString(jb, "notafter", timebuf);
     }
 }
 
-static void JsonTlsLogJa3Hash(json_t *js, SSLState *ssl_state)
+static void JsonTlsLogJa3Hash(JsonBuilder *jb, SSLState *ssl_state)
 {
     if (ssl_state->client_connp.ja3_hash != NULL) {
-        json_object_set_new(js, "hash",
-                            json_string(ssl_state->client_connp.ja3_hash));
+        JsonBuilderSetString(jb, "hash", ssl_state->client_connp.ja3_hash);
     }
 }
 
-static void JsonTlsLogJa3String(json_t *js, SSLState *ssl_state)
+static void JsonTlsLogJa3String(JsonBuilder *jb, SSLState *ssl_state)
 {
     if ((ssl_state->client_connp.ja3_str != NULL) &&
             ssl_state->client_connp.ja3_str->data != NULL) {
-        json_object_set_new(js, "string",
-                            json_string(ssl_state->client_connp.ja3_str->data));
+        JsonBuilderSetString(jb, "string", ssl_state->client_connp.ja3_str->data);
     }
 }
 
-static void JsonTlsLogJa3(json_t *js, SSLState *ssl_state)
+static void JsonTlsLogJa3(JsonBuilder *jb, SSLState *ssl_state)
 {
-    json_t *tjs = json_object();
-    if (unlikely(tjs == NULL))
-        return;
-
-    JsonTlsLogJa3Hash(tjs, ssl_state);
-    JsonTlsLogJa3String(tjs, ssl_state);
-
-    json_object_set_new(js, "ja3", tjs);
+    JsonBuilderOpenObject(jb, "ja3");
+    JsonTlsLogJa3Hash(jb, ssl_state);
+    JsonTlsLogJa3String(jb, ssl_state);
+    JsonBuilderClose(jb);
 }
 
-static void JsonTlsLogJa3SHash(json_t *js, SSLState *ssl_state)
+static void JsonTlsLogJa3SHash(JsonBuilder *jb, SSLState *ssl_state)
 {
     if (ssl_state->server_connp.ja3_hash != NULL) {
-        json_object_set_new(js, "hash",
-                            json_string(ssl_state->server_connp.ja3_hash));
+        JsonBuilderSetString(jb, "hash", ssl_state->server_connp.ja3_hash);
     }
 }
 
-static void JsonTlsLogJa3SString(json_t *js, SSLState *ssl_state)
+static void JsonTlsLogJa3SString(JsonBuilder *jb, SSLState *ssl_state)
 {
     if ((ssl_state->server_connp.ja3_str != NULL) &&
             ssl_state->server_connp.ja3_str->data != NULL) {
-        json_object_set_new(js, "string",
-                            json_string(ssl_state->server_connp.ja3_str->data));
+        JsonBuilderSetString(jb, "string", ssl_state->server_connp.ja3_str->data);
     }
 }
 
-static void JsonTlsLogJa3S(json_t *js, SSLState *ssl_state)
+static void JsonTlsLogJa3S(JsonBuilder *jb, SSLState *ssl_state)
 {
-    json_t *tjs = json_object();
-    if (unlikely(tjs == NULL))
-        return;
-
-    JsonTlsLogJa3SHash(tjs, ssl_state);
-    JsonTlsLogJa3SString(tjs, ssl_state);
-
-    json_object_set_new(js, "ja3s", tjs);
+    JsonBuilderOpenObject(jb, "ja3s");
+    JsonTlsLogJa3SHash(jb, ssl_state);
+    JsonTlsLogJa3SString(jb, ssl_state);
+    JsonBuilderClose(jb);
 }
-static void JsonTlsLogCertificate(json_t *js, SSLState *ssl_state)
+static void JsonTlsLogCertificate(JsonBuilder *jb, SSLState *ssl_state)
 {
     if (TAILQ_EMPTY(&ssl_state->server_connp.certs)) {
         return;
@@ -267,20 +250,17 @@ static void JsonTlsLogCertificate(json_t *js, SSLState *ssl_state)
     uint8_t encoded[len];
     if (Base64Encode(cert->cert_data, cert->cert_len, encoded, &len) ==
                      SC_BASE64_OK) {
-        json_object_set_new(js, "certificate", json_string((char *)encoded));
+        JsonBuilderSetString(jb, "certificate", (char *)encoded);
     }
 }
 
-static void JsonTlsLogChain(json_t *js, SSLState *ssl_state)
+static void JsonTlsLogChain(JsonBuilder *jb, SSLState *ssl_state)
 {
     if (TAILQ_EMPTY(&ssl_state->server_connp.certs)) {
         return;
     }
 
-    json_t *chain = json_array();
-    if (chain == NULL) {
-        return;
-    }
+    JsonBuilderOpenArray(jb, "chain");
 
     SSLCertsChain *cert;
     TAILQ_FOREACH(cert, &ssl_state->server_connp.certs, next) {
@@ -288,108 +268,147 @@ static void JsonTlsLogChain(json_t *js, SSLState *ssl_state)
         uint8_t encoded[len];
         if (Base64Encode(cert->cert_data, cert->cert_len, encoded, &len) ==
                          SC_BASE64_OK) {
-            json_array_append_new(chain, json_string((char *)encoded));
+            JsonBuilderSetString(jb, NULL, (char *)encoded);
         }
     }
 
-    json_object_set_new(js, "chain", chain);
+    JsonBuilderClose(jb);
 }
 
-void JsonTlsLogJSONBasic(json_t *js, SSLState *ssl_state)
+static void EveTlsLogJSONBasic(JsonBuilder *jb, SSLState *ssl_state)
 {
     /* tls subject */
-    JsonTlsLogSubject(js, ssl_state);
+    JsonTlsLogSubject(jb, ssl_state);
 
     /* tls issuerdn */
-    JsonTlsLogIssuer(js, ssl_state);
+    JsonTlsLogIssuer(jb, ssl_state);
 
     /* tls session resumption */
-    JsonTlsLogSessionResumed(js, ssl_state);
+    JsonTlsLogSessionResumed(jb, ssl_state);
 }
 
-static void JsonTlsLogJSONCustom(OutputTlsCtx *tls_ctx, json_t *js,
+static void JsonTlsLogJSONCustom(OutputTlsCtx *tls_ctx, JsonBuilder *jb,
                                  SSLState *ssl_state)
 {
     /* tls subject */
     if (tls_ctx->fields & LOG_TLS_FIELD_SUBJECT)
-        JsonTlsLogSubject(js, ssl_state);
+        JsonTlsLogSubject(jb, ssl_state);
 
     /* tls issuerdn */
     if (tls_ctx->fields & LOG_TLS_FIELD_ISSUER)
-        JsonTlsLogIssuer(js, ssl_state);
+        JsonTlsLogIssuer(jb, ssl_state);
 
     /* tls session resumption */
     if (tls_ctx->fields & LOG_TLS_FIELD_SESSION_RESUMED)
-        JsonTlsLogSessionResumed(js, ssl_state);
+        JsonTlsLogSessionResumed(jb, ssl_state);
 
     /* tls serial */
     if (tls_ctx->fields & LOG_TLS_FIELD_SERIAL)
-        JsonTlsLogSerial(js, ssl_state);
+        JsonTlsLogSerial(jb, ssl_state);
 
     /* tls fingerprint */
     if (tls_ctx->fields & LOG_TLS_FIELD_FINGERPRINT)
-        JsonTlsLogFingerprint(js, ssl_state);
+        JsonTlsLogFingerprint(jb, ssl_state);
 
     /* tls sni */
     if (tls_ctx->fields & LOG_TLS_FIELD_SNI)
-        JsonTlsLogSni(js, ssl_state);
+        JsonTlsLogSni(jb, ssl_state);
 
     /* tls version */
     if (tls_ctx->fields & LOG_TLS_FIELD_VERSION)
-        JsonTlsLogVersion(js, ssl_state);
+        JsonTlsLogVersion(jb, ssl_state);
 
     /* tls notbefore */
     if (tls_ctx->fields & LOG_TLS_FIELD_NOTBEFORE)
-        JsonTlsLogNotBefore(js, ssl_state);
+        JsonTlsLogNotBefore(jb, ssl_state);
 
     /* tls notafter */
     if (tls_ctx->fields & LOG_TLS_FIELD_NOTAFTER)
-        JsonTlsLogNotAfter(js, ssl_state);
+        JsonTlsLogNotAfter(jb, ssl_state);
 
     /* tls certificate */
     if (tls_ctx->fields & LOG_TLS_FIELD_CERTIFICATE)
-        JsonTlsLogCertificate(js, ssl_state);
+        JsonTlsLogCertificate(jb, ssl_state);
 
     /* tls chain */
     if (tls_ctx->fields & LOG_TLS_FIELD_CHAIN)
-        JsonTlsLogChain(js, ssl_state);
+        JsonTlsLogChain(jb, ssl_state);
 
     /* tls ja3_hash */
     if (tls_ctx->fields & LOG_TLS_FIELD_JA3)
-        JsonTlsLogJa3(js, ssl_state);
+        JsonTlsLogJa3(jb, ssl_state);
 
     /* tls ja3s */
     if (tls_ctx->fields & LOG_TLS_FIELD_JA3S)
-        JsonTlsLogJa3S(js, ssl_state);
+        JsonTlsLogJa3S(jb, ssl_state);
 }
 
-void JsonTlsLogJSONExtended(json_t *tjs, SSLState * state)
+void EveTlsLogJSONExtended(JsonBuilder *jb, SSLState *state)
 {
-    JsonTlsLogJSONBasic(tjs, state);
+    EveTlsLogJSONBasic(jb, state);
 
     /* tls serial */
-    JsonTlsLogSerial(tjs, state);
+    JsonTlsLogSerial(jb, state);
 
     /* tls fingerprint */
-    JsonTlsLogFingerprint(tjs, state);
+    JsonTlsLogFingerprint(jb, state);
 
     /* tls sni */
-    JsonTlsLogSni(tjs, state);
+    JsonTlsLogSni(jb, state);
 
     /* tls version */
-    JsonTlsLogVersion(tjs, state);
+    JsonTlsLogVersion(jb, state);
 
     /* tls notbefore */
-    JsonTlsLogNotBefore(tjs, state);
+    JsonTlsLogNotBefore(jb, state);
 
     /* tls notafter */
-    JsonTlsLogNotAfter(tjs, state);
+    JsonTlsLogNotAfter(jb, state);
 
     /* tls ja3 */
-    JsonTlsLogJa3(tjs, state);
+    JsonTlsLogJa3(jb, state);
 
     /* tls ja3s */
-    JsonTlsLogJa3S(tjs, state);
+    JsonTlsLogJa3S(jb, state);
+}
+
+/**
+ * \brief Add tls fields to a jansson object, for the loggers that still
+ *        use jansson
+ */
+static void JsonTlsLogJSONToObject(json_t *js, SSLState *ssl_state,
+        bool extended)
+{
+    MemBuffer *buffer = MemBufferCreateNew(1024);
+    if (unlikely(buffer == NULL))
+        return;
+
+    JsonBuilder jb;
+    JsonBuilderInit(&jb, &buffer, 0);
+    JsonBuilderOpenObject(&jb, NULL);
+    if (extended) {
+        EveTlsLogJSONExtended(&jb, ssl_state);
+    } else {
+        EveTlsLogJSONBasic(&jb, ssl_state);
+    }
+    JsonBuilderClose(&jb);
+
+    json_t *tjs = JsonBuilderToJson(&jb);
+    if (tjs != NULL) {
+        json_object_update(js, tjs);
+        json_decref(tjs);
+    }
+    MemBufferFree(buffer);
+}
+
+void JsonTlsLogJSONBasic(json_t *js, SSLState *ssl_state)
+{
+    JsonTlsLogJSONToObject(js, ssl_state, false);
+}
+
+void JsonTlsLogJSONExtended(json_t *tjs, SSLState *state)
+{
+    JsonTlsLogJSONToObject(tjs, state, true);
 }
 
 static int JsonTlsLogger(ThreadVars *tv, void *thread_data, const Packet *p,
@@ -411,47 +430,38 @@ static int JsonTlsLogger(ThreadVars *tv, void *thread_data, const Packet *p,
         return 0;
     }
 
-    json_t *js = CreateJSONHeader(p, LOG_DIR_FLOW, "tls");
-    if (unlikely(js == NULL)) {
-        return 0;
-    }
+    JsonBuilder jb;
+    OutputJsonBuilderStart(&jb, tls_ctx->file_ctx, &aft->buffer);
 
-    JsonAddCommonOptions(&tls_ctx->cfg, p, f, js);
+    EveAddHeader(&jb, p, LOG_DIR_FLOW, "tls", NULL);
 
-    json_t *tjs = json_object();
-    if (tjs == NULL) {
-        free(js);
-        return 0;
-    }
+    EveAddCommonOptions(&tls_ctx->cfg, p, f, &jb);
 
-    /* reset */
-    MemBufferReset(aft->buffer);
+    JsonBuilderOpenObject(&jb, "tls");
 
     /* log custom fields */
     if (tls_ctx->flags & LOG_TLS_CUSTOM) {
-        JsonTlsLogJSONCustom(tls_ctx, tjs, ssl_state);
+        JsonTlsLogJSONCustom(tls_ctx, &jb, ssl_state);
     }
     /* log extended */
     else if (tls_ctx->flags & LOG_TLS_EXTENDED) {
-        JsonTlsLogJSONExtended(tjs, ssl_state);
+        EveTlsLogJSONExtended(&jb, ssl_state);
     }
     /* log basic */
     else {
-        JsonTlsLogJSONBasic(tjs, ssl_state);
+        EveTlsLogJSONBasic(&jb, ssl_state);
     }
 
     /* print original application level protocol when it have been changed
        because of STARTTLS, HTTP CONNECT, or similar. */
     if (f->alproto_orig != ALPROTO_UNKNOWN) {
-        json_object_set_new(tjs, "from_proto",
-                json_string(AppLayerGetProtoName(f->alproto_orig)));
+        JsonBuilderSetString(&jb, "from_proto",
+                AppLayerGetProtoName(f->alproto_orig));
     }
 
-    json_object_set_new(js, "tls", tjs);
+    JsonBuilderClose(&jb);
 
-    OutputJSONBuffer(js, tls_ctx->file_ctx, &aft->buffer);
-    json_object_clear(js);
-    json_decref(js);
+    OutputJsonBuilderBuffer(&jb, tls_ctx->file_ctx, &aft->buffer);
 
     return 0;
 }
@@ -24,11 +24,14 @@
 #ifndef __OUTPUT_JSON_TLS_H__
 #define __OUTPUT_JSON_TLS_H__
 
+#include "util-json-builder.h"
+
 void JsonTlsLogRegister(void);
 
 #include "app-layer-ssl.h"
 
 void JsonTlsLogJSONBasic(json_t *js, SSLState *ssl_state);
 void JsonTlsLogJSONExtended(json_t *js, SSLState *ssl_state);
+void EveTlsLogJSONExtended(JsonBuilder *jb, SSLState *ssl_state);
 
 #endif /* __OUTPUT_JSON_TLS_H__ */
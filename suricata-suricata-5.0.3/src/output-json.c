@@ -55,6 +55,7 @@
 #include "util-proto-name.h"
 #include "util-optimize.h"
 #include "util-buffer.h"
+#include "util-json-builder.h"
 #include "util-logopenfile.h"
 #include "util-log-redis.h"
 #include "util-device.h"
@@ -226,7 +227,7 @@ static bool SCStringHasPrefix(const char *s, const char *prefix)
  */
 static void JsonAddFlowVars(const Flow *f, json_t *js_root, json_t **js_traffic)
 {
-    if (f == NULL || f->flowvar == NULL) {
+    if (f == NULL) {
         return;
     }
     json_t *js_flowvars = NULL;
@@ -236,7 +237,7 @@ static void JsonAddFlowVars(const Flow *f, json_t *js_root, json_t **js_traffic)
     json_t *js_flowbits = NULL;
     GenericVar *gv = f->flowvar;
     while (gv != NULL) {
-        if (gv->type == DETECT_FLOWVAR || gv->type == DETECT_FLOWINT) {
+        if (gv->type == DETECT_FLOWVAR) {
             FlowVar *fv = (FlowVar *)gv;
             if (fv->datatype == FLOWVAR_TYPE_STR && fv->key == NULL) {
                 const char *varname = VarNameStoreLookupById(fv->idx,
@@ -290,55 +291,54 @@ static void JsonAddFlowVars(const Flow *f, json_t *js_root, json_t **js_traffic)
                 json_object_set_new(js_flowvar, (const char *)keybuf,
                         json_string((char *)printable_buf));
                 json_array_append_new(js_flowvars, js_flowvar);
-            } else if (fv->datatype == FLOWVAR_TYPE_INT) {
-                const char *varname = VarNameStoreLookupById(fv->idx,
-                        VAR_TYPE_FLOW_INT);
-                if (varname) {
-                    if (js_flowints == NULL) {
-                        js_flowints = json_object();
-                        if (js_flowints == NULL)
-                            break;
-                    }
-
-                    json_object_set_new(js_flowints, varname,
-                            json_integer(fv->data.fv_int.value));
-                }
-
             }
-        } else if (gv->type == DETECT_FLOWBITS) {
-            FlowBit *fb = (FlowBit *)gv;
-            const char *varname = VarNameStoreLookupById(fb->idx,
-                    VAR_TYPE_FLOW_BIT);
-            if (varname) {
-                if (SCStringHasPrefix(varname, TRAFFIC_ID_PREFIX)) {
-                    if (js_traffic_id == NULL) {
-                        js_traffic_id = json_array();
-                        if (unlikely(js_traffic_id == NULL)) {
-                            break;
-                        }
-                    }
-                    json_array_append_new(js_traffic_id,
-                            json_string(&varname[traffic_id_prefix_len]));
-                } else if (SCStringHasPrefix(varname, TRAFFIC_LABEL_PREFIX)) {
-                    if (js_traffic_label == NULL) {
-                        js_traffic_label = json_array();
-                        if (unlikely(js_traffic_label == NULL)) {
-                            break;
-                        }
+        }
+        gv = gv->next;
+    }
+    for (uint16_t i = 0; i < f->flowints_cnt; i++) {
+        const char *varname = VarNameStoreLookupById(f->flowints[i].idx,
+                VAR_TYPE_FLOW_INT);
+        if (varname) {
+            if (js_flowints == NULL) {
+                js_flowints = json_object();
+                if (js_flowints == NULL)
+                    break;
+            }
+
+            json_object_set_new(js_flowints, varname,
+                    json_integer(f->flowints[i].value));
+        }
+    }
+    for (uint32_t idx = 0; FlowBitGetNext(f, &idx); idx++) {
+        const char *varname = VarNameStoreLookupById(idx, VAR_TYPE_FLOW_BIT);
+        if (varname) {
+            if (SCStringHasPrefix(varname, TRAFFIC_ID_PREFIX)) {
+                if (js_traffic_id == NULL) {
+                    js_traffic_id = json_array();
+                    if (unlikely(js_traffic_id == NULL)) {
+                        break;
                     }
-                    json_array_append_new(js_traffic_label,
-                            json_string(&varname[traffic_label_prefix_len]));
-                } else {
-                    if (js_flowbits == NULL) {
-                        js_flowbits = json_array();
-                        if (unlikely(js_flowbits == NULL))
-                            break;
+                }
+                json_array_append_new(js_traffic_id,
+                        json_string(&varname[traffic_id_prefix_len]));
+            } else if (SCStringHasPrefix(varname, TRAFFIC_LABEL_PREFIX)) {
+                if (js_traffic_label == NULL) {
+                    js_traffic_label = json_array();
+                    if (unlikely(js_traffic_label == NULL)) {
+                        break;
                     }
-                    json_array_append_new(js_flowbits, json_string(varname));
                 }
+                json_array_append_new(js_traffic_label,
+                        json_string(&varname[traffic_label_prefix_len]));
+            } else {
+                if (js_flowbits == NULL) {
+                    js_flowbits = json_array();
+                    if (unlikely(js_flowbits == NULL))
+                        break;
+                }
+                json_array_append_new(js_flowbits, json_string(varname));
             }
         }
-        gv = gv->next;
     }
     if (js_flowbits) {
         json_object_set_new(js_root, "flowbits", js_flowbits);
@@ -363,16 +363,24 @@ static void JsonAddFlowVars(const Flow *f, json_t *js_root, json_t **js_traffic)
     }
 }
 
+/**
+ * \brief Check if the flow has flowvars, flowints or flowbits to log.
+ */
+static inline bool FlowHasVars(const Flow *f)
+{
+    return f && (f->flowvar || f->flowints_cnt || FlowBitHasAny(f));
+}
+
 /**
  * \brief Add top-level metadata to the eve json object.
  */
 static void JsonAddMetadata(const Packet *p, const Flow *f, json_t *js)
 {
-    if ((p && p->pktvar) || (f && f->flowvar)) {
+    if ((p && p->pktvar) || FlowHasVars(f)) {
         json_t *js_vars = json_object();
         json_t *js_traffic = NULL;
         if (js_vars) {
-            if (f && f->flowvar) {
+            if (FlowHasVars(f)) {
                 JsonAddFlowVars(f, js_vars, &js_traffic);
                 if (js_traffic != NULL) {
                     json_object_set_new(js, "traffic", js_traffic);
@@ -398,6 +406,185 @@ void JsonAddCommonOptions(const OutputJsonCommonSettings *cfg,
     }
 }
 
+static void EvePrintableString(JsonBuilder *jb, const char *key,
+        const uint8_t *data, uint32_t data_len)
+{
+    uint8_t printable_buf[data_len + 1];
+    uint32_t offset = 0;
+    PrintStringsToBuffer(printable_buf, &offset, sizeof(printable_buf),
+            data, data_len);
+    JsonBuilderSetString(jb, key, (char *)printable_buf);
+}
+
+static void EveAddPacketvars(const Packet *p, JsonBuilder *jb)
+{
+    bool open = false;
+    for (const PktVar *pv = p->pktvar; pv != NULL; pv = pv->next) {
+        if (pv->key == NULL && pv->id == 0)
+            continue;
+        if (!open) {
+            JsonBuilderOpenArray(jb, "pktvars");
+            open = true;
+        }
+        JsonBuilderOpenObject(jb, NULL);
+        if (pv->key != NULL) {
+            uint32_t offset = 0;
+            uint8_t keybuf[pv->key_len + 1];
+            PrintStringsToBuffer(keybuf, &offset, sizeof(keybuf),
+                    pv->key, pv->key_len);
+            EvePrintableString(jb, (char *)keybuf, pv->value, pv->value_len);
+        } else {
+            const char *varname = VarNameStoreLookupById(pv->id, VAR_TYPE_PKT_VAR);
+            if (varname != NULL) {
+                EvePrintableString(jb, varname, pv->value, pv->value_len);
+            }
+        }
+        JsonBuilderClose(jb);
+    }
+    if (open) {
+        JsonBuilderClose(jb);
+    }
+}
+
+/**
+ * \brief Add the names of flowbits as an array.
+ *
+ * With a prefix only the flowbits with that prefix are added, without
+ * the prefix. Otherwise the flowbits without a traffic prefix are added.
+ */
+static void EveAddFlowbits(const Flow *f, JsonBuilder *jb, const char *key,
+        const char *prefix, size_t prefix_len)
+{
+    bool open = false;
+    for (uint32_t idx = 0; FlowBitGetNext(f, &idx); idx++) {
+        const char *varname = VarNameStoreLookupById(idx, VAR_TYPE_FLOW_BIT);
+        if (varname == NULL)
+            continue;
+        if (prefix != NULL) {
+            if (!SCStringHasPrefix(varname, prefix))
+                continue;
+            varname += prefix_len;
+        } else if (SCStringHasPrefix(varname, TRAFFIC_ID_PREFIX) ||
+                   SCStringHasPrefix(varname, TRAFFIC_LABEL_PREFIX)) {
+            continue;
+        }
+        if (!open) {
+            JsonBuilderOpenArray(jb, key);
+            open = true;
+        }
+        JsonBuilderSetString(jb, NULL, varname);
+    }
+    if (open) {
+        JsonBuilderClose(jb);
+    }
+}
+
+/**
+ * \brief Add flow variables to the metadata object.
+ *
+ * Same layout as JsonAddFlowVars(): "flowbits" (array), "flowints" (map)
+ * and "flowvars" (array).
+ */
+static void EveAddFlowVars(const Flow *f, JsonBuilder *jb)
+{
+    EveAddFlowbits(f, jb, "flowbits", NULL, 0);
+
+    bool open = false;
+    for (uint16_t i = 0; i < f->flowints_cnt; i++) {
+        const char *varname = VarNameStoreLookupById(f->flowints[i].idx,
+                VAR_TYPE_FLOW_INT);
+        if (varname == NULL)
+            continue;
+        if (!open) {
+            JsonBuilderOpenObject(jb, "flowints");
+            open = true;
+        }
+        JsonBuilderSetUint(jb, varname, f->flowints[i].value);
+    }
+    if (open) {
+        JsonBuilderClose(jb);
+    }
+
+    open = false;
+    for (const GenericVar *gv = f->flowvar; gv != NULL; gv = gv->next) {
+        if (gv->type != DETECT_FLOWVAR)
+            continue;
+        const FlowVar *fv = (const FlowVar *)gv;
+        if (fv->datatype != FLOWVAR_TYPE_STR)
+            continue;
+
+        const char *varname = NULL;
+        uint8_t keybuf[fv->key ? fv->keylen + 1 : 1];
+        if (fv->key == NULL) {
+            varname = VarNameStoreLookupById(fv->idx, VAR_TYPE_FLOW_VAR);
+            if (varname == NULL)
+                continue;
+        } else {
+            uint32_t offset = 0;
+            PrintStringsToBuffer(keybuf, &offset, sizeof(keybuf),
+                    fv->key, fv->keylen);
+            varname = (const char *)keybuf;
+        }
+        if (!open) {
+            JsonBuilderOpenArray(jb, "flowvars");
+            open = true;
+        }
+        JsonBuilderOpenObject(jb, NULL);
+        EvePrintableString(jb, varname, fv->data.fv_str.value,
+                fv->data.fv_str.value_len);
+        JsonBuilderClose(jb);
+    }
+    if (open) {
+        JsonBuilderClose(jb);
+    }
+}
+
+/**
+ * \brief Add top-level metadata to the eve record, see JsonAddMetadata().
+ */
+static void EveAddMetadata(const Packet *p, const Flow *f, JsonBuilder *jb)
+{
+    if ((p && p->pktvar) || FlowHasVars(f)) {
+        if (FlowHasVars(f)) {
+            JsonBuilderMark mark;
+            JsonBuilderGetMark(jb, &mark);
+            JsonBuilderOpenObject(jb, "traffic");
+            EveAddFlowbits(f, jb, "id", TRAFFIC_ID_PREFIX,
+                    traffic_id_prefix_len);
+            EveAddFlowbits(f, jb, "label", TRAFFIC_LABEL_PREFIX,
+                    traffic_label_prefix_len);
+            if (JsonBuilderIsEmpty(jb)) {
+                JsonBuilderRestoreMark(jb, &mark);
+            } else {
+                JsonBuilderClose(jb);
+            }
+        }
+
+        JsonBuilderOpenObject(jb, "metadata");
+        if (FlowHasVars(f)) {
+            EveAddFlowVars(f, jb);
+        }
+        if (p && p->pktvar) {
+            EveAddPacketvars(p, jb);
+        }
+        JsonBuilderClose(jb);
+    }
+}
+
+void EveAddCommonOptions(const OutputJsonCommonSettings *cfg,
+        const Packet *p, const Flow *f, JsonBuilder *jb)
+{
+    if (cfg->include_metadata) {
+        EveAddMetadata(p, f, jb);
+    }
+    if (cfg->include_community_id && f != NULL) {
+        unsigned char buf[64];
+        if (CreateCommunityFlowId(f, cfg->community_id_seed, buf, sizeof(buf))) {
+            JsonBuilderSetString(jb, "community_id", (const char *)buf);
+        }
+    }
+}
+
 /**
  * \brief Jsonify a packet
  *
@@ -422,6 +609,23 @@ void JsonPacket(const Packet *p, json_t *js, unsigned long max_length)
     json_object_set_new(packetinfo_js, "linktype", json_integer(p->datalink));
     json_object_set_new(js, "packet_info", packetinfo_js);
 }
+/**
+ * \brief Add the base64 encoded packet to the eve record, see JsonPacket()
+ */
+void EveAddPacket(const Packet *p, JsonBuilder *jb, unsigned long max_length)
+{
+    unsigned long max_len = max_length == 0 ? GET_PKT_LEN(p) : max_length;
+    unsigned long len = 2 * max_len;
+    uint8_t encoded_packet[len];
+    if (Base64Encode((unsigned char*) GET_PKT_DATA(p), max_len, encoded_packet, &len) == SC_BASE64_OK) {
+        JsonBuilderSetString(jb, "packet", (char *)encoded_packet);
+    }
+
+    JsonBuilderOpenObject(jb, "packet_info");
+    JsonBuilderSetUint(jb, "linktype", p->datalink);
+    JsonBuilderClose(jb);
+}
+
 /** \brief jsonify tcp flags field
  *  Only add 'true' fields in an attempt to keep things reasonably compact.
  */
@@ -445,34 +649,60 @@ void JsonTcpFlags(uint8_t flags, json_t *js)
         json_object_set_new(js, "cwr", json_true());
 }
 
+/** \brief add tcp flags to the eve record, see JsonTcpFlags() */
+void EveTcpFlags(uint8_t flags, JsonBuilder *jb)
+{
+    if (flags & TH_SYN)
+        JsonBuilderSetBool(jb, "syn", true);
+    if (flags & TH_FIN)
+        JsonBuilderSetBool(jb, "fin", true);
+    if (flags & TH_RST)
+        JsonBuilderSetBool(jb, "rst", true);
+    if (flags & TH_PUSH)
+        JsonBuilderSetBool(jb, "psh", true);
+    if (flags & TH_ACK)
+        JsonBuilderSetBool(jb, "ack", true);
+    if (flags & TH_URG)
+        JsonBuilderSetBool(jb, "urg", true);
+    if (flags & TH_ECN)
+        JsonBuilderSetBool(jb, "ecn", true);
+    if (flags & TH_CWR)
+        JsonBuilderSetBool(jb, "cwr", true);
+}
+
+const JsonAddrInfo json_addr_info_zero;
+
 /**
- * \brief Add five tuple from packet to JSON object
+ * \brief Get the addresses, ports and protocol of a packet for logging
  *
  * \param p Packet
  * \param dir log direction (packet or flow)
- * \param js JSON object
+ * \param addr zeroed address info to fill
+ *
+ * \retval true if the packet has a five tuple to log
  */
-void JsonFiveTuple(const Packet *p, enum OutputJsonLogDirection dir, json_t *js)
+bool JsonAddrInfoInit(const Packet *p, enum OutputJsonLogDirection dir,
+        JsonAddrInfo *addr)
 {
-    char srcip[46] = {0}, dstip[46] = {0};
+    char *srcip = addr->src_ip, *dstip = addr->dst_ip;
+    const size_t ipsize = sizeof(addr->src_ip);
     Port sp, dp;
-    char proto[16];
 
     switch (dir) {
         case LOG_DIR_PACKET:
             if (PKT_IS_IPV4(p)) {
                 PrintInet(AF_INET, (const void *)GET_IPV4_SRC_ADDR_PTR(p),
-                        srcip, sizeof(srcip));
+                        srcip, ipsize);
                 PrintInet(AF_INET, (const void *)GET_IPV4_DST_ADDR_PTR(p),
-                        dstip, sizeof(dstip));
+                        dstip, ipsize);
             } else if (PKT_IS_IPV6(p)) {
                 PrintInet(AF_INET6, (const void *)GET_IPV6_SRC_ADDR(p),
-                        srcip, sizeof(srcip));
+                        srcip, ipsize);
                 PrintInet(AF_INET6, (const void *)GET_IPV6_DST_ADDR(p),
-                        dstip, sizeof(dstip));
+                        dstip, ipsize);
             } else {
                 /* Not an IP packet so don't do anything */
-                return;
+                return false;
             }
             sp = p->sp;
             dp = p->dp;
@@ -482,28 +712,28 @@ void JsonFiveTuple(const Packet *p, enum OutputJsonLogDirection dir, json_t *js)
             if ((PKT_IS_TOSERVER(p))) {
                 if (PKT_IS_IPV4(p)) {
                     PrintInet(AF_INET, (const void *)GET_IPV4_SRC_ADDR_PTR(p),
-                            srcip, sizeof(srcip));
+                            srcip, ipsize);
                     PrintInet(AF_INET, (const void *)GET_IPV4_DST_ADDR_PTR(p),
-                            dstip, sizeof(dstip));
+                            dstip, ipsize);
                 } else if (PKT_IS_IPV6(p)) {
                     PrintInet(AF_INET6, (const void *)GET_IPV6_SRC_ADDR(p),
-                            srcip, sizeof(srcip));
+                            srcip, ipsize);
                     PrintInet(AF_INET6, (const void *)GET_IPV6_DST_ADDR(p),
-                            dstip, sizeof(dstip));
+                            dstip, ipsize);
                 }
                 sp = p->sp;
                 dp = p->dp;
             } else {
                 if (PKT_IS_IPV4(p)) {
                     PrintInet(AF_INET, (const void *)GET_IPV4_DST_ADDR_PTR(p),
-                            srcip, sizeof(srcip));
+                            srcip, ipsize);
                     PrintInet(AF_INET, (const void *)GET_IPV4_SRC_ADDR_PTR(p),
-                            dstip, sizeof(dstip));
+                            dstip, ipsize);
                 } else if (PKT_IS_IPV6(p)) {
                     PrintInet(AF_INET6, (const void *)GET_IPV6_DST_ADDR(p),
-                            srcip, sizeof(srcip));
+                            srcip, ipsize);
                     PrintInet(AF_INET6, (const void *)GET_IPV6_SRC_ADDR(p),
-                            dstip, sizeof(dstip));
+                            dstip, ipsize);
                 }
                 sp = p->dp;
                 dp = p->sp;
@@ -513,28 +743,28 @@ void JsonFiveTuple(const Packet *p, enum OutputJsonLogDirection dir, json_t *js)
             if ((PKT_IS_TOCLIENT(p))) {
                 if (PKT_IS_IPV4(p)) {
                     PrintInet(AF_INET, (const void *)GET_IPV4_SRC_ADDR_PTR(p),
-                            srcip, sizeof(srcip));
+                            srcip, ipsize);
                     PrintInet(AF_INET, (const void *)GET_IPV4_DST_ADDR_PTR(p),
-                            dstip, sizeof(dstip));
+                            dstip, ipsize);
                 } else if (PKT_IS_IPV6(p)) {
                     PrintInet(AF_INET6, (const void *)GET_IPV6_SRC_ADDR(p),
-                            srcip, sizeof(srcip));
+                            srcip, ipsize);
                     PrintInet(AF_INET6, (const void *)GET_IPV6_DST_ADDR(p),
-                            dstip, sizeof(dstip));
+                            dstip, ipsize);
                 }
                 sp = p->sp;
                 dp = p->dp;
             } else {
                 if (PKT_IS_IPV4(p)) {
                     PrintInet(AF_INET, (const void *)GET_IPV4_DST_ADDR_PTR(p),
-                            srcip, sizeof(srcip));
+                            srcip, ipsize);
                     PrintInet(AF_INET, (const void *)GET_IPV4_SRC_ADDR_PTR(p),
-                            dstip, sizeof(dstip));
+                            dstip, ipsize);
                 } else if (PKT_IS_IPV6(p)) {
                     PrintInet(AF_INET6, (const void *)GET_IPV6_DST_ADDR(p),
-                            srcip, sizeof(srcip));
+                            srcip, ipsize);
                     PrintInet(AF_INET6, (const void *)GET_IPV6_SRC_ADDR(p),
-                            dstip, sizeof(dstip));
+                            dstip, ipsize);
                 }
                 sp = p->dp;
                 dp = p->sp;
@@ -542,16 +772,33 @@ void JsonFiveTuple(const Packet *p, enum OutputJsonLogDirection dir, json_t *js)
             break;
         default:
             DEBUG_VALIDATE_BUG_ON(1);
-            return;
+            return false;
     }
+    addr->sp = sp;
+    addr->dp = dp;
 
     if (SCProtoNameValid(IP_GET_IPPROTO(p)) == TRUE) {
-        strlcpy(proto, known_proto[IP_GET_IPPROTO(p)], sizeof(proto));
+        strlcpy(addr->proto, known_proto[IP_GET_IPPROTO(p)], sizeof(addr->proto));
     } else {
-        snprintf(proto, sizeof(proto), "%03" PRIu32, IP_GET_IPPROTO(p));
+        snprintf(addr->proto, sizeof(addr->proto), "%03" PRIu32, IP_GET_IPPROTO(p));
     }
+    return true;
+}
+
+/**
+ * \brief Add five tuple from packet to JSON object
+ *
+ * \param p Packet
+ * \param dir log direction (packet or flow)
+ * \param js JSON object
+ */
+void JsonFiveTuple(const Packet *p, enum OutputJsonLogDirection dir, json_t *js)
+{
+    JsonAddrInfo addr = json_addr_info_zero;
+    if (!JsonAddrInfoInit(p, dir, &addr))
+        return;
 
-    json_object_set_new(js, "src_ip", json_string(srcip));
+    json_object_set_new(js, "src_ip", json_string(addr.src_ip));
 
     switch(p->proto) {
         case IPPROTO_ICMP:
@@ -559,11 +806,11 @@ void JsonFiveTuple(const Packet *p, enum OutputJsonLogDirection dir, json_t *js)
         case IPPROTO_UDP:
         case IPPROTO_TCP:
         case IPPROTO_SCTP:
-            json_object_set_new(js, "src_port", json_integer(sp));
+            json_object_set_new(js, "src_port", json_integer(addr.sp));
             break;
     }
 
-    json_object_set_new(js, "dest_ip", json_string(dstip));
+    json_object_set_new(js, "dest_ip", json_string(addr.dst_ip));
 
     switch(p->proto) {
         case IPPROTO_ICMP:
@@ -571,15 +818,43 @@ void JsonFiveTuple(const Packet *p, enum OutputJsonLogDirection dir, json_t *js)
         case IPPROTO_UDP:
         case IPPROTO_TCP:
         case IPPROTO_SCTP:
-            json_object_set_new(js, "dest_port", json_integer(dp));
+            json_object_set_new(js, "dest_port", json_integer(addr.dp));
             break;
     }
 
-    json_object_set_new(js, "proto", json_string(proto));
+    json_object_set_new(js, "proto", json_string(addr.proto));
 }
 
-static void CreateJSONCommunityFlowIdv4(json_t *js, const Flow *f,
-        const uint16_t seed)
+/**
+ * \brief Add the five tuple of JsonAddrInfoInit() to the eve record
+ */
+void EveAddAddrInfo(JsonBuilder *jb, const Packet *p, const JsonAddrInfo *addr)
+{
+    JsonBuilderSetString(jb, "src_ip", addr->src_ip);
+    switch(p->proto) {
+        case IPPROTO_ICMP:
+            break;
+        case IPPROTO_UDP:
+        case IPPROTO_TCP:
+        case IPPROTO_SCTP:
+            JsonBuilderSetUint(jb, "src_port", addr->sp);
+            break;
+    }
+    JsonBuilderSetString(jb, "dest_ip", addr->dst_ip);
+    switch(p->proto) {
+        case IPPROTO_ICMP:
+            break;
+        case IPPROTO_UDP:
+        case IPPROTO_TCP:
+        case IPPROTO_SCTP:
+            JsonBuilderSetUint(jb, "dest_port", addr->dp);
+            break;
+    }
+    JsonBuilderSetString(jb, "proto", addr->proto);
+}
+
+static bool CreateCommunityFlowIdv4(const Flow *f, const uint16_t seed,
+        unsigned char *base64buf, size_t size)
 {
     struct {
         uint16_t seed;
@@ -619,12 +894,13 @@ static void CreateJSONCommunityFlowIdv4(json_t *js, const Flow *f,
 
     uint8_t hash[20];
     if (ComputeSHA1((const uint8_t *)&ipv4, sizeof(ipv4), hash, sizeof(hash)) == 1) {
-        unsigned char base64buf[64] = "1:";
-        unsigned long out_len = sizeof(base64buf) - 2;
+        strlcpy((char *)base64buf, "1:", size);
+        unsigned long out_len = size - 2;
         if (Base64Encode(hash, sizeof(hash), base64buf+2, &out_len) == SC_BASE64_OK) {
-            json_object_set_new(js, "community_id", json_string((const char *)base64buf));
+            return true;
         }
     }
+    return false;
 }
 
 static inline bool FlowHashRawAddressIPv6LtU32(const uint32_t *a, const uint32_t *b)
@@ -639,8 +915,8 @@ static inline bool FlowHashRawAddressIPv6LtU32(const uint32_t *a, const uint32_t
     return false;
 }
 
-static void CreateJSONCommunityFlowIdv6(json_t *js, const Flow *f,
-        const uint16_t seed)
+static bool CreateCommunityFlowIdv6(const Flow *f, const uint16_t seed,
+        unsigned char *base64buf, size_t size)
 {
     struct {
         uint16_t seed;
@@ -680,20 +956,38 @@ static void CreateJSONCommunityFlowIdv6(json_t *js, const Flow *f,
 
     uint8_t hash[20];
     if (ComputeSHA1((const uint8_t *)&ipv6, sizeof(ipv6), hash, sizeof(hash)) == 1) {
-        unsigned char base64buf[64] = "1:";
-        unsigned long out_len = sizeof(base64buf) - 2;
+        strlcpy((char *)base64buf, "1:", size);
+        unsigned long out_len = size - 2;
         if (Base64Encode(hash, sizeof(hash), base64buf+2, &out_len) == SC_BASE64_OK) {
-            json_object_set_new(js, "community_id", json_string((const char *)base64buf));
+            return true;
         }
     }
+    return false;
 }
 
-static void CreateJSONCommunityFlowId(json_t *js, const Flow *f, const uint16_t seed)
+/**
+ * \brief Create the community id string of a flow
+ *
+ * \param base64buf output buffer, 64 bytes are enough
+ *
+ * \retval true if the id was created
+ */
+bool CreateCommunityFlowId(const Flow *f, const uint16_t seed,
+        unsigned char *base64buf, size_t size)
 {
     if (f->flags & FLOW_IPV4)
-        return CreateJSONCommunityFlowIdv4(js, f, seed);
+        return CreateCommunityFlowIdv4(f, seed, base64buf, size);
     else if (f->flags & FLOW_IPV6)
-        return CreateJSONCommunityFlowIdv6(js, f, seed);
+        return CreateCommunityFlowIdv6(f, seed, base64buf, size);
+    return false;
+}
+
+static void CreateJSONCommunityFlowId(json_t *js, const Flow *f, const uint16_t seed)
+{
+    unsigned char base64buf[64];
+    if (CreateCommunityFlowId(f, seed, base64buf, sizeof(base64buf))) {
+        json_object_set_new(js, "community_id", json_string((const char *)base64buf));
+    }
 }
 
 void CreateJSONFlowId(json_t *js, const Flow *f)
@@ -707,6 +1001,17 @@ void CreateJSONFlowId(json_t *js, const Flow *f)
     }
 }
 
+void EveAddFlowId(JsonBuilder *jb, const Flow *f)
+{
+    if (f == NULL)
+        return;
+    int64_t flow_id = FlowGetId(f);
+    JsonBuilderSetInt(jb, "flow_id", flow_id);
+    if (f->parent_id) {
+        JsonBuilderSetInt(jb, "parent_id", f->parent_id);
+    }
+}
+
 json_t *CreateJSONHeader(const Packet *p, enum OutputJsonLogDirection dir,
                          const char *event_type)
 {
@@ -793,6 +1098,92 @@ json_t *CreateJSONHeaderWithTxId(const Packet *p, enum OutputJsonLogDirection di
     return js;
 }
 
+/**
+ * \brief Add the common header fields to an eve record
+ *
+ * Same fields as CreateJSONHeader(). The record has to be started with
+ * OutputJsonBuilderStart().
+ *
+ * \param addr five tuple to log, if NULL it's taken from the packet
+ */
+void EveAddHeader(JsonBuilder *jb, const Packet *p,
+        enum OutputJsonLogDirection dir, const char *event_type,
+        const JsonAddrInfo *addr)
+{
+    char timebuf[64];
+    const Flow *f = (const Flow *)p->flow;
+
+    CreateIsoTimeString(&p->ts, timebuf, sizeof(timebuf));
+
+    /* time & tx */
+    JsonBuilderSetString(jb, "timestamp", timebuf);
+
+    EveAddFlowId(jb, f);
+
+    /* sensor id */
+    if (sensor_id >= 0)
+        JsonBuilderSetInt(jb, "sensor_id", sensor_id);
+
+    /* input interface */
+    if (p->livedev) {
+        JsonBuilderSetString(jb, "in_iface", p->livedev->dev);
+    }
+
+    /* pcap_cnt */
+    if (p->pcap_cnt != 0) {
+        JsonBuilderSetUint(jb, "pcap_cnt", p->pcap_cnt);
+    }
+
+    if (event_type) {
+        JsonBuilderSetString(jb, "event_type", event_type);
+    }
+
+    /* vlan */
+    if (p->vlan_idx > 0) {
+        JsonBuilderOpenArray(jb, "vlan");
+        JsonBuilderSetUint(jb, NULL, p->vlan_id[0]);
+        if (p->vlan_idx > 1) {
+            JsonBuilderSetUint(jb, NULL, p->vlan_id[1]);
+        }
+        JsonBuilderClose(jb);
+    }
+
+    /* 5-tuple */
+    JsonAddrInfo addr_info = json_addr_info_zero;
+    if (addr == NULL && JsonAddrInfoInit(p, dir, &addr_info)) {
+        addr = &addr_info;
+    }
+    if (addr != NULL) {
+        EveAddAddrInfo(jb, p, addr);
+    }
+
+    /* icmp */
+    switch (p->proto) {
+        case IPPROTO_ICMP:
+            if (p->icmpv4h) {
+                JsonBuilderSetUint(jb, "icmp_type", p->icmpv4h->type);
+                JsonBuilderSetUint(jb, "icmp_code", p->icmpv4h->code);
+            }
+            break;
+        case IPPROTO_ICMPV6:
+            if (p->icmpv6h) {
+                JsonBuilderSetUint(jb, "icmp_type", p->icmpv6h->type);
+                JsonBuilderSetUint(jb, "icmp_code", p->icmpv6h->code);
+            }
+            break;
+    }
+}
+
+void EveAddHeaderWithTxId(JsonBuilder *jb, const Packet *p,
+        enum OutputJsonLogDirection dir, const char *event_type,
+        uint64_t tx_id)
+{
+    EveAddHeader(jb, p, dir, event_type, NULL);
+
+    /* tx id for correlation with other events */
+    JsonBuilderSetUint(jb, "tx_id", tx_id);
+}
+
 int OutputJSONMemBufferCallback(const char *str, size_t size, void *data)
 {
     OutputJSONMemBufferWrapper *wrapper = data;
@@ -835,6 +1226,76 @@ int OutputJSONBuffer(json_t *js, LogFileCtx *file_ctx, MemBuffer **buffer)
     return 0;
 }
 
+/**
+ * \brief Start an eve record in a thread's output buffer
+ *
+ * Resets the buffer, writes the prefix and opens the root object. The
+ * record is then added to with the builder and written out with
+ * OutputJsonBuilderBuffer().
+ */
+void OutputJsonBuilderStart(JsonBuilder *jb, LogFileCtx *file_ctx,
+        MemBuffer **buffer)
+{
+    MemBufferReset(*buffer);
+
+    if (file_ctx->prefix) {
+        MemBufferWriteRaw((*buffer), file_ctx->prefix, file_ctx->prefix_len);
+    }
+
+    JsonBuilderInit(jb, buffer, file_ctx->json_flags);
+    JsonBuilderOpenObject(jb, NULL);
+}
+
+/**
+ * \brief Finish an eve record and write it to the log
+ *
+ * Only if the json flags of the output ask for another layout than the
+ * compact one the builder writes, the record is reformatted by jansson.
+ */
+int OutputJsonBuilderBuffer(JsonBuilder *jb, LogFileCtx *file_ctx,
+        MemBuffer **buffer)
+{
+    if (file_ctx->sensor_name) {
+        JsonBuilderSetString(jb, "host", file_ctx->sensor_name);
+    }
+
+    if (file_ctx->is_pcap_offline) {
+        JsonBuilderSetString(jb, "pcap_filename", PcapFileGetFilename());
+    }
+
+    JsonBuilderClose(jb);
+    if (unlikely(jb->error || jb->depth != 0))
+        return TM_ECODE_OK;
+
+    if ((file_ctx->json_flags & JSON_BUILDER_LAYOUT_FLAGS) !=
+            JSON_BUILDER_NATIVE_FLAGS)
+    {
+        json_t *js = JsonBuilderToJson(jb);
+        if (js == NULL)
+            return TM_ECODE_OK;
+
+        OutputJSONMemBufferWrapper wrapper = {
+            .buffer = buffer,
+            .expand_by = JSON_OUTPUT_BUFFER_SIZE
+        };
+        MEMBUFFER_OFFSET(*buffer) = jb->start;
+        int r = json_dump_callback(js, OutputJSONMemBufferCallback, &wrapper,
+                file_ctx->json_flags);
+        json_decref(js);
+        if (r != 0)
+            return TM_ECODE_OK;
+    }
+
+    /* room for the newline LogFileWrite adds */
+    if (MEMBUFFER_SIZE(*buffer) - MEMBUFFER_OFFSET(*buffer) < 2) {
+        if (MemBufferExpand(buffer, JSON_OUTPUT_BUFFER_SIZE) != 0)
+            return TM_ECODE_OK;
+    }
+
+    LogFileWrite(file_ctx, *buffer);
+    return 0;
+}
+
 /**
  * \brief Create a new LogFileCtx for "fast" output style.
  * \param conf The configuration node for this output.
@@ -1086,3 +1547,134 @@ static void OutputJsonDeInitCtx(OutputCtx *output_ctx)
     SCFree(json_ctx);
     SCFree(output_ctx);
 }
+
+#ifdef UNITTESTS
+
+/** last record written by OutputJsonTestWrite() */
+static char output_json_test_record[4096];
+
+static int OutputJsonTestWrite(const char *buffer, int buffer_len,
+        LogFileCtx *file_ctx)
+{
+    if (buffer_len >= (int)sizeof(output_json_test_record))
+        return -1;
+    memcpy(output_json_test_record, buffer, buffer_len);
+    output_json_test_record[buffer_len] = '\0';
+    return 0;
+}
+
+/** \internal
+ *  \brief log the same record through the jansson and the builder path
+ *
+ *  \retval 1 if the output is byte for byte the same
+ */
+static int OutputJsonTestCompare(LogFileCtx *file_ctx, const Packet *p,
+        const OutputJsonCommonSettings *cfg)
+{
+    const char *msg = "a \"quoted\" /path\\ caf\xc3\xa9 \x01\t\xf0\x9f\x98\x80";
+    char old_record[sizeof(output_json_test_record)];
+    MemBuffer *buffer = MemBufferCreateNew(64);
+    if (buffer == NULL)
+        return 0;
+
+    /* jansson */
+    json_t *js = CreateJSONHeaderWithTxId(p, LOG_DIR_FLOW, "alert", 3);
+    if (js == NULL) {
+        MemBufferFree(buffer);
+        return 0;
+    }
+    JsonAddCommonOptions(cfg, p, p->flow, js);
+    json_t *tcp = json_object();
+    JsonTcpFlags(TH_SYN|TH_ACK|TH_PUSH, tcp);
+    json_object_set_new(js, "tcp", tcp);
+    json_object_set_new(js, "msg", json_string(msg));
+    json_object_set_new(js, "extra", json_pack("{s:[i,s,b],s:n}",
+                "list", -1, "x/y", 1, "none"));
+    JsonPacket(p, js, 0);
+    OutputJSONBuffer(js, file_ctx, &buffer);
+    json_decref(js);
+    strlcpy(old_record, output_json_test_record, sizeof(old_record));
+    output_json_test_record[0] = '\0';
+
+    /* builder */
+    JsonBuilder jb;
+    OutputJsonBuilderStart(&jb, file_ctx, &buffer);
+    EveAddHeaderWithTxId(&jb, p, LOG_DIR_FLOW, "alert", 3);
+    EveAddCommonOptions(cfg, p, p->flow, &jb);
+    JsonBuilderOpenObject(&jb, "tcp");
+    EveTcpFlags(TH_SYN|TH_ACK|TH_PUSH, &jb);
+    JsonBuilderClose(&jb);
+    JsonBuilderSetString(&jb, "msg", msg);
+    json_t *extra = json_pack("{s:[i,s,b],s:n}", "list", -1, "x/y", 1, "none");
+    JsonBuilderSetJson(&jb, "extra", extra);
+    json_decref(extra);
+    EveAddPacket(p, &jb, 0);
+    OutputJsonBuilderBuffer(&jb, file_ctx, &buffer);
+    MemBufferFree(buffer);
+
+    if (old_record[0] == '\0' ||
+            strcmp(old_record, output_json_test_record) != 0) {
+        printf("jansson: %s\nbuilder: %s\n", old_record,
+                output_json_test_record);
+        return 0;
+    }
+    return 1;
+}
+
+/** \test a record logged through the jansson and the builder path is
+ *        the same, with the native and the reformatted layouts */
+static int OutputJsonTest01(void)
+{
+    uint8_t payload[] = "GET /index.html HTTP/1.1\r\n\r\n";
+    Packet *p = UTHBuildPacketReal(payload, sizeof(payload) - 1, IPPROTO_TCP,
+            "192.168.1.5", "10.0.0.1", 41424, 80);
+    FAIL_IF_NULL(p);
+    Flow *f = UTHBuildFlow(AF_INET, "192.168.1.5", "10.0.0.1", 41424, 80);
+    FAIL_IF_NULL(f);
+    f->proto = IPPROTO_TCP;
+    p->flow = f;
+    p->ts.tv_sec = 1600000000;
+    p->ts.tv_usec = 123456;
+    p->pcap_cnt = 7;
+    p->vlan_idx = 2;
+    p->vlan_id[0] = 10;
+    p->vlan_id[1] = 20;
+
+    LogFileCtx *file_ctx = LogFileNewCtx();
+    FAIL_IF_NULL(file_ctx);
+    file_ctx->type = LOGFILE_TYPE_FILE;
+    file_ctx->Write = OutputJsonTestWrite;
+    file_ctx->sensor_name = SCStrdup("sensor/1");
+    FAIL_IF_NULL(file_ctx->sensor_name);
+
+    OutputJsonCommonSettings cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.include_metadata = true;
+    cfg.include_community_id = true;
+
+    /* eve defaults, written by the builder directly */
+    file_ctx->json_flags = JSON_PRESERVE_ORDER|JSON_COMPACT|
+        JSON_ENSURE_ASCII|JSON_ESCAPE_SLASH;
+    FAIL_IF_NOT(OutputJsonTestCompare(file_ctx, p, &cfg));
+
+    file_ctx->json_flags = JSON_PRESERVE_ORDER|JSON_COMPACT;
+    FAIL_IF_NOT(OutputJsonTestCompare(file_ctx, p, &cfg));
+
+    /* reformatted by jansson */
+    file_ctx->json_flags = JSON_SORT_KEYS|JSON_INDENT(2)|JSON_ENSURE_ASCII;
+    FAIL_IF_NOT(OutputJsonTestCompare(file_ctx, p, &cfg));
+
+    LogFileFreeCtx(file_ctx);
+    UTHFreeFlow(f);
+    UTHFreePacket(p);
+    PASS;
+}
+
+#endif /* UNITTESTS */
+
+void OutputJsonRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("OutputJsonTest01", OutputJsonTest01);
+#endif /* UNITTESTS */
+}
@@ -26,12 +26,14 @@
 
 #include "suricata-common.h"
 #include "util-buffer.h"
+#include "util-json-builder.h"
 #include "util-logopenfile.h"
 #include "output.h"
 
 #include "app-layer-htp-xff.h"
 
 void OutputJsonRegister(void);
+void OutputJsonRegisterTests(void);
 
 enum OutputJsonLogDirection {
     LOG_DIR_PACKET = 0,
@@ -51,7 +53,23 @@ typedef struct OutputJSONMemBufferWrapper_ {
 
 int OutputJSONMemBufferCallback(const char *str, size_t size, void *data);
 
+/* addresses, ports and protocol of a packet as they are logged */
+typedef struct JsonAddrInfo_ {
+    char src_ip[46];
+    char dst_ip[46];
+    Port sp;
+    Port dp;
+    char proto[16];
+} JsonAddrInfo;
+
+extern const JsonAddrInfo json_addr_info_zero;
+
+bool JsonAddrInfoInit(const Packet *p, enum OutputJsonLogDirection dir,
+        JsonAddrInfo *addr);
+
 void CreateJSONFlowId(json_t *js, const Flow *f);
+bool CreateCommunityFlowId(const Flow *f, const uint16_t seed,
+        unsigned char *base64buf, size_t size);
 void JsonTcpFlags(uint8_t flags, json_t *js);
 void JsonPacket(const Packet *p, json_t *js, unsigned long max_length);
 void JsonFiveTuple(const Packet *, enum OutputJsonLogDirection, json_t *);
@@ -60,6 +78,21 @@ json_t *CreateJSONHeader(const Packet *p,
 json_t *CreateJSONHeaderWithTxId(const Packet *p,
         enum OutputJsonLogDirection dir, const char *event_type, uint64_t tx_id);
 int OutputJSONBuffer(json_t *js, LogFileCtx *file_ctx, MemBuffer **buffer);
+
+void EveAddFlowId(JsonBuilder *jb, const Flow *f);
+void EveTcpFlags(uint8_t flags, JsonBuilder *jb);
+void EveAddPacket(const Packet *p, JsonBuilder *jb, unsigned long max_length);
+void EveAddAddrInfo(JsonBuilder *jb, const Packet *p, const JsonAddrInfo *addr);
+void EveAddHeader(JsonBuilder *jb, const Packet *p,
+        enum OutputJsonLogDirection dir, const char *event_type,
+        const JsonAddrInfo *addr);
+void EveAddHeaderWithTxId(JsonBuilder *jb, const Packet *p,
+        enum OutputJsonLogDirection dir, const char *event_type,
+        uint64_t tx_id);
+void OutputJsonBuilderStart(JsonBuilder *jb, LogFileCtx *file_ctx,
+        MemBuffer **buffer);
+int OutputJsonBuilderBuffer(JsonBuilder *jb, LogFileCtx *file_ctx,
+        MemBuffer **buffer);
 OutputInitResult OutputJsonInitCtx(ConfNode *);
 
 OutputInitResult OutputJsonLogInitSub(ConfNode *conf, OutputCtx *parent_ctx);
@@ -94,5 +127,7 @@ void SCJsonDecref(json_t *js);
 
 void JsonAddCommonOptions(const OutputJsonCommonSettings *cfg,
         const Packet *p, const Flow *f, json_t *js);
+void EveAddCommonOptions(const OutputJsonCommonSettings *cfg,
+        const Packet *p, const Flow *f, JsonBuilder *jb);
 
 #endif /* __OUTPUT_JSON_H__ */
@@ -30,6 +30,7 @@
 #include "app-layer.h"
 #include "app-layer-parser.h"
 #include "app-layer-htp.h"
+#include "app-layer-htp-body.h"
 #include "util-print.h"
 #include "conf.h"
 #include "util-profiling.h"
@@ -232,7 +233,7 @@ static int HttpBodyIterator(Flow *f, int close, void *cbdata, uint8_t iflags)
 
                 const uint8_t *data = NULL;
                 uint32_t data_len = 0;
-                StreamingBufferSegmentGetData(body->sb, &chunk->sbseg, &data, &data_len);
+                HtpBodyChunkGetData(body, chunk, &data, &data_len);
 
                 // invoke Streamer
                 Streamer(cbdata, f, data, data_len, tx_id, flags);
@@ -49,6 +49,7 @@
 #include "output-json-anomaly.h"
 #include "output-json-flow.h"
 #include "output-json-netflow.h"
+#include "log-flow-columnar.h"
 #include "log-cf-common.h"
 #include "log-droplog.h"
 #include "output-json-drop.h"
@@ -581,7 +582,8 @@ error:
  */
 void OutputRegisterFlowModule(LoggerId id, const char *name,
     const char *conf_name, OutputInitFunc InitFunc, FlowLogger FlowLogFunc,
-    ThreadInitFunc ThreadInit, ThreadDeinitFunc ThreadDeinit,
+    FlowLoggerFlush FlowFlushFunc, ThreadInitFunc ThreadInit,
+    ThreadDeinitFunc ThreadDeinit,
     ThreadExitPrintStatsFunc ThreadExitPrintStats)
 {
     if (unlikely(FlowLogFunc == NULL)) {
@@ -598,6 +600,7 @@ void OutputRegisterFlowModule(LoggerId id, const char *name,
     module->conf_name = conf_name;
     module->InitFunc = InitFunc;
     module->FlowLogFunc = FlowLogFunc;
+    module->FlowFlushFunc = FlowFlushFunc;
     module->ThreadInit = ThreadInit;
     module->ThreadDeinit = ThreadDeinit;
     module->ThreadExitPrintStats = ThreadExitPrintStats;
@@ -620,7 +623,8 @@ error:
  */
 void OutputRegisterFlowSubModule(LoggerId id, const char *parent_name,
     const char *name, const char *conf_name, OutputInitSubFunc InitFunc,
-    FlowLogger FlowLogFunc, ThreadInitFunc ThreadInit,
+    FlowLogger FlowLogFunc, FlowLoggerFlush FlowFlushFunc,
+    ThreadInitFunc ThreadInit,
     ThreadDeinitFunc ThreadDeinit,
     ThreadExitPrintStatsFunc ThreadExitPrintStats)
 {
@@ -639,6 +643,7 @@ void OutputRegisterFlowSubModule(LoggerId id, const char *parent_name,
     module->parent_name = parent_name;
     module->InitSubFunc = InitFunc;
     module->FlowLogFunc = FlowLogFunc;
+    module->FlowFlushFunc = FlowFlushFunc;
     module->ThreadInit = ThreadInit;
     module->ThreadDeinit = ThreadDeinit;
     module->ThreadExitPrintStats = ThreadExitPrintStats;
@@ -1088,6 +1093,7 @@ void OutputRegisterLoggers(void)
     /* flow/netflow */
     JsonFlowLogRegister();
     JsonNetFlowLogRegister();
+    LogFlowColumnarRegister();
     /* json stats */
     JsonStatsLogRegister();
 
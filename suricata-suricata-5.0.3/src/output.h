@@ -66,6 +66,7 @@ typedef struct OutputModule_ {
     FileLogger FileLogFunc;
     FiledataLogger FiledataLogFunc;
     FlowLogger FlowLogFunc;
+    FlowLoggerFlush FlowFlushFunc;
     StreamingLogger StreamingLogFunc;
     StatsLogger StatsLogFunc;
     AppProto alproto;
@@ -150,12 +151,14 @@ void OutputRegisterFiledataSubModule(LoggerId, const char *parent_name,
 
 void OutputRegisterFlowModule(LoggerId id, const char *name,
     const char *conf_name, OutputInitFunc InitFunc,
-    FlowLogger FlowLogFunc, ThreadInitFunc ThreadInit,
+    FlowLogger FlowLogFunc, FlowLoggerFlush FlowFlushFunc,
+    ThreadInitFunc ThreadInit,
     ThreadDeinitFunc ThreadDeinit,
     ThreadExitPrintStatsFunc ThreadExitPrintStats);
 void OutputRegisterFlowSubModule(LoggerId id, const char *parent_name,
     const char *name, const char *conf_name, OutputInitSubFunc InitFunc,
-    FlowLogger FlowLogFunc, ThreadInitFunc ThreadInit,
+    FlowLogger FlowLogFunc, FlowLoggerFlush FlowFlushFunc,
+    ThreadInitFunc ThreadInit,
     ThreadDeinitFunc ThreadDeinit,
     ThreadExitPrintStatsFunc ThreadExitPrintStats);
 
@@ -0,0 +1,391 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \ingroup afxdp
+ *
+ * @{
+ */
+
+/**
+ * \file
+ *
+ * AF_XDP socket runmode
+ *
+ * One capture thread per rx queue of the interface. Frames live in an
+ * UMEM owned by the thread, so only the single and workers runmodes are
+ * supported: a packet has to be released by the thread that read it.
+ */
+
+#include "suricata-common.h"
+#include "config.h"
+#include "tm-threads.h"
+#include "conf.h"
+#include "runmodes.h"
+#include "runmode-af-xdp.h"
+
+#include "flow-bypass.h"
+
+#include "util-debug.h"
+#include "util-time.h"
+#include "util-cpu.h"
+#include "util-affinity.h"
+#include "util-device.h"
+#include "util-runmodes.h"
+#include "util-ioctl.h"
+#include "util-ebpf.h"
+
+#include "source-af-xdp.h"
+
+const char *RunModeAFXDPGetDefaultMode(void)
+{
+    return "workers";
+}
+
+void RunModeIdsAFXDPRegister(void)
+{
+    RunModeRegisterNewRunMode(RUNMODE_AFXDP_DEV, "single",
+                              "Single threaded af-xdp mode",
+                              RunModeIdsAFXDPSingle);
+    RunModeRegisterNewRunMode(RUNMODE_AFXDP_DEV, "workers",
+                              "Workers af-xdp mode, each thread does all"
+                              " tasks from acquisition to logging",
+                              RunModeIdsAFXDPWorkers);
+    return;
+}
+
+#ifdef HAVE_AF_XDP
+
+static void AFXDPDerefConfig(void *conf)
+{
+    AFXDPIfaceConfig *pfp = (AFXDPIfaceConfig *)conf;
+    /* config is used only once but cost of this low. */
+    if (SC_ATOMIC_SUB(pfp->ref, 1) == 0) {
+        SCFree(pfp);
+    }
+}
+
+/**
+ * \brief extract information from config file
+ *
+ * The returned structure will be freed by the thread init function.
+ *
+ * \return a AFXDPIfaceConfig corresponding to the interface name
+ */
+static void *ParseAFXDPConfig(const char *iface)
+{
+    const char *threadsstr = NULL;
+    ConfNode *if_root;
+    ConfNode *if_default = NULL;
+    ConfNode *af_xdp_node;
+    const char *tmpctype;
+    const char *bindmodestr;
+    intmax_t value;
+    int boolval;
+    const char *bpf_filter = NULL;
+    const char *ebpf_file = NULL;
+
+    if (iface == NULL) {
+        return NULL;
+    }
+
+    AFXDPIfaceConfig *aconf = SCCalloc(1, sizeof(*aconf));
+    if (unlikely(aconf == NULL)) {
+        return NULL;
+    }
+
+    strlcpy(aconf->iface, iface, sizeof(aconf->iface));
+    aconf->threads = 0;
+    SC_ATOMIC_INIT(aconf->ref);
+    (void) SC_ATOMIC_ADD(aconf->ref, 1);
+    SC_ATOMIC_INIT(aconf->queue_cnt);
+    aconf->ring_size = AFXDP_RING_SIZE_DEFAULT;
+    aconf->frame_size = AFXDP_FRAME_SIZE_DEFAULT;
+    aconf->bind_mode = AFXDP_BIND_AUTO;
+    aconf->promisc = 1;
+    aconf->checksum_mode = CHECKSUM_VALIDATION_AUTO;
+    aconf->DerefFunc = AFXDPDerefConfig;
+    aconf->xdp_mode = XDP_FLAGS_SKB_MODE;
+    aconf->xdp_filter_fd = -1;
+    aconf->ebpf_t_config.cpus_count = UtilCpuGetNumProcessorsConfigured();
+
+    if (ConfGet("bpf-filter", &bpf_filter) == 1) {
+        if (strlen(bpf_filter) > 0) {
+            aconf->bpf_filter = bpf_filter;
+            SCLogConfig("Going to use command-line provided bpf filter '%s'",
+                       aconf->bpf_filter);
+        }
+    }
+
+    /* Find initial node */
+    af_xdp_node = ConfGetNode("af-xdp");
+    if (af_xdp_node == NULL) {
+        SCLogInfo("unable to find af-xdp config using default values");
+        goto finalize;
+    }
+
+    if_root = ConfFindDeviceConfig(af_xdp_node, iface);
+    if_default = ConfFindDeviceConfig(af_xdp_node, "default");
+
+    if (if_root == NULL && if_default == NULL) {
+        SCLogInfo("unable to find af-xdp config for "
+                  "interface \"%s\" or \"default\", using default values",
+                  iface);
+        goto finalize;
+    }
+
+    /* If there is no setting for current interface use default one as main iface */
+    if (if_root == NULL) {
+        if_root = if_default;
+        if_default = NULL;
+    }
+
+    if (ConfGetChildValueWithDefault(if_root, if_default, "threads", &threadsstr) == 1) {
+        if (strcmp(threadsstr, "auto") != 0) {
+            aconf->threads = atoi(threadsstr);
+        }
+    }
+
+    if ((ConfGetChildValueIntWithDefault(if_root, if_default, "ring-size", &value)) == 1) {
+        if (value <= 0 || (value & (value - 1)) != 0) {
+            SCLogWarning(SC_ERR_INVALID_VALUE, "af-xdp ring-size %"PRIiMAX" for "
+                         "iface %s must be a power of 2, using %u", value, iface,
+                         AFXDP_RING_SIZE_DEFAULT);
+        } else {
+            aconf->ring_size = (uint32_t)value;
+        }
+    }
+
+    if ((ConfGetChildValueIntWithDefault(if_root, if_default, "frame-size", &value)) == 1) {
+        if (value != 2048 && value != 4096) {
+            SCLogWarning(SC_ERR_INVALID_VALUE, "af-xdp frame-size %"PRIiMAX" for "
+                         "iface %s must be 2048 or 4096, using %u", value, iface,
+                         AFXDP_FRAME_SIZE_DEFAULT);
+        } else {
+            aconf->frame_size = (uint32_t)value;
+        }
+    }
+
+    if (ConfGetChildValueWithDefault(if_root, if_default, "bind-mode", &bindmodestr) == 1) {
+        if (strcmp(bindmodestr, "auto") == 0) {
+            aconf->bind_mode = AFXDP_BIND_AUTO;
+        } else if (strcmp(bindmodestr, "zero-copy") == 0) {
+            aconf->bind_mode = AFXDP_BIND_ZERO_COPY;
+        } else if (strcmp(bindmodestr, "copy") == 0) {
+            aconf->bind_mode = AFXDP_BIND_COPY;
+        } else {
+            SCLogWarning(SC_ERR_INVALID_VALUE, "invalid bind-mode '%s' for "
+                         "iface %s (valid are auto, zero-copy, copy)",
+                         bindmodestr, iface);
+        }
+    }
+
+    /* load af-xdp bpf filter */
+    /* command line value has precedence */
+    if (ConfGet("bpf-filter", &bpf_filter) != 1) {
+        if (ConfGetChildValueWithDefault(if_root, if_default, "bpf-filter", &bpf_filter) == 1) {
+            if (strlen(bpf_filter) > 0) {
+                aconf->bpf_filter = bpf_filter;
+                SCLogConfig("Going to use bpf filter %s", aconf->bpf_filter);
+            }
+        }
+    }
+
+    const char *xdp_mode;
+    if (ConfGetChildValueWithDefault(if_root, if_default, "xdp-mode", &xdp_mode) == 1) {
+        if (!strcmp(xdp_mode, "soft")) {
+            aconf->xdp_mode = XDP_FLAGS_SKB_MODE;
+        } else if (!strcmp(xdp_mode, "driver")) {
+            aconf->xdp_mode = XDP_FLAGS_DRV_MODE;
+        } else {
+            SCLogWarning(SC_ERR_INVALID_VALUE,
+                         "Invalid xdp-mode value: '%s'", xdp_mode);
+        }
+    }
+
+    if (ConfGetChildValueWithDefault(if_root, if_default, "xdp-filter-file", &ebpf_file) == 1) {
+        aconf->ebpf_t_config.mode = AFP_MODE_XDP_BYPASS;
+        aconf->ebpf_t_config.flags |= EBPF_XDP_CODE;
+        aconf->xdp_filter_file = ebpf_file;
+        aconf->flags |= AFXDP_XDP_FILTER;
+
+        boolval = 0;
+        ConfGetChildValueBoolWithDefault(if_root, if_default, "bypass", &boolval);
+        if (boolval) {
+            SCLogConfig("Using bypass kernel functionality for AF_XDP (iface %s)",
+                    aconf->iface);
+            aconf->flags |= AFXDP_XDPBYPASS;
+            BypassedFlowManagerRegisterUpdateFunc(EBPFUpdateFlow, NULL);
+        }
+
+        boolval = 1;
+        if (ConfGetChildValueBoolWithDefault(if_root, if_default, "use-percpu-hash", &boolval) == 1) {
+            if (boolval == 0) {
+                SCLogConfig("Not using percpu hash on iface %s",
+                        aconf->iface);
+                aconf->ebpf_t_config.cpus_count = 1;
+            }
+        }
+    }
+
+    boolval = 0;
+    (void)ConfGetChildValueBoolWithDefault(if_root, if_default, "disable-promisc", &boolval);
+    if (boolval) {
+        SCLogConfig("Disabling promiscuous mode on iface %s",
+                aconf->iface);
+        aconf->promisc = 0;
+    }
+
+    if (ConfGetChildValueWithDefault(if_root, if_default, "checksum-checks", &tmpctype) == 1) {
+        if (strcmp(tmpctype, "auto") == 0) {
+            aconf->checksum_mode = CHECKSUM_VALIDATION_AUTO;
+        } else if (ConfValIsTrue(tmpctype)) {
+            aconf->checksum_mode = CHECKSUM_VALIDATION_ENABLE;
+        } else if (ConfValIsFalse(tmpctype)) {
+            aconf->checksum_mode = CHECKSUM_VALIDATION_DISABLE;
+        } else {
+            SCLogWarning(SC_ERR_INVALID_ARGUMENT, "Invalid value for "
+                         "checksum-checks for %s", aconf->iface);
+        }
+    }
+
+finalize:
+
+    /* One shot loading of the XDP file. The sockets are added to its
+     * 'xsks_map' by the capture threads. */
+    if (aconf->xdp_filter_file) {
+        int ret = EBPFLoadFile(aconf->iface, aconf->xdp_filter_file, "xdp",
+                               &aconf->xdp_filter_fd,
+                               &aconf->ebpf_t_config);
+        if (ret != 0) {
+            SCLogError(SC_ERR_INVALID_VALUE,
+                       "Error when loading XDP filter file");
+            SCFree(aconf);
+            return NULL;
+        }
+        if (EBPFSetupXDP(aconf->iface, aconf->xdp_filter_fd, aconf->xdp_mode) != 0) {
+            SCLogError(SC_ERR_INVALID_VALUE, "Error when setting up XDP");
+            SCFree(aconf);
+            return NULL;
+        }
+        /* no CPU redirect with AF_XDP: packets are read on the rx queue
+         * they arrived on */
+        EBPFBuildCPUSet(NULL, aconf->iface);
+    }
+
+    if (aconf->threads == 0) {
+        aconf->threads = GetIfaceRSSQueuesNum(aconf->iface);
+        if (aconf->threads == 0) {
+            aconf->threads = 1;
+        }
+    }
+
+    /* LRO merges frames before XDP can see them */
+    if (LiveGetOffload() == 0) {
+        (void)GetIfaceOffloading(aconf->iface, 0, 1);
+    } else {
+        DisableIfaceOffloading(LiveGetDevice(aconf->iface), 0, 1);
+    }
+
+    SC_ATOMIC_RESET(aconf->ref);
+    (void) SC_ATOMIC_ADD(aconf->ref, aconf->threads);
+
+    SCLogPerf("Using %d AF_XDP threads for interface %s (ring-size %u, "
+              "frame-size %u)", aconf->threads, aconf->iface,
+              aconf->ring_size, aconf->frame_size);
+
+    return aconf;
+}
+
+static int AFXDPConfigGeThreadsCount(void *conf)
+{
+    AFXDPIfaceConfig *afp = (AFXDPIfaceConfig *)conf;
+    return afp->threads;
+}
+
+#endif /* HAVE_AF_XDP */
+
+/**
+ * \brief Single thread version of the AF_XDP processing.
+ */
+int RunModeIdsAFXDPSingle(void)
+{
+    SCEnter();
+
+#ifdef HAVE_AF_XDP
+    int ret;
+    const char *live_dev = NULL;
+
+    RunModeInitialize();
+    TimeModeSetLive();
+
+    (void)ConfGet("af-xdp.live-interface", &live_dev);
+
+    ret = RunModeSetLiveCaptureSingle(ParseAFXDPConfig,
+                                    AFXDPConfigGeThreadsCount,
+                                    "ReceiveAFXDP",
+                                    "DecodeAFXDP", thread_name_single,
+                                    live_dev);
+    if (ret != 0) {
+        SCLogError(SC_ERR_RUNMODE, "Unable to start runmode");
+        exit(EXIT_FAILURE);
+    }
+
+    SCLogDebug("RunModeIdsAFXDPSingle initialised");
+
+#endif /* HAVE_AF_XDP */
+    SCReturnInt(0);
+}
+
+/**
+ * \brief Workers version of the AF_XDP processing.
+ *
+ * Start N threads with each thread doing all the work.
+ *
+ */
+int RunModeIdsAFXDPWorkers(void)
+{
+    SCEnter();
+
+#ifdef HAVE_AF_XDP
+    int ret;
+    const char *live_dev = NULL;
+
+    RunModeInitialize();
+    TimeModeSetLive();
+
+    (void)ConfGet("af-xdp.live-interface", &live_dev);
+
+    ret = RunModeSetLiveCaptureWorkers(ParseAFXDPConfig,
+                                    AFXDPConfigGeThreadsCount,
+                                    "ReceiveAFXDP",
+                                    "DecodeAFXDP", thread_name_workers,
+                                    live_dev);
+    if (ret != 0) {
+        SCLogError(SC_ERR_RUNMODE, "Unable to start runmode");
+        exit(EXIT_FAILURE);
+    }
+
+    SCLogDebug("RunModeIdsAFXDPWorkers initialised");
+
+#endif /* HAVE_AF_XDP */
+    SCReturnInt(0);
+}
+
+/**
+ * @}
+ */
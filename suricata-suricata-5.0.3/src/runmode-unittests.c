@@ -43,6 +43,8 @@
 #include "flow.h"
 #include "flow-timeout.h"
 #include "flow-manager.h"
+#include "flow-partition.h"
+#include "flow-bypass-policy.h"
 #include "flow-var.h"
 #include "flow-bit.h"
 #include "pkt-var.h"
@@ -90,6 +92,7 @@
 #include "util-bloomfilter.h"
 #include "util-bloomfilter-counting.h"
 #include "util-pool.h"
+#include "util-slab.h"
 #include "util-byte.h"
 #include "util-proto-name.h"
 #include "util-memrchr.h"
@@ -104,8 +107,13 @@
 #include "tmqh-flow.h"
 #include "defrag.h"
 #include "detect-engine-siggroup.h"
+#include "detect-engine-header.h"
 
 #include "util-streaming-buffer.h"
+#include "util-json-builder.h"
+#include "output-json.h"
+#include "util-log-async.h"
+#include "util-log-redis.h"
 #include "util-lua.h"
 
 #ifdef OS_WIN32
@@ -139,6 +147,7 @@ static void RegisterUnittests(void)
     BloomFilterRegisterTests();
     BloomFilterCountingRegisterTests();
     PoolRegisterTests();
+    SlabRegisterTests();
     ByteRegisterTests();
     MpmRegisterTests();
     FlowBitRegisterTests();
@@ -165,12 +174,15 @@ static void RegisterUnittests(void)
     ConfYamlRegisterTests();
     TmqhFlowRegisterTests();
     FlowRegisterTests();
+    FlowPartitionRegisterTests();
+    BypassPolicyRegisterTests();
     HostRegisterUnittests();
     IPPairRegisterUnittests();
     SCSigRegisterSignatureOrderingTests();
     SCRadixRegisterTests();
     DefragRegisterTests();
     SigGroupHeadRegisterTests();
+    DetectHeaderFilterRegisterTests();
     SCHInfoRegisterTests();
     SCRuleVarsRegisterTests();
     AppLayerParserRegisterUnittests();
@@ -200,6 +212,12 @@ static void RegisterUnittests(void)
     AppLayerUnittestsRegister();
     MimeDecRegisterTests();
     StreamingBufferRegisterTests();
+    JsonBuilderRegisterTests();
+    OutputJsonRegisterTests();
+    LogAsyncRegisterTests();
+#ifdef HAVE_LIBHIREDIS
+    SCLogRedisRegisterTests();
+#endif
 #ifdef OS_WIN32
     Win32SyscallRegisterTests();
 #endif
@@ -289,6 +307,7 @@ void RunUnittests(int list_unittests, const char *regex_arg)
         uint32_t failed = UtRunTests(regex_arg);
         PacketPoolDestroy();
         UtCleanup();
+        MpmACGlobalCleanup();
 #ifdef BUILD_HYPERSCAN
         MpmHSGlobalCleanup();
 #endif
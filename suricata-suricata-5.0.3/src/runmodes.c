@@ -54,6 +54,9 @@
 #include "flow-manager.h"
 #include "flow-bypass.h"
 #include "counters.h"
+#include "util-logopenfile.h"
+#include "util-log-async.h"
+#include "util-log-redis.h"
 
 int debuglog_enabled = 0;
 int threading_set_cpu_affinity = FALSE;
@@ -70,6 +73,9 @@ const char *thread_name_unix_socket = "US";
 const char *thread_name_detect_loader = "DL";
 const char *thread_name_counter_stats = "CS";
 const char *thread_name_counter_wakeup = "CW";
+const char *thread_name_log_flusher = "LF";
+const char *thread_name_log_output = "LO";
+const char *thread_name_redis_output = "RO";
 
 /**
  * \brief Holds description for a runmode.
@@ -139,6 +145,12 @@ static const char *RunModeTranslateModeToName(int runmode)
             return "UNITTEST";
         case RUNMODE_AFP_DEV:
             return "AF_PACKET_DEV";
+        case RUNMODE_AFXDP_DEV:
+#ifdef HAVE_AF_XDP
+            return "AF_XDP_DEV";
+#else
+            return "AF_XDP_DEV(DISABLED)";
+#endif
         case RUNMODE_NETMAP:
 #ifdef HAVE_NETMAP
             return "NETMAP";
@@ -220,6 +232,7 @@ void RunModeRegisterRunModes(void)
     RunModeErfDagRegister();
     RunModeNapatechRegister();
     RunModeIdsAFPRegister();
+    RunModeIdsAFXDPRegister();
     RunModeIdsNetmapRegister();
     RunModeIdsNflogRegister();
     RunModeUnixSocketRegister();
@@ -320,6 +333,9 @@ void RunModeDispatch(int runmode, const char *custom_mode)
             case RUNMODE_AFP_DEV:
                 custom_mode = RunModeAFPGetDefaultMode();
                 break;
+            case RUNMODE_AFXDP_DEV:
+                custom_mode = RunModeAFXDPGetDefaultMode();
+                break;
             case RUNMODE_NETMAP:
                 custom_mode = RunModeNetmapGetDefaultMode();
                 break;
@@ -391,6 +407,11 @@ void RunModeDispatch(int runmode, const char *custom_mode)
             BypassedFlowManagerThreadSpawn();
         }
         StatsSpawnThreads();
+        LogFileFlusherSpawn();
+        LogAsyncSpawn();
+#ifdef HAVE_LIBHIREDIS
+        SCLogRedisPipelineSpawn();
+#endif
     }
 }
 
@@ -523,6 +544,7 @@ bool IsRunModeOffline(enum RunModes run_mode_to_check)
 void RunModeShutDown(void)
 {
     RunOutputFreeList();
+    LogAsyncDeinit();
 
     OutputPacketShutdown();
     OutputTxShutdown();
@@ -556,7 +578,7 @@ static void SetupOutput(const char *name, OutputModule *module, OutputCtx *outpu
     /* flow logger doesn't run in the packet path */
     if (module->FlowLogFunc) {
         OutputRegisterFlowLogger(module->name, module->FlowLogFunc,
-            output_ctx, module->ThreadInit, module->ThreadDeinit,
+            module->FlowFlushFunc, output_ctx, module->ThreadInit, module->ThreadDeinit,
             module->ThreadExitPrintStats);
         return;
     }
@@ -894,6 +916,7 @@ void RunModeInitializeOutputs(void)
 }
 
 float threading_detect_ratio = 1;
+uint32_t threading_batch_size = TM_PKT_BATCH_DEFAULT;
 
 /**
  * Initialize multithreading settings.
@@ -915,4 +938,16 @@ void RunModeInitialize(void)
     }
 
     SCLogDebug("threading.detect-thread-ratio %f", threading_detect_ratio);
+
+    intmax_t batch_size;
+    if ((ConfGetInt("threading.batch-size", &batch_size)) == 1) {
+        if (batch_size < 1 || batch_size > TM_PKT_BATCH_MAX) {
+            WarnInvalidConfEntry("threading.batch-size", "%d", TM_PKT_BATCH_DEFAULT);
+        } else {
+            threading_batch_size = (uint32_t)batch_size;
+        }
+    } else if (ConfGetNode("threading.batch-size") != NULL) {
+        WarnInvalidConfEntry("threading.batch-size", "%d", TM_PKT_BATCH_DEFAULT);
+    }
+    SCLogDebug("threading.batch-size %u", threading_batch_size);
 }
@@ -221,6 +221,9 @@ typedef struct AFPThreadVars_
 
     ThreadVars *tv;
     TmSlot *slot;
+    /* packets of the current tpacket v3 block waiting for the slots */
+    Packet *batch[TM_PKT_BATCH_MAX];
+    uint32_t batch_cnt;
     LiveDevice *livedev;
     /* data link type for the thread */
     uint32_t datalink;
@@ -1127,14 +1130,34 @@ static inline int AFPParsePacketV3(AFPThreadVars *ptv, struct tpacket_block_desc
         }
     }
 
-    if (TmThreadsSlotProcessPkt(ptv->tv, ptv->slot, p) != TM_ECODE_OK) {
-        TmqhOutputPacketpool(ptv->tv, p);
-        SCReturnInt(AFP_SURI_FAILURE);
+    ptv->batch[ptv->batch_cnt++] = p;
+    if (ptv->batch_cnt == threading_batch_size) {
+        TmEcode r = TmThreadsSlotProcessPktBatch(ptv->tv, ptv->slot,
+                                                 ptv->batch, ptv->batch_cnt);
+        ptv->batch_cnt = 0;
+        if (r != TM_ECODE_OK) {
+            SCReturnInt(AFP_SURI_FAILURE);
+        }
     }
 
     SCReturnInt(AFP_READ_OK);
 }
 
+/**
+ * \brief Run the pending packets of the block through the slots
+ *
+ * Needs to be done before the block is given back to the kernel.
+ */
+static inline void AFPFlushBatch(AFPThreadVars *ptv)
+{
+    if (ptv->batch_cnt > 0) {
+        /* on failure the packets are back in the pool already */
+        (void)TmThreadsSlotProcessPktBatch(ptv->tv, ptv->slot,
+                                           ptv->batch, ptv->batch_cnt);
+        ptv->batch_cnt = 0;
+    }
+}
+
 static inline int AFPWalkBlock(AFPThreadVars *ptv, struct tpacket_block_desc *pbd)
 {
     int num_pkts = pbd->hdr.bh1.num_pkts, i;
@@ -1143,6 +1166,10 @@ static inline int AFPWalkBlock(AFPThreadVars *ptv, struct tpacket_block_desc *pb
 
     ppd = (uint8_t *)pbd + pbd->hdr.bh1.offset_to_first_pkt;
     for (i = 0; i < num_pkts; ++i) {
+        /* start loading the next frame while we set up this one */
+        if (i + 1 < num_pkts) {
+            prefetch(ppd + ((struct tpacket3_hdr *)ppd)->tp_next_offset);
+        }
         ret = AFPParsePacketV3(ptv, pbd,
                                (struct tpacket3_hdr *)ppd);
         switch (ret) {
@@ -1153,13 +1180,16 @@ static inline int AFPWalkBlock(AFPThreadVars *ptv, struct tpacket_block_desc *pb
                  * treat thenext packet */
                 break;
             case AFP_READ_FAILURE:
+                AFPFlushBatch(ptv);
                 SCReturnInt(AFP_READ_FAILURE);
             default:
+                AFPFlushBatch(ptv);
                 SCReturnInt(ret);
         }
         ppd = ppd + ((struct tpacket3_hdr *)ppd)->tp_next_offset;
     }
 
+    AFPFlushBatch(ptv);
     SCReturnInt(AFP_READ_OK);
 }
 #endif /* HAVE_TPACKET_V3 */
@@ -2289,88 +2319,6 @@ TmEcode AFPSetBPFFilter(AFPThreadVars *ptv)
     return TM_ECODE_OK;
 }
 
-#ifdef HAVE_PACKET_EBPF
-/**
- * Insert a half flow in the kernel bypass table
- *
- * \param mapfd file descriptor of the protocol bypass table
- * \param key data to use as key in the table
- * \return 0 in case of error, 1 if success
- */
-static int AFPInsertHalfFlow(int mapd, void *key, unsigned int nr_cpus)
-{
-    BPF_DECLARE_PERCPU(struct pair, value, nr_cpus);
-    unsigned int i;
-
-    if (mapd == -1) {
-        return 0;
-    }
-
-    /* We use a per CPU structure so we have to set an array of values as the kernel
-     * is not duplicating the data on each CPU by itself. */
-    for (i = 0; i < nr_cpus; i++) {
-        BPF_PERCPU(value, i).packets = 0;
-        BPF_PERCPU(value, i).bytes = 0;
-    }
-    if (bpf_map_update_elem(mapd, key, value, BPF_NOEXIST) != 0) {
-        switch (errno) {
-            /* no more place in the hash */
-            case E2BIG:
-                return 0;
-            /* no more place in the hash for some hardware bypass */
-            case EAGAIN:
-                return 0;
-            /* if we already have the key then bypass is a success */
-            case EEXIST:
-                return 1;
-            /* Not supposed to be there so issue a error */
-            default:
-                SCLogError(SC_ERR_BPF, "Can't update eBPF map: %s (%d)",
-                        strerror(errno),
-                        errno);
-                return 0;
-        }
-    }
-    return 1;
-}
-
-static int AFPSetFlowStorage(Packet *p, int map_fd, void *key0, void* key1,
-                             int family)
-{
-    FlowBypassInfo *fc = FlowGetStorageById(p->flow, GetFlowBypassInfoID());
-    if (fc) {
-        EBPFBypassData *eb = SCCalloc(1, sizeof(EBPFBypassData));
-        if (eb == NULL) {
-            EBPFDeleteKey(map_fd, key0);
-            EBPFDeleteKey(map_fd, key1);
-            LiveDevAddBypassFail(p->livedev, 1, family);
-            SCFree(key0);
-            SCFree(key1);
-            return 0;
-        }
-        eb->key[0] = key0;
-        eb->key[1] = key1;
-        eb->mapfd = map_fd;
-        eb->cpus_count = p->afp_v.nr_cpus;
-        fc->BypassUpdate = EBPFBypassUpdate;
-        fc->BypassFree = EBPFBypassFree;
-        fc->bypass_data = eb;
-    } else {
-        EBPFDeleteKey(map_fd, key0);
-        EBPFDeleteKey(map_fd, key1);
-        LiveDevAddBypassFail(p->livedev, 1, family);
-        SCFree(key0);
-        SCFree(key1);
-        return 0;
-    }
-
-    LiveDevAddBypassStats(p->livedev, 1, family);
-    LiveDevAddBypassSuccess(p->livedev, 1, family);
-    return 1;
-}
-
-#endif
-
 /**
  * Bypass function for AF_PACKET capture in eBPF mode
  *
@@ -2428,8 +2376,8 @@ static int AFPBypassCallback(Packet *p)
         } else {
             keys[0]->ip_proto = 0;
         }
-        if (AFPInsertHalfFlow(p->afp_v.v4_map_fd, keys[0],
-                              p->afp_v.nr_cpus) == 0) {
+        if (EBPFInsertHalfFlow(p->afp_v.v4_map_fd, keys[0],
+                               p->afp_v.nr_cpus) == 0) {
             LiveDevAddBypassFail(p->livedev, 1, AF_INET);
             SCFree(keys[0]);
             return 0;
@@ -2449,8 +2397,8 @@ static int AFPBypassCallback(Packet *p)
         keys[1]->vlan1 = p->vlan_id[1];
 
         keys[1]->ip_proto = keys[0]->ip_proto;
-        if (AFPInsertHalfFlow(p->afp_v.v4_map_fd, keys[1],
-                              p->afp_v.nr_cpus) == 0) {
+        if (EBPFInsertHalfFlow(p->afp_v.v4_map_fd, keys[1],
+                               p->afp_v.nr_cpus) == 0) {
             EBPFDeleteKey(p->afp_v.v4_map_fd, keys[0]);
             LiveDevAddBypassFail(p->livedev, 1, AF_INET);
             SCFree(keys[0]);
@@ -2458,7 +2406,8 @@ static int AFPBypassCallback(Packet *p)
             return 0;
         }
         EBPFUpdateFlow(p->flow, p, NULL);
-        return AFPSetFlowStorage(p, p->afp_v.v4_map_fd, keys[0], keys[1], AF_INET);
+        return EBPFSetFlowStorage(p, p->afp_v.v4_map_fd, keys[0], keys[1], AF_INET,
+                                  p->afp_v.nr_cpus);
     }
     /* For IPv6 case we don't handle extended header in eBPF */
     if (PKT_IS_IPV6(p) &&
@@ -2488,8 +2437,8 @@ static int AFPBypassCallback(Packet *p)
         } else {
             keys[0]->ip_proto = 0;
         }
-        if (AFPInsertHalfFlow(p->afp_v.v6_map_fd, keys[0],
-                              p->afp_v.nr_cpus) == 0) {
+        if (EBPFInsertHalfFlow(p->afp_v.v6_map_fd, keys[0],
+                               p->afp_v.nr_cpus) == 0) {
             LiveDevAddBypassFail(p->livedev, 1, AF_INET6);
             SCFree(keys[0]);
             return 0;
@@ -2511,8 +2460,8 @@ static int AFPBypassCallback(Packet *p)
         keys[1]->vlan1 = p->vlan_id[1];
 
         keys[1]->ip_proto = keys[0]->ip_proto;
-        if (AFPInsertHalfFlow(p->afp_v.v6_map_fd, keys[1],
-                              p->afp_v.nr_cpus) == 0) {
+        if (EBPFInsertHalfFlow(p->afp_v.v6_map_fd, keys[1],
+                               p->afp_v.nr_cpus) == 0) {
             EBPFDeleteKey(p->afp_v.v6_map_fd, keys[0]);
             LiveDevAddBypassFail(p->livedev, 1, AF_INET6);
             SCFree(keys[0]);
@@ -2521,7 +2470,8 @@ static int AFPBypassCallback(Packet *p)
         }
         if (p->flow)
             EBPFUpdateFlow(p->flow, p, NULL);
-        return AFPSetFlowStorage(p, p->afp_v.v6_map_fd, keys[0], keys[1], AF_INET6);
+        return EBPFSetFlowStorage(p, p->afp_v.v6_map_fd, keys[0], keys[1], AF_INET6,
+                                  p->afp_v.nr_cpus);
     }
 #endif
     return 0;
@@ -2542,136 +2492,8 @@ static int AFPXDPBypassCallback(Packet *p)
 {
 #ifdef HAVE_PACKET_XDP
     SCLogDebug("Calling af_packet callback function");
-    /* Only bypass TCP and UDP */
-    if (!(PKT_IS_TCP(p) || PKT_IS_UDP(p))) {
-        return 0;
-    }
-
-    /* If we don't have a flow attached to packet the eBPF map entries
-     * will be destroyed at first flow bypass manager pass as we won't
-     * find any associated entry */
-    if (p->flow == NULL) {
-        return 0;
-    }
-    /* Bypassing tunneled packets is currently not supported
-     * because we can't discard the inner packet only due to
-     * primitive parsing in eBPF */
-    if (IS_TUNNEL_PKT(p)) {
-        return 0;
-    }
-    if (PKT_IS_IPV4(p)) {
-        struct flowv4_keys *keys[2];
-        keys[0]= SCCalloc(1, sizeof(struct flowv4_keys));
-        if (keys[0] == NULL) {
-            LiveDevAddBypassFail(p->livedev, 1, AF_INET);
-            return 0;
-        }
-        if (p->afp_v.v4_map_fd == -1) {
-            SCFree(keys[0]);
-            return 0;
-        }
-        keys[0]->src = p->src.addr_data32[0];
-        keys[0]->dst = p->dst.addr_data32[0];
-        /* In the XDP filter we get port from parsing of packet and not from skb
-         * (as in eBPF filter) so we need to pass from host to network order */
-        keys[0]->port16[0] = htons(p->sp);
-        keys[0]->port16[1] = htons(p->dp);
-        keys[0]->vlan0 = p->vlan_id[0];
-        keys[0]->vlan1 = p->vlan_id[1];
-        if (IPV4_GET_IPPROTO(p) == IPPROTO_TCP) {
-            keys[0]->ip_proto = 1;
-        } else {
-            keys[0]->ip_proto = 0;
-        }
-        if (AFPInsertHalfFlow(p->afp_v.v4_map_fd, keys[0],
-                              p->afp_v.nr_cpus) == 0) {
-            LiveDevAddBypassFail(p->livedev, 1, AF_INET);
-            SCFree(keys[0]);
-            return 0;
-        }
-        keys[1]= SCCalloc(1, sizeof(struct flowv4_keys));
-        if (keys[1] == NULL) {
-            EBPFDeleteKey(p->afp_v.v4_map_fd, keys[0]);
-            LiveDevAddBypassFail(p->livedev, 1, AF_INET);
-            SCFree(keys[0]);
-            return 0;
-        }
-        keys[1]->src = p->dst.addr_data32[0];
-        keys[1]->dst = p->src.addr_data32[0];
-        keys[1]->port16[0] = htons(p->dp);
-        keys[1]->port16[1] = htons(p->sp);
-        keys[1]->vlan0 = p->vlan_id[0];
-        keys[1]->vlan1 = p->vlan_id[1];
-        keys[1]->ip_proto = keys[0]->ip_proto;
-        if (AFPInsertHalfFlow(p->afp_v.v4_map_fd, keys[1],
-                              p->afp_v.nr_cpus) == 0) {
-            EBPFDeleteKey(p->afp_v.v4_map_fd, keys[0]);
-            LiveDevAddBypassFail(p->livedev, 1, AF_INET);
-            SCFree(keys[0]);
-            SCFree(keys[1]);
-            return 0;
-        }
-        return AFPSetFlowStorage(p, p->afp_v.v4_map_fd, keys[0], keys[1], AF_INET);
-    }
-    /* For IPv6 case we don't handle extended header in eBPF */
-    if (PKT_IS_IPV6(p) &&
-        ((IPV6_GET_NH(p) == IPPROTO_TCP) || (IPV6_GET_NH(p) == IPPROTO_UDP))) {
-        SCLogDebug("add an IPv6");
-        if (p->afp_v.v6_map_fd == -1) {
-            return 0;
-        }
-        int i;
-        struct flowv6_keys *keys[2];
-        keys[0] = SCCalloc(1, sizeof(struct flowv6_keys));
-        if (keys[0] == NULL) {
-            return 0;
-        }
-
-        for (i = 0; i < 4; i++) {
-            keys[0]->src[i] = GET_IPV6_SRC_ADDR(p)[i];
-            keys[0]->dst[i] = GET_IPV6_DST_ADDR(p)[i];
-        }
-        keys[0]->port16[0] = htons(GET_TCP_SRC_PORT(p));
-        keys[0]->port16[1] = htons(GET_TCP_DST_PORT(p));
-        keys[0]->vlan0 = p->vlan_id[0];
-        keys[0]->vlan1 = p->vlan_id[1];
-        if (IPV6_GET_NH(p) == IPPROTO_TCP) {
-            keys[0]->ip_proto = 1;
-        } else {
-            keys[0]->ip_proto = 0;
-        }
-        if (AFPInsertHalfFlow(p->afp_v.v6_map_fd, keys[0],
-                              p->afp_v.nr_cpus) == 0) {
-            LiveDevAddBypassFail(p->livedev, 1, AF_INET6);
-            SCFree(keys[0]);
-            return 0;
-        }
-        keys[1]= SCCalloc(1, sizeof(struct flowv6_keys));
-        if (keys[1] == NULL) {
-            EBPFDeleteKey(p->afp_v.v6_map_fd, keys[0]);
-            LiveDevAddBypassFail(p->livedev, 1, AF_INET6);
-            SCFree(keys[0]);
-            return 0;
-        }
-        for (i = 0; i < 4; i++) {
-            keys[1]->src[i] = GET_IPV6_DST_ADDR(p)[i];
-            keys[1]->dst[i] = GET_IPV6_SRC_ADDR(p)[i];
-        }
-        keys[1]->port16[0] = htons(GET_TCP_DST_PORT(p));
-        keys[1]->port16[1] = htons(GET_TCP_SRC_PORT(p));
-        keys[1]->vlan0 = p->vlan_id[0];
-        keys[1]->vlan1 = p->vlan_id[1];
-        keys[1]->ip_proto = keys[0]->ip_proto;
-        if (AFPInsertHalfFlow(p->afp_v.v6_map_fd, keys[1],
-                              p->afp_v.nr_cpus) == 0) {
-            EBPFDeleteKey(p->afp_v.v6_map_fd, keys[0]);
-            LiveDevAddBypassFail(p->livedev, 1, AF_INET6);
-            SCFree(keys[0]);
-            SCFree(keys[1]);
-            return 0;
-        }
-        return AFPSetFlowStorage(p, p->afp_v.v6_map_fd, keys[0], keys[1], AF_INET6);
-    }
+    return EBPFXDPBypassFlow(p, p->afp_v.v4_map_fd, p->afp_v.v6_map_fd,
+                             p->afp_v.nr_cpus);
 #endif
     return 0;
 }
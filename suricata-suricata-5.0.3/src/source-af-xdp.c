@@ -0,0 +1,766 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ *  \defgroup afxdp AF_XDP running mode
+ *
+ *  @{
+ */
+
+/**
+ * \file
+ *
+ * AF_XDP socket acquisition support
+ *
+ * Each capture thread binds an AF_XDP socket to one rx queue of the
+ * interface. The socket has its own UMEM: packets are decoded in place
+ * from the UMEM frames and a frame is handed back to the fill ring when
+ * its packet is released to the packet pool.
+ */
+
+#define PCAP_DONT_INCLUDE_PCAP_BPF_H 1
+#define SC_PCAP_DONT_INCLUDE_PCAP_H 1
+#include "suricata-common.h"
+#include "config.h"
+#include "suricata.h"
+#include "decode.h"
+#include "threads.h"
+#include "threadvars.h"
+#include "tm-modules.h"
+#include "tm-threads.h"
+#include "conf.h"
+#include "util-debug.h"
+#include "util-device.h"
+#include "util-ebpf.h"
+#include "util-error.h"
+#include "util-privs.h"
+#include "util-optimize.h"
+#include "util-checksum.h"
+#include "tmqh-packetpool.h"
+#include "source-af-xdp.h"
+#include "runmodes.h"
+
+#ifdef HAVE_AF_XDP
+
+#include <bpf/xsk.h>
+#include <bpf/bpf.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <net/if.h>
+#include "util-ioctl.h"
+
+struct bpf_program {
+    unsigned int bf_len;
+    struct bpf_insn *bf_insns;
+};
+
+#ifdef HAVE_PCAP_H
+#include <pcap.h>
+#endif
+
+#ifdef HAVE_PCAP_PCAP_H
+#include <pcap/pcap.h>
+#endif
+
+#include "util-bpf.h"
+
+#endif /* HAVE_AF_XDP */
+
+#ifndef HAVE_AF_XDP
+
+/**
+ * \brief this function prints an error message and exits.
+ */
+static TmEcode NoAFXDPSupportExit(ThreadVars *tv, const void *initdata, void **data)
+{
+    SCLogError(SC_ERR_NO_AF_XDP,"Error creating thread %s: you do not have "
+            "support for AF_XDP enabled, on Linux host please recompile "
+            "with --enable-ebpf --enable-af-xdp", tv->name);
+    exit(EXIT_FAILURE);
+}
+
+void TmModuleReceiveAFXDPRegister (void)
+{
+    tmm_modules[TMM_RECEIVEAFXDP].name = "ReceiveAFXDP";
+    tmm_modules[TMM_RECEIVEAFXDP].ThreadInit = NoAFXDPSupportExit;
+    tmm_modules[TMM_RECEIVEAFXDP].flags = TM_FLAG_RECEIVE_TM;
+}
+
+/**
+ * \brief Registration Function for DecodeAFXDP.
+ */
+void TmModuleDecodeAFXDPRegister (void)
+{
+    tmm_modules[TMM_DECODEAFXDP].name = "DecodeAFXDP";
+    tmm_modules[TMM_DECODEAFXDP].ThreadInit = NoAFXDPSupportExit;
+    tmm_modules[TMM_DECODEAFXDP].flags = TM_FLAG_DECODE_TM;
+}
+
+#else /* We have AF_XDP support */
+
+#define POLL_TIMEOUT 100
+
+/** max number of descriptors taken from the rx ring in one go */
+#define AFXDP_RX_BATCH  TM_PKT_BATCH_MAX
+
+/**
+ * \brief Structure to hold thread specific variables.
+ */
+typedef struct AFXDPThreadVars_
+{
+    struct xsk_socket *xsk;
+    struct xsk_umem *umem;
+    struct xsk_ring_cons rx;
+    struct xsk_ring_prod fq;
+    struct xsk_ring_cons cq;
+    void *umem_area;
+    uint64_t umem_size;
+    int fd;
+
+    /** frames we own that are not on the fill ring yet. Used as a
+     *  stack so the most recently released frames are reused first. */
+    uint64_t *fill_stash;
+    uint32_t fill_cnt;
+
+    uint32_t ring_size;
+    uint32_t frame_size;
+    uint32_t queue_id;
+    int flags;
+    int promisc;
+    ChecksumValidationMode checksum_mode;
+
+    struct bpf_program bpf_prog;
+
+    /* XDP filter maps */
+    int xsks_map_fd;
+    int v4_map_fd;
+    int v6_map_fd;
+    unsigned int nr_cpus;
+
+    /* suricata internals */
+    TmSlot *slot;
+    ThreadVars *tv;
+    LiveDevice *livedev;
+    char iface[AFXDP_IFACE_NAME_LENGTH];
+
+    /* counters */
+    uint64_t pkts;
+    uint64_t bytes;
+    uint64_t kernel_drops;  /**< last value read from the socket */
+    time_t last_dump;
+    uint16_t capture_kernel_packets;
+    uint16_t capture_kernel_drops;
+    uint16_t capture_kernel_bytes;
+} AFXDPThreadVars;
+
+static void AFXDPDumpCounters(AFXDPThreadVars *ptv)
+{
+    struct xdp_statistics stats;
+    socklen_t len = sizeof(stats);
+    uint64_t drops = 0;
+
+    memset(&stats, 0, sizeof(stats));
+    if (getsockopt(ptv->fd, SOL_XDP, XDP_STATISTICS, &stats, &len) == 0) {
+        uint64_t total = stats.rx_dropped;
+#ifdef HAVE_STRUCT_XDP_STATISTICS_RX_RING_FULL
+        total += stats.rx_ring_full;
+#endif
+        drops = total - ptv->kernel_drops;
+        ptv->kernel_drops = total;
+    }
+
+    StatsAddUI64(ptv->tv, ptv->capture_kernel_packets, ptv->pkts);
+    StatsAddUI64(ptv->tv, ptv->capture_kernel_drops, drops);
+    StatsAddUI64(ptv->tv, ptv->capture_kernel_bytes, ptv->bytes);
+    (void) SC_ATOMIC_ADD(ptv->livedev->drop, drops);
+    (void) SC_ATOMIC_ADD(ptv->livedev->pkts, ptv->pkts);
+    ptv->pkts = 0;
+    ptv->bytes = 0;
+}
+
+/**
+ * \brief Give the stashed frames back to the kernel
+ *
+ * Only the capture thread produces on the fill ring, the frames of the
+ * packets released in the meantime are queued in the stash.
+ */
+static inline void AFXDPRefillFillRing(AFXDPThreadVars *ptv)
+{
+    if (ptv->fill_cnt == 0)
+        return;
+
+    uint32_t n = xsk_prod_nb_free(&ptv->fq, ptv->fill_cnt);
+    if (n > ptv->fill_cnt)
+        n = ptv->fill_cnt;
+    if (n == 0)
+        return;
+
+    uint32_t idx = 0;
+    if (xsk_ring_prod__reserve(&ptv->fq, n, &idx) != n)
+        return;
+
+    for (uint32_t i = 0; i < n; i++) {
+        *xsk_ring_prod__fill_addr(&ptv->fq, idx++) = ptv->fill_stash[--ptv->fill_cnt];
+    }
+    xsk_ring_prod__submit(&ptv->fq, n);
+}
+
+/**
+ * \brief Packet release routine, puts the frame back in the stash
+ */
+static void AFXDPReleasePacket(Packet *p)
+{
+    AFXDPThreadVars *ptv = (AFXDPThreadVars *)p->afxdp_v.ptv;
+
+    /* the callback stays set on recycled packets, only give back the
+     * frame once */
+    if (ptv != NULL) {
+        ptv->fill_stash[ptv->fill_cnt++] = p->afxdp_v.addr;
+        p->afxdp_v.ptv = NULL;
+    }
+    PacketFreeOrRelease(p);
+}
+
+static int AFXDPBypassCallback(Packet *p)
+{
+    SCLogDebug("Calling af_xdp callback function");
+    return EBPFXDPBypassFlow(p, p->afxdp_v.v4_map_fd, p->afxdp_v.v6_map_fd,
+                             p->afxdp_v.nr_cpus);
+}
+
+/**
+ * \brief Turn a rx descriptor into a packet
+ *
+ * \retval p the packet or NULL if the frame was filtered out or no
+ *         packet was available, in which case the frame is stashed
+ */
+static inline Packet *AFXDPProcessFrame(AFXDPThreadVars *ptv,
+        const struct xdp_desc *desc, const struct timeval *ts)
+{
+    /* frames are aligned, the descriptor address points after the
+     * headroom */
+    const uint64_t frame = desc->addr & ~((uint64_t)ptv->frame_size - 1);
+    uint8_t *pkt = xsk_umem__get_data(ptv->umem_area, desc->addr);
+
+    ptv->pkts++;
+    ptv->bytes += desc->len;
+
+    if (ptv->bpf_prog.bf_len) {
+        struct pcap_pkthdr pkthdr = { {0, 0}, desc->len, desc->len };
+        if (pcap_offline_filter(&ptv->bpf_prog, &pkthdr, pkt) == 0) {
+            ptv->fill_stash[ptv->fill_cnt++] = frame;
+            return NULL;
+        }
+    }
+
+    Packet *p = PacketGetFromQueueOrAlloc();
+    if (unlikely(p == NULL)) {
+        ptv->fill_stash[ptv->fill_cnt++] = frame;
+        return NULL;
+    }
+    PKT_SET_SRC(p, PKT_SRC_WIRE);
+    p->livedev = ptv->livedev;
+    p->datalink = LINKTYPE_ETHERNET;
+    p->ts = *ts;
+
+    p->afxdp_v.ptv = ptv;
+    p->afxdp_v.addr = frame;
+    p->ReleasePacket = AFXDPReleasePacket;
+
+    if (PacketSetData(p, pkt, desc->len) == -1) {
+        TmqhOutputPacketpool(ptv->tv, p);
+        return NULL;
+    }
+
+    if (ptv->flags & AFXDP_XDPBYPASS) {
+        p->BypassPacketsFlow = AFXDPBypassCallback;
+        p->afxdp_v.v4_map_fd = ptv->v4_map_fd;
+        p->afxdp_v.v6_map_fd = ptv->v6_map_fd;
+        p->afxdp_v.nr_cpus = ptv->nr_cpus;
+    }
+
+    if (ptv->checksum_mode == CHECKSUM_VALIDATION_DISABLE) {
+        p->flags |= PKT_IGNORE_CHECKSUM;
+    } else if (ptv->checksum_mode == CHECKSUM_VALIDATION_AUTO) {
+        if (ptv->livedev->ignore_checksum) {
+            p->flags |= PKT_IGNORE_CHECKSUM;
+        } else if (ChecksumAutoModeCheck(ptv->pkts,
+                    SC_ATOMIC_GET(ptv->livedev->pkts),
+                    SC_ATOMIC_GET(ptv->livedev->invalid_checksums))) {
+            ptv->livedev->ignore_checksum = 1;
+            p->flags |= PKT_IGNORE_CHECKSUM;
+        }
+    }
+
+    return p;
+}
+
+/**
+ * \brief Main AF_XDP reading loop function
+ */
+static TmEcode ReceiveAFXDPLoop(ThreadVars *tv, void *data, void *slot)
+{
+    SCEnter();
+
+    TmSlot *s = (TmSlot *)slot;
+    AFXDPThreadVars *ptv = (AFXDPThreadVars *)data;
+    struct pollfd fds;
+
+    ptv->slot = s->slot_next;
+    fds.fd = ptv->fd;
+    fds.events = POLLIN;
+
+    for (;;) {
+        if (unlikely(suricata_ctl_flags != 0)) {
+            break;
+        }
+
+        /* make sure we have at least one packet in the packet pool,
+         * to prevent us from alloc'ing packets at line rate */
+        PacketPoolWait();
+
+        AFXDPRefillFillRing(ptv);
+
+        uint32_t idx = 0;
+        const uint32_t rcvd = xsk_ring_cons__peek(&ptv->rx, AFXDP_RX_BATCH, &idx);
+        if (rcvd == 0) {
+            /* ring is empty, sleep until the kernel has frames for us.
+             * This also kicks the driver if it needs a wakeup. */
+            int r = poll(&fds, 1, POLL_TIMEOUT);
+            if (r < 0) {
+                if (errno != EINTR)
+                    SCLogError(SC_ERR_AFXDP_READ,
+                               "Error polling AF_XDP socket of iface '%s': (%d) %s",
+                               ptv->iface, errno, strerror(errno));
+            } else if (r == 0) {
+                AFXDPDumpCounters(ptv);
+                StatsSyncCountersIfSignalled(tv);
+
+                /* poll timed out, lets handle the timeout */
+                TmThreadsCaptureHandleTimeout(tv, ptv->slot, NULL);
+            }
+            continue;
+        }
+
+        /* the descriptors carry no timestamp, one per batch will do */
+        struct timeval ts;
+        gettimeofday(&ts, NULL);
+
+        Packet *batch[AFXDP_RX_BATCH];
+        uint32_t batch_cnt = 0;
+        for (uint32_t i = 0; i < rcvd; i++) {
+            const struct xdp_desc *desc = xsk_ring_cons__rx_desc(&ptv->rx, idx++);
+            Packet *p = AFXDPProcessFrame(ptv, desc, &ts);
+            if (p == NULL)
+                continue;
+
+            batch[batch_cnt++] = p;
+            if (batch_cnt == threading_batch_size) {
+                if (TmThreadsSlotProcessPktBatch(tv, ptv->slot, batch, batch_cnt) != TM_ECODE_OK) {
+                    xsk_ring_cons__release(&ptv->rx, rcvd);
+                    SCReturnInt(TM_ECODE_FAILED);
+                }
+                batch_cnt = 0;
+            }
+        }
+        /* the frames stay ours until they are put back on the fill
+         * ring, so the descriptors can go before the last batch runs */
+        xsk_ring_cons__release(&ptv->rx, rcvd);
+        if (batch_cnt > 0 &&
+                TmThreadsSlotProcessPktBatch(tv, ptv->slot, batch, batch_cnt) != TM_ECODE_OK) {
+            SCReturnInt(TM_ECODE_FAILED);
+        }
+
+        if (ts.tv_sec != ptv->last_dump) {
+            AFXDPDumpCounters(ptv);
+            ptv->last_dump = ts.tv_sec;
+        }
+        StatsSyncCountersIfSignalled(tv);
+    }
+
+    AFXDPDumpCounters(ptv);
+    StatsSyncCountersIfSignalled(tv);
+    SCReturnInt(TM_ECODE_OK);
+}
+
+/**
+ * \brief Set up the UMEM and bind the socket to our rx queue.
+ */
+static int AFXDPCreateSocket(AFXDPThreadVars *ptv, AFXDPIfaceConfig *aconf)
+{
+    /* enough frames to keep both the fill and the rx ring full */
+    const uint32_t nb_frames = ptv->ring_size * 2;
+    int ret;
+
+    int if_flags = GetIfaceFlags(ptv->iface);
+    if (if_flags == -1) {
+        SCLogError(SC_ERR_AFXDP_CREATE, "Can not access interface '%s'",
+                   ptv->iface);
+        return -1;
+    }
+    if ((if_flags & IFF_UP) == 0) {
+        SCLogError(SC_ERR_AFXDP_CREATE, "interface '%s' is down", ptv->iface);
+        return -1;
+    }
+    if (ptv->promisc && (if_flags & IFF_PROMISC) == 0) {
+        SetIfaceFlags(ptv->iface, if_flags | IFF_PROMISC);
+    }
+
+    ptv->fill_stash = SCMalloc(nb_frames * sizeof(uint64_t));
+    if (ptv->fill_stash == NULL) {
+        SCLogError(SC_ERR_MEM_ALLOC, "Unable to allocate AF_XDP frame stash");
+        return -1;
+    }
+
+    ptv->umem_size = (uint64_t)nb_frames * ptv->frame_size;
+    ptv->umem_area = mmap(NULL, ptv->umem_size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptv->umem_area == MAP_FAILED) {
+        SCLogError(SC_ERR_MEM_ALLOC, "Unable to map %"PRIu64" bytes of UMEM "
+                   "for '%s': %s", ptv->umem_size, ptv->iface, strerror(errno));
+        ptv->umem_area = NULL;
+        return -1;
+    }
+
+    struct xsk_umem_config ucfg = {
+        .fill_size = ptv->ring_size,
+        .comp_size = ptv->ring_size,
+        .frame_size = ptv->frame_size,
+        .frame_headroom = XSK_UMEM__DEFAULT_FRAME_HEADROOM,
+        .flags = 0,
+    };
+    ret = xsk_umem__create(&ptv->umem, ptv->umem_area, ptv->umem_size,
+                           &ptv->fq, &ptv->cq, &ucfg);
+    if (ret != 0) {
+        SCLogError(SC_ERR_AFXDP_CREATE, "Unable to create UMEM for '%s': %s",
+                   ptv->iface, strerror(-ret));
+        return -1;
+    }
+
+    struct xsk_socket_config xcfg;
+    memset(&xcfg, 0, sizeof(xcfg));
+    xcfg.rx_size = ptv->ring_size;
+    xcfg.tx_size = XSK_RING_PROD__DEFAULT_NUM_DESCS;
+    xcfg.xdp_flags = aconf->xdp_mode;
+    /* with a user filter, the XDP program is already in place and we
+     * only register the socket in its xsks_map */
+    if (ptv->flags & AFXDP_XDP_FILTER) {
+        xcfg.libbpf_flags = XSK_LIBBPF_FLAGS__INHIBIT_PROG_LOAD;
+    }
+    if (aconf->bind_mode == AFXDP_BIND_ZERO_COPY) {
+        xcfg.bind_flags |= XDP_ZEROCOPY;
+    } else if (aconf->bind_mode == AFXDP_BIND_COPY) {
+        xcfg.bind_flags |= XDP_COPY;
+    }
+#ifdef XDP_USE_NEED_WAKEUP
+    xcfg.bind_flags |= XDP_USE_NEED_WAKEUP;
+#endif
+
+    ret = xsk_socket__create(&ptv->xsk, ptv->iface, ptv->queue_id, ptv->umem,
+                             &ptv->rx, NULL, &xcfg);
+    if (ret != 0) {
+        SCLogError(SC_ERR_AFXDP_CREATE, "Unable to create AF_XDP socket on "
+                   "'%s' queue %u: %s", ptv->iface, ptv->queue_id, strerror(-ret));
+        return -1;
+    }
+    ptv->fd = xsk_socket__fd(ptv->xsk);
+
+    if (ptv->flags & AFXDP_XDP_FILTER) {
+        ptv->xsks_map_fd = EBPFGetMapFDByName(ptv->iface, "xsks_map");
+        if (ptv->xsks_map_fd == -1) {
+            SCLogError(SC_ERR_AFXDP_CREATE, "XDP filter on '%s' has no "
+                       "'xsks_map', it needs to be built with BUILD_XSKMAP",
+                       ptv->iface);
+            return -1;
+        }
+        if (bpf_map_update_elem(ptv->xsks_map_fd, &ptv->queue_id, &ptv->fd, 0) != 0) {
+            SCLogError(SC_ERR_AFXDP_CREATE, "Unable to add socket of queue %u "
+                       "to xsks_map of '%s': %s", ptv->queue_id, ptv->iface,
+                       strerror(errno));
+            return -1;
+        }
+    }
+
+    /* all frames start in the stash and go to the kernel at the first
+     * refill */
+    for (uint32_t i = 0; i < nb_frames; i++) {
+        ptv->fill_stash[ptv->fill_cnt++] = (uint64_t)i * ptv->frame_size;
+    }
+    AFXDPRefillFillRing(ptv);
+
+    const char *mode = "auto";
+#ifdef XDP_OPTIONS
+    struct xdp_options opts;
+    socklen_t optlen = sizeof(opts);
+    if (getsockopt(ptv->fd, SOL_XDP, XDP_OPTIONS, &opts, &optlen) == 0) {
+        mode = (opts.flags & XDP_OPTIONS_ZEROCOPY) ? "zero-copy" : "copy";
+    }
+#endif
+    SCLogConfig("AF_XDP socket bound to '%s' queue %u in %s mode",
+                ptv->iface, ptv->queue_id, mode);
+    return 0;
+}
+
+static void AFXDPCloseSocket(AFXDPThreadVars *ptv)
+{
+    if (ptv->xsks_map_fd != -1) {
+        EBPFDeleteKey(ptv->xsks_map_fd, &ptv->queue_id);
+        ptv->xsks_map_fd = -1;
+    }
+    if (ptv->xsk) {
+        xsk_socket__delete(ptv->xsk);
+        ptv->xsk = NULL;
+    }
+    if (ptv->umem) {
+        xsk_umem__delete(ptv->umem);
+        ptv->umem = NULL;
+    }
+    if (ptv->umem_area) {
+        munmap(ptv->umem_area, ptv->umem_size);
+        ptv->umem_area = NULL;
+    }
+    if (ptv->fill_stash) {
+        SCFree(ptv->fill_stash);
+        ptv->fill_stash = NULL;
+    }
+}
+
+/**
+ * \brief Init function for ReceiveAFXDP.
+ *
+ * \param tv pointer to ThreadVars
+ * \param initdata pointer to the interface passed from the user
+ * \param data pointer gets populated with AFXDPThreadVars
+ */
+static TmEcode ReceiveAFXDPThreadInit(ThreadVars *tv, const void *initdata, void **data)
+{
+    SCEnter();
+    AFXDPIfaceConfig *aconf = (AFXDPIfaceConfig *)initdata;
+
+    if (initdata == NULL) {
+        SCLogError(SC_ERR_INVALID_ARGUMENT, "initdata == NULL");
+        SCReturnInt(TM_ECODE_FAILED);
+    }
+
+    AFXDPThreadVars *ptv = SCCalloc(1, sizeof(*ptv));
+    if (unlikely(ptv == NULL)) {
+        aconf->DerefFunc(aconf);
+        SCReturnInt(TM_ECODE_FAILED);
+    }
+
+    ptv->tv = tv;
+    strlcpy(ptv->iface, aconf->iface, sizeof(ptv->iface));
+    ptv->livedev = LiveGetDevice(ptv->iface);
+    if (ptv->livedev == NULL) {
+        SCLogError(SC_ERR_INVALID_VALUE, "Unable to find Live device");
+        goto error;
+    }
+
+    ptv->queue_id = SC_ATOMIC_ADD(aconf->queue_cnt, 1) - 1;
+    ptv->ring_size = aconf->ring_size;
+    ptv->frame_size = aconf->frame_size;
+    ptv->flags = aconf->flags;
+    ptv->promisc = aconf->promisc;
+    ptv->checksum_mode = aconf->checksum_mode;
+    ptv->fd = -1;
+    ptv->xsks_map_fd = -1;
+    ptv->v4_map_fd = -1;
+    ptv->v6_map_fd = -1;
+    ptv->nr_cpus = aconf->ebpf_t_config.cpus_count;
+
+    if (ptv->flags & AFXDP_XDPBYPASS) {
+        ptv->v4_map_fd = EBPFGetMapFDByName(ptv->iface, "flow_table_v4");
+        if (ptv->v4_map_fd == -1) {
+            SCLogError(SC_ERR_INVALID_VALUE, "Can't find eBPF map fd for '%s'",
+                       "flow_table_v4");
+        }
+        ptv->v6_map_fd = EBPFGetMapFDByName(ptv->iface, "flow_table_v6");
+        if (ptv->v6_map_fd  == -1) {
+            SCLogError(SC_ERR_INVALID_VALUE, "Can't find eBPF map fd for '%s'",
+                       "flow_table_v6");
+        }
+    }
+
+    if (aconf->bpf_filter) {
+        char errbuf[PCAP_ERRBUF_SIZE];
+        SCLogConfig("Using BPF '%s' on iface '%s'",
+                    aconf->bpf_filter, ptv->iface);
+        if (SCBPFCompile(default_packet_size,  /* snaplen_arg */
+                    LINKTYPE_ETHERNET,    /* linktype_arg */
+                    &ptv->bpf_prog,       /* program */
+                    aconf->bpf_filter,    /* const char *buf */
+                    1,                    /* optimize */
+                    PCAP_NETMASK_UNKNOWN, /* mask */
+                    errbuf,
+                    sizeof(errbuf)) == -1)
+        {
+            SCLogError(SC_ERR_AFXDP_CREATE, "Failed to compile BPF \"%s\": %s",
+                       aconf->bpf_filter, errbuf);
+            goto error;
+        }
+    }
+
+    if (AFXDPCreateSocket(ptv, aconf) != 0) {
+        goto error;
+    }
+
+    ptv->capture_kernel_packets = StatsRegisterCounter("capture.kernel_packets",
+            ptv->tv);
+    ptv->capture_kernel_drops = StatsRegisterCounter("capture.kernel_drops",
+            ptv->tv);
+    ptv->capture_kernel_bytes = StatsRegisterCounter("capture.kernel_bytes",
+            ptv->tv);
+
+    *data = (void *)ptv;
+    aconf->DerefFunc(aconf);
+    SCReturnInt(TM_ECODE_OK);
+
+error:
+    AFXDPCloseSocket(ptv);
+    if (ptv->bpf_prog.bf_insns) {
+        SCBPFFree(&ptv->bpf_prog);
+    }
+    SCFree(ptv);
+    aconf->DerefFunc(aconf);
+    SCReturnInt(TM_ECODE_FAILED);
+}
+
+/**
+ * \brief This function prints stats to the screen at exit.
+ * \param tv pointer to ThreadVars
+ * \param data pointer that gets cast into AFXDPThreadVars for ptv
+ */
+static void ReceiveAFXDPThreadExitStats(ThreadVars *tv, void *data)
+{
+    SCEnter();
+    AFXDPThreadVars *ptv = (AFXDPThreadVars *)data;
+
+    AFXDPDumpCounters(ptv);
+    SCLogPerf("(%s) Kernel: Packets %" PRIu64 ", dropped %" PRIu64 ", bytes %" PRIu64 "",
+              tv->name,
+              StatsGetLocalCounterValue(tv, ptv->capture_kernel_packets),
+              StatsGetLocalCounterValue(tv, ptv->capture_kernel_drops),
+              StatsGetLocalCounterValue(tv, ptv->capture_kernel_bytes));
+}
+
+/**
+ * \brief DeInit function closes AF_XDP socket at exit.
+ * \param tv pointer to ThreadVars
+ * \param data pointer that gets cast into AFXDPThreadVars for ptv
+ */
+static TmEcode ReceiveAFXDPThreadDeinit(ThreadVars *tv, void *data)
+{
+    AFXDPThreadVars *ptv = (AFXDPThreadVars *)data;
+
+    AFXDPCloseSocket(ptv);
+    if (ptv->bpf_prog.bf_insns) {
+        SCBPFFree(&ptv->bpf_prog);
+    }
+    SCFree(ptv);
+    SCReturnInt(TM_ECODE_OK);
+}
+
+/**
+ * \brief Prepare AF_XDP decode thread.
+ * \param tv Thread local avariables.
+ * \param initdata Thread config.
+ * \param data Pointer to DecodeThreadVars placed here.
+ */
+static TmEcode DecodeAFXDPThreadInit(ThreadVars *tv, const void *initdata, void **data)
+{
+    SCEnter();
+
+    DecodeThreadVars *dtv = DecodeThreadVarsAlloc(tv);
+    if (dtv == NULL)
+        SCReturnInt(TM_ECODE_FAILED);
+
+    DecodeRegisterPerfCounters(dtv, tv);
+
+    *data = (void *)dtv;
+
+    SCReturnInt(TM_ECODE_OK);
+}
+
+/**
+ * \brief This function passes off to link type decoders.
+ *
+ * \param tv pointer to ThreadVars
+ * \param p pointer to the current packet
+ * \param data pointer that gets cast into DecodeThreadVars for dtv
+ * \param pq pointer to the current PacketQueue
+ * \param postpq
+ */
+static TmEcode DecodeAFXDP(ThreadVars *tv, Packet *p, void *data, PacketQueue *pq, PacketQueue *postpq)
+{
+    SCEnter();
+
+    DecodeThreadVars *dtv = (DecodeThreadVars *)data;
+
+    /* XXX HACK: flow timeout can call us for injected pseudo packets
+     *           see bug: https://redmine.openinfosecfoundation.org/issues/1107 */
+    if (p->flags & PKT_PSEUDO_STREAM_END)
+        SCReturnInt(TM_ECODE_OK);
+
+    /* update counters */
+    DecodeUpdatePacketCounters(tv, dtv, p);
+
+    DecodeEthernet(tv, dtv, p, GET_PKT_DATA(p), GET_PKT_LEN(p), pq);
+
+    PacketDecodeFinalize(tv, dtv, p);
+
+    SCReturnInt(TM_ECODE_OK);
+}
+
+static TmEcode DecodeAFXDPThreadDeinit(ThreadVars *tv, void *data)
+{
+    if (data != NULL)
+        DecodeThreadVarsFree(tv, data);
+    SCReturnInt(TM_ECODE_OK);
+}
+
+/**
+ * \brief Registration Function for ReceiveAFXDP.
+ */
+void TmModuleReceiveAFXDPRegister(void)
+{
+    tmm_modules[TMM_RECEIVEAFXDP].name = "ReceiveAFXDP";
+    tmm_modules[TMM_RECEIVEAFXDP].ThreadInit = ReceiveAFXDPThreadInit;
+    tmm_modules[TMM_RECEIVEAFXDP].PktAcqLoop = ReceiveAFXDPLoop;
+    tmm_modules[TMM_RECEIVEAFXDP].ThreadExitPrintStats = ReceiveAFXDPThreadExitStats;
+    tmm_modules[TMM_RECEIVEAFXDP].ThreadDeinit = ReceiveAFXDPThreadDeinit;
+    tmm_modules[TMM_RECEIVEAFXDP].cap_flags = SC_CAP_NET_RAW | SC_CAP_NET_ADMIN;
+    tmm_modules[TMM_RECEIVEAFXDP].flags = TM_FLAG_RECEIVE_TM;
+}
+
+/**
+ * \brief Registration Function for DecodeAFXDP.
+ */
+void TmModuleDecodeAFXDPRegister(void)
+{
+    tmm_modules[TMM_DECODEAFXDP].name = "DecodeAFXDP";
+    tmm_modules[TMM_DECODEAFXDP].ThreadInit = DecodeAFXDPThreadInit;
+    tmm_modules[TMM_DECODEAFXDP].Func = DecodeAFXDP;
+    tmm_modules[TMM_DECODEAFXDP].ThreadDeinit = DecodeAFXDPThreadDeinit;
+    tmm_modules[TMM_DECODEAFXDP].cap_flags = 0;
+    tmm_modules[TMM_DECODEAFXDP].flags = TM_FLAG_DECODE_TM;
+}
+
+#endif /* HAVE_AF_XDP */
+
+/**
+ * @}
+ */
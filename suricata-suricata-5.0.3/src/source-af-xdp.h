@@ -0,0 +1,90 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * AF_XDP capture
+ */
+
+#ifndef __SOURCE_AF_XDP_H__
+#define __SOURCE_AF_XDP_H__
+
+#define AFXDP_IFACE_NAME_LENGTH 48
+
+/* value for flags */
+#define AFXDP_XDPBYPASS     (1<<0)
+#define AFXDP_XDP_FILTER    (1<<1)  /**< user XDP filter, sockets go in its xsks_map */
+
+/* bind modes */
+#define AFXDP_BIND_AUTO         0
+#define AFXDP_BIND_ZERO_COPY    1
+#define AFXDP_BIND_COPY         2
+
+#define AFXDP_FRAME_SIZE_DEFAULT    4096
+#define AFXDP_RING_SIZE_DEFAULT     2048
+
+typedef struct AFXDPIfaceConfig_
+{
+    char iface[AFXDP_IFACE_NAME_LENGTH];
+    /* number of threads, one per rx queue */
+    int threads;
+    /* next rx queue to hand out to a capture thread */
+    SC_ATOMIC_DECLARE(unsigned int, queue_cnt);
+    /* size of the rx and fill rings, in descriptors */
+    uint32_t ring_size;
+    /* size of an UMEM frame */
+    uint32_t frame_size;
+    int bind_mode;
+    int promisc;
+    int flags;
+    /* XDP attach flags (XDP_FLAGS_*) */
+    uint32_t xdp_mode;
+    const char *xdp_filter_file;
+    int xdp_filter_fd;
+    const char *bpf_filter;
+#ifdef HAVE_PACKET_EBPF
+    struct ebpf_timeout_config ebpf_t_config;
+#endif
+    ChecksumValidationMode checksum_mode;
+    SC_ATOMIC_DECLARE(unsigned int, ref);
+    void (*DerefFunc)(void *);
+} AFXDPIfaceConfig;
+
+/**
+ * \brief per packet AF_XDP vars
+ *
+ * The UMEM frame of the packet is handed back to the fill ring of
+ * the capture socket when the packet is released.
+ */
+typedef struct AFXDPPacketVars_
+{
+    /* AFXDPThreadVars, NULL once the frame has been given back */
+    void *ptv;
+    /* UMEM address of the frame */
+    uint64_t addr;
+#ifdef HAVE_PACKET_EBPF
+    int v4_map_fd;
+    int v6_map_fd;
+    unsigned int nr_cpus;
+#endif
+} AFXDPPacketVars;
+
+void TmModuleReceiveAFXDPRegister(void);
+void TmModuleDecodeAFXDPRegister(void);
+
+#endif /* __SOURCE_AF_XDP_H__ */
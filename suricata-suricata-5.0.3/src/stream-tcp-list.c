@@ -170,15 +170,6 @@ static int DoInsertSegment (TcpStream *stream, TcpSegment *seg, TcpSegment **dup
         return -1;
     }
 
-    /* fast track */
-    if (RB_EMPTY(&stream->seg_tree)) {
-        SCLogDebug("empty tree, inserting seg %p seq %" PRIu32 ", "
-                   "len %" PRIu32 "", seg, seg->seq, TCP_SEG_LEN(seg));
-        TCPSEG_RB_INSERT(&stream->seg_tree, seg);
-        stream->segs_right_edge = SEG_SEQ_RIGHT_EDGE(seg);
-        return 0;
-    }
-
     /* insert and then check if there was any overlap with other segments */
     TcpSegment *res = TCPSEG_RB_INSERT(&stream->seg_tree, seg);
     if (res) {
@@ -201,6 +192,45 @@ static int DoInsertSegment (TcpStream *stream, TcpSegment *seg, TcpSegment **dup
     return 0;
 }
 
+/** \internal
+ *  \brief append an in order segment to the tree
+ *
+ *  A segment that starts at the right edge of the right most segment
+ *  can't overlap any segment in the tree and sorts after all of them,
+ *  so it's linked in as the new tail without searching the tree or
+ *  checking for overlaps.
+ *
+ *  \retval true segment appended
+ *  \retval false segment needs a regular insert
+ */
+static inline bool DoAppendSegment(TcpStream *stream, TcpSegment *seg)
+{
+    if (SEQ_LEQ(SEG_SEQ_RIGHT_EDGE(seg), stream->base_seq))
+        return false;
+
+    if (RB_EMPTY(&stream->seg_tree)) {
+        SCLogDebug("empty tree, inserting seg %p seq %" PRIu32 ", "
+                   "len %" PRIu32 "", seg, seg->seq, TCP_SEG_LEN(seg));
+        TCPSEG_RB_INSERT(&stream->seg_tree, seg);
+        stream->segs_right_edge = SEG_SEQ_RIGHT_EDGE(seg);
+        return true;
+    }
+
+    /* segs_right_edge is never below the right edge of any segment in
+     * the tree, even after segments were removed */
+    if (!SEQ_EQ(seg->seq, stream->segs_right_edge))
+        return false;
+
+    TcpSegment *tail = RB_MAX(TCPSEG, &stream->seg_tree);
+    RB_SET(seg, tail, rb);
+    RB_RIGHT(tail, rb) = seg;
+    TCPSEG_RB_INSERT_COLOR(&stream->seg_tree, seg);
+    stream->segs_right_edge = SEG_SEQ_RIGHT_EDGE(seg);
+
+    SCLogDebug("seg %u: appended", seg->seq);
+    return true;
+}
+
 /** \internal
  *  \brief handle overlap per list segment
  *
@@ -561,10 +591,17 @@ int StreamTcpReassembleInsertSegment(ThreadVars *tv, TcpReassemblyThreadCtx *ra_
     SCEnter();
 
     TcpSegment *dup_seg = NULL;
+    int r;
 
     /* insert segment into list. Note: doesn't handle the data */
-    int r = DoInsertSegment (stream, seg, &dup_seg, p);
-    SCLogDebug("DoInsertSegment returned %d", r);
+    if (likely(DoAppendSegment(stream, seg))) {
+        StatsIncr(tv, ra_ctx->counter_tcp_reass_append);
+        r = 0;
+    } else {
+        StatsIncr(tv, ra_ctx->counter_tcp_reass_tree);
+        r = DoInsertSegment (stream, seg, &dup_seg, p);
+        SCLogDebug("DoInsertSegment returned %d", r);
+    }
     if (r < 0) {
         StatsIncr(tv, ra_ctx->counter_tcp_reass_list_fail);
         StreamTcpSegmentReturntoPool(seg);
@@ -66,15 +66,10 @@
 #include "util-profiling.h"
 #include "util-validate.h"
 
-#ifdef DEBUG
-static SCMutex segment_pool_memuse_mutex;
-static uint64_t segment_pool_memuse = 0;
-static uint64_t segment_pool_memcnt = 0;
-#endif
-
-static PoolThread *segment_thread_pool = NULL;
-/* init only, protect initializing and growing pool */
-static SCMutex segment_thread_pool_mutex = SCMUTEX_INITIALIZER;
+/* segments and streaming buffer memory */
+static Slab *ra_slab = NULL;
+/* slab cache of the reassembly thread ctx of this thread, if any */
+static __thread SlabCache *ra_slab_cache = NULL;
 
 /* Memory use counter */
 SC_ATOMIC_DECLARE(uint64_t, ra_memuse);
@@ -179,18 +174,26 @@ uint64_t StreamTcpReassembleGetMemcap()
 
 /* memory functions for the streaming buffer API */
 
+/** \brief account memory taken by the reassembly slab */
+static int ReassembleReserve(size_t size)
+{
+    if (StreamTcpReassembleCheckMemcap(size) == 0)
+        return 0;
+    StreamTcpReassembleIncrMemuse(size);
+    return 1;
+}
+
+static void ReassembleRelease(size_t size)
+{
+    StreamTcpReassembleDecrMemuse(size);
+}
+
 /*
     void *(*Malloc)(size_t size);
 */
 static void *ReassembleMalloc(size_t size)
 {
-    if (StreamTcpReassembleCheckMemcap(size) == 0)
-        return NULL;
-    void *ptr = SCMalloc(size);
-    if (ptr == NULL)
-        return NULL;
-    StreamTcpReassembleIncrMemuse(size);
-    return ptr;
+    return SlabAlloc(ra_slab, ra_slab_cache, size);
 }
 
 /*
@@ -198,12 +201,10 @@ static void *ReassembleMalloc(size_t size)
 */
 static void *ReassembleCalloc(size_t n, size_t size)
 {
-    if (StreamTcpReassembleCheckMemcap(n * size) == 0)
-        return NULL;
-    void *ptr = SCCalloc(n, size);
+    void *ptr = SlabAlloc(ra_slab, ra_slab_cache, n * size);
     if (ptr == NULL)
         return NULL;
-    StreamTcpReassembleIncrMemuse(n * size);
+    memset(ptr, 0, n * size);
     return ptr;
 }
 
@@ -212,20 +213,7 @@ static void *ReassembleCalloc(size_t n, size_t size)
 */
 static void *ReassembleRealloc(void *optr, size_t orig_size, size_t size)
 {
-    if (size > orig_size) {
-        if (StreamTcpReassembleCheckMemcap(size - orig_size) == 0)
-            return NULL;
-    }
-    void *nptr = SCRealloc(optr, size);
-    if (nptr == NULL)
-        return NULL;
-
-    if (size > orig_size) {
-        StreamTcpReassembleIncrMemuse(size - orig_size);
-    } else {
-        StreamTcpReassembleDecrMemuse(orig_size - size);
-    }
-    return nptr;
+    return SlabRealloc(ra_slab, ra_slab_cache, optr, orig_size, size);
 }
 
 /*
@@ -233,64 +221,7 @@ static void *ReassembleRealloc(void *optr, size_t orig_size, size_t size)
 */
 static void ReassembleFree(void *ptr, size_t size)
 {
-    SCFree(ptr);
-    StreamTcpReassembleDecrMemuse(size);
-}
-
-/** \brief alloc a tcp segment pool entry */
-static void *TcpSegmentPoolAlloc(void)
-{
-    if (StreamTcpReassembleCheckMemcap((uint32_t)sizeof(TcpSegment)) == 0) {
-        return NULL;
-    }
-
-    TcpSegment *seg = NULL;
-
-    seg = SCMalloc(sizeof (TcpSegment));
-    if (unlikely(seg == NULL))
-        return NULL;
-    return seg;
-}
-
-static int TcpSegmentPoolInit(void *data, void *initdata)
-{
-    TcpSegment *seg = (TcpSegment *) data;
-
-    /* do this before the can bail, so TcpSegmentPoolCleanup
-     * won't have uninitialized memory to consider. */
-    memset(seg, 0, sizeof (TcpSegment));
-
-    if (StreamTcpReassembleCheckMemcap((uint32_t)sizeof(TcpSegment)) == 0) {
-        return 0;
-    }
-
-#ifdef DEBUG
-    SCMutexLock(&segment_pool_memuse_mutex);
-    segment_pool_memuse += sizeof(TcpSegment);
-    segment_pool_memcnt++;
-    SCLogDebug("segment_pool_memcnt %"PRIu64"", segment_pool_memcnt);
-    SCMutexUnlock(&segment_pool_memuse_mutex);
-#endif
-
-    StreamTcpReassembleIncrMemuse((uint32_t)sizeof(TcpSegment));
-    return 1;
-}
-
-/** \brief clean up a tcp segment pool entry */
-static void TcpSegmentPoolCleanup(void *ptr)
-{
-    if (ptr == NULL)
-        return;
-
-    StreamTcpReassembleDecrMemuse((uint32_t)sizeof(TcpSegment));
-
-#ifdef DEBUG
-    SCMutexLock(&segment_pool_memuse_mutex);
-    segment_pool_memuse -= sizeof(TcpSegment);
-    segment_pool_memcnt--;
-    SCLogDebug("segment_pool_memcnt %"PRIu64"", segment_pool_memcnt);
-    SCMutexUnlock(&segment_pool_memuse_mutex);
-#endif
+    SlabFree(ra_slab_cache, ptr);
 }
 
 /**
@@ -303,7 +234,7 @@ void StreamTcpSegmentReturntoPool(TcpSegment *seg)
     if (seg == NULL)
         return;
 
-    PoolThreadReturn(segment_thread_pool, seg);
+    SlabFree(ra_slab_cache, seg);
 }
 
 /**
@@ -399,9 +330,18 @@ int StreamTcpReassembleInit(char quiet)
     if (StreamTcpReassemblyConfig(quiet) < 0)
         return -1;
 
-#ifdef DEBUG
-    SCMutexInit(&segment_pool_memuse_mutex, NULL);
-#endif
+    /* size classes: segments and buffer blocks, then the streaming buffer
+     * growing from its initial size up to a 64k window */
+    const uint32_t sizes[] = {
+        sizeof(TcpSegment), 128,
+        2048, 4096, 8192, 16384, 32768, 65536,
+    };
+    ra_slab = SlabInit(sizes, ARRAY_SIZE(sizes),
+            ReassembleReserve, ReassembleRelease);
+    if (ra_slab == NULL) {
+        SCLogError(SC_ERR_MEM_ALLOC, "failed to setup stream reassembly slab");
+        return -1;
+    }
     StatsRegisterGlobalCounter("tcp.reassembly_memuse",
             StreamTcpReassembleMemuseGlobalCounter);
     return 0;
@@ -409,21 +349,9 @@ int StreamTcpReassembleInit(char quiet)
 
 void StreamTcpReassembleFree(char quiet)
 {
-    SCMutexLock(&segment_thread_pool_mutex);
-    if (segment_thread_pool != NULL) {
-        PoolThreadFree(segment_thread_pool);
-        segment_thread_pool = NULL;
-    }
-    SCMutexUnlock(&segment_thread_pool_mutex);
-    SCMutexDestroy(&segment_thread_pool_mutex);
-
-#ifdef DEBUG
-    if (segment_pool_memuse > 0)
-        SCLogInfo("segment_pool_memuse %"PRIu64"", segment_pool_memuse);
-    if (segment_pool_memcnt > 0)
-        SCLogInfo("segment_pool_memcnt %"PRIu64"", segment_pool_memcnt);
-    SCMutexDestroy(&segment_pool_memuse_mutex);
-#endif
+    SlabDestroy(ra_slab);
+    ra_slab = NULL;
+    ra_slab_cache = NULL;
 }
 
 TcpReassemblyThreadCtx *StreamTcpReassembleInitThreadCtx(ThreadVars *tv)
@@ -437,32 +365,16 @@ TcpReassemblyThreadCtx *StreamTcpReassembleInitThreadCtx(ThreadVars *tv)
 
     ra_ctx->app_tctx = AppLayerGetCtxThread(tv);
 
-    SCMutexLock(&segment_thread_pool_mutex);
-    if (segment_thread_pool == NULL) {
-        segment_thread_pool = PoolThreadInit(1, /* thread */
-                0, /* unlimited */
-                stream_config.prealloc_segments,
-                sizeof(TcpSegment),
-                TcpSegmentPoolAlloc,
-                TcpSegmentPoolInit, NULL,
-                TcpSegmentPoolCleanup, NULL);
-        ra_ctx->segment_thread_pool_id = 0;
-        SCLogDebug("pool size %d, thread segment_thread_pool_id %d",
-                PoolThreadSize(segment_thread_pool),
-                ra_ctx->segment_thread_pool_id);
-    } else {
-        /* grow segment_thread_pool until we have a element for our thread id */
-        ra_ctx->segment_thread_pool_id = PoolThreadExpand(segment_thread_pool);
-        SCLogDebug("pool size %d, thread segment_thread_pool_id %d",
-                PoolThreadSize(segment_thread_pool),
-                ra_ctx->segment_thread_pool_id);
-    }
-    SCMutexUnlock(&segment_thread_pool_mutex);
-    if (ra_ctx->segment_thread_pool_id < 0 || segment_thread_pool == NULL) {
-        SCLogError(SC_ERR_MEM_ALLOC, "failed to setup/expand stream segment pool. Expand stream.reassembly.memcap?");
+    /* thread ctx setup runs in the thread that uses it */
+    ra_ctx->slab_cache = SlabCacheGet(ra_slab);
+    if (ra_ctx->slab_cache == NULL ||
+            SlabCacheReserve(ra_ctx->slab_cache, sizeof(TcpSegment),
+                stream_config.prealloc_segments) < 0) {
+        SCLogError(SC_ERR_MEM_ALLOC, "failed to setup stream segment slab");
         StreamTcpReassembleFreeThreadCtx(ra_ctx);
         SCReturnPtr(NULL, "TcpReassemblyThreadCtx");
     }
+    ra_slab_cache = ra_ctx->slab_cache;
 
     SCReturnPtr(ra_ctx, "TcpReassemblyThreadCtx");
 }
@@ -470,6 +382,11 @@ TcpReassemblyThreadCtx *StreamTcpReassembleInitThreadCtx(ThreadVars *tv)
 void StreamTcpReassembleFreeThreadCtx(TcpReassemblyThreadCtx *ra_ctx)
 {
     SCEnter();
+    if (ra_ctx->slab_cache != NULL) {
+        if (ra_slab_cache == ra_ctx->slab_cache)
+            ra_slab_cache = NULL;
+        SlabCacheRelease(ra_ctx->slab_cache);
+    }
     AppLayerDestroyCtxThread(ra_ctx->app_tctx);
     SCFree(ra_ctx);
     SCReturn;
@@ -1817,14 +1734,14 @@ int StreamTcpReassembleHandleSegment(ThreadVars *tv, TcpReassemblyThreadCtx *ra_
  */
 TcpSegment *StreamTcpGetSegment(ThreadVars *tv, TcpReassemblyThreadCtx *ra_ctx)
 {
-    TcpSegment *seg = (TcpSegment *) PoolThreadGetById(segment_thread_pool, ra_ctx->segment_thread_pool_id);
+    TcpSegment *seg = SlabAlloc(ra_slab, ra_ctx->slab_cache, sizeof(TcpSegment));
     SCLogDebug("seg we return is %p", seg);
     if (seg == NULL) {
         /* Increment the counter to show that we are not able to serve the
            segment request due to memcap limit */
         StatsIncr(tv, ra_ctx->counter_tcp_segment_memcap);
     } else {
-        memset(&seg->sbseg, 0, sizeof(seg->sbseg));
+        memset(seg, 0, sizeof(*seg));
     }
 
     return seg;
@@ -28,6 +28,7 @@
 #include "stream-tcp-private.h"
 #include "stream.h"
 #include "app-layer-detect-proto.h"
+#include "util-slab.h"
 #include "stream-tcp-private.h"
 
 /** Supported OS list and default OS policy is BSD */
@@ -60,7 +61,8 @@ enum StreamUpdateDir {
 typedef struct TcpReassemblyThreadCtx_ {
     void *app_tctx;
 
-    int segment_thread_pool_id;
+    /** per thread segment and streaming buffer memory */
+    SlabCache *slab_cache;
 
     /** TCP segments which are not being reassembled due to memcap was reached */
     uint16_t counter_tcp_segment_memcap;
@@ -77,6 +79,11 @@ typedef struct TcpReassemblyThreadCtx_ {
     uint16_t counter_tcp_reass_data_normal_fail;
     uint16_t counter_tcp_reass_data_overlap_fail;
     uint16_t counter_tcp_reass_list_fail;
+
+    /** segments appended in order, without a tree search */
+    uint16_t counter_tcp_reass_append;
+    /** segments inserted into the tree with overlap checks */
+    uint16_t counter_tcp_reass_tree;
 } TcpReassemblyThreadCtx;
 
 #define OS_POLICY_DEFAULT   OS_POLICY_BSD
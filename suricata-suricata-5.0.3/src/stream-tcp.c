@@ -5251,6 +5251,8 @@ TmEcode StreamTcpThreadInit(ThreadVars *tv, void *initdata, void **data)
     stt->ra_ctx->counter_tcp_reass_data_normal_fail = StatsRegisterCounter("tcp.insert_data_normal_fail", tv);
     stt->ra_ctx->counter_tcp_reass_data_overlap_fail = StatsRegisterCounter("tcp.insert_data_overlap_fail", tv);
     stt->ra_ctx->counter_tcp_reass_list_fail = StatsRegisterCounter("tcp.insert_list_fail", tv);
+    stt->ra_ctx->counter_tcp_reass_append = StatsRegisterCounter("tcp.insert_append", tv);
+    stt->ra_ctx->counter_tcp_reass_tree = StatsRegisterCounter("tcp.insert_tree", tv);
 
 
     SCLogDebug("StreamTcp thread specific ctx online at %p, reassembly ctx %p",
@@ -6245,6 +6247,52 @@ int StreamTcpInlineMode(void)
     return (stream_config.flags & STREAMTCP_INIT_FLAG_INLINE) ? 1 : 0;
 }
 
+/** \brief get the name of a tcp session state
+ *  \retval name or NULL for an unknown state */
+const char *StreamTcpStateAsString(const uint8_t state)
+{
+    const char *tcp_state = NULL;
+    switch (state) {
+        case TCP_NONE:
+            tcp_state = "none";
+            break;
+        case TCP_LISTEN:
+            tcp_state = "listen";
+            break;
+        case TCP_SYN_SENT:
+            tcp_state = "syn_sent";
+            break;
+        case TCP_SYN_RECV:
+            tcp_state = "syn_recv";
+            break;
+        case TCP_ESTABLISHED:
+            tcp_state = "established";
+            break;
+        case TCP_FIN_WAIT1:
+            tcp_state = "fin_wait1";
+            break;
+        case TCP_FIN_WAIT2:
+            tcp_state = "fin_wait2";
+            break;
+        case TCP_TIME_WAIT:
+            tcp_state = "time_wait";
+            break;
+        case TCP_LAST_ACK:
+            tcp_state = "last_ack";
+            break;
+        case TCP_CLOSE_WAIT:
+            tcp_state = "close_wait";
+            break;
+        case TCP_CLOSING:
+            tcp_state = "closing";
+            break;
+        case TCP_CLOSED:
+            tcp_state = "closed";
+            break;
+    }
+    return tcp_state;
+}
+
 
 void TcpSessionSetReassemblyDepth(TcpSession *ssn, uint32_t size)
 {
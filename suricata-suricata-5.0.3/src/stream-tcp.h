@@ -190,6 +190,7 @@ void StreamTcpStreamCleanup(TcpStream *stream);
 int StreamTcpBypassEnabled(void);
 int StreamTcpInlineDropInvalid(void);
 int StreamTcpInlineMode(void);
+const char *StreamTcpStateAsString(const uint8_t state);
 
 int TcpSessionPacketSsnReuse(const Packet *p, const Flow *f, const void *tcp_ssn);
 
@@ -456,6 +456,7 @@ typedef enum {
     LOGGER_TCP_DATA,
     LOGGER_JSON_FLOW,
     LOGGER_JSON_NETFLOW,
+    LOGGER_FLOW_COLUMNAR,
     LOGGER_STATS,
     LOGGER_JSON_STATS,
     LOGGER_PRELUDE,
@@ -708,6 +708,37 @@ static int StreamTcpReassembleTest32(void)
     OVERLAP_END;
 }
 
+/** \test in order segments are appended, also across a SEQ wrap, and
+ *        the tree stays sorted */
+static int StreamTcpReassembleTest33(void)
+{
+    OVERLAP_START(UINT_MAX - 5, OS_POLICY_BSD);
+    OVERLAP_STEP(1, "AAAA", 4, "AAAA", 4);
+    OVERLAP_STEP(5, "BBBB", 4, "AAAABBBB", 8);
+    OVERLAP_STEP(9, "CCCC", 4, "AAAABBBBCCCC", 12);
+    OVERLAP_STEP(13, "DDDD", 4, "AAAABBBBCCCCDDDD", 16);
+    /* gap, then in order again after the gap */
+    OVERLAP_STEP(21, "FFFF", 4, "AAAABBBBCCCCDDDD\0\0\0\0FFFF", 24);
+    OVERLAP_STEP(25, "GGGG", 4, "AAAABBBBCCCCDDDD\0\0\0\0FFFFGGGG", 28);
+    /* fill the gap */
+    OVERLAP_STEP(17, "EEEE", 4, "AAAABBBBCCCCDDDDEEEEFFFFGGGG", 28);
+    /* retransmission of the tail is not appended, BSD keeps the old data */
+    OVERLAP_STEP(25, "XXXX", 4, "AAAABBBBCCCCDDDDEEEEFFFFGGGG", 28);
+
+    uint32_t seq = stream->isn + 1;
+    int cnt = 0;
+    TcpSegment *seg;
+    RB_FOREACH(seg, TCPSEG, &stream->seg_tree) {
+        FAIL_IF_NOT(seg->seq == seq);
+        seq += TCP_SEG_LEN(seg);
+        cnt++;
+    }
+    FAIL_IF_NOT(cnt == 7);
+    FAIL_IF_NOT(stream->segs_right_edge == seq);
+
+    OVERLAP_END;
+}
+
 void StreamTcpListRegisterTests(void)
 {
     UtRegisterTest("StreamTcpReassembleTest01 -- BSD policy",
@@ -729,5 +760,7 @@ void StreamTcpListRegisterTests(void)
             StreamTcpReassembleTest31);
     UtRegisterTest("StreamTcpReassembleTest32",
             StreamTcpReassembleTest32);
+    UtRegisterTest("StreamTcpReassembleTest33",
+            StreamTcpReassembleTest33);
 
 }
@@ -136,6 +136,8 @@ enum {
 #define SCCondSignal pthread_cond_signal
 #define SCCondDestroy pthread_cond_destroy
 #define SCCondWait(cond, mut) pthread_cond_wait(cond, mut)
+#define SCCondTimedwait(cond, mut, time) pthread_cond_timedwait(cond, mut, time)
+#define SCCondBroadcast pthread_cond_broadcast
 
 /* ctrl mutex */
 #define SCCtrlMutex pthread_mutex_t
@@ -51,6 +51,11 @@ typedef struct TmModule_ {
     /** the packet processing function */
     TmEcode (*Func)(ThreadVars *, Packet *, void *, PacketQueue *, PacketQueue *);
 
+    /** optional: when packets are processed in batches, called for a
+     *  packet a few packets before Func gets it, to prefetch the memory
+     *  Func will need */
+    void (*Prefetch)(ThreadVars *, Packet *, void *);
+
     TmEcode (*PktAcqLoop)(ThreadVars *, void *, void *);
 
     /** terminates the capture loop in PktAcqLoop */
@@ -177,6 +177,133 @@ TmEcode TmThreadsSlotVarRun(ThreadVars *tv, Packet *p,
     return TM_ECODE_OK;
 }
 
+/** how many packets ahead of the one being processed the slot's
+ *  Prefetch callback is called in batch mode */
+#define TM_PKT_PREFETCH_DISTANCE 4
+
+/** \internal
+ *  \brief return the packets of a failed batch to the pool
+ */
+static void TmThreadsSlotReleaseBatch(ThreadVars *tv, TmSlot *s,
+        Packet **pkts, uint32_t cnt)
+{
+    for (uint32_t i = 0; i < cnt; i++) {
+        TmqhOutputPacketpool(tv, pkts[i]);
+    }
+
+    TmqhReleasePacketsToPacketPool(&s->slot_pre_pq);
+    for (TmSlot *slot = s; slot != NULL; slot = slot->slot_next) {
+        SCMutexLock(&slot->slot_post_pq.mutex_q);
+        TmqhReleasePacketsToPacketPool(&slot->slot_post_pq);
+        SCMutexUnlock(&slot->slot_post_pq.mutex_q);
+    }
+    TmThreadsSetFlag(tv, THV_FAILED);
+}
+
+/**
+ * \brief Run a vector of packets through the slots.
+ *
+ * Each slot processes the whole vector before the next slot gets it, so
+ * the code and data of one module stay hot for the batch. The order in
+ * which a slot sees the packets is the one of TmThreadsSlotVarRun: the
+ * packets a slot adds to its pre_pq (tunnel packets) are inserted in
+ * the vector right before their parent for the following slots.
+ *
+ * \param tv thread vars
+ * \param s first slot to run
+ * \param pkts packets, at most TM_PKT_BATCH_MAX
+ * \param cnt number of packets in pkts
+ *
+ * \retval TM_ECODE_OK packets were processed and handed to tmqh_out
+ * \retval TM_ECODE_FAILED a slot failed, all packets of the batch have
+ *         been returned to the pool
+ */
+TmEcode TmThreadsSlotProcessPktBatch(ThreadVars *tv, TmSlot *s,
+        Packet **pkts, uint32_t cnt)
+{
+    /* room for the tunnel packets created along the way. If there are
+     * more, they go through the rest of the slots immediately. */
+    Packet *vec[2][TM_PKT_BATCH_MAX * 2];
+    const uint32_t vec_size = TM_PKT_BATCH_MAX * 2;
+
+    BUG_ON(cnt > TM_PKT_BATCH_MAX);
+
+    if (s == NULL) {
+        for (uint32_t i = 0; i < cnt; i++) {
+            tv->tmqh_out(tv, pkts[i]);
+        }
+        return TM_ECODE_OK;
+    }
+
+    Packet **in = vec[0];
+    uint32_t in_cnt = cnt;
+    memcpy(in, pkts, cnt * sizeof(Packet *));
+
+    for (TmSlot *slot = s; slot != NULL; slot = slot->slot_next) {
+        TmSlotFunc SlotFunc = SC_ATOMIC_GET(slot->SlotFunc);
+        void *slot_data = SC_ATOMIC_GET(slot->slot_data);
+        PacketQueue *post_pq = (slot->id == 0) ? &slot->slot_post_pq : NULL;
+        Packet **out = (in == vec[0]) ? vec[1] : vec[0];
+        uint32_t out_cnt = 0;
+
+        if (slot->SlotPrefetch != NULL) {
+            for (uint32_t i = 0; i < in_cnt && i < TM_PKT_PREFETCH_DISTANCE; i++) {
+                slot->SlotPrefetch(tv, in[i], slot_data);
+            }
+        }
+
+        for (uint32_t i = 0; i < in_cnt; i++) {
+            Packet *p = in[i];
+
+            if (slot->SlotPrefetch != NULL && i + TM_PKT_PREFETCH_DISTANCE < in_cnt) {
+                slot->SlotPrefetch(tv, in[i + TM_PKT_PREFETCH_DISTANCE], slot_data);
+            }
+
+            PACKET_PROFILING_TMM_START(p, slot->tm_id);
+            TmEcode r = SlotFunc(tv, p, slot_data, &slot->slot_pre_pq, post_pq);
+            PACKET_PROFILING_TMM_END(p, slot->tm_id);
+
+            if (unlikely(r == TM_ECODE_FAILED)) {
+                TmThreadsSlotReleaseBatch(tv, slot, out, out_cnt);
+                TmThreadsSlotReleaseBatch(tv, slot, in + i, in_cnt - i);
+                return TM_ECODE_FAILED;
+            }
+
+            while (slot->slot_pre_pq.top != NULL) {
+                Packet *extra_p = PacketDequeue(&slot->slot_pre_pq);
+                if (unlikely(extra_p == NULL))
+                    continue;
+
+                if (slot->slot_next == NULL) {
+                    tv->tmqh_out(tv, extra_p);
+                /* keep a spot for each remaining packet of this slot */
+                } else if (out_cnt + (in_cnt - i) < vec_size) {
+                    out[out_cnt++] = extra_p;
+                } else {
+                    r = TmThreadsSlotVarRun(tv, extra_p, slot->slot_next);
+                    if (unlikely(r == TM_ECODE_FAILED)) {
+                        TmqhOutputPacketpool(tv, extra_p);
+                        TmThreadsSlotReleaseBatch(tv, slot, out, out_cnt);
+                        TmThreadsSlotReleaseBatch(tv, slot, in + i, in_cnt - i);
+                        return TM_ECODE_FAILED;
+                    }
+                    tv->tmqh_out(tv, extra_p);
+                }
+            }
+            out[out_cnt++] = p;
+        }
+
+        in = out;
+        in_cnt = out_cnt;
+    }
+
+    for (uint32_t i = 0; i < in_cnt; i++) {
+        tv->tmqh_out(tv, in[i]);
+    }
+
+    return TmThreadsSlotHandlePostPQs(tv, s);
+}
+
 /** \internal
  *  \brief check 'slot' pre_pq and post_pq at thread cleanup
  *         and dump detailed info about the state of the packets
@@ -847,6 +974,7 @@ void TmSlotSetFuncAppend(ThreadVars *tv, TmModule *tm, const void *data)
     SC_ATOMIC_INIT(slot->SlotFunc);
     (void)SC_ATOMIC_SET(slot->SlotFunc, tm->Func);
     slot->PktAcqLoop = tm->PktAcqLoop;
+    slot->SlotPrefetch = tm->Prefetch;
     slot->Management = tm->Management;
     slot->SlotThreadExitPrintStats = tm->ThreadExitPrintStats;
     slot->SlotThreadDeinit = tm->ThreadDeinit;
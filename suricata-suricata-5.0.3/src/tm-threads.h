@@ -47,6 +47,11 @@ static inline void SleepUsec(uint64_t usec)
 #define TM_QUEUE_NAME_MAX 16
 #define TM_THREAD_NAME_MAX 16
 
+/** max number of packets a capture thread hands to
+ *  TmThreadsSlotProcessPktBatch at once */
+#define TM_PKT_BATCH_MAX 64
+#define TM_PKT_BATCH_DEFAULT 32
+
 typedef TmEcode (*TmSlotFunc)(ThreadVars *, Packet *, void *, PacketQueue *,
                         PacketQueue *);
 
@@ -59,6 +64,8 @@ typedef struct TmSlot_ {
 
     TmEcode (*PktAcqLoop)(ThreadVars *, void *, void *);
 
+    void (*SlotPrefetch)(ThreadVars *, Packet *, void *);
+
     TmEcode (*SlotThreadInit)(ThreadVars *, const void *, void **);
     void (*SlotThreadExitPrintStats)(ThreadVars *, void *);
     TmEcode (*SlotThreadDeinit)(ThreadVars *, void *);
@@ -140,6 +147,8 @@ void TmThreadsUnsetFlag(ThreadVars *, uint16_t);
 void TmThreadWaitForFlag(ThreadVars *, uint16_t);
 
 TmEcode TmThreadsSlotVarRun (ThreadVars *tv, Packet *p, TmSlot *slot);
+TmEcode TmThreadsSlotProcessPktBatch(ThreadVars *tv, TmSlot *s,
+        Packet **pkts, uint32_t cnt);
 
 ThreadVars *TmThreadsGetTVContainingSlot(TmSlot *);
 void TmThreadDisablePacketThreads(void);
@@ -160,6 +160,48 @@ void PacketPoolWait(void)
         cc_barrier();
 }
 
+/** \brief Check if we have at least N packets in the pool, without waiting
+ *
+ *  For threads that would have to wait on their own packets being
+ *  returned, e.g. a worker doing flow timeout work for its own flows.
+ *
+ *  \param n number of packets needed
+ *
+ *  \retval true if at least n packets are available
+ */
+bool PacketPoolHasN(int n)
+{
+    PktPool *my_pool = GetThreadPacketPool();
+    Packet *p, *pp;
+
+    for (int tries = 0; tries < 2; tries++) {
+        int i = 0;
+        pp = p = my_pool->head;
+        while (p != NULL) {
+            if (++i == n)
+                return true;
+
+            pp = p;
+            p = p->next;
+        }
+
+        if (my_pool->return_stack.head == NULL)
+            break;
+
+        /* move the return stack to our local stack and count again */
+        SCMutexLock(&my_pool->return_stack.mutex);
+        if (pp) {
+            pp->next = my_pool->return_stack.head;
+        } else {
+            my_pool->head = my_pool->return_stack.head;
+        }
+        my_pool->return_stack.head = NULL;
+        SC_ATOMIC_RESET(my_pool->return_stack.sync_now);
+        SCMutexUnlock(&my_pool->return_stack.mutex);
+    }
+    return false;
+}
+
 /** \brief Wait until we have the requested amount of packets in the pool
  *
  *  In some cases waiting for packets is undesirable. Especially when
@@ -366,6 +366,9 @@ const char * SCErrorToString(SCError err)
         CASE_CODE (SC_ERR_DATASET);
         CASE_CODE (SC_WARN_ANOMALY_CONFIG);
         CASE_CODE (SC_WARN_ALERT_CONFIG);
+        CASE_CODE (SC_ERR_NO_AF_XDP);
+        CASE_CODE (SC_ERR_AFXDP_CREATE);
+        CASE_CODE (SC_ERR_AFXDP_READ);
 
         CASE_CODE (SC_ERR_MAX);
     }
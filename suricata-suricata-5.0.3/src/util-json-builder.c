@@ -0,0 +1,577 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Append only JSON writer.
+ *
+ * The builder writes each member into the MemBuffer as soon as it is set.
+ * The buffer is only grown when it is full, so with the per thread buffers
+ * of the loggers a record is built without allocations once the buffer
+ * has reached its working size.
+ *
+ * Strings are escaped the way jansson does with the default EVE flags.
+ * Strings that are not valid UTF-8 are logged like SCJsonString() does,
+ * with the non printable bytes as \\xNN.
+ */
+
+#include "suricata-common.h"
+#include "util-buffer.h"
+#include "util-json-builder.h"
+#include "util-unittest.h"
+#include "util-validate.h"
+
+/** level is an array, not an object */
+#define JB_LEVEL_ARRAY      BIT_U8(0)
+/** level has a member, next one needs a ',' */
+#define JB_LEVEL_MEMBERS    BIT_U8(1)
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+/**
+ *  \brief make room for len more bytes plus the terminating NUL
+ *
+ *  \retval true room is available
+ */
+static bool JBReserve(JsonBuilder *jb, size_t len)
+{
+    MemBuffer *mb = *jb->buffer;
+    if (unlikely(jb->error))
+        return false;
+    if (likely((size_t)mb->offset + len < mb->size))
+        return true;
+
+    /* grow by at least the current size to keep expansions rare */
+    size_t need = (size_t)mb->offset + len + 1 - mb->size;
+    size_t expand_by = MAX(need, (size_t)mb->size);
+    if (expand_by > UINT32_MAX || MemBufferExpand(jb->buffer, expand_by) != 0) {
+        if (need > UINT32_MAX || MemBufferExpand(jb->buffer, need) != 0) {
+            jb->error = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline void JBWriteRaw(JsonBuilder *jb, const char *data, size_t len)
+{
+    if (!JBReserve(jb, len))
+        return;
+    MemBuffer *mb = *jb->buffer;
+    memcpy(mb->buffer + mb->offset, data, len);
+    mb->offset += len;
+    mb->buffer[mb->offset] = '\0';
+}
+
+static inline void JBWriteChar(JsonBuilder *jb, char c)
+{
+    if (!JBReserve(jb, 1))
+        return;
+    MemBuffer *mb = *jb->buffer;
+    mb->buffer[mb->offset++] = c;
+    mb->buffer[mb->offset] = '\0';
+}
+
+/**
+ *  \brief decode one UTF-8 sequence
+ *
+ *  Rejects overlong forms, surrogates and values above U+10FFFF like
+ *  jansson does.
+ *
+ *  \retval len length of the sequence, 0 if it is invalid
+ */
+static int JBUtf8Decode(const uint8_t *s, size_t len, uint32_t *cp)
+{
+    uint32_t c = s[0];
+    int n;
+    uint32_t min;
+
+    if (c < 0x80) {
+        *cp = c;
+        return 1;
+    } else if (c >= 0xc2 && c <= 0xdf) {
+        n = 2;
+        c &= 0x1f;
+        min = 0x80;
+    } else if (c >= 0xe0 && c <= 0xef) {
+        n = 3;
+        c &= 0x0f;
+        min = 0x800;
+    } else if (c >= 0xf0 && c <= 0xf4) {
+        n = 4;
+        c &= 0x07;
+        min = 0x10000;
+    } else {
+        return 0;
+    }
+    if ((size_t)n > len)
+        return 0;
+
+    for (int i = 1; i < n; i++) {
+        if ((s[i] & 0xc0) != 0x80)
+            return 0;
+        c = (c << 6) | (s[i] & 0x3f);
+    }
+    if (c < min || c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff))
+        return 0;
+
+    *cp = c;
+    return n;
+}
+
+static bool JBUtf8Valid(const uint8_t *s, size_t len)
+{
+    size_t i = 0;
+    while (i < len) {
+        if (s[i] < 0x80) {
+            i++;
+            continue;
+        }
+        uint32_t cp;
+        int n = JBUtf8Decode(s + i, len - i, &cp);
+        if (n == 0)
+            return false;
+        i += n;
+    }
+    return true;
+}
+
+static void JBWriteEscapedU16(JsonBuilder *jb, uint32_t u)
+{
+    char seq[6] = { '\\', 'u',
+        hex_digits[(u >> 12) & 0xf], hex_digits[(u >> 8) & 0xf],
+        hex_digits[(u >> 4) & 0xf], hex_digits[u & 0xf] };
+    JBWriteRaw(jb, seq, sizeof(seq));
+}
+
+/** \brief write the escape sequence for a codepoint that can't be
+ *         written as is */
+static void JBWriteEscaped(JsonBuilder *jb, uint32_t cp)
+{
+    switch (cp) {
+        case '\\': JBWriteRaw(jb, "\\\\", 2); break;
+        case '"':  JBWriteRaw(jb, "\\\"", 2); break;
+        case '\b': JBWriteRaw(jb, "\\b", 2); break;
+        case '\f': JBWriteRaw(jb, "\\f", 2); break;
+        case '\n': JBWriteRaw(jb, "\\n", 2); break;
+        case '\r': JBWriteRaw(jb, "\\r", 2); break;
+        case '\t': JBWriteRaw(jb, "\\t", 2); break;
+        case '/':  JBWriteRaw(jb, "\\/", 2); break;
+        default:
+            if (cp < 0x10000) {
+                JBWriteEscapedU16(jb, cp);
+            } else {
+                cp -= 0x10000;
+                JBWriteEscapedU16(jb, 0xd800 | ((cp >> 10) & 0x3ff));
+                JBWriteEscapedU16(jb, 0xdc00 | (cp & 0x3ff));
+            }
+            break;
+    }
+}
+
+static inline bool JBNeedsEscape(const JsonBuilder *jb, uint8_t c,
+        const bool valid)
+{
+    return (c < 0x20 || c == '"' || c == '\\' ||
+            (c == '/' && (jb->flags & JSON_ESCAPE_SLASH)) ||
+            (c >= 0x7f && !valid) ||
+            (c >= 0x80 && (jb->flags & JSON_ENSURE_ASCII)));
+}
+
+/**
+ *  \brief write a quoted string
+ *
+ *  Runs of bytes that need no escaping are copied in one go.
+ */
+static void JBWriteString(JsonBuilder *jb, const char *str, size_t len)
+{
+    const uint8_t *s = (const uint8_t *)str;
+    const bool valid = JBUtf8Valid(s, len);
+
+    JBWriteChar(jb, '"');
+
+    size_t i = 0;
+    while (i < len) {
+        size_t run = i;
+        while (run < len && !JBNeedsEscape(jb, s[run], valid))
+            run++;
+        if (run > i) {
+            JBWriteRaw(jb, (const char *)s + i, run - i);
+            i = run;
+            if (i == len)
+                break;
+        }
+
+        if (valid && s[i] >= 0x80) {
+            /* only reached with JSON_ENSURE_ASCII */
+            uint32_t cp = 0;
+            int n = JBUtf8Decode(s + i, len - i, &cp);
+            JBWriteEscaped(jb, cp);
+            i += n;
+        } else if (valid || isprint(s[i])) {
+            JBWriteEscaped(jb, s[i]);
+            i++;
+        } else {
+            char seq[5] = { '\\', '\\', 'x',
+                hex_digits[s[i] >> 4], hex_digits[s[i] & 0xf] };
+            JBWriteRaw(jb, seq, sizeof(seq));
+            i++;
+        }
+    }
+
+    JBWriteChar(jb, '"');
+}
+
+/**
+ *  \brief write the separator and key in front of a new member
+ *
+ *  \retval true member can be written
+ */
+static bool JBStartMember(JsonBuilder *jb, const char *key)
+{
+    if (unlikely(jb->error))
+        return false;
+
+    if (jb->depth == 0) {
+        /* only a single root value */
+        if (unlikely(key != NULL || (jb->level[0] & JB_LEVEL_MEMBERS))) {
+            DEBUG_VALIDATE_BUG_ON(1);
+            jb->error = true;
+            return false;
+        }
+        jb->level[0] |= JB_LEVEL_MEMBERS;
+        return true;
+    }
+
+    uint8_t *level = &jb->level[jb->depth];
+    const bool is_array = (*level & JB_LEVEL_ARRAY) != 0;
+    if (unlikely(is_array != (key == NULL))) {
+        DEBUG_VALIDATE_BUG_ON(1);
+        jb->error = true;
+        return false;
+    }
+
+    if (*level & JB_LEVEL_MEMBERS)
+        JBWriteChar(jb, ',');
+    *level |= JB_LEVEL_MEMBERS;
+
+    if (key != NULL) {
+        JBWriteString(jb, key, strlen(key));
+        JBWriteChar(jb, ':');
+    }
+    return !jb->error;
+}
+
+static void JBOpen(JsonBuilder *jb, const char *key, const bool array)
+{
+    if (!JBStartMember(jb, key))
+        return;
+    if (unlikely(jb->depth == JSON_BUILDER_MAX_DEPTH)) {
+        jb->error = true;
+        return;
+    }
+    JBWriteChar(jb, array ? '[' : '{');
+    jb->depth++;
+    jb->level[jb->depth] = array ? JB_LEVEL_ARRAY : 0;
+}
+
+/**
+ *  \brief set up a builder writing to the end of a buffer
+ *
+ *  \param buffer buffer to write to, it's reallocated when it runs full
+ *  \param flags jansson dump flags of the output
+ */
+void JsonBuilderInit(JsonBuilder *jb, MemBuffer **buffer, uint32_t flags)
+{
+    jb->buffer = buffer;
+    jb->start = MEMBUFFER_OFFSET(*buffer);
+    jb->flags = flags & (JSON_ENSURE_ASCII|JSON_ESCAPE_SLASH);
+    jb->depth = 0;
+    jb->error = false;
+    jb->level[0] = 0;
+}
+
+/** \brief open an object, key is NULL for the root or an array member */
+void JsonBuilderOpenObject(JsonBuilder *jb, const char *key)
+{
+    JBOpen(jb, key, false);
+}
+
+/** \brief open an array, key is NULL for the root or an array member */
+void JsonBuilderOpenArray(JsonBuilder *jb, const char *key)
+{
+    JBOpen(jb, key, true);
+}
+
+/** \brief close the innermost open object or array */
+void JsonBuilderClose(JsonBuilder *jb)
+{
+    if (unlikely(jb->error))
+        return;
+    if (unlikely(jb->depth == 0)) {
+        DEBUG_VALIDATE_BUG_ON(1);
+        jb->error = true;
+        return;
+    }
+    JBWriteChar(jb, (jb->level[jb->depth] & JB_LEVEL_ARRAY) ? ']' : '}');
+    jb->depth--;
+}
+
+/** \brief check if nothing was added to the innermost open object or array */
+bool JsonBuilderIsEmpty(const JsonBuilder *jb)
+{
+    return (jb->level[jb->depth] & JB_LEVEL_MEMBERS) == 0;
+}
+
+/** \brief set a string, nothing is added if val is NULL */
+void JsonBuilderSetString(JsonBuilder *jb, const char *key, const char *val)
+{
+    if (val == NULL)
+        return;
+    if (!JBStartMember(jb, key))
+        return;
+    JBWriteString(jb, val, strlen(val));
+}
+
+/**
+ *  \brief set a string from a buffer that isn't NUL terminated
+ *
+ *  Like JsonAddStringN() the string ends at the first NUL byte.
+ */
+void JsonBuilderSetStringN(JsonBuilder *jb, const char *key,
+        const char *val, size_t len)
+{
+    if (!JBStartMember(jb, key))
+        return;
+    const char *nul = memchr(val, '\0', len);
+    if (nul != NULL)
+        len = nul - val;
+    JBWriteString(jb, val, len);
+}
+
+static void JBWriteUint(JsonBuilder *jb, uint64_t val, bool negative)
+{
+    char buf[21];
+    size_t i = sizeof(buf);
+    do {
+        buf[--i] = '0' + (val % 10);
+        val /= 10;
+    } while (val);
+    if (negative)
+        buf[--i] = '-';
+    JBWriteRaw(jb, buf + i, sizeof(buf) - i);
+}
+
+void JsonBuilderSetUint(JsonBuilder *jb, const char *key, uint64_t val)
+{
+    if (!JBStartMember(jb, key))
+        return;
+    JBWriteUint(jb, val, false);
+}
+
+void JsonBuilderSetInt(JsonBuilder *jb, const char *key, int64_t val)
+{
+    if (!JBStartMember(jb, key))
+        return;
+    if (val < 0) {
+        JBWriteUint(jb, (uint64_t)0 - (uint64_t)val, true);
+    } else {
+        JBWriteUint(jb, (uint64_t)val, false);
+    }
+}
+
+void JsonBuilderSetBool(JsonBuilder *jb, const char *key, bool val)
+{
+    if (!JBStartMember(jb, key))
+        return;
+    if (val) {
+        JBWriteRaw(jb, "true", 4);
+    } else {
+        JBWriteRaw(jb, "false", 5);
+    }
+}
+
+static int JBDumpCallback(const char *str, size_t size, void *data)
+{
+    JsonBuilder *jb = data;
+    JBWriteRaw(jb, str, size);
+    return jb->error ? -1 : 0;
+}
+
+/**
+ *  \brief set a value from a jansson object
+ *
+ *  For the parts of a record that are still built as jansson objects,
+ *  e.g. by the Rust app layer loggers. Nothing is added if val is NULL.
+ */
+void JsonBuilderSetJson(JsonBuilder *jb, const char *key, const json_t *val)
+{
+    if (val == NULL)
+        return;
+    if (!JBStartMember(jb, key))
+        return;
+    if (json_dump_callback(val, JBDumpCallback, jb,
+                JSON_BUILDER_NATIVE_FLAGS|JSON_ENCODE_ANY|jb->flags) != 0) {
+        jb->error = true;
+    }
+}
+
+void JsonBuilderGetMark(const JsonBuilder *jb, JsonBuilderMark *mark)
+{
+    mark->offset = MEMBUFFER_OFFSET(*jb->buffer);
+    mark->depth = jb->depth;
+    mark->level = jb->level[jb->depth];
+}
+
+/** \brief drop everything written after the mark was taken */
+void JsonBuilderRestoreMark(JsonBuilder *jb, const JsonBuilderMark *mark)
+{
+    if (unlikely(jb->error))
+        return;
+    MemBuffer *mb = *jb->buffer;
+    mb->offset = mark->offset;
+    mb->buffer[mb->offset] = '\0';
+    jb->depth = mark->depth;
+    jb->level[jb->depth] = mark->level;
+}
+
+/**
+ *  \brief parse the output of a complete builder into a jansson object
+ *
+ *  For callers that still need the jansson API.
+ */
+json_t *JsonBuilderToJson(const JsonBuilder *jb)
+{
+    if (jb->error || jb->depth != 0)
+        return NULL;
+    const MemBuffer *mb = *jb->buffer;
+    return json_loadb((const char *)mb->buffer + jb->start,
+            mb->offset - jb->start, 0, NULL);
+}
+
+/**
+ * UNITTESTS
+ */
+
+#ifdef UNITTESTS
+
+#define JB_TEST_OUTPUT(jb, str)                                         \
+    (strcmp((const char *)MEMBUFFER_BUFFER(*(jb)->buffer) + (jb)->start, \
+            (str)) == 0)
+
+static int JsonBuilderTest01(void)
+{
+    MemBuffer *mb = MemBufferCreateNew(4);
+    FAIL_IF_NULL(mb);
+
+    JsonBuilder jb;
+    JsonBuilderInit(&jb, &mb, JSON_ENSURE_ASCII|JSON_ESCAPE_SLASH);
+    JsonBuilderOpenObject(&jb, NULL);
+    JsonBuilderSetString(&jb, "event_type", "alert");
+    JsonBuilderSetUint(&jb, "flow_id", UINT64_C(1234567890123));
+    JsonBuilderSetInt(&jb, "age", -3);
+    JsonBuilderOpenArray(&jb, "vlan");
+    JsonBuilderSetUint(&jb, NULL, 10);
+    JsonBuilderSetUint(&jb, NULL, 0);
+    JsonBuilderClose(&jb);
+    JsonBuilderOpenObject(&jb, "tcp");
+    FAIL_IF_NOT(JsonBuilderIsEmpty(&jb));
+    JsonBuilderSetBool(&jb, "syn", true);
+    FAIL_IF(JsonBuilderIsEmpty(&jb));
+    JsonBuilderClose(&jb);
+    JsonBuilderClose(&jb);
+
+    FAIL_IF(jb.error);
+    FAIL_IF_NOT(JB_TEST_OUTPUT(&jb, "{\"event_type\":\"alert\","
+                "\"flow_id\":1234567890123,\"age\":-3,\"vlan\":[10,0],"
+                "\"tcp\":{\"syn\":true}}"));
+
+    MemBufferFree(mb);
+    PASS;
+}
+
+/** \test escaping matches jansson with the default EVE flags */
+static int JsonBuilderTest02(void)
+{
+    MemBuffer *mb = MemBufferCreateNew(64);
+    FAIL_IF_NULL(mb);
+
+    JsonBuilder jb;
+    JsonBuilderInit(&jb, &mb, JSON_ENSURE_ASCII|JSON_ESCAPE_SLASH);
+    JsonBuilderOpenArray(&jb, NULL);
+    JsonBuilderSetString(&jb, NULL, "a\"b\\c/d\r\n\x01");
+    /* U+00E9 and U+1F600 */
+    JsonBuilderSetString(&jb, NULL, "\xc3\xa9\xf0\x9f\x98\x80");
+    /* not UTF-8 */
+    JsonBuilderSetString(&jb, NULL, "a/\xff\n");
+    JsonBuilderSetStringN(&jb, NULL, "abc\0def", 7);
+    JsonBuilderClose(&jb);
+
+    FAIL_IF(jb.error);
+    FAIL_IF_NOT(JB_TEST_OUTPUT(&jb, "[\"a\\\"b\\\\c\\/d\\r\\n\\u0001\","
+                "\"\\u00E9\\uD83D\\uDE00\",\"a\\/\\\\xFF\\\\x0A\",\"abc\"]"));
+
+    MemBufferReset(mb);
+    JsonBuilderInit(&jb, &mb, 0);
+    JsonBuilderOpenArray(&jb, NULL);
+    JsonBuilderSetString(&jb, NULL, "/\xc3\xa9");
+    JsonBuilderClose(&jb);
+    FAIL_IF_NOT(JB_TEST_OUTPUT(&jb, "[\"/\xc3\xa9\"]"));
+
+    MemBufferFree(mb);
+    PASS;
+}
+
+/** \test dropping an empty object */
+static int JsonBuilderTest03(void)
+{
+    MemBuffer *mb = MemBufferCreateNew(64);
+    FAIL_IF_NULL(mb);
+    MemBufferWriteRaw(mb, "prefix: ", 8);
+
+    JsonBuilder jb;
+    JsonBuilderInit(&jb, &mb, 0);
+    JsonBuilderOpenObject(&jb, NULL);
+    JsonBuilderSetUint(&jb, "a", 1);
+
+    JsonBuilderMark mark;
+    JsonBuilderGetMark(&jb, &mark);
+    JsonBuilderOpenObject(&jb, "empty");
+    FAIL_IF_NOT(JsonBuilderIsEmpty(&jb));
+    JsonBuilderRestoreMark(&jb, &mark);
+
+    JsonBuilderSetUint(&jb, "b", 2);
+    JsonBuilderClose(&jb);
+    FAIL_IF(jb.error);
+    FAIL_IF_NOT(JB_TEST_OUTPUT(&jb, "{\"a\":1,\"b\":2}"));
+    FAIL_IF_NOT(strncmp((char *)MEMBUFFER_BUFFER(mb), "prefix: ", 8) == 0);
+
+    MemBufferFree(mb);
+    PASS;
+}
+
+#endif /* UNITTESTS */
+
+void JsonBuilderRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("JsonBuilderTest01", JsonBuilderTest01);
+    UtRegisterTest("JsonBuilderTest02", JsonBuilderTest02);
+    UtRegisterTest("JsonBuilderTest03", JsonBuilderTest03);
+#endif /* UNITTESTS */
+}
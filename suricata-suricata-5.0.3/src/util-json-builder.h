@@ -0,0 +1,88 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Append only JSON writer. Members are encoded straight into a MemBuffer,
+ * so building a record doesn't need a jansson object tree.
+ */
+
+#ifndef __UTIL_JSON_BUILDER_H__
+#define __UTIL_JSON_BUILDER_H__
+
+#include "util-buffer.h"
+
+/** max nesting of objects and arrays */
+#define JSON_BUILDER_MAX_DEPTH  32
+
+#ifndef JSON_MAX_INDENT
+#define JSON_MAX_INDENT 0x1F
+#endif
+
+/** jansson output flags the builder produces natively, other layouts
+ *  need the output to be reformatted */
+#define JSON_BUILDER_NATIVE_FLAGS   (JSON_COMPACT|JSON_PRESERVE_ORDER)
+#define JSON_BUILDER_LAYOUT_FLAGS   (JSON_MAX_INDENT|JSON_COMPACT| \
+                                     JSON_SORT_KEYS|JSON_PRESERVE_ORDER)
+
+typedef struct JsonBuilder_ {
+    MemBuffer **buffer;
+    /** offset of the first byte written by the builder */
+    uint32_t start;
+    /** JSON_ENSURE_ASCII and JSON_ESCAPE_SLASH are honoured */
+    uint32_t flags;
+    /** number of open objects and arrays */
+    uint8_t depth;
+    /** out of memory or misuse, the output is unusable */
+    bool error;
+    /** per level: JB_LEVEL_* flags */
+    uint8_t level[JSON_BUILDER_MAX_DEPTH + 1];
+} JsonBuilder;
+
+/** position in the output that can be returned to, e.g. to drop an
+ *  object that turned out to be empty */
+typedef struct JsonBuilderMark_ {
+    uint32_t offset;
+    uint8_t depth;
+    uint8_t level;
+} JsonBuilderMark;
+
+void JsonBuilderInit(JsonBuilder *jb, MemBuffer **buffer, uint32_t flags);
+
+void JsonBuilderOpenObject(JsonBuilder *jb, const char *key);
+void JsonBuilderOpenArray(JsonBuilder *jb, const char *key);
+void JsonBuilderClose(JsonBuilder *jb);
+bool JsonBuilderIsEmpty(const JsonBuilder *jb);
+
+/* key is NULL for array members */
+void JsonBuilderSetString(JsonBuilder *jb, const char *key, const char *val);
+void JsonBuilderSetStringN(JsonBuilder *jb, const char *key,
+        const char *val, size_t len);
+void JsonBuilderSetUint(JsonBuilder *jb, const char *key, uint64_t val);
+void JsonBuilderSetInt(JsonBuilder *jb, const char *key, int64_t val);
+void JsonBuilderSetBool(JsonBuilder *jb, const char *key, bool val);
+void JsonBuilderSetJson(JsonBuilder *jb, const char *key, const json_t *val);
+
+void JsonBuilderGetMark(const JsonBuilder *jb, JsonBuilderMark *mark);
+void JsonBuilderRestoreMark(JsonBuilder *jb, const JsonBuilderMark *mark);
+
+json_t *JsonBuilderToJson(const JsonBuilder *jb);
+
+void JsonBuilderRegisterTests(void);
+
+#endif /* __UTIL_JSON_BUILDER_H__ */
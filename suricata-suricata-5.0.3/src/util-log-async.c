@@ -0,0 +1,702 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Asynchronous writes of log records.
+ *
+ * The loggers still build their records in the thread that logs, but the
+ * write to the file, socket or redis server happens in an output thread.
+ * Every thread that logs gets a ring the formatted records are copied
+ * into, and each ring is drained by one of the output threads. A slow log
+ * sink then only delays the output threads. When a ring is full, the
+ * thread either waits for the output thread or drops the record,
+ * depending on the on-full setting.
+ *
+ * Records of one thread are written in order. Before the output threads
+ * run, after they are stopped and for records that are too big for the
+ * ring, the thread writes its queued records and the new one itself.
+ */
+
+#include "suricata-common.h"
+#include "conf.h"
+#include "counters.h"
+#include "threads.h"
+#include "threadvars.h"
+#include "tm-threads.h"
+#include "runmodes.h"
+#include "util-debug.h"
+#include "util-misc.h"
+#include "util-optimize.h"
+#include "util-privs.h"
+#include "util-unittest.h"
+#include "util-log-async.h"
+#include "util-log-redis.h"
+#include "conf-yaml-loader.h"
+
+/* default size of the ring of a thread */
+#define LOG_ASYNC_RING_SIZE         (1024 * 1024)
+#define LOG_ASYNC_RING_SIZE_MIN     (64 * 1024)
+/* msecs an idle output thread waits for a wakeup */
+#define LOG_ASYNC_WAIT_MSEC         10
+/* usecs a thread waits for space in its full ring */
+#define LOG_ASYNC_BLOCK_USEC        100
+
+/** a queued record, followed by the next one at the next 8 byte boundary */
+typedef struct LogAsyncRecord_ {
+    /** NULL for a padding record, the rest of the ring is unused */
+    LogFileCtx *log_ctx;
+    LogAsyncWriteFunc Write;
+    uint32_t len;
+    /** len bytes and a terminating 0 */
+    char data[];
+} LogAsyncRecord;
+
+#define LOG_ASYNC_HEADER_LEN    offsetof(LogAsyncRecord, data)
+#define LOG_ASYNC_RECORD_LEN(len) \
+    (((uint32_t)LOG_ASYNC_HEADER_LEN + (len) + 1 + 7) & ~7U)
+
+typedef struct LogAsyncRing_ {
+    uint8_t *buf;
+    /** multiple of 8 */
+    uint32_t size;
+    /** selects the output thread */
+    uint32_t id;
+
+    /** bytes queued, only changed by the producer */
+    SC_ATOMIC_DECLARE(uint64_t, head);
+    /** bytes written out, only changed by the thread holding m */
+    SC_ATOMIC_DECLARE(uint64_t, tail);
+    /** held while the ring is drained */
+    SCMutex m;
+
+    /* producer side, only written by the producer */
+    uint64_t tail_cache;
+    uint64_t queued;
+    uint64_t dropped;
+    uint64_t blocked;
+
+    struct LogAsyncRing_ *next;
+} LogAsyncRing;
+
+static struct {
+    bool parsed;
+    bool enabled;
+    /** drop records when the ring is full, instead of waiting */
+    bool drop;
+    uint32_t threads;
+    uint32_t ring_size;
+} log_async_config;
+
+static SCMutex log_async_lock = SCMUTEX_INITIALIZER;
+/* all rings, the list only grows at the head until LogAsyncDeinit */
+static LogAsyncRing *log_async_rings = NULL;
+static uint32_t log_async_ring_cnt = 0;
+static ThreadVars **log_async_tvs = NULL;
+static uint32_t log_async_tv_cnt = 0;
+/* set while the output threads drain the rings */
+static volatile bool log_async_running = false;
+
+static __thread LogAsyncRing *log_async_ring = NULL;
+
+static LogAsyncRing *LogAsyncRingNew(uint32_t size)
+{
+    LogAsyncRing *r = SCCalloc(1, sizeof(*r));
+    if (unlikely(r == NULL))
+        return NULL;
+    r->buf = SCMalloc(size);
+    if (unlikely(r->buf == NULL)) {
+        SCFree(r);
+        return NULL;
+    }
+    r->size = size;
+    SC_ATOMIC_INIT(r->head);
+    SC_ATOMIC_INIT(r->tail);
+    SCMutexInit(&r->m, NULL);
+    return r;
+}
+
+static void LogAsyncRingFree(LogAsyncRing *r)
+{
+    SCMutexDestroy(&r->m);
+    SC_ATOMIC_DESTROY(r->head);
+    SC_ATOMIC_DESTROY(r->tail);
+    SCFree(r->buf);
+    SCFree(r);
+}
+
+/**
+ * \brief Queue a record in the ring of the calling thread.
+ *
+ * A record that doesn't fit before the end of the ring is queued at the
+ * start, the space it skips is marked as padding.
+ *
+ * \retval 0 on success
+ * \retval -1 if the ring is full
+ */
+static int LogAsyncRingPut(LogAsyncRing *r, LogFileCtx *log_ctx,
+        LogAsyncWriteFunc Write, const char *buffer, uint32_t len)
+{
+    const uint32_t need = LOG_ASYNC_RECORD_LEN(len);
+    const uint64_t head = SC_ATOMIC_GET(r->head);
+    const uint32_t offset = head % r->size;
+    const uint32_t skip = (r->size - offset < need) ? r->size - offset : 0;
+
+    if (head + skip + need - r->tail_cache > r->size) {
+        r->tail_cache = SC_ATOMIC_GET(r->tail);
+        /* don't overwrite records before they are written out */
+        hw_barrier();
+        if (head + skip + need - r->tail_cache > r->size)
+            return -1;
+    }
+
+    if (skip >= LOG_ASYNC_HEADER_LEN) {
+        LogAsyncRecord *pad = (LogAsyncRecord *)(r->buf + offset);
+        pad->log_ctx = NULL;
+    }
+
+    LogAsyncRecord *rec = (LogAsyncRecord *)(r->buf + (head + skip) % r->size);
+    rec->log_ctx = log_ctx;
+    rec->Write = Write;
+    rec->len = len;
+    memcpy(rec->data, buffer, len);
+    rec->data[len] = '\0';
+
+    /* publishes the record, it's a full barrier */
+    (void)SC_ATOMIC_ADD(r->head, skip + need);
+    return 0;
+}
+
+/**
+ * \brief Write out the records queued in a ring.
+ *
+ * \retval cnt number of records written
+ */
+static uint32_t LogAsyncRingDrain(LogAsyncRing *r)
+{
+    uint32_t cnt = 0;
+
+    SCMutexLock(&r->m);
+    uint64_t tail = SC_ATOMIC_GET(r->tail);
+    const uint64_t head = SC_ATOMIC_GET(r->head);
+    /* the records up to head are complete */
+    hw_barrier();
+
+    while (tail < head) {
+        const uint32_t offset = tail % r->size;
+        const LogAsyncRecord *rec = (const LogAsyncRecord *)(r->buf + offset);
+        uint32_t step = r->size - offset;
+
+        if (step >= LOG_ASYNC_HEADER_LEN && rec->log_ctx != NULL) {
+            rec->Write(rec->data, rec->len, rec->log_ctx);
+            step = LOG_ASYNC_RECORD_LEN(rec->len);
+            cnt++;
+        }
+        tail += step;
+        /* hands the space back to the producer */
+        (void)SC_ATOMIC_ADD(r->tail, step);
+    }
+    SCMutexUnlock(&r->m);
+
+    return cnt;
+}
+
+static void LogAsyncWakeup(const LogAsyncRing *r)
+{
+    if (log_async_tv_cnt == 0)
+        return;
+    ThreadVars *tv = log_async_tvs[r->id % log_async_tv_cnt];
+    SCCtrlCondSignal(tv->ctrl_cond);
+}
+
+/**
+ * \brief Get the ring of the calling thread, creating it on first use.
+ */
+static LogAsyncRing *LogAsyncGetRing(void)
+{
+    LogAsyncRing *r = log_async_ring;
+    if (likely(r != NULL))
+        return r;
+
+    r = LogAsyncRingNew(log_async_config.ring_size);
+    if (unlikely(r == NULL))
+        return NULL;
+
+    SCMutexLock(&log_async_lock);
+    r->id = log_async_ring_cnt++;
+    r->next = log_async_rings;
+    log_async_rings = r;
+    SCMutexUnlock(&log_async_lock);
+
+    log_async_ring = r;
+    return r;
+}
+
+static LogAsyncRing *LogAsyncRings(void)
+{
+    SCMutexLock(&log_async_lock);
+    LogAsyncRing *r = log_async_rings;
+    SCMutexUnlock(&log_async_lock);
+    return r;
+}
+
+/**
+ * \brief Queue a record for an output thread.
+ *
+ * \param Write writes the record out, called from the output thread
+ *
+ * \retval 1 if the record was queued or written
+ * \retval 0 if it was dropped
+ */
+int LogAsyncWrite(LogFileCtx *log_ctx, LogAsyncWriteFunc Write,
+        const char *buffer, int buffer_len)
+{
+    LogAsyncRing *r = LogAsyncGetRing();
+    if (unlikely(r == NULL)) {
+        return Write(buffer, buffer_len, log_ctx);
+    }
+
+    if (!log_async_running ||
+            LOG_ASYNC_RECORD_LEN(buffer_len) > r->size / 2) {
+        /* write in order with the queued records */
+        LogAsyncRingDrain(r);
+        return Write(buffer, buffer_len, log_ctx);
+    }
+
+    const uint64_t used = SC_ATOMIC_GET(r->head) - r->tail_cache;
+    if (LogAsyncRingPut(r, log_ctx, Write, buffer, buffer_len) < 0) {
+        if (log_async_config.drop) {
+            r->dropped++;
+            LogAsyncWakeup(r);
+            return 0;
+        }
+
+        r->blocked++;
+        do {
+            if (!log_async_running) {
+                LogAsyncRingDrain(r);
+            } else {
+                LogAsyncWakeup(r);
+                usleep(LOG_ASYNC_BLOCK_USEC);
+            }
+        } while (LogAsyncRingPut(r, log_ctx, Write, buffer, buffer_len) < 0);
+    } else if (used < r->size / 2 &&
+               SC_ATOMIC_GET(r->head) - r->tail_cache >= r->size / 2) {
+        /* get the output thread going before the ring fills up */
+        LogAsyncWakeup(r);
+    }
+    r->queued++;
+
+    return 1;
+}
+
+/**
+ * \brief Write out the queued records of all threads.
+ *
+ * Called before a LogFileCtx is freed, so no records of the ctx are
+ * left behind.
+ */
+void LogAsyncDrain(void)
+{
+    for (LogAsyncRing *r = LogAsyncRings(); r != NULL; r = r->next) {
+        LogAsyncRingDrain(r);
+    }
+}
+
+/**
+ * \brief Write of a LogFileCtx in async mode.
+ */
+static int LogAsyncFileWrite(const char *buffer, int buffer_len, LogFileCtx *log_ctx)
+{
+    return LogAsyncWrite(log_ctx, log_ctx->SyncWrite, buffer, buffer_len);
+}
+
+static uint64_t LogAsyncQueuedCounter(void)
+{
+    uint64_t cnt = 0;
+    for (LogAsyncRing *r = LogAsyncRings(); r != NULL; r = r->next) {
+        cnt += r->queued;
+    }
+    return cnt;
+}
+
+static uint64_t LogAsyncDroppedCounter(void)
+{
+    uint64_t cnt = 0;
+    for (LogAsyncRing *r = LogAsyncRings(); r != NULL; r = r->next) {
+        cnt += r->dropped;
+    }
+    return cnt;
+}
+
+static uint64_t LogAsyncBlockedCounter(void)
+{
+    uint64_t cnt = 0;
+    for (LogAsyncRing *r = LogAsyncRings(); r != NULL; r = r->next) {
+        cnt += r->blocked;
+    }
+    return cnt;
+}
+
+/**
+ * \brief Parse the async-output config.
+ */
+static void LogAsyncConfig(void)
+{
+    log_async_config.parsed = true;
+    log_async_config.threads = 1;
+    log_async_config.ring_size = LOG_ASYNC_RING_SIZE;
+
+    int enabled = 0;
+    if (ConfGetBool("async-output.enabled", &enabled) != 1 || !enabled)
+        return;
+
+    intmax_t threads = 0;
+    if (ConfGetInt("async-output.threads", &threads) == 1) {
+        if (threads < 1 || threads > 1024) {
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "invalid value for "
+                       "async-output.threads: %"PRIdMAX, threads);
+            exit(EXIT_FAILURE);
+        }
+        log_async_config.threads = (uint32_t)threads;
+    }
+
+    const char *ring_size = NULL;
+    if (ConfGet("async-output.ring-size", &ring_size) == 1) {
+        uint64_t size = 0;
+        if (ParseSizeStringU64(ring_size, &size) < 0 ||
+                size < LOG_ASYNC_RING_SIZE_MIN || size > UINT32_MAX / 2) {
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "invalid value for "
+                       "async-output.ring-size: %s. Expected at least %dkb",
+                       ring_size, LOG_ASYNC_RING_SIZE_MIN / 1024);
+            exit(EXIT_FAILURE);
+        }
+        log_async_config.ring_size = (uint32_t)size & ~7U;
+    }
+
+    const char *on_full = NULL;
+    if (ConfGet("async-output.on-full", &on_full) == 1) {
+        if (strcmp(on_full, "drop") == 0) {
+            log_async_config.drop = true;
+        } else if (strcmp(on_full, "block") != 0) {
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "invalid value for "
+                       "async-output.on-full: %s. Expected \"block\" or "
+                       "\"drop\"", on_full);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    log_async_config.enabled = true;
+
+    StatsRegisterGlobalCounter("output.async.queued", LogAsyncQueuedCounter);
+    StatsRegisterGlobalCounter("output.async.dropped", LogAsyncDroppedCounter);
+    StatsRegisterGlobalCounter("output.async.blocked", LogAsyncBlockedCounter);
+
+    SCLogConfig("async output: %u threads, %u byte rings, %s when full",
+                log_async_config.threads, log_async_config.ring_size,
+                log_async_config.drop ? "drop" : "block");
+}
+
+/**
+ * \brief Switch a LogFileCtx to async writes if async output is enabled.
+ *
+ * \retval 1 if the ctx writes asynchronously
+ * \retval 0 otherwise
+ */
+int LogAsyncSetup(LogFileCtx *log_ctx)
+{
+    if (!log_async_config.parsed)
+        LogAsyncConfig();
+    if (!log_async_config.enabled)
+        return 0;
+
+    log_ctx->SyncWrite = log_ctx->Write;
+    log_ctx->Write = LogAsyncFileWrite;
+    log_ctx->async = true;
+    return 1;
+}
+
+static void *LogAsyncThread(void *arg)
+{
+    ThreadVars *tv = (ThreadVars *)arg;
+
+    if (SCSetThreadName(tv->name) < 0) {
+        SCLogWarning(SC_ERR_THREAD_INIT, "Unable to set thread name");
+    }
+
+    if (tv->thread_setup_flags != 0)
+        TmThreadSetupOptions(tv);
+
+    tv->cap_flags = 0;
+    SCDropCaps(tv);
+
+    uint32_t idx = 0;
+    while (log_async_tvs[idx] != tv)
+        idx++;
+
+    TmThreadsSetFlag(tv, THV_INIT_DONE);
+    while (1) {
+        if (TmThreadsCheckFlag(tv, THV_PAUSE)) {
+            TmThreadsSetFlag(tv, THV_PAUSED);
+            TmThreadTestThreadUnPaused(tv);
+            TmThreadsUnsetFlag(tv, THV_PAUSED);
+        }
+
+        const bool kill = TmThreadsCheckFlag(tv, THV_KILL);
+        if (kill) {
+            /* threads write themselves from now on */
+            log_async_running = false;
+        }
+
+        uint32_t cnt = 0;
+        for (LogAsyncRing *r = LogAsyncRings(); r != NULL; r = r->next) {
+            if (r->id % log_async_tv_cnt == idx)
+                cnt += LogAsyncRingDrain(r);
+        }
+
+        if (kill) {
+            break;
+        }
+
+        if (cnt == 0) {
+            struct timeval cur_timev;
+            gettimeofday(&cur_timev, NULL);
+            struct timespec cond_time = FROM_TIMEVAL(cur_timev);
+            cond_time.tv_nsec += LOG_ASYNC_WAIT_MSEC * 1000000;
+            if (cond_time.tv_nsec >= 1000000000) {
+                cond_time.tv_sec++;
+                cond_time.tv_nsec -= 1000000000;
+            }
+
+            /* wait until a thread fills its ring, or until we are woken
+             * up by the shutdown procedure */
+            SCCtrlMutexLock(tv->ctrl_mutex);
+            SCCtrlCondTimedwait(tv->ctrl_cond, tv->ctrl_mutex, &cond_time);
+            SCCtrlMutexUnlock(tv->ctrl_mutex);
+        }
+    }
+
+    TmThreadsSetFlag(tv, THV_RUNNING_DONE);
+    TmThreadWaitForFlag(tv, THV_DEINIT);
+    TmThreadsSetFlag(tv, THV_CLOSED);
+    return NULL;
+}
+
+/**
+ * \brief Spawn the output threads if async output is enabled.
+ */
+void LogAsyncSpawn(void)
+{
+    if (!log_async_config.enabled)
+        return;
+
+    log_async_tvs = SCCalloc(log_async_config.threads, sizeof(ThreadVars *));
+    if (log_async_tvs == NULL) {
+        SCLogError(SC_ERR_MEM_ALLOC, "failed to allocate the async output "
+                   "threads");
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint32_t u = 0; u < log_async_config.threads; u++) {
+        char name[TM_THREAD_NAME_MAX];
+        snprintf(name, sizeof(name), "%s#%02u", thread_name_log_output, u+1);
+
+        ThreadVars *tv = TmThreadCreateMgmtThread(name, LogAsyncThread, 1);
+        if (tv == NULL) {
+            SCLogError(SC_ERR_THREAD_CREATE, "TmThreadCreateMgmtThread failed");
+            exit(EXIT_FAILURE);
+        }
+        log_async_tvs[u] = tv;
+    }
+    log_async_tv_cnt = log_async_config.threads;
+    log_async_running = true;
+
+    for (uint32_t u = 0; u < log_async_tv_cnt; u++) {
+        if (TmThreadSpawn(log_async_tvs[u]) != 0) {
+            SCLogError(SC_ERR_THREAD_SPAWN, "TmThreadSpawn failed for "
+                       "LogAsyncThread");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+/**
+ * \brief Free the rings, after all async LogFileCtx are freed.
+ */
+void LogAsyncDeinit(void)
+{
+    log_async_running = false;
+    LogAsyncDrain();
+
+    SCMutexLock(&log_async_lock);
+    LogAsyncRing *r = log_async_rings;
+    log_async_rings = NULL;
+    log_async_ring_cnt = 0;
+    if (log_async_tvs != NULL) {
+        SCFree(log_async_tvs);
+        log_async_tvs = NULL;
+    }
+    log_async_tv_cnt = 0;
+    SCMutexUnlock(&log_async_lock);
+
+    while (r != NULL) {
+        LogAsyncRing *next = r->next;
+        LogAsyncRingFree(r);
+        r = next;
+    }
+    log_async_ring = NULL;
+}
+
+#ifdef UNITTESTS
+static char test_out[4096];
+static uint32_t test_out_len = 0;
+
+static int LogAsyncTestWrite(const char *buffer, int buffer_len,
+        LogFileCtx *log_ctx)
+{
+    if (buffer[buffer_len] != '\0' ||
+            test_out_len + buffer_len > sizeof(test_out))
+        return -1;
+    memcpy(test_out + test_out_len, buffer, buffer_len);
+    test_out_len += buffer_len;
+    return 1;
+}
+
+/** \test records are written in order, also when they wrap around */
+static int LogAsyncTest01(void)
+{
+    LogFileCtx log_ctx;
+    memset(&log_ctx, 0, sizeof(log_ctx));
+    LogAsyncRing *r = LogAsyncRingNew(256);
+    FAIL_IF_NULL(r);
+
+    char expect[sizeof(test_out)];
+    for (int round = 0; round < 20; round++) {
+        uint32_t expect_len = 0;
+        test_out_len = 0;
+        for (int i = 0; i < 3; i++) {
+            char rec[64];
+            int len = snprintf(rec, sizeof(rec), "%d-%d %.*s;", round, i,
+                               (round * 7 + i * 13) % 40, "0123456789012345678901234567890123456789");
+            FAIL_IF(LogAsyncRingPut(r, &log_ctx, LogAsyncTestWrite, rec, len) != 0);
+            memcpy(expect + expect_len, rec, len);
+            expect_len += len;
+        }
+        FAIL_IF(LogAsyncRingDrain(r) != 3);
+        FAIL_IF(test_out_len != expect_len);
+        FAIL_IF(memcmp(test_out, expect, expect_len) != 0);
+        FAIL_IF(SC_ATOMIC_GET(r->head) != SC_ATOMIC_GET(r->tail));
+    }
+
+    LogAsyncRingFree(r);
+    PASS;
+}
+
+/** \test a full ring refuses records until it is drained */
+static int LogAsyncTest02(void)
+{
+    LogFileCtx log_ctx;
+    memset(&log_ctx, 0, sizeof(log_ctx));
+    LogAsyncRing *r = LogAsyncRingNew(256);
+    FAIL_IF_NULL(r);
+
+    const char rec[] = "0123456789012345678901234567890123456789";
+    int queued = 0;
+    while (LogAsyncRingPut(r, &log_ctx, LogAsyncTestWrite, rec, sizeof(rec) - 1) == 0)
+        queued++;
+    FAIL_IF(queued != 256 / LOG_ASYNC_RECORD_LEN(sizeof(rec) - 1));
+
+    test_out_len = 0;
+    FAIL_IF(LogAsyncRingDrain(r) != (uint32_t)queued);
+    FAIL_IF(test_out_len != queued * (sizeof(rec) - 1));
+    FAIL_IF(LogAsyncRingPut(r, &log_ctx, LogAsyncTestWrite, rec, sizeof(rec) - 1) != 0);
+
+    LogAsyncRingFree(r);
+    PASS;
+}
+
+#ifdef HAVE_LIBHIREDIS
+/** \test a redis output opened with async output enabled queues its
+ *        records for the output threads */
+static int LogAsyncTest03(void)
+{
+    const char config[] = "\
+%YAML 1.1\n\
+---\n\
+async-output:\n\
+  enabled: yes\n\
+redis:\n\
+  server: 127.0.0.1\n\
+  mode: list\n\
+";
+    ConfCreateContextBackup();
+    ConfInit();
+    FAIL_IF(ConfYamlLoadString(config, strlen(config)) != 0);
+    memset(&log_async_config, 0, sizeof(log_async_config));
+
+    LogFileCtx *log_ctx = LogFileNewCtx();
+    FAIL_IF_NULL(log_ctx);
+    log_ctx->type = LOGFILE_TYPE_REDIS;
+    FAIL_IF(SCConfLogOpenRedis(ConfGetNode("redis"), log_ctx) != 0);
+    FAIL_IF_NOT(log_ctx->async);
+
+    const char rec[] = "{\"event_type\":\"test\"}";
+    MemBuffer *buffer = MemBufferCreateNew(64);
+    FAIL_IF_NULL(buffer);
+    MemBufferWriteString(buffer, "%s", rec);
+
+    /* pretend the output threads run, so the record is queued rather
+     * than written right away */
+    log_async_running = true;
+    FAIL_IF(LogFileWrite(log_ctx, buffer) != 0);
+    log_async_running = false;
+
+    LogAsyncRing *r = log_async_ring;
+    FAIL_IF_NULL(r);
+    FAIL_IF(r->queued != 1);
+    const uint64_t tail = SC_ATOMIC_GET(r->tail);
+    FAIL_IF(SC_ATOMIC_GET(r->head) - tail != LOG_ASYNC_RECORD_LEN(sizeof(rec) - 1));
+    const LogAsyncRecord *queued = (const LogAsyncRecord *)(r->buf + tail % r->size);
+    FAIL_IF(queued->log_ctx != log_ctx);
+    FAIL_IF(queued->len != sizeof(rec) - 1);
+    FAIL_IF(memcmp(queued->data, rec, sizeof(rec)) != 0);
+
+    /* don't send the record to a real server */
+    (void)SC_ATOMIC_SET(r->tail, SC_ATOMIC_GET(r->head));
+
+    MemBufferFree(buffer);
+    LogFileFreeCtx(log_ctx);
+    LogAsyncDeinit();
+    memset(&log_async_config, 0, sizeof(log_async_config));
+    ConfDeInit();
+    ConfRestoreContextBackup();
+    PASS;
+}
+#endif /* HAVE_LIBHIREDIS */
+#endif /* UNITTESTS */
+
+void LogAsyncRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("LogAsyncTest01", LogAsyncTest01);
+    UtRegisterTest("LogAsyncTest02", LogAsyncTest02);
+#ifdef HAVE_LIBHIREDIS
+    UtRegisterTest("LogAsyncTest03", LogAsyncTest03);
+#endif /* HAVE_LIBHIREDIS */
+#endif /* UNITTESTS */
+}
@@ -0,0 +1,43 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Writes log records from dedicated output threads. Each thread queues
+ * its records in its own single producer, single consumer ring.
+ */
+
+#ifndef __UTIL_LOG_ASYNC_H__
+#define __UTIL_LOG_ASYNC_H__
+
+#include "util-logopenfile.h"
+
+typedef int (*LogAsyncWriteFunc)(const char *buffer, int buffer_len,
+                                 LogFileCtx *log_ctx);
+
+int LogAsyncSetup(LogFileCtx *log_ctx);
+int LogAsyncWrite(LogFileCtx *log_ctx, LogAsyncWriteFunc Write,
+        const char *buffer, int buffer_len);
+void LogAsyncDrain(void);
+
+void LogAsyncSpawn(void);
+void LogAsyncDeinit(void);
+
+void LogAsyncRegisterTests(void);
+
+#endif /* __UTIL_LOG_ASYNC_H__ */
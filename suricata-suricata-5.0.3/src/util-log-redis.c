@@ -24,8 +24,14 @@
  * File-like output for logging:  redis
  */
 #include "suricata-common.h" /* errno.h, string.h, etc. */
+#include "counters.h"
 #include "util-log-redis.h"
 #include "util-logopenfile.h"
+#include "util-log-async.h"
+#include "util-privs.h"
+#include "runmodes.h"
+#include "tm-threads.h"
+#include "util-unittest.h"
 
 #ifdef HAVE_LIBHIREDIS
 
@@ -66,7 +72,6 @@ static SCLogRedisContext *SCLogRedisContextAlloc(void)
     ctx->ev_base = NULL;
     ctx->async   = NULL;
 #endif
-    ctx->batch_count = 0;
     ctx->tried = 0;
 
     return ctx;
@@ -91,7 +96,6 @@ static SCLogRedisContext *SCLogRedisContextAsyncAlloc(void)
     ctx->async   = NULL;
     ctx->ev_base = NULL;
     ctx->connected = 0;
-    ctx->batch_count = 0;
     ctx->tried = 0;
 
     return ctx;
@@ -333,77 +337,458 @@ static int SCLogRedisWriteSync(LogFileCtx *file_ctx, const char *string)
     }
 
     /* synchronous mode */
-    if (file_ctx->redis_setup.batch_size) {
-        redisAppendCommand(redis, "%s %s %s",
-                file_ctx->redis_setup.command,
-                file_ctx->redis_setup.key,
-                string);
-        if (ctx->batch_count == file_ctx->redis_setup.batch_size) {
-            redisReply *reply;
-            int i;
-            ctx->batch_count = 0;
-            for (i = 0; i <= file_ctx->redis_setup.batch_size; i++) {
-                if (redisGetReply(redis, (void **)&reply) == REDIS_OK) {
-                    freeReplyObject(reply);
-                    ret = 0;
-                } else {
-                    if (redis->err) {
-                        SCLogInfo("Error when fetching reply: %s (%d)",
-                                redis->errstr,
-                                redis->err);
-                    }
-                    switch (redis->err) {
-                        case REDIS_ERR_EOF:
-                        case REDIS_ERR_IO:
-                            SCLogInfo("Reopening connection to redis server");
-                            SCConfLogReopenSyncRedis(file_ctx);
-                            redis = ctx->sync;
-                            if (redis) {
-                                SCLogInfo("Reconnected to redis server");
-                            } else {
-                                SCLogInfo("Unable to reconnect to redis server");
-                                return -1;
-                            }
-                            break;
-                        default:
-                            SCLogWarning(SC_ERR_INVALID_VALUE,
-                                    "Unsupported error code %d",
-                                    redis->err);
-                            return -1;
-                    }
-                }
-            }
-        } else {
-            ctx->batch_count++;
+    redisReply *reply = redisCommand(redis, "%s %s %s",
+            file_ctx->redis_setup.command,
+            file_ctx->redis_setup.key,
+            string);
+    /* We may lose the reply if disconnection happens*/
+    if (reply) {
+        switch (reply->type) {
+            case REDIS_REPLY_ERROR:
+                SCLogWarning(SC_ERR_SOCKET, "Redis error: %s", reply->str);
+                SCConfLogReopenSyncRedis(file_ctx);
+                break;
+            case REDIS_REPLY_INTEGER:
+                SCLogDebug("Redis integer %lld", reply->integer);
+                ret = 0;
+                break;
+            default:
+                SCLogError(SC_ERR_INVALID_VALUE,
+                        "Redis default triggered with %d", reply->type);
+                SCConfLogReopenSyncRedis(file_ctx);
+                break;
         }
+        freeReplyObject(reply);
     } else {
-        redisReply *reply = redisCommand(redis, "%s %s %s",
-                file_ctx->redis_setup.command,
-                file_ctx->redis_setup.key,
-                string);
-        /* We may lose the reply if disconnection happens*/
-        if (reply) {
-            switch (reply->type) {
-                case REDIS_REPLY_ERROR:
-                    SCLogWarning(SC_ERR_SOCKET, "Redis error: %s", reply->str);
-                    SCConfLogReopenSyncRedis(file_ctx);
+        SCConfLogReopenSyncRedis(file_ctx);
+    }
+    return ret;
+}
+
+/* seconds a command of the pipelined writer may take */
+#define REDIS_PIPELINE_TIMEOUT  5
+/* msecs an idle connection thread waits for records */
+#define REDIS_PIPELINE_WAIT_MSEC    100
+
+/* limits of the pipelining settings */
+#define REDIS_PIPELINE_BATCH_SIZE_MAX   10000
+#define REDIS_PIPELINE_CONNECTIONS_MAX  64
+#define REDIS_PIPELINE_QUEUE_SIZE_MAX   10000000
+
+/** a queued record of the pipelined writer */
+typedef struct SCLogRedisRecord_ {
+    size_t len;
+    char data[];
+} SCLogRedisRecord;
+
+/** pipelined writer: a bounded queue of records, written in batches by a
+ *  thread per connection */
+typedef struct SCLogRedisPipeline_ {
+    SCMutex m;
+    SCCondT cond;
+    /* ring of queued records */
+    SCLogRedisRecord **records;
+    uint32_t size;
+    uint32_t head;
+    uint32_t cnt;
+
+    LogFileCtx *log_ctx;
+    int connections;
+    /** connection threads, NULL until spawned */
+    ThreadVars **tvs;
+
+    struct SCLogRedisPipeline_ *next;
+} SCLogRedisPipeline;
+
+/* all pipelined writers, their threads are spawned together with the
+ * other management threads */
+static SCMutex redis_pipelines_lock = SCMUTEX_INITIALIZER;
+static SCLogRedisPipeline *redis_pipelines = NULL;
+
+/* counters of all pipelined writers */
+SC_ATOMIC_DECLARE(uint64_t, redis_pipeline_written);
+SC_ATOMIC_DECLARE(uint64_t, redis_pipeline_dropped);
+SC_ATOMIC_DECLARE(uint64_t, redis_pipeline_failed);
+
+static uint64_t SCLogRedisWrittenCounter(void)
+{
+    return SC_ATOMIC_GET(redis_pipeline_written);
+}
+
+static uint64_t SCLogRedisDroppedCounter(void)
+{
+    return SC_ATOMIC_GET(redis_pipeline_dropped);
+}
+
+static uint64_t SCLogRedisFailedCounter(void)
+{
+    return SC_ATOMIC_GET(redis_pipeline_failed);
+}
+
+static redisContext *SCLogRedisPipelineConnect(const LogFileCtx *log_ctx)
+{
+    const struct timeval timeout = { REDIS_PIPELINE_TIMEOUT, 0 };
+    redisContext *redis = redisConnectWithTimeout(log_ctx->redis_setup.server,
+            log_ctx->redis_setup.port, timeout);
+    if (redis == NULL)
+        return NULL;
+    if (redis->err || redisSetTimeout(redis, timeout) != REDIS_OK) {
+        SCLogDebug("error connecting to redis server: %s", redis->errstr);
+        redisFree(redis);
+        return NULL;
+    }
+    return redis;
+}
+
+/**
+ * \brief Send a batch of records in one round trip.
+ *
+ * \retval 0 if redis replied to all commands
+ * \retval -1 on a connection error, the connection must be reopened
+ */
+static int SCLogRedisPipelineSend(const LogFileCtx *log_ctx, redisContext *redis,
+        SCLogRedisRecord **batch, int n)
+{
+    const char *argv[3] = { log_ctx->redis_setup.command,
+                            log_ctx->redis_setup.key, NULL };
+    size_t argvlen[3] = { strlen(argv[0]), strlen(argv[1]), 0 };
+
+    for (int i = 0; i < n; i++) {
+        argv[2] = batch[i]->data;
+        argvlen[2] = batch[i]->len;
+        if (redisAppendCommandArgv(redis, 3, argv, argvlen) != REDIS_OK)
+            return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        redisReply *reply = NULL;
+        if (redisGetReply(redis, (void **)&reply) != REDIS_OK) {
+            SCLogDebug("error when fetching reply: %s (%d)", redis->errstr,
+                       redis->err);
+            return -1;
+        }
+        if (reply->type == REDIS_REPLY_ERROR) {
+            SCLogDebug("redis error: %s", reply->str);
+            (void)SC_ATOMIC_ADD(redis_pipeline_failed, 1);
+        } else {
+            (void)SC_ATOMIC_ADD(redis_pipeline_written, 1);
+        }
+        freeReplyObject(reply);
+    }
+    return 0;
+}
+
+/**
+ * \brief Take up to batch_size records from the queue, oldest first.
+ *
+ * \retval n number of records moved to batch
+ */
+static int SCLogRedisPipelineDequeue(SCLogRedisPipeline *p,
+        SCLogRedisRecord **batch, int batch_size)
+{
+    int n = 0;
+    SCMutexLock(&p->m);
+    while (n < batch_size && p->cnt > 0) {
+        batch[n++] = p->records[p->head];
+        p->head = (p->head + 1) % p->size;
+        p->cnt--;
+    }
+    SCMutexUnlock(&p->m);
+    return n;
+}
+
+/**
+ * \brief Wait until records are queued, or for at most msecs.
+ */
+static void SCLogRedisPipelineWait(SCLogRedisPipeline *p, int msecs)
+{
+    struct timeval cur_timev;
+    gettimeofday(&cur_timev, NULL);
+    struct timespec cond_time = FROM_TIMEVAL(cur_timev);
+    cond_time.tv_sec += msecs / 1000;
+    cond_time.tv_nsec += (msecs % 1000) * 1000000;
+    if (cond_time.tv_nsec >= 1000000000) {
+        cond_time.tv_sec++;
+        cond_time.tv_nsec -= 1000000000;
+    }
+
+    SCMutexLock(&p->m);
+    if (p->cnt == 0) {
+        SCCondTimedwait(&p->cond, &p->m, &cond_time);
+    }
+    SCMutexUnlock(&p->m);
+}
+
+static SCLogRedisPipeline *SCLogRedisPipelineOfThread(const ThreadVars *tv)
+{
+    SCMutexLock(&redis_pipelines_lock);
+    SCLogRedisPipeline *p = redis_pipelines;
+    for ( ; p != NULL; p = p->next) {
+        for (int i = 0; p->tvs != NULL && i < p->connections; i++) {
+            if (p->tvs[i] == tv)
+                goto end;
+        }
+    }
+end:
+    SCMutexUnlock(&redis_pipelines_lock);
+    return p;
+}
+
+static void *SCLogRedisPipelineThread(void *arg)
+{
+    ThreadVars *tv = (ThreadVars *)arg;
+
+    if (SCSetThreadName(tv->name) < 0) {
+        SCLogWarning(SC_ERR_THREAD_INIT, "Unable to set thread name");
+    }
+
+    if (tv->thread_setup_flags != 0)
+        TmThreadSetupOptions(tv);
+
+    tv->cap_flags = 0;
+    SCDropCaps(tv);
+
+    SCLogRedisPipeline *p = SCLogRedisPipelineOfThread(tv);
+    BUG_ON(p == NULL);
+    const LogFileCtx *log_ctx = p->log_ctx;
+    const int batch_size = log_ctx->redis_setup.batch_size;
+    redisContext *redis = NULL;
+    bool warned = false;
+
+    SCLogRedisRecord **batch = SCCalloc(batch_size, sizeof(SCLogRedisRecord *));
+    if (batch == NULL) {
+        SCLogError(SC_ERR_MEM_ALLOC, "failed to allocate redis batch");
+        exit(EXIT_FAILURE);
+    }
+
+    TmThreadsSetFlag(tv, THV_INIT_DONE);
+
+    /* records of a batch that failed are kept here and sent again once
+     * reconnected, records are rather duplicated than lost */
+    int n = 0;
+    while (1) {
+        if (TmThreadsCheckFlag(tv, THV_PAUSE)) {
+            TmThreadsSetFlag(tv, THV_PAUSED);
+            TmThreadTestThreadUnPaused(tv);
+            TmThreadsUnsetFlag(tv, THV_PAUSED);
+        }
+
+        /* at shutdown, write out what is queued before leaving */
+        const bool kill = TmThreadsCheckFlag(tv, THV_KILL);
+
+        if (n == 0) {
+            n = SCLogRedisPipelineDequeue(p, batch, batch_size);
+            if (n == 0) {
+                if (kill)
                     break;
-                case REDIS_REPLY_INTEGER:
-                    SCLogDebug("Redis integer %lld", reply->integer);
-                    ret = 0;
+                SCLogRedisPipelineWait(p, REDIS_PIPELINE_WAIT_MSEC);
+                continue;
+            }
+        }
+
+        /* records stay queued while redis is unavailable */
+        if (redis == NULL) {
+            redis = SCLogRedisPipelineConnect(log_ctx);
+            if (redis == NULL) {
+                /* at shutdown, give up on an unavailable server */
+                if (kill)
                     break;
-                default:
-                    SCLogError(SC_ERR_INVALID_VALUE,
-                            "Redis default triggered with %d", reply->type);
-                    SCConfLogReopenSyncRedis(file_ctx);
+                if (!warned) {
+                    SCLogWarning(SC_ERR_SOCKET, "failed to connect to redis "
+                                 "server %s, will keep trying",
+                                 log_ctx->redis_setup.server);
+                    warned = true;
+                }
+                sleep(1);
+                continue;
+            }
+            SCLogInfo("Connected to redis server [%s].",
+                      log_ctx->redis_setup.server);
+            warned = false;
+        }
+
+        if (SCLogRedisPipelineSend(log_ctx, redis, batch, n) < 0) {
+            redisFree(redis);
+            redis = NULL;
+            continue;
+        }
+        for (int i = 0; i < n; i++) {
+            SCFree(batch[i]);
+        }
+        n = 0;
+    }
+
+    for (int i = 0; i < n; i++) {
+        SCFree(batch[i]);
+        (void)SC_ATOMIC_ADD(redis_pipeline_dropped, 1);
+    }
+    if (redis != NULL)
+        redisFree(redis);
+    SCFree(batch);
+
+    TmThreadsSetFlag(tv, THV_RUNNING_DONE);
+    TmThreadWaitForFlag(tv, THV_DEINIT);
+    TmThreadsSetFlag(tv, THV_CLOSED);
+    return NULL;
+}
+
+/**
+ * \brief Spawn the connection threads of the pipelined writers.
+ *
+ * Called with the other management threads once the outputs are set up.
+ * Records queued before are written once the threads run.
+ */
+void SCLogRedisPipelineSpawn(void)
+{
+    SCMutexLock(&redis_pipelines_lock);
+    SCLogRedisPipeline *p = redis_pipelines;
+    SCMutexUnlock(&redis_pipelines_lock);
+
+    uint32_t id = 0;
+    for ( ; p != NULL; p = p->next) {
+        ThreadVars **tvs = SCCalloc(p->connections, sizeof(ThreadVars *));
+        if (tvs == NULL) {
+            SCLogError(SC_ERR_MEM_ALLOC, "failed to allocate the redis "
+                       "connection threads");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < p->connections; i++) {
+            char name[TM_THREAD_NAME_MAX];
+            snprintf(name, sizeof(name), "%s#%02u", thread_name_redis_output,
+                     ++id);
+            tvs[i] = TmThreadCreateMgmtThread(name, SCLogRedisPipelineThread, 1);
+            if (tvs[i] == NULL) {
+                SCLogError(SC_ERR_THREAD_CREATE, "TmThreadCreateMgmtThread failed");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        SCMutexLock(&redis_pipelines_lock);
+        p->tvs = tvs;
+        SCMutexUnlock(&redis_pipelines_lock);
+
+        for (int i = 0; i < p->connections; i++) {
+            if (TmThreadSpawn(tvs[i]) != 0) {
+                SCLogError(SC_ERR_THREAD_SPAWN, "TmThreadSpawn failed for "
+                           "SCLogRedisPipelineThread");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+}
+
+/**
+ * \brief Queue a record for the pipelined writer.
+ *
+ * \retval 0 on success
+ * \retval -1 if the queue is full
+ */
+static int SCLogRedisWritePipelined(LogFileCtx *file_ctx, const char *string,
+        size_t string_len)
+{
+    SCLogRedisPipeline *p = ((SCLogRedisContext *)file_ctx->redis)->pipeline;
+
+    SCLogRedisRecord *rec = SCMalloc(sizeof(*rec) + string_len);
+    if (unlikely(rec == NULL)) {
+        (void)SC_ATOMIC_ADD(redis_pipeline_dropped, 1);
+        return -1;
+    }
+    rec->len = string_len;
+    memcpy(rec->data, string, string_len);
+
+    SCMutexLock(&p->m);
+    if (p->cnt == p->size) {
+        SCMutexUnlock(&p->m);
+        SCFree(rec);
+        (void)SC_ATOMIC_ADD(redis_pipeline_dropped, 1);
+        return -1;
+    }
+    p->records[(p->head + p->cnt) % p->size] = rec;
+    p->cnt++;
+    SCCondSignal(&p->cond);
+    SCMutexUnlock(&p->m);
+    return 0;
+}
+
+static SCLogRedisPipeline *SCLogRedisPipelineNew(LogFileCtx *log_ctx)
+{
+    SCLogRedisPipeline *p = SCCalloc(1, sizeof(*p));
+    if (unlikely(p == NULL))
+        return NULL;
+    p->records = SCCalloc(log_ctx->redis_setup.queue_size,
+                          sizeof(SCLogRedisRecord *));
+    if (p->records == NULL) {
+        SCFree(p);
+        return NULL;
+    }
+    p->size = log_ctx->redis_setup.queue_size;
+    p->log_ctx = log_ctx;
+    p->connections = log_ctx->redis_setup.connections;
+    SCMutexInit(&p->m, NULL);
+    SCCondInit(&p->cond, NULL);
+    return p;
+}
+
+/**
+ * \brief Add a pipelined writer to the ones that get connection threads.
+ */
+static void SCLogRedisPipelineRegister(SCLogRedisPipeline *p)
+{
+    SCMutexLock(&redis_pipelines_lock);
+    p->next = redis_pipelines;
+    redis_pipelines = p;
+    SCMutexUnlock(&redis_pipelines_lock);
+}
+
+/**
+ * \brief Free the pipelined writer.
+ *
+ * The connection threads are stopped by now. Records queued after they
+ * stopped are written from the calling thread, they are dropped if redis
+ * is unavailable.
+ */
+static void SCLogRedisPipelineFree(SCLogRedisPipeline *p)
+{
+    SCMutexLock(&redis_pipelines_lock);
+    SCLogRedisPipeline **pp = &redis_pipelines;
+    while (*pp != NULL && *pp != p)
+        pp = &(*pp)->next;
+    if (*pp != NULL)
+        *pp = p->next;
+    SCMutexUnlock(&redis_pipelines_lock);
+
+    if (p->cnt > 0) {
+        const int batch_size = p->log_ctx->redis_setup.batch_size;
+        SCLogRedisRecord **batch = SCCalloc(batch_size, sizeof(SCLogRedisRecord *));
+        redisContext *redis = batch ? SCLogRedisPipelineConnect(p->log_ctx) : NULL;
+        if (redis != NULL) {
+            int n;
+            while ((n = SCLogRedisPipelineDequeue(p, batch, batch_size)) > 0) {
+                const int r = SCLogRedisPipelineSend(p->log_ctx, redis, batch, n);
+                for (int i = 0; i < n; i++) {
+                    SCFree(batch[i]);
+                    if (r < 0)
+                        (void)SC_ATOMIC_ADD(redis_pipeline_dropped, 1);
+                }
+                if (r < 0)
                     break;
             }
-            freeReplyObject(reply);
-        } else {
-            SCConfLogReopenSyncRedis(file_ctx);
+            redisFree(redis);
         }
+        if (batch != NULL)
+            SCFree(batch);
     }
-    return ret;
+
+    for (uint32_t i = 0; i < p->cnt; i++) {
+        SCFree(p->records[(p->head + i) % p->size]);
+        (void)SC_ATOMIC_ADD(redis_pipeline_dropped, 1);
+    }
+    SCCondDestroy(&p->cond);
+    SCMutexDestroy(&p->m);
+    SCFree(p->records);
+    if (p->tvs != NULL)
+        SCFree(p->tvs);
+    SCFree(p);
 }
 
 /**
@@ -429,6 +814,9 @@ int LogFileWriteRedis(void *lf_ctx, const char *string, size_t string_len)
 #endif
     /* sync mode */
     if (! file_ctx->redis_setup.is_async) {
+        if (((SCLogRedisContext *)file_ctx->redis)->pipeline) {
+            return SCLogRedisWritePipelined(file_ctx, string, string_len);
+        }
         return SCLogRedisWriteSync(file_ctx, string);
     }
     return -1;
@@ -485,13 +873,44 @@ int SCConfLogOpenRedis(ConfNode *redis_node, void *lf_ctx)
             int ret;
             intmax_t val;
             ret = ConfGetChildValueBool(pipelining, "enabled", &enabled);
-            if (ret && enabled) {
-                ret = ConfGetChildValueInt(pipelining, "batch-size", &val);
-                if (ret) {
-                    log_ctx->redis_setup.batch_size = val;
-                } else {
-                    log_ctx->redis_setup.batch_size = 10;
+            if (ret && enabled && is_async) {
+                SCLogWarning(SC_ERR_REDIS_CONFIG, "redis pipelining is not "
+                             "used in async mode");
+            } else if (ret && enabled &&
+                       RunmodeGetCurrent() == RUNMODE_UNIX_SOCKET) {
+                /* the connection threads are management threads, which
+                 * are restarted for every file in unix socket mode */
+                SCLogWarning(SC_ERR_REDIS_CONFIG, "redis pipelining is not "
+                             "used in unix socket mode");
+            } else if (ret && enabled) {
+                intmax_t batch_size = 10, connections = 1, queue_size = 100000;
+                if (ConfGetChildValueInt(pipelining, "batch-size", &val))
+                    batch_size = val;
+                if (ConfGetChildValueInt(pipelining, "connections", &val))
+                    connections = val;
+                if (ConfGetChildValueInt(pipelining, "queue-size", &val))
+                    queue_size = val;
+                if (batch_size <= 0 || batch_size > REDIS_PIPELINE_BATCH_SIZE_MAX) {
+                    SCLogError(SC_ERR_REDIS_CONFIG, "Invalid redis pipelining "
+                               "batch-size %"PRIdMAX", expected 1 to %d",
+                               batch_size, REDIS_PIPELINE_BATCH_SIZE_MAX);
+                    exit(EXIT_FAILURE);
                 }
+                if (connections <= 0 || connections > REDIS_PIPELINE_CONNECTIONS_MAX) {
+                    SCLogError(SC_ERR_REDIS_CONFIG, "Invalid redis pipelining "
+                               "connections %"PRIdMAX", expected 1 to %d",
+                               connections, REDIS_PIPELINE_CONNECTIONS_MAX);
+                    exit(EXIT_FAILURE);
+                }
+                if (queue_size <= 0 || queue_size > REDIS_PIPELINE_QUEUE_SIZE_MAX) {
+                    SCLogError(SC_ERR_REDIS_CONFIG, "Invalid redis pipelining "
+                               "queue-size %"PRIdMAX", expected 1 to %d",
+                               queue_size, REDIS_PIPELINE_QUEUE_SIZE_MAX);
+                    exit(EXIT_FAILURE);
+                }
+                log_ctx->redis_setup.batch_size = (int)batch_size;
+                log_ctx->redis_setup.connections = (int)connections;
+                log_ctx->redis_setup.queue_size = (uint32_t)queue_size;
             }
         }
     } else {
@@ -515,6 +934,7 @@ int SCConfLogOpenRedis(ConfNode *redis_node, void *lf_ctx)
         exit(EXIT_FAILURE);
     }
     log_ctx->redis_setup.port = atoi(redis_port);
+    log_ctx->type = LOGFILE_TYPE_REDIS;
     log_ctx->Close = SCLogFileCloseRedis;
 
 #ifdef HAVE_LIBEVENT
@@ -522,10 +942,43 @@ int SCConfLogOpenRedis(ConfNode *redis_node, void *lf_ctx)
         log_ctx->redis = SCLogRedisContextAsyncAlloc();
     }
 #endif /*HAVE_LIBEVENT*/
-    if (! is_async) {
+    if (log_ctx->redis_setup.batch_size > 0) {
+        log_ctx->redis = SCLogRedisContextAlloc();
+        if (log_ctx->redis == NULL) {
+            return -1;
+        }
+        SCLogRedisPipeline *p = SCLogRedisPipelineNew(log_ctx);
+        if (p == NULL) {
+            SCLogError(SC_ERR_MEM_ALLOC, "Failed to allocate redis pipeline");
+            exit(EXIT_FAILURE);
+        }
+        ((SCLogRedisContext *)log_ctx->redis)->pipeline = p;
+        SCLogRedisPipelineRegister(p);
+
+        static bool counters_registered = false;
+        if (!counters_registered) {
+            StatsRegisterGlobalCounter("output.redis.written",
+                    SCLogRedisWrittenCounter);
+            StatsRegisterGlobalCounter("output.redis.dropped",
+                    SCLogRedisDroppedCounter);
+            StatsRegisterGlobalCounter("output.redis.failed",
+                    SCLogRedisFailedCounter);
+            counters_registered = true;
+        }
+        SCLogConfig("redis pipelining: batch-size %d, %d connection(s), "
+                    "queue-size %u", log_ctx->redis_setup.batch_size,
+                    log_ctx->redis_setup.connections,
+                    log_ctx->redis_setup.queue_size);
+    } else if (! is_async) {
         log_ctx->redis = SCLogRedisContextAlloc();
         SCConfLogReopenSyncRedis(log_ctx);
     }
+
+    /* pipelined redis is already written by its connection threads */
+    if (log_ctx->redis_setup.batch_size == 0 &&
+            RunmodeGetCurrent() != RUNMODE_UNIX_SOCKET) {
+        LogAsyncSetup(log_ctx);
+    }
     return 0;
 }
 
@@ -555,25 +1008,159 @@ void SCLogFileCloseRedis(LogFileCtx *log_ctx)
 
     /* synchronous */
     if (!log_ctx->redis_setup.is_async) {
+        if (ctx->pipeline) {
+            SCLogRedisPipelineFree(ctx->pipeline);
+            ctx->pipeline = NULL;
+        }
         if (ctx->sync) {
-            redisReply *reply;
-            int i;
-            for (i = 0; i < ctx->batch_count; i++) {
-                redisGetReply(ctx->sync, (void **)&reply);
-                if (reply) {
-                    freeReplyObject(reply);
-                }
-            }
             redisFree(ctx->sync);
             ctx->sync = NULL;
         }
         ctx->tried = 0;
-        ctx->batch_count = 0;
     }
 
     if (ctx != NULL) {
         SCFree(ctx);
     }
+    log_ctx->redis = NULL;
+}
+
+
+#ifdef UNITTESTS
+static LogFileCtx *SCLogRedisTestPipelineCtx(uint32_t queue_size, int batch_size)
+{
+    LogFileCtx *log_ctx = LogFileNewCtx();
+    if (log_ctx == NULL)
+        return NULL;
+    log_ctx->type = LOGFILE_TYPE_REDIS;
+    log_ctx->redis_setup.command = redis_lpush_cmd;
+    log_ctx->redis_setup.key = redis_default_key;
+    log_ctx->redis_setup.batch_size = batch_size;
+    log_ctx->redis_setup.connections = 1;
+    log_ctx->redis_setup.queue_size = queue_size;
+    log_ctx->redis_setup.server = redis_default_server;
+    /* nothing listens there, connecting fails */
+    log_ctx->redis_setup.port = 1;
+    log_ctx->Close = SCLogFileCloseRedis;
+
+    SCLogRedisContext *ctx = SCLogRedisContextAlloc();
+    ctx->pipeline = SCLogRedisPipelineNew(log_ctx);
+    if (ctx->pipeline == NULL) {
+        SCFree(ctx);
+        LogFileFreeCtx(log_ctx);
+        return NULL;
+    }
+    log_ctx->redis = ctx;
+    return log_ctx;
+}
+
+static int SCLogRedisTestWrite(LogFileCtx *log_ctx, int i)
+{
+    char rec[32];
+    int len = snprintf(rec, sizeof(rec), "{\"record\":%d}", i);
+    return LogFileWriteRedis(log_ctx, rec, len);
+}
+
+/** \brief check that a batch holds the records first to first + n - 1 */
+static int SCLogRedisTestBatch(SCLogRedisRecord **batch, int n, int first)
+{
+    for (int i = 0; i < n; i++) {
+        char rec[32];
+        int len = snprintf(rec, sizeof(rec), "{\"record\":%d}", first + i);
+        if (batch[i]->len != (size_t)len || memcmp(batch[i]->data, rec, len) != 0)
+            return 0;
+        SCFree(batch[i]);
+    }
+    return 1;
+}
+
+/** \test the queue keeps the records in order and drops records when
+ *        it is full */
+static int SCLogRedisTest01(void)
+{
+    LogFileCtx *log_ctx = SCLogRedisTestPipelineCtx(4, 10);
+    FAIL_IF_NULL(log_ctx);
+    SCLogRedisPipeline *p = ((SCLogRedisContext *)log_ctx->redis)->pipeline;
+    SCLogRedisRecord *batch[10];
+
+    const uint64_t dropped = SC_ATOMIC_GET(redis_pipeline_dropped);
+    for (int i = 0; i < 4; i++) {
+        FAIL_IF(SCLogRedisTestWrite(log_ctx, i) != 0);
+    }
+    FAIL_IF(SCLogRedisTestWrite(log_ctx, 4) != -1);
+    FAIL_IF(SC_ATOMIC_GET(redis_pipeline_dropped) != dropped + 1);
+
+    FAIL_IF(SCLogRedisPipelineDequeue(p, batch, 10) != 4);
+    FAIL_IF_NOT(SCLogRedisTestBatch(batch, 4, 0));
+    FAIL_IF(SCLogRedisPipelineDequeue(p, batch, 10) != 0);
+
+    /* wrap around the end of the ring */
+    for (int i = 10; i < 13; i++) {
+        FAIL_IF(SCLogRedisTestWrite(log_ctx, i) != 0);
+    }
+    FAIL_IF(SCLogRedisPipelineDequeue(p, batch, 2) != 2);
+    FAIL_IF_NOT(SCLogRedisTestBatch(batch, 2, 10));
+    for (int i = 13; i < 16; i++) {
+        FAIL_IF(SCLogRedisTestWrite(log_ctx, i) != 0);
+    }
+    FAIL_IF(SCLogRedisTestWrite(log_ctx, 16) != -1);
+    FAIL_IF(SCLogRedisPipelineDequeue(p, batch, 10) != 4);
+    FAIL_IF_NOT(SCLogRedisTestBatch(batch, 4, 12));
+    FAIL_IF(p->cnt != 0);
+
+    LogFileFreeCtx(log_ctx);
+    PASS;
+}
+
+/** \test the queued records are taken in batches of at most batch-size */
+static int SCLogRedisTest02(void)
+{
+    LogFileCtx *log_ctx = SCLogRedisTestPipelineCtx(100, 3);
+    FAIL_IF_NULL(log_ctx);
+    SCLogRedisPipeline *p = ((SCLogRedisContext *)log_ctx->redis)->pipeline;
+    const int batch_size = log_ctx->redis_setup.batch_size;
+    SCLogRedisRecord *batch[3];
+
+    for (int i = 0; i < 7; i++) {
+        FAIL_IF(SCLogRedisTestWrite(log_ctx, i) != 0);
+    }
+    FAIL_IF(SCLogRedisPipelineDequeue(p, batch, batch_size) != 3);
+    FAIL_IF_NOT(SCLogRedisTestBatch(batch, 3, 0));
+    FAIL_IF(SCLogRedisPipelineDequeue(p, batch, batch_size) != 3);
+    FAIL_IF_NOT(SCLogRedisTestBatch(batch, 3, 3));
+    FAIL_IF(SCLogRedisPipelineDequeue(p, batch, batch_size) != 1);
+    FAIL_IF_NOT(SCLogRedisTestBatch(batch, 1, 6));
+    FAIL_IF(SCLogRedisPipelineDequeue(p, batch, batch_size) != 0);
+
+    LogFileFreeCtx(log_ctx);
+    PASS;
+}
+/** \test records still queued when the output is freed are counted as
+ *        dropped if redis is unavailable */
+static int SCLogRedisTest03(void)
+{
+    LogFileCtx *log_ctx = SCLogRedisTestPipelineCtx(100, 3);
+    FAIL_IF_NULL(log_ctx);
+
+    const uint64_t dropped = SC_ATOMIC_GET(redis_pipeline_dropped);
+    for (int i = 0; i < 5; i++) {
+        FAIL_IF(SCLogRedisTestWrite(log_ctx, i) != 0);
+    }
+    FAIL_IF(SC_ATOMIC_GET(redis_pipeline_dropped) != dropped);
+
+    LogFileFreeCtx(log_ctx);
+    FAIL_IF(SC_ATOMIC_GET(redis_pipeline_dropped) != dropped + 5);
+    PASS;
+}
+#endif /* UNITTESTS */
+
+void SCLogRedisRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("SCLogRedisTest01", SCLogRedisTest01);
+    UtRegisterTest("SCLogRedisTest02", SCLogRedisTest02);
+    UtRegisterTest("SCLogRedisTest03", SCLogRedisTest03);
+#endif /* UNITTESTS */
 }
 
 #endif //#ifdef HAVE_LIBHIREDIS
@@ -43,7 +43,13 @@ typedef struct RedisSetup_ {
     const char *server;
     int  port;
     int is_async;
+    /** max number of records per pipelined round trip, 0 if records are
+     *  written one at a time */
     int  batch_size;
+    /** connections of the pipelined writer */
+    int  connections;
+    /** max number of records queued for the pipelined writer */
+    uint32_t queue_size;
 } RedisSetup;
 
 typedef struct SCLogRedisContext_ {
@@ -54,12 +60,15 @@ typedef struct SCLogRedisContext_ {
     int connected;
 #endif /* HAVE_LIBEVENT */
     time_t tried;
-    int  batch_count;
+    /** queue and connections of the pipelined writer */
+    struct SCLogRedisPipeline_ *pipeline;
 } SCLogRedisContext;
 
 void SCLogRedisInit(void);
 int SCConfLogOpenRedis(ConfNode *, void *);
 int LogFileWriteRedis(void *, const char *, size_t);
+void SCLogRedisPipelineSpawn(void);
+void SCLogRedisRegisterTests(void);
 
 #endif /* HAVE_LIBHIREDIS */
 #endif /* __UTIL_LOG_REDIS_H__ */
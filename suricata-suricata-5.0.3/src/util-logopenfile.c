@@ -31,6 +31,7 @@
 #include "util-byte.h"
 #include "util-path.h"
 #include "util-logopenfile.h"
+#include "util-log-async.h"
 
 #if defined(HAVE_SYS_UN_H) && defined(HAVE_SYS_SOCKET_H) && defined(HAVE_SYS_TYPES_H)
 #define BUILD_WITH_UNIXSOCKET
@@ -43,6 +44,89 @@
 #include "util-log-redis.h"
 #endif /* HAVE_LIBHIREDIS */
 
+#ifdef HAVE_LIBLZ4
+#include <lz4frame.h>
+#endif /* HAVE_LIBLZ4 */
+
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif /* HAVE_LIBZSTD */
+
+#include "util-misc.h"
+#include "util-privs.h"
+#include "tm-threads.h"
+#include "runmodes.h"
+#include <sys/uio.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/* seconds between flushes of the per thread write buffers */
+#define LOGFILE_FLUSH_INTERVAL  1
+/* number of buffered ctxs a thread remembers its buffer for */
+#define LOGFILE_TB_CACHE_SIZE   8
+/* per thread buffer size of compressed files without a buffer-size */
+#define LOGFILE_COMPRESS_BUFFER_SIZE    (1024 * 1024)
+
+#if defined(HAVE_LIBLZ4) && !defined(LZ4F_HEADER_SIZE_MAX)
+#define LZ4F_HEADER_SIZE_MAX    19
+#endif
+
+/** per thread write buffer of a buffered LogFileCtx */
+typedef struct LogFileThreadBuffer_ {
+    /* taken by the owning thread while it appends or writes out */
+    SCMutex m;
+    unsigned long thread_id;
+
+    char *buf;
+    size_t len;
+
+    /* second buffer. Only one of spare, full and out is set: the
+     * spare is swapped in when the flusher takes the buffer, or when
+     * the thread hands a full buffer over to the flusher. */
+    char *spare;
+    char *full;
+    size_t full_len;
+    char *out;
+    size_t out_len;
+
+    struct LogFileThreadBuffer_ *next;
+} LogFileThreadBuffer;
+
+typedef struct LogFileBufferedCtx_ {
+    LogFileCtx *log_ctx;
+    TAILQ_ENTRY(LogFileBufferedCtx_) next;
+} LogFileBufferedCtx;
+
+/* buffered ctxs, flushed by the flusher thread */
+static TAILQ_HEAD(, LogFileBufferedCtx_) logfile_buffered_ctxs =
+    TAILQ_HEAD_INITIALIZER(logfile_buffered_ctxs);
+static SCMutex logfile_buffered_lock = SCMUTEX_INITIALIZER;
+static uint32_t logfile_buffer_gen = 0;
+static ThreadVars *logfile_flusher_tv = NULL;
+
+/** compression state of a compressed LogFileCtx */
+typedef struct LogFileCompressor_ {
+#ifdef HAVE_LIBLZ4
+    LZ4F_compressionContext_t lz4f_context;
+    LZ4F_preferences_t lz4f_prefs;
+#endif /* HAVE_LIBLZ4 */
+#ifdef HAVE_LIBZSTD
+    ZSTD_CCtx *zstd_context;
+#endif /* HAVE_LIBZSTD */
+    /* output of the last batch */
+    uint8_t *buf;
+    size_t size;
+} LogFileCompressor;
+
+static __thread struct {
+    const LogFileCtx *log_ctx;
+    uint32_t gen;
+    LogFileThreadBuffer *tb;
+} logfile_tb_cache[LOGFILE_TB_CACHE_SIZE];
+static __thread int logfile_tb_cache_next;
+
 #ifdef BUILD_WITH_UNIXSOCKET
 /** \brief connect to the indicated local stream socket, logging any errors
  *  \param path filesystem path to connect to
@@ -177,6 +261,27 @@ tryagain:
 }
 #endif /* BUILD_WITH_UNIXSOCKET */
 
+/**
+ * \brief Reopen the log file if a rotation is due.
+ *
+ * Must be called with fp_mutex held.
+ */
+static void SCLogFileCheckRotation(LogFileCtx *log_ctx)
+{
+    if (log_ctx->rotation_flag) {
+        log_ctx->rotation_flag = 0;
+        SCConfLogReopen(log_ctx);
+    }
+
+    if (log_ctx->flags & LOGFILE_ROTATE_INTERVAL) {
+        time_t now = time(NULL);
+        if (now >= log_ctx->rotate_time) {
+            SCConfLogReopen(log_ctx);
+            log_ctx->rotate_time = now + log_ctx->rotate_interval;
+        }
+    }
+}
+
 /**
  * \brief Write buffer to log file.
  * \retval 0 on failure; otherwise, the return value of fwrite (number of
@@ -194,19 +299,7 @@ static int SCLogFileWrite(const char *buffer, int buffer_len, LogFileCtx *log_ct
 #endif
     {
 
-        /* Check for rotation. */
-        if (log_ctx->rotation_flag) {
-            log_ctx->rotation_flag = 0;
-            SCConfLogReopen(log_ctx);
-        }
-
-        if (log_ctx->flags & LOGFILE_ROTATE_INTERVAL) {
-            time_t now = time(NULL);
-            if (now >= log_ctx->rotate_time) {
-                SCConfLogReopen(log_ctx);
-                log_ctx->rotate_time = now + log_ctx->rotate_interval;
-            }
-        }
+        SCLogFileCheckRotation(log_ctx);
 
         if (log_ctx->fp) {
             clearerr(log_ctx->fp);
@@ -220,6 +313,627 @@ static int SCLogFileWrite(const char *buffer, int buffer_len, LogFileCtx *log_ct
     return ret;
 }
 
+/**
+ * \brief Set up the compression of a regular file.
+ *
+ * \retval 0 on success
+ * \retval -1 on error
+ */
+static int LogFileCompressorSetup(ConfNode *conf, LogFileCtx *log_ctx,
+                                  const char *compression)
+{
+    intmax_t level = 0;
+    const int have_level = ConfGetChildValueInt(conf, "compression-level", &level);
+
+    LogFileCompressor *c = SCCalloc(1, sizeof(*c));
+    if (unlikely(c == NULL))
+        return -1;
+
+    if (strcmp(compression, "lz4") == 0) {
+#ifdef HAVE_LIBLZ4
+        LZ4F_errorCode_t errcode =
+            LZ4F_createCompressionContext(&c->lz4f_context, LZ4F_VERSION);
+        if (LZ4F_isError(errcode)) {
+            SCLogError(SC_ERR_MEM_ALLOC, "LZ4F_createCompressionContext "
+                       "failed: %s", LZ4F_getErrorName(errcode));
+            SCFree(c);
+            return -1;
+        }
+        memset(&c->lz4f_prefs, 0, sizeof(c->lz4f_prefs));
+        c->lz4f_prefs.frameInfo.blockSizeID = LZ4F_max256KB;
+        c->lz4f_prefs.frameInfo.blockMode = LZ4F_blockLinked;
+        if (have_level)
+            c->lz4f_prefs.compressionLevel = (int)level;
+        log_ctx->compression = LOGFILE_COMPRESSION_LZ4;
+#else
+        SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "%s.compression: lz4 "
+                   "requires Suricata to be built with liblz4", conf->name);
+        SCFree(c);
+        return -1;
+#endif /* HAVE_LIBLZ4 */
+    } else if (strcmp(compression, "zstd") == 0) {
+#ifdef HAVE_LIBZSTD
+        c->zstd_context = ZSTD_createCCtx();
+        if (c->zstd_context == NULL) {
+            SCLogError(SC_ERR_MEM_ALLOC, "ZSTD_createCCtx failed");
+            SCFree(c);
+            return -1;
+        }
+        if (have_level) {
+            size_t r = ZSTD_CCtx_setParameter(c->zstd_context,
+                    ZSTD_c_compressionLevel, (int)level);
+            if (ZSTD_isError(r)) {
+                SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "invalid value "
+                           "for %s.compression-level: %s", conf->name,
+                           ZSTD_getErrorName(r));
+                ZSTD_freeCCtx(c->zstd_context);
+                SCFree(c);
+                return -1;
+            }
+        }
+        log_ctx->compression = LOGFILE_COMPRESSION_ZSTD;
+#else
+        SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "%s.compression: zstd "
+                   "requires Suricata to be built with libzstd", conf->name);
+        SCFree(c);
+        return -1;
+#endif /* HAVE_LIBZSTD */
+    } else {
+        SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "invalid value for "
+                   "%s.compression: %s. Expected \"none\", \"lz4\" or "
+                   "\"zstd\"", conf->name, compression);
+        SCFree(c);
+        return -1;
+    }
+
+    log_ctx->compressor = c;
+    return 0;
+}
+
+static void LogFileCompressorFree(LogFileCtx *log_ctx)
+{
+    LogFileCompressor *c = log_ctx->compressor;
+#ifdef HAVE_LIBLZ4
+    if (log_ctx->compression == LOGFILE_COMPRESSION_LZ4)
+        LZ4F_freeCompressionContext(c->lz4f_context);
+#endif /* HAVE_LIBLZ4 */
+#ifdef HAVE_LIBZSTD
+    if (log_ctx->compression == LOGFILE_COMPRESSION_ZSTD)
+        ZSTD_freeCCtx(c->zstd_context);
+#endif /* HAVE_LIBZSTD */
+    if (c->buf != NULL)
+        SCFree(c->buf);
+    SCFree(c);
+    log_ctx->compressor = NULL;
+}
+
+#ifdef HAVE_LIBLZ4
+static int LogFileCompressLz4(LogFileCompressor *c, const struct iovec *iov,
+                              int iovcnt, size_t *len)
+{
+    size_t r = LZ4F_compressBegin(c->lz4f_context, c->buf, c->size,
+                                  &c->lz4f_prefs);
+    if (LZ4F_isError(r))
+        goto error;
+    size_t off = r;
+
+    for (int i = 0; i < iovcnt; i++) {
+        r = LZ4F_compressUpdate(c->lz4f_context, c->buf + off,
+                c->size - off, iov[i].iov_base, iov[i].iov_len, NULL);
+        if (LZ4F_isError(r))
+            goto error;
+        off += r;
+    }
+
+    r = LZ4F_compressEnd(c->lz4f_context, c->buf + off, c->size - off, NULL);
+    if (LZ4F_isError(r))
+        goto error;
+    *len = off + r;
+    return 0;
+
+error:
+    SCLogDebug("lz4 compression failed: %s", LZ4F_getErrorName(r));
+    return -1;
+}
+#endif /* HAVE_LIBLZ4 */
+
+#ifdef HAVE_LIBZSTD
+static int LogFileCompressZstd(LogFileCompressor *c, const struct iovec *iov,
+                               int iovcnt, size_t *len)
+{
+    ZSTD_outBuffer out = { c->buf, c->size, 0 };
+    size_t r;
+
+    for (int i = 0; i < iovcnt; i++) {
+        ZSTD_inBuffer in = { iov[i].iov_base, iov[i].iov_len, 0 };
+        while (in.pos < in.size) {
+            r = ZSTD_compressStream2(c->zstd_context, &out, &in, ZSTD_e_continue);
+            if (ZSTD_isError(r) || out.pos == out.size)
+                goto error;
+        }
+    }
+
+    ZSTD_inBuffer in = { NULL, 0, 0 };
+    do {
+        r = ZSTD_compressStream2(c->zstd_context, &out, &in, ZSTD_e_end);
+        if (ZSTD_isError(r) || (r != 0 && out.pos == out.size))
+            goto error;
+    } while (r != 0);
+
+    *len = out.pos;
+    return 0;
+
+error:
+    SCLogDebug("zstd compression failed");
+    /* drop the unfinished frame */
+    ZSTD_CCtx_reset(c->zstd_context, ZSTD_reset_session_only);
+    return -1;
+}
+#endif /* HAVE_LIBZSTD */
+
+/**
+ * \brief Compress the iovecs into one frame.
+ *
+ * Must be called with fp_mutex held.
+ *
+ * \retval 0 on success, the frame is in iov_out
+ * \retval -1 on error
+ */
+static int LogFileCompress(LogFileCtx *log_ctx, const struct iovec *iov,
+                           int iovcnt, struct iovec *iov_out)
+{
+    LogFileCompressor *c = log_ctx->compressor;
+    size_t bound = 0;
+    size_t len = 0;
+    int r = -1;
+
+#ifdef HAVE_LIBLZ4
+    if (log_ctx->compression == LOGFILE_COMPRESSION_LZ4) {
+        bound = LZ4F_HEADER_SIZE_MAX + LZ4F_compressBound(0, &c->lz4f_prefs);
+        for (int i = 0; i < iovcnt; i++)
+            bound += LZ4F_compressBound(iov[i].iov_len, &c->lz4f_prefs);
+    }
+#endif /* HAVE_LIBLZ4 */
+#ifdef HAVE_LIBZSTD
+    if (log_ctx->compression == LOGFILE_COMPRESSION_ZSTD) {
+        size_t total = 0;
+        for (int i = 0; i < iovcnt; i++)
+            total += iov[i].iov_len;
+        bound = ZSTD_compressBound(total) + ZSTD_CStreamOutSize();
+    }
+#endif /* HAVE_LIBZSTD */
+
+    if (bound > c->size) {
+        uint8_t *buf = SCRealloc(c->buf, bound);
+        if (unlikely(buf == NULL))
+            return -1;
+        c->buf = buf;
+        c->size = bound;
+    }
+
+#ifdef HAVE_LIBLZ4
+    if (log_ctx->compression == LOGFILE_COMPRESSION_LZ4)
+        r = LogFileCompressLz4(c, iov, iovcnt, &len);
+#endif /* HAVE_LIBLZ4 */
+#ifdef HAVE_LIBZSTD
+    if (log_ctx->compression == LOGFILE_COMPRESSION_ZSTD)
+        r = LogFileCompressZstd(c, iov, iovcnt, &len);
+#endif /* HAVE_LIBZSTD */
+    if (r < 0)
+        return -1;
+
+    iov_out->iov_base = c->buf;
+    iov_out->iov_len = len;
+    return 0;
+}
+
+/**
+ * \brief Write the iovecs to the log file of a buffered ctx.
+ *
+ * Must be called with fp_mutex held.
+ */
+static void SCLogFileWriteOut(LogFileCtx *log_ctx, struct iovec *iov, int iovcnt)
+{
+    SCLogFileCheckRotation(log_ctx);
+    if (log_ctx->fp == NULL)
+        return;
+
+    struct iovec frame;
+    if (log_ctx->compressor != NULL) {
+        if (LogFileCompress(log_ctx, iov, iovcnt, &frame) < 0)
+            return;
+        iov = &frame;
+        iovcnt = 1;
+    }
+
+    const int fd = fileno(log_ctx->fp);
+    while (iovcnt > 0) {
+        ssize_t r = writev(fd, iov, MIN(iovcnt, IOV_MAX));
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            SCLogDebug("writing to %s failed: %s", log_ctx->filename,
+                       strerror(errno));
+            return;
+        }
+        /* skip what was written, a short write continues mid iovec */
+        while (iovcnt > 0 && (size_t)r >= iov->iov_len) {
+            r -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + r;
+            iov->iov_len -= r;
+        }
+    }
+}
+
+/**
+ * \brief Wake up the flusher thread to write out a full buffer.
+ */
+static void LogFileFlusherWakeup(void)
+{
+    ThreadVars *tv = logfile_flusher_tv;
+    if (tv != NULL) {
+        SCCtrlCondSignal(tv->ctrl_cond);
+    }
+}
+
+/**
+ * \brief Get the write buffer of the calling thread, creating it on first use.
+ */
+static LogFileThreadBuffer *LogFileGetThreadBuffer(LogFileCtx *log_ctx)
+{
+    for (int i = 0; i < LOGFILE_TB_CACHE_SIZE; i++) {
+        if (logfile_tb_cache[i].log_ctx == log_ctx &&
+            logfile_tb_cache[i].gen == log_ctx->buffer_gen)
+            return logfile_tb_cache[i].tb;
+    }
+
+    const unsigned long thread_id = SCGetThreadIdLong();
+    LogFileThreadBuffer *tb;
+
+    SCMutexLock(&log_ctx->fp_mutex);
+    for (tb = log_ctx->thread_buffers; tb != NULL; tb = tb->next) {
+        if (tb->thread_id == thread_id)
+            break;
+    }
+    if (tb == NULL) {
+        tb = SCCalloc(1, sizeof(*tb));
+        if (tb != NULL) {
+            tb->buf = SCMalloc(log_ctx->buffer_size);
+            tb->spare = SCMalloc(log_ctx->buffer_size);
+            if (tb->buf == NULL || tb->spare == NULL) {
+                if (tb->buf != NULL)
+                    SCFree(tb->buf);
+                if (tb->spare != NULL)
+                    SCFree(tb->spare);
+                SCFree(tb);
+                tb = NULL;
+            } else {
+                SCMutexInit(&tb->m, NULL);
+                tb->thread_id = thread_id;
+                tb->next = log_ctx->thread_buffers;
+                log_ctx->thread_buffers = tb;
+            }
+        }
+    }
+    SCMutexUnlock(&log_ctx->fp_mutex);
+
+    if (tb != NULL) {
+        int i = logfile_tb_cache_next++ % LOGFILE_TB_CACHE_SIZE;
+        logfile_tb_cache[i].log_ctx = log_ctx;
+        logfile_tb_cache[i].gen = log_ctx->buffer_gen;
+        logfile_tb_cache[i].tb = tb;
+    }
+    return tb;
+}
+
+/**
+ * \brief Write to a log file in buffered mode.
+ *
+ * The record is added to the buffer of the calling thread. A full buffer
+ * is handed over to the flusher thread, the others are written out every
+ * LOGFILE_FLUSH_INTERVAL seconds by the flusher. If the flusher still has
+ * the previous buffer, the thread writes out the full one itself.
+ */
+static int SCLogFileWriteBuffered(const char *buffer, int buffer_len, LogFileCtx *log_ctx)
+{
+    LogFileThreadBuffer *tb = LogFileGetThreadBuffer(log_ctx);
+    if (unlikely(tb == NULL)) {
+        struct iovec iov = { (void *)buffer, buffer_len };
+        SCMutexLock(&log_ctx->fp_mutex);
+        SCLogFileWriteOut(log_ctx, &iov, 1);
+        SCMutexUnlock(&log_ctx->fp_mutex);
+        return 1;
+    }
+
+    SCMutexLock(&tb->m);
+    if (tb->len + buffer_len > log_ctx->buffer_size) {
+        /* records bigger than the buffer are written directly */
+        const bool direct = ((size_t)buffer_len > log_ctx->buffer_size);
+
+        if (!direct && tb->spare != NULL) {
+            /* hand the full buffer over to the flusher */
+            tb->full = tb->buf;
+            tb->full_len = tb->len;
+            tb->buf = tb->spare;
+            tb->spare = NULL;
+            tb->len = 0;
+            LogFileFlusherWakeup();
+        } else {
+            struct iovec iov[3];
+            int iovcnt = 0;
+            if (tb->full != NULL) {
+                iov[iovcnt].iov_base = tb->full;
+                iov[iovcnt].iov_len = tb->full_len;
+                iovcnt++;
+            }
+            if (tb->len > 0) {
+                iov[iovcnt].iov_base = tb->buf;
+                iov[iovcnt].iov_len = tb->len;
+                iovcnt++;
+            }
+            if (direct) {
+                iov[iovcnt].iov_base = (void *)buffer;
+                iov[iovcnt].iov_len = buffer_len;
+                iovcnt++;
+            }
+
+            SCMutexLock(&log_ctx->fp_mutex);
+            SCLogFileWriteOut(log_ctx, iov, iovcnt);
+            SCMutexUnlock(&log_ctx->fp_mutex);
+            tb->len = 0;
+            if (tb->full != NULL) {
+                tb->spare = tb->full;
+                tb->full = NULL;
+            }
+
+            if (direct) {
+                SCMutexUnlock(&tb->m);
+                return 1;
+            }
+        }
+    }
+    memcpy(tb->buf + tb->len, buffer, buffer_len);
+    tb->len += buffer_len;
+    SCMutexUnlock(&tb->m);
+
+    return 1;
+}
+
+/**
+ * \brief Write out the thread buffers of a buffered ctx in one batch.
+ *
+ * Threads keep appending to their spare buffer meanwhile. The file lock
+ * is held while the buffers are taken, so a thread that writes out its
+ * own full buffer can't get ahead of the batch. A thread holding its
+ * buffer lock is skipped, it's writing out itself.
+ *
+ * \param full_only only write out the buffers handed over by the threads
+ */
+static void LogFileFlush(LogFileCtx *log_ctx, bool full_only)
+{
+    LogFileThreadBuffer *tb;
+    int cnt = 0;
+
+    SCMutexLock(&log_ctx->fp_mutex);
+    for (tb = log_ctx->thread_buffers; tb != NULL; tb = tb->next) {
+        cnt++;
+    }
+    struct iovec *iov = cnt ? SCMalloc(cnt * sizeof(struct iovec)) : NULL;
+    if (iov == NULL) {
+        SCMutexUnlock(&log_ctx->fp_mutex);
+        return;
+    }
+
+    int iovcnt = 0;
+    for (tb = log_ctx->thread_buffers; tb != NULL; tb = tb->next) {
+        if (SCMutexTrylock(&tb->m) != 0)
+            continue;
+        if (tb->full != NULL) {
+            /* the partial buffer stays, it's written out next time */
+            tb->out = tb->full;
+            tb->out_len = tb->full_len;
+            tb->full = NULL;
+
+            iov[iovcnt].iov_base = tb->out;
+            iov[iovcnt].iov_len = tb->out_len;
+            iovcnt++;
+        } else if (!full_only && tb->len > 0 && tb->spare != NULL) {
+            tb->out = tb->buf;
+            tb->out_len = tb->len;
+            tb->buf = tb->spare;
+            tb->spare = NULL;
+            tb->len = 0;
+
+            iov[iovcnt].iov_base = tb->out;
+            iov[iovcnt].iov_len = tb->out_len;
+            iovcnt++;
+        }
+        SCMutexUnlock(&tb->m);
+    }
+
+    if (iovcnt > 0)
+        SCLogFileWriteOut(log_ctx, iov, iovcnt);
+    /* the list only grows at the head, so the buffers we took are
+     * all reachable from here */
+    LogFileThreadBuffer *head = log_ctx->thread_buffers;
+    SCMutexUnlock(&log_ctx->fp_mutex);
+    SCFree(iov);
+
+    for (tb = head; tb != NULL; tb = tb->next) {
+        if (tb->out == NULL)
+            continue;
+        SCMutexLock(&tb->m);
+        tb->spare = tb->out;
+        tb->out = NULL;
+        SCMutexUnlock(&tb->m);
+    }
+}
+
+/**
+ * \brief Switch a regular file ctx to buffered writes.
+ */
+static void LogFileSetupBuffered(LogFileCtx *log_ctx, size_t buffer_size)
+{
+    LogFileBufferedCtx *entry = SCCalloc(1, sizeof(*entry));
+    if (entry == NULL) {
+        SCLogWarning(SC_ERR_MEM_ALLOC, "failed to set up buffered writes "
+                     "for %s", log_ctx->filename);
+        return;
+    }
+    entry->log_ctx = log_ctx;
+
+    log_ctx->buffer_size = buffer_size;
+    log_ctx->Write = SCLogFileWriteBuffered;
+
+    SCMutexLock(&logfile_buffered_lock);
+    log_ctx->buffer_gen = ++logfile_buffer_gen;
+    TAILQ_INSERT_TAIL(&logfile_buffered_ctxs, entry, next);
+    SCMutexUnlock(&logfile_buffered_lock);
+}
+
+/**
+ * \brief Write out and free the thread buffers of a buffered ctx.
+ */
+static void LogFileCleanupBuffered(LogFileCtx *log_ctx)
+{
+    LogFileBufferedCtx *entry;
+
+    SCMutexLock(&logfile_buffered_lock);
+    TAILQ_FOREACH(entry, &logfile_buffered_ctxs, next) {
+        if (entry->log_ctx == log_ctx) {
+            TAILQ_REMOVE(&logfile_buffered_ctxs, entry, next);
+            SCFree(entry);
+            break;
+        }
+    }
+    SCMutexUnlock(&logfile_buffered_lock);
+
+    LogFileFlush(log_ctx, false);
+
+    LogFileThreadBuffer *tb = log_ctx->thread_buffers;
+    while (tb != NULL) {
+        LogFileThreadBuffer *next = tb->next;
+        /* a thread may have filled its spare buffer meanwhile */
+        struct iovec iov[2];
+        int iovcnt = 0;
+        if (tb->full != NULL) {
+            iov[iovcnt].iov_base = tb->full;
+            iov[iovcnt].iov_len = tb->full_len;
+            iovcnt++;
+        }
+        if (tb->len > 0) {
+            iov[iovcnt].iov_base = tb->buf;
+            iov[iovcnt].iov_len = tb->len;
+            iovcnt++;
+        }
+        if (iovcnt > 0) {
+            SCMutexLock(&log_ctx->fp_mutex);
+            SCLogFileWriteOut(log_ctx, iov, iovcnt);
+            SCMutexUnlock(&log_ctx->fp_mutex);
+        }
+        SCMutexDestroy(&tb->m);
+        SCFree(tb->buf);
+        if (tb->spare != NULL)
+            SCFree(tb->spare);
+        if (tb->full != NULL)
+            SCFree(tb->full);
+        SCFree(tb);
+        tb = next;
+    }
+    log_ctx->thread_buffers = NULL;
+}
+
+static void *LogFileFlusherThread(void *arg)
+{
+    ThreadVars *tv = (ThreadVars *)arg;
+
+    if (SCSetThreadName(tv->name) < 0) {
+        SCLogWarning(SC_ERR_THREAD_INIT, "Unable to set thread name");
+    }
+
+    if (tv->thread_setup_flags != 0)
+        TmThreadSetupOptions(tv);
+
+    tv->cap_flags = 0;
+    SCDropCaps(tv);
+
+    struct timeval next_flush;
+    gettimeofday(&next_flush, NULL);
+    next_flush.tv_sec += LOGFILE_FLUSH_INTERVAL;
+
+    TmThreadsSetFlag(tv, THV_INIT_DONE);
+    while (1) {
+        if (TmThreadsCheckFlag(tv, THV_PAUSE)) {
+            TmThreadsSetFlag(tv, THV_PAUSED);
+            TmThreadTestThreadUnPaused(tv);
+            TmThreadsUnsetFlag(tv, THV_PAUSED);
+        }
+
+        struct timespec cond_time = FROM_TIMEVAL(next_flush);
+
+        /* wait for the set time, or until we are woken up by a thread
+         * with a full buffer or by the shutdown procedure */
+        SCCtrlMutexLock(tv->ctrl_mutex);
+        SCCtrlCondTimedwait(tv->ctrl_cond, tv->ctrl_mutex, &cond_time);
+        SCCtrlMutexUnlock(tv->ctrl_mutex);
+
+        const bool kill = TmThreadsCheckFlag(tv, THV_KILL);
+
+        struct timeval cur_timev;
+        gettimeofday(&cur_timev, NULL);
+        const bool full_only = !kill && timercmp(&cur_timev, &next_flush, <);
+        if (!full_only) {
+            next_flush = cur_timev;
+            next_flush.tv_sec += LOGFILE_FLUSH_INTERVAL;
+        }
+
+        LogFileBufferedCtx *entry;
+        SCMutexLock(&logfile_buffered_lock);
+        TAILQ_FOREACH(entry, &logfile_buffered_ctxs, next) {
+            LogFileFlush(entry->log_ctx, full_only);
+        }
+        SCMutexUnlock(&logfile_buffered_lock);
+
+        if (kill) {
+            break;
+        }
+    }
+
+    TmThreadsSetFlag(tv, THV_RUNNING_DONE);
+    TmThreadWaitForFlag(tv, THV_DEINIT);
+    TmThreadsSetFlag(tv, THV_CLOSED);
+    return NULL;
+}
+
+/**
+ * \brief Spawn the thread flushing the buffers of buffered log files.
+ */
+void LogFileFlusherSpawn(void)
+{
+    SCMutexLock(&logfile_buffered_lock);
+    const bool needed = !TAILQ_EMPTY(&logfile_buffered_ctxs);
+    SCMutexUnlock(&logfile_buffered_lock);
+    if (!needed)
+        return;
+
+    ThreadVars *tv = TmThreadCreateMgmtThread(thread_name_log_flusher,
+                                              LogFileFlusherThread, 1);
+    if (tv == NULL) {
+        SCLogError(SC_ERR_THREAD_CREATE, "TmThreadCreateMgmtThread failed");
+        exit(EXIT_FAILURE);
+    }
+    if (TmThreadSpawn(tv) != 0) {
+        SCLogError(SC_ERR_THREAD_SPAWN, "TmThreadSpawn failed for "
+                   "LogFileFlusherThread");
+        exit(EXIT_FAILURE);
+    }
+    logfile_flusher_tv = tv;
+}
+
 /** \brief generate filename based on pattern
  *  \param pattern pattern to use
  *  \retval char* on success
@@ -463,6 +1177,58 @@ SCConfLogOpenGeneric(ConfNode *conf,
         return -1;
     }
 
+    const char *buffer_size = ConfNodeLookupChildValue(conf, "buffer-size");
+    if (buffer_size != NULL) {
+        uint64_t size = 0;
+        if (ParseSizeStringU64(buffer_size, &size) < 0) {
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "invalid value for "
+                       "%s.buffer-size: %s", conf->name, buffer_size);
+            return -1;
+        }
+        if (size > 0 && !log_ctx->is_regular) {
+            SCLogWarning(SC_ERR_INVALID_YAML_CONF_ENTRY, "%s.buffer-size is "
+                         "only supported for regular files", conf->name);
+        } else if (size > 0 && RunmodeGetCurrent() == RUNMODE_UNIX_SOCKET) {
+            SCLogWarning(SC_ERR_INVALID_YAML_CONF_ENTRY, "%s.buffer-size is "
+                         "not supported in unix socket mode", conf->name);
+        } else if (size > 0) {
+            LogFileSetupBuffered(log_ctx, (size_t)size);
+        }
+    }
+
+    const char *compression = ConfNodeLookupChildValue(conf, "compression");
+    if (compression != NULL && strcmp(compression, "none") != 0) {
+        if (!log_ctx->is_regular) {
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "%s.compression is "
+                       "only supported for regular files", conf->name);
+            return -1;
+        }
+        /* frames are written by the buffered writes */
+        if (RunmodeGetCurrent() == RUNMODE_UNIX_SOCKET) {
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "%s.compression "
+                       "is not supported in unix socket mode", conf->name);
+            return -1;
+        }
+        if (LogFileCompressorSetup(conf, log_ctx, compression) < 0)
+            return -1;
+        if (log_ctx->buffer_size == 0) {
+            LogFileSetupBuffered(log_ctx, LOGFILE_COMPRESS_BUFFER_SIZE);
+            if (log_ctx->buffer_size == 0)
+                return -1;
+        }
+    }
+
+    /* buffered files are already written by the flusher thread, pipelined
+     * redis by its connection threads */
+    bool queued = log_ctx->buffer_size > 0;
+#ifdef HAVE_LIBHIREDIS
+    if (log_ctx->type == LOGFILE_TYPE_REDIS && log_ctx->redis_setup.batch_size > 0)
+        queued = true;
+#endif
+    if (!queued && RunmodeGetCurrent() != RUNMODE_UNIX_SOCKET) {
+        LogAsyncSetup(log_ctx);
+    }
+
 #ifdef BUILD_WITH_UNIXSOCKET
     /* If a socket and running live, do non-blocking writes. */
     if (log_ctx->is_sock && !IsRunModeOffline(RunmodeGetCurrent())) {
@@ -542,12 +1308,26 @@ int LogFileFreeCtx(LogFileCtx *lf_ctx)
         SCReturnInt(0);
     }
 
-    if (lf_ctx->fp != NULL) {
+    if (lf_ctx->buffer_size > 0) {
+        LogFileCleanupBuffered(lf_ctx);
+    }
+
+    if (lf_ctx->async) {
+        LogAsyncDrain();
+    }
+
+    /* redis is closed even if it has no connection, as that also writes
+     * out the records still queued for its pipelined writer */
+    if (lf_ctx->fp != NULL || lf_ctx->type == LOGFILE_TYPE_REDIS) {
         SCMutexLock(&lf_ctx->fp_mutex);
         lf_ctx->Close(lf_ctx);
         SCMutexUnlock(&lf_ctx->fp_mutex);
     }
 
+    if (lf_ctx->compressor != NULL) {
+        LogFileCompressorFree(lf_ctx);
+    }
+
     SCMutexDestroy(&lf_ctx->fp_mutex);
 
     if (lf_ctx->prefix != NULL) {
@@ -568,6 +1348,22 @@ int LogFileFreeCtx(LogFileCtx *lf_ctx)
     SCReturnInt(1);
 }
 
+#ifdef HAVE_LIBHIREDIS
+/**
+ * \brief Write a record to redis.
+ *
+ * The buffer must be 0 terminated.
+ */
+static int LogFileWriteRedisLocked(const char *buffer, int buffer_len,
+        LogFileCtx *file_ctx)
+{
+    SCMutexLock(&file_ctx->fp_mutex);
+    int ret = LogFileWriteRedis(file_ctx, buffer, buffer_len);
+    SCMutexUnlock(&file_ctx->fp_mutex);
+    return ret;
+}
+#endif /* HAVE_LIBHIREDIS */
+
 int LogFileWrite(LogFileCtx *file_ctx, MemBuffer *buffer)
 {
     if (file_ctx->type == LOGFILE_TYPE_SYSLOG) {
@@ -584,10 +1380,14 @@ int LogFileWrite(LogFileCtx *file_ctx, MemBuffer *buffer)
     }
 #ifdef HAVE_LIBHIREDIS
     else if (file_ctx->type == LOGFILE_TYPE_REDIS) {
-        SCMutexLock(&file_ctx->fp_mutex);
-        LogFileWriteRedis(file_ctx, (const char *)MEMBUFFER_BUFFER(buffer),
-                MEMBUFFER_OFFSET(buffer));
-        SCMutexUnlock(&file_ctx->fp_mutex);
+        if (file_ctx->async) {
+            LogAsyncWrite(file_ctx, LogFileWriteRedisLocked,
+                    (const char *)MEMBUFFER_BUFFER(buffer),
+                    MEMBUFFER_OFFSET(buffer));
+        } else {
+            LogFileWriteRedisLocked((const char *)MEMBUFFER_BUFFER(buffer),
+                    MEMBUFFER_OFFSET(buffer), file_ctx);
+        }
     }
 #endif
 
@@ -43,6 +43,10 @@ enum LogFileType { LOGFILE_TYPE_FILE,
                    LOGFILE_TYPE_UNIX_STREAM,
                    LOGFILE_TYPE_REDIS };
 
+enum LogFileCompression { LOGFILE_COMPRESSION_NONE,
+                          LOGFILE_COMPRESSION_LZ4,
+                          LOGFILE_COMPRESSION_ZSTD };
+
 typedef struct SyslogSetup_ {
     int alert_syslog_level;
 } SyslogSetup;
@@ -131,6 +135,23 @@ typedef struct LogFileCtx_ {
     /* Socket types may need to drop events to keep from blocking
      * Suricata. */
     uint64_t dropped;
+
+    /* Size of the per thread write buffers, 0 if writes are not
+     * buffered. The buffers are protected by fp_mutex. */
+    size_t buffer_size;
+    struct LogFileThreadBuffer_ *thread_buffers;
+    /* tells a buffered ctx apart from an earlier one at the same address */
+    uint32_t buffer_gen;
+
+    /* Compression of a regular file. Every batch of buffered writes
+     * is written as a separate frame. Protected by fp_mutex. */
+    enum LogFileCompression compression;
+    struct LogFileCompressor_ *compressor;
+
+    /* Set if the records are written by the async output threads. Write
+     * queues a record, SyncWrite writes it out. */
+    bool async;
+    int (*SyncWrite)(const char *buffer, int buffer_len, struct LogFileCtx_ *fp);
 } LogFileCtx;
 
 /* Min time (msecs) before trying to reconnect a Unix domain socket */
@@ -147,5 +168,6 @@ int LogFileWrite(LogFileCtx *file_ctx, MemBuffer *buffer);
 
 int SCConfLogOpenGeneric(ConfNode *conf, LogFileCtx *, const char *, int);
 int SCConfLogReopen(LogFileCtx *);
+void LogFileFlusherSpawn(void);
 
 #endif /* __UTIL_LOGOPENFILE_H__ */
@@ -0,0 +1,849 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Aho-Corasick with a SIMD prefix filter ("ac-simd").
+ *
+ * The patterns are split in AC_SIMD_BUCKETS groups. For each of the
+ * first (up to AC_SIMD_MAX_PREFIX) pattern bytes, two 16 byte tables map
+ * the low and high nibble of an input byte to the groups having a
+ * pattern with that nibble at that position. With SSSE3/AVX2 a pshufb
+ * per table looks up 16/32 input positions at once, in the way of the
+ * Teddy matcher. Positions where no group is left can't start a
+ * pattern. The SSSE3 and AVX2 versions are built regardless of the
+ * compiler's target flags and picked at runtime from the cpu features.
+ *
+ * The other positions are verified with the regular AC state table,
+ * starting from the root state and stopping as soon as the walk falls
+ * back to a shorter string than the one read from the position.
+ *
+ * When the filter would let too many positions through for a pattern
+ * set (mpm-ac-simd.max-candidate-rate), the plain AC search is used.
+ */
+
+#include "suricata-common.h"
+#include "suricata.h"
+
+#include "detect.h"
+#include "detect-engine.h"
+
+#include "conf.h"
+#include "util-debug.h"
+#include "util-unittest.h"
+#include "util-memcmp.h"
+#include "util-mpm-ac-simd.h"
+
+/* x86 compilers that can build the SIMD kernels through the target
+ * attribute and tell the cpu features at runtime */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || (defined(__GNUC__) && \
+        (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define AC_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+/** default expected share of candidate positions above which the
+ *  filter costs more than it saves */
+#define AC_SIMD_MAX_CANDIDATE_RATE 0.25
+
+/** best filter kernel the cpu supports, set at registration */
+static uint8_t ac_simd_cpu_kernel = AC_SIMD_KERNEL_SCALAR;
+
+#define AC_SIMD_DEPTH_UNSET UINT16_MAX
+
+static void SCACSimdRegisterTests(void);
+
+/**
+ * \brief Initialize the AC SIMD context.
+ *
+ * \param mpm_ctx Mpm context.
+ */
+static void SCACSimdInitCtx(MpmCtx *mpm_ctx)
+{
+    if (mpm_ctx->ctx != NULL)
+        return;
+
+    mpm_ctx->ctx = SCMalloc(sizeof(SCACSimdCtx));
+    if (mpm_ctx->ctx == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    memset(mpm_ctx->ctx, 0, sizeof(SCACSimdCtx));
+
+    mpm_ctx->memory_cnt++;
+    mpm_ctx->memory_size += sizeof(SCACSimdCtx);
+
+    /* initialize the hash we use to speed up pattern insertions */
+    mpm_ctx->init_hash = SCMalloc(sizeof(MpmPattern *) * MPM_INIT_HASH_SIZE);
+    if (mpm_ctx->init_hash == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    memset(mpm_ctx->init_hash, 0, sizeof(MpmPattern *) * MPM_INIT_HASH_SIZE);
+
+    SCACSimdCtx *ctx = (SCACSimdCtx *)mpm_ctx->ctx;
+    /* the state table layout is shared with ac */
+    SCACGetConfig(&ctx->ac);
+
+    ctx->kernel = ac_simd_cpu_kernel;
+    ctx->max_rate = AC_SIMD_MAX_CANDIDATE_RATE;
+    double rate;
+    if (ConfGetDouble("mpm-ac-simd.max-candidate-rate", &rate) == 1) {
+        if (rate < 0 || rate > 1) {
+            SCLogWarning(SC_ERR_INVALID_YAML_CONF_ENTRY, "Invalid value for "
+                         "mpm-ac-simd.max-candidate-rate: %f. Using %.2f",
+                         rate, AC_SIMD_MAX_CANDIDATE_RATE);
+        } else {
+            ctx->max_rate = rate;
+        }
+    }
+}
+
+/**
+ * \brief Destroy the AC SIMD context.
+ *
+ * \param mpm_ctx Pointer to the mpm context.
+ */
+static void SCACSimdDestroyCtx(MpmCtx *mpm_ctx)
+{
+    SCACSimdCtx *ctx = (SCACSimdCtx *)mpm_ctx->ctx;
+    if (ctx == NULL)
+        return;
+
+    if (ctx->state_depth != NULL) {
+        SCFree(ctx->state_depth);
+        ctx->state_depth = NULL;
+        mpm_ctx->memory_cnt--;
+        mpm_ctx->memory_size -= ctx->ac.state_count * sizeof(uint16_t);
+    }
+
+    /* SCACDestroyCtx frees the whole ctx, but only accounts for the
+     * embedded AC part of it */
+    mpm_ctx->memory_size -= sizeof(SCACSimdCtx) - sizeof(SCACCtx);
+    SCACDestroyCtx(mpm_ctx);
+}
+
+/**
+ * \internal
+ * \brief Add a pattern's leading bytes to the filter tables.
+ */
+static void SCACSimdFilterAddPattern(SCACSimdCtx *ctx, const MpmPattern *p)
+{
+    /* keep patterns with the same prefix in the same bucket, it keeps
+     * the nibble tables tight */
+    uint32_t hash = 0;
+    for (uint16_t k = 0; k < ctx->prefix_len; k++) {
+        hash = hash * 31 + p->ci[k];
+    }
+    const uint8_t bit = 1 << (hash % AC_SIMD_BUCKETS);
+
+    for (uint16_t k = 0; k < ctx->prefix_len; k++) {
+        /* the filter runs on the raw input, so letters are added in both
+         * cases. Case sensitive patterns are checked by the verify. */
+        const uint8_t c = p->ci[k];
+        ctx->lo[k][c & 0x0f] |= bit;
+        ctx->hi[k][c >> 4] |= bit;
+        if (c >= 'a' && c <= 'z') {
+            const uint8_t uc = c - ('a' - 'A');
+            ctx->hi[k][uc >> 4] |= bit;
+        }
+    }
+}
+
+/**
+ * \internal
+ * \brief Estimate the share of input positions the filter lets through
+ *        on uniformly distributed bytes.
+ */
+static double SCACSimdFilterRate(const SCACSimdCtx *ctx)
+{
+    double rate = 0;
+
+    for (int b = 0; b < AC_SIMD_BUCKETS; b++) {
+        const uint8_t bit = 1 << b;
+        double brate = 1;
+
+        for (uint16_t k = 0; k < ctx->prefix_len; k++) {
+            uint32_t pass = 0;
+            for (uint32_t c = 0; c < 256; c++) {
+                if (ctx->lo[k][c & 0x0f] & ctx->hi[k][c >> 4] & bit)
+                    pass++;
+            }
+            brate *= (double)pass / 256;
+        }
+        rate += brate;
+    }
+    return rate;
+}
+
+/**
+ * \internal
+ * \brief Get the next state from the AC delta table.
+ *
+ * \param out set to 1 if the next state has outputs
+ */
+static inline uint32_t SCACSimdNextState(const SCACCtx *ac, uint32_t state,
+        uint8_t c, int *out)
+{
+    if (ac->ctable != NULL) {
+        const uint32_t next = SCACCompactNext(ac, state, c);
+        *out = (next & AC_COMPACT_OUTPUT) != 0;
+        return next & AC_COMPACT_STATE_MASK;
+    } else if (ac->state_count < 32767) {
+        const SC_AC_STATE_TYPE_U16 next = ac->state_table_u16[state][c];
+        *out = (next & 0x8000) != 0;
+        return next & 0x7FFF;
+    } else {
+        const SC_AC_STATE_TYPE_U32 next = ac->state_table_u32[state][c];
+        *out = (next & 0xFF000000) != 0;
+        return next & 0x00FFFFFF;
+    }
+}
+
+/**
+ * \internal
+ * \brief Compute the depth of each state, i.e. the length of the string
+ *        it stands for.
+ *
+ * Breadth first walk of the delta table: the first time a state is
+ * reached from the root is through the goto path, as every other path
+ * to the state is longer.
+ */
+static int SCACSimdSetupDepth(MpmCtx *mpm_ctx)
+{
+    SCACSimdCtx *ctx = (SCACSimdCtx *)mpm_ctx->ctx;
+    const SCACCtx *ac = &ctx->ac;
+    const uint32_t state_count = ac->state_count;
+
+    ctx->state_depth = SCMalloc(state_count * sizeof(uint16_t));
+    if (ctx->state_depth == NULL)
+        return -1;
+    mpm_ctx->memory_cnt++;
+    mpm_ctx->memory_size += state_count * sizeof(uint16_t);
+
+    uint32_t *queue = SCMalloc(state_count * sizeof(uint32_t));
+    if (queue == NULL)
+        return -1;
+
+    for (uint32_t s = 0; s < state_count; s++)
+        ctx->state_depth[s] = AC_SIMD_DEPTH_UNSET;
+
+    uint32_t top = 0, bot = 0;
+    ctx->state_depth[0] = 0;
+    queue[top++] = 0;
+    while (bot < top) {
+        const uint32_t state = queue[bot++];
+        for (uint32_t c = 0; c < 256; c++) {
+            int out;
+            const uint32_t next = SCACSimdNextState(ac, state, (uint8_t)c, &out);
+            if (ctx->state_depth[next] == AC_SIMD_DEPTH_UNSET) {
+                ctx->state_depth[next] = ctx->state_depth[state] + 1;
+                queue[top++] = next;
+            }
+        }
+    }
+    SCFree(queue);
+    return 0;
+}
+
+/**
+ * \brief Process the patterns added to the mpm, and create the filter
+ *        and AC tables.
+ *
+ * \param mpm_ctx Pointer to the mpm context.
+ */
+static int SCACSimdPreparePatterns(MpmCtx *mpm_ctx)
+{
+    SCACSimdCtx *ctx = (SCACSimdCtx *)mpm_ctx->ctx;
+
+    if (mpm_ctx->pattern_cnt == 0 || mpm_ctx->init_hash == NULL) {
+        SCLogDebug("no patterns supplied to this mpm_ctx");
+        return 0;
+    }
+
+    /* the AC prepare consumes the patterns, so get what we need first */
+    ctx->prefix_len = MIN(mpm_ctx->minlen, AC_SIMD_MAX_PREFIX);
+    ctx->maxlen = mpm_ctx->maxlen;
+    for (uint32_t i = 0; i < MPM_INIT_HASH_SIZE; i++) {
+        for (MpmPattern *p = mpm_ctx->init_hash[i]; p != NULL; p = p->next) {
+            SCACSimdFilterAddPattern(ctx, p);
+        }
+    }
+
+    if (SCACPreparePatterns(mpm_ctx) != 0)
+        goto error;
+    if (SCACSimdSetupDepth(mpm_ctx) != 0)
+        goto error;
+
+    const double rate = SCACSimdFilterRate(ctx);
+    ctx->use_filter = (rate <= ctx->max_rate);
+    SCLogDebug("%u patterns, prefix %u, candidate rate %.4f: %s",
+               mpm_ctx->pattern_cnt, ctx->prefix_len, rate,
+               ctx->use_filter ? "filter" : "plain ac");
+    return 0;
+
+error:
+    SCLogError(SC_ERR_MEM_ALLOC, "Error allocating memory");
+    return -1;
+}
+
+/**
+ * \internal
+ * \brief Find the patterns starting at 'start'.
+ *
+ * Walks the delta table from the root. While the depth of the state is
+ * the number of bytes read, the state stands for buf[start..i]. Once it
+ * is shorter, no pattern starting at 'start' is left.
+ */
+static inline uint32_t SCACSimdVerify(const SCACSimdCtx *ctx,
+        PrefilterRuleStore *pmq, const uint8_t *buf, const uint32_t buflen,
+        const uint32_t start, uint8_t *bitarray)
+{
+    const SCACCtx *ac = &ctx->ac;
+    const SCACPatternList *pid_pat_list = ac->pid_pat_list;
+    const uint32_t end = MIN(buflen, start + ctx->maxlen);
+    uint32_t state = 0;
+    uint32_t matches = 0;
+
+    for (uint32_t i = start; i < end; i++) {
+        int out;
+        state = SCACSimdNextState(ac, state, u8_tolower(buf[i]), &out);
+        const uint32_t len = i - start + 1;
+        if (ctx->state_depth[state] != len)
+            break;
+        if (!out)
+            continue;
+
+        const uint32_t no_of_entries = ac->output_table[state].no_of_entries;
+        const uint32_t *pids = ac->output_table[state].pids;
+        for (uint32_t k = 0; k < no_of_entries; k++) {
+            const uint32_t pid = pids[k] & AC_PID_MASK;
+            /* shorter patterns are suffixes, they are found from
+             * their own start */
+            const SCACPatternList *pat = &pid_pat_list[pid];
+            if (pat->patlen != len)
+                continue;
+
+            /* same checks as SCACSearch */
+            const int offset = i - pat->patlen + 1;
+            if (offset < (int)pat->offset || (pat->depth && i > pat->depth))
+                continue;
+            if ((pids[k] & AC_CASE_MASK) &&
+                    SCMemcmp(pat->cs, buf + offset, pat->patlen) != 0)
+                continue;
+
+            if (!(bitarray[pid / 8] & (1 << (pid % 8)))) {
+                bitarray[pid / 8] |= (1 << (pid % 8));
+                PrefilterAddSids(pmq, pat->sids, pat->sids_size);
+            }
+            matches++;
+        }
+    }
+    return matches;
+}
+
+/**
+ * \internal
+ * \brief Scalar version of the filter for a single position.
+ */
+static inline int SCACSimdFilterByte(const SCACSimdCtx *ctx, const uint8_t *buf)
+{
+    uint8_t res = 0xff;
+    for (uint16_t k = 0; k < ctx->prefix_len; k++) {
+        res &= ctx->lo[k][buf[k] & 0x0f] & ctx->hi[k][buf[k] >> 4];
+    }
+    return res != 0;
+}
+
+#ifdef AC_SIMD_X86
+/**
+ * \internal
+ * \brief AVX2 filter over 32 positions at a time.
+ *
+ * \param pos in: first position to check, out: first position left
+ *            for the scalar filter
+ *
+ * \retval matches Match count.
+ */
+__attribute__((target("avx2")))
+static uint32_t SCACSimdFilterAVX2(const SCACSimdCtx *ctx, PrefilterRuleStore *pmq,
+        const uint8_t *buf, const uint32_t buflen, uint8_t *bitarray, uint32_t *pos)
+{
+    const uint32_t prefix_len = ctx->prefix_len;
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i lo[AC_SIMD_MAX_PREFIX], hi[AC_SIMD_MAX_PREFIX];
+    uint32_t matches = 0;
+    uint32_t i = *pos;
+
+    for (uint32_t k = 0; k < prefix_len; k++) {
+        lo[k] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)ctx->lo[k]));
+        hi[k] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)ctx->hi[k]));
+    }
+    /* the loads of the last prefix byte need to stay in the buffer */
+    for ( ; i + 32 + prefix_len - 1 <= buflen; i += 32) {
+        __m256i res = _mm256_set1_epi8((char)0xff);
+        for (uint32_t k = 0; k < prefix_len; k++) {
+            const __m256i data = _mm256_loadu_si256((const __m256i *)(buf + i + k));
+            const __m256i l = _mm256_shuffle_epi8(lo[k], _mm256_and_si256(data, nibble));
+            const __m256i h = _mm256_shuffle_epi8(hi[k],
+                    _mm256_and_si256(_mm256_srli_epi16(data, 4), nibble));
+            res = _mm256_and_si256(res, _mm256_and_si256(l, h));
+        }
+        uint32_t cand = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(res, zero));
+        while (cand) {
+            const uint32_t p = __builtin_ctz(cand);
+            cand &= cand - 1;
+            matches += SCACSimdVerify(ctx, pmq, buf, buflen, i + p, bitarray);
+        }
+    }
+    *pos = i;
+    return matches;
+}
+
+/**
+ * \internal
+ * \brief SSSE3 filter over 16 positions at a time.
+ *
+ * \param pos in: first position to check, out: first position left
+ *            for the scalar filter
+ *
+ * \retval matches Match count.
+ */
+__attribute__((target("ssse3")))
+static uint32_t SCACSimdFilterSSSE3(const SCACSimdCtx *ctx, PrefilterRuleStore *pmq,
+        const uint8_t *buf, const uint32_t buflen, uint8_t *bitarray, uint32_t *pos)
+{
+    const uint32_t prefix_len = ctx->prefix_len;
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo[AC_SIMD_MAX_PREFIX], hi[AC_SIMD_MAX_PREFIX];
+    uint32_t matches = 0;
+    uint32_t i = *pos;
+
+    for (uint32_t k = 0; k < prefix_len; k++) {
+        lo[k] = _mm_loadu_si128((const __m128i *)ctx->lo[k]);
+        hi[k] = _mm_loadu_si128((const __m128i *)ctx->hi[k]);
+    }
+    /* the loads of the last prefix byte need to stay in the buffer */
+    for ( ; i + 16 + prefix_len - 1 <= buflen; i += 16) {
+        __m128i res = _mm_set1_epi8((char)0xff);
+        for (uint32_t k = 0; k < prefix_len; k++) {
+            const __m128i data = _mm_loadu_si128((const __m128i *)(buf + i + k));
+            const __m128i l = _mm_shuffle_epi8(lo[k], _mm_and_si128(data, nibble));
+            const __m128i h = _mm_shuffle_epi8(hi[k],
+                    _mm_and_si128(_mm_srli_epi16(data, 4), nibble));
+            res = _mm_and_si128(res, _mm_and_si128(l, h));
+        }
+        uint32_t cand = ~(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(res, zero)) & 0xffff;
+        while (cand) {
+            const uint32_t p = __builtin_ctz(cand);
+            cand &= cand - 1;
+            matches += SCACSimdVerify(ctx, pmq, buf, buflen, i + p, bitarray);
+        }
+    }
+    *pos = i;
+    return matches;
+}
+#endif /* AC_SIMD_X86 */
+
+/**
+ * \internal
+ * \brief Get the best filter kernel the cpu supports.
+ */
+static uint8_t SCACSimdCpuKernel(void)
+{
+#ifdef AC_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return AC_SIMD_KERNEL_AVX2;
+    if (__builtin_cpu_supports("ssse3"))
+        return AC_SIMD_KERNEL_SSSE3;
+#endif
+    return AC_SIMD_KERNEL_SCALAR;
+}
+
+/**
+ * \brief AC search using the prefix filter to skip positions.
+ *
+ * \param mpm_ctx        Pointer to the mpm context.
+ * \param mpm_thread_ctx Pointer to the mpm thread context.
+ * \param pmq            Pointer to the Pattern Matcher Queue to hold
+ *                       search matches.
+ * \param buf            Buffer to be searched.
+ * \param buflen         Buffer length.
+ *
+ * \retval matches Match count.
+ */
+static uint32_t SCACSimdSearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
+        PrefilterRuleStore *pmq, const uint8_t *buf, uint32_t buflen)
+{
+    const SCACSimdCtx *ctx = (SCACSimdCtx *)mpm_ctx->ctx;
+
+    if (ctx->state_depth == NULL)
+        return 0;
+    if (!ctx->use_filter)
+        return SCACSearch(mpm_ctx, mpm_thread_ctx, pmq, buf, buflen);
+    if (buflen < ctx->prefix_len)
+        return 0;
+
+    uint8_t bitarray[ctx->ac.pattern_id_bitarray_size];
+    memset(bitarray, 0, ctx->ac.pattern_id_bitarray_size);
+
+    uint32_t matches = 0;
+    uint32_t i = 0;
+
+#ifdef AC_SIMD_X86
+    if (ctx->kernel == AC_SIMD_KERNEL_AVX2) {
+        matches += SCACSimdFilterAVX2(ctx, pmq, buf, buflen, bitarray, &i);
+    } else if (ctx->kernel == AC_SIMD_KERNEL_SSSE3) {
+        matches += SCACSimdFilterSSSE3(ctx, pmq, buf, buflen, bitarray, &i);
+    }
+#endif
+
+    /* tail, or the whole buffer without SIMD support */
+    for ( ; i + ctx->prefix_len <= buflen; i++) {
+        if (SCACSimdFilterByte(ctx, buf + i)) {
+            matches += SCACSimdVerify(ctx, pmq, buf, buflen, i, bitarray);
+        }
+    }
+
+    return matches;
+}
+
+static void SCACSimdPrintInfo(MpmCtx *mpm_ctx)
+{
+    SCACSimdCtx *ctx = (SCACSimdCtx *)mpm_ctx->ctx;
+
+    SCACPrintInfo(mpm_ctx);
+    printf("MPM AC SIMD Information:\n");
+    printf("Prefix filter:   %s, %u bytes, %s\n",
+           ctx->use_filter ? "on" : "off", ctx->prefix_len,
+           ctx->kernel == AC_SIMD_KERNEL_AVX2 ? "avx2" :
+           ctx->kernel == AC_SIMD_KERNEL_SSSE3 ? "ssse3" : "scalar");
+    printf("Candidate rate:  %.4f (max %.4f)\n", SCACSimdFilterRate(ctx),
+           ctx->max_rate);
+    printf("\n");
+}
+
+/************************** Mpm Registration ***************************/
+
+/**
+ * \brief Register the aho-corasick mpm with the SIMD prefix filter.
+ */
+void MpmACSimdRegister(void)
+{
+    ac_simd_cpu_kernel = SCACSimdCpuKernel();
+
+    mpm_table[MPM_AC_SIMD].name = "ac-simd";
+    mpm_table[MPM_AC_SIMD].InitCtx = SCACSimdInitCtx;
+    mpm_table[MPM_AC_SIMD].InitThreadCtx = SCACInitThreadCtx;
+    mpm_table[MPM_AC_SIMD].DestroyCtx = SCACSimdDestroyCtx;
+    mpm_table[MPM_AC_SIMD].DestroyThreadCtx = SCACDestroyThreadCtx;
+    mpm_table[MPM_AC_SIMD].AddPattern = SCACAddPatternCS;
+    mpm_table[MPM_AC_SIMD].AddPatternNocase = SCACAddPatternCI;
+    mpm_table[MPM_AC_SIMD].Prepare = SCACSimdPreparePatterns;
+    mpm_table[MPM_AC_SIMD].Search = SCACSimdSearch;
+    mpm_table[MPM_AC_SIMD].PrintCtx = SCACSimdPrintInfo;
+    mpm_table[MPM_AC_SIMD].PrintThreadCtx = SCACPrintSearchStats;
+    mpm_table[MPM_AC_SIMD].RegisterUnittests = SCACSimdRegisterTests;
+}
+
+/*************************************Unittests********************************/
+
+#ifdef UNITTESTS
+
+typedef struct SCACSimdTestPattern_ {
+    const char *pat;
+    int nocase;
+} SCACSimdTestPattern;
+
+/** \internal
+ *  \brief search buf with 'ac' and 'ac-simd' and compare the results
+ *
+ *  \param compact use the compact AC state table for both
+ *  \param kernel  force the filter on with this AC_SIMD_KERNEL_*, or -1
+ *                 to let the pattern set and cpu decide
+ *
+ *  \retval matches of ac-simd, or -1 if it differs from ac
+ */
+static int SCACSimdCompareKernel(const SCACSimdTestPattern *pats, int pats_cnt,
+        const uint8_t *buf, uint32_t buflen, bool compact, int kernel)
+{
+    uint32_t cnt[2];
+    PrefilterRuleStore pmq[2];
+    const uint16_t algo[2] = { MPM_AC, MPM_AC_SIMD };
+
+    for (int a = 0; a < 2; a++) {
+        MpmCtx mpm_ctx;
+        MpmThreadCtx mpm_thread_ctx;
+
+        memset(&mpm_ctx, 0, sizeof(MpmCtx));
+        memset(&mpm_thread_ctx, 0, sizeof(MpmThreadCtx));
+        MpmInitCtx(&mpm_ctx, algo[a]);
+        /* SCACSimdCtx starts with the SCACCtx */
+        ((SCACCtx *)mpm_ctx.ctx)->compact = compact;
+        MpmInitThreadCtx(&mpm_thread_ctx, algo[a]);
+        PmqSetup(&pmq[a]);
+
+        for (int p = 0; p < pats_cnt; p++) {
+            const uint16_t len = strlen(pats[p].pat);
+            if (pats[p].nocase)
+                MpmAddPatternCI(&mpm_ctx, (uint8_t *)pats[p].pat, len, 0, 0, p, p, 0);
+            else
+                MpmAddPatternCS(&mpm_ctx, (uint8_t *)pats[p].pat, len, 0, 0, p, p, 0);
+        }
+        mpm_table[algo[a]].Prepare(&mpm_ctx);
+        if (algo[a] == MPM_AC_SIMD && kernel >= 0) {
+            ((SCACSimdCtx *)mpm_ctx.ctx)->use_filter = true;
+            ((SCACSimdCtx *)mpm_ctx.ctx)->kernel = (uint8_t)kernel;
+        }
+
+        cnt[a] = mpm_table[algo[a]].Search(&mpm_ctx, &mpm_thread_ctx, &pmq[a], buf, buflen);
+
+        mpm_table[algo[a]].DestroyCtx(&mpm_ctx);
+        mpm_table[algo[a]].DestroyThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+    }
+
+    /* sids are added in a different order, compare them as sets */
+    int result = (int)cnt[1];
+    if (cnt[0] != cnt[1] || pmq[0].rule_id_array_cnt != pmq[1].rule_id_array_cnt) {
+        printf("ac %u/%u != ac-simd %u/%u: ", cnt[0], pmq[0].rule_id_array_cnt,
+                cnt[1], pmq[1].rule_id_array_cnt);
+        result = -1;
+    } else {
+        for (uint32_t i = 0; i < pmq[0].rule_id_array_cnt; i++) {
+            uint32_t j;
+            for (j = 0; j < pmq[1].rule_id_array_cnt; j++) {
+                if (pmq[0].rule_id_array[i] == pmq[1].rule_id_array[j])
+                    break;
+            }
+            if (j == pmq[1].rule_id_array_cnt) {
+                printf("sid %u not found by ac-simd: ", pmq[0].rule_id_array[i]);
+                result = -1;
+                break;
+            }
+        }
+    }
+    PmqFree(&pmq[0]);
+    PmqFree(&pmq[1]);
+    return result;
+}
+
+static int SCACSimdCompare(const SCACSimdTestPattern *pats, int pats_cnt,
+        const uint8_t *buf, uint32_t buflen, bool compact)
+{
+    return SCACSimdCompareKernel(pats, pats_cnt, buf, buflen, compact, -1);
+}
+
+static int SCACSimdTest01(void)
+{
+    SCACSimdTestPattern pats[] = { { "abcd", 0 } };
+    const char *buf = "abcdefghjiklmnopqrstuvwxyz";
+
+    FAIL_IF_NOT(SCACSimdCompare(pats, 1, (uint8_t *)buf, strlen(buf), false) == 1);
+    PASS;
+}
+
+/** \test case sensitive pattern against a different case, and nocase
+ *        pattern against mixed case */
+static int SCACSimdTest02(void)
+{
+    SCACSimdTestPattern pats[] = { { "abcd", 0 }, { "wxyz", 1 } };
+    const char *buf = "ABCDefghjiklmnopqrstuvWxYz";
+
+    FAIL_IF_NOT(SCACSimdCompare(pats, 2, (uint8_t *)buf, strlen(buf), false) == 1);
+    PASS;
+}
+
+/** \test patterns that are suffixes of each other */
+static int SCACSimdTest03(void)
+{
+    SCACSimdTestPattern pats[] = {
+        { "abcd", 0 }, { "bcd", 0 }, { "cd", 0 }, { "d", 0 },
+    };
+    const char *buf = "xxabcdxxabcdxx";
+
+    FAIL_IF_NOT(SCACSimdCompare(pats, 4, (uint8_t *)buf, strlen(buf), false) == 8);
+    PASS;
+}
+
+/** \test matches straddling the 16 and 32 byte blocks and in the tail */
+static int SCACSimdTest04(void)
+{
+    SCACSimdTestPattern pats[] = { { "needle", 0 }, { "NeEdLeS", 1 } };
+    uint8_t buf[100];
+
+    memset(buf, 'x', sizeof(buf));
+    memcpy(buf + 13, "needle", 6);
+    memcpy(buf + 29, "needles", 7);
+    memcpy(buf + 62, "needle", 6);
+    memcpy(buf + 94, "needle", 6);
+
+    FAIL_IF_NOT(SCACSimdCompare(pats, 2, buf, sizeof(buf), false) == 5);
+    PASS;
+}
+
+/** \test buffers shorter than the shortest pattern and than a block */
+static int SCACSimdTest05(void)
+{
+    SCACSimdTestPattern pats[] = { { "abc", 0 }, { "abcdef", 0 } };
+
+    FAIL_IF_NOT(SCACSimdCompare(pats, 2, (uint8_t *)"ab", 2, false) == 0);
+    FAIL_IF_NOT(SCACSimdCompare(pats, 2, (uint8_t *)"abc", 3, false) == 1);
+    FAIL_IF_NOT(SCACSimdCompare(pats, 2, (uint8_t *)"zabcdef", 7, false) == 2);
+    PASS;
+}
+
+/** \test one byte patterns make the filter useless, plain AC is used */
+static int SCACSimdTest06(void)
+{
+    SCACSimdTestPattern pats[] = {
+        { "a", 1 }, { "e", 1 }, { "i", 1 }, { "o", 1 }, { "u", 1 },
+        { "0", 0 }, { "1", 0 }, { "2", 0 }, { "3", 0 }, { "4", 0 },
+        { "5", 0 }, { "6", 0 }, { "7", 0 }, { "8", 0 }, { "9", 0 },
+        { " ", 0 }, { "/", 0 }, { ".", 0 }, { "-", 0 }, { "_", 0 },
+        { "b", 1 }, { "c", 1 }, { "d", 1 }, { "f", 1 }, { "g", 1 },
+        { "h", 1 }, { "j", 1 }, { "k", 1 }, { "l", 1 }, { "m", 1 },
+        { "n", 1 }, { "p", 1 }, { "r", 1 }, { "s", 1 }, { "t", 1 },
+    };
+    const char *buf = "GET /index.html HTTP/1.1";
+
+    MpmCtx mpm_ctx;
+    memset(&mpm_ctx, 0, sizeof(MpmCtx));
+    MpmInitCtx(&mpm_ctx, MPM_AC_SIMD);
+    for (int p = 0; p < (int)(sizeof(pats) / sizeof(pats[0])); p++) {
+        MpmAddPatternCS(&mpm_ctx, (uint8_t *)pats[p].pat, 1, 0, 0, p, p, 0);
+    }
+    mpm_table[MPM_AC_SIMD].Prepare(&mpm_ctx);
+    FAIL_IF(((SCACSimdCtx *)mpm_ctx.ctx)->use_filter);
+    mpm_table[MPM_AC_SIMD].DestroyCtx(&mpm_ctx);
+
+    FAIL_IF(SCACSimdCompare(pats, sizeof(pats) / sizeof(pats[0]),
+                (uint8_t *)buf, strlen(buf), false) < 0);
+    PASS;
+}
+
+/** \internal
+ *  \brief compare on pseudo random input over a small alphabet so there
+ *          are lots of partial matches
+ */
+static int SCACSimdCompareRandom(bool compact, int kernel)
+{
+    SCACSimdTestPattern pats[] = {
+        { "abca", 0 }, { "bcab", 1 }, { "cc", 0 }, { "AbAb", 0 },
+        { "abcabcabc", 1 }, { "cba", 0 }, { "bbbbb", 0 }, { "cAB", 0 },
+    };
+    const int pats_cnt = sizeof(pats) / sizeof(pats[0]);
+    uint8_t buf[4096];
+    uint32_t seed = 1;
+
+    for (uint32_t i = 0; i < sizeof(buf); i++) {
+        seed = seed * 1103515245 + 12345;
+        buf[i] = "abcABC"[(seed >> 16) % 6];
+    }
+
+    for (uint32_t len = 0; len < 300; len += 7) {
+        if (SCACSimdCompareKernel(pats, pats_cnt, buf, len, compact, kernel) < 0)
+            return 0;
+    }
+    return SCACSimdCompareKernel(pats, pats_cnt, buf, sizeof(buf), compact, kernel) > 0;
+}
+
+static int SCACSimdTest07(void)
+{
+    FAIL_IF_NOT(SCACSimdCompareRandom(false, -1));
+    PASS;
+}
+
+/** \test the filter on top of the compact AC state table */
+static int SCACSimdTest08(void)
+{
+    FAIL_IF_NOT(SCACSimdCompareRandom(true, -1));
+    PASS;
+}
+
+/** \test force the filter on with each kernel the cpu supports, also
+ *        for a pattern set where it would be off, and compare with ac */
+static int SCACSimdTest09(void)
+{
+    SCACSimdTestPattern one[] = {
+        { "a", 1 }, { "e", 1 }, { "/", 0 }, { " ", 0 }, { "1", 0 },
+    };
+    SCACSimdTestPattern blocks[] = { { "needle", 0 }, { "NeEdLeS", 1 } };
+    const char *req = "GET /index.html HTTP/1.1\r\nHost: example.com\r\n\r\n";
+    uint8_t buf[100];
+
+    memset(buf, 'x', sizeof(buf));
+    memcpy(buf + 13, "needle", 6);
+    memcpy(buf + 29, "needles", 7);
+    memcpy(buf + 62, "needle", 6);
+    memcpy(buf + 94, "needle", 6);
+
+    for (int k = AC_SIMD_KERNEL_SCALAR; k <= ac_simd_cpu_kernel; k++) {
+        FAIL_IF_NOT(SCACSimdCompareRandom(false, k));
+        FAIL_IF_NOT(SCACSimdCompareRandom(true, k));
+        FAIL_IF_NOT(SCACSimdCompareKernel(blocks, 2, buf, sizeof(buf), false, k) == 5);
+        FAIL_IF(SCACSimdCompareKernel(one, 5, (uint8_t *)req, strlen(req), false, k) <= 0);
+    }
+    PASS;
+}
+
+/** \test mpm-ac-simd.max-candidate-rate keeps the filter on */
+static int SCACSimdTest10(void)
+{
+    SCACSimdTestPattern pats[] = {
+        { "a", 1 }, { "e", 1 }, { "i", 1 }, { "o", 1 }, { "u", 1 },
+        { "0", 0 }, { "1", 0 }, { "2", 0 }, { "3", 0 }, { "4", 0 },
+    };
+
+    ConfCreateContextBackup();
+    ConfInit();
+    FAIL_IF_NOT(ConfSet("mpm-ac-simd.max-candidate-rate", "1.0"));
+
+    MpmCtx mpm_ctx;
+    memset(&mpm_ctx, 0, sizeof(MpmCtx));
+    MpmInitCtx(&mpm_ctx, MPM_AC_SIMD);
+    for (int p = 0; p < (int)(sizeof(pats) / sizeof(pats[0])); p++) {
+        MpmAddPatternCS(&mpm_ctx, (uint8_t *)pats[p].pat, 1, 0, 0, p, p, 0);
+    }
+    mpm_table[MPM_AC_SIMD].Prepare(&mpm_ctx);
+    FAIL_IF_NOT(((SCACSimdCtx *)mpm_ctx.ctx)->use_filter);
+    mpm_table[MPM_AC_SIMD].DestroyCtx(&mpm_ctx);
+
+    ConfDeInit();
+    ConfRestoreContextBackup();
+    PASS;
+}
+
+#endif /* UNITTESTS */
+
+static void SCACSimdRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("SCACSimdTest01", SCACSimdTest01);
+    UtRegisterTest("SCACSimdTest02", SCACSimdTest02);
+    UtRegisterTest("SCACSimdTest03", SCACSimdTest03);
+    UtRegisterTest("SCACSimdTest04", SCACSimdTest04);
+    UtRegisterTest("SCACSimdTest05", SCACSimdTest05);
+    UtRegisterTest("SCACSimdTest06", SCACSimdTest06);
+    UtRegisterTest("SCACSimdTest07", SCACSimdTest07);
+    UtRegisterTest("SCACSimdTest08", SCACSimdTest08);
+    UtRegisterTest("SCACSimdTest09", SCACSimdTest09);
+    UtRegisterTest("SCACSimdTest10", SCACSimdTest10);
+#endif
+}
@@ -0,0 +1,64 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Aho-Corasick with a SIMD prefix filter.
+ */
+
+#ifndef __UTIL_MPM_AC_SIMD_H__
+#define __UTIL_MPM_AC_SIMD_H__
+
+#include "util-mpm.h"
+#include "util-mpm-ac.h"
+
+/** number of pattern groups the filter tells apart */
+#define AC_SIMD_BUCKETS     8
+/** max number of leading pattern bytes checked by the filter */
+#define AC_SIMD_MAX_PREFIX  3
+
+/** filter implementations, picked at runtime from the cpu features */
+#define AC_SIMD_KERNEL_SCALAR   0
+#define AC_SIMD_KERNEL_SSSE3    1
+#define AC_SIMD_KERNEL_AVX2     2
+
+typedef struct SCACSimdCtx_ {
+    /* regular AC context, first so the AC functions can use this ctx */
+    SCACCtx ac;
+
+    /* per prefix byte, the buckets a low/high nibble value can be in */
+    uint8_t lo[AC_SIMD_MAX_PREFIX][16];
+    uint8_t hi[AC_SIMD_MAX_PREFIX][16];
+    /* number of prefix bytes the filter checks */
+    uint16_t prefix_len;
+    /* filter lets too many positions through, use plain AC */
+    bool use_filter;
+    /* filter implementation, AC_SIMD_KERNEL_* */
+    uint8_t kernel;
+    /* candidate rate above which the plain AC search is used */
+    double max_rate;
+
+    /* length of the longest pattern */
+    uint16_t maxlen;
+    /* length of the string each state stands for */
+    uint16_t *state_depth;
+} SCACSimdCtx;
+
+void MpmACSimdRegister(void);
+
+#endif /* __UTIL_MPM_AC_SIMD_H__ */
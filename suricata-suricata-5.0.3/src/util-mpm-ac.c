@@ -59,20 +59,10 @@
 #include "util-memcmp.h"
 #include "util-mpm-ac.h"
 #include "util-memcpy.h"
+#include "util-hash.h"
+#include "util-hash-lookup3.h"
 
 void SCACInitCtx(MpmCtx *);
-void SCACInitThreadCtx(MpmCtx *, MpmThreadCtx *);
-void SCACDestroyCtx(MpmCtx *);
-void SCACDestroyThreadCtx(MpmCtx *, MpmThreadCtx *);
-int SCACAddPatternCI(MpmCtx *, uint8_t *, uint16_t, uint16_t, uint16_t,
-                     uint32_t, SigIntId, uint8_t);
-int SCACAddPatternCS(MpmCtx *, uint8_t *, uint16_t, uint16_t, uint16_t,
-                     uint32_t, SigIntId, uint8_t);
-int SCACPreparePatterns(MpmCtx *mpm_ctx);
-uint32_t SCACSearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
-                    PrefilterRuleStore *pmq, const uint8_t *buf, uint32_t buflen);
-void SCACPrintInfo(MpmCtx *mpm_ctx);
-void SCACPrintSearchStats(MpmThreadCtx *mpm_thread_ctx);
 void SCACRegisterTests(void);
 
 /* a placeholder to denote a failure transition in the goto table */
@@ -80,12 +70,39 @@ void SCACRegisterTests(void);
 
 #define STATE_QUEUE_CONTAINER_SIZE 65536
 
-#define AC_CASE_MASK    0x80000000
-#define AC_PID_MASK     0x7FFFFFFF
-#define AC_CASE_BIT     31
+/* max number of classes a state's row can differ from its fallback row in
+ * to be stored as a sparse row */
+#define AC_COMPACT_SPARSE_MAX 8
 
 static int construct_both_16_and_32_state_tables = 0;
 
+/* initial size of the global hash of shared tables */
+#define AC_TABLES_HASH_SIZE 1024
+
+/**
+ * \brief State tables shared by all ctxs with the same patterns, e.g. the
+ *        same signature group in different tenants or in the old and new
+ *        detect engine during a reload. Only the sids of the patterns
+ *        differ between these ctxs, those are kept per ctx.
+ */
+typedef struct SCACSharedTables_ {
+    /* the patterns the tables are built from, in pid order */
+    uint8_t *key;
+    uint32_t key_len;
+    bool compact;
+
+    /* number of ctxs using the tables */
+    uint32_t ref_cnt;
+
+    /* the tables. pid_pat_list has no sids */
+    SCACCtx tables;
+    uint32_t pattern_cnt;
+} SCACSharedTables;
+
+/* global hash of shared tables. Access is serialised via g_ac_tables_mutex */
+static HashTable *g_ac_tables = NULL;
+static SCMutex g_ac_tables_mutex = SCMUTEX_INITIALIZER;
+
 /**
  * \brief Helper structure used by AC during state table creation
  */
@@ -96,19 +113,23 @@ typedef struct StateQueue_ {
 } StateQueue;
 
 /**
- * \internal
- * \brief Initialize the AC context with user specified conf parameters.  We
- *        aren't retrieving anything for AC conf now, but we will certainly
- *        need it, when we customize AC.
+ * \brief Initialize the AC context with user specified conf parameters.
+ *
+ *        mpm-ac.state-table: full|compact selects the state table layout.
  */
-static void SCACGetConfig(void)
+void SCACGetConfig(SCACCtx *ctx)
 {
-    //ConfNode *ac_conf;
-    //const char *hash_val = NULL;
+    const char *layout = NULL;
 
-    //ConfNode *pm = ConfGetNode("pattern-matcher");
+    if (ConfGet("mpm-ac.state-table", &layout) != 1 || layout == NULL)
+        return;
 
-    return;
+    if (strcmp(layout, "compact") == 0) {
+        ctx->compact = true;
+    } else if (strcmp(layout, "full") != 0) {
+        SCLogWarning(SC_ERR_INVALID_YAML_CONF_ENTRY, "Invalid value for "
+                     "mpm-ac.state-table: %s. Using full", layout);
+    }
 }
 
 /**
@@ -683,6 +704,163 @@ static inline void SCACClubOutputStatePresenceWithDeltaTable(MpmCtx *mpm_ctx)
     return;
 }
 
+/**
+ * \internal
+ * \brief Append a row to the compact state table.
+ *
+ * \retval offset of the row in the table
+ */
+static uint32_t SCACCompactAppend(MpmCtx *mpm_ctx, uint32_t *allocated,
+                                  const uint32_t *row, uint32_t len)
+{
+    SCACCtx *ctx = (SCACCtx *)mpm_ctx->ctx;
+
+    if (ctx->ctable_size + len > *allocated) {
+        uint32_t size = *allocated ? *allocated : 1024;
+        while (size < ctx->ctable_size + len)
+            size *= 2;
+        void *ptmp = SCRealloc(ctx->ctable,
+                               SCACCheckSafeSizetMult(size, sizeof(uint32_t)));
+        if (ptmp == NULL) {
+            SCFree(ctx->ctable);
+            ctx->ctable = NULL;
+            SCLogError(SC_ERR_MEM_ALLOC, "Error allocating memory");
+            exit(EXIT_FAILURE);
+        }
+        ctx->ctable = ptmp;
+        *allocated = size;
+    }
+
+    const uint32_t offset = ctx->ctable_size;
+    memcpy(ctx->ctable + offset, row, len * sizeof(uint32_t));
+    ctx->ctable_size += len;
+    return offset;
+}
+
+/**
+ * \internal
+ * \brief Create the compact state table, in place of the delta table.
+ *
+ *        Bytes not used by any pattern share byte class 0, the others
+ *        each get their own class, with upper and lower case folded.
+ *        The rows are built in breadth first order from the goto and
+ *        failure tables, so the row of a state's failure state is
+ *        always in the table already.
+ *
+ *        A state gets a sparse row if its row differs in only a few
+ *        classes from the row of the first state with a dense row on
+ *        its failure path. The root row is always dense.
+ *
+ * \param mpm_ctx Pointer to the mpm context.
+ */
+static void SCACCreateCompactTable(MpmCtx *mpm_ctx)
+{
+    SCACCtx *ctx = (SCACCtx *)mpm_ctx->ctx;
+    uint8_t used[256];
+    uint8_t class_byte[256];
+    uint32_t allocated = 0;
+    uint32_t i;
+
+    memset(used, 0, sizeof(used));
+    for (i = 0; i < mpm_ctx->pattern_cnt; i++) {
+        for (uint16_t j = 0; j < ctx->parray[i]->len; j++)
+            used[ctx->parray[i]->ci[j]] = 1;
+    }
+
+    ctx->alphabet_size = 1;
+    class_byte[0] = 0;
+    for (i = 0; i < 256; i++) {
+        if (used[i] && !(i >= 'A' && i <= 'Z')) {
+            class_byte[ctx->alphabet_size] = (uint8_t)i;
+            ctx->translate_table[i] = ctx->alphabet_size++;
+        } else {
+            ctx->translate_table[i] = 0;
+        }
+    }
+    for (i = 'A'; i <= 'Z'; i++)
+        ctx->translate_table[i] = ctx->translate_table[i - 'A' + 'a'];
+
+    ctx->state_index = SCMalloc(SCACCheckSafeSizetMult(ctx->state_count,
+                                                       sizeof(uint32_t)));
+    uint32_t *queue = SCMalloc(SCACCheckSafeSizetMult(ctx->state_count,
+                                                      sizeof(uint32_t)));
+    uint32_t *row = SCMalloc(ctx->alphabet_size * sizeof(uint32_t));
+    uint32_t *sparse = SCMalloc((AC_COMPACT_SPARSE_MAX + 2) * sizeof(uint32_t));
+    if (ctx->state_index == NULL || queue == NULL || row == NULL ||
+            sparse == NULL) {
+        SCLogError(SC_ERR_MEM_ALLOC, "Error allocating memory");
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t top = 0, bot = 0;
+    queue[top++] = 0;
+    while (bot < top) {
+        const uint32_t state = queue[bot++];
+        uint32_t k;
+
+        /* unused bytes always lead back to the root */
+        row[0] = 0;
+        for (k = 1; k < ctx->alphabet_size; k++) {
+            const int32_t next = ctx->goto_table[state][class_byte[k]];
+            if (next == SC_AC_FAIL) {
+                row[k] = SCACCompactNext(ctx, ctx->failure_table[state],
+                                         class_byte[k]);
+                continue;
+            }
+            /* the goto table is a tree, each state is queued once */
+            if (next != 0)
+                queue[top++] = next;
+            row[k] = next;
+            if (ctx->output_table[next].no_of_entries != 0)
+                row[k] |= AC_COMPACT_OUTPUT;
+        }
+
+        if (state == 0) {
+            ctx->state_index[0] = SCACCompactAppend(mpm_ctx, &allocated, row,
+                                                    ctx->alphabet_size);
+            continue;
+        }
+
+        uint32_t dense = ctx->failure_table[state];
+        while (ctx->state_index[dense] & AC_COMPACT_SPARSE)
+            dense = ctx->failure_table[dense];
+        const uint32_t *dense_row = ctx->ctable + ctx->state_index[dense];
+
+        uint32_t n = 0;
+        for (k = 1; k < ctx->alphabet_size && n <= AC_COMPACT_SPARSE_MAX; k++) {
+            if (row[k] != dense_row[k] && n++ < AC_COMPACT_SPARSE_MAX)
+                sparse[n + 1] = row[k] | (k << AC_COMPACT_CLASS_SHIFT);
+        }
+        if (n <= AC_COMPACT_SPARSE_MAX && n + 2 < ctx->alphabet_size) {
+            sparse[0] = n;
+            sparse[1] = ctx->state_index[dense];
+            ctx->state_index[state] = AC_COMPACT_SPARSE |
+                SCACCompactAppend(mpm_ctx, &allocated, sparse, n + 2);
+            ctx->sparse_state_cnt++;
+        } else {
+            ctx->state_index[state] = SCACCompactAppend(mpm_ctx, &allocated,
+                                                        row, ctx->alphabet_size);
+        }
+    }
+
+    SCFree(queue);
+    SCFree(row);
+    SCFree(sparse);
+
+    /* shrink the table to what we used */
+    void *ptmp = SCRealloc(ctx->ctable, ctx->ctable_size * sizeof(uint32_t));
+    if (ptmp != NULL)
+        ctx->ctable = ptmp;
+
+    mpm_ctx->memory_cnt += 2;
+    mpm_ctx->memory_size += (ctx->state_count + ctx->ctable_size) *
+                            sizeof(uint32_t);
+
+    SCLogDebug("compact state table: %u states (%u sparse), %u byte classes, "
+               "%u entries", ctx->state_count, ctx->sparse_state_cnt,
+               ctx->alphabet_size, ctx->ctable_size);
+}
+
 static inline void SCACInsertCaseSensitiveEntriesForPatterns(MpmCtx *mpm_ctx)
 {
     SCACCtx *ctx = (SCACCtx *)mpm_ctx->ctx;
@@ -742,10 +920,20 @@ static void SCACPrepareStateTable(MpmCtx *mpm_ctx)
     SCACCreateGotoTable(mpm_ctx);
     /* create the failure table */
     SCACCreateFailureTable(mpm_ctx);
-    /* create the final state(delta) table */
-    SCACCreateDeltaTable(mpm_ctx);
-    /* club the output state presence with delta transition entries */
-    SCACClubOutputStatePresenceWithDeltaTable(mpm_ctx);
+
+    if (ctx->compact && ctx->state_count > AC_COMPACT_STATE_MASK + 1) {
+        SCLogWarning(SC_ERR_AHO_CORASICK, "%u states is too many for the "
+                     "compact state table, using the full one", ctx->state_count);
+        ctx->compact = false;
+    }
+    if (ctx->compact) {
+        SCACCreateCompactTable(mpm_ctx);
+    } else {
+        /* create the final state(delta) table */
+        SCACCreateDeltaTable(mpm_ctx);
+        /* club the output state presence with delta transition entries */
+        SCACClubOutputStatePresenceWithDeltaTable(mpm_ctx);
+    }
 
     /* club nocase entries */
     SCACInsertCaseSensitiveEntriesForPatterns(mpm_ctx);
@@ -766,9 +954,298 @@ static void SCACPrepareStateTable(MpmCtx *mpm_ctx)
     return;
 }
 
+static uint32_t SCACSharedTablesHash(HashTable *ht, void *data, uint16_t len)
+{
+    const SCACSharedTables *st = data;
+    return hashlittle_safe(st->key, st->key_len, st->compact) % ht->array_size;
+}
+
+static char SCACSharedTablesCompare(void *data1, uint16_t len1, void *data2,
+                                    uint16_t len2)
+{
+    const SCACSharedTables *st1 = data1;
+    const SCACSharedTables *st2 = data2;
+
+    return st1->compact == st2->compact && st1->key_len == st2->key_len &&
+           memcmp(st1->key, st2->key, st1->key_len) == 0;
+}
+
+static void SCACSharedTablesTableFree(void *data)
+{
+    /* Stub function handed to hash table; the shared tables are freed
+     * when the last ctx using them is destroyed. */
+}
+
+/**
+ * \internal
+ * \brief Order of the patterns that sets their pids.
+ */
+static int SCACPatternCompare(const void *a, const void *b)
+{
+    const MpmPattern *p1 = *(const MpmPattern **)a;
+    const MpmPattern *p2 = *(const MpmPattern **)b;
+
+    if (p1->len != p2->len)
+        return p1->len < p2->len ? -1 : 1;
+    int r = memcmp(p1->original_pat, p2->original_pat, p1->len);
+    if (r != 0)
+        return r;
+    if (p1->flags != p2->flags)
+        return p1->flags < p2->flags ? -1 : 1;
+    if (p1->offset != p2->offset)
+        return p1->offset < p2->offset ? -1 : 1;
+    if (p1->depth != p2->depth)
+        return p1->depth < p2->depth ? -1 : 1;
+    return 0;
+}
+
+/**
+ * \internal
+ * \brief Serialize the patterns into the key of the shared tables.
+ */
+static uint8_t *SCACSharedTablesKey(MpmPattern **parray, uint32_t pattern_cnt,
+                                    uint32_t *key_len)
+{
+    uint32_t len = 0;
+    for (uint32_t i = 0; i < pattern_cnt; i++) {
+        len += sizeof(parray[i]->len) + sizeof(parray[i]->flags) +
+               sizeof(parray[i]->offset) + sizeof(parray[i]->depth) +
+               parray[i]->len;
+    }
+
+    uint8_t *key = SCMalloc(len);
+    if (key == NULL)
+        return NULL;
+
+    uint8_t *ptr = key;
+    for (uint32_t i = 0; i < pattern_cnt; i++) {
+        const MpmPattern *pat = parray[i];
+        memcpy(ptr, &pat->len, sizeof(pat->len));
+        ptr += sizeof(pat->len);
+        memcpy(ptr, &pat->flags, sizeof(pat->flags));
+        ptr += sizeof(pat->flags);
+        memcpy(ptr, &pat->offset, sizeof(pat->offset));
+        ptr += sizeof(pat->offset);
+        memcpy(ptr, &pat->depth, sizeof(pat->depth));
+        ptr += sizeof(pat->depth);
+        memcpy(ptr, pat->original_pat, pat->len);
+        ptr += pat->len;
+    }
+
+    *key_len = len;
+    return key;
+}
+
+/**
+ * \internal
+ * \brief Point the ctx to the shared tables.
+ *
+ *        The ctx keeps its own pid_pat_list, for the sids, but the
+ *        pattern data in it points to the shared list.
+ */
+static void SCACUseSharedTables(SCACCtx *ctx, SCACSharedTables *shared)
+{
+    const SCACCtx *t = &shared->tables;
+
+    ctx->shared = shared;
+    ctx->state_count = t->state_count;
+    ctx->state_table_u16 = t->state_table_u16;
+    ctx->state_table_u32 = t->state_table_u32;
+    ctx->output_table = t->output_table;
+    ctx->state_index = t->state_index;
+    ctx->ctable = t->ctable;
+    ctx->ctable_size = t->ctable_size;
+    ctx->sparse_state_cnt = t->sparse_state_cnt;
+    ctx->alphabet_size = t->alphabet_size;
+    memcpy(ctx->translate_table, t->translate_table, sizeof(ctx->translate_table));
+    ctx->compact = t->compact;
+
+    for (uint32_t i = 0; i < shared->pattern_cnt; i++) {
+        ctx->pid_pat_list[i].cs = t->pid_pat_list[i].cs;
+        ctx->pid_pat_list[i].patlen = t->pid_pat_list[i].patlen;
+        ctx->pid_pat_list[i].offset = t->pid_pat_list[i].offset;
+        ctx->pid_pat_list[i].depth = t->pid_pat_list[i].depth;
+    }
+}
+
+/**
+ * \internal
+ * \brief Subtract the memory of the tables from the mpm ctx counters.
+ */
+static void SCACUnaccountTables(MpmCtx *mpm_ctx, const SCACCtx *t)
+{
+    if (t->state_table_u16 != NULL) {
+        mpm_ctx->memory_cnt--;
+        mpm_ctx->memory_size -= (t->state_count *
+                                 sizeof(SC_AC_STATE_TYPE_U16) * 256);
+    }
+    if (t->state_table_u32 != NULL) {
+        mpm_ctx->memory_cnt--;
+        mpm_ctx->memory_size -= (t->state_count *
+                                 sizeof(SC_AC_STATE_TYPE_U32) * 256);
+    }
+    if (t->ctable != NULL) {
+        mpm_ctx->memory_cnt -= 2;
+        mpm_ctx->memory_size -= (t->state_count + t->ctable_size) *
+                                sizeof(uint32_t);
+    }
+}
+
+static void SCACSharedTablesFree(SCACSharedTables *shared)
+{
+    SCACCtx *t = &shared->tables;
+
+    SCFree(t->state_table_u16);
+    SCFree(t->state_table_u32);
+    SCFree(t->ctable);
+    SCFree(t->state_index);
+    if (t->output_table != NULL) {
+        for (uint32_t state = 0; state < t->state_count; state++) {
+            SCFree(t->output_table[state].pids);
+        }
+        SCFree(t->output_table);
+    }
+    if (t->pid_pat_list != NULL) {
+        for (uint32_t i = 0; i < shared->pattern_cnt; i++) {
+            SCFree(t->pid_pat_list[i].cs);
+        }
+        SCFree(t->pid_pat_list);
+    }
+    SCFree(shared->key);
+    SCFree(shared);
+}
+
+/**
+ * \internal
+ * \brief Move the tables just built in the ctx to new shared tables.
+ */
+static SCACSharedTables *SCACSharedTablesCreate(MpmCtx *mpm_ctx, uint8_t *key,
+                                                uint32_t key_len)
+{
+    SCACCtx *ctx = (SCACCtx *)mpm_ctx->ctx;
+
+    SCACSharedTables *shared = SCCalloc(1, sizeof(SCACSharedTables));
+    SCACPatternList *pid_pat_list = SCCalloc(mpm_ctx->pattern_cnt,
+                                             sizeof(SCACPatternList));
+    if (shared == NULL || pid_pat_list == NULL) {
+        SCLogError(SC_ERR_MEM_ALLOC, "Error allocating memory");
+        exit(EXIT_FAILURE);
+    }
+
+    shared->key = key;
+    shared->key_len = key_len;
+    shared->compact = ctx->compact;
+    shared->pattern_cnt = mpm_ctx->pattern_cnt;
+    shared->tables = *ctx;
+
+    /* the shared list owns the patterns, the ctx the sids */
+    for (uint32_t i = 0; i < mpm_ctx->pattern_cnt; i++) {
+        pid_pat_list[i] = ctx->pid_pat_list[i];
+        pid_pat_list[i].sids = NULL;
+        pid_pat_list[i].sids_size = 0;
+    }
+    shared->tables.pid_pat_list = pid_pat_list;
+    return shared;
+}
+
+/**
+ * \internal
+ * \brief Release the ctx's reference to the shared tables.
+ */
+static void SCACReleaseSharedTables(MpmCtx *mpm_ctx)
+{
+    SCACCtx *ctx = (SCACCtx *)mpm_ctx->ctx;
+    SCACSharedTables *shared = ctx->shared;
+
+    if (ctx->shared_owner)
+        SCACUnaccountTables(mpm_ctx, ctx);
+
+    /* the pattern data belongs to the shared tables */
+    for (uint32_t i = 0; i < (mpm_ctx->max_pat_id + 1); i++) {
+        SCFree(ctx->pid_pat_list[i].sids);
+    }
+    SCFree(ctx->pid_pat_list);
+
+    ctx->pid_pat_list = NULL;
+    ctx->state_table_u16 = NULL;
+    ctx->state_table_u32 = NULL;
+    ctx->output_table = NULL;
+    ctx->state_index = NULL;
+    ctx->ctable = NULL;
+    ctx->shared = NULL;
+    ctx->shared_owner = false;
+
+    SCMutexLock(&g_ac_tables_mutex);
+    BUG_ON(shared->ref_cnt == 0);
+    shared->ref_cnt--;
+    if (shared->ref_cnt == 0) {
+        HashTableRemove(g_ac_tables, shared, 0);
+        SCACSharedTablesFree(shared);
+    }
+    SCMutexUnlock(&g_ac_tables_mutex);
+}
+
+/**
+ * \internal
+ * \brief Get the shared tables for the patterns, if they exist.
+ */
+static SCACSharedTables *SCACSharedTablesGet(uint8_t *key, uint32_t key_len,
+                                             bool compact)
+{
+    SCACSharedTables lookup = { .key = key, .key_len = key_len,
+                                .compact = compact };
+    SCACSharedTables *shared = NULL;
+
+    SCMutexLock(&g_ac_tables_mutex);
+    if (g_ac_tables != NULL) {
+        shared = HashTableLookup(g_ac_tables, &lookup, 0);
+        if (shared != NULL)
+            shared->ref_cnt++;
+    }
+    SCMutexUnlock(&g_ac_tables_mutex);
+    return shared;
+}
+
+/**
+ * \internal
+ * \brief Add new shared tables, unless tables for the same patterns were
+ *        added in the meantime.
+ *
+ * \retval shared the tables to use, either the new or the existing ones
+ */
+static SCACSharedTables *SCACSharedTablesAdd(SCACSharedTables *new)
+{
+    SCACSharedTables *shared = NULL;
+
+    SCMutexLock(&g_ac_tables_mutex);
+    if (g_ac_tables == NULL) {
+        g_ac_tables = HashTableInit(AC_TABLES_HASH_SIZE, SCACSharedTablesHash,
+                                    SCACSharedTablesCompare,
+                                    SCACSharedTablesTableFree);
+        if (g_ac_tables == NULL) {
+            SCLogError(SC_ERR_MEM_ALLOC, "Error allocating memory");
+            exit(EXIT_FAILURE);
+        }
+    }
+    shared = HashTableLookup(g_ac_tables, new, 0);
+    if (shared == NULL) {
+        if (HashTableAdd(g_ac_tables, new, 0) != 0) {
+            SCLogError(SC_ERR_MEM_ALLOC, "Error allocating memory");
+            exit(EXIT_FAILURE);
+        }
+        shared = new;
+    }
+    shared->ref_cnt++;
+    SCMutexUnlock(&g_ac_tables_mutex);
+    return shared;
+}
+
 /**
  * \brief Process the patterns added to the mpm, and create the internal tables.
  *
+ *        If another ctx already has the tables for the same patterns, they
+ *        are shared.
+ *
  * \param mpm_ctx Pointer to the mpm context.
  */
 int SCACPreparePatterns(MpmCtx *mpm_ctx)
@@ -805,10 +1282,17 @@ int SCACPreparePatterns(MpmCtx *mpm_ctx)
     SCFree(mpm_ctx->init_hash);
     mpm_ctx->init_hash = NULL;
 
+    /* the pids are only used inside the ctx. Renumber them in a fixed
+     * pattern order, so the same patterns always give the same tables */
+    qsort(ctx->parray, mpm_ctx->pattern_cnt, sizeof(MpmPattern *),
+          SCACPatternCompare);
+    for (i = 0; i < mpm_ctx->pattern_cnt; i++) {
+        ctx->parray[i]->id = i;
+    }
+
     /* the memory consumed by a single state in our goto table */
     ctx->single_state_size = sizeof(int32_t) * 256;
 
-    /* handle no case patterns */
     ctx->pid_pat_list = SCMalloc((mpm_ctx->max_pat_id + 1)* sizeof(SCACPatternList));
     if (ctx->pid_pat_list == NULL) {
         SCLogError(SC_ERR_MEM_ALLOC, "Error allocating memory");
@@ -817,21 +1301,7 @@ int SCACPreparePatterns(MpmCtx *mpm_ctx)
     memset(ctx->pid_pat_list, 0, (mpm_ctx->max_pat_id + 1) * sizeof(SCACPatternList));
 
     for (i = 0; i < mpm_ctx->pattern_cnt; i++) {
-        if (!(ctx->parray[i]->flags & MPM_PATTERN_FLAG_NOCASE)) {
-            ctx->pid_pat_list[ctx->parray[i]->id].cs = SCMalloc(ctx->parray[i]->len);
-            if (ctx->pid_pat_list[ctx->parray[i]->id].cs == NULL) {
-                SCLogError(SC_ERR_MEM_ALLOC, "Error allocating memory");
-                exit(EXIT_FAILURE);
-            }
-            memcpy(ctx->pid_pat_list[ctx->parray[i]->id].cs,
-                   ctx->parray[i]->original_pat, ctx->parray[i]->len);
-            ctx->pid_pat_list[ctx->parray[i]->id].patlen = ctx->parray[i]->len;
-        }
-        ctx->pid_pat_list[ctx->parray[i]->id].offset = ctx->parray[i]->offset;
-        ctx->pid_pat_list[ctx->parray[i]->id].depth = ctx->parray[i]->depth;
-
         /* ACPatternList now owns this memory */
-        //SCLogInfo("ctx->parray[i]->sids_size %u", ctx->parray[i]->sids_size);
         ctx->pid_pat_list[ctx->parray[i]->id].sids_size = ctx->parray[i]->sids_size;
         ctx->pid_pat_list[ctx->parray[i]->id].sids = ctx->parray[i]->sids;
 
@@ -839,8 +1309,48 @@ int SCACPreparePatterns(MpmCtx *mpm_ctx)
         ctx->parray[i]->sids = NULL;
     }
 
-    /* prepare the state table required by AC */
-    SCACPrepareStateTable(mpm_ctx);
+    uint32_t key_len = 0;
+    uint8_t *key = SCACSharedTablesKey(ctx->parray, mpm_ctx->pattern_cnt, &key_len);
+    if (key == NULL)
+        goto error;
+
+    SCACSharedTables *shared = SCACSharedTablesGet(key, key_len, ctx->compact);
+    if (shared != NULL) {
+        SCLogDebug("reusing tables %p with %u patterns (ref_cnt %u)",
+                   shared, shared->pattern_cnt, shared->ref_cnt);
+        SCFree(key);
+        SCACUseSharedTables(ctx, shared);
+    } else {
+        /* handle no case patterns */
+        for (i = 0; i < mpm_ctx->pattern_cnt; i++) {
+            if (!(ctx->parray[i]->flags & MPM_PATTERN_FLAG_NOCASE)) {
+                ctx->pid_pat_list[ctx->parray[i]->id].cs = SCMalloc(ctx->parray[i]->len);
+                if (ctx->pid_pat_list[ctx->parray[i]->id].cs == NULL) {
+                    SCLogError(SC_ERR_MEM_ALLOC, "Error allocating memory");
+                    exit(EXIT_FAILURE);
+                }
+                memcpy(ctx->pid_pat_list[ctx->parray[i]->id].cs,
+                       ctx->parray[i]->original_pat, ctx->parray[i]->len);
+            }
+            ctx->pid_pat_list[ctx->parray[i]->id].patlen = ctx->parray[i]->len;
+            ctx->pid_pat_list[ctx->parray[i]->id].offset = ctx->parray[i]->offset;
+            ctx->pid_pat_list[ctx->parray[i]->id].depth = ctx->parray[i]->depth;
+        }
+
+        /* prepare the state table required by AC */
+        SCACPrepareStateTable(mpm_ctx);
+
+        SCACSharedTables *new = SCACSharedTablesCreate(mpm_ctx, key, key_len);
+        shared = SCACSharedTablesAdd(new);
+        if (shared != new) {
+            /* someone else built the same tables in the meantime */
+            SCACUnaccountTables(mpm_ctx, &new->tables);
+            SCACSharedTablesFree(new);
+        } else {
+            ctx->shared_owner = true;
+        }
+        SCACUseSharedTables(ctx, shared);
+    }
 
     /* free all the stored patterns.  Should save us a good 100-200 mbs */
     for (i = 0; i < mpm_ctx->pattern_cnt; i++) {
@@ -910,9 +1420,8 @@ void SCACInitCtx(MpmCtx *mpm_ctx)
     }
     memset(mpm_ctx->init_hash, 0, sizeof(MpmPattern *) * MPM_INIT_HASH_SIZE);
 
-    /* get conf values for AC from our yaml file.  We have no conf values for
-     * now.  We will certainly need this, as we develop the algo */
-    SCACGetConfig();
+    /* get conf values for AC from our yaml file */
+    SCACGetConfig((SCACCtx *)mpm_ctx->ctx);
 
     SCReturn;
 }
@@ -969,6 +1478,10 @@ void SCACDestroyCtx(MpmCtx *mpm_ctx)
         mpm_ctx->memory_size -= (mpm_ctx->pattern_cnt * sizeof(MpmPattern *));
     }
 
+    if (ctx->shared != NULL) {
+        SCACReleaseSharedTables(mpm_ctx);
+    }
+
     if (ctx->state_table_u16 != NULL) {
         SCFree(ctx->state_table_u16);
         ctx->state_table_u16 = NULL;
@@ -986,6 +1499,17 @@ void SCACDestroyCtx(MpmCtx *mpm_ctx)
                                  sizeof(SC_AC_STATE_TYPE_U32) * 256);
     }
 
+    if (ctx->ctable != NULL) {
+        SCFree(ctx->ctable);
+        ctx->ctable = NULL;
+        SCFree(ctx->state_index);
+        ctx->state_index = NULL;
+
+        mpm_ctx->memory_cnt -= 2;
+        mpm_ctx->memory_size -= (ctx->state_count + ctx->ctable_size) *
+                                sizeof(uint32_t);
+    }
+
     if (ctx->output_table != NULL) {
         uint32_t state_count;
         for (state_count = 0; state_count < ctx->state_count; state_count++) {
@@ -1014,6 +1538,52 @@ void SCACDestroyCtx(MpmCtx *mpm_ctx)
     return;
 }
 
+/**
+ * \internal
+ * \brief The aho corasick search function for the compact state table.
+ */
+static uint32_t SCACSearchCompact(const SCACCtx *ctx, PrefilterRuleStore *pmq,
+                                  const uint8_t *buf, uint32_t buflen)
+{
+    const SCACPatternList *pid_pat_list = ctx->pid_pat_list;
+    uint32_t state = 0;
+    uint32_t matches = 0;
+
+    uint8_t bitarray[ctx->pattern_id_bitarray_size];
+    memset(bitarray, 0, ctx->pattern_id_bitarray_size);
+
+    for (uint32_t i = 0; i < buflen; i++) {
+        /* the byte classes fold the case, no need for u8_tolower */
+        state = SCACCompactNext(ctx, state & AC_COMPACT_STATE_MASK, buf[i]);
+        if (!(state & AC_COMPACT_OUTPUT))
+            continue;
+
+        const uint32_t no_of_entries =
+            ctx->output_table[state & AC_COMPACT_STATE_MASK].no_of_entries;
+        const uint32_t *pids = ctx->output_table[state & AC_COMPACT_STATE_MASK].pids;
+        for (uint32_t k = 0; k < no_of_entries; k++) {
+            const uint32_t lower_pid = pids[k] & AC_PID_MASK;
+            const SCACPatternList *pat = &pid_pat_list[lower_pid];
+            const int offset = i - pat->patlen + 1;
+
+            if (offset < (int)pat->offset || (pat->depth && i > pat->depth))
+                continue;
+
+            if ((pids[k] & AC_CASE_MASK) &&
+                    SCMemcmp(pat->cs, buf + offset, pat->patlen) != 0)
+                continue;
+
+            if (!(bitarray[lower_pid / 8] & (1 << (lower_pid % 8)))) {
+                bitarray[lower_pid / 8] |= (1 << (lower_pid % 8));
+                PrefilterAddSids(pmq, pat->sids, pat->sids_size);
+            }
+            matches++;
+        }
+    }
+
+    return matches;
+}
+
 /**
  * \brief The aho corasick search function.
  *
@@ -1038,6 +1608,9 @@ uint32_t SCACSearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
     /* \todo Change it for stateful MPM.  Supply the state using mpm_thread_ctx */
     const SCACPatternList *pid_pat_list = ctx->pid_pat_list;
 
+    if (ctx->ctable != NULL)
+        return SCACSearchCompact(ctx, pmq, buf, buflen);
+
     uint8_t bitarray[ctx->pattern_id_bitarray_size];
     memset(bitarray, 0, ctx->pattern_id_bitarray_size);
 
@@ -1225,12 +1798,37 @@ void SCACPrintInfo(MpmCtx *mpm_ctx)
     printf("Smallest:        %" PRIu32 "\n", mpm_ctx->minlen);
     printf("Largest:         %" PRIu32 "\n", mpm_ctx->maxlen);
     printf("Total states in the state table:    %" PRIu32 "\n", ctx->state_count);
+    if (ctx->ctable != NULL) {
+        printf("State table:     compact, %" PRIu32 " byte classes, "
+               "%" PRIu32 " sparse rows\n", (uint32_t)ctx->alphabet_size,
+               ctx->sparse_state_cnt);
+        printf("State table size: %" PRIuMAX "\n",
+               (uintmax_t)(ctx->state_count + ctx->ctable_size) * sizeof(uint32_t));
+    } else {
+        printf("State table:     full\n");
+        printf("State table size: %" PRIuMAX "\n", (uintmax_t)ctx->state_count * 256 *
+               (ctx->state_count < 32767 ? sizeof(SC_AC_STATE_TYPE_U16) :
+                                           sizeof(SC_AC_STATE_TYPE_U32)));
+    }
     printf("\n");
 
     return;
 }
 
 
+/**
+ * \brief Clean up the global memory used by all AC MPM instances.
+ */
+void MpmACGlobalCleanup(void)
+{
+    SCMutexLock(&g_ac_tables_mutex);
+    if (g_ac_tables != NULL) {
+        HashTableFree(g_ac_tables);
+        g_ac_tables = NULL;
+    }
+    SCMutexUnlock(&g_ac_tables_mutex);
+}
+
 /************************** Mpm Registration ***************************/
 
 /**
@@ -2280,6 +2878,197 @@ end:
     return result;
 }
 
+/** \internal
+ *  \brief search buf using the given state table layout. Every other
+ *          pattern is added nocase.
+ */
+static uint32_t SCACTestSearchLayout(bool compact, const char *pats[],
+        int pats_cnt, const uint8_t *buf, uint32_t buflen,
+        PrefilterRuleStore *pmq, uint32_t *sparse_cnt)
+{
+    MpmCtx mpm_ctx;
+    MpmThreadCtx mpm_thread_ctx;
+
+    memset(&mpm_ctx, 0, sizeof(MpmCtx));
+    memset(&mpm_thread_ctx, 0, sizeof(MpmThreadCtx));
+    MpmInitCtx(&mpm_ctx, MPM_AC);
+    ((SCACCtx *)mpm_ctx.ctx)->compact = compact;
+    SCACInitThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+
+    for (int i = 0; i < pats_cnt; i++) {
+        if (i % 2)
+            MpmAddPatternCI(&mpm_ctx, (uint8_t *)pats[i], strlen(pats[i]), 0, 0, i, i, 0);
+        else
+            MpmAddPatternCS(&mpm_ctx, (uint8_t *)pats[i], strlen(pats[i]), 0, 0, i, i, 0);
+    }
+    SCACPreparePatterns(&mpm_ctx);
+    if (sparse_cnt != NULL)
+        *sparse_cnt = ((SCACCtx *)mpm_ctx.ctx)->sparse_state_cnt;
+
+    uint32_t cnt = SCACSearch(&mpm_ctx, &mpm_thread_ctx, pmq, buf, buflen);
+
+    SCACDestroyCtx(&mpm_ctx);
+    SCACDestroyThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+    return cnt;
+}
+
+/** \test compact state table, case handling and overlapping patterns */
+static int SCACTest30(void)
+{
+    const char *pats[] = { "abcd", "BCDE", "cde", "ONE", "one", "xyz" };
+    const char *buf = "abcdefgh One oNe one XYZ";
+    PrefilterRuleStore pmq;
+
+    PmqSetup(&pmq);
+    uint32_t cnt = SCACTestSearchLayout(true, pats, 6, (uint8_t *)buf,
+                                        strlen(buf), &pmq, NULL);
+    /* ONE is nocase and matches 3 times */
+    FAIL_IF_NOT(cnt == 8);
+    FAIL_IF_NOT(pmq.rule_id_array_cnt == 6);
+    PmqFree(&pmq);
+    PASS;
+}
+
+/** \test compact state table, bytes not in any pattern reset the state */
+static int SCACTest31(void)
+{
+    const char *pats[] = { "abc" };
+    const uint8_t buf[] = { 'a', 'b', 0x00, 'c', 0xfe, 'a', 'b', 'c', 'A' };
+    PrefilterRuleStore pmq;
+
+    PmqSetup(&pmq);
+    uint32_t cnt = SCACTestSearchLayout(true, pats, 1, buf, sizeof(buf),
+                                        &pmq, NULL);
+    FAIL_IF_NOT(cnt == 1);
+    PmqFree(&pmq);
+    PASS;
+}
+
+/** \test compact and full state tables find the same patterns */
+static int SCACTest32(void)
+{
+    char patbuf[64][12];
+    const char *pats[64];
+    uint8_t buf[2048];
+    uint32_t seed = 1;
+
+    /* small alphabet for lots of partial matches, plus bytes that are not
+     * in any pattern */
+    for (uint32_t i = 0; i < sizeof(buf); i++) {
+        seed = seed * 1103515245 + 12345;
+        buf[i] = "abcdeABCDE\x01#"[(seed >> 16) % 12];
+    }
+    for (int i = 0; i < 64; i++) {
+        seed = seed * 1103515245 + 12345;
+        int len = 2 + (seed >> 16) % 10;
+        for (int j = 0; j < len; j++) {
+            seed = seed * 1103515245 + 12345;
+            patbuf[i][j] = "abcdeABCDE"[(seed >> 16) % 10];
+        }
+        patbuf[i][len] = '\0';
+        pats[i] = patbuf[i];
+    }
+
+    for (uint32_t len = 0; len <= sizeof(buf); len += 97) {
+        PrefilterRuleStore pmq_full, pmq_compact;
+        uint32_t sparse_cnt = 0;
+
+        PmqSetup(&pmq_full);
+        PmqSetup(&pmq_compact);
+        uint32_t cnt_full = SCACTestSearchLayout(false, pats, 64, buf, len,
+                                                 &pmq_full, NULL);
+        uint32_t cnt_compact = SCACTestSearchLayout(true, pats, 64, buf, len,
+                                                    &pmq_compact, &sparse_cnt);
+        FAIL_IF_NOT(sparse_cnt > 0);
+        FAIL_IF_NOT(cnt_full == cnt_compact);
+        FAIL_IF_NOT(pmq_full.rule_id_array_cnt == pmq_compact.rule_id_array_cnt);
+        FAIL_IF_NOT(memcmp(pmq_full.rule_id_array, pmq_compact.rule_id_array,
+                           pmq_full.rule_id_array_cnt * sizeof(SigIntId)) == 0);
+        PmqFree(&pmq_full);
+        PmqFree(&pmq_compact);
+    }
+    PASS;
+}
+
+/** \test ctxs with the same patterns share the tables, but keep their own
+ *        sids */
+static int SCACTest33(void)
+{
+    MpmCtx mpm_ctx[2];
+    MpmThreadCtx mpm_thread_ctx;
+    PrefilterRuleStore pmq;
+    const char *buf = "abcdefgh";
+
+    memset(&mpm_ctx, 0, sizeof(mpm_ctx));
+    memset(&mpm_thread_ctx, 0, sizeof(MpmThreadCtx));
+    PmqSetup(&pmq);
+
+    /* same patterns, in a different order and with different sids */
+    MpmInitCtx(&mpm_ctx[0], MPM_AC);
+    MpmAddPatternCS(&mpm_ctx[0], (uint8_t *)"abc", 3, 0, 0, 0, 1, MPM_PATTERN_CTX_OWNS_ID);
+    MpmAddPatternCI(&mpm_ctx[0], (uint8_t *)"FGH", 3, 0, 0, 0, 2, MPM_PATTERN_CTX_OWNS_ID);
+    SCACPreparePatterns(&mpm_ctx[0]);
+
+    MpmInitCtx(&mpm_ctx[1], MPM_AC);
+    MpmAddPatternCI(&mpm_ctx[1], (uint8_t *)"FGH", 3, 0, 0, 0, 3, MPM_PATTERN_CTX_OWNS_ID);
+    MpmAddPatternCS(&mpm_ctx[1], (uint8_t *)"abc", 3, 0, 0, 0, 4, MPM_PATTERN_CTX_OWNS_ID);
+    MpmAddPatternCS(&mpm_ctx[1], (uint8_t *)"abc", 3, 0, 0, 0, 5, MPM_PATTERN_CTX_OWNS_ID);
+    SCACPreparePatterns(&mpm_ctx[1]);
+
+    SCACCtx *ctx0 = (SCACCtx *)mpm_ctx[0].ctx;
+    SCACCtx *ctx1 = (SCACCtx *)mpm_ctx[1].ctx;
+    FAIL_IF(ctx0->shared == NULL);
+    FAIL_IF_NOT(ctx0->shared == ctx1->shared);
+    FAIL_IF_NOT(ctx0->state_table_u16 == ctx1->state_table_u16);
+    FAIL_IF_NOT(ctx0->shared_owner && !ctx1->shared_owner);
+
+    /* the tables outlive the ctx that built them */
+    SCACDestroyCtx(&mpm_ctx[0]);
+
+    SCACInitThreadCtx(&mpm_ctx[1], &mpm_thread_ctx);
+    uint32_t cnt = SCACSearch(&mpm_ctx[1], &mpm_thread_ctx, &pmq,
+                              (uint8_t *)buf, strlen(buf));
+    FAIL_IF_NOT(cnt == 2);
+    FAIL_IF_NOT(pmq.rule_id_array_cnt == 3);
+    FAIL_IF_NOT(pmq.rule_id_array[0] == 4 && pmq.rule_id_array[1] == 5);
+    FAIL_IF_NOT(pmq.rule_id_array[2] == 3);
+    PmqFree(&pmq);
+    SCACDestroyCtx(&mpm_ctx[1]);
+    SCACDestroyThreadCtx(&mpm_ctx[1], &mpm_thread_ctx);
+    PASS;
+}
+
+/** \test tables are not shared between different patterns or layouts */
+static int SCACTest34(void)
+{
+    MpmCtx mpm_ctx[3];
+
+    memset(&mpm_ctx, 0, sizeof(mpm_ctx));
+    for (int i = 0; i < 3; i++) {
+        MpmInitCtx(&mpm_ctx[i], MPM_AC);
+        /* same content, but nocase */
+        if (i == 1)
+            MpmAddPatternCI(&mpm_ctx[i], (uint8_t *)"abc", 3, 0, 0, 0, 1, MPM_PATTERN_CTX_OWNS_ID);
+        else
+            MpmAddPatternCS(&mpm_ctx[i], (uint8_t *)"abc", 3, 0, 0, 0, 1, MPM_PATTERN_CTX_OWNS_ID);
+        if (i == 2)
+            ((SCACCtx *)mpm_ctx[i].ctx)->compact = true;
+        SCACPreparePatterns(&mpm_ctx[i]);
+    }
+
+    const SCACCtx *ctx0 = (SCACCtx *)mpm_ctx[0].ctx;
+    const SCACCtx *ctx1 = (SCACCtx *)mpm_ctx[1].ctx;
+    const SCACCtx *ctx2 = (SCACCtx *)mpm_ctx[2].ctx;
+    FAIL_IF(ctx0->shared == ctx1->shared);
+    FAIL_IF(ctx0->shared == ctx2->shared);
+    FAIL_IF_NOT(ctx0->shared_owner && ctx1->shared_owner && ctx2->shared_owner);
+
+    for (int i = 0; i < 3; i++) {
+        SCACDestroyCtx(&mpm_ctx[i]);
+    }
+    PASS;
+}
+
 #endif /* UNITTESTS */
 
 void SCACRegisterTests(void)
@@ -2315,6 +3104,11 @@ void SCACRegisterTests(void)
     UtRegisterTest("SCACTest27", SCACTest27);
     UtRegisterTest("SCACTest28", SCACTest28);
     UtRegisterTest("SCACTest29", SCACTest29);
+    UtRegisterTest("SCACTest30", SCACTest30);
+    UtRegisterTest("SCACTest31", SCACTest31);
+    UtRegisterTest("SCACTest32", SCACTest32);
+    UtRegisterTest("SCACTest33", SCACTest33);
+    UtRegisterTest("SCACTest34", SCACTest34);
 #endif
 
     return;
@@ -28,6 +28,20 @@
 #define SC_AC_STATE_TYPE_U16 uint16_t
 #define SC_AC_STATE_TYPE_U32 uint32_t
 
+/* output table pid flags: pattern needs a case sensitive check */
+#define AC_CASE_MASK    0x80000000
+#define AC_PID_MASK     0x7FFFFFFF
+#define AC_CASE_BIT     31
+
+/* compact state table entries: next state, output flag and, in sparse
+ * rows, the byte class the entry is for */
+#define AC_COMPACT_STATE_MASK   0x007FFFFF
+#define AC_COMPACT_OUTPUT       0x00800000
+#define AC_COMPACT_ENTRY_MASK   0x00FFFFFF
+#define AC_COMPACT_CLASS_SHIFT  24
+/* state_index flag: the state's row is sparse */
+#define AC_COMPACT_SPARSE       0x80000000
+
 typedef struct SCACPatternList_ {
     uint8_t *cs;
     uint16_t patlen;
@@ -73,6 +87,26 @@ typedef struct SCACCtx_ {
 
     uint32_t allocated_state_count;
 
+    /* compact state table, used instead of state_table_u16/u32 when set up.
+     * Input bytes are mapped to byte classes. Per state, state_index holds
+     * the offset of its row in ctable. A row is either dense, one entry per
+     * class, or sparse, listing only the classes where it differs from the
+     * dense row of a state on its failure path */
+    uint32_t *state_index;
+    uint32_t *ctable;
+    uint32_t ctable_size;
+    uint32_t sparse_state_cnt;
+    uint16_t alphabet_size;
+    uint8_t translate_table[256];
+    /* build the compact table instead of the full one */
+    bool compact;
+
+    /* the tables above and the pattern data in pid_pat_list are shared with
+     * the other ctxs with the same patterns */
+    struct SCACSharedTables_ *shared;
+    /* this ctx built the shared tables and counts their memory */
+    bool shared_owner;
+
 } SCACCtx;
 
 typedef struct SCACThreadCtx_ {
@@ -83,5 +117,50 @@ typedef struct SCACThreadCtx_ {
 } SCACThreadCtx;
 
 void MpmACRegister(void);
+void MpmACGlobalCleanup(void);
+
+/**
+ * \brief Get the next state from the compact state table.
+ *
+ * \param ctx   AC context with a compact state table.
+ * \param state Current state.
+ * \param c     Input byte, case is folded by the byte class mapping.
+ *
+ * \retval next state, or'ed with AC_COMPACT_OUTPUT if it has outputs
+ */
+static inline uint32_t SCACCompactNext(const SCACCtx *ctx, uint32_t state,
+                                       uint8_t c)
+{
+    const uint32_t cls = ctx->translate_table[c];
+    const uint32_t idx = ctx->state_index[state];
+
+    if (!(idx & AC_COMPACT_SPARSE))
+        return ctx->ctable[idx + cls];
+
+    /* sparse row: entry count, offset of the dense row to fall back to,
+     * then the entries */
+    const uint32_t *row = &ctx->ctable[idx & ~AC_COMPACT_SPARSE];
+    const uint32_t n = row[0];
+    for (uint32_t k = 2; k < n + 2; k++) {
+        if ((row[k] >> AC_COMPACT_CLASS_SHIFT) == cls)
+            return row[k] & AC_COMPACT_ENTRY_MASK;
+    }
+    return ctx->ctable[row[1] + cls];
+}
+
+/* used by the AC variants building on the AC state table */
+void SCACGetConfig(SCACCtx *ctx);
+void SCACInitThreadCtx(MpmCtx *, MpmThreadCtx *);
+void SCACDestroyCtx(MpmCtx *);
+void SCACDestroyThreadCtx(MpmCtx *, MpmThreadCtx *);
+int SCACAddPatternCI(MpmCtx *, uint8_t *, uint16_t, uint16_t, uint16_t,
+                     uint32_t, SigIntId, uint8_t);
+int SCACAddPatternCS(MpmCtx *, uint8_t *, uint16_t, uint16_t, uint16_t,
+                     uint32_t, SigIntId, uint8_t);
+int SCACPreparePatterns(MpmCtx *mpm_ctx);
+uint32_t SCACSearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
+                    PrefilterRuleStore *pmq, const uint8_t *buf, uint32_t buflen);
+void SCACPrintInfo(MpmCtx *mpm_ctx);
+void SCACPrintSearchStats(MpmThreadCtx *mpm_thread_ctx);
 
 #endif /* __UTIL_MPM_AC__H__ */
@@ -455,29 +455,27 @@ typedef struct PatternDatabase_ {
 
     /* Reference count: number of MPM contexts using this pattern database. */
     uint32_t ref_cnt;
+
+    /* hs_db was loaded from the on-disk cache */
+    bool cached;
 } PatternDatabase;
 
 static uint32_t SCHSPatternHash(const SCHSPattern *p, uint32_t hash)
 {
     BUG_ON(p->original_pat == NULL);
-    BUG_ON(p->sids == NULL);
 
     hash = hashlittle_safe(&p->len, sizeof(p->len), hash);
     hash = hashlittle_safe(&p->flags, sizeof(p->flags), hash);
     hash = hashlittle_safe(p->original_pat, p->len, hash);
-    hash = hashlittle_safe(&p->id, sizeof(p->id), hash);
     hash = hashlittle_safe(&p->offset, sizeof(p->offset), hash);
     hash = hashlittle_safe(&p->depth, sizeof(p->depth), hash);
-    hash = hashlittle_safe(&p->sids_size, sizeof(p->sids_size), hash);
-    hash = hashlittle_safe(p->sids, p->sids_size * sizeof(SigIntId), hash);
     return hash;
 }
 
 static char SCHSPatternCompare(const SCHSPattern *p1, const SCHSPattern *p2)
 {
     if ((p1->len != p2->len) || (p1->flags != p2->flags) ||
-        (p1->id != p2->id) || (p1->offset != p2->offset) ||
-        (p1->depth != p2->depth) || (p1->sids_size != p2->sids_size)) {
+        (p1->offset != p2->offset) || (p1->depth != p2->depth)) {
         return 0;
     }
 
@@ -485,14 +483,32 @@ static char SCHSPatternCompare(const SCHSPattern *p1, const SCHSPattern *p2)
         return 0;
     }
 
-    if (SCMemcmp(p1->sids, p2->sids, p1->sids_size * sizeof(p1->sids[0])) !=
-        0) {
-        return 0;
-    }
-
     return 1;
 }
 
+/**
+ * \brief qsort callback putting the patterns in a canonical order, so that
+ *        ctxs with the same patterns end up with the same database.
+ */
+static int SCHSPatternSort(const void *a, const void *b)
+{
+    const SCHSPattern *p1 = *(const SCHSPattern **)a;
+    const SCHSPattern *p2 = *(const SCHSPattern **)b;
+
+    if (p1->len != p2->len)
+        return p1->len < p2->len ? -1 : 1;
+    int r = memcmp(p1->original_pat, p2->original_pat, p1->len);
+    if (r != 0)
+        return r;
+    if (p1->flags != p2->flags)
+        return p1->flags < p2->flags ? -1 : 1;
+    if (p1->offset != p2->offset)
+        return p1->offset < p2->offset ? -1 : 1;
+    if (p1->depth != p2->depth)
+        return p1->depth < p2->depth ? -1 : 1;
+    return 0;
+}
+
 static uint32_t PatternDatabaseHash(HashTable *ht, void *data, uint16_t len)
 {
     const PatternDatabase *pd = data;
@@ -576,6 +592,228 @@ static PatternDatabase *PatternDatabaseAlloc(uint32_t pattern_cnt)
     return pd;
 }
 
+/** magic at the start of a cache file, "SCHS" */
+#define HS_CACHE_MAGIC 0x53484353
+
+/** cache file header, followed by the key and the serialized database */
+typedef struct SCHSCacheHeader_ {
+    uint32_t magic;
+    uint32_t key_len;
+} SCHSCacheHeader;
+
+/**
+ * \internal
+ * \brief Get the cache directory, or NULL if caching is off.
+ */
+static const char *SCHSCacheDir(void)
+{
+    const char *dir = NULL;
+    if (ConfGet("mpm-hs.cache-dir", &dir) != 1 || dir == NULL || *dir == '\0')
+        return NULL;
+    return dir;
+}
+
+static void SCHSCacheKeyAdd(uint8_t *key, uint32_t *off, const void *data,
+                            uint32_t len)
+{
+    if (key != NULL)
+        memcpy(key + *off, data, len);
+    *off += len;
+}
+
+/**
+ * \internal
+ * \brief Write the cache key of the compile data to key, or only get its
+ *        length if key is NULL.
+ */
+static uint32_t SCHSCacheKeyFill(const SCHSCompileData *cd,
+                                 const hs_platform_info_t *plat, uint8_t *key)
+{
+    const char *version = hs_version();
+    const uint32_t version_len = strlen(version);
+    const uint32_t mode = HS_MODE_BLOCK;
+    const uint64_t cpu_features = plat->cpu_features;
+    const uint32_t tune = plat->tune;
+    uint32_t off = 0;
+
+    SCHSCacheKeyAdd(key, &off, &version_len, sizeof(version_len));
+    SCHSCacheKeyAdd(key, &off, version, version_len);
+    SCHSCacheKeyAdd(key, &off, &tune, sizeof(tune));
+    SCHSCacheKeyAdd(key, &off, &cpu_features, sizeof(cpu_features));
+    SCHSCacheKeyAdd(key, &off, &mode, sizeof(mode));
+    SCHSCacheKeyAdd(key, &off, &cd->pattern_cnt, sizeof(cd->pattern_cnt));
+
+    for (uint32_t i = 0; i < cd->pattern_cnt; i++) {
+        const uint32_t expr_len = strlen(cd->expressions[i]);
+        uint64_t ext[3] = { 0, 0, 0 };
+        if (cd->ext[i] != NULL) {
+            ext[0] = cd->ext[i]->flags;
+            ext[1] = cd->ext[i]->min_offset;
+            ext[2] = cd->ext[i]->max_offset;
+        }
+
+        SCHSCacheKeyAdd(key, &off, &cd->ids[i], sizeof(cd->ids[i]));
+        SCHSCacheKeyAdd(key, &off, &cd->flags[i], sizeof(cd->flags[i]));
+        SCHSCacheKeyAdd(key, &off, ext, sizeof(ext));
+        SCHSCacheKeyAdd(key, &off, &expr_len, sizeof(expr_len));
+        SCHSCacheKeyAdd(key, &off, cd->expressions[i], expr_len);
+    }
+    return off;
+}
+
+/**
+ * \internal
+ * \brief Build the key of the on-disk cache file of a pattern database.
+ *
+ * The key holds everything the compiled database depends on: the
+ * Hyperscan version, the platform, and the expressions with their ids,
+ * flags and offsets. It is stored in the cache file and compared in full
+ * before the database is used, so a file name collision or a file from
+ * another build is never mistaken for the database of these patterns.
+ *
+ * \retval key or NULL on error. Free with SCFree.
+ */
+static uint8_t *SCHSCacheKey(const SCHSCompileData *cd, uint32_t *key_len)
+{
+    hs_platform_info_t plat;
+    if (hs_populate_platform(&plat) != HS_SUCCESS)
+        return NULL;
+
+    *key_len = SCHSCacheKeyFill(cd, &plat, NULL);
+    uint8_t *key = SCMalloc(*key_len);
+    if (key == NULL)
+        return NULL;
+    SCHSCacheKeyFill(cd, &plat, key);
+    return key;
+}
+
+/**
+ * \internal
+ * \brief Get the path of the on-disk cache file for a cache key.
+ *
+ * The file name is a 64 bit hash of the key, built from two 32 bit
+ * hashes with different seeds.
+ *
+ * \retval 0 on success, -1 on error
+ */
+static int SCHSCachePath(const char *dir, const uint8_t *key, uint32_t key_len,
+                         char *path, size_t size)
+{
+    const uint32_t h1 = hashlittle_safe(key, key_len, 0);
+    const uint32_t h2 = hashlittle_safe(key, key_len, 0x9e3779b9);
+
+    int r = snprintf(path, size, "%s/%08x%08x.hs", dir, h1, h2);
+    if (r < 0 || (size_t)r >= size)
+        return -1;
+    return 0;
+}
+
+/**
+ * \internal
+ * \brief Load the database of a pattern set from the on-disk cache.
+ *
+ * The database is only deserialized if the key stored in the file is
+ * the key of the patterns being compiled. Otherwise the database is
+ * compiled and the file replaced.
+ *
+ * \retval 0 if pd->hs_db was loaded, -1 otherwise
+ */
+static int SCHSCacheLoad(PatternDatabase *pd, const char *path,
+                         const uint8_t *key, uint32_t key_len)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+        return -1;
+
+    int ret = -1;
+    char *bytes = NULL;
+    struct stat st;
+    if (fstat(fileno(fp), &st) != 0 ||
+            (uint64_t)st.st_size <= sizeof(SCHSCacheHeader) + key_len)
+        goto end;
+
+    bytes = SCMalloc(st.st_size);
+    if (bytes == NULL)
+        goto end;
+    if (fread(bytes, 1, st.st_size, fp) != (size_t)st.st_size)
+        goto end;
+
+    SCHSCacheHeader hdr;
+    memcpy(&hdr, bytes, sizeof(hdr));
+    if (hdr.magic != HS_CACHE_MAGIC || hdr.key_len != key_len ||
+            memcmp(bytes + sizeof(hdr), key, key_len) != 0) {
+        SCLogDebug("cached database %s is for other patterns or another "
+                   "Hyperscan build", path);
+        goto end;
+    }
+
+    const size_t db_off = sizeof(hdr) + key_len;
+    hs_error_t err = hs_deserialize_database(bytes + db_off,
+            st.st_size - db_off, &pd->hs_db);
+    if (err != HS_SUCCESS) {
+        SCLogDebug("cached database %s not usable: %d", path, err);
+        pd->hs_db = NULL;
+        goto end;
+    }
+    SCLogDebug("loaded database with %" PRIu32 " patterns from %s",
+               pd->pattern_cnt, path);
+    pd->cached = true;
+    ret = 0;
+end:
+    if (bytes != NULL)
+        SCFree(bytes);
+    fclose(fp);
+    return ret;
+}
+
+/**
+ * \internal
+ * \brief Store the compiled database of a pattern set in the on-disk cache.
+ *
+ * The file is written under a temporary name and renamed, so that other
+ * instances sharing the directory never see a partial file.
+ */
+static void SCHSCacheSave(const PatternDatabase *pd, const char *path,
+                          const uint8_t *key, uint32_t key_len)
+{
+    char tmp_path[PATH_MAX];
+    int r = snprintf(tmp_path, sizeof(tmp_path), "%s.%d.%lu.tmp", path,
+                     (int)getpid(), SCGetThreadIdLong());
+    if (r < 0 || (size_t)r >= sizeof(tmp_path))
+        return;
+
+    char *bytes = NULL;
+    size_t len = 0;
+    if (hs_serialize_database(pd->hs_db, &bytes, &len) != HS_SUCCESS)
+        return;
+
+    FILE *fp = fopen(tmp_path, "wb");
+    if (fp == NULL) {
+        static bool warned = false;
+        if (!warned) {
+            SCLogWarning(SC_ERR_FOPEN, "failed to write Hyperscan cache file "
+                         "%s: %s", tmp_path, strerror(errno));
+            warned = true;
+        }
+        SCHSFree(bytes);
+        return;
+    }
+
+    const SCHSCacheHeader hdr = { HS_CACHE_MAGIC, key_len };
+    bool ok = (fwrite(&hdr, 1, sizeof(hdr), fp) == sizeof(hdr));
+    ok &= (fwrite(key, 1, key_len, fp) == key_len);
+    ok &= (fwrite(bytes, 1, len, fp) == len);
+    ok &= (fclose(fp) == 0);
+    SCHSFree(bytes);
+
+    if (!ok || rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        return;
+    }
+    SCLogDebug("stored database with %" PRIu32 " patterns in %s",
+               pd->pattern_cnt, path);
+}
+
 /**
  * \brief Process the patterns added to the mpm, and create the internal tables.
  *
@@ -620,8 +858,26 @@ int SCHSPreparePatterns(MpmCtx *mpm_ctx)
     SCFree(ctx->init_hash);
     ctx->init_hash = NULL;
 
-    /* Serialise whole database compilation as a relatively easy way to ensure
-     * dedupe is safe. */
+    /* The database is keyed on the patterns only. The sids differ between
+     * detection engines (tenants, reloads), so they move to the ctx. */
+    qsort(pd->parray, pd->pattern_cnt, sizeof(SCHSPattern *), SCHSPatternSort);
+
+    ctx->sids = SCMalloc(pd->pattern_cnt * sizeof(SCHSSids));
+    if (ctx->sids == NULL) {
+        goto error;
+    }
+    ctx->sids_cnt = pd->pattern_cnt;
+    for (uint32_t i = 0; i < pd->pattern_cnt; i++) {
+        ctx->sids[i].sids = pd->parray[i]->sids;
+        ctx->sids[i].sids_size = pd->parray[i]->sids_size;
+        pd->parray[i]->sids = NULL;
+        pd->parray[i]->sids_size = 0;
+    }
+    mpm_ctx->memory_cnt++;
+    mpm_ctx->memory_size += pd->pattern_cnt * sizeof(SCHSSids);
+
+    /* Check global hash table to see if we've seen this pattern database
+     * before, and reuse the Hyperscan database if so. */
     SCMutexLock(&g_db_table_mutex);
 
     /* Init global pattern database hash if necessary. */
@@ -635,10 +891,7 @@ int SCHSPreparePatterns(MpmCtx *mpm_ctx)
         }
     }
 
-    /* Check global hash table to see if we've seen this pattern database
-     * before, and reuse the Hyperscan database if so. */
     PatternDatabase *pd_cached = HashTableLookup(g_db_table, pd, 1);
-
     if (pd_cached != NULL) {
         SCLogDebug("Reusing cached database %p with %" PRIu32
                    " patterns (ref_cnt=%" PRIu32 ")",
@@ -651,9 +904,12 @@ int SCHSPreparePatterns(MpmCtx *mpm_ctx)
         SCHSFreeCompileData(cd);
         return 0;
     }
+    SCMutexUnlock(&g_db_table_mutex);
 
     BUG_ON(ctx->pattern_db != NULL); /* already built? */
 
+    /* Compile without holding the table lock, so that the mpm ctxs of
+     * the detection engine can be built in parallel. */
     for (uint32_t i = 0; i < pd->pattern_cnt; i++) {
         const SCHSPattern *p = pd->parray[i];
 
@@ -668,7 +924,6 @@ int SCHSPreparePatterns(MpmCtx *mpm_ctx)
         if (p->flags & (MPM_PATTERN_FLAG_OFFSET | MPM_PATTERN_FLAG_DEPTH)) {
             cd->ext[i] = SCMalloc(sizeof(hs_expr_ext_t));
             if (cd->ext[i] == NULL) {
-                SCMutexUnlock(&g_db_table_mutex);
                 goto error;
             }
             memset(cd->ext[i], 0, sizeof(hs_expr_ext_t));
@@ -686,52 +941,87 @@ int SCHSPreparePatterns(MpmCtx *mpm_ctx)
 
     BUG_ON(mpm_ctx->pattern_cnt == 0);
 
-    err = hs_compile_ext_multi((const char *const *)cd->expressions, cd->flags,
-                               cd->ids, (const hs_expr_ext_t *const *)cd->ext,
-                               cd->pattern_cnt, HS_MODE_BLOCK, NULL, &pd->hs_db,
-                               &compile_err);
-
-    if (err != HS_SUCCESS) {
-        SCLogError(SC_ERR_FATAL, "failed to compile hyperscan database");
-        if (compile_err) {
-            SCLogError(SC_ERR_FATAL, "compile error: %s", compile_err->message);
+    char cache_path[PATH_MAX];
+    uint32_t cache_key_len = 0;
+    uint8_t *cache_key = NULL;
+    const char *cache_dir = SCHSCacheDir();
+    if (cache_dir != NULL) {
+        cache_key = SCHSCacheKey(cd, &cache_key_len);
+        if (cache_key != NULL && SCHSCachePath(cache_dir, cache_key,
+                    cache_key_len, cache_path, sizeof(cache_path)) != 0) {
+            SCFree(cache_key);
+            cache_key = NULL;
         }
-        hs_free_compile_error(compile_err);
-        SCMutexUnlock(&g_db_table_mutex);
-        goto error;
     }
 
-    ctx->pattern_db = pd;
+    if (cache_key == NULL ||
+            SCHSCacheLoad(pd, cache_path, cache_key, cache_key_len) != 0) {
+        err = hs_compile_ext_multi((const char *const *)cd->expressions, cd->flags,
+                                   cd->ids, (const hs_expr_ext_t *const *)cd->ext,
+                                   cd->pattern_cnt, HS_MODE_BLOCK, NULL, &pd->hs_db,
+                                   &compile_err);
+
+        if (err != HS_SUCCESS) {
+            SCLogError(SC_ERR_FATAL, "failed to compile hyperscan database");
+            if (compile_err) {
+                SCLogError(SC_ERR_FATAL, "compile error: %s", compile_err->message);
+            }
+            hs_free_compile_error(compile_err);
+            if (cache_key != NULL)
+                SCFree(cache_key);
+            goto error;
+        }
+
+        if (cache_key != NULL)
+            SCHSCacheSave(pd, cache_path, cache_key, cache_key_len);
+    }
+    if (cache_key != NULL)
+        SCFree(cache_key);
 
     SCMutexLock(&g_scratch_proto_mutex);
     err = hs_alloc_scratch(pd->hs_db, &g_scratch_proto);
     SCMutexUnlock(&g_scratch_proto_mutex);
     if (err != HS_SUCCESS) {
         SCLogError(SC_ERR_FATAL, "failed to allocate scratch");
-        SCMutexUnlock(&g_db_table_mutex);
         goto error;
     }
 
-    err = hs_database_size(pd->hs_db, &ctx->hs_db_size);
+    size_t hs_db_size = 0;
+    err = hs_database_size(pd->hs_db, &hs_db_size);
     if (err != HS_SUCCESS) {
         SCLogError(SC_ERR_FATAL, "failed to query database size");
+        goto error;
+    }
+
+    /* Cache this database globally for later, unless a ctx with the same
+     * patterns finished its build first. */
+    SCMutexLock(&g_db_table_mutex);
+    pd_cached = HashTableLookup(g_db_table, pd, 1);
+    if (pd_cached != NULL) {
+        pd_cached->ref_cnt++;
+        ctx->pattern_db = pd_cached;
+        SCMutexUnlock(&g_db_table_mutex);
+        PatternDatabaseFree(pd);
+        SCHSFreeCompileData(cd);
+        return 0;
+    }
+    pd->ref_cnt = 1;
+    int r = HashTableAdd(g_db_table, pd, 1);
+    if (r < 0) {
+        pd->ref_cnt = 0;
         SCMutexUnlock(&g_db_table_mutex);
         goto error;
     }
+    SCMutexUnlock(&g_db_table_mutex);
 
+    ctx->pattern_db = pd;
+    ctx->hs_db_size = hs_db_size;
     mpm_ctx->memory_cnt++;
     mpm_ctx->memory_size += ctx->hs_db_size;
 
     SCLogDebug("Built %" PRIu32 " patterns into a database of size %" PRIuMAX
                " bytes", mpm_ctx->pattern_cnt, (uintmax_t)ctx->hs_db_size);
 
-    /* Cache this database globally for later. */
-    pd->ref_cnt = 1;
-    int r = HashTableAdd(g_db_table, pd, 1);
-    SCMutexUnlock(&g_db_table_mutex);
-    if (r < 0)
-        goto error;
-
     SCHSFreeCompileData(cd);
     return 0;
 
@@ -884,6 +1174,15 @@ void SCHSDestroyCtx(MpmCtx *mpm_ctx)
     }
     SCMutexUnlock(&g_db_table_mutex);
 
+    if (ctx->sids != NULL) {
+        for (uint32_t i = 0; i < ctx->sids_cnt; i++) {
+            SCFree(ctx->sids[i].sids);
+        }
+        SCFree(ctx->sids);
+        mpm_ctx->memory_cnt--;
+        mpm_ctx->memory_size -= ctx->sids_cnt * sizeof(SCHSSids);
+    }
+
     SCFree(mpm_ctx->ctx);
     mpm_ctx->memory_cnt--;
     mpm_ctx->memory_size -= sizeof(SCHSCtx);
@@ -902,14 +1201,12 @@ static int SCHSMatchEvent(unsigned int id, unsigned long long from,
 {
     SCHSCallbackCtx *cctx = ctx;
     PrefilterRuleStore *pmq = cctx->pmq;
-    const PatternDatabase *pd = cctx->ctx->pattern_db;
-    const SCHSPattern *pat = pd->parray[id];
+    const SCHSSids *s = &cctx->ctx->sids[id];
 
-    SCLogDebug("Hyperscan Match %" PRIu32 ": id=%" PRIu32 " @ %" PRIuMAX
-               " (pat id=%" PRIu32 ")",
-               cctx->match_count, (uint32_t)id, (uintmax_t)to, pat->id);
+    SCLogDebug("Hyperscan Match %" PRIu32 ": id=%" PRIu32 " @ %" PRIuMAX,
+               cctx->match_count, (uint32_t)id, (uintmax_t)to);
 
-    PrefilterAddSids(pmq, pat->sids, pat->sids_size);
+    PrefilterAddSids(pmq, s->sids, s->sids_size);
 
     cctx->match_count++;
     return 0;
@@ -2145,6 +2442,106 @@ end:
     return result;
 }
 
+/** \internal
+ *  \brief get the path of the only cache file in dir
+ */
+static int SCHSTestCacheFile(const char *dir, char *path, size_t size)
+{
+    DIR *d = opendir(dir);
+    if (d == NULL)
+        return -1;
+
+    int cnt = 0;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        const size_t len = strlen(e->d_name);
+        if (len > 3 && strcmp(e->d_name + len - 3, ".hs") == 0) {
+            snprintf(path, size, "%s/%s", dir, e->d_name);
+            cnt++;
+        }
+    }
+    closedir(d);
+    return cnt == 1 ? 0 : -1;
+}
+
+/** \internal
+ *  \brief build a ctx for the test patterns and search with it
+ *
+ *  \retval 1 if the database was loaded from the cache, 0 if it was
+ *          compiled, -1 on error
+ */
+static int SCHSTestCacheRun(void)
+{
+    MpmCtx mpm_ctx;
+    MpmThreadCtx mpm_thread_ctx;
+    PrefilterRuleStore pmq;
+    const char *buf = "abcdefghjiklmnopqrstuvwxyz";
+
+    memset(&mpm_ctx, 0, sizeof(MpmCtx));
+    memset(&mpm_thread_ctx, 0, sizeof(MpmThreadCtx));
+    MpmInitCtx(&mpm_ctx, MPM_HS);
+
+    MpmAddPatternCS(&mpm_ctx, (uint8_t *)"abcd", 4, 0, 0, 0, 0, 0);
+    MpmAddPatternCI(&mpm_ctx, (uint8_t *)"XYZ", 3, 0, 0, 1, 1, 0);
+    PmqSetup(&pmq);
+
+    if (SCHSPreparePatterns(&mpm_ctx) != 0)
+        return -1;
+    const SCHSCtx *ctx = (SCHSCtx *)mpm_ctx.ctx;
+    const PatternDatabase *pd = (PatternDatabase *)ctx->pattern_db;
+    int ret = pd->cached ? 1 : 0;
+
+    SCHSInitThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+    uint32_t cnt = SCHSSearch(&mpm_ctx, &mpm_thread_ctx, &pmq,
+                              (uint8_t *)buf, strlen(buf));
+    if (cnt != 2)
+        ret = -1;
+
+    SCHSDestroyCtx(&mpm_ctx);
+    SCHSDestroyThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+    PmqFree(&pmq);
+    return ret;
+}
+
+/** \test database is stored in and loaded from the cache directory, and
+ *        a file with another key is not used */
+static int SCHSTest30(void)
+{
+    char dir[] = "/tmp/suricata-hs-cache-XXXXXX";
+    FAIL_IF_NULL(mkdtemp(dir));
+
+    ConfCreateContextBackup();
+    ConfInit();
+    FAIL_IF_NOT(ConfSet("mpm-hs.cache-dir", dir) == 1);
+
+    /* the first run compiles and stores, the second loads */
+    FAIL_IF_NOT(SCHSTestCacheRun() == 0);
+    char path[PATH_MAX] = "";
+    FAIL_IF(SCHSTestCacheFile(dir, path, sizeof(path)) != 0);
+    FAIL_IF_NOT(SCHSTestCacheRun() == 1);
+
+    /* change the last byte of the stored key, the last pattern's
+     * expression: same file name, other patterns */
+    FILE *fp = fopen(path, "r+b");
+    FAIL_IF_NULL(fp);
+    SCHSCacheHeader hdr;
+    FAIL_IF_NOT(fread(&hdr, 1, sizeof(hdr), fp) == sizeof(hdr));
+    FAIL_IF_NOT(hdr.magic == HS_CACHE_MAGIC);
+    FAIL_IF(fseek(fp, sizeof(hdr) + hdr.key_len - 1, SEEK_SET) != 0);
+    FAIL_IF_NOT(fputc('!', fp) == '!');
+    FAIL_IF(fclose(fp) != 0);
+
+    /* mismatch: compiled again and the file replaced */
+    FAIL_IF_NOT(SCHSTestCacheRun() == 0);
+    FAIL_IF_NOT(SCHSTestCacheRun() == 1);
+
+    unlink(path);
+    rmdir(dir);
+    ConfDeInit();
+    ConfRestoreContextBackup();
+    PASS;
+}
+
 #endif /* UNITTESTS */
 
 void SCHSRegisterTests(void)
@@ -2179,6 +2576,7 @@ void SCHSRegisterTests(void)
     UtRegisterTest("SCHSTest27", SCHSTest27);
     UtRegisterTest("SCHSTest28", SCHSTest28);
     UtRegisterTest("SCHSTest29", SCHSTest29);
+    UtRegisterTest("SCHSTest30", SCHSTest30);
 #endif
 
     return;
@@ -49,6 +49,12 @@ typedef struct SCHSPattern_ {
     struct SCHSPattern_ *next;
 } SCHSPattern;
 
+/* sids for a pattern of the database */
+typedef struct SCHSSids_ {
+    uint32_t sids_size;
+    SigIntId *sids;
+} SCHSSids;
+
 typedef struct SCHSCtx_ {
     /* hash used during ctx initialization */
     SCHSPattern **init_hash;
@@ -56,6 +62,11 @@ typedef struct SCHSCtx_ {
     /* pattern database and pattern arrays. */
     void *pattern_db;
 
+    /* sids per database pattern id. Kept in the ctx as the database is
+     * shared with ctxs that use the same patterns for other sids. */
+    SCHSSids *sids;
+    uint32_t sids_cnt;
+
     /* size of database, for accounting. */
     size_t hs_db_size;
 } SCHSCtx;
@@ -35,6 +35,7 @@ enum {
     MPM_AC,
     MPM_AC_BS,
     MPM_AC_KS,
+    MPM_AC_SIMD,
     MPM_HS,
     /* table size */
     MPM_TABLE_SIZE,
@@ -84,6 +85,8 @@ typedef struct MpmPattern_ {
  * one per sgh. */
 #define MPMCTX_FLAGS_GLOBAL     BIT_U8(0)
 #define MPMCTX_FLAGS_NODEPTH    BIT_U8(1)
+/** ctx is queued for its Prepare, see DetectMpmPrepareQueued() */
+#define MPMCTX_FLAGS_QUEUED     BIT_U8(2)
 
 typedef struct MpmCtx_ {
     void *ctx;
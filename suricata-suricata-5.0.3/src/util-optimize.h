@@ -27,6 +27,7 @@
 #if CPPCHECK==1
 #define likely
 #define unlikely
+#define prefetch
 #else
 #ifndef likely
 #define likely(expr) __builtin_expect(!!(expr), 1)
@@ -34,6 +35,10 @@
 #ifndef unlikely
 #define unlikely(expr) __builtin_expect(!!(expr), 0)
 #endif
+/** hint the cpu to start loading the cache line at 'addr' for reading */
+#ifndef prefetch
+#define prefetch(addr) __builtin_prefetch((addr), 0, 3)
+#endif
 #endif
 
 /** from http://en.wikipedia.org/wiki/Memory_ordering
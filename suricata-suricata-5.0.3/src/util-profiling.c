@@ -1329,6 +1329,7 @@ const char * PacketProfileLoggertIdToString(LoggerId id)
         CASE_CODE (LOGGER_TCP_DATA);
         CASE_CODE (LOGGER_JSON_FLOW);
         CASE_CODE (LOGGER_JSON_NETFLOW);
+        CASE_CODE (LOGGER_FLOW_COLUMNAR);
         CASE_CODE (LOGGER_STATS);
         CASE_CODE (LOGGER_JSON_STATS);
         CASE_CODE (LOGGER_PRELUDE);
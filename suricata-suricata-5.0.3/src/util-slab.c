@@ -0,0 +1,742 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Per thread slab allocator with size classes.
+ *
+ * Memory is taken from the system in pages, each page holding a fixed
+ * number of chunks of one size class. Every chunk is preceded by a small
+ * header pointing to its page, so it can be freed without knowing its
+ * class or owner. Allocations larger than the largest class are passed
+ * to the system allocator.
+ *
+ * Pages belong to a SlabCache, which is only used by one thread at a time.
+ * A chunk freed by another thread is pushed on the owner's 'remote' list
+ * with a CAS, the owner moves those back to their pages when it runs out
+ * of free chunks. Only the owner pops from the list, and it always takes
+ * the whole list, so the list doesn't suffer from ABA.
+ *
+ * Memory use is reported per chunk handed out through the Reserve and
+ * Release callbacks, so the memcap of the user covers the memory it
+ * actually holds. A chunk is released when it is freed, also when another
+ * thread frees it, not when the owner takes it back. The free chunks of
+ * the pages aren't accounted; SLAB_PAGE_MIN_CHUNKS and SLAB_KEEP_EMPTY
+ * keep that overhead to a few pages per class and thread.
+ */
+
+#include "suricata-common.h"
+#include "util-atomic.h"
+#include "util-debug.h"
+#include "util-slab.h"
+#include "util-unittest.h"
+#include "util-validate.h"
+
+#define SLAB_ALIGN(x)   (((x) + 15) & ~((size_t)15))
+
+/** target size of a page */
+#define SLAB_PAGE_SIZE          65536
+/** min number of chunks in a page, only used by classes that don't fit
+ *  more into SLAB_PAGE_SIZE */
+#define SLAB_PAGE_MIN_CHUNKS    2
+/** empty pages kept per class on top of the reserved pages */
+#define SLAB_KEEP_EMPTY         1
+
+typedef struct SlabChunk_ {
+    union {
+        struct SlabPage_ *page; /**< page of the chunk */
+        Slab *slab;             /**< slab of a large chunk */
+    };
+    uint64_t size;              /**< size of a large chunk, 0 otherwise */
+} SlabChunk;
+
+typedef struct SlabPage_ {
+    SlabCache *cache;           /**< owner of the page */
+    int class_idx;
+    uint32_t inuse;             /**< chunks handed out */
+    SlabChunk *free;            /**< free chunks */
+    struct SlabPage_ *prev;
+    struct SlabPage_ *next;
+} SlabPage;
+
+#define SLAB_PAGE_HDR       SLAB_ALIGN(sizeof(SlabPage))
+#define SLAB_CHUNK_HDR      SLAB_ALIGN(sizeof(SlabChunk))
+
+#define ChunkData(c)        ((void *)((uint8_t *)(c) + SLAB_CHUNK_HDR))
+#define DataChunk(p)        ((SlabChunk *)((uint8_t *)(p) - SLAB_CHUNK_HDR))
+
+/* free and remote lists are linked through the chunk data */
+#define ChunkNext(c)        (*(SlabChunk **)ChunkData(c))
+
+static inline size_t ChunkBytes(const SlabClass *cls)
+{
+    return SLAB_CHUNK_HDR + cls->size;
+}
+
+static inline size_t PageBytes(const SlabClass *cls)
+{
+    return SLAB_PAGE_HDR + (size_t)cls->chunks * ChunkBytes(cls);
+}
+
+/** \internal
+ *  \brief get the smallest class that fits 'size'
+ *  \retval idx class index or -1 if the size is larger than all classes */
+static inline int SlabClassIndex(const Slab *slab, size_t size)
+{
+    for (int i = 0; i < slab->nclasses; i++) {
+        if (size <= slab->sizes[i])
+            return i;
+    }
+    return -1;
+}
+
+static void PageListRemove(SlabPage **head, SlabPage **tail, SlabPage *page)
+{
+    if (page->prev)
+        page->prev->next = page->next;
+    else
+        *head = page->next;
+    if (page->next)
+        page->next->prev = page->prev;
+    else if (tail != NULL)
+        *tail = page->prev;
+    page->prev = page->next = NULL;
+}
+
+static void PageListPushHead(SlabPage **head, SlabPage **tail, SlabPage *page)
+{
+    page->prev = NULL;
+    page->next = *head;
+    if (*head)
+        (*head)->prev = page;
+    else if (tail != NULL)
+        *tail = page;
+    *head = page;
+}
+
+static void PageListPushTail(SlabPage **head, SlabPage **tail, SlabPage *page)
+{
+    page->next = NULL;
+    page->prev = *tail;
+    if (*tail)
+        (*tail)->next = page;
+    else
+        *head = page;
+    *tail = page;
+}
+
+/** \internal
+ *  \brief add a new, empty page to a class of the cache */
+static SlabPage *PageNew(SlabCache *cache, int class_idx)
+{
+    SlabClass *cls = &cache->classes[class_idx];
+    SlabPage *page = SCMalloc(PageBytes(cls));
+    if (unlikely(page == NULL))
+        return NULL;
+    memset(page, 0, sizeof(*page));
+    page->cache = cache;
+    page->class_idx = class_idx;
+
+    uint8_t *ptr = (uint8_t *)page + SLAB_PAGE_HDR;
+    for (uint32_t i = 0; i < cls->chunks; i++) {
+        SlabChunk *c = (SlabChunk *)ptr;
+        c->page = page;
+        c->size = 0;
+        ChunkNext(c) = page->free;
+        page->free = c;
+        ptr += ChunkBytes(cls);
+    }
+
+    cls->pages++;
+    cls->empty++;
+    PageListPushTail(&cls->partial, &cls->partial_tail, page);
+    return page;
+}
+
+static void PageFree(SlabCache *cache, SlabPage *page)
+{
+    SlabClass *cls = &cache->classes[page->class_idx];
+    cls->pages--;
+    SCFree(page);
+}
+
+/** \internal
+ *  \brief return a chunk to its page, called by the owner of the page
+ *
+ *  The chunk's memory is released by the caller. */
+static void CacheFreeLocal(SlabCache *cache, SlabChunk *c)
+{
+    SlabPage *page = c->page;
+    SlabClass *cls = &cache->classes[page->class_idx];
+
+    if (page->free == NULL) {
+        PageListRemove(&cls->full, NULL, page);
+        PageListPushHead(&cls->partial, &cls->partial_tail, page);
+    }
+    ChunkNext(c) = page->free;
+    page->free = c;
+    page->inuse--;
+
+    if (page->inuse == 0) {
+        PageListRemove(&cls->partial, &cls->partial_tail, page);
+        if (cls->pages > cls->min_pages && cls->empty >= SLAB_KEEP_EMPTY) {
+            PageFree(cache, page);
+        } else {
+            /* empty pages last, so they are the first to become free */
+            cls->empty++;
+            PageListPushTail(&cls->partial, &cls->partial_tail, page);
+        }
+    }
+}
+
+/** \internal
+ *  \brief take back the chunks other threads freed */
+static void CacheDrainRemote(SlabCache *cache)
+{
+    SlabChunk *list;
+    do {
+        list = SC_ATOMIC_GET(cache->remote);
+        if (list == NULL)
+            return;
+    } while (SC_ATOMIC_CAS(&cache->remote, list, NULL) == 0);
+
+    while (list != NULL) {
+        SlabChunk *next = ChunkNext(list);
+        CacheFreeLocal(cache, list);
+        list = next;
+    }
+}
+
+static void *CacheAlloc(SlabCache *cache, int class_idx)
+{
+    SlabClass *cls = &cache->classes[class_idx];
+
+    if (cache->slab->Reserve(ChunkBytes(cls)) == 0)
+        return NULL;
+    if (cls->partial == NULL) {
+        CacheDrainRemote(cache);
+        if (cls->partial == NULL && PageNew(cache, class_idx) == NULL) {
+            cache->slab->Release(ChunkBytes(cls));
+            return NULL;
+        }
+    }
+
+    SlabPage *page = cls->partial;
+    SlabChunk *c = page->free;
+    page->free = ChunkNext(c);
+    if (page->inuse++ == 0)
+        cls->empty--;
+    if (page->free == NULL) {
+        PageListRemove(&cls->partial, &cls->partial_tail, page);
+        PageListPushHead(&cls->full, NULL, page);
+    }
+    return ChunkData(c);
+}
+
+static void *SlabAllocLarge(Slab *slab, size_t size)
+{
+    const size_t bytes = SLAB_CHUNK_HDR + size;
+    if (slab->Reserve(bytes) == 0)
+        return NULL;
+    SlabChunk *c = SCMalloc(bytes);
+    if (unlikely(c == NULL)) {
+        slab->Release(bytes);
+        return NULL;
+    }
+    c->slab = slab;
+    c->size = size;
+    return ChunkData(c);
+}
+
+static SlabCache *SlabCacheNew(Slab *slab)
+{
+    SlabCache *cache = SCCalloc(1, sizeof(*cache));
+    if (unlikely(cache == NULL))
+        return NULL;
+    cache->slab = slab;
+    SC_ATOMIC_INIT(cache->remote);
+    for (int i = 0; i < slab->nclasses; i++) {
+        SlabClass *cls = &cache->classes[i];
+        cls->size = slab->sizes[i];
+        cls->chunks = SLAB_PAGE_SIZE / (SLAB_CHUNK_HDR + cls->size);
+        if (cls->chunks < SLAB_PAGE_MIN_CHUNKS)
+            cls->chunks = SLAB_PAGE_MIN_CHUNKS;
+    }
+    cache->next = slab->caches;
+    slab->caches = cache;
+    return cache;
+}
+
+static void SlabCacheFree(SlabCache *cache)
+{
+    /* chunks on the remote list were released when they were freed */
+    CacheDrainRemote(cache);
+
+    for (int i = 0; i < cache->slab->nclasses; i++) {
+        SlabClass *cls = &cache->classes[i];
+        while (cls->partial != NULL) {
+            SlabPage *page = cls->partial;
+            PageListRemove(&cls->partial, &cls->partial_tail, page);
+            cache->slab->Release(page->inuse * ChunkBytes(cls));
+            PageFree(cache, page);
+        }
+        while (cls->full != NULL) {
+            SlabPage *page = cls->full;
+            PageListRemove(&cls->full, NULL, page);
+            cache->slab->Release(page->inuse * ChunkBytes(cls));
+            PageFree(cache, page);
+        }
+    }
+    SC_ATOMIC_DESTROY(cache->remote);
+    SCFree(cache);
+}
+
+/**
+ * \brief Set up a slab.
+ *
+ * \param sizes chunk sizes of the classes, in ascending order
+ * \param nsizes number of sizes
+ * \param Reserve called before handing out a chunk or a large
+ *        allocation, returns 0 if the memory can't be used
+ * \param Release called when a chunk or a large allocation is freed
+ *
+ * \retval slab or NULL on error
+ */
+Slab *SlabInit(const uint32_t *sizes, int nsizes,
+        int (*Reserve)(size_t), void (*Release)(size_t))
+{
+    if (nsizes <= 0 || nsizes > SLAB_MAX_CLASSES)
+        return NULL;
+
+    Slab *slab = SCCalloc(1, sizeof(*slab));
+    if (unlikely(slab == NULL))
+        return NULL;
+
+    for (int i = 0; i < nsizes; i++) {
+        uint32_t size = SLAB_ALIGN(sizes[i] ? sizes[i] : 1);
+        if (slab->nclasses > 0) {
+            if (size < slab->sizes[slab->nclasses - 1]) {
+                SCFree(slab);
+                return NULL;
+            }
+            if (size == slab->sizes[slab->nclasses - 1])
+                continue;
+        }
+        slab->sizes[slab->nclasses++] = size;
+    }
+    slab->Reserve = Reserve;
+    slab->Release = Release;
+    SCMutexInit(&slab->lock, NULL);
+    SCMutexInit(&slab->shared_lock, NULL);
+
+    slab->shared = SlabCacheNew(slab);
+    if (slab->shared == NULL) {
+        SlabDestroy(slab);
+        return NULL;
+    }
+    slab->shared->owned = true;
+    return slab;
+}
+
+/**
+ * \brief Free a slab and all memory of its caches.
+ *
+ * Chunks still in use are released. Large chunks that weren't freed are
+ * leaked.
+ */
+void SlabDestroy(Slab *slab)
+{
+    if (slab == NULL)
+        return;
+
+    SlabCache *cache = slab->caches;
+    while (cache != NULL) {
+        SlabCache *next = cache->next;
+        SlabCacheFree(cache);
+        cache = next;
+    }
+    SCMutexDestroy(&slab->lock);
+    SCMutexDestroy(&slab->shared_lock);
+    SCFree(slab);
+}
+
+/**
+ * \brief Get a cache for the calling thread.
+ *
+ * A cache released by a thread that went away is reused, so its pages,
+ * which may still hold chunks in use, aren't orphaned.
+ */
+SlabCache *SlabCacheGet(Slab *slab)
+{
+    SCMutexLock(&slab->lock);
+    SlabCache *cache = slab->caches;
+    while (cache != NULL && cache->owned)
+        cache = cache->next;
+    if (cache == NULL)
+        cache = SlabCacheNew(slab);
+    if (cache != NULL)
+        cache->owned = true;
+    SCMutexUnlock(&slab->lock);
+
+    if (cache != NULL)
+        CacheDrainRemote(cache);
+    return cache;
+}
+
+/**
+ * \brief Hand back a cache at thread exit.
+ *
+ * Chunks of the cache stay valid and can still be freed by any thread.
+ */
+void SlabCacheRelease(SlabCache *cache)
+{
+    if (cache == NULL)
+        return;
+
+    CacheDrainRemote(cache);
+
+    Slab *slab = cache->slab;
+    SCMutexLock(&slab->lock);
+    cache->owned = false;
+    SCMutexUnlock(&slab->lock);
+}
+
+/**
+ * \brief Preallocate pages for 'count' chunks of 'size' and keep them
+ *        even when they become empty.
+ *
+ * The pages only count towards the memcap once their chunks are used.
+ *
+ * \retval 0 on success, -1 if the memory couldn't be allocated
+ */
+int SlabCacheReserve(SlabCache *cache, size_t size, uint32_t count)
+{
+    const int class_idx = SlabClassIndex(cache->slab, size);
+    if (class_idx < 0)
+        return -1;
+
+    SlabClass *cls = &cache->classes[class_idx];
+    cls->min_pages = (count + cls->chunks - 1) / cls->chunks;
+    while (cls->pages < cls->min_pages) {
+        if (PageNew(cache, class_idx) == NULL)
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * \brief Allocate memory.
+ *
+ * \param cache cache of the calling thread, or NULL to use the shared cache
+ *
+ * \retval ptr uninitialized memory, or NULL if it couldn't be reserved
+ */
+void *SlabAlloc(Slab *slab, SlabCache *cache, size_t size)
+{
+    const int class_idx = SlabClassIndex(slab, size);
+    if (class_idx < 0)
+        return SlabAllocLarge(slab, size);
+
+    if (cache != NULL) {
+        DEBUG_VALIDATE_BUG_ON(cache->slab != slab);
+        return CacheAlloc(cache, class_idx);
+    }
+
+    SCMutexLock(&slab->shared_lock);
+    void *ptr = CacheAlloc(slab->shared, class_idx);
+    SCMutexUnlock(&slab->shared_lock);
+    return ptr;
+}
+
+/**
+ * \brief Resize memory.
+ *
+ * Memory that still fits its chunk isn't moved, so growing a buffer in
+ * small steps only copies it when it moves to the next class.
+ *
+ * \param orig_size size of the data in use, to limit the copy
+ *
+ * \retval ptr resized memory, or NULL if it couldn't be reserved, in which
+ *         case 'ptr' is still valid
+ */
+void *SlabRealloc(Slab *slab, SlabCache *cache, void *ptr,
+        size_t orig_size, size_t size)
+{
+    if (ptr == NULL)
+        return SlabAlloc(slab, cache, size);
+
+    SlabChunk *c = DataChunk(ptr);
+    if (c->size != 0) {
+        if (size <= c->size)
+            return ptr;
+        if (SlabClassIndex(slab, size) < 0) {
+            /* large to large, let the system allocator move or grow it */
+            const size_t diff = size - c->size;
+            if (slab->Reserve(diff) == 0)
+                return NULL;
+            SlabChunk *nc = SCRealloc(c, SLAB_CHUNK_HDR + size);
+            if (unlikely(nc == NULL)) {
+                slab->Release(diff);
+                return NULL;
+            }
+            nc->size = size;
+            return ChunkData(nc);
+        }
+    } else if (size <= slab->sizes[c->page->class_idx]) {
+        return ptr;
+    }
+
+    void *nptr = SlabAlloc(slab, cache, size);
+    if (nptr == NULL)
+        return NULL;
+    memcpy(nptr, ptr, MIN(orig_size, size));
+    SlabFree(cache, ptr);
+    return nptr;
+}
+
+/**
+ * \brief Free memory.
+ *
+ * \param cache cache of the calling thread, or NULL if it has none
+ */
+void SlabFree(SlabCache *cache, void *ptr)
+{
+    if (ptr == NULL)
+        return;
+
+    SlabChunk *c = DataChunk(ptr);
+    if (c->size != 0) {
+        Slab *slab = c->slab;
+        const size_t bytes = SLAB_CHUNK_HDR + c->size;
+        SCFree(c);
+        slab->Release(bytes);
+        return;
+    }
+
+    SlabPage *page = c->page;
+    page->cache->slab->Release(ChunkBytes(&page->cache->classes[page->class_idx]));
+    if (page->cache == cache) {
+        CacheFreeLocal(cache, c);
+        return;
+    }
+
+    SlabCache *owner = page->cache;
+    SlabChunk *head;
+    do {
+        head = SC_ATOMIC_GET(owner->remote);
+        ChunkNext(c) = head;
+    } while (SC_ATOMIC_CAS(&owner->remote, head, c) == 0);
+}
+
+#ifdef UNITTESTS
+static uint64_t slab_test_memuse = 0;
+static uint64_t slab_test_memcap = 0;
+
+static int SlabTestReserve(size_t size)
+{
+    if (slab_test_memcap && slab_test_memuse + size > slab_test_memcap)
+        return 0;
+    slab_test_memuse += size;
+    return 1;
+}
+
+static void SlabTestRelease(size_t size)
+{
+    slab_test_memuse -= size;
+}
+
+/** \test classes, in place realloc and large chunks */
+static int SlabTest01(void)
+{
+    const uint32_t sizes[] = { 40, 48, 2048, 4096 };
+    slab_test_memuse = slab_test_memcap = 0;
+
+    Slab *slab = SlabInit(sizes, 4, SlabTestReserve, SlabTestRelease);
+    FAIL_IF_NULL(slab);
+    /* 40 and 48 share a class */
+    FAIL_IF_NOT(slab->nclasses == 3);
+    SlabCache *cache = SlabCacheGet(slab);
+    FAIL_IF_NULL(cache);
+
+    uint8_t *a = SlabAlloc(slab, cache, 2048);
+    FAIL_IF_NULL(a);
+    FAIL_IF_NOT(slab_test_memuse == ChunkBytes(&cache->classes[1]));
+    memset(a, 'a', 2048);
+
+    /* still fits, stays in place */
+    FAIL_IF_NOT(SlabRealloc(slab, cache, a, 2048, 2000) == a);
+    /* next class, copied */
+    uint8_t *b = SlabRealloc(slab, cache, a, 2048, 4096);
+    FAIL_IF_NULL(b);
+    FAIL_IF(b == a);
+    FAIL_IF_NOT(b[0] == 'a' && b[2047] == 'a');
+    /* large, copied */
+    uint8_t *c = SlabRealloc(slab, cache, b, 4096, 10000);
+    FAIL_IF_NULL(c);
+    FAIL_IF_NOT(c[0] == 'a' && c[2047] == 'a');
+    c = SlabRealloc(slab, cache, c, 10000, 20000);
+    FAIL_IF_NULL(c);
+    FAIL_IF_NOT(c[0] == 'a' && c[2047] == 'a');
+    SlabFree(cache, c);
+
+    SlabCacheRelease(cache);
+    SlabDestroy(slab);
+    FAIL_IF_NOT(slab_test_memuse == 0);
+    PASS;
+}
+
+/** \test chunks freed by other threads and released caches */
+static int SlabTest02(void)
+{
+    const uint32_t sizes[] = { 48 };
+    slab_test_memuse = slab_test_memcap = 0;
+
+    Slab *slab = SlabInit(sizes, 1, SlabTestReserve, SlabTestRelease);
+    FAIL_IF_NULL(slab);
+    SlabCache *cache = SlabCacheGet(slab);
+    FAIL_IF_NULL(cache);
+    const uint32_t chunks = cache->classes[0].chunks;
+
+    void *ptrs[chunks];
+    for (uint32_t i = 0; i < chunks; i++) {
+        ptrs[i] = SlabAlloc(slab, cache, 48);
+        FAIL_IF_NULL(ptrs[i]);
+    }
+    FAIL_IF_NOT(cache->classes[0].pages == 1);
+    FAIL_IF_NOT(cache->classes[0].partial == NULL);
+
+    FAIL_IF_NOT(slab_test_memuse == chunks * ChunkBytes(&cache->classes[0]));
+
+    /* freed without the owner's cache, released right away */
+    SlabFree(NULL, ptrs[0]);
+    FAIL_IF_NOT(SC_ATOMIC_GET(cache->remote) == DataChunk(ptrs[0]));
+    FAIL_IF_NOT(slab_test_memuse == (chunks - 1) * ChunkBytes(&cache->classes[0]));
+
+    /* the page is full, so the remote chunk is taken back */
+    FAIL_IF_NOT(SlabAlloc(slab, cache, 48) == ptrs[0]);
+    FAIL_IF_NOT(cache->classes[0].pages == 1);
+    FAIL_IF_NOT(slab_test_memuse == chunks * ChunkBytes(&cache->classes[0]));
+
+    /* a released cache is reused by the next thread */
+    SlabCacheRelease(cache);
+    FAIL_IF_NOT(SlabCacheGet(slab) == cache);
+    for (uint32_t i = 0; i < chunks; i++) {
+        SlabFree(cache, ptrs[i]);
+    }
+    FAIL_IF_NOT(cache->classes[0].pages == 1);
+    FAIL_IF_NOT(cache->classes[0].empty == 1);
+
+    /* the shared cache */
+    void *s = SlabAlloc(slab, NULL, 48);
+    FAIL_IF_NULL(s);
+    FAIL_IF_NOT(DataChunk(s)->page->cache == slab->shared);
+    SlabFree(cache, s);
+
+    SlabCacheRelease(cache);
+    SlabDestroy(slab);
+    FAIL_IF_NOT(slab_test_memuse == 0);
+    PASS;
+}
+
+/** \test memcap, reserved and empty pages */
+static int SlabTest03(void)
+{
+    const uint32_t sizes[] = { 4096 };
+    slab_test_memuse = slab_test_memcap = 0;
+
+    Slab *slab = SlabInit(sizes, 1, SlabTestReserve, SlabTestRelease);
+    FAIL_IF_NULL(slab);
+    SlabCache *cache = SlabCacheGet(slab);
+    FAIL_IF_NULL(cache);
+    SlabClass *cls = &cache->classes[0];
+    const size_t chunk_bytes = ChunkBytes(cls);
+
+    /* reserved pages only count once they are used */
+    FAIL_IF_NOT(SlabCacheReserve(cache, 4096, cls->chunks + 1) == 0);
+    FAIL_IF_NOT(cls->pages == 2);
+    FAIL_IF_NOT(slab_test_memuse == 0);
+
+    /* no room for more chunks */
+    slab_test_memcap = 2 * cls->chunks * chunk_bytes;
+    void *ptrs[3 * cls->chunks];
+    for (uint32_t i = 0; i < 2 * cls->chunks; i++) {
+        ptrs[i] = SlabAlloc(slab, cache, 4096);
+        FAIL_IF_NULL(ptrs[i]);
+    }
+    FAIL_IF_NOT(SlabAlloc(slab, cache, 4096) == NULL);
+    FAIL_IF_NOT(SlabAlloc(slab, cache, 8192) == NULL);
+    FAIL_IF_NOT(slab_test_memuse == slab_test_memcap);
+
+    slab_test_memcap = 0;
+    for (uint32_t i = 2 * cls->chunks; i < 3 * cls->chunks; i++) {
+        ptrs[i] = SlabAlloc(slab, cache, 4096);
+        FAIL_IF_NULL(ptrs[i]);
+    }
+    FAIL_IF_NOT(cls->pages == 3);
+
+    /* reserved pages are kept, one more empty page is kept */
+    for (uint32_t i = 0; i < 3 * cls->chunks; i++) {
+        SlabFree(cache, ptrs[i]);
+    }
+    FAIL_IF_NOT(cls->pages == 2);
+    FAIL_IF_NOT(cls->empty == 2);
+    FAIL_IF_NOT(slab_test_memuse == 0);
+
+    SlabCacheRelease(cache);
+    SlabDestroy(slab);
+    FAIL_IF_NOT(slab_test_memuse == 0);
+    PASS;
+}
+
+/** \test large classes are charged per chunk, not per page */
+static int SlabTest04(void)
+{
+    const uint32_t sizes[] = { 65536 };
+    slab_test_memuse = slab_test_memcap = 0;
+
+    Slab *slab = SlabInit(sizes, 1, SlabTestReserve, SlabTestRelease);
+    FAIL_IF_NULL(slab);
+    SlabCache *cache = SlabCacheGet(slab);
+    FAIL_IF_NULL(cache);
+    SlabClass *cls = &cache->classes[0];
+    FAIL_IF_NOT(cls->chunks == SLAB_PAGE_MIN_CHUNKS);
+
+    /* a memcap of one chunk allows one chunk */
+    slab_test_memcap = ChunkBytes(cls);
+    void *a = SlabAlloc(slab, cache, 65536);
+    FAIL_IF_NULL(a);
+    FAIL_IF_NOT(slab_test_memuse == ChunkBytes(cls));
+    FAIL_IF_NOT(SlabAlloc(slab, cache, 65536) == NULL);
+
+    /* a chunk still in use is released with the slab */
+    SlabCacheRelease(cache);
+    SlabDestroy(slab);
+    FAIL_IF_NOT(slab_test_memuse == 0);
+    PASS;
+}
+#endif /* UNITTESTS */
+
+void SlabRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("SlabTest01", SlabTest01);
+    UtRegisterTest("SlabTest02", SlabTest02);
+    UtRegisterTest("SlabTest03", SlabTest03);
+    UtRegisterTest("SlabTest04", SlabTest04);
+#endif /* UNITTESTS */
+}
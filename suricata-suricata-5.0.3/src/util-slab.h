@@ -0,0 +1,92 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Per thread slab allocator with size classes.
+ *
+ * Each thread allocates from its own SlabCache without locking. Memory
+ * freed by another thread is handed back to the owning cache through a
+ * lock free list, which the owner picks up when it runs out of chunks.
+ */
+
+#ifndef __UTIL_SLAB_H__
+#define __UTIL_SLAB_H__
+
+/** max number of size classes of a slab */
+#define SLAB_MAX_CLASSES    16
+
+struct SlabPage_;
+
+typedef struct SlabClass_ {
+    uint32_t size;              /**< usable size of a chunk */
+    uint32_t chunks;            /**< chunks per page */
+
+    struct SlabPage_ *partial;  /**< pages with free chunks, empty last */
+    struct SlabPage_ *partial_tail;
+    struct SlabPage_ *full;     /**< pages without free chunks */
+
+    uint32_t pages;             /**< pages in use by this class */
+    uint32_t min_pages;         /**< pages kept even if empty */
+    uint32_t empty;             /**< empty pages */
+} SlabClass;
+
+typedef struct SlabCache_ {
+    struct Slab_ *slab;
+    bool owned;                 /**< cache is in use by a thread */
+
+    /** chunks freed by other threads */
+    SC_ATOMIC_DECLARE(void *, remote);
+
+    SlabClass classes[SLAB_MAX_CLASSES];
+    struct SlabCache_ *next;
+} SlabCache;
+
+typedef struct Slab_ {
+    int nclasses;
+    uint32_t sizes[SLAB_MAX_CLASSES];
+
+    /** memcap callbacks: Reserve returns 1 if the memory could be
+     *  accounted, 0 if it is over the memcap */
+    int (*Reserve)(size_t size);
+    void (*Release)(size_t size);
+
+    SCMutex lock;               /**< protects the list of caches */
+    SlabCache *caches;
+
+    /** cache for threads that don't have their own */
+    SCMutex shared_lock;
+    SlabCache *shared;
+} Slab;
+
+Slab *SlabInit(const uint32_t *sizes, int nsizes,
+        int (*Reserve)(size_t), void (*Release)(size_t));
+void SlabDestroy(Slab *slab);
+
+SlabCache *SlabCacheGet(Slab *slab);
+void SlabCacheRelease(SlabCache *cache);
+int SlabCacheReserve(SlabCache *cache, size_t size, uint32_t count);
+
+void *SlabAlloc(Slab *slab, SlabCache *cache, size_t size);
+void *SlabRealloc(Slab *slab, SlabCache *cache, void *ptr,
+        size_t orig_size, size_t size);
+void SlabFree(SlabCache *cache, void *ptr);
+
+void SlabRegisterTests(void);
+
+#endif /* __UTIL_SLAB_H__ */
@@ -41,6 +41,7 @@
     (cfg)->Free ? (cfg)->Free((ptr), (s)) : SCFree((ptr))
 
 static void SBBFree(StreamingBuffer *sb);
+static void EvictViews(StreamingBuffer *sb, uint64_t offset);
 
 RB_GENERATE(SBB, StreamingBufferBlock, rb, SBBCompare);
 
@@ -134,6 +135,7 @@ void StreamingBufferClear(StreamingBuffer *sb)
     if (sb != NULL) {
         SCLogDebug("sb->buf_size %u max %u", sb->buf_size, sb->buf_size_max);
 
+        EvictViews(sb, UINT64_MAX);
         SBBFree(sb);
         if (sb->buf != NULL) {
             FREE(sb->cfg, sb->buf, sb->buf_size);
@@ -436,6 +438,7 @@ static void AutoSlide(StreamingBuffer *sb)
     uint32_t size = sb->cfg->buf_slide;
     uint32_t slide = sb->buf_offset - size;
     SCLogDebug("sliding %u forward, size of original buffer left after slide %u", slide, size);
+    EvictViews(sb, sb->stream_offset + slide);
     memmove(sb->buf, sb->buf+slide, size);
     sb->stream_offset += slide;
     sb->buf_offset = size;
@@ -512,6 +515,7 @@ void StreamingBufferSlideToOffset(StreamingBuffer *sb, uint64_t offset)
         uint32_t slide = offset - sb->stream_offset;
         uint32_t size = sb->buf_offset - slide;
         SCLogDebug("sliding %u forward, size of original buffer left after slide %u", slide, size);
+        EvictViews(sb, offset);
         memmove(sb->buf, sb->buf+slide, size);
         sb->stream_offset += slide;
         sb->buf_offset = size;
@@ -523,6 +527,7 @@ void StreamingBufferSlide(StreamingBuffer *sb, uint32_t slide)
 {
     uint32_t size = sb->buf_offset - slide;
     SCLogDebug("sliding %u forward, size of original buffer left after slide %u", slide, size);
+    EvictViews(sb, sb->stream_offset + slide);
     memmove(sb->buf, sb->buf+slide, size);
     sb->stream_offset += slide;
     sb->buf_offset = size;
@@ -728,6 +733,165 @@ int StreamingBufferInsertAt(StreamingBuffer *sb, StreamingBufferSegment *seg,
     return 0;
 }
 
+/** \internal
+ *  \brief get the data of a view, clipped to what is in the buffer */
+static inline void ViewGetData(const StreamingBufferView *view,
+        const uint8_t **data, uint32_t *data_len)
+{
+    const StreamingBuffer *sb = view->sb;
+    if (sb->buf != NULL && view->offset >= sb->stream_offset &&
+            view->offset < sb->stream_offset + sb->buf_offset)
+    {
+        uint32_t rel = view->offset - sb->stream_offset;
+        *data = sb->buf + rel;
+        *data_len = MIN(view->len, sb->buf_offset - rel);
+    } else {
+        *data = NULL;
+        *data_len = 0;
+    }
+}
+
+/** \internal
+ *  \brief hand off and detach all views that have data before 'offset'
+ *
+ *  Must be called before the data is moved or freed.
+ */
+static void EvictViews(StreamingBuffer *sb, uint64_t offset)
+{
+    StreamingBufferView **pview = &sb->views;
+    while (*pview != NULL) {
+        StreamingBufferView *view = *pview;
+        if (view->offset >= offset) {
+            pview = &view->next;
+            continue;
+        }
+
+        const uint8_t *data = NULL;
+        uint32_t data_len = 0;
+        ViewGetData(view, &data, &data_len);
+
+        *pview = view->next;
+        view->next = NULL;
+        view->sb = NULL;
+
+        SCLogDebug("sb %p evicting view %p %"PRIu64", %u", sb, view,
+                view->offset, data_len);
+        view->Evict(view, data, data_len);
+    }
+}
+
+/**
+ *  \brief reference data that is in the buffer instead of copying it
+ *
+ *  \param data pointer into the buffer as returned by one of the GetData
+ *               functions, for the duration of the current call chain
+ *  \param Evict called before the data is slid out or cleared
+ *
+ *  \retval 0 view attached
+ *  \retval -1 data is not (completely) in this buffer, view unchanged
+ */
+int StreamingBufferViewAttach(StreamingBuffer *sb, StreamingBufferView *view,
+        const uint8_t *data, uint32_t data_len,
+        void (*Evict)(StreamingBufferView *, const uint8_t *, uint32_t))
+{
+    DEBUG_VALIDATE_BUG_ON(view->sb != NULL);
+
+    if (sb == NULL || sb->buf == NULL || data == NULL || data_len == 0)
+        return -1;
+
+    const uintptr_t start = (uintptr_t)sb->buf;
+    const uintptr_t ptr = (uintptr_t)data;
+    if (ptr < start || ptr - start > sb->buf_offset ||
+            data_len > sb->buf_offset - (ptr - start))
+        return -1;
+
+    view->sb = sb;
+    view->offset = sb->stream_offset + (ptr - start);
+    view->len = data_len;
+    view->Evict = Evict;
+    view->next = sb->views;
+    sb->views = view;
+    return 0;
+}
+
+/**
+ *  \brief grow a view with data that directly follows it in the buffer
+ *
+ *  \retval 0 view extended
+ *  \retval -1 view detached or data not adjacent, view unchanged
+ */
+int StreamingBufferViewExtend(StreamingBufferView *view,
+        const uint8_t *data, uint32_t data_len)
+{
+    const StreamingBuffer *sb = view->sb;
+    if (sb == NULL || sb->buf == NULL || view->offset < sb->stream_offset)
+        return -1;
+
+    const uint64_t next = view->offset + view->len - sb->stream_offset;
+    if (data != sb->buf + next || next + data_len > sb->buf_offset)
+        return -1;
+
+    view->len += data_len;
+    return 0;
+}
+
+/**
+ *  \brief drop 'slide' bytes from the start of a view
+ *
+ *  Dropped data is no longer handed to the Evict callback.
+ */
+void StreamingBufferViewSlide(StreamingBufferView *view, uint32_t slide)
+{
+    slide = MIN(slide, view->len);
+    view->offset += slide;
+    view->len -= slide;
+}
+
+/**
+ *  \brief stop referencing the buffer, without calling Evict
+ */
+void StreamingBufferViewDetach(StreamingBufferView *view)
+{
+    StreamingBuffer *sb = view->sb;
+    if (sb == NULL)
+        return;
+
+    StreamingBufferView **pview = &sb->views;
+    while (*pview != NULL) {
+        if (*pview == view) {
+            *pview = view->next;
+            break;
+        }
+        pview = &(*pview)->next;
+    }
+    view->next = NULL;
+    view->sb = NULL;
+}
+
+/**
+ *  \brief get view data starting 'offset' bytes into the view
+ *
+ *  \retval 1 data returned
+ *  \retval 0 no data: view detached or offset beyond the view
+ */
+int StreamingBufferViewGetDataAtOffset(const StreamingBufferView *view,
+        const uint8_t **data, uint32_t *data_len, uint64_t offset)
+{
+    if (view->sb != NULL && offset < view->len) {
+        const uint8_t *vdata = NULL;
+        uint32_t vdata_len = 0;
+        ViewGetData(view, &vdata, &vdata_len);
+        if (vdata != NULL && offset < vdata_len) {
+            *data = vdata + offset;
+            *data_len = vdata_len - (uint32_t)offset;
+            return 1;
+        }
+    }
+    *data = NULL;
+    *data_len = 0;
+    return 0;
+}
+
 int StreamingBufferSegmentIsBeforeWindow(const StreamingBuffer *sb,
                                          const StreamingBufferSegment *seg)
 {
@@ -1472,6 +1636,84 @@ static int StreamingBufferTest10(void)
     PASS;
 }
 
+static uint8_t view_evict_data[32];
+static uint32_t view_evict_len = 0;
+static int view_evict_cnt = 0;
+
+static void ViewTestEvict(StreamingBufferView *view,
+        const uint8_t *data, uint32_t data_len)
+{
+    BUG_ON(view->sb != NULL);
+    BUG_ON(data_len > sizeof(view_evict_data));
+    memcpy(view_evict_data, data, data_len);
+    view_evict_len = data_len;
+    view_evict_cnt++;
+}
+
+/** \test views follow the data, and hand it off when it's slid out */
+static int StreamingBufferTest11(void)
+{
+    StreamingBufferConfig cfg = { 0, 8, 16, NULL, NULL, NULL, NULL };
+    StreamingBuffer *sb = StreamingBufferInit(&cfg);
+    FAIL_IF(sb == NULL);
+    view_evict_cnt = 0;
+
+    StreamingBufferSegment seg;
+    FAIL_IF(StreamingBufferAppend(sb, &seg, (const uint8_t *)"ABCDEFGH", 8) != 0);
+
+    const uint8_t *data = NULL;
+    uint32_t data_len = 0;
+    FAIL_IF_NOT(StreamingBufferGetDataAtOffset(sb, &data, &data_len, 2));
+    StreamingBufferView view;
+    memset(&view, 0, sizeof(view));
+    FAIL_IF(StreamingBufferViewAttach(sb, &view, data, 3, ViewTestEvict) != 0);
+    FAIL_IF(view.offset != 2);
+    /* not adjacent to the view */
+    FAIL_IF(StreamingBufferViewExtend(&view, data + 4, 1) == 0);
+    FAIL_IF(StreamingBufferViewExtend(&view, data + 3, 2) != 0);
+    FAIL_IF(view.len != 5);
+
+    /* not in the buffer */
+    uint8_t other[4] = { 0 };
+    StreamingBufferView view2;
+    memset(&view2, 0, sizeof(view2));
+    FAIL_IF(StreamingBufferViewAttach(sb, &view2, other, sizeof(other), ViewTestEvict) == 0);
+    FAIL_IF(StreamingBufferViewAttach(sb, &view2, data, 7, ViewTestEvict) == 0);
+    FAIL_IF(view2.sb != NULL);
+
+    /* grows the buffer, the view must follow the data */
+    FAIL_IF(StreamingBufferAppend(sb, &seg, (const uint8_t *)"IJKLMNOPQRSTUVWXYZ", 18) != 0);
+    FAIL_IF_NOT(StreamingBufferViewGetDataAtOffset(&view, &data, &data_len, 1));
+    FAIL_IF(data_len != 4 || memcmp(data, "DEFG", 4) != 0);
+
+    /* slide up to the view: nothing handed off */
+    StreamingBufferSlideToOffset(sb, 2);
+    FAIL_IF(view.sb != sb);
+    FAIL_IF(view_evict_cnt != 0);
+
+    /* slide into the view: data handed off, view detached */
+    StreamingBufferSlideToOffset(sb, 4);
+    FAIL_IF(view.sb != NULL);
+    FAIL_IF(view_evict_cnt != 1);
+    FAIL_IF(view_evict_len != 5 || memcmp(view_evict_data, "CDEFG", 5) != 0);
+    FAIL_IF(StreamingBufferViewGetDataAtOffset(&view, &data, &data_len, 0) != 0);
+    FAIL_IF(sb->views != NULL);
+
+    /* only what is left of a slid view is handed off */
+    FAIL_IF_NOT(StreamingBufferGetDataAtOffset(sb, &data, &data_len, 10));
+    FAIL_IF(StreamingBufferViewAttach(sb, &view, data, 4, ViewTestEvict) != 0);
+    StreamingBufferViewSlide(&view, 2);
+    FAIL_IF(StreamingBufferViewAttach(sb, &view2, data, 1, ViewTestEvict) != 0);
+    StreamingBufferViewDetach(&view2);
+    FAIL_IF(view2.sb != NULL);
+    FAIL_IF(sb->views != &view || view.next != NULL);
+
+    StreamingBufferFree(sb);
+    FAIL_IF(view_evict_cnt != 2);
+    FAIL_IF(view_evict_len != 2 || memcmp(view_evict_data, "MN", 2) != 0);
+    PASS;
+}
+
 #endif
 
 void StreamingBufferRegisterTests(void)
@@ -1487,5 +1729,6 @@ void StreamingBufferRegisterTests(void)
     UtRegisterTest("StreamingBufferTest08", StreamingBufferTest08);
     UtRegisterTest("StreamingBufferTest09", StreamingBufferTest09);
     UtRegisterTest("StreamingBufferTest10", StreamingBufferTest10);
+    UtRegisterTest("StreamingBufferTest11", StreamingBufferTest11);
 #endif
 }
@@ -53,6 +53,12 @@
  * +-----------+-----------+
  * | offset    | len       |
  * +-----------+-----------+
+ *
+ * A StreamingBufferView lets another buffer owner reference a region
+ * of the data without copying it. Views don't hold the data in place:
+ * before viewed data is slid out of the buffer or cleared, the view's
+ * Evict callback is handed the data so its owner can copy what it still
+ * needs, and the view is detached.
  */
 
 
@@ -92,6 +98,24 @@ RB_HEAD(SBB, StreamingBufferBlock);
 RB_PROTOTYPE(SBB, StreamingBufferBlock, rb, SBBCompare);
 StreamingBufferBlock *SBB_RB_FIND_INCLUSIVE(struct SBB *head, StreamingBufferBlock *elm);
 
+struct StreamingBuffer_;
+
+/**
+ *  \brief reference to a region of a StreamingBuffer's data
+ */
+typedef struct StreamingBufferView_ {
+    struct StreamingBuffer_ *sb;    /**< buffer viewed, NULL if detached */
+    uint64_t offset;                /**< stream offset of the first byte */
+    uint32_t len;
+
+    /** called with the viewed data right before it leaves the buffer. The
+     *  view is already detached when this is called. */
+    void (*Evict)(struct StreamingBufferView_ *view,
+            const uint8_t *data, uint32_t data_len);
+
+    struct StreamingBufferView_ *next;
+} StreamingBufferView;
+
 typedef struct StreamingBuffer_ {
     const StreamingBufferConfig *cfg;
     uint64_t stream_offset; /**< offset of the start of the memory block */
@@ -102,15 +126,16 @@ typedef struct StreamingBuffer_ {
 
     struct SBB sbb_tree;    /**< red black tree of Stream Buffer Blocks */
     StreamingBufferBlock *head; /**< head, should always be the same as RB_MIN */
+    StreamingBufferView *views; /**< views on the data, see StreamingBufferViewAttach */
 #ifdef DEBUG
     uint32_t buf_size_max;
 #endif
 } StreamingBuffer;
 
 #ifndef DEBUG
-#define STREAMING_BUFFER_INITIALIZER(cfg) { (cfg), 0, NULL, 0, 0, { NULL }, NULL, };
+#define STREAMING_BUFFER_INITIALIZER(cfg) { (cfg), 0, NULL, 0, 0, { NULL }, NULL, NULL, };
 #else
-#define STREAMING_BUFFER_INITIALIZER(cfg) { (cfg), 0, NULL, 0, 0, { NULL }, NULL, 0 };
+#define STREAMING_BUFFER_INITIALIZER(cfg) { (cfg), 0, NULL, 0, 0, { NULL }, NULL, NULL, 0 };
 #endif
 
 typedef struct StreamingBufferSegment_ {
@@ -162,6 +187,16 @@ int StreamingBufferGetDataAtOffset (const StreamingBuffer *sb,
         const uint8_t **data, uint32_t *data_len,
         uint64_t offset);
 
+int StreamingBufferViewAttach(StreamingBuffer *sb, StreamingBufferView *view,
+        const uint8_t *data, uint32_t data_len,
+        void (*Evict)(StreamingBufferView *, const uint8_t *, uint32_t));
+int StreamingBufferViewExtend(StreamingBufferView *view,
+        const uint8_t *data, uint32_t data_len);
+void StreamingBufferViewSlide(StreamingBufferView *view, uint32_t slide);
+void StreamingBufferViewDetach(StreamingBufferView *view);
+int StreamingBufferViewGetDataAtOffset(const StreamingBufferView *view,
+        const uint8_t **data, uint32_t *data_len, uint64_t offset);
+
 int StreamingBufferSegmentIsBeforeWindow(const StreamingBuffer *sb,
                                          const StreamingBufferSegment *seg);
 